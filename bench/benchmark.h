@@ -0,0 +1,171 @@
+// Copyright 2013  All Rights Reserved.
+// Author: ryan.scranton@gmail.com (Ryan Scranton)
+
+// STOMP is a set of libraries for doing astrostatistical analysis on the
+// celestial sphere.  The goal is to enable descriptions of arbitrary regions
+// on the sky which may or may not encode futher spatial information (galaxy
+// density, CMB temperature, observational depth, etc.) and to do so in such
+// a way as to make the analysis of that data as algorithmically efficient as
+// possible.
+//
+// This header file contains the small timing harness shared by the stomp and
+// s2omp benchmark drivers.  Each benchmark is a setup step (untimed) and a
+// workload that is run a fixed number of times.  For every benchmark we
+// report the per-repetition wall clock latency percentiles, the throughput in
+// items per second (where an "item" is whatever the workload processes:
+// points tested, pixels generated, pairs searched, etc.) and the peak
+// resident set size of the process so far.  Results are written as one JSON
+// object per line to the file given by --output, so that runs can be diffed
+// or collected by a script.  Since the libraries print their own progress
+// messages to standard output, the results are echoed to standard error.
+
+#ifndef BENCH_BENCHMARK_H_
+#define BENCH_BENCHMARK_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace StompBench {
+
+// Command line options common to both drivers.  Everything is passed as
+// --name=value; unrecognized options are reported and ignored.
+struct BenchmarkOptions {
+  uint32_t n_points;      // Size of the synthetic catalogs.
+  uint32_t seed;          // Seed for footprints and catalogs.
+  uint32_t repetitions;   // Timed repetitions per benchmark.
+  double radius;          // Radius of the synthetic footprint in degrees.
+  std::string filter;     // Only run benchmarks whose name contains this.
+  std::string output;     // JSON output file; empty for standard output.
+
+  BenchmarkOptions() :
+    n_points(100000), seed(1), repetitions(5), radius(5.0) {}
+
+  void Parse(int argc, char** argv) {
+    for (int i=1;i<argc;i++) {
+      std::string arg(argv[i]);
+      size_t split = arg.find('=');
+      std::string name = arg.substr(0, split);
+      std::string value = (split == std::string::npos ? "" :
+			   arg.substr(split + 1));
+      if (name == "--n_points") {
+	n_points = strtoul(value.c_str(), NULL, 10);
+      } else if (name == "--seed") {
+	seed = strtoul(value.c_str(), NULL, 10);
+      } else if (name == "--repetitions") {
+	repetitions = strtoul(value.c_str(), NULL, 10);
+      } else if (name == "--radius") {
+	radius = strtod(value.c_str(), NULL);
+      } else if (name == "--filter") {
+	filter = value;
+      } else if (name == "--output") {
+	output = value;
+      } else {
+	std::cerr << "Unrecognized option: " << arg << "\n";
+      }
+    }
+    if (repetitions == 0) repetitions = 1;
+  }
+};
+
+// Peak resident set size in kilobytes.
+inline long PeakRSSKilobytes() {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+#if defined(__APPLE__)
+  return usage.ru_maxrss/1024;
+#else
+  return usage.ru_maxrss;
+#endif
+}
+
+class BenchmarkReport {
+ public:
+  BenchmarkReport(const std::string& library, const BenchmarkOptions& options) :
+    library_(library), options_(options), n_run_(0) {
+    if (!options_.output.empty()) {
+      output_file_.open(options_.output.c_str());
+    }
+  }
+
+  // Run a single benchmark.  The setup function is called once, outside of
+  // the timed region; workload is then called options.repetitions times and
+  // should return the number of items it processed.
+  void Run(const std::string& name, std::function<void()> setup,
+	   std::function<uint64_t()> workload) {
+    if (!options_.filter.empty() &&
+	(name.find(options_.filter) == std::string::npos)) return;
+
+    setup();
+
+    std::vector<double> latency;
+    uint64_t n_items = 0;
+    for (uint32_t i=0;i<options_.repetitions;i++) {
+      std::chrono::steady_clock::time_point start =
+	std::chrono::steady_clock::now();
+      n_items += workload();
+      std::chrono::duration<double> elapsed =
+	std::chrono::steady_clock::now() - start;
+      latency.push_back(elapsed.count());
+    }
+
+    double total_time = 0.0;
+    for (uint32_t i=0;i<latency.size();i++) total_time += latency[i];
+    std::sort(latency.begin(), latency.end());
+
+    std::ostringstream json;
+    json.precision(6);
+    json << "{\"library\": \"" << library_ << "\", " <<
+      "\"benchmark\": \"" << name << "\", " <<
+      "\"n_points\": " << options_.n_points << ", " <<
+      "\"seed\": " << options_.seed << ", " <<
+      "\"repetitions\": " << options_.repetitions << ", " <<
+      "\"items\": " << n_items/options_.repetitions << ", " <<
+      "\"latency_min_s\": " << latency.front() << ", " <<
+      "\"latency_p50_s\": " << Percentile(latency, 0.50) << ", " <<
+      "\"latency_p90_s\": " << Percentile(latency, 0.90) << ", " <<
+      "\"latency_p99_s\": " << Percentile(latency, 0.99) << ", " <<
+      "\"latency_max_s\": " << latency.back() << ", " <<
+      "\"items_per_s\": " <<
+      (total_time > 0.0 ? n_items/total_time : 0.0) << ", " <<
+      "\"peak_rss_kb\": " << PeakRSSKilobytes() << "}";
+
+    if (output_file_.is_open()) {
+      output_file_ << json.str() << "\n";
+      output_file_.flush();
+    }
+    std::cerr << json.str() << "\n";
+    n_run_++;
+  }
+
+  uint32_t NRun() const {
+    return n_run_;
+  }
+
+ private:
+  // Nearest-rank percentile of a sorted vector.
+  static double Percentile(const std::vector<double>& sorted, double fraction) {
+    uint32_t rank = static_cast<uint32_t>(fraction*sorted.size() + 0.999999);
+    if (rank < 1) rank = 1;
+    if (rank > sorted.size()) rank = sorted.size();
+    return sorted[rank - 1];
+  }
+
+  std::string library_;
+  BenchmarkOptions options_;
+  std::ofstream output_file_;
+  uint32_t n_run_;
+};
+
+} // end namespace StompBench
+
+#endif
@@ -0,0 +1,154 @@
+// Copyright 2013  All Rights Reserved.
+// Author: ryan.scranton@gmail.com (Ryan Scranton)
+
+// Benchmarks for the s2omp library hot paths.  These mirror the Stomp
+// benchmarks: a circle_bound footprint of --radius degrees around an axis
+// drawn from --seed and catalogs of --n_points points drawn uniformly within
+// it.  The s2omp random point generators share an unseeded, per-translation
+// unit generator, so the catalogs are drawn here from our own seeded one.
+
+#include <math.h>
+#include <random>
+#include <string>
+
+#include "benchmark.h"
+
+#include "angular_bin-inl.h"
+#include "circle_bound.h"
+#include "coverer.h"
+#include "io.h"
+#include "pixel_union.h"
+#include "point.h"
+#include "tree_union.h"
+
+// Draw n_points points uniformly within radius_deg of axis.
+void seeded_cap_points(const s2omp::point& axis, double radius_deg,
+    long n_points, std::mt19937_64* generator, s2omp::point_vector* points) {
+  std::uniform_real_distribution<double> uniform(0.0, 1.0);
+
+  // Build an orthonormal frame around the axis.
+  double ax = axis.x(), ay = axis.y(), az = axis.z();
+  double ux = fabs(ax) < 0.9 ? 1.0 : 0.0, uy = ux > 0.0 ? 0.0 : 1.0, uz = 0.0;
+  double dot = ux * ax + uy * ay + uz * az;
+  ux -= dot * ax;
+  uy -= dot * ay;
+  uz -= dot * az;
+  double norm = sqrt(ux * ux + uy * uy + uz * uz);
+  ux /= norm;
+  uy /= norm;
+  uz /= norm;
+  double vx = ay * uz - az * uy, vy = az * ux - ax * uz, vz = ax * uy - ay * ux;
+
+  double height = 1.0 - cos(radius_deg * s2omp::DEG_TO_RAD);
+  points->clear();
+  points->reserve(n_points);
+  for (long k = 0; k < n_points; k++) {
+    double z = 1.0 - height * uniform(*generator);
+    double r = sqrt(1.0 - z * z);
+    double phi = 2.0 * s2omp::PI * uniform(*generator);
+    double a = r * cos(phi), b = r * sin(phi);
+    points->push_back(s2omp::point(z * ax + a * ux + b * vx,
+        z * ay + a * uy + b * vy, z * az + a * uz + b * vz, 1.0));
+  }
+}
+
+int main(int argc, char **argv) {
+  StompBench::BenchmarkOptions options;
+  options.Parse(argc, argv);
+  StompBench::BenchmarkReport report("s2omp", options);
+
+  std::mt19937_64 generator(options.seed);
+  std::uniform_real_distribution<double> uniform(0.0, 1.0);
+  double sin_dec = sin(60.0 * s2omp::DEG_TO_RAD);
+  double dec = asin(sin_dec * (2.0 * uniform(generator) - 1.0));
+  double ra = 2.0 * s2omp::PI * uniform(generator);
+  s2omp::point axis(cos(dec) * cos(ra), cos(dec) * sin(ra), sin(dec), 1.0);
+  s2omp::circle_bound* bound =
+      s2omp::circle_bound::from_radius(axis, options.radius);
+
+  int max_level = s2omp::pixel::get_level_from_area(bound->area() / 1.0e5);
+
+  s2omp::pixel_vector covering;
+  report.Run("circle_bound::get_size_covering", [](){}, [&]() -> uint64_t {
+      bound->get_size_covering(1000, &covering);
+      return covering.size();
+    });
+
+  s2omp::pixel_vector interior;
+  report.Run("circle_bound::get_interior_covering", [](){}, [&]() -> uint64_t {
+      bound->get_interior_covering(max_level, &interior);
+      return interior.size();
+    });
+  if (interior.empty()) bound->get_interior_covering(max_level, &interior);
+
+  s2omp::pixel_union pix_union;
+  report.Run("pixel_union::init", [](){}, [&]() -> uint64_t {
+      s2omp::pixel_vector pixels(interior);
+      pix_union.init(pixels);
+      return pix_union.size();
+    });
+  if (pix_union.is_empty()) {
+    s2omp::pixel_vector pixels(interior);
+    pix_union.init(pixels);
+  }
+
+  s2omp::point_vector catalog, test_points;
+  seeded_cap_points(axis, options.radius, options.n_points, &generator,
+      &catalog);
+  seeded_cap_points(axis, 1.5 * options.radius, options.n_points, &generator,
+      &test_points);
+
+  long n_contained = 0;
+  report.Run("pixel_union::contains", [](){}, [&]() -> uint64_t {
+      n_contained = 0;
+      for (s2omp::point_iterator iter = test_points.begin();
+          iter != test_points.end(); ++iter) {
+        if (pix_union.contains(*iter)) n_contained++;
+      }
+      return test_points.size();
+    });
+
+  s2omp::tree_union* tree = NULL;
+  report.Run("tree_union::add_points", [](){}, [&]() -> uint64_t {
+      delete tree;
+      tree = new s2omp::tree_union(8, 200);
+      tree->add_points(catalog);
+      return catalog.size();
+    });
+
+  report.Run("tree_union::find_pairs", [](){}, [&]() -> uint64_t {
+      s2omp::angular_bin bin(0.01, 0.1);
+      tree->find_pairs(catalog, &bin);
+      return catalog.size();
+    });
+  delete tree;
+
+  std::string pb_file_name = "s2omp_bench_union.pb";
+  std::string chunked_file_name = "s2omp_bench_union.chk";
+  std::string packed_file_name = "s2omp_bench_union_packed.chk";
+  report.Run("io::read_pb", [&]() {
+      s2omp::io::write_pb(pix_union, pb_file_name);
+    }, [&]() -> uint64_t {
+      s2omp::pixel_union read_union;
+      s2omp::io::read_pb(pb_file_name, &read_union);
+      return read_union.size();
+    });
+  report.Run("io::read_chunked", [&]() {
+      s2omp::io::write_chunked(pix_union, chunked_file_name);
+    }, [&]() -> uint64_t {
+      s2omp::pixel_union read_union;
+      s2omp::io::read_chunked(chunked_file_name, &read_union);
+      return read_union.size();
+    });
+  report.Run("io::read_chunked (packed)", [&]() {
+      s2omp::io::write_packed(pix_union, packed_file_name);
+    }, [&]() -> uint64_t {
+      s2omp::pixel_union read_union;
+      s2omp::io::read_chunked(packed_file_name, &read_union);
+      return read_union.size();
+    });
+
+  delete bound;
+
+  return report.NRun() > 0 ? 0 : 1;
+}
@@ -0,0 +1,186 @@
+// Copyright 2013  All Rights Reserved.
+// Author: ryan.scranton@gmail.com (Ryan Scranton)
+
+// Benchmarks for the Stomp library hot paths.  The footprint is a circle of
+// --radius degrees at a position drawn from --seed, pixelized into a Map, and
+// the catalogs are --n_points random points drawn from that Map (or from a
+// slightly larger one for the containment tests) with the same seed, so two
+// runs with the same options do exactly the same work.
+
+#include <stdint.h>
+#include <math.h>
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <stomp.h>
+#include "MersenneTwister.h"
+#include "benchmark.h"
+
+int main(int argc, char **argv) {
+  StompBench::BenchmarkOptions options;
+  options.Parse(argc, argv);
+  StompBench::BenchmarkReport report("stomp", options);
+
+  // Draw the footprint center uniformly over the sphere between +/-60 degrees
+  // in declination.
+  MTRand mtrand(options.seed);
+  double ra = 360.0*mtrand.randExc();
+  double sin_dec = sin(60.0*Stomp::DegToRad);
+  double dec = asin(sin_dec*(2.0*mtrand.rand() - 1.0))*Stomp::RadToDeg;
+  Stomp::AngularCoordinate center(ra, dec,
+				  Stomp::AngularCoordinate::Equatorial);
+  Stomp::CircleBound bound(center, options.radius);
+  Stomp::CircleBound outer_bound(center, 1.5*options.radius);
+  uint32_t max_resolution = 2048;
+
+  Stomp::Map stomp_map;
+  report.Run("Map::PixelizeBound", [](){}, [&]() -> uint64_t {
+      stomp_map.PixelizeBound(bound, 1.0, max_resolution);
+      return stomp_map.Size();
+    });
+  if (stomp_map.Empty()) stomp_map.PixelizeBound(bound, 1.0, max_resolution);
+
+  Stomp::AngularVector catalog;
+  report.Run("Map::GenerateRandomPoints", [](){}, [&]() -> uint64_t {
+      catalog.clear();
+      stomp_map.GenerateRandomPoints(catalog, options.n_points, false,
+				     options.seed);
+      return catalog.size();
+    });
+  if (catalog.empty())
+    stomp_map.GenerateRandomPoints(catalog, options.n_points, false,
+				   options.seed);
+
+  // Catalog ingestion: RA/DEC columns to unit vectors and to Galactic
+  // coordinates, one point at a time and with the bulk conversions.
+  std::vector<double> ra_col, dec_col, x_col, y_col, z_col, out_theta, out_phi;
+  Stomp::AngularCoordinate::FromAngularVector(catalog, ra_col, dec_col);
+  report.Run("AngularCoordinate::Set (scalar)", [](){}, [&]() -> uint64_t {
+      x_col.resize(ra_col.size());
+      Stomp::AngularCoordinate ang;
+      for (uint32_t i=0;i<ra_col.size();i++) {
+	ang.SetEquatorialCoordinates(ra_col[i], dec_col[i]);
+	x_col[i] = ang.UnitSphereX();
+      }
+      return ra_col.size();
+    });
+  report.Run("AngularCoordinate::ToUnitSphereCoordinates", [](){},
+	     [&]() -> uint64_t {
+      Stomp::AngularCoordinate::ToUnitSphereCoordinates(ra_col, dec_col,
+							x_col, y_col, z_col);
+      return ra_col.size();
+    });
+  report.Run("AngularCoordinate::EquatorialToGalactic (scalar)", [](){},
+	     [&]() -> uint64_t {
+      out_theta.resize(ra_col.size());
+      out_phi.resize(ra_col.size());
+      for (uint32_t i=0;i<ra_col.size();i++)
+	Stomp::AngularCoordinate::EquatorialToGalactic(ra_col[i], dec_col[i],
+						       out_theta[i],
+						       out_phi[i]);
+      return ra_col.size();
+    });
+  report.Run("AngularCoordinate::ConvertCoordinates", [](){},
+	     [&]() -> uint64_t {
+      Stomp::AngularCoordinate::ConvertCoordinates(
+	ra_col, dec_col, Stomp::AngularCoordinate::Equatorial,
+	out_theta, out_phi, Stomp::AngularCoordinate::Galactic);
+      return ra_col.size();
+    });
+
+  // For the containment tests we want a mix of hits and misses, so the test
+  // points come from a larger, coarsely pixelized footprint.
+  Stomp::AngularVector test_points;
+  uint32_t n_contained = 0;
+  report.Run("Map::Contains", [&]() {
+      Stomp::Map outer_map;
+      outer_map.PixelizeBound(outer_bound, 1.0, 256);
+      outer_map.GenerateRandomPoints(test_points, options.n_points, false,
+				     options.seed);
+    }, [&]() -> uint64_t {
+      n_contained = 0;
+      for (Stomp::AngularIterator iter=test_points.begin();
+	   iter!=test_points.end();++iter)
+	if (stomp_map.Contains(*iter)) n_contained++;
+      return test_points.size();
+    });
+
+  // Circle coverage is far more expensive per object than a point lookup,
+  // so we only use the first few thousand test points as circle centers.
+  report.Run("Map::FindQuadrantFractions", [](){}, [&]() -> uint64_t {
+      Stomp::AngularVector circle_ang(test_points.begin(),
+				      test_points.begin() +
+				      std::min<size_t>(test_points.size(),
+						       4096));
+      std::vector<double> radius(1, 0.05*options.radius);
+      std::vector<double> unmasked_fraction, quadrant_fraction;
+      stomp_map.FindQuadrantFractions(circle_ang, radius, unmasked_fraction,
+				      quadrant_fraction);
+      return circle_ang.size();
+    });
+
+  std::string ascii_file_name = "stomp_bench_map.pix";
+  std::string binary_file_name = "stomp_bench_map.bin";
+  report.Run("Map::Write", [](){}, [&]() -> uint64_t {
+      stomp_map.Write(ascii_file_name);
+      return stomp_map.Size();
+    });
+  report.Run("Map::Read", [&]() {
+      stomp_map.Write(ascii_file_name);
+    }, [&]() -> uint64_t {
+      Stomp::Map read_map;
+      read_map.Read(ascii_file_name);
+      return read_map.Size();
+    });
+  report.Run("Map::WriteBinary", [](){}, [&]() -> uint64_t {
+      stomp_map.WriteBinary(binary_file_name);
+      return stomp_map.Size();
+    });
+  report.Run("Map::ReadBinary", [&]() {
+      stomp_map.WriteBinary(binary_file_name);
+    }, [&]() -> uint64_t {
+      Stomp::Map read_map;
+      read_map.ReadBinary(binary_file_name);
+      return read_map.Size();
+    });
+
+  // Pair counting on small scales, using the pair-based estimator for every
+  // bin.
+  Stomp::WAngularVector galaxy;
+  Stomp::TreeMap* galaxy_tree = NULL;
+  report.Run("TreeMap::FindWeightedPairs", [&]() {
+      galaxy.reserve(catalog.size());
+      for (Stomp::AngularIterator iter=catalog.begin();
+	   iter!=catalog.end();++iter)
+	galaxy.push_back(Stomp::WeightedAngularCoordinate(
+	  iter->UnitSphereX(), iter->UnitSphereY(), iter->UnitSphereZ(), 1.0));
+      galaxy_tree = new Stomp::TreeMap(256, 200);
+      for (Stomp::WAngularIterator iter=galaxy.begin();
+	   iter!=galaxy.end();++iter) galaxy_tree->AddPoint(*iter);
+    }, [&]() -> uint64_t {
+      Stomp::AngularCorrelation wtheta(0.01, 0.1, 4.0, false);
+      wtheta.UseOnlyPairs();
+      galaxy_tree->FindWeightedPairs(galaxy, wtheta);
+      return galaxy.size();
+    });
+  delete galaxy_tree;
+
+  // Pixel-based auto-correlation on large scales.
+  uint32_t scalar_resolution = 256;
+  Stomp::ScalarMap* scalar_map = NULL;
+  report.Run("ScalarMap::AutoCorrelate", [&]() {
+      scalar_map = new Stomp::ScalarMap(stomp_map, scalar_resolution,
+					Stomp::ScalarMap::DensityField);
+      for (Stomp::AngularIterator iter=catalog.begin();
+	   iter!=catalog.end();++iter) scalar_map->AddToMap(*iter);
+    }, [&]() -> uint64_t {
+      Stomp::AngularCorrelation wtheta(0.1, 1.0, 4.0);
+      wtheta.SetMaxResolution(scalar_resolution);
+      scalar_map->AutoCorrelate(wtheta);
+      return scalar_map->Size();
+    });
+  delete scalar_map;
+
+  return report.NRun() > 0 ? 0 : 1;
+}
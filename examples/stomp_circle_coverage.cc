@@ -19,6 +19,10 @@ DEFINE_string(output_file, "",
               "Name of the ASCII file to write results");
 DEFINE_int32(max_resolution, -1,
              "Maximum resolution for pixelizing circles.  Default to map maximum resolution");
+DEFINE_int32(n_threads, -1,
+             "Number of threads to use.  Default to one per core.");
+DEFINE_bool(fractions, false,
+            "Also write the unmasked fraction of each circle and quadrant.");
 DEFINE_bool(single_index, false, "Use older single-index file input format.");
 DEFINE_bool(no_weight, false, "Input map file is missing weight column.");
 DEFINE_bool(radec, false, "Input positions are in equatorial coordinates.");
@@ -77,83 +81,63 @@ int main(int argc, char **argv) {
     exit(1);
   }
 
-  // Define our bit mask values
-  unsigned long inside_map = 1 << 0;
-  unsigned long first_quadrant = 1 << 1;  // 0 <= position_angle < 90
-  unsigned long second_quadrant = 1 << 2;  // 90 <= position_angle < 180
-  unsigned long third_quadrant = 1 << 3;  // 180 <= position_angle < 270
-  unsigned long fourth_quadrant = 1 << 4;  // 270 <= position_angle < 360
-
-  int n_circle = 0;
-  int check = 100;
+  // Read in all of the circles first so that we can process them together.
+  Stomp::AngularVector circle_ang;
+  std::vector<double> circle_theta, circle_phi, circle_radius;
   while (!input_file.eof()) {
     double theta, phi, radius;
     input_file >> theta >> phi >> radius;
 
     if (!input_file.eof()) {
-      // Generate an AngularCoordinate based on our input position.
-      Stomp::AngularCoordinate ang(theta, phi, coord);
-
-      uint32_t idx = 0;
-
-      // Figure out the first bit of our bitmask by checking that the position
-      // is inside our map.
-      if (stomp_map->Contains(ang)) idx += inside_map;
-
-      // Now we assemble a Map for each of the quadrants and see if they are
-      // inside our reference Map.
-      {
-	Stomp::WedgeBound wedge_bound(ang, radius, 0.0, 90.0, coord);
-	Stomp::Map* wedge_map =
-	  new Stomp::Map(wedge_bound, 1.0, max_resolution);
-
-	if (stomp_map->Contains(*wedge_map)) idx += first_quadrant;
-
-	delete wedge_map;
-      }
-
-      {
-	Stomp::WedgeBound wedge_bound(ang, radius, 90.0, 180.0, coord);
-	Stomp::Map* wedge_map =
-	  new Stomp::Map(wedge_bound, 1.0, max_resolution);
-
-	if (stomp_map->Contains(*wedge_map)) idx += second_quadrant;
-
-	delete wedge_map;
-      }
-
-      {
-	Stomp::WedgeBound wedge_bound(ang, radius, 180.0, 270.0, coord);
-	Stomp::Map* wedge_map =
-	  new Stomp::Map(wedge_bound, 1.0, max_resolution);
-
-	if (stomp_map->Contains(*wedge_map)) idx += third_quadrant;
-
-	delete wedge_map;
-      }
-
-      {
-	Stomp::WedgeBound wedge_bound(ang, radius, 270.0, 360.0, coord);
-	Stomp::Map* wedge_map =
-	  new Stomp::Map(wedge_bound, 1.0, max_resolution);
-
-	if (stomp_map->Contains(*wedge_map)) idx += fourth_quadrant;
-
-	delete wedge_map;
-      }
-
-      n_circle++;
-      if (n_circle > 0 && n_circle % check == 0)
-	std::cout << "Processed " << n_circle << " objects...\n";
-
-      output_file << theta << " " << phi << " " << radius << " " << idx << "\n";
+      circle_ang.push_back(Stomp::AngularCoordinate(theta, phi, coord));
+      circle_theta.push_back(theta);
+      circle_phi.push_back(phi);
+      circle_radius.push_back(radius);
     }
   }
   input_file.close();
-  output_file.close();
+  std::cout << "Read " << circle_ang.size() << " circles.\n";
 
+  // Now we find the fraction of each circle and its quadrants inside our map.
+  uint32_t n_threads = Stomp::DefaultThreads();
+  if (FLAGS_n_threads > 0) n_threads = static_cast<uint32_t>(FLAGS_n_threads);
 
+  std::vector<double> unmasked_fraction, quadrant_fraction;
+  stomp_map->FindQuadrantFractions(circle_ang, circle_radius,
+				   unmasked_fraction, quadrant_fraction,
+				   coord, max_resolution, n_threads);
 
+  // Define our bit mask values
+  unsigned long inside_map = 1 << 0;
+  unsigned long first_quadrant = 1 << 1;  // 0 <= position_angle < 90
+  unsigned long second_quadrant = 1 << 2;  // 90 <= position_angle < 180
+  unsigned long third_quadrant = 1 << 3;  // 180 <= position_angle < 270
+  unsigned long fourth_quadrant = 1 << 4;  // 270 <= position_angle < 360
+  unsigned long quadrant_bits[4] = {first_quadrant, second_quadrant,
+				    third_quadrant, fourth_quadrant};
+
+  for (uint32_t i=0;i<circle_ang.size();i++) {
+    uint32_t idx = 0;
+
+    // Figure out the first bit of our bitmask by checking that the position
+    // is inside our map.
+    if (stomp_map->Contains(circle_ang[i])) idx += inside_map;
+
+    // The quadrant bits are set if the quadrant is wholly inside our map.
+    for (uint32_t q=0;q<4;q++)
+      if (Stomp::DoubleGE(quadrant_fraction[4*i + q], 1.0))
+	idx += quadrant_bits[q];
+
+    output_file << circle_theta[i] << " " << circle_phi[i] << " " <<
+      circle_radius[i] << " " << idx;
+    if (FLAGS_fractions) {
+      output_file << " " << unmasked_fraction[i];
+      for (uint32_t q=0;q<4;q++)
+	output_file << " " << quadrant_fraction[4*i + q];
+    }
+    output_file << "\n";
+  }
+  output_file.close();
 
   return 0;
 }
@@ -12,6 +12,8 @@ DEFINE_string(map_file, "",
               "Name of the ASCII file containing the StompMap geometry");
 DEFINE_string(galaxy_file, "",
               "Name of the ASCII file containing the input galaxy catalog");
+DEFINE_string(galaxy_format, "ascii",
+              "Format of the galaxy catalog: ascii, binary or fits");
 DEFINE_string(output_tag, "test",
               "Tag for output file: Wtheta_OUTPUT_TAG");
 DEFINE_double(theta_min, 0.001, "Minimum angular scale (in degrees)");
@@ -58,21 +60,54 @@ int main(int argc, char **argv) {
   // and MAGNITUDE is the apparent magnitude in a given filter.  We filter all
   // of the objects against the map, tossing out any objects that aren't in the
   // map.
+  //
+  // For large catalogs, the same columns (named LAMBDA, ETA and WEIGHT) can
+  // be read from a STOMP binary catalog or a FITS binary table instead, a
+  // chunk at a time.
   Stomp::WAngularVector galaxy;
-  std::ifstream galaxy_file(FLAGS_galaxy_file.c_str());
-  double lambda, eta, prob, mag;
   uint32_t n_galaxy = 0;
 
-  while (!galaxy_file.eof()) {
-    galaxy_file >> lambda >> eta >> prob >> mag;
-    Stomp::WeightedAngularCoordinate tmp_ang(lambda, eta, prob,
-					     Stomp::AngularCoordinate::Survey);
+  if (FLAGS_galaxy_format == "ascii") {
+    std::ifstream galaxy_file(FLAGS_galaxy_file.c_str());
+    double lambda, eta, prob, mag;
+
+    while (!galaxy_file.eof()) {
+      galaxy_file >> lambda >> eta >> prob >> mag;
+      Stomp::WeightedAngularCoordinate tmp_ang(lambda, eta, prob,
+					       Stomp::AngularCoordinate::Survey);
 
-    if (stomp_map->Contains(tmp_ang) && (tmp_ang.Weight() > 0.2))
-      galaxy.push_back(tmp_ang);
-    n_galaxy++;
+      if (stomp_map->Contains(tmp_ang) && (tmp_ang.Weight() > 0.2))
+	galaxy.push_back(tmp_ang);
+      n_galaxy++;
+    }
+    galaxy_file.close();
+  } else {
+    Stomp::CatalogReader* reader = NULL;
+    if (FLAGS_galaxy_format == "fits") {
+      reader = new Stomp::FitsCatalogReader();
+    } else {
+      reader = new Stomp::BinaryCatalogReader();
+    }
+    if (!reader->Open(FLAGS_galaxy_file) ||
+	!reader->SetCoordinateColumns("LAMBDA", "ETA",
+				      Stomp::AngularCoordinate::Survey) ||
+	!reader->SetWeightColumn("WEIGHT")) exit(1);
+
+    Stomp::PointCatalog catalog;
+    std::vector<uint8_t> keep;
+    while (reader->ReadChunk(catalog) > 0) {
+      n_galaxy += catalog.Size();
+      stomp_map->Contains(catalog, keep);
+      for (uint32_t i=0;i<catalog.Size();i++) {
+	if (keep[i] && (catalog.Weight(i) > 0.2)) {
+	  Stomp::WeightedAngularCoordinate tmp_ang;
+	  catalog.Point(i, tmp_ang);
+	  galaxy.push_back(tmp_ang);
+	}
+      }
+    }
+    delete reader;
   }
-  galaxy_file.close();
 
   std::cout << "Read " << n_galaxy << " galaxies from " << FLAGS_galaxy_file <<
     "; kept " << galaxy.size() << "\n";
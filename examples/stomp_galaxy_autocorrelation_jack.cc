@@ -29,6 +29,18 @@ DEFINE_bool(no_weight, false, "Map file is missing weight column.");
 DEFINE_bool(coordinates_only, false, "Galaxy files only contain coordinates.");
 DEFINE_int32(maximum_resolution, -1,
 	     "Maximum resolution to use for pixel-based estimator");
+DEFINE_string(work_unit_prefix, "",
+	      "Prefix for work unit files when splitting the pair counting.");
+DEFINE_int32(n_work_units, 0,
+	     "Split the pair counting into this many work units and exit.");
+DEFINE_int32(work_unit, -1,
+	     "Run this work unit (needs only the angular binning flags).");
+DEFINE_bool(merge_work_units, false,
+	    "Merge the finished work units and write the results.");
+DEFINE_string(instrumentation_report, "",
+	      "Write the library's counters and timers to this JSON file.");
+DEFINE_bool(auto_tune, false,
+	    "Time the estimators on a subsample to pick the resolution break.");
 
 int main(int argc, char **argv) {
   std::string usage = "Usage: ";
@@ -38,6 +50,52 @@ int main(int argc, char **argv) {
   google::SetUsageMessage(usage);
   google::ParseCommandLineFlags(&argc, &argv, true);
 
+  // The pair counting can be split into work units that run as separate
+  // jobs.  Running with --n_work_units=64 and --work_unit_prefix=wu (along
+  // with the usual map and galaxy inputs) writes the work units, which can
+  // then be run with something like
+  //
+  //   seq 0 63 | xargs -P 16 -I{} stomp_galaxy_autocorrelation_jack
+  //     --work_unit_prefix=wu --work_unit={}
+  //
+  // before running once more with --merge_work_units to get the result.
+  //
+  // Running or merging the work units only needs the angular binning, so we
+  // handle those cases before reading the map and galaxies.
+  if (!FLAGS_work_unit_prefix.empty() &&
+      ((FLAGS_work_unit >= 0) || FLAGS_merge_work_units)) {
+    Stomp::AngularCorrelation wtheta(FLAGS_theta_min, FLAGS_theta_max,
+				     FLAGS_n_bins_per_decade);
+    if (FLAGS_work_unit >= 0) {
+      if (!wtheta.RunPairWorkUnit(FLAGS_work_unit_prefix,
+				  static_cast<uint32_t>(FLAGS_work_unit))) {
+	std::cout << "Work unit " << FLAGS_work_unit << " failed.\n";
+	exit(2);
+      }
+      if (!FLAGS_instrumentation_report.empty())
+	Stomp::Instrumentation::WriteReport(FLAGS_instrumentation_report);
+      return 0;
+    }
+
+    if (!wtheta.MergePairWorkUnits(FLAGS_work_unit_prefix)) {
+      std::cout << "Failed to merge work units from " <<
+	FLAGS_work_unit_prefix << "\n";
+      exit(2);
+    }
+
+    std::string wtheta_file_name = "Wtheta_" + FLAGS_output_tag;
+    std::string covar_file_name = "CovarWtheta_" + FLAGS_output_tag;
+    std::cout << "Writing galaxy auto-correlation to " <<
+      wtheta_file_name << " and covariance matrix to " <<
+      covar_file_name << "\n";
+    if (!wtheta.Write(wtheta_file_name) ||
+	!wtheta.WriteCovariance(covar_file_name)) {
+      std::cout << "Failed to write results.\n";
+      exit(2);
+    }
+    return 0;
+  }
+
   if (FLAGS_map_file.empty()) {
     std::cout << usage << "\n";
     std::cout << "Type '" << argv[0] << " --help' for a list of options.\n";
@@ -120,16 +178,58 @@ int main(int argc, char **argv) {
   // less memory, provided we choose the break sensibly).  This call will
   // modify all of the high-resolution bins so that they use the pair-based
   // estimator.
-  if (FLAGS_maximum_resolution == -1) {
-    FLAGS_maximum_resolution = 512;
-    if (n_galaxy < 2000000) FLAGS_maximum_resolution = 128;
-    if ((n_galaxy > 2000000) && (n_galaxy < 10000000))
-      FLAGS_maximum_resolution = 256;
+  //
+  // Alternatively, we can have the library time both estimators on a
+  // subsample of the data and pick the break (along with the tree
+  // parameters for the pair-based estimator) once the regions are set up.
+  if (FLAGS_auto_tune) {
+    std::cout << "Auto-tuning the maximum resolution...\n";
+    wtheta.SetAutoTune();
+  } else {
+    if (FLAGS_maximum_resolution == -1) {
+      FLAGS_maximum_resolution = 512;
+      if (n_galaxy < 2000000) FLAGS_maximum_resolution = 128;
+      if ((n_galaxy > 2000000) && (n_galaxy < 10000000))
+	FLAGS_maximum_resolution = 256;
+    }
+
+    std::cout << "Setting maximum resolution to " <<
+      FLAGS_maximum_resolution << "...\n";
+    wtheta.SetMaxResolution(static_cast<uint32_t>(FLAGS_maximum_resolution));
   }
 
-  std::cout << "Setting maximum resolution to " <<
-    FLAGS_maximum_resolution << "...\n";
-  wtheta.SetMaxResolution(static_cast<uint32_t>(FLAGS_maximum_resolution));
+  // If we're splitting the pair counting into work units, we do the same
+  // set-up as FindAutoCorrelationWithRegions and the pixel-based bins here
+  // and write out the work units.
+  if (!FLAGS_work_unit_prefix.empty() && (FLAGS_n_work_units > 0)) {
+    uint16_t n_regions = static_cast<uint16_t>(FLAGS_n_jackknife);
+    if (n_regions == 0) n_regions = static_cast<uint16_t>(2*wtheta.NBins());
+    n_regions = stomp_map->InitializeRegions(n_regions);
+    wtheta.InitializeRegions(n_regions);
+    Stomp::PointCatalog galaxy_catalog(galaxy, false);
+    if (FLAGS_auto_tune)
+      wtheta.AutoTune(*stomp_map, galaxy_catalog,
+		      static_cast<uint8_t>(FLAGS_n_random));
+    uint32_t region_resolution = stomp_map->RegionResolution();
+    if (region_resolution > wtheta.MinResolution())
+      wtheta.SetMinResolution(region_resolution);
+
+    if (region_resolution > wtheta.MaxResolution()) {
+      wtheta.UseOnlyPairs();
+    } else {
+      wtheta.FindPixelAutoCorrelation(*stomp_map, galaxy);
+    }
+
+    uint32_t n_work_units = static_cast<uint32_t>(FLAGS_n_work_units);
+    if (!wtheta.WritePairAutoWorkUnits(*stomp_map, galaxy_catalog,
+				       FLAGS_work_unit_prefix, n_work_units,
+				       static_cast<uint8_t>(FLAGS_n_random))) {
+      std::cout << "Failed to write work units to " <<
+	FLAGS_work_unit_prefix << "\n";
+      exit(2);
+    }
+    return 0;
+  }
 
   // Now we use the regions version of the auto-correlation code to find our
   // result.
@@ -160,6 +260,20 @@ int main(int argc, char **argv) {
       covar_file_name << "\n";
   }
 
+  if (FLAGS_auto_tune) {
+    std::string tuning_file_name = "Tuning_" + FLAGS_output_tag;
+    std::cout << "Writing auto-tuning choices to " << tuning_file_name << "\n";
+    if (!wtheta.WriteTuning(tuning_file_name))
+      std::cout << "Failed to write tuning to " << tuning_file_name << "\n";
+  }
+
+  // The counters are only filled in if the library was configured with
+  // --enable-instrumentation; otherwise the report just says so.
+  if (!FLAGS_instrumentation_report.empty()) {
+    std::cout << "Writing instrumentation report to " <<
+      FLAGS_instrumentation_report << "\n";
+    Stomp::Instrumentation::WriteReport(FLAGS_instrumentation_report);
+  }
 
   return 0;
 }
@@ -3,6 +3,7 @@
 #include <string>
 #include <iostream>
 #include <sstream>
+#include <vector>
 #include <stomp.h>
 #include <gflags/gflags.h>
 
@@ -49,9 +50,8 @@ int main(int argc, char **argv) {
 				   int region_resolution);
   void AutoCorrelateGalaxies(Stomp::ScalarMap* galaxy_map,
 			     Stomp::AngularCorrelation& wtheta);
-  void CrossCorrelateSystematicsField(Stomp::ScalarMap* galaxy_map,
-				      SystematicsField sys_field,
-				      Stomp::AngularCorrelation& wtheta);
+  void CrossCorrelateSystematics(Stomp::ScalarMap* galaxy_map,
+				 Stomp::WThetaVector& xcorr);
 
   std::string usage = "Usage: ";
   usage += argv[0];
@@ -131,73 +131,36 @@ int main(int argc, char **argv) {
   }
 
 
-  // Galaxy-Seeing
-  if (FLAGS_galaxy_seeing) {
-    Stomp::AngularCorrelation xcorr_seeing(FLAGS_theta_min, FLAGS_theta_max,
-					   FLAGS_n_bins_per_decade);
-
-    CrossCorrelateSystematicsField(galaxy_map, Seeing,
-				   xcorr_seeing);
-
-    std::string output_file_name =
-      "MeanWthetaSys_gal-see_" + FLAGS_output_tag + output_suffix.str();
-    std::cout << "Writing results to " << output_file_name << "...\n";
-
-    std::ofstream output_file(output_file_name.c_str());
-    for (Stomp::ThetaIterator iter=xcorr_seeing.Begin();
-	 iter!=xcorr_seeing.End();++iter) {
-      if (iter->Resolution() != -1) {
-	output_file << std::setprecision(6) << iter->Theta() << " " <<
-	  iter->MeanWtheta()  << " " << iter->MeanWthetaError() << "\n";
-      }
-    }
-    output_file.close();
-  }
-
-  // Galaxy-Extinction
-  if (FLAGS_galaxy_extinction) {
-    Stomp::AngularCorrelation xcorr_extinction(FLAGS_theta_min, FLAGS_theta_max,
-					       FLAGS_n_bins_per_decade);
-
-    CrossCorrelateSystematicsField(galaxy_map, Extinction,
-				   xcorr_extinction);
-
-    std::string output_file_name =
-      "MeanWthetaSys_gal-ext_" + FLAGS_output_tag + output_suffix.str();
-    std::cout << "Writing results to " << output_file_name << "...\n";
-
-    std::ofstream output_file(output_file_name.c_str());
-    for (Stomp::ThetaIterator iter=xcorr_extinction.Begin();
-	 iter!=xcorr_extinction.End();++iter) {
-      if (iter->Resolution() != -1) {
-	output_file << std::setprecision(6) << iter->Theta() << " " <<
-	  iter->MeanWtheta()  << " " << iter->MeanWthetaError() << "\n";
-      }
-    }
-    output_file.close();
-  }
-
-  // Galaxy-Sky Brightness
-  if (FLAGS_galaxy_sky) {
-    Stomp::AngularCorrelation xcorr_sky(FLAGS_theta_min, FLAGS_theta_max,
-					   FLAGS_n_bins_per_decade);
-
-    CrossCorrelateSystematicsField(galaxy_map, Sky,
-				   xcorr_sky);
-
-    std::string output_file_name =
-      "MeanWthetaSys_gal-sky_" + FLAGS_output_tag + output_suffix.str();
-    std::cout << "Writing results to " << output_file_name << "...\n";
-
-    std::ofstream output_file(output_file_name.c_str());
-    for (Stomp::ThetaIterator iter=xcorr_sky.Begin();
-	 iter!=xcorr_sky.End();++iter) {
-      if (iter->Resolution() != -1) {
-	output_file << std::setprecision(6) << iter->Theta() << " " <<
-	  iter->MeanWtheta()  << " " << iter->MeanWthetaError() << "\n";
+  // The systematics cross-correlations are all done in a single pass, with
+  // seeing, extinction and sky brightness as channels of one MultiScalarMap;
+  // xcorr[Seeing], xcorr[Extinction] and xcorr[Sky] hold the results.
+  if (FLAGS_galaxy_seeing || FLAGS_galaxy_extinction || FLAGS_galaxy_sky) {
+    Stomp::WThetaVector xcorr(3, Stomp::AngularCorrelation(
+      FLAGS_theta_min, FLAGS_theta_max, FLAGS_n_bins_per_decade));
+
+    CrossCorrelateSystematics(galaxy_map, xcorr);
+
+    const char* field_tag[3] = {"see", "ext", "sky"};
+    bool field_requested[3] = {FLAGS_galaxy_seeing, FLAGS_galaxy_extinction,
+			       FLAGS_galaxy_sky};
+    for (int field=Seeing;field<=Sky;field++) {
+      if (!field_requested[field]) continue;
+
+      std::string output_file_name =
+	"MeanWthetaSys_gal-" + std::string(field_tag[field]) + "_" +
+	FLAGS_output_tag + output_suffix.str();
+      std::cout << "Writing results to " << output_file_name << "...\n";
+
+      std::ofstream output_file(output_file_name.c_str());
+      for (Stomp::ThetaIterator iter=xcorr[field].Begin();
+	   iter!=xcorr[field].End();++iter) {
+	if (iter->Resolution() != -1) {
+	  output_file << std::setprecision(6) << iter->Theta() << " " <<
+	    iter->MeanWtheta()  << " " << iter->MeanWthetaError() << "\n";
+	}
       }
+      output_file.close();
     }
-    output_file.close();
   }
 
   std::cout << "Done.\n";
@@ -327,38 +290,25 @@ void AutoCorrelateGalaxies(Stomp::ScalarMap* galaxy_map,
   }
 }
 
-void CrossCorrelateSystematicsField(Stomp::ScalarMap* galaxy_map,
-				    SystematicsField sys_field,
-				    Stomp::AngularCorrelation& wtheta) {
-  for (Stomp::ThetaIterator iter=wtheta.Begin();
-       iter!=wtheta.End();++iter) iter->InitializeRegions(FLAGS_n_jack);
+void CrossCorrelateSystematics(Stomp::ScalarMap* galaxy_map,
+			       Stomp::WThetaVector& xcorr) {
+  for (Stomp::WThetaIterator wtheta_iter=xcorr.begin();
+       wtheta_iter!=xcorr.end();++wtheta_iter) {
+    for (Stomp::ThetaIterator iter=wtheta_iter->Begin();
+	 iter!=wtheta_iter->End();++iter) iter->InitializeRegions(FLAGS_n_jack);
 
-  wtheta.SetMinResolution(galaxy_map->RegionResolution());
-  wtheta.SetMaxResolution(galaxy_map->Resolution());
+    wtheta_iter->SetMinResolution(galaxy_map->RegionResolution());
+    wtheta_iter->SetMaxResolution(galaxy_map->Resolution());
+  }
 
-  //Scan through the systematics file again and load up the appropriate values.
-  Stomp::ScalarVector sys_pix;
+  // Scan through the systematics file again and load up all three fields.
+  std::cout << "Reading in systematics values from " <<
+    FLAGS_sysmap_file << "...\n";
+  Stomp::PixelVector sys_pix;
+  std::vector<double> sys_values;
   std::ifstream sysmap_file(FLAGS_sysmap_file.c_str());
   double unmasked, seeing, extinction, sky;
-  unsigned long hpixnum, superpixnum;
-  unsigned int resolution, n_objects;
-
-  switch (sys_field) {
-  case Seeing:
-    std::cout << "Reading in seeing values from " <<
-      FLAGS_sysmap_file << "...\n";
-    break;
-  case Extinction:
-    std::cout << "Reading in extinction values from " <<
-      FLAGS_sysmap_file << "...\n";
-    break;
-  case Sky:
-    std::cout << "Reading in sky brightness values from " <<
-      FLAGS_sysmap_file << "...\n";
-    break;
-  }
-
-  // Parse the systematics file and pull out the requested field
+  uint32_t x, y, hpixnum, superpixnum, resolution, n_objects;
   while (!sysmap_file.eof()) {
     sysmap_file >> hpixnum >> superpixnum >> resolution >> unmasked >>
       seeing >> extinction >> sky >> n_objects;
@@ -371,65 +321,56 @@ void CrossCorrelateSystematicsField(Stomp::ScalarMap* galaxy_map,
 	  (sky >= FLAGS_sky_min) &&
 	  (sky <= FLAGS_sky_max) &&
 	  (n_objects > 0)) {
-	Stomp::ScalarPixel pix(resolution, hpixnum, superpixnum,
-			       unmasked, 0.0);
-	switch (sys_field) {
-	case Seeing:
-	  pix.SetIntensity(seeing);
-	  break;
-	case Extinction:
-	  pix.SetIntensity(extinction);
-	  break;
-	case Sky:
-	  pix.SetIntensity(sky);
-	  break;
-	}
-	sys_pix.push_back(pix);
+	Stomp::Pixel::HPix2XY(resolution, hpixnum, superpixnum, x, y);
+	sys_pix.push_back(Stomp::Pixel(x, y, resolution, unmasked));
+	sys_values.push_back(seeing);
+	sys_values.push_back(extinction);
+	sys_values.push_back(sky);
       }
     }
   }
   sysmap_file.close();
 
-  // Set up our systematics ScalarMap
-  Stomp::ScalarMap* sys_map =
-    new Stomp::ScalarMap(sys_pix, Stomp::ScalarMap::ScalarField);
+  // Set up our systematics map, using the same regions as the galaxy map.
+  Stomp::MultiScalarMap* sys_map =
+    new Stomp::MultiScalarMap(sys_pix, 3, Stomp::ScalarMap::ScalarField);
+  for (uint32_t i=0;i<sys_pix.size();i++) {
+    for (uint32_t k=0;k<3;k++)
+      sys_map->SetIntensity(sys_pix[i], k, sys_values[3*i + k]);
+  }
   sys_pix.clear();
-  sys_map->InitializeRegions(FLAGS_n_jack, galaxy_map->RegionResolution());
+  sys_values.clear();
+  sys_map->InitializeRegions(*galaxy_map);
 
-  // Now we do the requested cross-correlation.
+  Stomp::MultiScalarMap* galaxy_multi_map =
+    new Stomp::MultiScalarMap(*galaxy_map);
+  galaxy_multi_map->InitializeRegions(*galaxy_map);
+
+  // Now we do the cross-correlations.
   int max_resolution = galaxy_map->Resolution();
-  int min_resolution = wtheta.MinResolution();
+  int min_resolution = xcorr[0].MinResolution();
 
-  switch (sys_field) {
-  case Seeing:
-    std::cout << "Cross-correlating galaxies with seeing...\n";
-    break;
-  case Extinction:
-    std::cout << "Cross-correlating galaxies with extinction...\n";
-    break;
-  case Sky:
-    std::cout << "Cross-correlating galaxies with sky brightness...\n";
-    break;
-  }
-  for (Stomp::ThetaIterator iter=wtheta.Begin(max_resolution);
-       iter!=wtheta.End(max_resolution);++iter) {
-    galaxy_map->CrossCorrelateWithRegions(*sys_map, iter);
-  }
+  std::cout << "Cross-correlating galaxies with seeing, extinction and " <<
+    "sky brightness...\n";
+  galaxy_multi_map->CrossCorrelateWithRegions(*sys_map, xcorr);
 
   for (int resolution=max_resolution/2;
        resolution>=min_resolution;resolution/=2) {
-    Stomp::ScalarMap* galaxy_sub_map =
-      new Stomp::ScalarMap(*galaxy_map, resolution);
+    Stomp::MultiScalarMap* galaxy_sub_map =
+      new Stomp::MultiScalarMap(*galaxy_multi_map, resolution);
     galaxy_sub_map->InitializeRegions(*galaxy_map);
 
-    Stomp::ScalarMap* sys_sub_map = new Stomp::ScalarMap(*sys_map, resolution);
-    sys_sub_map->InitializeRegions(*sys_map);
-    for (Stomp::ThetaIterator iter=wtheta.Begin(resolution);
-	 iter!=wtheta.End(resolution);++iter) {
-      galaxy_sub_map->CrossCorrelateWithRegions(*sys_sub_map, iter);
-    }
+    Stomp::MultiScalarMap* sys_sub_map =
+      new Stomp::MultiScalarMap(*sys_map, resolution);
+    sys_sub_map->InitializeRegions(*galaxy_map);
+
+    if (xcorr[0].Begin(resolution) != xcorr[0].End(resolution))
+      galaxy_sub_map->CrossCorrelateWithRegions(*sys_sub_map, xcorr);
+
     delete sys_sub_map;
     delete galaxy_sub_map;
   }
-}
 
+  delete galaxy_multi_map;
+  delete sys_map;
+}
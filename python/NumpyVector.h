@@ -189,6 +189,14 @@ template <class T> class NumpyVector {
             return mStride;
         }
 
+        // Stride-aware element access through the cached data pointer.  This
+        // makes no calls into the python or numpy API, so it is safe to use
+        // from worker threads while the GIL is released.  No bounds checking
+        // is done.
+        T& at(npy_intp index) {
+            return *(T* ) (mData + index*mStride);
+        }
+
 	
 	private:
 
@@ -205,6 +213,7 @@ template <class T> class NumpyVector {
         npy_intp mStride;
 
 		PyObject* mArray;
+		char* mData;
 
 		static std::map<const char*,int> mNumpyIdMap;
 };
@@ -217,12 +226,15 @@ std::map<const char*,int> NumpyVector<T>::mNumpyIdMap;
 template <class T>
 NumpyVector<T>::NumpyVector()  throw (const char *) {
 	// DONT FORGET THIS!!!!
-	import_array();
+	// (import_array() itself returns a value, which we can't do from a
+	// constructor)
+	if (_import_array() < 0) throw "Could not import numpy";
 
     init_type_info();
 
 	// don't forget to initialize
 	mArray = NULL;
+	mData = NULL;
 	mSize=0;
     mNdim=0;
     mStride=0;
@@ -235,12 +247,15 @@ NumpyVector<T>::NumpyVector()  throw (const char *) {
 template <class T>
 NumpyVector<T>::NumpyVector(PyObject* obj)  throw (const char *) {
 	// DONT FORGET THIS!!!!
-	import_array();
+	// (import_array() itself returns a value, which we can't do from a
+	// constructor)
+	if (_import_array() < 0) throw "Could not import numpy";
 
     init_type_info();
 
 	// don't forget to initialize
 	mArray = NULL;
+	mData = NULL;
 	mSize=0;
     mNdim=0;
     mStride=0;
@@ -257,12 +272,15 @@ NumpyVector<T>::NumpyVector(PyObject* obj)  throw (const char *) {
 template <class T>
 NumpyVector<T>::NumpyVector(npy_intp size) throw (const char *) {
 	// DONT FORGET THIS!!!!
-	import_array();
+	// (import_array() itself returns a value, which we can't do from a
+	// constructor)
+	if (_import_array() < 0) throw "Could not import numpy";
 
     init_type_info();
 
 	// don't forget to initialize
 	mArray = NULL;
+	mData = NULL;
 	mSize=0;
     mNdim=0;
     mStride=0;
@@ -361,6 +379,7 @@ void NumpyVector<T>::init(PyObject* obj)  throw (const char *) {
     } else {
         mStride = PyArray_STRIDE(mArray, 0);
     }
+    mData = (char* ) PyArray_DATA(mArray);
 
 }
 
@@ -391,6 +410,7 @@ void NumpyVector<T>::init(npy_intp size)  throw (const char *) {
     // dimensions and stride
     mNdim = ndim;
     mStride = PyArray_STRIDE(mArray, 0);
+    mData = (char* ) PyArray_DATA(mArray);
 
 }
 
@@ -8,7 +8,7 @@ swig_addflags='-DWITH_PYTHON3'
 # also try to add numpy support
 try:
     import numpy
-    swig_addflags += ' -DWITH_NUMPY3'
+    swig_addflags += ' -DWITH_NUMPY'
 except:
     sys.stdout.write("Numpy not found, not building with numpy support\n")
 
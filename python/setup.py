@@ -22,7 +22,7 @@ else:
 try:
     import numpy
     include_dirs=[numpy.get_include()]
-    addflags='-DWITH_NUMPY3'
+    addflags='-DWITH_NUMPY'
     os.environ['CPPFLAGS'] +=  ' ' +addflags
     depends=['NumpyVector.h']
 except:
@@ -75,7 +75,15 @@ stomp_module = Extension("_stomp",
                                   "../stomp/stomp_itree_map.cc",
                                   "../stomp/stomp_geometry.cc",
                                   "../stomp/stomp_util.cc",
+                                  "../stomp/stomp_point_catalog.cc",
+                                  "../stomp/stomp_catalog_reader.cc",
+                                  "../stomp/stomp_bound_index.cc",
+                                  "../stomp/stomp_multi_scalar_map.cc",
+                                  "../stomp/stomp_instrumentation.cc",
                                   "stomp_wrap.cxx"],
+                         # the library and the numpy methods use std::thread
+                         extra_compile_args=['-std=c++0x', '-pthread'],
+                         extra_link_args=['-pthread'],
                          )
 
 setup (name = "stomp",
@@ -4,6 +4,8 @@
 #include "../stomp/stomp_angular_bin.h"
 #include "../stomp/stomp_radial_bin.h"
 #include "../stomp/stomp_angular_coordinate.h"
+#include "../stomp/stomp_point_catalog.h"
+#include "../stomp/stomp_catalog_reader.h"
 #include "../stomp/stomp_angular_correlation.h"
 #include "../stomp/stomp_radial_correlation.h"
 #include "../stomp/stomp_pixel.h"
@@ -16,6 +18,9 @@
 #include "../stomp/stomp_tree_map.h"
 #include "../stomp/stomp_itree_map.h"
 #include "../stomp/stomp_geometry.h"
+#include "../stomp/stomp_bound_index.h"
+#include "../stomp/stomp_multi_scalar_map.h"
+#include "../stomp/stomp_instrumentation.h"
 #include "../stomp/stomp_util.h"
 %}
 
@@ -122,7 +127,10 @@ typedef IndexVector::iterator IndexIterator;
 %include "../stomp/stomp_map.h"
 %include "../stomp/stomp_scalar_map.h"
 %include "../stomp/stomp_geometry.h"
+%include "../stomp/stomp_bound_index.h"
+%include "../stomp/stomp_multi_scalar_map.h"
 %include "../stomp/stomp_util.h"
+%include "../stomp/stomp_instrumentation.h"
 
 namespace Stomp {
 
@@ -713,6 +721,20 @@ class TreeMap : public BaseMap {
   uint32_t FindPairs(AngularCoordinate& ang, double theta_max);
   void FindPairs(AngularVector& ang, AngularBin& theta);
   void FindPairs(AngularVector& ang, AngularCorrelation& wtheta);
+  void FindPairs(PointCatalog& catalog, AngularBin& theta);
+  void FindPairs(PointCatalog& catalog, AngularCorrelation& wtheta);
+#ifdef WITH_NUMPY
+  PyObject* FindPairs(PyObject* x1obj, PyObject* x2obj,
+		      const std::string& system,
+		      double theta_min, double theta_max,
+		      uint32_t n_threads = DefaultThreads())
+    throw (const char* );
+  PyObject* FindWeightedPairs(PyObject* x1obj, PyObject* x2obj,
+			      const std::string& system,
+			      double theta_min, double theta_max,
+			      uint32_t n_threads = DefaultThreads())
+    throw (const char* );
+#endif
   double FindWeightedPairs(AngularCoordinate& ang, AngularBin& theta);
   double FindWeightedPairs(AngularCoordinate& ang,
 			   double theta_min, double theta_max);
@@ -728,6 +750,8 @@ class TreeMap : public BaseMap {
   void FindWeightedPairs(WAngularVector& w_ang, AngularBin& theta);
   void FindWeightedPairs(WAngularVector& w_ang,
 			 AngularCorrelation& wtheta);
+  void FindWeightedPairs(PointCatalog& catalog, AngularBin& theta);
+  void FindWeightedPairs(PointCatalog& catalog, AngularCorrelation& wtheta);
   double FindWeightedPairs(AngularCoordinate& ang, AngularBin& theta,
 			   const std::string& field_name);
   double FindWeightedPairs(AngularCoordinate& ang,
@@ -805,6 +829,14 @@ class TreeMap : public BaseMap {
 		    WeightedAngularCoordinate& match_ang);
   bool AddPoint(WeightedAngularCoordinate& w_ang);
   bool AddPoint(AngularCoordinate& ang, double object_weight = 1.0);
+  uint32_t AddPoint(PointCatalog& catalog,
+		    uint32_t n_threads = DefaultThreads());
+#ifdef WITH_NUMPY
+  PyObject* AddPoint(PyObject* x1obj, PyObject* x2obj,
+		     const std::string& system, PyObject* weightobj = NULL,
+		     uint32_t n_threads = DefaultThreads())
+    throw (const char* );
+#endif
   bool Read(const std::string& input_file,
 	    AngularCoordinate::Sphere sphere = AngularCoordinate::Equatorial,
 	    bool verbose = false, uint8_t theta_column = 0,
@@ -813,6 +845,8 @@ class TreeMap : public BaseMap {
 	    AngularCoordinate::Sphere sphere = AngularCoordinate::Equatorial,
 	    bool verbose = false, uint8_t theta_column = 0,
 	    uint8_t phi_column = 1, int8_t weight_column = -1);
+  bool Read(CatalogReader& reader, bool verbose = false,
+	    uint32_t chunk_rows = 0);
   virtual void Coverage(PixelVector& superpix,
 			uint32_t resolution = HPixResolution);
   bool Covering(Map& stomp_map, uint32_t maximum_pixels);
@@ -923,6 +957,9 @@ class IndexedTreeMap : public BaseMap {
 
 } // end namespace Stomp
 
+%include "../stomp/stomp_point_catalog.h"
+%include "../stomp/stomp_catalog_reader.h"
+
 %template(AngularVector) std::vector<Stomp::AngularCoordinate>;
 %template(ThetaVector) std::vector<Stomp::AngularBin>;
 %template(RadialVector) std::vector<Stomp::RadialBin>;
@@ -935,6 +972,8 @@ class IndexedTreeMap : public BaseMap {
 %template(FieldColumnDict) std::map<std::string, uint8_t>;
 %template(DoubleVector) std::vector<double>;
 %template(IndexVector) std::vector<uint32_t>;
+%template(FlagVector) std::vector<uint8_t>;
+%template(BoundVector) std::vector<Stomp::GeometricBound*>;
 
 SETUP_GENERATOR(std::vector<Stomp::AngularBin>::const_iterator)
 ADD_GENERATOR(Stomp::AngularCorrelation, Bins,
@@ -0,0 +1,100 @@
+#!/usr/bin/env python
+
+# Unit testing module for STOMP numpy methods
+# Copyright (c) 2010, Ryan Scranton
+#
+# All rights reserved.
+
+"""
+STOMP is a set of libraries for doing astrostatistical analysis on the
+celestial sphere.  The goal is to enable descriptions of arbitrary regions
+on the sky which may or may not encode futher spatial information (galaxy
+density, CMB temperature, observational depth, etc.) and to do so in such
+a way as to make the analysis of that data as algorithmically efficient as
+possible.
+
+This module tests the numpy array methods of the map classes.  These run
+with the GIL released over several threads, so the main thing to check is
+that the results don't depend on the number of threads.
+"""
+
+__author__ = "Ryan Scranton (ryan.scranton@gmail.com)"
+__copyright__ = "Copyright 2010, Ryan Scranton"
+__license__ = "BSD"
+__version__ = "1.0"
+
+import stomp
+import numpy
+import unittest
+
+class TestStompNumpy(unittest.TestCase):
+
+    """
+    Unit testing class for the numpy methods of the STOMP map classes.
+    """
+
+    def setUp(self):
+        center = stomp.AngularCoordinate(20.0, 30.0,
+                                         stomp.AngularCoordinate.Equatorial)
+        circle = stomp.CircleBound(center, 5.0)
+        self.stomp_map = stomp.Map(circle, 1.0, 256)
+        self.stomp_map.InitializeRegions(10)
+        self.ra, self.dec = self.stomp_map.GenerateRandomEq(10000, False, 7, 1)
+
+    def testGenerateRandom(self):
+        """Test that seeded random points don't depend on the threads."""
+        ra, dec = self.stomp_map.GenerateRandomEq(10000, False, 7, 4)
+        self.assertTrue(numpy.all(ra == self.ra))
+        self.assertTrue(numpy.all(dec == self.dec))
+
+        lam1, eta1 = self.stomp_map.GenerateRandomQuadrantPointsSurvey(
+            10.0, 20.0, 1.0, 10000, 2, 5, 1)
+        lam4, eta4 = self.stomp_map.GenerateRandomQuadrantPointsSurvey(
+            10.0, 20.0, 1.0, 10000, 2, 5, 4)
+        self.assertTrue(numpy.all(lam1 == lam4))
+        self.assertTrue(numpy.all(eta1 == eta4))
+
+    def testContains(self):
+        """Test Map.Contains and FindRegion on arrays."""
+        flags = self.stomp_map.Contains(self.ra, self.dec, "eq", None, 4)
+        self.assertTrue(numpy.all(flags & stomp.Map.INSIDE_MAP))
+
+        quad1 = self.stomp_map.Contains(self.ra, self.dec, "eq", 0.5, 1)
+        quad4 = self.stomp_map.Contains(self.ra, self.dec, "eq", 0.5, 4)
+        self.assertTrue(numpy.all(quad1 == quad4))
+
+        region1 = self.stomp_map.FindRegion(self.ra, self.dec, "eq", 1)
+        region4 = self.stomp_map.FindRegion(self.ra, self.dec, "eq", 4)
+        self.assertTrue(numpy.all(region1 == region4))
+        self.assertTrue(numpy.all(region1 >= 0))
+
+    def testScalarMap(self):
+        """Test ScalarMap.AddToMap on arrays."""
+        scalar_map = stomp.ScalarMap(self.stomp_map, 64,
+                                     stomp.ScalarMap.DensityField)
+        added = scalar_map.AddToMap(self.ra, self.dec, "eq", 2.0, 4)
+        self.assertEqual(added.sum(), 10000)
+        self.assertEqual(scalar_map.NPoints(), 10000)
+        self.assertAlmostEqual(scalar_map.Intensity(), 20000.0)
+
+    def testTreeMap(self):
+        """Test TreeMap.AddPoint and pair counting on arrays."""
+        tree_map1 = stomp.TreeMap(256, 50)
+        tree_map4 = stomp.TreeMap(256, 50)
+        tree_map1.AddPoint(self.ra, self.dec, "eq", None, 1)
+        tree_map4.AddPoint(self.ra, self.dec, "eq", None, 4)
+        self.assertEqual(tree_map4.NPoints(), 10000)
+        self.assertEqual(tree_map1.Nodes(), tree_map4.Nodes())
+
+        pairs1 = tree_map1.FindPairs(self.ra, self.dec, "eq", 0.01, 0.1, 1)
+        pairs4 = tree_map4.FindPairs(self.ra, self.dec, "eq", 0.01, 0.1, 4)
+        self.assertTrue(numpy.all(pairs1 == pairs4))
+
+        weighted = tree_map4.FindWeightedPairs(self.ra, self.dec, "eq",
+                                               0.01, 0.1, 4)
+        self.assertAlmostEqual(weighted.sum(), pairs4.sum())
+
+
+if __name__ == '__main__':
+    suite = unittest.TestLoader().loadTestsFromTestCase(TestStompNumpy)
+    unittest.TextTestRunner(verbosity=2).run(suite)
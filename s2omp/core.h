@@ -16,11 +16,13 @@
 #define CORE_H_
 
 #include <algorithm>
+#include <atomic>
 #include <ctime>
 #include <math.h>
 #include <stdint.h>
 #include <random>
 #include <set>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -141,6 +143,50 @@ inline uint64 random_uint64(uint64 max_value) {
   return static_cast<uint64>(max_value * UNIFORM_DOUBLE(MT_GENERATOR));
 }
 
+// Several of the bulk construction methods can split their work across
+// threads.  Unless told otherwise, they use one thread per hardware core.
+inline int default_n_threads() {
+  int n_threads = std::thread::hardware_concurrency();
+  return n_threads > 0 ? n_threads : 1;
+}
+
+// Call task(k) for every k in [0, n_tasks) using up to n_threads threads.
+// Tasks are handed out one at a time from a shared counter, so tasks of uneven
+// cost balance themselves across the threads.  The calling thread does its
+// share of the work, so n_threads = 1 runs everything serially in order.
+template <typename Function>
+void parallel_for(long n_tasks, int n_threads, Function task) {
+  if (n_tasks <= 0) {
+    return;
+  }
+  if (n_threads > n_tasks) {
+    n_threads = n_tasks;
+  }
+  if (n_threads <= 1) {
+    for (long k = 0; k < n_tasks; k++) {
+      task(k);
+    }
+    return;
+  }
+
+  std::atomic<long> next_task(0);
+  auto worker = [&]() {
+    for (long k = next_task++; k < n_tasks; k = next_task++) {
+      task(k);
+    }
+  };
+
+  std::vector<std::thread> threads;
+  threads.reserve(n_threads - 1);
+  for (int k = 1; k < n_threads; k++) {
+    threads.push_back(std::thread(worker));
+  }
+  worker();
+  for (int k = 0; k < threads.size(); k++) {
+    threads[k].join();
+  }
+}
+
 } // end namespace s2omp
 
 #endif /* CORE_H_ */
@@ -14,6 +14,7 @@
 using __gnu_cxx::hash_set;
 
 #include "bound_interface.h"
+#include "circle_bound.h"
 #include "coverer.h"
 #include "pixel.h"
 #include "point.h"
@@ -23,11 +24,15 @@ namespace s2omp {
 coverer::coverer() {
   min_level_ = 0;
   max_level_ = MAX_LEVEL;
+  n_threads_ = 1;
+  memoize_ = false;
 }
 
 coverer::coverer(int min_level, int max_level) {
   min_level_ = min_level;
   max_level_ = max_level;
+  n_threads_ = 1;
+  memoize_ = false;
 }
 
 coverer::~coverer() {
@@ -85,13 +90,32 @@ bool coverer::generate_covering(
   // Need something here to test if initial_candidates is empty and if so start
   // with the face pixels and test may_intersect
 
+  // A plain interior covering doesn't need the priority queue at all, since
+  // the subtrees below each candidate can be resolved independently.  If
+  // we have threads to spare, we take advantage of that.
+  if (interior && fraction <= 0.0 && n_threads_ > 1) {
+    parallel_interior_covering(bound, initial_candidates, pixels);
+    return !pixels->empty();
+  }
+
   // We score these initial pixels and store them in the the priority queue
-  // based on score from low to high (low being the best score).
-  for (pixel_iterator iter = initial_candidates.begin(); iter
-      != initial_candidates.end(); ++iter) {
-    new_candidate(bound, *iter);
+  // based on score from low to high (low being the best score).  Scoring is
+  // independent for each pixel, so we can spread it over our threads.
+  long n_initial = initial_candidates.size();
+  std::vector<pixel_candidate> candidates(n_initial);
+  std::vector<int> scores(n_initial);
+  std::vector<score_map> new_scores(n_initial);
+  parallel_for(n_initial, n_threads_, [&](long k) {
+    candidates[k].pix = initial_candidates[k];
+    scores[k] = score_pixel(bound, &candidates[k], &new_scores[k]);
+  });
+  for (long k = 0; k < n_initial; k++) {
+    if (memoize_) {
+      score_cache_.insert(new_scores[k].begin(), new_scores[k].end());
+    }
+    pix_q_.push(pixel_entry(scores[k], candidates[k]));
     if (!interior && fraction > 0.0)
-      covered_area += iter->exact_area();
+      covered_area += initial_candidates[k].exact_area();
   }
 
   // If we have already reached our convergence criteria for a non-interior
@@ -183,9 +207,12 @@ bool coverer::generate_covering(
             candidate.n_children >= max_pixels) {
           pixels->push_back(candidate.pix);
         } else {
+          // The children that may intersect the bound were already found
+          // when we scored this candidate.
+          int k = 0;
           for (pixel child = candidate.pix.child_begin();
-               child != candidate.pix.child_end(); child = child.next()) {
-            if (bound.may_intersect(child)) {
+               child != candidate.pix.child_end(); child = child.next(), k++) {
+            if (candidate.child_flags & (1 << k)) {
               new_candidate(bound, child);
               if (fraction > 0.0)
                 covered_area += child.exact_area();
@@ -207,9 +234,10 @@ bool coverer::generate_covering(
 
         // If we can't add this pixel, we resolve it's children and add them to
         // the queue.
+        int k = 0;
         for (pixel child = candidate.pix.child_begin(); child
-                 != candidate.pix.child_end(); child = child.next()) {
-          if (bound.may_intersect(child)) {
+                 != candidate.pix.child_end(); child = child.next(), k++) {
+          if (candidate.child_flags & (1 << k)) {
             new_candidate(bound, child);
           }
         }
@@ -234,6 +262,60 @@ bool coverer::generate_covering(
       double_le(fabs(bound_area - covered_area)/bound_area, fraction);
 }
 
+bool coverer::get_size_coverings(long max_pixels,
+    const circle_ptr_vector& bounds, covering_vector* coverings) {
+  coverings->clear();
+  coverings->resize(bounds.size());
+
+  // Each thread works with its own single-threaded coverer, so the bounds
+  // never share a priority queue or score cache.
+  std::vector<char> success(bounds.size(), 0);
+  parallel_for(bounds.size(), n_threads_, [&](long k) {
+    coverer cover(min_level_, max_level_);
+    success[k] = cover.get_size_covering(max_pixels, *bounds[k],
+        &(*coverings)[k]);
+  });
+
+  return std::find(success.begin(), success.end(), 0) == success.end();
+}
+
+bool coverer::get_interior_coverings(const circle_ptr_vector& bounds,
+    covering_vector* coverings) {
+  coverings->clear();
+  coverings->resize(bounds.size());
+
+  std::vector<char> success(bounds.size(), 0);
+  parallel_for(bounds.size(), n_threads_, [&](long k) {
+    coverer cover(min_level_, max_level_);
+    success[k] = cover.get_interior_covering(*bounds[k], &(*coverings)[k]);
+  });
+
+  return std::find(success.begin(), success.end(), 0) == success.end();
+}
+
+bool coverer::get_size_coverings(const std::vector<long>& max_pixels,
+    const bound_interface& bound, covering_vector* coverings) {
+  coverings->clear();
+  coverings->resize(max_pixels.size());
+
+  // The child scores don't depend on max_pixels, so each covering after the
+  // first re-uses everything scored by the ones before it.  We start and end
+  // with an empty cache so that nothing scored here outlives the bound.
+  score_cache_.clear();
+  memoize_ = true;
+  bool success = true;
+  for (long k = 0; k < max_pixels.size(); k++) {
+    if (!generate_covering(bound, max_pixels[k], false, -1.0,
+        &(*coverings)[k])) {
+      success = false;
+    }
+  }
+  memoize_ = false;
+  score_cache_.clear();
+
+  return success;
+}
+
 void coverer::get_simple_covering(
     const bound_interface& bound, int level, pixel_vector* pixels) {
   // Clear the input pixel vector.
@@ -336,6 +418,10 @@ bool coverer::set_min_max_level(int min, int max) {
   return true;
 }
 
+void coverer::set_n_threads(int n_threads) {
+  n_threads_ = n_threads > 0 ? n_threads : 1;
+}
+
 void coverer::set_levels_from_area(double area_deg2) {
   int level = pixel::get_level_from_area(area_deg2);
   min_level_ = max(0, level - 3);
@@ -370,8 +456,6 @@ void coverer::new_candidate(const bound_interface& bound,
   // Create the pixel_candidate object and initialize default values.
   pixel_candidate pix_cand;
   pix_cand.pix = pix;
-  pix_cand.n_children = 0;
-  pix_cand.is_terminal = false;
 
   // We use score pixel in a two fold sense. First it tells us where to place
   // this candidate in the priority queue. Second, it computes both the total
@@ -383,26 +467,66 @@ void coverer::new_candidate(const bound_interface& bound,
   pix_q_.push(pixel_entry(score, pix_cand));
 }
 
+uint8_t coverer::child_flags(const bound_interface& bound, const pixel& pix,
+    score_map* new_scores) {
+  // If we've already tested this pixel against the bound, re-use the result.
+  // The cache is only ever read here, so threads scoring pixels in parallel
+  // can share it as long as they keep their new results in new_scores.
+  if (memoize_) {
+    score_map::const_iterator iter = score_cache_.find(pix.id());
+    if (iter != score_cache_.end()) {
+      return iter->second;
+    }
+  }
+
+  // We can skip the containment test for children at max_level_, since
+  // they're terminal regardless.  The cache never outlives a single call, so
+  // the level range is the same for every covering that reads it.
+  uint8_t flags = 0;
+  int k = 0;
+  for (pixel child = pix.child_begin(); child != pix.child_end();
+       child = child.next(), k++) {
+    if (bound.may_intersect(child)) {
+      flags |= 1 << k;
+      if (child.level() + 1 <= max_level_ && bound.contains(child)) {
+        flags |= 1 << (k + 4);
+      }
+    }
+  }
+
+  if (memoize_) {
+    (*new_scores)[pix.id()] = flags;
+  }
+
+  return flags;
+}
+
 int coverer::score_pixel(const bound_interface& bound,
     pixel_candidate* pix_cand) {
+  return score_pixel(bound, pix_cand, &score_cache_);
+}
+
+int coverer::score_pixel(const bound_interface& bound,
+    pixel_candidate* pix_cand, score_map* new_scores) {
 
   // We want to sort the pixels in our priority queue first by their size,
   // next by the number of children that may_intersect the bound, and then
   // by the number of children that are terminal (for non-interior coverings
   /// this means child.level() == max_level or bound.contains(child))
+  uint8_t flags = child_flags(bound, pix_cand->pix, new_scores);
   int n_children = 0, n_terminals = 0;
-  for (pixel child = pix_cand->pix.child_begin();
-       child != pix_cand->pix.child_end(); child = child.next()) {
-    if (bound.may_intersect(child)) {
+  for (int k = 0; k < 4; k++) {
+    if (flags & (1 << k)) {
       n_children++;
-      if (child.level() + 1 > max_level_ || bound.contains(child)) {
+      if (pix_cand->pix.level() + 2 > max_level_ || (flags & (1 << (k + 4)))) {
         n_terminals++;
       }
     }
   }
+  pix_cand->child_flags = flags;
   pix_cand->n_children = n_children;
-  if (pix_cand->pix.level() + 1 > max_level_ || n_terminals == 4)
-    pix_cand->is_terminal = true;
+  pix_cand->is_terminal =
+      pix_cand->pix.level() + 1 > max_level_ || n_terminals == 4;
 
 
   // This is the value that is used within the priority queue. First we
@@ -415,5 +539,84 @@ int coverer::score_pixel(const bound_interface& bound,
   return -(((pix_cand->pix.level() << 2) + n_children << 2) + n_terminals);
 }
 
-} // end namespace s2omp
+void coverer::parallel_interior_covering(const bound_interface& bound,
+    const pixel_vector& initial_candidates, pixel_vector* pixels) {
+  // Start by bringing our candidates up to min_level_.
+  pixel_vector frontier;
+  for (pixel_iterator iter = initial_candidates.begin();
+       iter != initial_candidates.end(); ++iter) {
+    if (iter->level() < min_level_) {
+      for (pixel child = iter->child_begin(min_level_);
+           child != iter->child_end(min_level_); child = child.next()) {
+        if (bound.may_intersect(child)) {
+          frontier.push_back(child);
+        }
+      }
+    } else {
+      frontier.push_back(*iter);
+    }
+  }
+
+  // A handful of initial candidates won't keep all of our threads busy, so
+  // we expand the tree breadth-first until we have several independent
+  // subtrees per thread.
+  while (!frontier.empty() && frontier.size() < 4 * n_threads_) {
+    pixel_vector next_frontier;
+    for (pixel_iterator iter = frontier.begin(); iter != frontier.end(); ++iter) {
+      expand_interior(bound, *iter, &score_cache_, pixels, &next_frontier);
+    }
+    frontier.swap(next_frontier);
+  }
+
+  // Now resolve each of the subtrees in parallel and gather the results.
+  long n_subtrees = frontier.size();
+  std::vector<pixel_vector> subtree_pixels(n_subtrees);
+  std::vector<score_map> new_scores(n_subtrees);
+  parallel_for(n_subtrees, n_threads_, [&](long k) {
+    expand_interior(bound, frontier[k], &new_scores[k], &subtree_pixels[k],
+        NULL);
+  });
+
+  for (long k = 0; k < n_subtrees; k++) {
+    pixels->insert(pixels->end(), subtree_pixels[k].begin(),
+        subtree_pixels[k].end());
+    if (memoize_) {
+      score_cache_.insert(new_scores[k].begin(), new_scores[k].end());
+    }
+  }
 
+  sort(pixels->begin(), pixels->end());
+}
+
+void coverer::expand_interior(const bound_interface& bound, const pixel& pix,
+    score_map* new_scores, pixel_vector* pixels, pixel_vector* frontier) {
+  // Same logic as the interior branch of generate_covering: contained pixels
+  // go into the covering, non-terminal pixels are refined and anything else is
+  // dropped.  If we're given a frontier, the intersecting children are added
+  // to it rather than being refined immediately.
+  if (bound.contains(pix)) {
+    pixels->push_back(pix);
+    return;
+  }
+
+  pixel_candidate candidate;
+  candidate.pix = pix;
+  score_pixel(bound, &candidate, new_scores);
+  if (candidate.is_terminal) {
+    return;
+  }
+
+  int k = 0;
+  for (pixel child = pix.child_begin(); child != pix.child_end();
+       child = child.next(), k++) {
+    if (candidate.child_flags & (1 << k)) {
+      if (frontier) {
+        frontier->push_back(child);
+      } else {
+        expand_interior(bound, child, new_scores, pixels, NULL);
+      }
+    }
+  }
+}
+
+} // end namespace s2omp
@@ -12,6 +12,12 @@
 #include <set>
 #include <utility>
 
+#if defined(OS_MACOSX)
+#include <ext/hash_map>
+#else
+#include <hash_map>
+#endif
+
 #include "core.h"
 #include "pixel.h"
 
@@ -31,8 +37,16 @@ struct pixel_candidate {
   pixel pix;
   bool is_terminal;
   uint8_t n_children;
+  uint8_t child_flags;
 };
 
+// When scoring a pixel we test each of its four children against the bound.
+// The results are packed into a single byte: bit k is set if child k may
+// intersect the bound and bit k + 4 if child k is contained by the bound.
+typedef __gnu_cxx::hash_map<uint64, uint8_t> score_map;
+
+typedef std::vector<pixel_vector> covering_vector;
+
 typedef std::pair<int, pixel_candidate> pixel_entry;
 typedef std::vector<pixel_entry> pixel_entry_vector;
 typedef pixel_entry_vector::iterator pixel_entry_iterator;
@@ -122,6 +136,35 @@ public:
   static void get_center_covering(
       const bound_interface& bound, int level, pixel_vector* pixels);
 
+  // Batch versions of the size-limited and interior coverings for many
+  // circle_bounds at once.  Each bound is covered independently using the
+  // current level limits and the bounds are spread over n_threads() threads.
+  // The return value is true if every individual covering succeeded.
+  bool get_size_coverings(long max_pixels, const circle_ptr_vector& bounds,
+      covering_vector* coverings);
+  bool get_interior_coverings(const circle_ptr_vector& bounds,
+      covering_vector* coverings);
+
+  // Size-limited coverings of a single bound for each of the given
+  // max_pixels.  Scoring a candidate pixel means testing each of its children
+  // against the bound, which dominates the cost of a covering, so those
+  // results are cached by pixel id and shared between the coverings.  The
+  // cache only lives for the duration of the call, so it can never be applied
+  // to a bound that has since been modified or replaced.  The return value is
+  // true if every individual covering succeeded.
+  bool get_size_coverings(const std::vector<long>& max_pixels,
+      const bound_interface& bound, covering_vector* coverings);
+
+  // By default, coverings are generated on a single thread.  With more than
+  // one thread, the interior covering (without an area tolerance) expands
+  // the subtree below each of its initial candidate pixels in parallel and
+  // the initial candidates of the other coverings are scored in parallel.
+  // The batch methods above always use this many threads.
+  inline int n_threads() {
+    return n_threads_;
+  }
+  void set_n_threads(int n_threads);
+
   inline int min_level() {
     return min_level_;
   }
@@ -142,12 +185,22 @@ private:
   bool generate_covering(const bound_interface& bound, long max_pixels,
                          bool interior, double fraction, pixel_vector* pixels);
   void get_initial_covering(const bound_interface& bound, pixel_vector* pixels);
+  uint8_t child_flags(const bound_interface& bound, const pixel& pix,
+      score_map* new_scores);
   int score_pixel(const bound_interface& bound, pixel_candidate* pix);
+  int score_pixel(const bound_interface& bound, pixel_candidate* pix,
+      score_map* new_scores);
   void flush_queue(pixel_vector* pixels);
   void new_candidate(const bound_interface& bound, const pixel& pix);
+  void parallel_interior_covering(const bound_interface& bound,
+      const pixel_vector& initial_candidates, pixel_vector* pixels);
+  void expand_interior(const bound_interface& bound, const pixel& pix,
+      score_map* new_scores, pixel_vector* pixels, pixel_vector* frontier);
 
-  int min_level_, max_level_;
+  int min_level_, max_level_, n_threads_;
+  bool memoize_;
   candidate_queue pix_q_;
+  score_map score_cache_;
 };
 
 } // end namespace s2omp
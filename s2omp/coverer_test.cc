@@ -304,3 +304,94 @@ TEST(coverer, TestCovererInteriorCovering) {
   }
   ASSERT_LT(area, bound->area());
 }
+
+TEST(coverer, TestCovererMemoizedAndParallelCovering) {
+  // Test that memoized and multi-threaded coverings reproduce the results of
+  // the default single-threaded coverer.
+
+  // Start by constructing a simple circle_bound.
+  s2omp::point axis = s2omp::point::from_radec_deg(0.0, 0.0);
+  double theta_deg = 10.0;
+  s2omp::circle_bound* bound =
+      s2omp::circle_bound::from_radius(axis, theta_deg);
+
+  s2omp::coverer cover;
+  cover.set_levels_from_area(bound->area());
+  cover.set_max_level(cover.min_level() + 8);
+  s2omp::pixel_vector interior_covering, covering;
+  ASSERT_TRUE(cover.get_interior_covering(*bound, &interior_covering));
+  ASSERT_TRUE(cover.get_size_covering(100, *bound, &covering));
+  sort(interior_covering.begin(), interior_covering.end());
+
+  // Coverings of one bound at several sizes share their pixel scores, but
+  // should give the same answers as covering at each size on its own.
+  std::vector<long> max_pixels;
+  max_pixels.push_back(20);
+  max_pixels.push_back(100);
+  s2omp::covering_vector size_coverings;
+  ASSERT_TRUE(cover.get_size_coverings(max_pixels, *bound, &size_coverings));
+  ASSERT_EQ(size_coverings.size(), max_pixels.size());
+  for (int i = 0; i < max_pixels.size(); i++) {
+    s2omp::pixel_vector size_covering;
+    ASSERT_TRUE(cover.get_size_covering(max_pixels[i], *bound,
+        &size_covering));
+    ASSERT_EQ(size_coverings[i].size(), size_covering.size());
+    for (int k = 0; k < size_covering.size(); k++) {
+      ASSERT_EQ(size_coverings[i][k].id(), size_covering[k].id());
+    }
+  }
+
+  // A bound re-created at the same address with different geometry (as
+  // with a stack-allocated bound in a loop) mustn't pick up any scores from
+  // its predecessor.
+  s2omp::coverer loop_cover(cover.min_level(), cover.max_level());
+  for (int i = 0; i < 2; i++) {
+    s2omp::circle_bound loop_bound(
+        s2omp::point::from_radec_deg(20.0 * i, 10.0 * i),
+        s2omp::circle_bound::get_height_for_angle(theta_deg + 2.0 * i));
+    s2omp::covering_vector loop_coverings;
+    ASSERT_TRUE(loop_cover.get_size_coverings(max_pixels, loop_bound,
+        &loop_coverings));
+    s2omp::coverer fresh_cover(cover.min_level(), cover.max_level());
+    s2omp::pixel_vector fresh_covering;
+    ASSERT_TRUE(fresh_cover.get_size_covering(100, loop_bound,
+        &fresh_covering));
+    ASSERT_EQ(loop_coverings[1].size(), fresh_covering.size());
+    for (int k = 0; k < fresh_covering.size(); k++) {
+      ASSERT_EQ(loop_coverings[1][k].id(), fresh_covering[k].id());
+    }
+  }
+
+  // The multi-threaded interior covering is returned in sorted order.
+  s2omp::coverer thread_cover(cover.min_level(), cover.max_level());
+  thread_cover.set_n_threads(4);
+  ASSERT_EQ(thread_cover.n_threads(), 4);
+  s2omp::pixel_vector thread_covering;
+  ASSERT_TRUE(thread_cover.get_interior_covering(*bound, &thread_covering));
+  ASSERT_EQ(thread_covering.size(), interior_covering.size());
+  for (int k = 0; k < interior_covering.size(); k++) {
+    ASSERT_EQ(thread_covering[k].id(), interior_covering[k].id());
+  }
+
+  // Finally, the batch interface should match covering each bound on its own.
+  s2omp::circle_ptr_vector bounds;
+  for (int k = 0; k < 20; k++) {
+    s2omp::point center = s2omp::point::from_radec_deg(10.0 * k, 5.0 * k - 45.0);
+    bounds.push_back(s2omp::circle_bound::from_radius(center, 1.0 + 0.1 * k));
+  }
+  s2omp::coverer batch_cover(0, 16);
+  batch_cover.set_n_threads(4);
+  s2omp::covering_vector coverings;
+  ASSERT_TRUE(batch_cover.get_size_coverings(20, bounds, &coverings));
+  ASSERT_EQ(coverings.size(), bounds.size());
+  for (int k = 0; k < bounds.size(); k++) {
+    s2omp::coverer single_cover(0, 16);
+    ASSERT_TRUE(single_cover.get_size_covering(20, *bounds[k], &covering));
+    ASSERT_EQ(coverings[k].size(), covering.size());
+    for (int j = 0; j < covering.size(); j++) {
+      ASSERT_EQ(coverings[k][j].id(), covering[j].id());
+    }
+    delete bounds[k];
+  }
+  delete bound;
+}
@@ -1,5 +1,16 @@
+#include <algorithm>
 #include <iostream>
 #include <fstream>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/zero_copy_stream_impl.h>
+#include <google/protobuf/io/zero_copy_stream_impl_lite.h>
 
 #include "io.h"
 
@@ -13,6 +24,580 @@
 
 namespace s2omp {
 
+namespace {
+
+// Chunked container layout.  All integers other than the trailer are base-128
+// varints as used by the protocol buffer wire format:
+//
+//   header:  CHUNK_MAGIC, version, content, parameter_a, parameter_b
+//   chunks:  n_bytes, serialized message (repeated)
+//   index:   n_chunks, then offset, n_bytes, n_items, face, min_level,
+//            max_level, min_id, max_id for each chunk
+//   trailer: index offset (little-endian fixed64), CHUNK_MAGIC
+static const char CHUNK_MAGIC[] = "S2OMPCHK";
+static const int CHUNK_MAGIC_SIZE = 8;
+static const uint32 CHUNK_VERSION = 1;
+static const int CHUNK_TRAILER_SIZE = 8 + CHUNK_MAGIC_SIZE;
+
+class chunk_writer {
+  // Appends bounded-size messages to a chunked container, keeping track of
+  // the index entry for each one.  Chunks are closed when they reach the
+  // maximum size or when the next pixel falls on a different face.
+public:
+  chunk_writer(const string& output_file, ChunkContent content,
+      int parameter_a, int parameter_b, long max_chunk_size) :
+    fs_(output_file.c_str(), std::ios::out | std::ios::trunc
+        | std::ios::binary),
+    max_chunk_size_(max_chunk_size > 0 ? max_chunk_size : DEFAULT_CHUNK_SIZE),
+    ok_(fs_.good()) {
+    if (ok_) {
+      raw_ = new google::protobuf::io::OstreamOutputStream(&fs_);
+      coded_ = new google::protobuf::io::CodedOutputStream(raw_);
+      coded_->WriteRaw(CHUNK_MAGIC, CHUNK_MAGIC_SIZE);
+      coded_->WriteVarint32(CHUNK_VERSION);
+      coded_->WriteVarint32(content);
+      coded_->WriteVarint32(parameter_a);
+      coded_->WriteVarint32(parameter_b);
+    } else {
+      raw_ = NULL;
+      coded_ = NULL;
+    }
+    reset_chunk();
+  }
+  ~chunk_writer() {
+    delete coded_;
+    delete raw_;
+  }
+
+  // Returns true if the current chunk must be flushed before adding pix.
+  inline bool needs_flush(const pixel& pix) const {
+    return current_.n_items >= max_chunk_size_ ||
+        (current_.n_items > 0 && pix.face() != current_.face);
+  }
+
+  inline bool has_items() const {
+    return current_.n_items > 0;
+  }
+
+  void add_item(const pixel& pix) {
+    if (current_.n_items == 0) {
+      current_.face = pix.face();
+      current_.min_level = pix.level();
+      current_.max_level = pix.level();
+      current_.min_id = pix.range_min().id();
+      current_.max_id = pix.range_max().id();
+    } else {
+      current_.min_level = std::min(current_.min_level, pix.level());
+      current_.max_level = std::max(current_.max_level, pix.level());
+      current_.min_id = std::min(current_.min_id, pix.range_min().id());
+      current_.max_id = std::max(current_.max_id, pix.range_max().id());
+    }
+    current_.n_items++;
+  }
+
+  void flush(const google::protobuf::Message& message) {
+    if (!ok_ || current_.n_items == 0) return;
+
+    string bytes;
+    ok_ = message.SerializeToString(&bytes);
+    if (ok_) flush(bytes);
+  }
+
+  void flush(const string& bytes) {
+    if (!ok_ || current_.n_items == 0) return;
+
+    coded_->WriteVarint32(bytes.size());
+    current_.offset = coded_->ByteCount();
+    current_.n_bytes = bytes.size();
+    coded_->WriteString(bytes);
+    index_.push_back(current_);
+    reset_chunk();
+  }
+
+  bool finish() {
+    if (!ok_) return false;
+
+    uint64 index_offset = coded_->ByteCount();
+    coded_->WriteVarint32(index_.size());
+    for (chunk_vector::const_iterator iter = index_.begin();
+        iter != index_.end(); ++iter) {
+      coded_->WriteVarint64(iter->offset);
+      coded_->WriteVarint64(iter->n_bytes);
+      coded_->WriteVarint64(iter->n_items);
+      coded_->WriteVarint32(iter->face);
+      coded_->WriteVarint32(iter->min_level);
+      coded_->WriteVarint32(iter->max_level);
+      coded_->WriteVarint64(iter->min_id);
+      coded_->WriteVarint64(iter->max_id);
+    }
+    coded_->WriteLittleEndian64(index_offset);
+    coded_->WriteRaw(CHUNK_MAGIC, CHUNK_MAGIC_SIZE);
+    ok_ = !coded_->HadError();
+
+    delete coded_;
+    coded_ = NULL;
+    delete raw_;
+    raw_ = NULL;
+    fs_.close();
+
+    return ok_ && !fs_.fail();
+  }
+
+private:
+  void reset_chunk() {
+    current_.offset = 0;
+    current_.n_bytes = 0;
+    current_.n_items = 0;
+    current_.face = 0;
+    current_.min_level = current_.max_level = 0;
+    current_.min_id = current_.max_id = 0;
+  }
+
+  std::fstream fs_;
+  google::protobuf::io::OstreamOutputStream* raw_;
+  google::protobuf::io::CodedOutputStream* coded_;
+  long max_chunk_size_;
+  bool ok_;
+  chunk_info current_;
+  chunk_vector index_;
+};
+
+bool write_point_chunks(const point_vector& points, const string& output_file,
+    ChunkContent content, int parameter_a, int parameter_b,
+    long max_chunk_size) {
+  GOOGLE_PROTOBUF_VERIFY_VERSION;
+
+  // Chunks need to be contiguous in pixel id, so we write the points in id
+  // order without disturbing the input vector.
+  std::vector<std::pair<uint64, long> > keys;
+  keys.reserve(points.size());
+  for (long k = 0; k < points.size(); k++) {
+    keys.push_back(std::make_pair(points[k].id(), k));
+  }
+  std::sort(keys.begin(), keys.end());
+
+  chunk_writer writer(output_file, content, parameter_a, parameter_b,
+      max_chunk_size);
+  PointVectorProto proto;
+  for (long k = 0; k < keys.size(); k++) {
+    const point& p = points[keys[k].second];
+    pixel pix(p.id());
+    if (writer.needs_flush(pix)) {
+      writer.flush(proto);
+      proto.Clear();
+    }
+    PointProto* point_proto = proto.add_point();
+    point_proto->set_id(p.id());
+    point_proto->set_weight(p.weight());
+    writer.add_item(pix);
+  }
+  writer.flush(proto);
+
+  return writer.finish();
+}
+
+bool overlaps(const chunk_info& chunk, const pixel& pix) {
+  return chunk.min_id <= pix.range_max().id() &&
+      chunk.max_id >= pix.range_min().id();
+}
+
+
+// ASCII files are parsed by memory-mapping the file, splitting it into chunks
+// on line boundaries and tokenizing the chunks in parallel.  Each line
+// contributes at most one item; lines that don't parse are skipped.
+class mapped_text {
+public:
+  mapped_text(const string& file_name) : data_(NULL), size_(0), ok_(false) {
+    int fd = open(file_name.c_str(), O_RDONLY);
+    if (fd < 0) {
+      return;
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) == 0) {
+      size_ = file_stat.st_size;
+      ok_ = true;
+      if (size_ > 0) {
+        void* data = mmap(NULL, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+          ok_ = false;
+          size_ = 0;
+        } else {
+          data_ = static_cast<const char*>(data);
+          madvise(data, size_, MADV_SEQUENTIAL);
+        }
+      }
+    }
+    ::close(fd);
+  }
+  ~mapped_text() {
+    if (data_ != NULL) {
+      munmap(const_cast<char*>(data_), size_);
+    }
+  }
+
+  bool ok() const { return ok_; }
+
+  // Split the file into at most n_chunks pieces, each ending just after a
+  // newline (or at the end of the file).
+  void split(int n_chunks, std::vector<const char*>* boundaries) const {
+    boundaries->clear();
+    const char* end = data_ + size_;
+    boundaries->push_back(data_);
+    for (int k = 1; k < n_chunks; k++) {
+      const char* start = data_ + size_ * k / n_chunks;
+      if (start <= boundaries->back()) {
+        continue;
+      }
+      const char* newline = static_cast<const char*>(
+          memchr(start, '\n', end - start));
+      if (newline == NULL) {
+        break;
+      }
+      boundaries->push_back(newline + 1);
+    }
+    if (boundaries->back() != end) {
+      boundaries->push_back(end);
+    }
+  }
+
+private:
+  const char* data_;
+  size_t size_;
+  bool ok_;
+};
+
+inline bool is_space(char c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+// Find up to max_tokens whitespace-separated tokens in [begin, end).
+int tokenize(const char* begin, const char* end, int max_tokens,
+    const char** token_begin, const char** token_end) {
+  int n_tokens = 0;
+  const char* c = begin;
+  while (n_tokens < max_tokens) {
+    while (c < end && is_space(*c)) c++;
+    if (c == end) {
+      break;
+    }
+    token_begin[n_tokens] = c;
+    while (c < end && !is_space(*c)) c++;
+    token_end[n_tokens++] = c;
+  }
+  return n_tokens;
+}
+
+bool parse_double(const char* begin, const char* end, double* value) {
+  char buffer[64];
+  size_t length = end - begin;
+  if (length >= sizeof(buffer)) {
+    return false;
+  }
+  memcpy(buffer, begin, length);
+  buffer[length] = '\0';
+  char* parse_end;
+  *value = strtod(buffer, &parse_end);
+  return parse_end == buffer + length;
+}
+
+// Parse each line of the input file with parse_line(begin, end, &item),
+// keeping the items for which it returns true in file order.
+template<class T, typename Function>
+bool read_ascii_lines(const string& file_name, Function parse_line,
+    std::vector<T>* items) {
+  mapped_text text(file_name);
+  if (!text.ok()) {
+    return false;
+  }
+
+  int n_threads = default_n_threads();
+  std::vector<const char*> boundaries;
+  text.split(8 * n_threads, &boundaries);
+  long n_chunks = boundaries.size() - 1;
+
+  std::vector<std::vector<T> > chunk_items(n_chunks > 0 ? n_chunks : 0);
+  parallel_for(n_chunks, n_threads, [&](long k) {
+    const char* c = boundaries[k];
+    const char* chunk_end = boundaries[k + 1];
+    while (c < chunk_end) {
+      const char* line_end = static_cast<const char*>(
+          memchr(c, '\n', chunk_end - c));
+      if (line_end == NULL) {
+        line_end = chunk_end;
+      }
+      T item;
+      if (parse_line(c, line_end, &item)) {
+        chunk_items[k].push_back(item);
+      }
+      c = line_end + 1;
+    }
+  });
+
+  long n_items = 0;
+  for (long k = 0; k < n_chunks; k++) {
+    n_items += chunk_items[k].size();
+  }
+  items->reserve(items->size() + n_items);
+  for (long k = 0; k < n_chunks; k++) {
+    items->insert(items->end(), chunk_items[k].begin(), chunk_items[k].end());
+  }
+
+  return true;
+}
+
+bool parse_pixel_line(const char* begin, const char* end, pixel* pix) {
+  const char* token_begin[1];
+  const char* token_end[1];
+  if (tokenize(begin, end, 1, token_begin, token_end) < 1) {
+    return false;
+  }
+  *pix = pixel(S2CellId::FromToken(string(token_begin[0], token_end[0])));
+  return true;
+}
+
+bool parse_point_line(const char* begin, const char* end, point* p) {
+  const char* token_begin[2];
+  const char* token_end[2];
+  double weight;
+  if (tokenize(begin, end, 2, token_begin, token_end) < 2 ||
+      !parse_double(token_begin[1], token_end[1], &weight)) {
+    return false;
+  }
+  S2CellId id = S2CellId::FromToken(string(token_begin[0], token_end[0]));
+  *p = point(id.id(), weight);
+  return true;
+}
+
+} // end anonymous namespace
+
+chunked_reader::chunked_reader() {
+  close();
+}
+
+chunked_reader::~chunked_reader() {
+}
+
+bool chunked_reader::open(const string& file_name) {
+  close();
+
+  std::ifstream fs(file_name.c_str(), std::ios::in | std::ios::binary);
+  if (!fs) {
+    return false;
+  }
+
+  // Header
+  char header[64];
+  fs.read(header, sizeof(header));
+  long header_size = fs.gcount();
+  if (header_size < CHUNK_MAGIC_SIZE ||
+      string(header, CHUNK_MAGIC_SIZE) != string(CHUNK_MAGIC)) {
+    return false;
+  }
+  google::protobuf::io::CodedInputStream header_stream(
+      reinterpret_cast<const uint8*>(header) + CHUNK_MAGIC_SIZE,
+      header_size - CHUNK_MAGIC_SIZE);
+  uint32 version, content, parameter_a, parameter_b;
+  if (!header_stream.ReadVarint32(&version) || version != CHUNK_VERSION ||
+      !header_stream.ReadVarint32(&content) ||
+      !header_stream.ReadVarint32(&parameter_a) ||
+      !header_stream.ReadVarint32(&parameter_b) ||
+      content > PACKED_PIXEL_CHUNKS) {
+    return false;
+  }
+
+  // Trailer
+  fs.clear();
+  fs.seekg(0, std::ios::end);
+  long file_size = fs.tellg();
+  if (file_size < CHUNK_MAGIC_SIZE + CHUNK_TRAILER_SIZE) {
+    return false;
+  }
+  char trailer[CHUNK_TRAILER_SIZE];
+  fs.seekg(file_size - CHUNK_TRAILER_SIZE);
+  fs.read(trailer, CHUNK_TRAILER_SIZE);
+  if (!fs || string(trailer + 8, CHUNK_MAGIC_SIZE) != string(CHUNK_MAGIC)) {
+    return false;
+  }
+  // CodedInputStream reads into google::protobuf::uint64, which isn't the
+  // same type as the s2 uint64 on LP64 platforms.
+  google::protobuf::uint64 index_offset;
+  google::protobuf::io::CodedInputStream trailer_stream(
+      reinterpret_cast<const uint8*>(trailer), 8);
+  if (!trailer_stream.ReadLittleEndian64(&index_offset) ||
+      index_offset >= file_size - CHUNK_TRAILER_SIZE) {
+    return false;
+  }
+
+  // Index
+  string index_bytes(file_size - CHUNK_TRAILER_SIZE - index_offset, '\0');
+  fs.seekg(index_offset);
+  fs.read(&index_bytes[0], index_bytes.size());
+  if (!fs) {
+    return false;
+  }
+  google::protobuf::io::CodedInputStream index_stream(
+      reinterpret_cast<const uint8*>(index_bytes.data()), index_bytes.size());
+  uint32 n_chunks;
+  if (!index_stream.ReadVarint32(&n_chunks)) {
+    return false;
+  }
+  chunk_vector index;
+  index.reserve(n_chunks);
+  for (uint32 k = 0; k < n_chunks; k++) {
+    chunk_info chunk;
+    google::protobuf::uint64 offset, n_bytes, n_items, min_id, max_id;
+    uint32 face, min_level, max_level;
+    if (!index_stream.ReadVarint64(&offset) ||
+        !index_stream.ReadVarint64(&n_bytes) ||
+        !index_stream.ReadVarint64(&n_items) ||
+        !index_stream.ReadVarint32(&face) ||
+        !index_stream.ReadVarint32(&min_level) ||
+        !index_stream.ReadVarint32(&max_level) ||
+        !index_stream.ReadVarint64(&min_id) ||
+        !index_stream.ReadVarint64(&max_id) ||
+        offset + n_bytes > index_offset) {
+      return false;
+    }
+    chunk.offset = offset;
+    chunk.n_bytes = n_bytes;
+    chunk.n_items = n_items;
+    chunk.face = face;
+    chunk.min_level = min_level;
+    chunk.max_level = max_level;
+    chunk.min_id = min_id;
+    chunk.max_id = max_id;
+    index.push_back(chunk);
+  }
+
+  file_name_ = file_name;
+  content_ = static_cast<ChunkContent>(content);
+  parameter_a_ = parameter_a;
+  parameter_b_ = parameter_b;
+  index_.swap(index);
+
+  return true;
+}
+
+void chunked_reader::close() {
+  file_name_.clear();
+  content_ = PIXEL_CHUNKS;
+  parameter_a_ = parameter_b_ = 0;
+  index_.clear();
+}
+
+long chunked_reader::n_items() const {
+  long n_items = 0;
+  for (chunk_vector::const_iterator iter = index_.begin();
+      iter != index_.end(); ++iter) {
+    n_items += iter->n_items;
+  }
+  return n_items;
+}
+
+void chunked_reader::find_chunks(const pixel& pix,
+    std::vector<int>* chunks) const {
+  chunks->clear();
+  for (int k = 0; k < index_.size(); k++) {
+    if (overlaps(index_[k], pix)) {
+      chunks->push_back(k);
+    }
+  }
+}
+
+void chunked_reader::find_chunks(const bound_interface& bound,
+    std::vector<int>* chunks) const {
+  chunks->clear();
+
+  pixel_vector covering;
+  bound.get_covering(&covering);
+  for (int k = 0; k < index_.size(); k++) {
+    for (pixel_iterator iter = covering.begin();
+        iter != covering.end(); ++iter) {
+      if (overlaps(index_[k], *iter)) {
+        chunks->push_back(k);
+        break;
+      }
+    }
+  }
+}
+
+bool chunked_reader::read_chunk_bytes(int k, string* bytes) const {
+  if (k < 0 || k >= index_.size()) {
+    return false;
+  }
+
+  std::ifstream fs(file_name_.c_str(), std::ios::in | std::ios::binary);
+  if (!fs) {
+    return false;
+  }
+
+  bytes->assign(index_[k].n_bytes, '\0');
+  fs.seekg(index_[k].offset);
+  if (!bytes->empty()) {
+    fs.read(&(*bytes)[0], bytes->size());
+  }
+
+  return !fs.fail();
+}
+
+bool chunked_reader::read_chunk(int k, pixel_vector* pixels) const {
+  pixels->clear();
+
+  string bytes;
+  if (content_ == PACKED_PIXEL_CHUNKS) {
+    return read_chunk_bytes(k, &bytes) && io::unpack_pixels(bytes, pixels);
+  }
+
+  PixelVectorProto proto;
+  if (content_ != PIXEL_CHUNKS || !read_chunk_bytes(k, &bytes) ||
+      !proto.ParseFromString(bytes)) {
+    return false;
+  }
+
+  pixels->reserve(proto.pixel_size());
+  for (int j = 0; j < proto.pixel_size(); j++) {
+    pixels->push_back(io::to_pixel(proto.pixel(j)));
+  }
+
+  return true;
+}
+
+bool chunked_reader::read_chunk(int k, field_vector* pixels) const {
+  pixels->clear();
+
+  PixelVectorProto proto;
+  string bytes;
+  if (content_ != FIELD_CHUNKS || !read_chunk_bytes(k, &bytes) ||
+      !proto.ParseFromString(bytes)) {
+    return false;
+  }
+
+  pixels->reserve(proto.pixel_size());
+  for (int j = 0; j < proto.pixel_size(); j++) {
+    pixels->push_back(io::to_field_pixel(proto.pixel(j)));
+  }
+
+  return true;
+}
+
+bool chunked_reader::read_chunk(int k, point_vector* points) const {
+  points->clear();
+
+  PointVectorProto proto;
+  string bytes;
+  if ((content_ != POINT_CHUNKS && content_ != TREE_CHUNKS) ||
+      !read_chunk_bytes(k, &bytes) || !proto.ParseFromString(bytes)) {
+    return false;
+  }
+
+  points->reserve(proto.point_size());
+  for (int j = 0; j < proto.point_size(); j++) {
+    points->push_back(io::to_point(proto.point(j)));
+  }
+
+  return true;
+}
+
 bool io::write_ascii(const point_vector& points, const string& file_name) {
   std::fstream fs(file_name, std::fstream::out);
   if (!fs) {
@@ -151,43 +736,14 @@ bool io::read_ascii(const string& input_file, point_vector* points) {
   if (!points->empty())
     points->clear();
 
-  std::fstream fs(input_file, std::ios::in);
-  if (!fs) {
-    return false;
-  }
-
-  while (!fs.eof()) {
-    pixel pix;
-    double weight;
-    fs >> pix >> weight;
-
-    if (!fs.eof()) {
-      points->push_back(point(pix.id(), weight));
-    }
-  }
-
-  return true;
+  return read_ascii_lines(input_file, parse_point_line, points);
 }
 
 bool io::read_ascii(const string& input_file, pixel_vector* pixels) {
   if (!pixels->empty())
     pixels->clear();
 
-  std::fstream fs(input_file, std::ios::in);
-  if (!fs) {
-    return false;
-  }
-
-  while (!fs.eof()) {
-    pixel pix;
-    fs >> pix;
-
-    if (!fs.eof()) {
-      pixels->push_back(pix);
-    }
-  }
-
-  return true;
+  return read_ascii_lines(input_file, parse_pixel_line, pixels);
 }
 
 bool io::read_ascii(const string& input_file, pixel_union* pix_union) {
@@ -294,15 +850,378 @@ bool io::read_pb(const string& input_file, tree_union* t) {
 
   t->init(proto.level(), proto.node_capacity());
 
+  point_vector points;
+  points.reserve(proto.point_size());
   for (int k = 0; k < proto.point_size(); k++) {
-    if (!t->add_point(to_point(proto.point(k)))) {
+    points.push_back(to_point(proto.point(k)));
+  }
+
+  return t->add_points(points);
+}
+
+bool io::write_chunked(const point_vector& points,
+    const string& output_file) {
+  return write_chunked(points, output_file, DEFAULT_CHUNK_SIZE);
+}
+
+bool io::write_chunked(const point_vector& points,
+    const string& output_file, long max_chunk_size) {
+  return write_point_chunks(points, output_file, POINT_CHUNKS, 0, 0,
+      max_chunk_size);
+}
+
+bool io::write_chunked(const pixel_union& pix_union,
+    const string& output_file) {
+  return write_chunked(pix_union, output_file, DEFAULT_CHUNK_SIZE);
+}
+
+bool io::write_chunked(const pixel_union& pix_union,
+    const string& output_file, long max_chunk_size) {
+  GOOGLE_PROTOBUF_VERIFY_VERSION;
+
+  chunk_writer writer(output_file, PIXEL_CHUNKS, 0, 0, max_chunk_size);
+  PixelVectorProto proto;
+  for (pixel_iterator iter = pix_union.begin(); iter != pix_union.end(); ++iter) {
+    if (writer.needs_flush(*iter)) {
+      writer.flush(proto);
+      proto.Clear();
+    }
+    proto.add_pixel()->set_id(iter->id());
+    writer.add_item(*iter);
+  }
+  writer.flush(proto);
+
+  return writer.finish();
+}
+
+bool io::write_packed(const pixel_union& pix_union,
+    const string& output_file) {
+  return write_packed(pix_union, output_file, DEFAULT_CHUNK_SIZE);
+}
+
+bool io::write_packed(const pixel_union& pix_union,
+    const string& output_file, long max_chunk_size) {
+  chunk_writer writer(output_file, PACKED_PIXEL_CHUNKS, 0, 0, max_chunk_size);
+  pixel_vector pixels;
+  string bytes;
+  for (pixel_iterator iter = pix_union.begin(); iter != pix_union.end(); ++iter) {
+    if (writer.needs_flush(*iter)) {
+      pack_pixels(pixels, &bytes);
+      writer.flush(bytes);
+      pixels.clear();
+    }
+    pixels.push_back(*iter);
+    writer.add_item(*iter);
+  }
+  pack_pixels(pixels, &bytes);
+  writer.flush(bytes);
+
+  return writer.finish();
+}
+
+bool io::write_chunked(const field_union& s, const string& output_file) {
+  return write_chunked(s, output_file, DEFAULT_CHUNK_SIZE);
+}
+
+bool io::write_chunked(const field_union& s, const string& output_file,
+    long max_chunk_size) {
+  GOOGLE_PROTOBUF_VERIFY_VERSION;
+
+  chunk_writer writer(output_file, FIELD_CHUNKS, s.type(), 0, max_chunk_size);
+  PixelVectorProto proto;
+  for (field_const_iterator iter = s.begin(); iter != s.end(); ++iter) {
+    pixel pix(iter->id());
+    if (writer.needs_flush(pix)) {
+      writer.flush(proto);
+      proto.Clear();
+    }
+    PixelProto* pixel_proto = proto.add_pixel();
+    pixel_proto->set_id(iter->id());
+    pixel_proto->set_weight(iter->weight());
+    pixel_proto->set_intensity(iter->intensity());
+    pixel_proto->set_n_points(iter->n_points());
+    writer.add_item(pix);
+  }
+  writer.flush(proto);
+
+  return writer.finish();
+}
+
+bool io::write_chunked(const tree_union& t, const string& output_file) {
+  return write_chunked(t, output_file, DEFAULT_CHUNK_SIZE);
+}
+
+bool io::write_chunked(const tree_union& t, const string& output_file,
+    long max_chunk_size) {
+  point_vector points;
+  t.copy_points(&points);
+
+  return write_point_chunks(points, output_file, TREE_CHUNKS, t.level(),
+      t.node_capacity(), max_chunk_size);
+}
+
+bool io::read_chunked(const string& input_file, point_vector* points) {
+  return read_chunked(input_file, default_n_threads(), points);
+}
+
+bool io::read_chunked(const string& input_file, pixel_union* pix_union) {
+  return read_chunked(input_file, default_n_threads(), pix_union);
+}
+
+bool io::read_chunked(const string& input_file, field_union* s) {
+  return read_chunked(input_file, default_n_threads(), s);
+}
+
+bool io::read_chunked(const string& input_file, tree_union* t) {
+  return read_chunked(input_file, default_n_threads(), t);
+}
+
+bool io::read_chunked(const string& input_file, int n_threads,
+    point_vector* points) {
+  chunked_reader reader;
+  if (!reader.open(input_file) || reader.content() != POINT_CHUNKS) {
+    return false;
+  }
+
+  std::vector<int> chunks;
+  for (int k = 0; k < reader.n_chunks(); k++) {
+    chunks.push_back(k);
+  }
+
+  return read_chunks(reader, chunks, n_threads, points);
+}
+
+bool io::read_chunked(const string& input_file, int n_threads,
+    pixel_union* pix_union) {
+  chunked_reader reader;
+  if (!reader.open(input_file) || (reader.content() != PIXEL_CHUNKS &&
+      reader.content() != PACKED_PIXEL_CHUNKS)) {
+    return false;
+  }
+
+  // Each chunk is parsed into its own vector and then concatenated in file
+  // order, so the union is initialized from already-sorted input.
+  std::vector<pixel_vector> chunk_pixels(reader.n_chunks());
+  std::vector<char> chunk_ok(reader.n_chunks(), 0);
+  parallel_for(reader.n_chunks(), n_threads, [&](long k) {
+    chunk_ok[k] = reader.read_chunk(k, &chunk_pixels[k]);
+  });
+
+  pixel_vector pixels;
+  pixels.reserve(reader.n_items());
+  for (int k = 0; k < reader.n_chunks(); k++) {
+    if (!chunk_ok[k]) return false;
+    pixels.insert(pixels.end(), chunk_pixels[k].begin(),
+        chunk_pixels[k].end());
+    pixel_vector().swap(chunk_pixels[k]);
+  }
+
+  pix_union->init(pixels);
+
+  return true;
+}
+
+bool io::read_chunked(const string& input_file, int n_threads,
+    field_union* s) {
+  chunked_reader reader;
+  if (!reader.open(input_file) || reader.content() != FIELD_CHUNKS) {
+    return false;
+  }
+
+  std::vector<field_vector> chunk_pixels(reader.n_chunks());
+  std::vector<char> chunk_ok(reader.n_chunks(), 0);
+  parallel_for(reader.n_chunks(), n_threads, [&](long k) {
+    chunk_ok[k] = reader.read_chunk(k, &chunk_pixels[k]);
+  });
+
+  field_vector pixels;
+  pixels.reserve(reader.n_items());
+  for (int k = 0; k < reader.n_chunks(); k++) {
+    if (!chunk_ok[k]) return false;
+    pixels.insert(pixels.end(), chunk_pixels[k].begin(),
+        chunk_pixels[k].end());
+    field_vector().swap(chunk_pixels[k]);
+  }
+
+  return s->init(pixels,
+      static_cast<field_union::FieldType>(reader.field_type()));
+}
+
+bool io::read_chunked(const string& input_file, int n_threads,
+    tree_union* t) {
+  chunked_reader reader;
+  if (!reader.open(input_file) || reader.content() != TREE_CHUNKS) {
+    return false;
+  }
+
+  std::vector<int> chunks;
+  for (int k = 0; k < reader.n_chunks(); k++) {
+    chunks.push_back(k);
+  }
+
+  point_vector points;
+  if (!read_chunks(reader, chunks, n_threads, &points)) {
+    return false;
+  }
+
+  t->init(reader.level(), reader.node_capacity());
+
+  return t->add_points(points, n_threads);
+}
+
+bool io::read_chunked(const string& input_file,
+    const bound_interface& bound, point_vector* points) {
+  chunked_reader reader;
+  if (!reader.open(input_file) ||
+      (reader.content() != POINT_CHUNKS && reader.content() != TREE_CHUNKS)) {
+    return false;
+  }
+
+  std::vector<int> chunks;
+  reader.find_chunks(bound, &chunks);
+
+  point_vector chunk_points;
+  if (!read_chunks(reader, chunks, default_n_threads(), &chunk_points)) {
+    return false;
+  }
+
+  points->clear();
+  for (point_iterator iter = chunk_points.begin();
+      iter != chunk_points.end(); ++iter) {
+    if (bound.contains(*iter)) {
+      points->push_back(*iter);
+    }
+  }
+
+  return true;
+}
+
+bool io::read_chunked(const string& input_file,
+    const bound_interface& bound, pixel_union* pix_union) {
+  chunked_reader reader;
+  if (!reader.open(input_file) || (reader.content() != PIXEL_CHUNKS &&
+      reader.content() != PACKED_PIXEL_CHUNKS)) {
+    return false;
+  }
+
+  std::vector<int> chunks;
+  reader.find_chunks(bound, &chunks);
+
+  pixel_vector pixels;
+  for (std::vector<int>::const_iterator iter = chunks.begin();
+      iter != chunks.end(); ++iter) {
+    pixel_vector chunk_pixels;
+    if (!reader.read_chunk(*iter, &chunk_pixels)) {
       return false;
     }
+    for (pixel_iterator pix_iter = chunk_pixels.begin();
+        pix_iter != chunk_pixels.end(); ++pix_iter) {
+      if (bound.may_intersect(*pix_iter)) {
+        pixels.push_back(*pix_iter);
+      }
+    }
+  }
+
+  pix_union->init(pixels);
+
+  return true;
+}
+
+bool io::read_chunks(const chunked_reader& reader,
+    const std::vector<int>& chunks, int n_threads, point_vector* points) {
+  std::vector<point_vector> chunk_points(chunks.size());
+  std::vector<char> chunk_ok(chunks.size(), 0);
+  parallel_for(chunks.size(), n_threads, [&](long k) {
+    chunk_ok[k] = reader.read_chunk(chunks[k], &chunk_points[k]);
+  });
+
+  long n_points = 0;
+  for (int k = 0; k < chunks.size(); k++) {
+    if (!chunk_ok[k]) return false;
+    n_points += chunk_points[k].size();
+  }
+
+  points->clear();
+  points->reserve(n_points);
+  for (int k = 0; k < chunks.size(); k++) {
+    points->insert(points->end(), chunk_points[k].begin(),
+        chunk_points[k].end());
+    point_vector().swap(chunk_points[k]);
   }
 
   return true;
 }
 
+void io::pack_pixels(const pixel_vector& pixels, string* bytes) {
+  // Group the pixels by level.  The input is sorted by id, so the cell
+  // positions within each group are already increasing.
+  std::vector<pixel_vector> levels(MAX_LEVEL + 1);
+  for (pixel_iterator iter = pixels.begin(); iter != pixels.end(); ++iter) {
+    levels[iter->level()].push_back(*iter);
+  }
+
+  bytes->clear();
+  google::protobuf::io::StringOutputStream raw(bytes);
+  google::protobuf::io::CodedOutputStream coded(&raw);
+
+  int n_levels = 0;
+  for (int level = 0; level <= MAX_LEVEL; level++) {
+    if (!levels[level].empty()) n_levels++;
+  }
+  coded.WriteVarint32(n_levels);
+
+  for (int level = 0; level <= MAX_LEVEL; level++) {
+    if (levels[level].empty()) continue;
+
+    int shift = 2 * (MAX_LEVEL - level) + 1;
+    coded.WriteVarint32(level);
+    coded.WriteVarint32(levels[level].size());
+    uint64 last_position = 0;
+    for (pixel_iterator iter = levels[level].begin();
+        iter != levels[level].end(); ++iter) {
+      uint64 position = iter->id() >> shift;
+      coded.WriteVarint64(position - last_position);
+      last_position = position;
+    }
+  }
+}
+
+bool io::unpack_pixels(const string& bytes, pixel_vector* pixels) {
+  pixels->clear();
+
+  google::protobuf::io::CodedInputStream coded(
+      reinterpret_cast<const uint8*>(bytes.data()), bytes.size());
+
+  uint32 n_levels;
+  if (!coded.ReadVarint32(&n_levels)) {
+    return false;
+  }
+
+  for (uint32 k = 0; k < n_levels; k++) {
+    uint32 level, n_pixels;
+    if (!coded.ReadVarint32(&level) || level > MAX_LEVEL ||
+        !coded.ReadVarint32(&n_pixels)) {
+      return false;
+    }
+
+    int shift = 2 * (MAX_LEVEL - level) + 1;
+    uint64 position = 0;
+    for (uint32 j = 0; j < n_pixels; j++) {
+      google::protobuf::uint64 delta;
+      if (!coded.ReadVarint64(&delta)) {
+        return false;
+      }
+      position += delta;
+      pixels->push_back(pixel(((position << 1) | 1) << (shift - 1)));
+    }
+  }
+
+  // Restore the id ordering that the chunk was written in.
+  std::sort(pixels->begin(), pixels->end());
+
+  return coded.CurrentPosition() == bytes.size();
+}
+
 point io::to_point(const PointProto& proto) {
   return point(proto.id(), proto.weight());
 }
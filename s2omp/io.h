@@ -33,6 +33,107 @@ class pixel_union;
 class field_union;
 class tree_union;
 
+typedef std::vector<field_pixel> field_vector;
+
+// The single-message protocol buffer files written by write_pb() are limited
+// by the maximum protocol buffer message size and need the entire message in
+// memory to read or write.  For large unions, we also support a chunked
+// container: a short header, a stream of length-delimited PixelVectorProto
+// (for pixel_unions and field_unions) or PointVectorProto (for point_vectors
+// and tree_unions) messages of bounded size, and a footer index recording the
+// byte offset, face, level range and pixel id range of each chunk.  Chunks
+// never span more than one face and their contents are sorted by pixel id, so
+// readers can stream through the file, read chunks in parallel or seek
+// straight to the chunks that overlap a given region of the sky.
+enum ChunkContent {
+  PIXEL_CHUNKS = 0,
+  FIELD_CHUNKS = 1,
+  POINT_CHUNKS = 2,
+  TREE_CHUNKS = 3,
+  PACKED_PIXEL_CHUNKS = 4
+};
+
+// Sorted pixel ids are highly redundant, so pixel_unions can also be written
+// with packed chunks.  Rather than a PixelVectorProto, each chunk holds the
+// pixels grouped by level, with each group stored as varint-encoded
+// differences between successive cell positions at that level (the cell id
+// with its trailing sentinel bit and unused low bits shifted off).  Large,
+// high-resolution unions typically pack to a few bytes per pixel.
+
+// Default maximum number of pixels or points per chunk.
+static long const DEFAULT_CHUNK_SIZE = 1 << 16;
+
+struct chunk_info {
+  uint64 offset;
+  uint64 n_bytes;
+  long n_items;
+  int face, min_level, max_level;
+  uint64 min_id, max_id;
+};
+
+typedef std::vector<chunk_info> chunk_vector;
+
+class chunked_reader {
+  // Random-access reader for the chunked container.  Opening a file only
+  // reads the header and the footer index; chunks are parsed on demand.
+  // read_chunk() opens its own stream for each call, so a single reader can
+  // be shared by several threads reading different chunks.
+public:
+  chunked_reader();
+  ~chunked_reader();
+
+  bool open(const string& file_name);
+  void close();
+
+  inline bool is_open() const {
+    return !file_name_.empty();
+  }
+  inline ChunkContent content() const {
+    return content_;
+  }
+
+  // For tree_unions, the level and node capacity of the tree; for
+  // field_unions, the field type is stored in the first slot.
+  inline int level() const {
+    return parameter_a_;
+  }
+  inline int node_capacity() const {
+    return parameter_b_;
+  }
+  inline int field_type() const {
+    return parameter_a_;
+  }
+
+  inline int n_chunks() const {
+    return index_.size();
+  }
+  inline const chunk_info& chunk(int k) const {
+    return index_[k];
+  }
+  long n_items() const;
+
+  // Return the indices of the chunks whose pixel id range overlaps the input
+  // pixel or any pixel in the input bound's covering.  This only consults the
+  // index, so no chunk data is read.
+  void find_chunks(const pixel& pix, std::vector<int>* chunks) const;
+  void find_chunks(const bound_interface& bound, std::vector<int>* chunks) const;
+
+  // Parse a single chunk.  The output type must match the file content:
+  // pixel_vector for PIXEL_CHUNKS or PACKED_PIXEL_CHUNKS, field_vector for
+  // FIELD_CHUNKS and point_vector for POINT_CHUNKS or TREE_CHUNKS.
+  bool read_chunk(int k, pixel_vector* pixels) const;
+  bool read_chunk(int k, field_vector* pixels) const;
+  bool read_chunk(int k, point_vector* points) const;
+
+private:
+  bool read_chunk_bytes(int k, string* bytes) const;
+
+  string file_name_;
+  ChunkContent content_;
+  int parameter_a_, parameter_b_;
+  chunk_vector index_;
+};
+
 class io {
 public:
   static bool write_ascii(const point_vector& points,
@@ -61,10 +162,64 @@ public:
   static bool read_pb(const string& input_file, field_union* s);
   static bool read_pb(const string& input_file, tree_union* t);
 
+  // Chunked container I/O.  The writers take an optional maximum number of
+  // pixels or points per chunk; point_vectors are written in pixel id order.
+  static bool write_chunked(const point_vector& points,
+      const string& output_file);
+  static bool write_chunked(const point_vector& points,
+      const string& output_file, long max_chunk_size);
+  static bool write_chunked(const pixel_union& pix_union,
+      const string& output_file);
+  static bool write_chunked(const pixel_union& pix_union,
+      const string& output_file, long max_chunk_size);
+  static bool write_chunked(const field_union& s, const string& output_file);
+  static bool write_chunked(const field_union& s, const string& output_file,
+      long max_chunk_size);
+  static bool write_chunked(const tree_union& t, const string& output_file);
+  static bool write_chunked(const tree_union& t, const string& output_file,
+      long max_chunk_size);
+
+  // As above, but with packed pixel chunks.  The pixel_union readers below
+  // accept either encoding.
+  static bool write_packed(const pixel_union& pix_union,
+      const string& output_file);
+  static bool write_packed(const pixel_union& pix_union,
+      const string& output_file, long max_chunk_size);
+
+  // The readers parse the chunks in parallel on up to n_threads threads
+  // (defaulting to one per core).
+  static bool read_chunked(const string& input_file, point_vector* points);
+  static bool read_chunked(const string& input_file, pixel_union* pix_union);
+  static bool read_chunked(const string& input_file, field_union* s);
+  static bool read_chunked(const string& input_file, tree_union* t);
+  static bool read_chunked(const string& input_file, int n_threads,
+      point_vector* points);
+  static bool read_chunked(const string& input_file, int n_threads,
+      pixel_union* pix_union);
+  static bool read_chunked(const string& input_file, int n_threads,
+      field_union* s);
+  static bool read_chunked(const string& input_file, int n_threads,
+      tree_union* t);
+
+  // Regional reads only parse the chunks that overlap the input bound and
+  // only keep the pixels that may intersect it (or the points it contains).
+  static bool read_chunked(const string& input_file,
+      const bound_interface& bound, point_vector* points);
+  static bool read_chunked(const string& input_file,
+      const bound_interface& bound, pixel_union* pix_union);
+
 private:
+  friend class chunked_reader;
+
   static point to_point(const PointProto& proto);
   static pixel to_pixel(const PixelProto& proto);
   static field_pixel to_field_pixel(const PixelProto& proto);
+
+  static void pack_pixels(const pixel_vector& pixels, string* bytes);
+  static bool unpack_pixels(const string& bytes, pixel_vector* pixels);
+
+  static bool read_chunks(const chunked_reader& reader,
+      const std::vector<int>& chunks, int n_threads, point_vector* points);
 };
 
 } // end namespace s2omp
@@ -1,9 +1,12 @@
 #include <gtest/gtest.h>
 
+#include <algorithm>
+
 #include "io.h"
 
 #include "circle_bound.h"
 #include "pixel_union.h"
+#include "tree_union.h"
 
 TEST(io, TestIoPixelAscii) {
   // Test the static methods for reading and writing pixels to ascii files.
@@ -130,3 +133,206 @@ TEST(io, TestIoPixelProtoBuffer) {
     ASSERT_EQ(pixels[k].id(), read_pixels[k].id());
   }
 }
+
+TEST(io, TestIoPixelUnionChunked) {
+  // Test the chunked container for pixel_unions, using a small chunk size so
+  // that the union is spread over many chunks.
+  s2omp::point axis(0.0, 0.0, 1.0, 1.0);
+  double theta_deg = 10.0;
+  s2omp::circle_bound* bound =
+      s2omp::circle_bound::from_radius(axis, theta_deg);
+
+  int level = s2omp::pixel::get_level_from_area(bound->area() / 1000.0);
+  s2omp::pixel_vector pixels;
+  bound->get_simple_covering(level, &pixels);
+  s2omp::pixel_union pix_union;
+  pix_union.init(pixels);
+
+  string test_file_name = "io_test_pixel_union.chk";
+  long max_chunk_size = 16;
+  ASSERT_TRUE(s2omp::io::write_chunked(pix_union, test_file_name,
+      max_chunk_size));
+
+  // The index should cover every pixel with chunks of bounded size that are
+  // sorted by pixel id and never cross a face boundary.
+  s2omp::chunked_reader reader;
+  ASSERT_TRUE(reader.open(test_file_name));
+  ASSERT_EQ(s2omp::PIXEL_CHUNKS, reader.content());
+  ASSERT_EQ(pix_union.size(), reader.n_items());
+  ASSERT_GT(reader.n_chunks(), 1);
+  for (int k = 0; k < reader.n_chunks(); k++) {
+    ASSERT_LE(reader.chunk(k).n_items, max_chunk_size);
+    ASSERT_LE(reader.chunk(k).min_id, reader.chunk(k).max_id);
+    if (k > 0) {
+      ASSERT_GT(reader.chunk(k).min_id, reader.chunk(k - 1).max_id);
+    }
+
+    s2omp::pixel_vector chunk_pixels;
+    ASSERT_TRUE(reader.read_chunk(k, &chunk_pixels));
+    ASSERT_EQ(reader.chunk(k).n_items, chunk_pixels.size());
+    for (s2omp::pixel_iterator iter = chunk_pixels.begin();
+        iter != chunk_pixels.end(); ++iter) {
+      ASSERT_EQ(reader.chunk(k).face, iter->face());
+    }
+  }
+
+  // Serial and parallel reads should both reproduce the union.
+  for (int n_threads = 1; n_threads <= 4; n_threads *= 4) {
+    s2omp::pixel_union read_union;
+    ASSERT_TRUE(s2omp::io::read_chunked(test_file_name, n_threads,
+        &read_union));
+    ASSERT_EQ(pix_union.size(), read_union.size());
+    ASSERT_NEAR(pix_union.area(), read_union.area(), 1.0e-10);
+    s2omp::pixel_iterator read_iter = read_union.begin();
+    for (s2omp::pixel_iterator iter = pix_union.begin();
+        iter != pix_union.end(); ++iter, ++read_iter) {
+      ASSERT_EQ(iter->id(), read_iter->id());
+    }
+  }
+
+  // A regional read should only touch the chunks near a smaller bound and
+  // still return every pixel in the union that intersects it.
+  s2omp::circle_bound* small_bound =
+      s2omp::circle_bound::from_radius(axis, 2.0);
+  std::vector<int> chunks;
+  reader.find_chunks(*small_bound, &chunks);
+  ASSERT_GT(chunks.size(), 0);
+  ASSERT_LT(chunks.size(), reader.n_chunks());
+
+  s2omp::pixel_union region_union;
+  ASSERT_TRUE(s2omp::io::read_chunked(test_file_name, *small_bound,
+      &region_union));
+  for (s2omp::pixel_iterator iter = pix_union.begin();
+      iter != pix_union.end(); ++iter) {
+    if (small_bound->may_intersect(*iter)) {
+      ASSERT_TRUE(region_union.contains(*iter));
+    }
+  }
+
+  // The chunked reader should refuse files in the single-message format.
+  ASSERT_TRUE(s2omp::io::write_pb(pix_union, "io_test_pixel_union.pb"));
+  ASSERT_FALSE(reader.open("io_test_pixel_union.pb"));
+
+  delete small_bound;
+  delete bound;
+}
+
+TEST(io, TestIoPointChunked) {
+  // Test the chunked container for point_vectors.  Points are written in
+  // pixel id order, so we compare against a sorted copy of the input.
+  s2omp::point axis(0.0, 0.0, 1.0, 1.0);
+  double theta_deg = 10.0;
+  s2omp::circle_bound* bound =
+      s2omp::circle_bound::from_radius(axis, theta_deg);
+
+  s2omp::point_vector points;
+  long n_points = 10000;
+  bound->get_random_points(n_points, &points);
+
+  string test_file_name = "io_test_point_vector.chk";
+  ASSERT_TRUE(s2omp::io::write_chunked(points, test_file_name, 1000));
+
+  s2omp::point_vector read_points;
+  ASSERT_TRUE(s2omp::io::read_chunked(test_file_name, 4, &read_points));
+
+  std::sort(points.begin(), points.end());
+  ASSERT_EQ(points.size(), read_points.size());
+  for (int k = 0; k < points.size(); k++) {
+    ASSERT_EQ(points[k].id(), read_points[k].id());
+    ASSERT_NEAR(points[k].weight(), read_points[k].weight(), 1.0e-20);
+  }
+
+  // A regional read should return exactly the points in the smaller bound.
+  s2omp::circle_bound* small_bound =
+      s2omp::circle_bound::from_radius(axis, 2.0);
+  s2omp::point_vector region_points;
+  ASSERT_TRUE(s2omp::io::read_chunked(test_file_name, *small_bound,
+      &region_points));
+  long n_contained = 0;
+  for (s2omp::point_iterator iter = read_points.begin();
+      iter != read_points.end(); ++iter) {
+    if (small_bound->contains(*iter)) n_contained++;
+  }
+  ASSERT_EQ(n_contained, region_points.size());
+
+  delete small_bound;
+  delete bound;
+}
+
+TEST(io, TestIoTreeUnionChunked) {
+  // Test the chunked container for tree_unions.  The tree parameters travel
+  // in the header and the tree is rebuilt with the bulk loader.
+  s2omp::point axis(0.0, 0.0, 1.0, 1.0);
+  double theta_deg = 10.0;
+  s2omp::circle_bound* bound =
+      s2omp::circle_bound::from_radius(axis, theta_deg);
+
+  s2omp::point_vector points;
+  bound->get_random_points(5000, &points);
+
+  s2omp::tree_union tree(8, 50);
+  for (s2omp::point_iterator iter = points.begin();
+      iter != points.end(); ++iter) {
+    tree.add_point(*iter);
+  }
+
+  string test_file_name = "io_test_tree_union.chk";
+  ASSERT_TRUE(s2omp::io::write_chunked(tree, test_file_name, 500));
+
+  s2omp::tree_union read_tree;
+  ASSERT_TRUE(s2omp::io::read_chunked(test_file_name, 4, &read_tree));
+  ASSERT_EQ(tree.level(), read_tree.level());
+  ASSERT_EQ(tree.node_capacity(), read_tree.node_capacity());
+  ASSERT_EQ(tree.n_points(), read_tree.n_points());
+  ASSERT_NEAR(tree.weight(), read_tree.weight(), 1.0e-8);
+  ASSERT_EQ(tree.size(), read_tree.size());
+
+  delete bound;
+}
+
+TEST(io, TestIoPixelUnionPacked) {
+  // Test the packed pixel encoding.  It should round-trip a multi-level
+  // pixel_union exactly and take up less space than the protobuf chunks.
+  s2omp::point axis(0.0, 0.0, 1.0, 1.0);
+  double theta_deg = 10.0;
+  s2omp::circle_bound* bound =
+      s2omp::circle_bound::from_radius(axis, theta_deg);
+
+  int level = s2omp::pixel::get_level_from_area(bound->area() / 10000.0);
+  s2omp::pixel_vector pixels;
+  bound->get_simple_covering(level, &pixels);
+  s2omp::pixel_union pix_union;
+  pix_union.init(pixels);
+  ASSERT_LT(pix_union.min_level(), pix_union.max_level());
+
+  string chunked_file_name = "io_test_pixel_union_chunked.chk";
+  string packed_file_name = "io_test_pixel_union_packed.chk";
+  ASSERT_TRUE(s2omp::io::write_chunked(pix_union, chunked_file_name, 256));
+  ASSERT_TRUE(s2omp::io::write_packed(pix_union, packed_file_name, 256));
+
+  s2omp::chunked_reader chunked_reader, packed_reader;
+  ASSERT_TRUE(chunked_reader.open(chunked_file_name));
+  ASSERT_TRUE(packed_reader.open(packed_file_name));
+  ASSERT_EQ(s2omp::PACKED_PIXEL_CHUNKS, packed_reader.content());
+  ASSERT_EQ(chunked_reader.n_chunks(), packed_reader.n_chunks());
+  uint64 chunked_bytes = 0, packed_bytes = 0;
+  for (int k = 0; k < packed_reader.n_chunks(); k++) {
+    chunked_bytes += chunked_reader.chunk(k).n_bytes;
+    packed_bytes += packed_reader.chunk(k).n_bytes;
+  }
+  ASSERT_LT(2 * packed_bytes, chunked_bytes);
+
+  for (int n_threads = 1; n_threads <= 4; n_threads *= 4) {
+    s2omp::pixel_union read_union;
+    ASSERT_TRUE(s2omp::io::read_chunked(packed_file_name, n_threads,
+        &read_union));
+    ASSERT_EQ(pix_union.size(), read_union.size());
+    s2omp::pixel_iterator read_iter = read_union.begin();
+    for (s2omp::pixel_iterator iter = pix_union.begin();
+        iter != pix_union.end(); ++iter, ++read_iter) {
+      ASSERT_EQ(iter->id(), read_iter->id());
+    }
+  }
+
+  delete bound;
+}
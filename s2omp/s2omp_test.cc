@@ -13,11 +13,11 @@
 
 //#include "pixel_union_test.cc"
 //#include "field_union_test.cc"
-//#include "tree_union_test.cc"
+#include "tree_union_test.cc"
 
-//#include "coverer_test.cc"
+#include "coverer_test.cc"
 //#include "region_map_test.cc"
-//#include "io_test.cc"
+#include "io_test.cc"
 
 int main(int argc, char **argv) {
   testing::InitGoogleTest(&argc, argv);
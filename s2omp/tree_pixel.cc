@@ -64,6 +64,19 @@ tree_pixel* tree_pixel::from_pixel(const pixel& pix, uint max_points) {
   return new tree_pixel(pix.id(), max_points);
 }
 
+packed_point tree_pixel::to_packed_point(const point& p) {
+  packed_point packed;
+  packed.x = p.x();
+  packed.y = p.y();
+  packed.z = p.z();
+  packed.weight = p.weight();
+  return packed;
+}
+
+point tree_pixel::from_packed_point(const packed_point& p) {
+  return point(S2Point(p.x, p.y, p.z), p.weight);
+}
+
 // Moving private method here since it's referenced in add_point.
 bool tree_pixel::initialize_subnodes() {
   if (is_leaf()) {
@@ -75,28 +88,26 @@ bool tree_pixel::initialize_subnodes() {
     subnodes_.push_back(from_pixel(c, node_capacity_));
   }
 
-  for (point_ptr_iterator p_iter = points_.begin(); p_iter != points_.end(); ++p_iter) {
-    bool transferred_point = false;
-    for (tree_ptr_iterator iter = subnodes_.begin(); iter != subnodes_.end(); ++iter) {
-      if ((*iter)->add_point(*p_iter)) {
-        transferred_point = true;
-        break;
-      }
-    }
-    if (!transferred_point) {
+  // The sub-nodes are stored in the same order as their child positions, so
+  // we can hand each point directly to the sub-node that contains it.
+  for (packed_point_iterator iter = points_.begin(); iter != points_.end(); ++iter) {
+    S2CellId leaf_id = S2CellId::FromPoint(S2Point(iter->x, iter->y, iter->z));
+    tree_pixel* node = subnodes_[leaf_id.child_position(level() + 1)];
+    if (!node->add_packed_point(*iter, leaf_id)) {
       std::cout << "s2omp::tree_pixel::initialize_subnodes - "
           << "Failed to transfer point to any subnode.  Exiting.\n";
       exit(2);
     }
   }
-  points_.clear();
+  packed_point_vector().swap(points_);
 
   return !subnodes_.empty() && points_.empty();
 }
 
-bool tree_pixel::add_point(point* p) {
+bool tree_pixel::add_packed_point(const packed_point& p,
+    const S2CellId& leaf_id) {
   // If the point is outside the pixel, ignore it.
-  if (!contains(*p)) {
+  if (!get_cellid().contains(leaf_id)) {
     return false;
   }
 
@@ -106,52 +117,93 @@ bool tree_pixel::add_point(point* p) {
     if (point_count_ == 0)
       points_.reserve(node_capacity_);
     points_.push_back(p);
-    weight_ += p->weight();
+    weight_ += p.weight;
     point_count_++;
 
     return true;
-  } else {
-    // If we're at capacity, then this point will be added to a subnode.  Before
-    // adding to any subnodes, we need to make sure that we've initialized them.
-    if (!has_nodes()) {
-      if (!initialize_subnodes()) {
-        std::cout << "s2omp::tree_pixel::add_point - "
-            << "Failed to initialize subnodes.  Exiting.\n";
-        exit(2);
-      }
-    }
+  }
 
-    // Iterate through the subnodes and add the point to the one that contains
-    // it.
-    for (tree_ptr_iterator iter = subnodes_.begin(); iter != subnodes_.end(); iter++) {
-      if ((*iter)->contains(*p)) {
-        // Provided that we successully
-        if ((*iter)->add_point(p)) {
-          weight_ += p->weight();
-          point_count_++;
-
-          return true;
-        }
-      }
+  // If we're at capacity, then this point will be added to a subnode.  Before
+  // adding to any subnodes, we need to make sure that we've initialized them.
+  if (!has_nodes()) {
+    if (!initialize_subnodes()) {
+      std::cout << "s2omp::tree_pixel::add_point - "
+          << "Failed to initialize subnodes.  Exiting.\n";
+      exit(2);
     }
   }
 
+  tree_pixel* node = subnodes_[leaf_id.child_position(level() + 1)];
+  if (node->add_packed_point(p, leaf_id)) {
+    weight_ += p.weight;
+    point_count_++;
+
+    return true;
+  }
+
   // If we've reached this point, then somehow we've failed to add the point
   // to either this node or any of the subnodes.
   return false;
 }
 
 bool tree_pixel::add_point(const point& p) {
-  return add_point(point::copy_point(p));
+  return add_packed_point(to_packed_point(p), S2CellId::FromPoint(p.s2point()));
+}
+
+bool tree_pixel::build_from_sorted(const std::vector<uint64>& ids,
+    const packed_point_vector& points, long begin, long end) {
+  if (point_count_ > 0 || begin > end) {
+    return false;
+  }
+
+  // Every entry in the input range must fall inside this pixel.
+  if (begin < end && (ids[begin] < range_min().id()
+      || ids[end - 1] > range_max().id())) {
+    return false;
+  }
+
+  point_count_ = end - begin;
+
+  // Nodes that are under capacity (or that can't be split any further) hold
+  // their points directly.
+  if (point_count_ <= node_capacity_ || is_leaf()) {
+    points_.assign(points.begin() + begin, points.begin() + end);
+    for (packed_point_iterator iter = points_.begin(); iter != points_.end(); ++iter) {
+      weight_ += iter->weight;
+    }
+    return true;
+  }
+
+  // Otherwise, we split the range among our four sub-nodes.  Since the input
+  // ids are sorted, the points for each child pixel form a contiguous block
+  // whose end we can find with a binary search.
+  subnodes_.reserve(4);
+  long start = begin;
+  for (pixel c = child_begin(); c != child_end(); c = c.next()) {
+    long stop = std::upper_bound(ids.begin() + start, ids.begin() + end,
+        c.range_max().id()) - ids.begin();
+
+    tree_pixel* node = from_pixel(c, node_capacity_);
+    if (!node->build_from_sorted(ids, points, start, stop)) {
+      delete node;
+      return false;
+    }
+    weight_ += node->weight();
+    subnodes_.push_back(node);
+
+    start = stop;
+  }
+
+  return true;
 }
 
 // Moving these private methods here since the following methods use them.
 void tree_pixel::direct_pair_count(const annulus_bound& bound,
     pair_weight* pairs) const {
-  for (point_ptr_iterator iter = points_.begin(); iter != points_.end(); ++iter) {
-    if (bound.contains(*(*iter))) {
+  for (packed_point_iterator iter = points_.begin(); iter != points_.end(); ++iter) {
+    if (bound.contains(from_packed_point(*iter))) {
       pairs->n_pairs++;
-      pairs->total_weight += (*iter)->weight();
+      pairs->total_weight += iter->weight;
     }
   }
 }
@@ -203,8 +255,8 @@ void tree_pixel::_neighbor_recursion(const point& p, tree_neighbor* neighbors) c
   if (!points_.empty()) {
     // We have no subnodes in this tree, so we'll just iterate over the
     // points here and take the nearest N neighbors.
-    for (point_ptr_iterator iter = points_.begin(); iter != points_.end(); ++iter) {
-      neighbors->test_point(*iter);
+    for (packed_point_iterator iter = points_.begin(); iter != points_.end(); ++iter) {
+      neighbors->test_point(from_packed_point(*iter));
     }
     return;
   }
@@ -314,8 +366,8 @@ long tree_pixel::n_points(const pixel& pix) const {
   // where we have points in this node.
   long contained_points = 0;
   if (!points_.empty()) {
-    for (point_ptr_iterator iter = points_.begin(); iter != points_.end(); iter++) {
-      if (pix.contains(*(*iter)))
+    for (packed_point_iterator iter = points_.begin(); iter != points_.end(); iter++) {
+      if (pix.contains(from_packed_point(*iter)))
         contained_points++;
     }
 
@@ -347,9 +399,9 @@ double tree_pixel::weight(const pixel& pix) const {
   // where we have points in this node.
   double total_weight = 0.0;
   if (!points_.empty()) {
-    for (point_ptr_iterator iter = points_.begin(); iter != points_.end(); iter++) {
-      if (pix.contains(*(*iter)))
-        total_weight = (*iter)->weight();
+    for (packed_point_iterator iter = points_.begin(); iter != points_.end(); iter++) {
+      if (pix.contains(from_packed_point(*iter)))
+        total_weight += iter->weight;
     }
 
     return total_weight;
@@ -413,8 +465,8 @@ double tree_pixel::covering_fraction(const pixel& pix) const {
 
   // If any of our contained points is also contained by the input pixel, then
   // the contained fraction is unity.  Otherwise, the fraction is zero.
-  for (point_ptr_iterator iter = points_.begin(); iter != points_.end(); iter++) {
-    if (pix.contains(*(*iter))) {
+  for (packed_point_iterator iter = points_.begin(); iter != points_.end(); iter++) {
+    if (pix.contains(from_packed_point(*iter))) {
       return 1.0;
     }
   }
@@ -435,8 +487,8 @@ void tree_pixel::copy_points(point_vector* points) const {
 
   // If we have points in this node, then copy them to the output vector.
   if (!points_.empty()) {
-    for (point_ptr_iterator iter = points_.begin(); iter != points_.end(); iter++) {
-      points->push_back(point::copy_point(*iter));
+    for (packed_point_iterator iter = points_.begin(); iter != points_.end(); iter++) {
+      points->push_back(from_packed_point(*iter));
     }
     return;
   }
@@ -473,9 +525,9 @@ void tree_pixel::copy_points(const pixel& pix, point_vector* points) const {
   points->reserve(point_count_);
 
   if (!points_.empty()) {
-    for (point_ptr_iterator iter = points_.begin(); iter != points_.end(); iter++) {
-      if (pix.contains(*(*iter))) {
-        points->push_back(point::copy_point(*iter));
+    for (packed_point_iterator iter = points_.begin(); iter != points_.end(); iter++) {
+      if (pix.contains(from_packed_point(*iter))) {
+        points->push_back(from_packed_point(*iter));
       }
     }
     return;
@@ -504,9 +556,7 @@ long tree_pixel::n_nodes() const {
 }
 
 void tree_pixel::clear() {
-  for (point_ptr_iterator iter = points_.begin(); iter != points_.end(); iter++) {
-    delete *iter;
-  }
+  packed_point_vector().swap(points_);
 
   for (tree_ptr_iterator iter = subnodes_.begin(); iter != subnodes_.end(); ++iter) {
     (*iter)->clear();
@@ -559,7 +609,7 @@ void tree_neighbor::nearest_neighbors(point_vector* points,
     distance_point_pair dist_pair = point_queue_.top();
     point_queue_.pop();
 
-    points->push_back(point::copy_point(dist_pair.second));
+    points->push_back(dist_pair.second);
     backup_copy.push_back(dist_pair);
   }
 
@@ -576,8 +626,8 @@ point tree_neighbor::nearest_neighbor() {
   return points.back();
 }
 
-bool tree_neighbor::test_point(point* test_point) {
-  double sin2theta = reference_point_.cross_norm2(*test_point);
+bool tree_neighbor::test_point(const point& test_point) {
+  double sin2theta = reference_point_.cross_norm2(test_point);
 
   if (sin2theta < max_distance_ || n_neighbors() < max_neighbors()) {
     if (n_neighbors() == max_neighbors()) {
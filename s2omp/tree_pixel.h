@@ -37,6 +37,17 @@ typedef struct pair_weight {
   double total_weight;
 };
 
+// Points stored in the tree are kept as packed unit vector components and
+// weights rather than as individually allocated point objects.  This keeps the
+// per-point memory footprint to 32 bytes and lets leaf node scans run over
+// contiguous memory.
+struct packed_point {
+  double x, y, z, weight;
+};
+
+typedef std::vector<packed_point> packed_point_vector;
+typedef packed_point_vector::const_iterator packed_point_iterator;
+
 typedef std::vector<tree_pixel> tree_vector;
 typedef tree_vector::const_iterator tree_iterator;
 typedef std::pair<tree_iterator, tree_iterator> tree_pair;
@@ -47,7 +58,7 @@ typedef std::pair<double, tree_pixel*> distance_pixel_pair;
 typedef std::priority_queue<distance_pixel_pair,
     std::vector<distance_pixel_pair>, nearest_neighbor_pixel> pixel_queue;
 
-typedef std::pair<double, point*> distance_point_pair;
+typedef std::pair<double, point> distance_point_pair;
 typedef std::priority_queue<distance_point_pair,
     std::vector<distance_point_pair>, nearest_neighbor_point> point_queue;
 
@@ -71,13 +82,28 @@ public:
   static tree_pixel* from_point(const point& p, int level, uint max_points);
   static tree_pixel* from_pixel(const pixel& pix, uint max_points);
 
+  // Conversions between the packed storage format and point objects.
+  static packed_point to_packed_point(const point& p);
+  static point from_packed_point(const packed_point& p);
+
   // Add a given point on the sphere to either this pixel (if the capacity for
   // this pixel hasn't been reached) or one of the sub-pixels.  Return true
   // if the point was successfully added (i.e. the point was contained in the
   // bounds of the current pixel); false, otherwise.
-  bool add_point(point* p);
   bool add_point(const point& p);
 
+  // Alternatively, we can build the node and all of its sub-nodes in a single
+  // pass from a set of points that have already been sorted by their leaf
+  // pixel id.  The first argument is that sorted vector of leaf ids and the
+  // second the matching packed points; begin and end delimit the range of
+  // entries that fall inside this pixel.  Since the tree structure doesn't
+  // depend on the order in which points are added, the result is identical to
+  // calling add_point() for each point, but every point is copied exactly
+  // once instead of being passed down the tree each time a node splits.  The
+  // node must be empty before calling this method.
+  bool build_from_sorted(const std::vector<uint64>& ids,
+      const packed_point_vector& points, long begin, long end);
+
   // The motivation for building a tree structure like the one in this class is
   // to do fast pair finding by recursing down the tree structure.  The work
   // of this recursion is done with _find_pairs_recursion, but the preferred
@@ -176,10 +202,10 @@ public:
   // Occasionally, it can be useful for outside code to be able to traverse
   // the tree structure contained in the pixel and sub-nodes.  These hooks allow
   // for access to the pointers to the sub-nodes and any point data directly.
-  point_ptr_iterator points_begin() const {
+  packed_point_iterator points_begin() const {
     return points_.begin();
   }
-  point_ptr_iterator points_end() const {
+  packed_point_iterator points_end() const {
     return points_.end();
   }
   tree_ptr_iterator nodes_begin() const {
@@ -223,9 +249,10 @@ private:
 
   void initialize_node(uint max_points);
   bool initialize_subnodes();
+  bool add_packed_point(const packed_point& p, const S2CellId& leaf_id);
   void direct_pair_count(const annulus_bound& bound, pair_weight* pairs) const;
 
-  point_ptr_vector points_;
+  packed_point_vector points_;
   tree_ptr_vector subnodes_;
   uint node_capacity_;
   long point_count_;
@@ -290,7 +317,7 @@ public:
   // point was successfully included in the list (i.e., the distance between
   // the input point and the reference point was smaller than the current most
   // distant point in the list) or not.
-  bool test_point(point* test_point);
+  bool test_point(const point& test_point);
 
   // Return the maximum distance of the current list.
   inline double max_distance() {
@@ -72,6 +72,145 @@ bool tree_union::add_point(const point& p) {
   return modified_;
 }
 
+// Helper types and methods for the bulk loader.
+namespace {
+
+typedef std::pair<uint64, long> id_index_pair;
+
+// Sort the input vector by splitting it into blocks, sorting those in
+// parallel and then merging neighboring blocks pairwise until the whole
+// vector is in order.
+void parallel_sort(std::vector<id_index_pair>* keys, int n_threads) {
+  long n_keys = keys->size();
+  long n_blocks = std::max(1L, std::min<long>(n_threads, n_keys / 10000));
+
+  std::vector<long> bounds;
+  for (long k = 0; k <= n_blocks; k++) {
+    bounds.push_back(n_keys * k / n_blocks);
+  }
+
+  std::vector<id_index_pair>::iterator begin = keys->begin();
+  parallel_for(n_blocks, n_threads, [&](long k) {
+    std::sort(begin + bounds[k], begin + bounds[k + 1]);
+  });
+
+  while (bounds.size() > 2) {
+    long n_merges = (bounds.size() - 1) / 2;
+    parallel_for(n_merges, n_threads, [&](long k) {
+      std::inplace_merge(begin + bounds[2 * k], begin + bounds[2 * k + 1],
+          begin + bounds[2 * k + 2]);
+    });
+
+    std::vector<long> merged_bounds;
+    for (long k = 0; k < bounds.size(); k += 2) {
+      merged_bounds.push_back(bounds[k]);
+    }
+    if (merged_bounds.back() != bounds.back()) {
+      merged_bounds.push_back(bounds.back());
+    }
+    bounds.swap(merged_bounds);
+  }
+}
+
+// Chunk size used when splitting per-point work between threads.
+long const BULK_CHUNK_SIZE = 1 << 16;
+
+} // end anonymous namespace
+
+bool tree_union::add_points(const point_vector& points) {
+  return add_points(points, default_n_threads());
+}
+
+bool tree_union::add_points(const point_vector& points, int n_threads) {
+  long n_points = points.size();
+  if (n_points == 0) {
+    return true;
+  }
+  long n_chunks = (n_points + BULK_CHUNK_SIZE - 1) / BULK_CHUNK_SIZE;
+
+  // Start by finding the leaf pixel id for every point.  Pairing these with
+  // the point indices gives us a sort key that also keeps the ordering of
+  // points at identical positions deterministic.
+  std::vector<id_index_pair> keys(n_points);
+  parallel_for(n_chunks, n_threads, [&](long chunk) {
+    long stop = std::min(n_points, (chunk + 1) * BULK_CHUNK_SIZE);
+    for (long k = chunk * BULK_CHUNK_SIZE; k < stop; k++) {
+      keys[k] = id_index_pair(points[k].id(), k);
+    }
+  });
+
+  parallel_sort(&keys, n_threads);
+
+  // Gather the points into packed storage in sorted order.
+  std::vector<uint64> ids(n_points);
+  packed_point_vector packed_points(n_points);
+  parallel_for(n_chunks, n_threads, [&](long chunk) {
+    long stop = std::min(n_points, (chunk + 1) * BULK_CHUNK_SIZE);
+    for (long k = chunk * BULK_CHUNK_SIZE; k < stop; k++) {
+      ids[k] = keys[k].first;
+      packed_points[k] = tree_pixel::to_packed_point(points[keys[k].second]);
+    }
+  });
+  std::vector<id_index_pair>().swap(keys);
+
+  // Now find the block of sorted points that belongs to each node.
+  std::vector<uint64> node_ids;
+  std::vector<long> node_bounds;
+  for (long k = 0; k < n_points; k++) {
+    uint64 node_id = S2CellId(ids[k]).parent(level_).id();
+    if (node_ids.empty() || node_ids.back() != node_id) {
+      node_ids.push_back(node_id);
+      node_bounds.push_back(k);
+    }
+  }
+  node_bounds.push_back(n_points);
+
+  // Build each of the new nodes in parallel.  Nodes that already exist in the
+  // node map are left for the serial pass below.
+  long n_nodes = node_ids.size();
+  tree_ptr_vector new_nodes(n_nodes, NULL);
+  std::vector<char> built(n_nodes, 0);
+  parallel_for(n_nodes, n_threads, [&](long k) {
+    if (node_map_.find(node_ids[k]) != node_map_.end()) {
+      return;
+    }
+    new_nodes[k] = new tree_pixel(node_ids[k], node_capacity_);
+    built[k] = new_nodes[k]->build_from_sorted(ids, packed_points,
+        node_bounds[k], node_bounds[k + 1]);
+  });
+
+  bool success = true;
+  for (long k = 0; k < n_nodes; k++) {
+    if (new_nodes[k] == NULL) {
+      node_map_iterator iter = node_map_.find(node_ids[k]);
+      for (long j = node_bounds[k]; j < node_bounds[k + 1]; j++) {
+        point p = tree_pixel::from_packed_point(packed_points[j]);
+        if (!iter->second->add_point(p)) {
+          success = false;
+          continue;
+        }
+        point_count_++;
+        weight_ += p.weight();
+      }
+      continue;
+    }
+
+    if (!built[k]) {
+      delete new_nodes[k];
+      success = false;
+      continue;
+    }
+
+    node_map_.insert(std::pair<uint64, tree_pixel*>(node_ids[k], new_nodes[k]));
+    nodes_.insert(pixel(node_ids[k]));
+    point_count_ += new_nodes[k]->n_points();
+    weight_ += new_nodes[k]->weight();
+  }
+  modified_ = true;
+
+  return success;
+}
+
 long tree_union::find_pairs(const annulus_bound& bound) const {
   pixel_vector pixels;
   bound.get_simple_covering(level_, &pixels);
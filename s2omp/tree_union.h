@@ -53,6 +53,17 @@ public:
 
   bool add_point(const point& p);
 
+  // Bulk loading.  Rather than passing each point down the tree one at a
+  // time, the input points are sorted by their leaf pixel ids and each node
+  // in the node map is then built in a single pass over its block of sorted
+  // points.  The nodes are independent of one another, so they are built in
+  // parallel using up to n_threads threads (defaulting to one per core).  The
+  // resulting tree is identical to the one produced by calling add_point() on
+  // each point.  Points that fall in nodes which already contain data are
+  // added individually.
+  bool add_points(const point_vector& points);
+  bool add_points(const point_vector& points, int n_threads);
+
   // Stand-alone methods where we're only interested in the pairs and/or
   // weight within a single bound.
   long find_pairs(const annulus_bound& bound) const;
@@ -0,0 +1,59 @@
+#include <gtest/gtest.h>
+
+#include "tree_union.h"
+
+#include "angular_bin-inl.h"
+#include "annulus_bound.h"
+#include "circle_bound.h"
+
+TEST(tree_union, TestTreeUnionBulkLoad) {
+  // Generate a set of random points inside a circle that spans several
+  // top-level nodes.
+  s2omp::point axis(0.0, 0.0, 1.0, 1.0);
+  s2omp::circle_bound* bound = s2omp::circle_bound::from_radius(axis, 5.0);
+  s2omp::point_vector points;
+  bound->get_random_points(20000, &points);
+  delete bound;
+
+  int level = 6;
+  int node_capacity = 50;
+
+  // Build one tree point by point and another with the bulk loader.
+  s2omp::tree_union serial_tree(level, node_capacity);
+  for (s2omp::point_iterator iter = points.begin();
+      iter != points.end(); ++iter) {
+    ASSERT_TRUE(serial_tree.add_point(*iter));
+  }
+
+  s2omp::tree_union bulk_tree(level, node_capacity);
+  ASSERT_TRUE(bulk_tree.add_points(points, 4));
+
+  // The tree structure doesn't depend on the order in which points are
+  // added, so both trees should match.
+  ASSERT_EQ(bulk_tree.n_points(), serial_tree.n_points());
+  ASSERT_EQ(bulk_tree.size(), serial_tree.size());
+  ASSERT_NEAR(bulk_tree.weight(), serial_tree.weight(), 1.0e-8);
+
+  s2omp::pixel_vector serial_nodes, bulk_nodes;
+  serial_tree.get_area_covering(0.0, &serial_nodes);
+  bulk_tree.get_area_covering(0.0, &bulk_nodes);
+  ASSERT_EQ(bulk_nodes.size(), serial_nodes.size());
+  for (int k = 0; k < bulk_nodes.size(); k++) {
+    ASSERT_EQ(bulk_nodes[k].id(), serial_nodes[k].id());
+  }
+
+  // Pair counts should also agree.
+  s2omp::angular_bin bin(0.1, 1.0);
+  s2omp::annulus_bound* annulus =
+      s2omp::annulus_bound::from_angular_bin(axis, bin);
+  ASSERT_EQ(bulk_tree.find_pairs(*annulus), serial_tree.find_pairs(*annulus));
+  ASSERT_NEAR(bulk_tree.find_weighted_pairs(*annulus),
+      serial_tree.find_weighted_pairs(*annulus), 1.0e-8);
+  delete annulus;
+
+  // Bulk loading into a tree that already has data should fall back to adding
+  // points to the existing nodes.
+  ASSERT_TRUE(bulk_tree.add_points(points, 4));
+  ASSERT_EQ(bulk_tree.n_points(), 2 * serial_tree.n_points());
+  ASSERT_EQ(bulk_tree.size(), serial_tree.size());
+}
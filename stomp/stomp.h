@@ -18,6 +18,8 @@
 
 #include <stomp/stomp_core.h>
 #include <stomp/stomp_angular_coordinate.h>
+#include <stomp/stomp_point_catalog.h>
+#include <stomp/stomp_catalog_reader.h>
 #include <stomp/stomp_angular_bin.h>
 #include <stomp/stomp_radial_bin.h>
 #include <stomp/stomp_angular_correlation.h>
@@ -32,6 +34,9 @@
 #include <stomp/stomp_tree_map.h>
 #include <stomp/stomp_itree_map.h>
 #include <stomp/stomp_geometry.h>
+#include <stomp/stomp_bound_index.h>
+#include <stomp/stomp_multi_scalar_map.h>
+#include <stomp/stomp_instrumentation.h>
 #include <stomp/stomp_util.h>
 
 #endif
@@ -13,6 +13,8 @@
 #include "stomp_angular_bin.h"
 #include "stomp_pixel.h"
 #include "stomp_angular_coordinate.h"
+#include <iomanip>
+#include <limits>
 
 namespace Stomp {
 
@@ -65,16 +67,7 @@ AngularBin::~AngularBin() {
 }
 
 void AngularBin::ClearRegions() {
-  weight_region_.clear();
-  gal_gal_region_.clear();
-  gal_rand_region_.clear();
-  rand_gal_region_.clear();
-  rand_rand_region_.clear();
-  pixel_wtheta_region_.clear();
-  pixel_weight_region_.clear();
-  wtheta_region_.clear();
-  wtheta_error_region_.clear();
-  counter_region_.clear();
+  region_data_.clear();
   n_region_ = 0;
 }
 
@@ -82,31 +75,45 @@ void AngularBin::InitializeRegions(int16_t n_regions) {
   ClearRegions();
   if (n_regions > 0) {
     n_region_ = n_regions;
-    weight_region_.reserve(n_regions);
-    gal_gal_region_.reserve(n_regions);
-    gal_rand_region_.reserve(n_regions);
-    rand_gal_region_.reserve(n_regions);
-    rand_rand_region_.reserve(n_regions);
-    pixel_wtheta_region_.reserve(n_regions);
-    pixel_weight_region_.reserve(n_regions);
-    wtheta_region_.reserve(n_regions);
-    wtheta_error_region_.reserve(n_regions);
-    counter_region_.reserve(n_regions);
-    for (uint16_t k=0;k<n_regions;k++) {
-      weight_region_[k] = 0.0;
-      gal_gal_region_[k] = 0.0;
-      gal_rand_region_[k] = 0.0;
-      rand_gal_region_[k] = 0.0;
-      rand_rand_region_[k] = 0.0;
-      pixel_wtheta_region_[k] = 0.0;
-      pixel_weight_region_[k] = 0.0;
-      wtheta_region_[k] = 0.0;
-      wtheta_error_region_[k] = 0.0;
-      counter_region_[k] = 0;
-    }
+    region_data_.assign((n_regions + 1)*NRegionData, 0.0);
+  }
+}
+
+double AngularBin::_RegionValue(int16_t region, RegionData data) {
+  if ((data == WthetaData) || (data == WthetaErrorData))
+    return region_data_[region*NRegionData + data];
+  return region_data_[n_region_*NRegionData + data] -
+    region_data_[region*NRegionData + data];
+}
+
+void AngularBin::_AddToRegionData(RegionData data, double value,
+				  int16_t region_a, int16_t region_b) {
+  region_data_[n_region_*NRegionData + data] += value;
+  if (region_a < n_region_) region_data_[region_a*NRegionData + data] += value;
+  if ((region_b != region_a) && (region_b != -1) && (region_b < n_region_))
+    region_data_[region_b*NRegionData + data] += value;
+}
+
+void AngularBin::_MoveRegionData(RegionData from_data, RegionData to_data,
+				 RegionData also_to_data) {
+  for (uint32_t i=0;i<region_data_.size();i+=NRegionData) {
+    double* row = &region_data_[i];
+    row[to_data] += row[from_data];
+    if (also_to_data != NRegionData) row[also_to_data] += row[from_data];
+    row[from_data] = 0.0;
   }
 }
 
+void AngularBin::_ScaleRegionData(RegionData data, double scale) {
+  for (uint32_t i=data;i<region_data_.size();i+=NRegionData)
+    region_data_[i] /= scale;
+}
+
+void AngularBin::_ResetRegionData(RegionData data) {
+  for (uint32_t i=data;i<region_data_.size();i+=NRegionData)
+    region_data_[i] = 0.0;
+}
+
 void AngularBin::SetResolution(uint32_t resolution) {
   resolution_ = resolution;
 }
@@ -225,160 +232,115 @@ void AngularBin::AddToPixelWtheta(double dwtheta, double dweight,
   pixel_wtheta_ += dwtheta;
   pixel_weight_ += dweight;
 
-  if ((region_a != -1) && (region_b != -1)) {
-    for (int16_t k=0;k<n_region_;k++) {
-      if ((k != region_a) && (k != region_b)) {
-	pixel_wtheta_region_[k] += dwtheta;
-	pixel_weight_region_[k] += dweight;
-      }
-    }
+  if ((region_a != -1) && (region_b != -1) && (n_region_ > 0)) {
+    _AddToRegionData(PixelWthetaData, dwtheta, region_a, region_b);
+    _AddToRegionData(PixelWeightData, dweight, region_a, region_b);
   }
 }
 
 void AngularBin::AddToWeight(double weight, int16_t region) {
   weight_ += weight;
 
-  if (region != -1) {
-    for (int16_t k=0;k<n_region_;k++) {
-      if (k != region) weight_region_[k] += weight;
-    }
-  }
+  if ((region != -1) && (n_region_ > 0))
+    _AddToRegionData(WeightData, weight, region);
 }
 
 void AngularBin::AddToCounter(uint32_t step, int16_t region) {
   counter_ += step;
-  if (region != -1) {
-    for (int16_t k=0;k<n_region_;k++) {
-      if (k != region) counter_region_[k] += step;
-    }
-  }
+  if ((region != -1) && (n_region_ > 0))
+    _AddToRegionData(CounterData, 1.0*step, region);
 }
 
 void AngularBin::MoveWeightToGalGal() {
   gal_gal_ += weight_;
   weight_ = 0.0;
-  for (int16_t k=0;k<n_region_;k++) {
-    gal_gal_region_[k] += weight_region_[k];
-    weight_region_[k] = 0.0;
-  }
+  _MoveRegionData(WeightData, GalGalData);
 }
 
 void AngularBin::MoveWeightToGalRand(bool move_to_rand_gal) {
   gal_rand_ += weight_;
   if (move_to_rand_gal) rand_gal_ += weight_;
   weight_ = 0.0;
-  for (int16_t k=0;k<n_region_;k++) {
-    gal_rand_region_[k] += weight_region_[k];
-    if (move_to_rand_gal) rand_gal_region_[k] += weight_region_[k];
-    weight_region_[k] = 0.0;
-  }
+  _MoveRegionData(WeightData, GalRandData,
+		  move_to_rand_gal ? RandGalData : NRegionData);
 }
 
 void AngularBin::MoveWeightToRandGal(bool move_to_gal_rand) {
   rand_gal_ += weight_;
   if (move_to_gal_rand) gal_rand_ += weight_;
   weight_ = 0.0;
-  for (int16_t k=0;k<n_region_;k++) {
-    rand_gal_region_[k] += weight_region_[k];
-    if (move_to_gal_rand) gal_rand_region_[k] += weight_region_[k];
-    weight_region_[k] = 0.0;
-  }
+  _MoveRegionData(WeightData, RandGalData,
+		  move_to_gal_rand ? GalRandData : NRegionData);
 }
 
 void AngularBin::MoveWeightToRandRand() {
   rand_rand_ += weight_;
   weight_ = 0.0;
-  for (int16_t k=0;k<n_region_;k++) {
-    rand_rand_region_[k] += weight_region_[k];
-    weight_region_[k] = 0.0;
-  }
+  _MoveRegionData(WeightData, RandRandData);
 }
 
 void AngularBin::RescaleGalGal(double weight) {
   gal_gal_ /= weight;
-  for (int16_t k=0;k<n_region_;k++) gal_gal_region_[k] /= weight;
+  _ScaleRegionData(GalGalData, weight);
 }
 
 void AngularBin::RescaleGalRand(double weight) {
   gal_rand_ /= weight;
-  for (int16_t k=0;k<n_region_;k++) gal_rand_region_[k] /= weight;
+  _ScaleRegionData(GalRandData, weight);
 }
 
 void AngularBin::RescaleRandGal(double weight) {
   rand_gal_ /= weight;
-  for (int16_t k=0;k<n_region_;k++) rand_gal_region_[k] /= weight;
+  _ScaleRegionData(RandGalData, weight);
 }
 
 void AngularBin::RescaleRandRand(double weight) {
   rand_rand_ /= weight;
-  for (int16_t k=0;k<n_region_;k++) rand_rand_region_[k] /= weight;
+  _ScaleRegionData(RandRandData, weight);
 }
 
 void AngularBin::Reset() {
   weight_ = gal_gal_ = gal_rand_ = rand_gal_ = rand_rand_ = 0.0;
   pixel_wtheta_ = pixel_weight_ = wtheta_ = wtheta_error_ = 0.0;
   counter_ = 0;
-  if (n_region_ > 0) {
-    for (int16_t k=0;k<n_region_;k++) {
-      weight_region_[k] = 0.0;
-      gal_gal_region_[k] = 0.0;
-      gal_rand_region_[k] = 0.0;
-      rand_gal_region_[k] = 0.0;
-      rand_rand_region_[k] = 0.0;
-      pixel_wtheta_region_[k] = 0.0;
-      pixel_weight_region_[k] = 0.0;
-      wtheta_region_[k] = 0.0;
-      wtheta_error_region_[k] = 0.0;
-      counter_region_[k] = 0;
-    }
-  }
+  region_data_.assign(region_data_.size(), 0.0);
 }
 
 void AngularBin::ResetPixelWtheta() {
   pixel_wtheta_ = 0.0;
   pixel_weight_ = 0.0;
-  if (n_region_ > 0) {
-    for (int16_t k=0;k<n_region_;k++) {
-      pixel_wtheta_region_[k] = 0.0;
-      pixel_weight_region_[k] = 0.0;
-    }
-  }
+  _ResetRegionData(PixelWthetaData);
+  _ResetRegionData(PixelWeightData);
 }
 
 void AngularBin::ResetWeight() {
   weight_ = 0.0;
-  if (n_region_ > 0)
-    for (int16_t k=0;k<n_region_;k++) weight_region_[k] = 0.0;
+  _ResetRegionData(WeightData);
 }
 
 void AngularBin::ResetCounter() {
   counter_ = 0;
-  if (n_region_ > 0)
-    for (int16_t k=0;k<n_region_;k++) counter_region_[k] = 0;
+  _ResetRegionData(CounterData);
 }
 
 void AngularBin::ResetGalGal() {
   gal_gal_ = 0.0;
-  if (n_region_ > 0)
-    for (int16_t k=0;k<n_region_;k++) gal_gal_region_[k] = 0.0;
+  _ResetRegionData(GalGalData);
 }
 
 void AngularBin::ResetGalRand() {
   gal_rand_ = 0.0;
-  if (n_region_ > 0)
-    for (int16_t k=0;k<n_region_;k++) gal_rand_region_[k] = 0.0;
+  _ResetRegionData(GalRandData);
 }
 
 void AngularBin::ResetRandGal() {
   rand_gal_ = 0.0;
-  if (n_region_ > 0)
-    for (int16_t k=0;k<n_region_;k++) rand_gal_region_[k] = 0.0;
+  _ResetRegionData(RandGalData);
 }
 
 void AngularBin::ResetRandRand() {
   rand_rand_ = 0.0;
-  if (n_region_ > 0)
-    for (int16_t k=0;k<n_region_;k++) rand_rand_region_[k] = 0.0;
+  _ResetRegionData(RandRandData);
 }
 
 uint32_t AngularBin::Resolution() {
@@ -420,21 +382,22 @@ double AngularBin::CosThetaMax() {
 double AngularBin::Wtheta(int16_t region) {
   if (set_wtheta_) {
     return (region == -1 ? wtheta_ :
-	    (region < n_region_ ? wtheta_region_[region] : -1.0));
+	    (region < n_region_ ? _RegionValue(region, WthetaData) : -1.0));
   } else {
     if (resolution_ == 0) {
       return (region == -1 ?
 	      (gal_gal_ - gal_rand_ - rand_gal_ + rand_rand_)/rand_rand_ :
 	      (region < n_region_ ?
-	       (gal_gal_region_[region] - gal_rand_region_[region] -
-		rand_gal_region_[region] + rand_rand_region_[region])/
-	       rand_rand_region_[region] :
-	       -1.0));
+	       (_RegionValue(region, GalGalData) -
+		_RegionValue(region, GalRandData) -
+		_RegionValue(region, RandGalData) +
+		_RegionValue(region, RandRandData))/
+	       _RegionValue(region, RandRandData) : -1.0));
     } else {
       return (region == -1 ? pixel_wtheta_/pixel_weight_ :
 	      (region < n_region_ ?
-	       pixel_wtheta_region_[region]/pixel_weight_region_[region] :
-	       -1.0));
+	       _RegionValue(region, PixelWthetaData)/
+	       _RegionValue(region, PixelWeightData) : -1.0));
     }
   }
 }
@@ -442,16 +405,17 @@ double AngularBin::Wtheta(int16_t region) {
 double AngularBin::WthetaError(int16_t region) {
   if (set_wtheta_error_) {
     return (region == -1 ? wtheta_error_ :
-	    (region < n_region_ ? wtheta_error_region_[region] : -1.0));
+	    (region < n_region_ ?
+	     _RegionValue(region, WthetaErrorData) : -1.0));
   } else {
     if (resolution_ == 0) {
       return (region == -1 ? 1.0/sqrt(gal_gal_) :
 	      (region < n_region_ ?
-	       1.0/sqrt(gal_gal_region_[region]) : -1.0));
+	       1.0/sqrt(_RegionValue(region, GalGalData)) : -1.0));
     } else {
       return (region == -1 ? 1.0/sqrt(pixel_weight_) :
-	      (region < n_region_ ? 1.0/sqrt(pixel_weight_region_[region]) :
-	       -1.0));
+	      (region < n_region_ ?
+	       1.0/sqrt(_RegionValue(region, PixelWeightData)) : -1.0));
     }
   }
 }
@@ -459,61 +423,72 @@ double AngularBin::WthetaError(int16_t region) {
 double AngularBin::WeightedCrossCorrelation(int16_t region) {
   return (region == -1 ? weight_/counter_ :
 	  (region < n_region_ ?
-	   weight_region_[region]/counter_region_[region] : -1.0));
+	   _RegionValue(region, WeightData)/
+	   _RegionValue(region, CounterData) : -1.0));
 }
 
 double AngularBin::PixelWtheta(int16_t region) {
   return (region == -1 ? pixel_wtheta_ :
-	  (region < n_region_ ? pixel_wtheta_region_[region] : -1.0));
+	  (region < n_region_ ? _RegionValue(region, PixelWthetaData) : -1.0));
 }
 
 double AngularBin::PixelWeight(int16_t region) {
   return (region == -1 ? pixel_weight_ :
-	  (region < n_region_ ? pixel_weight_region_[region] : -1.0));
+	  (region < n_region_ ? _RegionValue(region, PixelWeightData) : -1.0));
 }
 
 double AngularBin::Weight(int16_t region) {
   return (region == -1 ? weight_ :
-	  (region < n_region_ ? weight_region_[region] : -1.0));
+	  (region < n_region_ ? _RegionValue(region, WeightData) : -1.0));
 }
 
 uint32_t AngularBin::Counter(int16_t region) {
   return (region == -1 ? counter_ :
-	  (region < n_region_ ? counter_region_[region] : -1));
+	  (region < n_region_ ?
+	   static_cast<uint32_t>(_RegionValue(region, CounterData)) : -1));
 }
 
 double AngularBin::GalGal(int16_t region) {
   return (region == -1 ? gal_gal_ :
-	  (region < n_region_ ? gal_gal_region_[region] : -1.0));
+	  (region < n_region_ ? _RegionValue(region, GalGalData) : -1.0));
 }
 
 double AngularBin::GalRand(int16_t region) {
   return (region == -1 ? gal_rand_ :
-	  (region < n_region_ ? gal_rand_region_[region] : -1.0));
+	  (region < n_region_ ? _RegionValue(region, GalRandData) : -1.0));
 }
 
 double AngularBin::RandGal(int16_t region) {
   return (region == -1 ? rand_gal_ :
-	  (region < n_region_ ? rand_gal_region_[region] : -1.0));
+	  (region < n_region_ ? _RegionValue(region, RandGalData) : -1.0));
 }
 
 double AngularBin::RandRand(int16_t region) {
   return (region == -1 ? rand_rand_ :
-	  (region < n_region_ ? rand_rand_region_[region] : -1.0));
+	  (region < n_region_ ? _RegionValue(region, RandRandData) : -1.0));
 }
 
 double AngularBin::MeanWtheta() {
+  std::vector<double> wtheta;
+  JackknifeWtheta(wtheta);
+
   double mean_wtheta = 0.0;
   for (int16_t k=0;k<n_region_;k++)
-    mean_wtheta += Wtheta(k)/(1.0*n_region_);
+    mean_wtheta += wtheta[k]/(1.0*n_region_);
   return mean_wtheta;
 }
 
 double AngularBin::MeanWthetaError() {
-  double mean_wtheta = MeanWtheta();
+  std::vector<double> wtheta;
+  JackknifeWtheta(wtheta);
+
+  double mean_wtheta = 0.0;
+  for (int16_t k=0;k<n_region_;k++)
+    mean_wtheta += wtheta[k]/(1.0*n_region_);
+
   double mean_wtheta_error = 0.0;
   for (int16_t k=0;k<n_region_;k++)
-    mean_wtheta_error += (mean_wtheta - Wtheta(k))*(mean_wtheta - Wtheta(k));
+    mean_wtheta_error += (mean_wtheta - wtheta[k])*(mean_wtheta - wtheta[k]);
   return (n_region_ == 0 ? 0.0 :
 	  (n_region_ - 1.0)*sqrt(mean_wtheta_error)/n_region_);
 }
@@ -522,7 +497,8 @@ double AngularBin::MeanWeightedCrossCorrelation() {
   double mean_weight_cross_correlation = 0.0;
   for (int16_t k=0;k<n_region_;k++)
     mean_weight_cross_correlation +=
-      1.0*weight_region_[k]/counter_region_[k]/(1.0*n_region_);
+      _RegionValue(k, WeightData)/_RegionValue(k, CounterData)/
+      (1.0*n_region_);
   return mean_weight_cross_correlation;
 }
 
@@ -541,45 +517,137 @@ double AngularBin::MeanWeightedCrossCorrelationError() {
 double AngularBin::MeanWeight() {
   double mean_weight = 0.0;
   for (int16_t k=0;k<n_region_;k++)
-    mean_weight += weight_region_[k]/(1.0*n_region_);
+    mean_weight += _RegionValue(k, WeightData)/(1.0*n_region_);
   return mean_weight;
 }
 
 double AngularBin::MeanCounter() {
   double mean_counter = 0.0;
   for (int16_t k=0;k<n_region_;k++)
-    mean_counter += 1.0*counter_region_[k]/(1.0*n_region_);
+    mean_counter += 1.0*_RegionValue(k, CounterData)/(1.0*n_region_);
   return mean_counter;
 }
 
 double AngularBin::MeanGalGal() {
   double mean_gal_gal = 0.0;
   for (int16_t k=0;k<n_region_;k++)
-    mean_gal_gal += gal_gal_region_[k]/(1.0*n_region_);
+    mean_gal_gal += _RegionValue(k, GalGalData)/(1.0*n_region_);
   return mean_gal_gal;
 }
 
 double AngularBin::MeanGalRand() {
   double mean_gal_rand = 0.0;
   for (int16_t k=0;k<n_region_;k++)
-    mean_gal_rand += gal_rand_region_[k]/(1.0*n_region_);
+    mean_gal_rand += _RegionValue(k, GalRandData)/(1.0*n_region_);
   return mean_gal_rand;
 }
 
 double AngularBin::MeanRandGal() {
   double mean_rand_gal = 0.0;
   for (int16_t k=0;k<n_region_;k++)
-    mean_rand_gal += rand_gal_region_[k]/(1.0*n_region_);
+    mean_rand_gal += _RegionValue(k, RandGalData)/(1.0*n_region_);
   return mean_rand_gal;
 }
 
 double AngularBin::MeanRandRand() {
   double mean_rand_rand = 0.0;
   for (int16_t k=0;k<n_region_;k++)
-    mean_rand_rand += rand_rand_region_[k]/(1.0*n_region_);
+    mean_rand_rand += _RegionValue(k, RandRandData)/(1.0*n_region_);
   return mean_rand_rand;
 }
 
+void AngularBin::JackknifeWtheta(std::vector<double>& wtheta) {
+  wtheta.resize(n_region_ > 0 ? n_region_ : 0);
+  if (n_region_ <= 0) return;
+
+  const double* total = &region_data_[n_region_*NRegionData];
+  for (int16_t k=0;k<n_region_;k++) {
+    const double* row = &region_data_[k*NRegionData];
+    if (set_wtheta_) {
+      wtheta[k] = row[WthetaData];
+    } else if (resolution_ == 0) {
+      double rand_rand = total[RandRandData] - row[RandRandData];
+      wtheta[k] = ((total[GalGalData] - row[GalGalData]) -
+		   (total[GalRandData] - row[GalRandData]) -
+		   (total[RandGalData] - row[RandGalData]) +
+		   rand_rand)/rand_rand;
+    } else {
+      wtheta[k] = (total[PixelWthetaData] - row[PixelWthetaData])/
+	(total[PixelWeightData] - row[PixelWeightData]);
+    }
+  }
+}
+
+void AngularBin::WriteState(std::ostream& output) {
+  std::streamsize precision = output.precision();
+  output << std::setprecision(std::numeric_limits<double>::digits10 + 2) <<
+    theta_min_ << " " << theta_max_ << " " << theta_ << " " <<
+    resolution_ << " " << n_region_ << " " <<
+    (set_wtheta_ ? 1 : 0) << " " << (set_wtheta_error_ ? 1 : 0) << " " <<
+    weight_ << " " << gal_gal_ << " " << gal_rand_ << " " << rand_gal_ <<
+    " " << rand_rand_ << " " << pixel_wtheta_ << " " << pixel_weight_ <<
+    " " << wtheta_ << " " << wtheta_error_ << " " << counter_;
+  for (uint32_t i=0;i<region_data_.size();i++)
+    output << " " << region_data_[i];
+  output << "\n" << std::setprecision(precision);
+}
+
+bool AngularBin::ReadState(std::istream& input) {
+  AngularBin theta;
+  double theta_min, theta_max;
+  int set_wtheta, set_wtheta_error;
+  if (!(input >> theta_min >> theta_max >> theta.theta_ >>
+	theta.resolution_ >> theta.n_region_ >> set_wtheta >>
+	set_wtheta_error >> theta.weight_ >> theta.gal_gal_ >>
+	theta.gal_rand_ >> theta.rand_gal_ >> theta.rand_rand_ >>
+	theta.pixel_wtheta_ >> theta.pixel_weight_ >> theta.wtheta_ >>
+	theta.wtheta_error_ >> theta.counter_)) return false;
+
+  theta.SetThetaMin(theta_min);
+  theta.SetThetaMax(theta_max);
+  theta.set_wtheta_ = (set_wtheta == 1);
+  theta.set_wtheta_error_ = (set_wtheta_error == 1);
+
+  if (theta.n_region_ < 0) return false;
+  theta.region_data_.assign(
+    theta.n_region_ > 0 ? (theta.n_region_ + 1)*NRegionData : 0, 0.0);
+  for (uint32_t i=0;i<theta.region_data_.size();i++)
+    if (!(input >> theta.region_data_[i])) return false;
+
+  *this = theta;
+  return true;
+}
+
+bool AngularBin::Add(AngularBin& theta) {
+  if ((theta.n_region_ != n_region_) ||
+      (theta.resolution_ != resolution_) ||
+      !DoubleEQ(theta.theta_min_, theta_min_) ||
+      !DoubleEQ(theta.theta_max_, theta_max_)) return false;
+
+  weight_ += theta.weight_;
+  gal_gal_ += theta.gal_gal_;
+  gal_rand_ += theta.gal_rand_;
+  rand_gal_ += theta.rand_gal_;
+  rand_rand_ += theta.rand_rand_;
+  pixel_wtheta_ += theta.pixel_wtheta_;
+  pixel_weight_ += theta.pixel_weight_;
+  counter_ += theta.counter_;
+  for (uint32_t i=0;i<region_data_.size();i+=NRegionData) {
+    for (uint32_t j=0;j<WthetaData;j++)
+      region_data_[i + j] += theta.region_data_[i + j];
+  }
+
+  // Any w(theta) or error that was set directly came from the pair counts
+  // of one bin or the other, so it no longer applies; clearing it makes
+  // Wtheta and WthetaError fall back to the summed counts.
+  wtheta_ = wtheta_error_ = 0.0;
+  set_wtheta_ = set_wtheta_error_ = false;
+  _ResetRegionData(WthetaData);
+  _ResetRegionData(WthetaErrorData);
+
+  return true;
+}
+
 bool AngularBin::ThetaOrder(AngularBin theta_a, AngularBin theta_b) {
   return (theta_a.ThetaMin() < theta_b.ThetaMin() ? true : false);
 }
@@ -18,6 +18,7 @@
 #define STOMP_ANGULAR_BIN_H
 
 #include <vector>
+#include <iostream>
 #include <math.h>
 
 namespace Stomp {
@@ -191,6 +192,26 @@ class AngularBin {
   double MeanRandGal();
   double MeanRandRand();
 
+  // Fill a vector with the jack-knife w(theta) for each of the regions, i.e.
+  // the equivalent of calling Wtheta(k) for k = 0 to NRegion()-1.  This is
+  // a single pass over the region data, which makes it the better choice
+  // for the covariance calculations in AngularCorrelation.
+  void JackknifeWtheta(std::vector<double>& wtheta);
+
+  // For checkpointing long calculations, WriteState writes everything that
+  // the bin has accumulated (the totals and the region data) as a single
+  // line of text, with enough precision that ReadState gets back exactly the
+  // same values.  ReadState returns false if the line can't be parsed, in
+  // which case the bin is left as it was.  Add sums the accumulated data from
+  // another bin with the same angular range, resolution and number of
+  // regions into this one, returning false (and leaving the bin alone) if
+  // they don't match.  Only the accumulated counts and weights are summed;
+  // any w(theta) and error values stored directly in the bin are cleared,
+  // so that Wtheta and WthetaError are worked out from the combined counts.
+  void WriteState(std::ostream& output);
+  bool ReadState(std::istream& input);
+  bool Add(AngularBin& theta);
+
   // Finally, some static methods which the AngularCorrelation method will use
   // to order its vectors of AngularBin objects.
   static bool ThetaOrder(AngularBin theta_a, AngularBin theta_b);
@@ -204,11 +225,36 @@ class AngularBin {
   double weight_, gal_gal_, gal_rand_, rand_gal_, rand_rand_;
   double pixel_wtheta_, pixel_weight_, wtheta_, wtheta_error_;
   uint32_t counter_;
-  std::vector<double> weight_region_, gal_gal_region_;
-  std::vector<double> gal_rand_region_, rand_gal_region_, rand_rand_region_;
-  std::vector<double> pixel_wtheta_region_, pixel_weight_region_;
-  std::vector<double> wtheta_region_, wtheta_error_region_;
-  std::vector<uint32_t> counter_region_;
+
+  // The region data are kept in a single block, with a row of NRegionData
+  // values for each region followed by a row of totals for everything that
+  // was assigned to a region.  Rather than adding each pair to every region
+  // that it doesn't touch, we add it to the total and to the rows for the
+  // regions that it does touch; the jack-knife value for region k is then
+  // the total row minus row k.  The exceptions are the w(theta) and error
+  // values, which are stored directly.
+  enum RegionData {
+    WeightData,
+    GalGalData,
+    GalRandData,
+    RandGalData,
+    RandRandData,
+    PixelWthetaData,
+    PixelWeightData,
+    CounterData,
+    WthetaData,
+    WthetaErrorData,
+    NRegionData
+  };
+  double _RegionValue(int16_t region, RegionData data);
+  void _AddToRegionData(RegionData data, double value, int16_t region_a,
+			int16_t region_b = -1);
+  void _MoveRegionData(RegionData from_data, RegionData to_data,
+		       RegionData also_to_data = NRegionData);
+  void _ScaleRegionData(RegionData data, double scale);
+  void _ResetRegionData(RegionData data);
+
+  std::vector<double> region_data_;
   uint32_t resolution_;
   int16_t n_region_;
   bool set_wtheta_error_, set_wtheta_;
@@ -783,6 +783,306 @@ void AngularCoordinate::GalacticToXYZ(double gal_lon, double gal_lat,
   z = sin(dec);
 }
 
+// The bulk conversions work through their input in blocks of this many
+// points, with the scratch arrays for each block on the stack.  Each thread
+// takes BulkBlocksPerTask blocks at a time.
+static const uint32_t BulkBlockSize = 512;
+static const uint32_t BulkBlocksPerTask = 32;
+
+// Each coordinate system is described by the rotation taking the natural
+// Cartesian frame of that system (x toward longitude 0, z toward the pole)
+// into our internal unit sphere frame, plus an offset added to the longitude
+// before going into that frame.  The rotation is stored row-major.  As with
+// Set(), theta is the latitude for Survey coordinates (lambda, eta) and the
+// longitude otherwise (ra, dec and gal_lon, gal_lat); latitude_first says
+// which.
+static void BulkFrame(AngularCoordinate::Sphere sphere, double rotation[9],
+		      double& longitude_offset, bool& latitude_first) {
+  for (uint8_t i=0;i<9;i++) rotation[i] = 0.0;
+  longitude_offset = 0.0;
+  latitude_first = (sphere == AngularCoordinate::Survey);
+
+  switch (sphere) {
+  case AngularCoordinate::Survey:
+    // x = -sin(lambda), y = cos(lambda)*cos(eta+EtaPole),
+    // z = cos(lambda)*sin(eta+EtaPole)
+    rotation[2] = -1.0;
+    rotation[3] = 1.0;
+    rotation[7] = 1.0;
+    longitude_offset = EtaPole;
+    break;
+  case AngularCoordinate::Equatorial:
+    // x = cos(ra-Node)*cos(dec), y = sin(ra-Node)*cos(dec), z = sin(dec)
+    rotation[0] = 1.0;
+    rotation[4] = 1.0;
+    rotation[8] = 1.0;
+    longitude_offset = -Node;
+    break;
+  case AngularCoordinate::Galactic:
+    // Row i is the Galactic unit vector of our i-th axis, found with the
+    // scalar conversion so that the two stay consistent.
+    for (uint8_t i=0;i<3;i++) {
+      AngularCoordinate axis(i == 0 ? 1.0 : 0.0, i == 1 ? 1.0 : 0.0,
+			     i == 2 ? 1.0 : 0.0);
+      double gal_lon, gal_lat;
+      AngularCoordinate::EquatorialToGalactic(axis.RARadians(),
+					      axis.DECRadians(),
+					      gal_lon, gal_lat, true);
+      rotation[3*i] = cos(gal_lon)*cos(gal_lat);
+      rotation[3*i+1] = sin(gal_lon)*cos(gal_lat);
+      rotation[3*i+2] = sin(gal_lat);
+    }
+    break;
+  }
+}
+
+// sin and cos of the same argument, reduced by the nearest multiple of pi/2
+// (split three ways so the reduction stays exact for any angle we'll see) and
+// evaluated with the usual minimax polynomials on [-pi/4, pi/4]; the results
+// agree with libm to an ulp or so.  Unlike sin() and cos(), this is all
+// straight-line arithmetic and selects, so the compiler can vectorize the
+// loops that call it.  Adding and subtracting 1.5*2^52 rounds to the nearest
+// integer without a call to floor() or rint().
+static inline void BulkSinCos(double x, double& sin_x, double& cos_x) {
+  const double round = 6755399441055744.0;
+  double q = (x*0.63661977236758134308 + round) - round;
+  int32_t quadrant = static_cast<int32_t>(q);
+  double z = ((x - q*1.57079625129699707031e+00) -
+	      q*7.54978941586159635336e-08) - q*5.39030285815811905290e-15;
+  double zz = z*z;
+  double s = z + z*zz*(((((1.58962301576546568060e-10*zz -
+			   2.50507477628578072866e-8)*zz +
+			  2.75573136213857245213e-6)*zz -
+			 1.98412698295895385996e-4)*zz +
+			8.33333333332211858878e-3)*zz -
+		       1.66666666666666307295e-1);
+  double c = 1.0 - 0.5*zz + zz*zz*(((((-1.13585365213876817300e-11*zz +
+				       2.08757008419747316778e-9)*zz -
+				      2.75573141792967388112e-7)*zz +
+				     2.48015872888517045348e-5)*zz -
+				    1.38888888888730564116e-3)*zz +
+				   4.16666666666665929218e-2);
+
+  double swap_s = ((quadrant & 1) ? c : s);
+  double swap_c = ((quadrant & 1) ? s : c);
+  sin_x = ((quadrant & 2) ? -swap_s : swap_s);
+  cos_x = (((quadrant + 1) & 2) ? -swap_c : swap_c);
+}
+
+static void BulkToUnitSphere(const double* latitude, const double* longitude,
+			     uint32_t n_point, double* x, double* y, double* z,
+			     const double rotation[9], double longitude_offset,
+			     double scale) {
+  double a[BulkBlockSize], b[BulkBlockSize], c[BulkBlockSize];
+  double half_pi = 0.5*Pi;
+
+  for (uint32_t i=0;i<n_point;i++) {
+    double lat = latitude[i]*scale;
+    lat = (lat > half_pi ? half_pi : (lat < -half_pi ? -half_pi : lat));
+    double lon = longitude[i]*scale + longitude_offset;
+    double sin_lat, cos_lat, sin_lon, cos_lon;
+    BulkSinCos(lat, sin_lat, cos_lat);
+    BulkSinCos(lon, sin_lon, cos_lon);
+    a[i] = cos_lat*cos_lon;
+    b[i] = cos_lat*sin_lon;
+    c[i] = sin_lat;
+  }
+
+  for (uint32_t i=0;i<n_point;i++) {
+    x[i] = rotation[0]*a[i] + rotation[1]*b[i] + rotation[2]*c[i];
+    y[i] = rotation[3]*a[i] + rotation[4]*b[i] + rotation[5]*c[i];
+    z[i] = rotation[6]*a[i] + rotation[7]*b[i] + rotation[8]*c[i];
+  }
+}
+
+static void BulkFromUnitSphere(const double* x, const double* y,
+			       const double* z, uint32_t n_point,
+			       double* latitude, double* longitude,
+			       const double rotation[9], double longitude_offset,
+			       double longitude_min, double scale) {
+  double a[BulkBlockSize], b[BulkBlockSize], c[BulkBlockSize];
+  double two_pi = 2.0*Pi;
+  double longitude_max = longitude_min + two_pi;
+
+  for (uint32_t i=0;i<n_point;i++) {
+    a[i] = rotation[0]*x[i] + rotation[3]*y[i] + rotation[6]*z[i];
+    b[i] = rotation[1]*x[i] + rotation[4]*y[i] + rotation[7]*z[i];
+    c[i] = rotation[2]*x[i] + rotation[5]*y[i] + rotation[8]*z[i];
+  }
+
+  for (uint32_t i=0;i<n_point;i++) {
+    double lon = atan2(b[i], a[i]) - longitude_offset;
+    lon = (lon < longitude_min ? lon + two_pi :
+	   (lon >= longitude_max ? lon - two_pi : lon));
+    // atan2 rather than asin keeps the latitude accurate near the poles.
+    latitude[i] = atan2(c[i], sqrt(a[i]*a[i] + b[i]*b[i]))*scale;
+    longitude[i] = lon*scale;
+  }
+}
+
+// Survey longitudes run from -180 to 180; the others from 0 to 360.
+static double BulkLongitudeMin(AngularCoordinate::Sphere sphere) {
+  return (sphere == AngularCoordinate::Survey ? -Pi : 0.0);
+}
+
+void AngularCoordinate::ToUnitSphereCoordinates(const double* theta,
+						const double* phi,
+						uint32_t n_point,
+						double* unit_sphere_x,
+						double* unit_sphere_y,
+						double* unit_sphere_z,
+						Sphere sphere, bool radians,
+						uint32_t n_threads) {
+  double rotation[9], longitude_offset;
+  bool latitude_first;
+  BulkFrame(sphere, rotation, longitude_offset, latitude_first);
+  const double* latitude = (latitude_first ? theta : phi);
+  const double* longitude = (latitude_first ? phi : theta);
+  double scale = (radians ? 1.0 : DegToRad);
+
+  uint32_t task_size = BulkBlockSize*BulkBlocksPerTask;
+  uint32_t n_task = (n_point + task_size - 1)/task_size;
+  ParallelFor(n_task, n_threads, [&](uint32_t task) {
+    uint32_t end = (n_point - task*task_size > task_size ?
+		    (task + 1)*task_size : n_point);
+    for (uint32_t i=task*task_size;i<end;i+=BulkBlockSize) {
+      uint32_t n_block = (end - i > BulkBlockSize ? BulkBlockSize : end - i);
+      BulkToUnitSphere(latitude + i, longitude + i, n_block, unit_sphere_x + i,
+		       unit_sphere_y + i, unit_sphere_z + i, rotation,
+		       longitude_offset, scale);
+    }
+  });
+}
+
+void AngularCoordinate::FromUnitSphereCoordinates(const double* unit_sphere_x,
+						  const double* unit_sphere_y,
+						  const double* unit_sphere_z,
+						  uint32_t n_point,
+						  double* theta, double* phi,
+						  Sphere sphere, bool radians,
+						  uint32_t n_threads) {
+  double rotation[9], longitude_offset;
+  bool latitude_first;
+  BulkFrame(sphere, rotation, longitude_offset, latitude_first);
+  double* latitude = (latitude_first ? theta : phi);
+  double* longitude = (latitude_first ? phi : theta);
+  double longitude_min = BulkLongitudeMin(sphere);
+  double scale = (radians ? 1.0 : RadToDeg);
+
+  uint32_t task_size = BulkBlockSize*BulkBlocksPerTask;
+  uint32_t n_task = (n_point + task_size - 1)/task_size;
+  ParallelFor(n_task, n_threads, [&](uint32_t task) {
+    uint32_t end = (n_point - task*task_size > task_size ?
+		    (task + 1)*task_size : n_point);
+    for (uint32_t i=task*task_size;i<end;i+=BulkBlockSize) {
+      uint32_t n_block = (end - i > BulkBlockSize ? BulkBlockSize : end - i);
+      BulkFromUnitSphere(unit_sphere_x + i, unit_sphere_y + i,
+			 unit_sphere_z + i, n_block, latitude + i, longitude + i,
+			 rotation, longitude_offset, longitude_min, scale);
+    }
+  });
+}
+
+void AngularCoordinate::ConvertCoordinates(const double* theta,
+					   const double* phi,
+					   uint32_t n_point,
+					   Sphere input_sphere,
+					   double* output_theta,
+					   double* output_phi,
+					   Sphere output_sphere, bool radians,
+					   uint32_t n_threads) {
+  double input_rotation[9], input_offset;
+  double output_rotation[9], output_offset;
+  bool input_latitude_first, output_latitude_first;
+  BulkFrame(input_sphere, input_rotation, input_offset, input_latitude_first);
+  BulkFrame(output_sphere, output_rotation, output_offset,
+	    output_latitude_first);
+  const double* latitude = (input_latitude_first ? theta : phi);
+  const double* longitude = (input_latitude_first ? phi : theta);
+  double* output_latitude = (output_latitude_first ? output_theta : output_phi);
+  double* output_longitude =
+    (output_latitude_first ? output_phi : output_theta);
+  double longitude_min = BulkLongitudeMin(output_sphere);
+  double input_scale = (radians ? 1.0 : DegToRad);
+  double output_scale = (radians ? 1.0 : RadToDeg);
+
+  uint32_t task_size = BulkBlockSize*BulkBlocksPerTask;
+  uint32_t n_task = (n_point + task_size - 1)/task_size;
+  ParallelFor(n_task, n_threads, [&](uint32_t task) {
+    double x[BulkBlockSize], y[BulkBlockSize], z[BulkBlockSize];
+    uint32_t end = (n_point - task*task_size > task_size ?
+		    (task + 1)*task_size : n_point);
+    for (uint32_t i=task*task_size;i<end;i+=BulkBlockSize) {
+      uint32_t n_block = (end - i > BulkBlockSize ? BulkBlockSize : end - i);
+      BulkToUnitSphere(latitude + i, longitude + i, n_block, x, y, z,
+		       input_rotation, input_offset, input_scale);
+      BulkFromUnitSphere(x, y, z, n_block, output_latitude + i,
+			 output_longitude + i,
+			 output_rotation, output_offset, longitude_min,
+			 output_scale);
+    }
+  });
+}
+
+bool AngularCoordinate::ToUnitSphereCoordinates(std::vector<double>& thetaVec,
+						std::vector<double>& phiVec,
+						std::vector<double>& xVec,
+						std::vector<double>& yVec,
+						std::vector<double>& zVec,
+						Sphere sphere, bool radians,
+						uint32_t n_threads) {
+  if (thetaVec.size() != phiVec.size()) return false;
+
+  xVec.resize(thetaVec.size());
+  yVec.resize(thetaVec.size());
+  zVec.resize(thetaVec.size());
+  if (thetaVec.empty()) return true;
+
+  ToUnitSphereCoordinates(&thetaVec[0], &phiVec[0], thetaVec.size(),
+			  &xVec[0], &yVec[0], &zVec[0], sphere, radians,
+			  n_threads);
+  return true;
+}
+
+bool AngularCoordinate::FromUnitSphereCoordinates(std::vector<double>& xVec,
+						  std::vector<double>& yVec,
+						  std::vector<double>& zVec,
+						  std::vector<double>& thetaVec,
+						  std::vector<double>& phiVec,
+						  Sphere sphere, bool radians,
+						  uint32_t n_threads) {
+  if ((xVec.size() != yVec.size()) || (xVec.size() != zVec.size()))
+    return false;
+
+  thetaVec.resize(xVec.size());
+  phiVec.resize(xVec.size());
+  if (xVec.empty()) return true;
+
+  FromUnitSphereCoordinates(&xVec[0], &yVec[0], &zVec[0], xVec.size(),
+			    &thetaVec[0], &phiVec[0], sphere, radians,
+			    n_threads);
+  return true;
+}
+
+bool AngularCoordinate::ConvertCoordinates(std::vector<double>& thetaVec,
+					   std::vector<double>& phiVec,
+					   Sphere input_sphere,
+					   std::vector<double>& output_thetaVec,
+					   std::vector<double>& output_phiVec,
+					   Sphere output_sphere, bool radians,
+					   uint32_t n_threads) {
+  if (thetaVec.size() != phiVec.size()) return false;
+
+  output_thetaVec.resize(thetaVec.size());
+  output_phiVec.resize(thetaVec.size());
+  if (thetaVec.empty()) return true;
+
+  ConvertCoordinates(&thetaVec[0], &phiVec[0], thetaVec.size(), input_sphere,
+		     &output_thetaVec[0], &output_phiVec[0], output_sphere,
+		     radians, n_threads);
+  return true;
+}
+
 double AngularCoordinate::EtaMultiplier(double lam) {
   return 1.0 +
     lam*lam*(0.000192312 - lam*lam*(1.82764e-08 + 1.28162e-11*lam*lam));
@@ -809,8 +1109,11 @@ bool AngularCoordinate::ToAngularVector(std::vector<double>& thetaVec,
 
     ang.reserve(thetaVec.size());
 
+    std::vector<double> xVec, yVec, zVec;
+    ToUnitSphereCoordinates(thetaVec, phiVec, xVec, yVec, zVec,
+			    sphere, radians);
     for (uint32_t i=0;i<thetaVec.size();i++)
-      ang.push_back(AngularCoordinate(thetaVec[i], phiVec[i], sphere, radians));
+      ang.push_back(AngularCoordinate(xVec[i], yVec[i], zVec[i]));
 
     io_success = true;
   }
@@ -828,34 +1131,29 @@ bool AngularCoordinate::ToAngularVector(const std::string& input_file,
   bool io_success = false;
 
   if (theta_column != phi_column) {
-    std::ifstream input_file_str(input_file.c_str());
-
-    uint32_t n_lines = 0;
-
-    if (input_file_str) {
-      while (!input_file_str.eof()) {
-	if (!input_file_str.eof()) {
-	  // This should read each line into a buffer, convert that buffer into
-	  // a string and then break that string into a vector of strings.  We
-	  // should then be able to access theta and phi by converting the
-	  // appropriate elements of that vector to doubles.
-	  char line_buffer[1000];
-	  std::vector<std::string> line_elements;
-
-	  input_file_str.getline(line_buffer, 1000);
-	  std::string line_string(line_buffer);
-	  Tokenize(line_string, line_elements, " ");
-	  n_lines++;
-
-	  if ((line_elements.size() > theta_column) &&
-	      (line_elements.size() > phi_column)) {
-	    double theta = strtod(line_elements[theta_column].c_str(), NULL);
-	    double phi = strtod(line_elements[phi_column].c_str(), NULL);
-	    ang.push_back(AngularCoordinate(theta, phi, sphere, radians));
-	  }
-	}
-      }
-      input_file_str.close();
+    // The file is parsed in parallel by AsciiTable; lines that don't reach
+    // both coordinate columns are skipped.
+    std::vector<uint8_t> columns;
+    columns.push_back(theta_column);
+    columns.push_back(phi_column);
+    AsciiTable table;
+
+    if (table.Read(input_file, columns)) {
+      std::vector<uint32_t> rows;
+      rows.reserve(table.NRows());
+      for (uint32_t i=0;i<table.NRows();i++)
+	if (table.Complete(i)) rows.push_back(i);
+
+      ang.resize(rows.size());
+      const uint32_t block_size = 4096;
+      uint32_t n_block = (rows.size() + block_size - 1)/block_size;
+      ParallelFor(n_block, DefaultThreads(), [&](uint32_t block) {
+	uint32_t end = (block + 1)*block_size;
+	if (end > rows.size()) end = rows.size();
+	for (uint32_t i=block*block_size;i<end;i++)
+	  ang[i] = AngularCoordinate(table.Value(rows[i], 0),
+				     table.Value(rows[i], 1), sphere, radians);
+      });
       io_success = true;
     } else {
       std::cout << "Stomp::AngularCoordinate::ToAngularVector - " <<
@@ -1120,9 +1418,12 @@ bool WeightedAngularCoordinate::ToWAngularVector(std::vector<double>& thetaVec,
 
     w_ang.reserve(thetaVec.size());
 
+    std::vector<double> xVec, yVec, zVec;
+    ToUnitSphereCoordinates(thetaVec, phiVec, xVec, yVec, zVec,
+			    sphere, radians);
     for (uint32_t i=0;i<thetaVec.size();i++)
-      w_ang.push_back(WeightedAngularCoordinate(thetaVec[i], phiVec[i],
-						weightVec[i], sphere, radians));
+      w_ang.push_back(WeightedAngularCoordinate(xVec[i], yVec[i], zVec[i],
+						weightVec[i]));
 
     io_success = true;
   }
@@ -1143,9 +1444,12 @@ bool WeightedAngularCoordinate::ToWAngularVector(std::vector<double>& thetaVec,
 
     w_ang.reserve(thetaVec.size());
 
+    std::vector<double> xVec, yVec, zVec;
+    ToUnitSphereCoordinates(thetaVec, phiVec, xVec, yVec, zVec,
+			    sphere, radians);
     for (uint32_t i=0;i<thetaVec.size();i++)
-      w_ang.push_back(WeightedAngularCoordinate(thetaVec[i], phiVec[i],
-						weight, sphere, radians));
+      w_ang.push_back(WeightedAngularCoordinate(xVec[i], yVec[i], zVec[i],
+						weight));
 
     io_success = true;
   }
@@ -1160,53 +1464,9 @@ bool WeightedAngularCoordinate::ToWAngularVector(const std::string& input_file,
 						 uint8_t theta_column,
 						 uint8_t phi_column,
 						 int8_t weight_column) {
-
-  if (!w_ang.empty()) w_ang.clear();
-  bool io_success = false;
-
-  if (theta_column != phi_column) {
-    std::ifstream input_file_str(input_file.c_str());
-
-    uint32_t n_lines = 0;
-    uint8_t weight_idx = static_cast<uint8_t>(weight_column);
-
-    if (input_file_str) {
-      while (!input_file_str.eof()) {
-	if (!input_file_str.eof()) {
-	  // This should read each line into a buffer, convert that buffer into
-	  // a string and then break that string into a vector of strings.  We
-	  // should then be able to access theta and phi by converting the
-	  // appropriate elements of that vector to doubles.
-	  char line_buffer[1000];
-	  std::vector<std::string> line_elements;
-
-	  input_file_str.getline(line_buffer, 1000);
-	  std::string line_string(line_buffer);
-	  Tokenize(line_string, line_elements, " ");
-	  n_lines++;
-
-	  if ((line_elements.size() > theta_column) &&
-	      (line_elements.size() > phi_column)) {
-	    double theta = strtod(line_elements[theta_column].c_str(), NULL);
-	    double phi = strtod(line_elements[phi_column].c_str(), NULL);
-	    double weight = 1.0;
-	    if ((weight_column > -1) &&
-		(line_elements.size() > weight_idx))
-	      weight = strtod(line_elements[weight_idx].c_str(), NULL);
-	    w_ang.push_back(WeightedAngularCoordinate(theta, phi, weight,
-						      sphere, radians));
-	  }
-	}
-      }
-      input_file_str.close();
-      io_success = true;
-    } else {
-      std::cout << "Stomp::WeightedAngularCoordinate::ToWAngularVector - " <<
-	input_file << " does not exist!\n";
-    }
-  }
-
-  return io_success;
+  FieldColumnDict field_columns;
+  return ToWAngularVector(input_file, w_ang, field_columns, sphere, radians,
+			  theta_column, phi_column, weight_column);
 }
 
 bool WeightedAngularCoordinate::FromWAngularVector(WAngularVector& w_ang,
@@ -1321,52 +1581,50 @@ bool WeightedAngularCoordinate::ToWAngularVector(const std::string& input_file,
   bool io_success = false;
 
   if (theta_column != phi_column) {
-    std::ifstream input_file_str(input_file.c_str());
-
-    uint32_t n_lines = 0;
-    uint8_t weight_idx = static_cast<uint8_t>(weight_column);
-
-    if (input_file_str) {
-      while (!input_file_str.eof()) {
-	if (!input_file_str.eof()) {
-	  // This should read each line into a buffer, convert that buffer into
-	  // a string and then break that string into a vector of strings.  We
-	  // should then be able to access theta and phi by converting the
-	  // appropriate elements of that vector to doubles.
-	  char line_buffer[1000];
-	  std::vector<std::string> line_elements;
-
-	  input_file_str.getline(line_buffer, 1000);
-	  std::string line_string(line_buffer);
-	  Tokenize(line_string, line_elements, " ");
-	  n_lines++;
-
-	  if ((line_elements.size() > theta_column) &&
-	      (line_elements.size() > phi_column)) {
-	    double theta = strtod(line_elements[theta_column].c_str(), NULL);
-	    double phi = strtod(line_elements[phi_column].c_str(), NULL);
-	    double weight = 1.0;
-	    if ((weight_column > -1) &&
-		(line_elements.size() > weight_idx)) {
-	      weight = strtod(line_elements[weight_idx].c_str(), NULL);
-	    }
-
-	    FieldDict fields;
-	    for (FieldColumnIterator iter=field_columns.begin();
-		 iter!=field_columns.end();++iter) {
-	      fields[iter->first] = 0.0;
-	      if (line_elements.size() > iter->second) {
-		fields[iter->first] =
-		  strtod(line_elements[iter->second].c_str(), NULL);
-	      }
-	    }
-
-	    w_ang.push_back(WeightedAngularCoordinate(theta, phi, weight,
-						      fields, sphere, radians));
-	  }
+    // The table columns are theta, phi, weight (if requested) and then the
+    // Field columns in FieldColumnDict order.  Only theta and phi are
+    // required; missing weights are unity and missing Fields are 0.
+    std::vector<uint8_t> columns;
+    columns.push_back(theta_column);
+    columns.push_back(phi_column);
+    uint8_t field_start = 2;
+    if (weight_column > -1) {
+      columns.push_back(static_cast<uint8_t>(weight_column));
+      field_start++;
+    }
+    for (FieldColumnIterator iter=field_columns.begin();
+	 iter!=field_columns.end();++iter) columns.push_back(iter->second);
+    AsciiTable table;
+
+    if (table.Read(input_file, columns)) {
+      std::vector<uint32_t> rows;
+      rows.reserve(table.NRows());
+      for (uint32_t i=0;i<table.NRows();i++)
+	if (table.HasValue(i, 0) && table.HasValue(i, 1)) rows.push_back(i);
+
+      w_ang.resize(rows.size());
+      const uint32_t block_size = 4096;
+      uint32_t n_block = (rows.size() + block_size - 1)/block_size;
+      ParallelFor(n_block, DefaultThreads(), [&](uint32_t block) {
+	uint32_t end = (block + 1)*block_size;
+	if (end > rows.size()) end = rows.size();
+	for (uint32_t i=block*block_size;i<end;i++) {
+	  uint32_t row = rows[i];
+	  double weight = 1.0;
+	  if ((weight_column > -1) && table.HasValue(row, 2))
+	    weight = table.Value(row, 2);
+
+	  FieldDict fields;
+	  uint8_t k = field_start;
+	  for (FieldColumnIterator iter=field_columns.begin();
+	       iter!=field_columns.end();++iter,k++)
+	    fields[iter->first] = table.Value(row, k);
+
+	  w_ang[i] = WeightedAngularCoordinate(table.Value(row, 0),
+					       table.Value(row, 1), weight,
+					       fields, sphere, radians);
 	}
-      }
-      input_file_str.close();
+      });
       io_success = true;
     } else {
       std::cout << "Stomp::WeightedAngularCoordinate::ToWAngularVector - " <<
@@ -1606,43 +1864,37 @@ bool CosmoCoordinate::ToCosmoVector(const std::string& input_file,
   bool io_success = false;
 
   if (theta_column != phi_column) {
-    std::ifstream input_file_str(input_file.c_str());
-
-    uint32_t n_lines = 0;
-    uint8_t weight_idx = static_cast<uint8_t>(weight_column);
-
-    if (input_file_str) {
-      while (!input_file_str.eof()) {
-	if (!input_file_str.eof()) {
-	  // This should read each line into a buffer, convert that buffer into
-	  // a string and then break that string into a vector of strings.  We
-	  // should then be able to access theta and phi by converting the
-	  // appropriate elements of that vector to doubles.
-	  char line_buffer[1000];
-	  std::vector<std::string> line_elements;
-
-	  input_file_str.getline(line_buffer, 1000);
-	  std::string line_string(line_buffer);
-	  Tokenize(line_string, line_elements, " ");
-	  n_lines++;
-
-	  if ((line_elements.size() > theta_column) &&
-	      (line_elements.size() > phi_column) &&
-	      (line_elements.size() > redshift_column)) {
-	    double theta = strtod(line_elements[theta_column].c_str(), NULL);
-	    double phi = strtod(line_elements[phi_column].c_str(), NULL);
-	    double redshift =
-	      strtod(line_elements[redshift_column].c_str(), NULL);
-	    double weight = 1.0;
-	    if ((weight_column > -1) &&
-		(line_elements.size() > weight_idx))
-	      weight = strtod(line_elements[weight_idx].c_str(), NULL);
-	    z_ang.push_back(CosmoCoordinate(theta, phi, redshift,
-					    weight, sphere, radians));
-	  }
+    std::vector<uint8_t> columns;
+    columns.push_back(theta_column);
+    columns.push_back(phi_column);
+    columns.push_back(redshift_column);
+    if (weight_column > -1)
+      columns.push_back(static_cast<uint8_t>(weight_column));
+    AsciiTable table;
+
+    if (table.Read(input_file, columns)) {
+      std::vector<uint32_t> rows;
+      rows.reserve(table.NRows());
+      for (uint32_t i=0;i<table.NRows();i++)
+	if (table.HasValue(i, 0) && table.HasValue(i, 1) &&
+	    table.HasValue(i, 2)) rows.push_back(i);
+
+      z_ang.resize(rows.size());
+      const uint32_t block_size = 4096;
+      uint32_t n_block = (rows.size() + block_size - 1)/block_size;
+      ParallelFor(n_block, DefaultThreads(), [&](uint32_t block) {
+	uint32_t end = (block + 1)*block_size;
+	if (end > rows.size()) end = rows.size();
+	for (uint32_t i=block*block_size;i<end;i++) {
+	  uint32_t row = rows[i];
+	  double weight = 1.0;
+	  if ((weight_column > -1) && table.HasValue(row, 3))
+	    weight = table.Value(row, 3);
+	  z_ang[i] = CosmoCoordinate(table.Value(row, 0), table.Value(row, 1),
+				     table.Value(row, 2), weight, sphere,
+				     radians);
 	}
-      }
-      input_file_str.close();
+      });
       io_success = true;
     }
   }
@@ -1852,42 +2104,36 @@ bool IndexedAngularCoordinate::ToIAngularVector(const std::string& input_file,
   bool io_success = false;
 
   if (theta_column != phi_column) {
-    std::ifstream input_file_str(input_file.c_str());
-
-    uint32_t n_lines = 0;
-    uint8_t index_idx = static_cast<uint8_t>(index_column);
-
-    if (input_file_str) {
-      while (!input_file_str.eof()) {
-	if (!input_file_str.eof()) {
-	  // This should read each line into a buffer, convert that buffer into
-	  // a string and then break that string into a vector of strings.  We
-	  // should then be able to access theta and phi by converting the
-	  // appropriate elements of that vector to doubles.
-	  char line_buffer[1000];
-	  std::vector<std::string> line_elements;
-
-	  input_file_str.getline(line_buffer, 1000);
-	  std::string line_string(line_buffer);
-	  Tokenize(line_string, line_elements, " ");
-
-	  if ((line_elements.size() > theta_column) &&
-	      (line_elements.size() > phi_column)) {
-	    double theta = strtod(line_elements[theta_column].c_str(), NULL);
-	    double phi = strtod(line_elements[phi_column].c_str(), NULL);
-	    uint32_t index = n_lines;
-	    if ((index_column > -1) &&
-		(line_elements.size() > index_idx))
-	      index =
-		static_cast<uint32_t>(strtoul(line_elements[index_idx].c_str(),
-					      NULL, 10));
-	    i_ang.push_back(IndexedAngularCoordinate(theta, phi, index,
-						     sphere, radians));
-	  }
-	  n_lines++;
+    std::vector<uint8_t> columns;
+    columns.push_back(theta_column);
+    columns.push_back(phi_column);
+    if (index_column > -1)
+      columns.push_back(static_cast<uint8_t>(index_column));
+    AsciiTable table;
+
+    if (table.Read(input_file, columns)) {
+      std::vector<uint32_t> rows;
+      rows.reserve(table.NRows());
+      for (uint32_t i=0;i<table.NRows();i++)
+	if (table.HasValue(i, 0) && table.HasValue(i, 1)) rows.push_back(i);
+
+      // Without an index column, the index is the line number in the file.
+      i_ang.resize(rows.size());
+      const uint32_t block_size = 4096;
+      uint32_t n_block = (rows.size() + block_size - 1)/block_size;
+      ParallelFor(n_block, DefaultThreads(), [&](uint32_t block) {
+	uint32_t end = (block + 1)*block_size;
+	if (end > rows.size()) end = rows.size();
+	for (uint32_t i=block*block_size;i<end;i++) {
+	  uint32_t row = rows[i];
+	  uint32_t index = row;
+	  if ((index_column > -1) && table.HasValue(row, 2))
+	    index = static_cast<uint32_t>(table.Value(row, 2));
+	  i_ang[i] = IndexedAngularCoordinate(table.Value(row, 0),
+					      table.Value(row, 1), index,
+					      sphere, radians);
 	}
-      }
-      input_file_str.close();
+      });
       io_success = true;
     }
   }
@@ -27,6 +27,7 @@
 #include <string>
 #include <vector>
 #include <map>
+#include "stomp_core.h"
 
 namespace Stomp {
 
@@ -214,6 +215,57 @@ class AngularCoordinate {
 			    double& x, double& y, double& z,
 			    bool radians = false);
 
+  // Bulk versions of the conversions above for structure-of-arrays buffers.
+  // The work is done in fixed-size blocks: one pass does all of the trig for
+  // a block, and the change of coordinate system is then a 3x3 rotation of
+  // the unit vectors.  Those passes are simple loops over contiguous arrays
+  // that the compiler can vectorize.  Large inputs are also split over
+  // n_threads threads.  The pointer versions write n_point values to each
+  // output array; ConvertCoordinates may write over its inputs.  The vector
+  // versions return false if the input lengths don't match.
+  static void ToUnitSphereCoordinates(const double* theta, const double* phi,
+				      uint32_t n_point, double* unit_sphere_x,
+				      double* unit_sphere_y,
+				      double* unit_sphere_z,
+				      Sphere sphere = Equatorial,
+				      bool radians = false,
+				      uint32_t n_threads = DefaultThreads());
+  static void FromUnitSphereCoordinates(const double* unit_sphere_x,
+					const double* unit_sphere_y,
+					const double* unit_sphere_z,
+					uint32_t n_point, double* theta,
+					double* phi, Sphere sphere = Equatorial,
+					bool radians = false,
+					uint32_t n_threads = DefaultThreads());
+  static void ConvertCoordinates(const double* theta, const double* phi,
+				 uint32_t n_point, Sphere input_sphere,
+				 double* output_theta, double* output_phi,
+				 Sphere output_sphere, bool radians = false,
+				 uint32_t n_threads = DefaultThreads());
+  static bool ToUnitSphereCoordinates(std::vector<double>& thetaVec,
+				      std::vector<double>& phiVec,
+				      std::vector<double>& xVec,
+				      std::vector<double>& yVec,
+				      std::vector<double>& zVec,
+				      Sphere sphere = Equatorial,
+				      bool radians = false,
+				      uint32_t n_threads = DefaultThreads());
+  static bool FromUnitSphereCoordinates(std::vector<double>& xVec,
+					std::vector<double>& yVec,
+					std::vector<double>& zVec,
+					std::vector<double>& thetaVec,
+					std::vector<double>& phiVec,
+					Sphere sphere = Equatorial,
+					bool radians = false,
+					uint32_t n_threads = DefaultThreads());
+  static bool ConvertCoordinates(std::vector<double>& thetaVec,
+				 std::vector<double>& phiVec,
+				 Sphere input_sphere,
+				 std::vector<double>& output_thetaVec,
+				 std::vector<double>& output_phiVec,
+				 Sphere output_sphere, bool radians = false,
+				 uint32_t n_threads = DefaultThreads());
+
   // This is a bit more obscure.  The idea here is that, when you want to find
   // the pixel bounds that subtend a given angular scale about a point on the
   // sphere, finding those bounds in latitude is easier than in longitude.
@@ -4,6 +4,8 @@
 #include <fstream>
 #include <math.h>
 #include <string>
+#include <algorithm>
+#include <vector>
 #include <gflags/gflags.h>
 #include "stomp_core.h"
 #include "stomp_angular_coordinate.h"
@@ -335,6 +337,134 @@ void AngularVectorIOTests() {
   }
 }
 
+void AngularCoordinateBulkConversionTests() {
+  // The bulk conversions should agree with the scalar methods for every pair
+  // of coordinate systems and shouldn't depend on the number of threads.
+  std::cout << "\n";
+  std::cout << "*****************************************\n";
+  std::cout << "*** AngularCoordinate Bulk Conversion ***\n";
+  std::cout << "*****************************************\n\n";
+
+  // A grid of positions covering the sphere, including the poles and both
+  // ends of the longitude range.
+  std::vector<double> latVec, lonVec;
+  for (int lat=-90;lat<=90;lat+=5) {
+    for (int lon=-180;lon<=360;lon+=5) {
+      latVec.push_back(1.0*lat);
+      lonVec.push_back(1.0*lon);
+    }
+  }
+  std::cout << "\tConverting " << latVec.size() << " positions...\n";
+
+  Stomp::AngularCoordinate::Sphere spheres[3] = {
+    Stomp::AngularCoordinate::Survey,
+    Stomp::AngularCoordinate::Equatorial,
+    Stomp::AngularCoordinate::Galactic
+  };
+  std::string sphere_names[3] = {"Survey", "Equatorial", "Galactic"};
+
+  for (uint8_t i=0;i<3;i++) {
+    // Survey coordinates are (lambda, eta); the others are (lon, lat).
+    bool survey_input = (spheres[i] == Stomp::AngularCoordinate::Survey);
+    std::vector<double>& thetaVec = (survey_input ? latVec : lonVec);
+    std::vector<double>& phiVec = (survey_input ? lonVec : latVec);
+
+    Stomp::AngularVector ang;
+    Stomp::AngularCoordinate::ToAngularVector(thetaVec, phiVec, ang,
+					      spheres[i]);
+
+    // Check the unit vectors against those from the scalar setters.
+    double max_unit_diff = 0.0;
+    for (uint32_t k=0;k<ang.size();k++) {
+      Stomp::AngularCoordinate tmp_ang(thetaVec[k], phiVec[k], spheres[i]);
+      max_unit_diff = std::max(max_unit_diff,
+			       fabs(tmp_ang.DotProduct(ang[k]) - 1.0));
+    }
+
+    for (uint8_t j=0;j<3;j++) {
+      std::vector<double> out_theta, out_phi, thread_theta, thread_phi;
+      Stomp::AngularCoordinate::ConvertCoordinates(thetaVec, phiVec,
+						   spheres[i], out_theta,
+						   out_phi, spheres[j], false, 1);
+      Stomp::AngularCoordinate::ConvertCoordinates(thetaVec, phiVec,
+						   spheres[i], thread_theta,
+						   thread_phi, spheres[j],
+						   false, 4);
+
+      double max_diff = 0.0;
+      uint32_t n_match = 0;
+      for (uint32_t k=0;k<thetaVec.size();k++) {
+	Stomp::AngularCoordinate tmp_ang(thetaVec[k], phiVec[k], spheres[i]);
+	if ((out_theta[k] == thread_theta[k]) &&
+	    (out_phi[k] == thread_phi[k])) n_match++;
+
+	// Compare against what the scalar accessors give for the output
+	// coordinate system.
+	double out_lat = out_phi[k], out_lon = out_theta[k];
+	double scalar_lat, scalar_lon;
+	switch (spheres[j]) {
+	case Stomp::AngularCoordinate::Survey:
+	  out_lat = out_theta[k];
+	  out_lon = out_phi[k];
+	  scalar_lat = tmp_ang.Lambda();
+	  scalar_lon = tmp_ang.Eta();
+	  break;
+	case Stomp::AngularCoordinate::Equatorial:
+	  scalar_lat = tmp_ang.DEC();
+	  scalar_lon = tmp_ang.RA();
+	  break;
+	default:
+	  scalar_lat = tmp_ang.GalLat();
+	  scalar_lon = tmp_ang.GalLon();
+	  break;
+	}
+
+	// The scalar Galactic round trip is only good to ~1e-4 degrees near
+	// the poles (the rotation constants are rounded), so check the identity
+	// conversions against the input instead.
+	if (i == j) {
+	  scalar_lat = (survey_input ? thetaVec[k] : phiVec[k]);
+	  scalar_lon = (survey_input ? phiVec[k] : thetaVec[k]);
+	}
+
+	// Use the chord length; acos is too coarse for offsets this small.
+	double lat = out_lat*Stomp::DegToRad, lon = out_lon*Stomp::DegToRad;
+	double s_lat = scalar_lat*Stomp::DegToRad;
+	double s_lon = scalar_lon*Stomp::DegToRad;
+	double dx = cos(lat)*cos(lon) - cos(s_lat)*cos(s_lon);
+	double dy = cos(lat)*sin(lon) - cos(s_lat)*sin(s_lon);
+	double dz = sin(lat) - sin(s_lat);
+	max_diff = std::max(max_diff,
+			    sqrt(dx*dx + dy*dy + dz*dz)*Stomp::RadToDeg);
+
+	// Away from the poles, the longitudes should also be in the same
+	// range as the scalar accessors return (the endpoints of the range may
+	// differ by a full turn).
+	double lon_diff = fabs(out_lon - scalar_lon);
+	if ((fabs(out_lat) < 89.0) && (lon_diff > 1.0e-6) &&
+	    (fabs(lon_diff - 360.0) > 1.0e-6)) {
+	  std::cout << "\t\tLongitude mismatch: " << out_lon <<
+	    " vs. " << scalar_lon << "\n";
+	  exit(1);
+	}
+      }
+      std::cout << "\t" << sphere_names[i] << " -> " << sphere_names[j] <<
+	": max offset " << max_diff << " degrees, " << n_match << "/" <<
+	thetaVec.size() << " match between 1 and 4 threads.\n";
+      if ((max_diff > 1.0e-8) || (n_match != thetaVec.size())) {
+	std::cout << "\t\tBad.  Bulk conversion doesn't match.\n";
+	exit(1);
+      }
+    }
+    std::cout << "\t" << sphere_names[i] << " unit vectors: max 1-cos(d) " <<
+      max_unit_diff << "\n";
+    if (max_unit_diff > 1.0e-12) {
+      std::cout << "\t\tBad.  Bulk unit vectors don't match.\n";
+      exit(1);
+    }
+  }
+}
+
 void AngularVectorFileIOTests() {
   // Check to make sure that our static methods for reading ASCII files into
   // AngularVectors are working properly..
@@ -622,6 +752,8 @@ DEFINE_bool(angular_vector_io_tests, false,
             "Run AngularVector I/O tests ");
 DEFINE_bool(angular_vector_file_io_tests, false,
             "Run AngularVector file I/O tests ");
+DEFINE_bool(angular_coordinate_bulk_conversion_tests, false,
+            "Run AngularCoordinate bulk conversion tests");
 DEFINE_bool(weighted_angular_coordinate_basic_tests, false,
             "Run WeightedAngularCoordinate basic tests");
 DEFINE_bool(wangular_vector_file_io_tests, false,
@@ -635,6 +767,7 @@ void AngularCoordinateUnitTests(bool run_all_tests) {
   void AngularCoordinateRotationTests();
   void AngularVectorIOTests();
   void AngularVectorFileIOTests();
+  void AngularCoordinateBulkConversionTests();
   void WeightedAngularCoordinateBasicTests();
   void WAngularVectorFileIOTests();
 
@@ -681,6 +814,11 @@ void AngularCoordinateUnitTests(bool run_all_tests) {
   if (FLAGS_all_angular_coordinate_tests || FLAGS_angular_vector_file_io_tests)
     AngularVectorFileIOTests();
 
+  // Check that the bulk coordinate conversions agree with the scalar ones.
+  if (FLAGS_all_angular_coordinate_tests ||
+      FLAGS_angular_coordinate_bulk_conversion_tests)
+    AngularCoordinateBulkConversionTests();
+
   // Check WeightedAngularCoordinate extensions to the basic AngularCoordinate.
   if (FLAGS_all_angular_coordinate_tests ||
       FLAGS_weighted_angular_coordinate_basic_tests)
@@ -13,11 +13,18 @@
 // large angular scales, so this class draws on nearly the entire breadth of
 // the STOMP library.
 
+#include <cstdio>
+#include <algorithm>
+#include <sstream>
+#include <utility>
 #include "stomp_core.h"
 #include "stomp_angular_correlation.h"
+#include "stomp_pixel.h"
 #include "stomp_map.h"
 #include "stomp_scalar_map.h"
 #include "stomp_tree_map.h"
+#include "stomp_point_catalog.h"
+#include "stomp_instrumentation.h"
 
 namespace Stomp {
 
@@ -28,6 +35,53 @@ AngularCorrelation::AngularCorrelation() {
   regionation_resolution_ = 0;
   n_region_ = -1;
   manual_resolution_break_ = false;
+  _InitializeCheckpoint();
+  _InitializeTuning();
+  theta_pixel_begin_ = theta_pixel_end_ = thetabin_.end();
+  theta_pair_begin_ = theta_pair_end_ = thetabin_.end();
+}
+
+AngularCorrelation::AngularCorrelation(const AngularCorrelation& wtheta) {
+  _CopyFrom(wtheta);
+}
+
+AngularCorrelation& AngularCorrelation::operator=(
+  const AngularCorrelation& wtheta) {
+  if (this != &wtheta) _CopyFrom(wtheta);
+  return *this;
+}
+
+void AngularCorrelation::_CopyFrom(const AngularCorrelation& wtheta) {
+  thetabin_ = wtheta.thetabin_;
+  theta_min_ = wtheta.theta_min_;
+  theta_max_ = wtheta.theta_max_;
+  sin2theta_min_ = wtheta.sin2theta_min_;
+  sin2theta_max_ = wtheta.sin2theta_max_;
+  min_resolution_ = wtheta.min_resolution_;
+  max_resolution_ = wtheta.max_resolution_;
+  regionation_resolution_ = wtheta.regionation_resolution_;
+  n_region_ = wtheta.n_region_;
+  manual_resolution_break_ = wtheta.manual_resolution_break_;
+  checkpoint_file_ = wtheta.checkpoint_file_;
+  completed_stages_ = wtheta.completed_stages_;
+  random_iterations_ = wtheta.random_iterations_;
+  randoms_normalized_ = wtheta.randoms_normalized_;
+  tree_resolution_ = wtheta.tree_resolution_;
+  tree_node_capacity_ = wtheta.tree_node_capacity_;
+  auto_tune_ = wtheta.auto_tune_;
+  tuning_pair_seconds_ = wtheta.tuning_pair_seconds_;
+  tuning_pixel_seconds_ = wtheta.tuning_pixel_seconds_;
+  tuning_seconds_ = wtheta.tuning_seconds_;
+
+  ThetaVector& source_bins = const_cast<ThetaVector&>(wtheta.thetabin_);
+  theta_pixel_begin_ =
+    thetabin_.begin() + (wtheta.theta_pixel_begin_ - source_bins.begin());
+  theta_pixel_end_ =
+    thetabin_.begin() + (wtheta.theta_pixel_end_ - source_bins.begin());
+  theta_pair_begin_ =
+    thetabin_.begin() + (wtheta.theta_pair_begin_ - source_bins.begin());
+  theta_pair_end_ =
+    thetabin_.begin() + (wtheta.theta_pair_end_ - source_bins.begin());
 }
 
 AngularCorrelation::AngularCorrelation(double theta_min, double theta_max,
@@ -74,6 +128,8 @@ AngularCorrelation::AngularCorrelation(double theta_min, double theta_max,
   }
 
   manual_resolution_break_ = false;
+  _InitializeCheckpoint();
+  _InitializeTuning();
 }
 
 AngularCorrelation::AngularCorrelation(uint32_t n_bins,
@@ -114,6 +170,8 @@ AngularCorrelation::AngularCorrelation(uint32_t n_bins,
   }
 
   manual_resolution_break_ = false;
+  _InitializeCheckpoint();
+  _InitializeTuning();
 }
 
 void AngularCorrelation::AssignBinResolutions(double lammin, double lammax,
@@ -186,6 +244,335 @@ void AngularCorrelation::AutoMaxResolution(uint32_t n_obj, double area) {
   SetMaxResolution(max_resolution, false);
 }
 
+void AngularCorrelation::AutoTune(Map& stomp_map, PointCatalog& galaxy,
+				  uint8_t random_iterations,
+				  uint32_t n_calibration) {
+  _AutoTune(stomp_map, stomp_map, galaxy, galaxy, random_iterations,
+	    n_calibration, true);
+}
+
+void AngularCorrelation::AutoTune(Map& stomp_map_a, Map& stomp_map_b,
+				  PointCatalog& galaxy_a,
+				  PointCatalog& galaxy_b,
+				  uint8_t random_iterations,
+				  uint32_t n_calibration) {
+  _AutoTune(stomp_map_a, stomp_map_b, galaxy_a, galaxy_b, random_iterations,
+	    n_calibration, false);
+}
+
+void AngularCorrelation::SetAutoTune(bool auto_tune) {
+  auto_tune_ = auto_tune;
+}
+
+double AngularCorrelation::PredictedSeconds() {
+  return tuning_seconds_;
+}
+
+bool AngularCorrelation::WriteTuning(const std::string& output_file_name) {
+  std::ofstream output_file(output_file_name.c_str());
+  if (!output_file.is_open()) {
+    std::cout << "Stomp::AngularCorrelation::WriteTuning - " <<
+      "Failed to open " << output_file_name << "\n";
+    return false;
+  }
+
+  output_file << "tree_resolution " << TreeResolution() << "\n" <<
+    "node_capacity " << tree_node_capacity_ << "\n" <<
+    "max_resolution " << max_resolution_ << "\n" <<
+    "predicted_seconds " << tuning_seconds_ << "\n";
+  for (uint32_t i=0;i<thetabin_.size();i++) {
+    output_file << "bin " << thetabin_[i].Theta() << " " <<
+      thetabin_[i].Resolution() << " " <<
+      (i < tuning_pair_seconds_.size() ? tuning_pair_seconds_[i] : -1.0) <<
+      " " <<
+      (i < tuning_pixel_seconds_.size() ? tuning_pixel_seconds_[i] : -1.0) <<
+      "\n";
+  }
+  output_file.close();
+
+  return !output_file.fail();
+}
+
+void AngularCorrelation::SetTreeParameters(uint32_t tree_resolution,
+					   uint16_t node_capacity) {
+  tree_resolution_ = tree_resolution;
+  tree_node_capacity_ = node_capacity;
+}
+
+uint32_t AngularCorrelation::TreeResolution() {
+  uint32_t tree_resolution =
+    (tree_resolution_ > 0 ? tree_resolution_ : min_resolution_);
+  if (regionation_resolution_ > tree_resolution)
+    tree_resolution = regionation_resolution_;
+  return tree_resolution;
+}
+
+uint16_t AngularCorrelation::TreeNodeCapacity() {
+  return tree_node_capacity_;
+}
+
+void AngularCorrelation::_AutoTune(Map& stomp_map_a, Map& stomp_map_b,
+				   PointCatalog& galaxy_a,
+				   PointCatalog& galaxy_b,
+				   uint8_t random_iterations,
+				   uint32_t n_calibration,
+				   bool auto_correlation) {
+  STOMP_SCOPED_TIMER("AngularCorrelation::AutoTune");
+  uint32_t n_bins = thetabin_.size();
+
+  std::vector<uint8_t> inside;
+  uint32_t n_tree = stomp_map_a.Contains(galaxy_a, inside);
+  if ((n_bins == 0) || (n_tree == 0) || (galaxy_b.Size() == 0) ||
+      (n_calibration == 0)) {
+    std::cout << "Stomp::AngularCorrelation::AutoTune - " <<
+      "Nothing to calibrate with; using AutoMaxResolution instead...\n";
+    uint32_t n_obj =
+      static_cast<uint32_t>(sqrt(1.0*galaxy_a.Size()*galaxy_b.Size()));
+    AutoMaxResolution(n_obj, stomp_map_a.Area());
+    return;
+  }
+  PointCatalog tree_galaxy;
+  galaxy_a.Select(inside, tree_galaxy);
+
+  // The resolution each bin would have with the pixel-based estimator (the
+  // same thing SetMaxResolution uses) and the resolution it would actually
+  // be calculated at once the regionation resolution is taken into account.
+  std::vector<uint32_t> bin_resolution(n_bins), pixel_resolution(n_bins);
+  for (uint32_t i=0;i<n_bins;i++) {
+    AngularBin theta(thetabin_[i].ThetaMin(), thetabin_[i].ThetaMax());
+    theta.CalculateResolution();
+    bin_resolution[i] = theta.Resolution();
+    pixel_resolution[i] = bin_resolution[i];
+    if (pixel_resolution[i] < regionation_resolution_)
+      pixel_resolution[i] = regionation_resolution_;
+  }
+
+  // The calibration patch is centered on a galaxy from the middle of the
+  // tree catalog.  The query points are the ones within core_radius of it
+  // (enough for about n_calibration of them) and the tree points are the
+  // ones within reach of those for the bins we time directly.  We cap the
+  // size of the tree patch, so bins much larger than the core can't be timed
+  // directly; their cost is scaled up from the largest bin that can by the
+  // area of the annulus.
+  const uint32_t max_tree_points = 100000;
+  double tree_density = n_tree/stomp_map_a.Area();
+  double query_density = galaxy_b.Size()/stomp_map_b.Area();
+  double core_radius = sqrt(n_calibration/(Pi*query_density));
+  double theta_direct =
+    sqrt(max_tree_points/(Pi*tree_density)) - core_radius;
+  if (theta_direct < thetabin_[0].ThetaMax())
+    theta_direct = thetabin_[0].ThetaMax();
+  if (theta_direct > theta_max_) theta_direct = theta_max_;
+
+  uint32_t n_direct = 1;
+  while ((n_direct < n_bins) &&
+	 DoubleLE(thetabin_[n_direct].ThetaMax(), theta_direct)) n_direct++;
+
+  AngularCoordinate center;
+  tree_galaxy.Point(n_tree/2, center);
+  PointCatalog tree_patch, query_patch;
+  _FindCalibrationPatch(tree_galaxy, center, core_radius + theta_direct, 0,
+			tree_patch);
+  _FindCalibrationPatch(galaxy_b, center, core_radius, n_calibration,
+			query_patch);
+  if (query_patch.Empty()) query_patch.AddPoint(center);
+
+  // The full measurement does a search of the tree for each query point for
+  // the galaxies and each random iteration (twice for the cross-correlation,
+  // which also checks the galaxy tree against the random query points) and
+  // builds one tree per random iteration on top of the galaxy tree.
+  double n_search = galaxy_b.Size()*
+    (1.0 + (auto_correlation ? 2.0 : 3.0)*random_iterations);
+  double n_tree_add = n_tree*(1.0 + random_iterations);
+
+  // Pair costs.  The candidate trees run from the coarsest resolution we
+  // can use up to 64 times finer, each with a range of node capacities.
+  const uint16_t node_capacity[] = {25, 50, 100, 200, 400, 800};
+  const uint32_t n_capacity = sizeof(node_capacity)/sizeof(node_capacity[0]);
+  uint32_t min_tree_resolution = HPixResolution;
+  if (regionation_resolution_ > min_tree_resolution)
+    min_tree_resolution = regionation_resolution_;
+
+  std::vector<uint32_t> candidate_resolution;
+  std::vector<uint16_t> candidate_capacity;
+  std::vector<double> build_seconds;
+  std::vector<std::vector<double> > pair_seconds;
+  StompWatch watch;
+  for (uint32_t resolution=min_tree_resolution;
+       (resolution<=64*min_tree_resolution) &&
+	 (resolution<=MaxPixelResolution);resolution*=2) {
+    for (uint32_t j=0;j<n_capacity;j++) {
+      watch.StartTimer();
+      TreeMap tree(resolution, node_capacity[j]);
+      tree.AddPoint(tree_patch);
+      watch.StopTimer();
+
+      std::vector<double> query_seconds(n_bins);
+      for (uint32_t i=0;i<n_direct;i++) {
+	AngularBin theta(thetabin_[i].ThetaMin(), thetabin_[i].ThetaMax());
+	StompWatch query_watch;
+	query_watch.StartTimer();
+	tree.FindWeightedPairs(query_patch, theta);
+	query_watch.StopTimer();
+	query_seconds[i] = query_watch.ElapsedTime()/query_patch.Size();
+      }
+      double direct_pixels = _AnnulusPixels(thetabin_[n_direct-1].ThetaMin(),
+					    thetabin_[n_direct-1].ThetaMax(),
+					    MaxPixelResolution);
+      for (uint32_t i=n_direct;i<n_bins;i++)
+	query_seconds[i] = query_seconds[n_direct-1]*
+	  _AnnulusPixels(thetabin_[i].ThetaMin(), thetabin_[i].ThetaMax(),
+			 MaxPixelResolution)/direct_pixels;
+
+      candidate_resolution.push_back(resolution);
+      candidate_capacity.push_back(node_capacity[j]);
+      build_seconds.push_back(
+	n_tree_add*watch.ElapsedTime()/(tree_patch.Size() + 1.0));
+      for (uint32_t i=0;i<n_bins;i++) query_seconds[i] *= n_search;
+      pair_seconds.push_back(query_seconds);
+    }
+  }
+
+  // Pixel costs.  The time for the pixel-based estimator goes as the number
+  // of pixels in the map times the number of pixels in the annulus around
+  // each one, plus the time to build the map at the finest pixel-based
+  // resolution.  We calibrate both on a patch of the Map with a few
+  // thousand pixels at the resolution of the largest bin.
+  const double n_calibration_pixels = 4000.0;
+  uint32_t calibration_resolution = pixel_resolution[n_bins-1];
+  double pixel_radius =
+    sqrt(n_calibration_pixels*Pixel::PixelArea(calibration_resolution)/Pi);
+  if (pixel_radius > 90.0) pixel_radius = 90.0;
+
+  watch.StartTimer();
+  ScalarMap pixel_patch(stomp_map_a, center, pixel_radius,
+			calibration_resolution, ScalarMap::DensityField);
+  pixel_patch.AddToMap(tree_patch);
+  watch.StopTimer();
+  double n_patch_pixels = pixel_patch.Size() + 1.0;
+  double map_seconds_per_pixel = watch.ElapsedTime()/n_patch_pixels;
+
+  ThetaVector calibration_bin;
+  calibration_bin.push_back(AngularBin(thetabin_[n_bins-1].ThetaMin(),
+				       thetabin_[n_bins-1].ThetaMax()));
+  calibration_bin[0].SetResolution(calibration_resolution);
+  watch.StartTimer();
+  pixel_patch.AutoCorrelate(calibration_bin.begin());
+  watch.StopTimer();
+  double seconds_per_pixel_pair = watch.ElapsedTime()/
+    (n_patch_pixels*_AnnulusPixels(calibration_bin[0].ThetaMin(),
+				   calibration_bin[0].ThetaMax(),
+				   calibration_resolution));
+
+  double map_area = stomp_map_a.Area();
+  std::vector<double> pixel_seconds(n_bins);
+  for (uint32_t i=0;i<n_bins;i++)
+    pixel_seconds[i] = seconds_per_pixel_pair*
+      map_area/Pixel::PixelArea(pixel_resolution[i])*
+      _AnnulusPixels(thetabin_[i].ThetaMin(), thetabin_[i].ThetaMax(),
+		     pixel_resolution[i]);
+
+  // Now find the combination that minimizes the total.  The bins are in
+  // order of increasing angle, so the pair-based bins are always the first
+  // n_pair of them and the break can only go where the bin resolution
+  // changes.  A break below the regionation resolution isn't allowed.
+  uint32_t best_candidate = 0, best_n_pair = n_bins;
+  double best_seconds = -1.0;
+  for (uint32_t k=0;k<candidate_resolution.size();k++) {
+    double pair_total = build_seconds[k];
+    for (uint32_t n_pair=0;n_pair<=n_bins;n_pair++) {
+      if (n_pair > 0) pair_total += pair_seconds[k][n_pair-1];
+      if ((n_pair < n_bins) &&
+	  (((n_pair > 0) &&
+	    (bin_resolution[n_pair-1] == bin_resolution[n_pair])) ||
+	   (bin_resolution[n_pair] < regionation_resolution_))) continue;
+
+      double seconds = (n_pair > 0 ? pair_total : 0.0);
+      if (n_pair < n_bins) {
+	seconds += map_seconds_per_pixel*(auto_correlation ? 1.0 : 2.0)*
+	  map_area/Pixel::PixelArea(pixel_resolution[n_pair]);
+	for (uint32_t i=n_pair;i<n_bins;i++) seconds += pixel_seconds[i];
+      }
+
+      if ((best_seconds < 0.0) || (seconds < best_seconds)) {
+	best_seconds = seconds;
+	best_candidate = k;
+	best_n_pair = n_pair;
+      }
+    }
+  }
+
+  SetTreeParameters(candidate_resolution[best_candidate],
+		    candidate_capacity[best_candidate]);
+  if (best_n_pair == n_bins) {
+    UseOnlyPairs();
+    manual_resolution_break_ = false;
+  } else {
+    SetMaxResolution(bin_resolution[best_n_pair], false);
+    if (regionation_resolution_ > 0)
+      SetMinResolution(regionation_resolution_ > min_resolution_ ?
+		       regionation_resolution_ : min_resolution_);
+  }
+
+  tuning_pair_seconds_ = pair_seconds[best_candidate];
+  tuning_pixel_seconds_ = pixel_seconds;
+  tuning_seconds_ = best_seconds;
+
+  std::cout << "Stomp::AngularCorrelation::AutoTune - " <<
+    "Calibrated on " << query_patch.Size() << " query and " <<
+    tree_patch.Size() << " tree points...\n";
+  if (best_n_pair == n_bins) {
+    std::cout << "Stomp::AngularCorrelation::AutoTune - " <<
+      "Using pairs for all bins, ";
+  } else {
+    std::cout << "Stomp::AngularCorrelation::AutoTune - " <<
+      "Setting maximum resolution to " << max_resolution_ << ", ";
+  }
+  std::cout << "tree resolution " << TreeResolution() <<
+    " with node capacity " << tree_node_capacity_ << "; predicted time " <<
+    tuning_seconds_ << " seconds...\n";
+}
+
+void AngularCorrelation::_FindCalibrationPatch(PointCatalog& catalog,
+					       AngularCoordinate& center,
+					       double radius,
+					       uint32_t max_points,
+					       PointCatalog& patch) {
+  double cos_radius = (radius < 180.0 ? cos(radius*DegToRad) : -1.0);
+  std::vector<uint8_t> keep(catalog.Size(), 0);
+  uint32_t n_keep = 0;
+  for (uint32_t i=0;i<catalog.Size();i++) {
+    if (center.UnitSphereX()*catalog.UnitSphereX(i) +
+	center.UnitSphereY()*catalog.UnitSphereY(i) +
+	center.UnitSphereZ()*catalog.UnitSphereZ(i) >= cos_radius) {
+      keep[i] = 1;
+      n_keep++;
+    }
+  }
+
+  // Thin the patch out evenly if there are too many points in it.
+  if ((max_points > 0) && (n_keep > max_points)) {
+    uint32_t stride = (n_keep + max_points - 1)/max_points, n_seen = 0;
+    for (uint32_t i=0;i<catalog.Size();i++) {
+      if (keep[i] == 1) {
+	if (n_seen % stride != 0) keep[i] = 0;
+	n_seen++;
+      }
+    }
+  }
+
+  patch.Clear();
+  catalog.Select(keep, patch);
+}
+
+double AngularCorrelation::_AnnulusPixels(double theta_min, double theta_max,
+					  uint32_t resolution) {
+  double n_pixels = 2.0*Pi*StradToDeg*
+    (cos(theta_min*DegToRad) - cos(theta_max*DegToRad))/
+    Pixel::PixelArea(resolution);
+  return (n_pixels > 1.0 ? n_pixels : 1.0);
+}
+
 void AngularCorrelation::InitializeRegions(int16_t n_regions) {
   n_region_ = n_regions;
   for (ThetaIterator iter=Begin();iter!=End();++iter)
@@ -207,8 +594,22 @@ void AngularCorrelation::FindAutoCorrelation(Map& stomp_map,
 					     WAngularVector& galaxy,
 					     uint8_t random_iterations,
 					     bool use_weighted_randoms) {
-  if (!manual_resolution_break_)
-    AutoMaxResolution(galaxy.size(), stomp_map.Area());
+  PointCatalog catalog(galaxy, false);
+  FindAutoCorrelation(stomp_map, catalog, random_iterations,
+		      use_weighted_randoms);
+}
+
+void AngularCorrelation::FindAutoCorrelation(Map& stomp_map,
+					     PointCatalog& galaxy,
+					     uint8_t random_iterations,
+					     bool use_weighted_randoms) {
+  if (!manual_resolution_break_) {
+    if (auto_tune_) {
+      AutoTune(stomp_map, galaxy, random_iterations);
+    } else {
+      AutoMaxResolution(galaxy.Size(), stomp_map.Area());
+    }
+  }
 
   if (theta_pixel_begin_ != theta_pixel_end_)
     FindPixelAutoCorrelation(stomp_map, galaxy, use_weighted_randoms);
@@ -219,14 +620,29 @@ void AngularCorrelation::FindAutoCorrelation(Map& stomp_map,
 }
 
 void AngularCorrelation::FindCrossCorrelation(Map& stomp_map_a,
-		            Map& stomp_map_b,
+					      Map& stomp_map_b,
 					      WAngularVector& galaxy_a,
 					      WAngularVector& galaxy_b,
 					      uint8_t random_iterations,
 					      bool use_weighted_randoms) {
-  if (!manual_resolution_break_) {
+  PointCatalog catalog_a(galaxy_a, false);
+  PointCatalog catalog_b(galaxy_b, false);
+  FindCrossCorrelation(stomp_map_a, stomp_map_b, catalog_a, catalog_b,
+		       random_iterations, use_weighted_randoms);
+}
+
+void AngularCorrelation::FindCrossCorrelation(Map& stomp_map_a,
+		            Map& stomp_map_b,
+					      PointCatalog& galaxy_a,
+					      PointCatalog& galaxy_b,
+					      uint8_t random_iterations,
+					      bool use_weighted_randoms) {
+  if (!manual_resolution_break_ && auto_tune_) {
+    AutoTune(stomp_map_a, stomp_map_b, galaxy_a, galaxy_b,
+	     random_iterations);
+  } else if (!manual_resolution_break_) {
     uint32_t n_obj =
-      static_cast<uint32_t>(sqrt(1.0*galaxy_a.size()*galaxy_b.size()));
+      static_cast<uint32_t>(sqrt(1.0*galaxy_a.Size()*galaxy_b.Size()));
     double area = stomp_map_a.Area();
     if (stomp_map_b.Area() < area) area = stomp_map_b.Area();
     AutoMaxResolution(n_obj, area);
@@ -246,8 +662,18 @@ void AngularCorrelation::FindAutoCorrelationWithRegions(Map& stomp_map,
 							uint8_t random_iter,
 							uint16_t n_regions,
 							bool use_weighted_randoms) {
-  if (!manual_resolution_break_)
-    AutoMaxResolution(gal.size(), stomp_map.Area());
+  PointCatalog catalog(gal, false);
+  FindAutoCorrelationWithRegions(stomp_map, catalog, random_iter, n_regions,
+				 use_weighted_randoms);
+}
+
+void AngularCorrelation::FindAutoCorrelationWithRegions(Map& stomp_map,
+							PointCatalog& gal,
+							uint8_t random_iter,
+							uint16_t n_regions,
+							bool use_weighted_randoms) {
+  if (!manual_resolution_break_ && !auto_tune_)
+    AutoMaxResolution(gal.Size(), stomp_map.Area());
 
   if (n_regions == 0) n_regions = static_cast<uint16_t>(2*thetabin_.size());
   std::cout << "Stomp::AngularCorrelation::FindAutoCorrelationWithRegions - " <<
@@ -268,6 +694,11 @@ void AngularCorrelation::FindAutoCorrelationWithRegions(Map& stomp_map,
   std::cout << "Stomp::AngularCorrelation::FindAutoCorrelationWithRegions - " <<
     "Regionated at " << regionation_resolution_ << "...\n";
   InitializeRegions(n_regions);
+
+  // The tuning needs to know the regionation resolution, since none of the
+  // pixel-based bins or the tree can be any coarser than that.
+  if (!manual_resolution_break_ && auto_tune_)
+    AutoTune(stomp_map, gal, random_iter);
   if (regionation_resolution_ > min_resolution_)
     SetMinResolution(regionation_resolution_);
 
@@ -288,15 +719,29 @@ void AngularCorrelation::FindAutoCorrelationWithRegions(Map& stomp_map,
 }
 
 void AngularCorrelation::FindCrossCorrelationWithRegions(Map& stomp_map_a,
-		           Map& stomp_map_b,
+							 Map& stomp_map_b,
 							 WAngularVector& gal_a,
 							 WAngularVector& gal_b,
 							 uint8_t random_iter,
 							 uint16_t n_regions,
 							 bool use_weighted_randoms) {
-  if (!manual_resolution_break_) {
+  PointCatalog catalog_a(gal_a, false);
+  PointCatalog catalog_b(gal_b, false);
+  FindCrossCorrelationWithRegions(stomp_map_a, stomp_map_b, catalog_a,
+				  catalog_b, random_iter, n_regions,
+				  use_weighted_randoms);
+}
+
+void AngularCorrelation::FindCrossCorrelationWithRegions(Map& stomp_map_a,
+		           Map& stomp_map_b,
+							 PointCatalog& gal_a,
+							 PointCatalog& gal_b,
+							 uint8_t random_iter,
+							 uint16_t n_regions,
+							 bool use_weighted_randoms) {
+  if (!manual_resolution_break_ && !auto_tune_) {
     uint32_t n_obj =
-      static_cast<uint32_t>(sqrt(1.0*gal_a.size()*gal_b.size()));
+      static_cast<uint32_t>(sqrt(1.0*gal_a.Size()*gal_b.Size()));
     AutoMaxResolution(n_obj, stomp_map_a.Area());
   }
 
@@ -316,6 +761,8 @@ void AngularCorrelation::FindCrossCorrelationWithRegions(Map& stomp_map_a,
   std::cout << "Stomp::AngularCorrelation::FindCrossCorrelationWithRegions" <<
     " - Regionated at " << regionation_resolution_ << "...\n";
   InitializeRegions(n_regions);
+  if (!manual_resolution_break_ && auto_tune_)
+    AutoTune(stomp_map_a, stomp_map_b, gal_a, gal_b, random_iter);
   if (regionation_resolution_ > min_resolution_)
     SetMinResolution(regionation_resolution_);
 
@@ -337,7 +784,21 @@ void AngularCorrelation::FindCrossCorrelationWithRegions(Map& stomp_map_a,
 }
 
 void AngularCorrelation::FindPixelAutoCorrelation(Map& stomp_map,
-						  WAngularVector& galaxy, bool use_weighted_randoms) {
+						  WAngularVector& galaxy,
+						  bool use_weighted_randoms) {
+  PointCatalog catalog(galaxy, false);
+  FindPixelAutoCorrelation(stomp_map, catalog, use_weighted_randoms);
+}
+
+void AngularCorrelation::FindPixelAutoCorrelation(Map& stomp_map,
+						  PointCatalog& galaxy,
+						  bool use_weighted_randoms) {
+  STOMP_SCOPED_TIMER("AngularCorrelation::FindPixelAutoCorrelation");
+  if (_ResumeCheckpoint() && (completed_stages_ & PixelStage)) {
+    std::cout << "Stomp::AngularCorrelation::FindPixelAutoCorrelation - " <<
+      "Pixel-based bins already done in " << checkpoint_file_ << "...\n";
+    return;
+  }
 
   std::cout << "Stomp::AngularCorrelation::FindPixelAutoCorrelation - " <<
     "Initializing ScalarMap at " << max_resolution_ << "...\n";
@@ -351,18 +812,15 @@ void AngularCorrelation::FindPixelAutoCorrelation(Map& stomp_map,
 
   std::cout << "Stomp::AngularCorrelation::FindPixelAutoCorrelation - " <<
     "Adding points to ScalarMap...\n";
-  uint32_t n_filtered = 0;
-  uint32_t n_kept = 0;
-  for (WAngularIterator iter=galaxy.begin();iter!=galaxy.end();++iter) {
-    if (stomp_map.Contains(*iter)) {
-      n_filtered++;
-      if (scalar_map->AddToMap(*iter)) n_kept++;
-    }
-  }
+  std::vector<uint8_t> inside;
+  uint32_t n_filtered = stomp_map.Contains(galaxy, inside);
+  PointCatalog filtered_galaxy;
+  galaxy.Select(inside, filtered_galaxy);
+  uint32_t n_kept = scalar_map->AddToMap(filtered_galaxy);
 
-  if (n_filtered != galaxy.size())
+  if (n_filtered != galaxy.Size())
     std::cout << "Stomp::AngularCorrelation::FindPixelAutoCorrelation - " <<
-      "WARNING: " << galaxy.size() - n_filtered << "/" << galaxy.size() <<
+      "WARNING: " << galaxy.Size() - n_filtered << "/" << galaxy.Size() <<
       " objects not within input Map.\n";
 
   if (n_filtered != n_kept)
@@ -373,6 +831,9 @@ void AngularCorrelation::FindPixelAutoCorrelation(Map& stomp_map,
   FindPixelAutoCorrelation(*scalar_map);
 
   delete scalar_map;
+
+  completed_stages_ |= PixelStage;
+  _SaveCheckpoint();
 }
 
 void AngularCorrelation::FindPixelAutoCorrelation(ScalarMap& scalar_map) {
@@ -388,11 +849,12 @@ void AngularCorrelation::FindPixelAutoCorrelation(ScalarMap& scalar_map) {
     }
   }
 
+  // All of the coarser maps come from a single pass over the input map.
+  ScalarMapPyramid pyramid(scalar_map, min_resolution_);
   for (uint32_t resolution=scalar_map.Resolution()/2;
        resolution>=min_resolution_;resolution/=2) {
-    ScalarMap* sub_scalar_map =
-      new ScalarMap(scalar_map,resolution);
-    if (scalar_map.NRegion() > 0) sub_scalar_map->InitializeRegions(scalar_map);
+    ScalarMap* sub_scalar_map = pyramid.Level(resolution);
+    if (sub_scalar_map == NULL) break;
     for (ThetaIterator iter=Begin(resolution);iter!=End(resolution);++iter) {
       if (scalar_map.NRegion() > 0) {
 	std::cout << "\tAuto-correlating with regions at " <<
@@ -404,16 +866,31 @@ void AngularCorrelation::FindPixelAutoCorrelation(ScalarMap& scalar_map) {
 	sub_scalar_map->AutoCorrelate(iter);
       }
     }
-
-    delete sub_scalar_map;
   }
 }
 
 void AngularCorrelation::FindPixelCrossCorrelation(Map& stomp_map_a,
-		           Map& stomp_map_b,
+						   Map& stomp_map_b,
 						   WAngularVector& galaxy_a,
 						   WAngularVector& galaxy_b,
 						   bool use_weighted_randoms) {
+  PointCatalog catalog_a(galaxy_a, false);
+  PointCatalog catalog_b(galaxy_b, false);
+  FindPixelCrossCorrelation(stomp_map_a, stomp_map_b, catalog_a, catalog_b,
+			    use_weighted_randoms);
+}
+
+void AngularCorrelation::FindPixelCrossCorrelation(Map& stomp_map_a,
+						   Map& stomp_map_b,
+						   PointCatalog& galaxy_a,
+						   PointCatalog& galaxy_b,
+						   bool use_weighted_randoms) {
+  STOMP_SCOPED_TIMER("AngularCorrelation::FindPixelCrossCorrelation");
+  if (_ResumeCheckpoint() && (completed_stages_ & PixelStage)) {
+    std::cout << "Stomp::AngularCorrelation::FindPixelCrossCorrelation - " <<
+      "Pixel-based bins already done in " << checkpoint_file_ << "...\n";
+    return;
+  }
 
   std::cout << "Stomp::AngularCorrelation::FindPixelCrossCorrelation - " <<
     "Initialing ScalarMaps at " << max_resolution_ << "...\n";
@@ -429,45 +906,28 @@ void AngularCorrelation::FindPixelCrossCorrelation(Map& stomp_map_a,
     scalar_map_b->InitializeRegions(stomp_map_b);
   }
 
-  uint32_t n_filtered = 0;
-  uint32_t n_kept = 0;
-  for (WAngularIterator iter=galaxy_a.begin();iter!=galaxy_a.end();++iter) {
-    if (stomp_map_a.Contains(*iter)) {
-      n_filtered++;
-//      if (use_weighted_randoms){
-//      	Pixel tmp_pix = Pixel(*iter, max_resolution_);
-//      	WeightedAngularCoordinate tmp_wang = WeightedAngularCoordinate(
-//      			iter->UnitSphereX(), iter->UnitSphereY(), iter->UnitSphereZ(),
-//      			iter->Weight() / stomp_map_a.FindAverageWeight(tmp_pix));
-//      	if (scalar_map_a->AddToMap(tmp_wang)) n_kept++;
-//      } else {
-//
-//      }
-      if (scalar_map_a->AddToMap(*iter)) n_kept++;
-    }
-  }
+  std::vector<uint8_t> inside;
+  PointCatalog filtered_galaxy;
+  uint32_t n_filtered = stomp_map_a.Contains(galaxy_a, inside);
+  galaxy_a.Select(inside, filtered_galaxy);
+  uint32_t n_kept = scalar_map_a->AddToMap(filtered_galaxy);
 
-  if (n_filtered != galaxy_a.size())
+  if (n_filtered != galaxy_a.Size())
     std::cout << "Stomp::AngularCorrelation::FindPixelCrossCorrelation - " <<
-      "WARNING: " << galaxy_a.size() - n_filtered <<
-      "/" << galaxy_a.size() << " objects not within input Map.\n";
+      "WARNING: " << galaxy_a.Size() - n_filtered <<
+      "/" << galaxy_a.Size() << " objects not within input Map.\n";
   if (n_filtered != n_kept)
     std::cout << "Stomp::AngularCorrelation::FindPixelCrossCorrelation - " <<
       "WARNING: Failed to place " << n_filtered - n_kept <<
       "/" << n_filtered << " filtered objects into ScalarMap.\n";
 
-  n_filtered = 0;
-  n_kept = 0;
-  for (WAngularIterator iter=galaxy_b.begin();iter!=galaxy_b.end();++iter) {
-    if (stomp_map_b.Contains(*iter)) {
-      n_filtered++;
-      if (scalar_map_b->AddToMap(*iter)) n_kept++;
-    }
-  }
+  n_filtered = stomp_map_b.Contains(galaxy_b, inside);
+  galaxy_b.Select(inside, filtered_galaxy);
+  n_kept = scalar_map_b->AddToMap(filtered_galaxy);
 
-  if (n_filtered != galaxy_b.size())
+  if (n_filtered != galaxy_b.Size())
     std::cout << "Stomp::AngularCorrelation::FindPixelCrossCorrelation - " <<
-      "WARNING: " << galaxy_b.size() - n_filtered << "/" << galaxy_b.size() <<
+      "WARNING: " << galaxy_b.Size() - n_filtered << "/" << galaxy_b.Size() <<
       " objects not within input Map.\n";
   if (n_filtered != n_kept)
     std::cout << "Stomp::AngularCorrelation::FindPixelCrossCorrelation - " <<
@@ -478,6 +938,9 @@ void AngularCorrelation::FindPixelCrossCorrelation(Map& stomp_map_a,
 
   delete scalar_map_a;
   delete scalar_map_b;
+
+  completed_stages_ |= PixelStage;
+  _SaveCheckpoint();
 }
 
 void AngularCorrelation::FindPixelCrossCorrelation(ScalarMap& map_a,
@@ -497,15 +960,15 @@ void AngularCorrelation::FindPixelCrossCorrelation(ScalarMap& map_a,
     }
   }
 
+  ScalarMapPyramid pyramid_a(map_a, min_resolution_);
+  ScalarMapPyramid pyramid_b(map_b, min_resolution_);
+  if (map_a.NRegion() > 0) pyramid_b.InitializeRegions(map_a);
+
   for (uint32_t resolution=map_a.Resolution()/2;
        resolution>=min_resolution_;resolution/=2) {
-    ScalarMap* sub_map_a = new ScalarMap(map_a, resolution);
-    ScalarMap* sub_map_b = new ScalarMap(map_b, resolution);
-
-    if (map_a.NRegion() > 0) {
-      sub_map_a->InitializeRegions(map_a);
-      sub_map_b->InitializeRegions(map_a);
-    }
+    ScalarMap* sub_map_a = pyramid_a.Level(resolution);
+    ScalarMap* sub_map_b = pyramid_b.Level(resolution);
+    if ((sub_map_a == NULL) || (sub_map_b == NULL)) break;
 
     std::cout << "Stomp::AngularCorrelation::FindPixelCrossCorrelation - \n";
     for (ThetaIterator iter=Begin(resolution);iter!=End(resolution);++iter) {
@@ -519,8 +982,6 @@ void AngularCorrelation::FindPixelCrossCorrelation(ScalarMap& map_a,
 	sub_map_a->CrossCorrelate(*sub_map_b, iter);
       }
     }
-    delete sub_map_a;
-    delete sub_map_b;
   }
 }
 
@@ -528,81 +989,117 @@ void AngularCorrelation::FindPairAutoCorrelation(Map& stomp_map,
 						 WAngularVector& galaxy,
 						 uint8_t random_iterations,
 						 bool use_weighted_randoms) {
-  int16_t tree_resolution = min_resolution_;
-  if (regionation_resolution_ > min_resolution_)
-    tree_resolution = regionation_resolution_;
+  PointCatalog catalog(galaxy, false);
+  FindPairAutoCorrelation(stomp_map, catalog, random_iterations,
+			  use_weighted_randoms);
+}
 
-  TreeMap* galaxy_tree = new TreeMap(tree_resolution, 200);
+void AngularCorrelation::FindPairAutoCorrelation(Map& stomp_map,
+						 PointCatalog& galaxy,
+						 uint8_t random_iterations,
+						 bool use_weighted_randoms) {
+  STOMP_SCOPED_TIMER("AngularCorrelation::FindPairAutoCorrelation");
+  if (!_ResumeCheckpoint()) {
+    completed_stages_ &= PixelStage;
+    random_iterations_ = 0;
+    randoms_normalized_ = false;
+  }
 
-  uint32_t n_kept = 0;
-  uint32_t n_fail = 0;
-  for (WAngularIterator iter=galaxy.begin();iter!=galaxy.end();++iter) {
-    if (stomp_map.Contains(*iter)) {
-      n_kept++;
-      if (!galaxy_tree->AddPoint(*iter)) {
-	std::cout << "Stomp::AngularCorrelation::FindPairAutoCorrelation - " <<
-	  "Failed to add point: " << iter->Lambda() << ", " <<
-	  iter->Eta() << "\n";
-	n_fail++;
-      }
-    }
+  if ((completed_stages_ & GalGalStage) && randoms_normalized_ &&
+      (random_iterations_ >= random_iterations)) {
+    std::cout << "Stomp::AngularCorrelation::FindPairAutoCorrelation - " <<
+      "Pair-based bins already done with " << random_iterations_ <<
+      " random iterations in " << checkpoint_file_ << "...\n";
+    return;
   }
-  std::cout << "Stomp::AngularCorrelation::FindPairAutoCorrelation - " <<
-    n_kept - n_fail << "/" << galaxy.size() << " objects added to tree;" <<
-    n_fail << " failed adds...\n";
 
+  uint32_t tree_resolution = TreeResolution();
+
+  if (!(completed_stages_ & GalGalStage)) {
+    TreeMap* galaxy_tree =
+      new TreeMap(tree_resolution, tree_node_capacity_);
+
+    std::vector<uint8_t> inside;
+    uint32_t n_kept = stomp_map.Contains(galaxy, inside);
+    PointCatalog filtered_galaxy;
+    galaxy.Select(inside, filtered_galaxy);
+    uint32_t n_fail = n_kept - galaxy_tree->AddPoint(filtered_galaxy);
+    std::cout << "Stomp::AngularCorrelation::FindPairAutoCorrelation - " <<
+      n_kept - n_fail << "/" << galaxy.Size() << " objects added to tree;" <<
+      n_fail << " failed adds...\n";
 
-  if (stomp_map.NRegion() > 0) {
-    if (!galaxy_tree->InitializeRegions(stomp_map)) {
-      std::cout << "Stomp::AngularCorrelation::FindPairAutoCorrelation - " <<
-	"Failed to initialize regions on TreeMap  Exiting.\n";
-      exit(2);
-    }
-  }
 
-  // Galaxy-galaxy
-  std::cout << "Stomp::AngularCorrelation::FindPairAutoCorrelation - \n";
-  std::cout << "\tGalaxy-galaxy pairs...\n";
-  for (ThetaIterator iter=theta_pair_begin_;iter!=theta_pair_end_;++iter) {
     if (stomp_map.NRegion() > 0) {
-      galaxy_tree->FindWeightedPairsWithRegions(galaxy, *iter);
-    } else {
-      galaxy_tree->FindWeightedPairs(galaxy, *iter);
+      if (!galaxy_tree->InitializeRegions(stomp_map)) {
+	std::cout << "Stomp::AngularCorrelation::FindPairAutoCorrelation - " <<
+	  "Failed to initialize regions on TreeMap  Exiting.\n";
+	exit(2);
+      }
     }
-    iter->MoveWeightToGalGal();
-  }
 
-  // Done with the galaxy-based tree, so we can delete that memory.
-  delete galaxy_tree;
+    // Galaxy-galaxy
+    std::cout << "Stomp::AngularCorrelation::FindPairAutoCorrelation - \n";
+    std::cout << "\tGalaxy-galaxy pairs...\n";
+    for (ThetaIterator iter=theta_pair_begin_;iter!=theta_pair_end_;++iter) {
+      if (stomp_map.NRegion() > 0) {
+	galaxy_tree->FindWeightedPairsWithRegions(galaxy, *iter);
+      } else {
+	galaxy_tree->FindWeightedPairs(galaxy, *iter);
+      }
+      iter->MoveWeightToGalGal();
+    }
 
-  // Before we start on the random iterations, we'll zero out the data fields
-  // for those counts.
-  for (ThetaIterator iter=theta_pair_begin_;iter!=theta_pair_end_;++iter) {
-    iter->ResetGalRand();
-    iter->ResetRandGal();
-    iter->ResetRandRand();
+    // Done with the galaxy-based tree, so we can delete that memory.
+    delete galaxy_tree;
+
+    // Before we start on the random iterations, we'll zero out the data
+    // fields for those counts.
+    for (ThetaIterator iter=theta_pair_begin_;iter!=theta_pair_end_;++iter) {
+      iter->ResetGalRand();
+      iter->ResetRandGal();
+      iter->ResetRandRand();
+    }
+    random_iterations_ = 0;
+    randoms_normalized_ = false;
+
+    completed_stages_ |= GalGalStage;
+    _SaveCheckpoint();
+  } else if (randoms_normalized_) {
+    // We're adding iterations to a finished measurement, so we need to go
+    // back to the raw random pair counts.
+    for (ThetaIterator iter=theta_pair_begin_;iter!=theta_pair_end_;++iter) {
+      if (random_iterations_ > 0) {
+	iter->RescaleGalRand(1.0/random_iterations_);
+	iter->RescaleRandGal(1.0/random_iterations_);
+	iter->RescaleRandRand(1.0/random_iterations_);
+      } else {
+	iter->ResetGalRand();
+	iter->ResetRandGal();
+	iter->ResetRandRand();
+      }
+    }
+    randoms_normalized_ = false;
   }
 
   std::cout << "Stomp::AngularCorrelation::FindPairAutoCorrelation - \n";
-  for (uint8_t rand_iter=0;rand_iter<random_iterations;rand_iter++) {
+  for (uint32_t rand_iter=random_iterations_;rand_iter<random_iterations;
+       rand_iter++) {
     std::cout << "\tRandom iteration " <<
       static_cast<int>(rand_iter) << "...\n";
 
     // Generate set of random points based on the input galaxy file and map.
-    WAngularVector random_galaxy;
+    PointCatalog random_galaxy;
     stomp_map.GenerateRandomPoints(random_galaxy, galaxy, use_weighted_randoms);
 
     // Create the TreeMap from those random points.
-    TreeMap* random_tree = new TreeMap(tree_resolution, 200);
+    TreeMap* random_tree =
+      new TreeMap(tree_resolution, tree_node_capacity_);
 
-    for (WAngularIterator iter=random_galaxy.begin();
-	 iter!=random_galaxy.end();++iter) {
-      if (!random_tree->AddPoint(*iter)) {
-	std::cout << "Stomp::AngularCorrelation::FindPairAutoCorrelation - " <<
-	  "Failed to add point: " << iter->Lambda() << ", " <<
-	  iter->Eta() << "\n";
-      }
-    }
+    uint32_t n_fail =
+      random_galaxy.Size() - random_tree->AddPoint(random_galaxy);
+    if (n_fail > 0)
+      std::cout << "Stomp::AngularCorrelation::FindPairAutoCorrelation - " <<
+	"Failed to add " << n_fail << " random points to tree\n";
 
     if (stomp_map.NRegion() > 0) {
       if (!random_tree->InitializeRegions(stomp_map)) {
@@ -634,45 +1131,67 @@ void AngularCorrelation::FindPairAutoCorrelation(Map& stomp_map,
     }
 
     delete random_tree;
+
+    random_iterations_++;
+    _SaveCheckpoint();
   }
 
   // Finally, we rescale our random pair counts to normalize them to the
   // number of input objects.
   for (ThetaIterator iter=theta_pair_begin_;iter!=theta_pair_end_;++iter) {
-    iter->RescaleGalRand(1.0*random_iterations);
-    iter->RescaleRandGal(1.0*random_iterations);
-    iter->RescaleRandRand(1.0*random_iterations);
+    iter->RescaleGalRand(1.0*random_iterations_);
+    iter->RescaleRandGal(1.0*random_iterations_);
+    iter->RescaleRandRand(1.0*random_iterations_);
   }
+  randoms_normalized_ = true;
+  _SaveCheckpoint();
 }
 
 void AngularCorrelation::FindPairCrossCorrelation(Map& stomp_map_a,
-		          Map& stomp_map_b,
+						  Map& stomp_map_b,
 						  WAngularVector& galaxy_a,
 						  WAngularVector& galaxy_b,
 						  uint8_t random_iterations,
 						  bool use_weighted_randoms) {
-  int16_t tree_resolution = min_resolution_;
-  if (regionation_resolution_ > min_resolution_)
-    tree_resolution = regionation_resolution_;
+  PointCatalog catalog_a(galaxy_a, false);
+  PointCatalog catalog_b(galaxy_b, false);
+  FindPairCrossCorrelation(stomp_map_a, stomp_map_b, catalog_a, catalog_b,
+			   random_iterations, use_weighted_randoms);
+}
 
-  TreeMap* galaxy_tree_a = new TreeMap(tree_resolution, 200);
+void AngularCorrelation::FindPairCrossCorrelation(Map& stomp_map_a,
+						  Map& stomp_map_b,
+						  PointCatalog& galaxy_a,
+						  PointCatalog& galaxy_b,
+						  uint8_t random_iterations,
+						  bool use_weighted_randoms) {
+  STOMP_SCOPED_TIMER("AngularCorrelation::FindPairCrossCorrelation");
+  if (!_ResumeCheckpoint()) {
+    completed_stages_ &= PixelStage;
+    random_iterations_ = 0;
+    randoms_normalized_ = false;
+  }
 
-  uint32_t n_kept = 0;
-  uint32_t n_fail = 0;
-  for (WAngularIterator iter=galaxy_a.begin();iter!=galaxy_a.end();++iter) {
-    if (stomp_map_a.Contains(*iter)) {
-      n_kept++;
-      if (!galaxy_tree_a->AddPoint(*iter)) {
-	std::cout << "Stomp::AngularCorrelation::FindPairCrossCorrelation - " <<
-	  "Failed to add point: " << iter->Lambda() << ", " <<
-	  iter->Eta() << "\n";
-	n_fail++;
-      }
-    }
+  if ((completed_stages_ & GalGalStage) && randoms_normalized_ &&
+      (random_iterations_ >= random_iterations)) {
+    std::cout << "Stomp::AngularCorrelation::FindPairCrossCorrelation - " <<
+      "Pair-based bins already done with " << random_iterations_ <<
+      " random iterations in " << checkpoint_file_ << "...\n";
+    return;
   }
 
+  uint32_t tree_resolution = TreeResolution();
+
+  TreeMap* galaxy_tree_a = new TreeMap(tree_resolution, tree_node_capacity_);
+
+  std::vector<uint8_t> inside;
+  uint32_t n_kept = stomp_map_a.Contains(galaxy_a, inside);
+  PointCatalog filtered_galaxy;
+  galaxy_a.Select(inside, filtered_galaxy);
+  uint32_t n_fail = n_kept - galaxy_tree_a->AddPoint(filtered_galaxy);
+
   std::cout << "Stomp::AngularCorrelation::FindPairCrossCorrelation - " <<
-    n_kept - n_fail << "/" << galaxy_a.size() <<
+    n_kept - n_fail << "/" << galaxy_a.Size() <<
     " objects added to tree;" << n_fail << " failed adds...\n";
 
   if (stomp_map_a.NRegion() > 0) {
@@ -683,40 +1202,63 @@ void AngularCorrelation::FindPairCrossCorrelation(Map& stomp_map_a,
     }
   }
 
-  // Galaxy-galaxy
-  std::cout << "Stomp::AngularCorrelation::FindPairCrossCorrelation - \n";
-  std::cout << "\tGalaxy-galaxy pairs...\n";
-  for (ThetaIterator iter=theta_pair_begin_;iter!=theta_pair_end_;++iter) {
-    if (stomp_map_a.NRegion() > 0) {
-      galaxy_tree_a->FindWeightedPairsWithRegions(galaxy_b, *iter);
-    } else {
-      galaxy_tree_a->FindWeightedPairs(galaxy_b, *iter);
+  if (!(completed_stages_ & GalGalStage)) {
+    // Galaxy-galaxy
+    std::cout << "Stomp::AngularCorrelation::FindPairCrossCorrelation - \n";
+    std::cout << "\tGalaxy-galaxy pairs...\n";
+    for (ThetaIterator iter=theta_pair_begin_;iter!=theta_pair_end_;++iter) {
+      if (stomp_map_a.NRegion() > 0) {
+	galaxy_tree_a->FindWeightedPairsWithRegions(galaxy_b, *iter);
+      } else {
+	galaxy_tree_a->FindWeightedPairs(galaxy_b, *iter);
+      }
+      // If the number of random iterations is 0, then we're doing a
+      // WeightedCrossCorrelation instead of a cross-correlation between 2
+      // population densities.  In that case, we want the ratio between the
+      // WeightedPairs and Pairs, so we keep the values in the Weight and
+      // Counter fields.
+      if (random_iterations > 0) iter->MoveWeightToGalGal();
     }
-    // If the number of random iterations is 0, then we're doing a
-    // WeightedCrossCorrelation instead of a cross-correlation between 2
-    // population densities.  In that case, we want the ratio between the
-    // WeightedPairs and Pairs, so we keep the values in the Weight and
-    // Counter fields.
-    if (random_iterations > 0) iter->MoveWeightToGalGal();
-  }
 
-  // Before we start on the random iterations, we'll zero out the data fields
-  // for those counts.
-  for (ThetaIterator iter=theta_pair_begin_;iter!=theta_pair_end_;++iter) {
-    iter->ResetGalRand();
-    iter->ResetRandGal();
-    iter->ResetRandRand();
+    // Before we start on the random iterations, we'll zero out the data
+    // fields for those counts.
+    for (ThetaIterator iter=theta_pair_begin_;iter!=theta_pair_end_;++iter) {
+      iter->ResetGalRand();
+      iter->ResetRandGal();
+      iter->ResetRandRand();
+    }
+    random_iterations_ = 0;
+    randoms_normalized_ = false;
+
+    completed_stages_ |= GalGalStage;
+    _SaveCheckpoint();
+  } else if (randoms_normalized_) {
+    // We're adding iterations to a finished measurement, so we need to go
+    // back to the raw random pair counts.
+    for (ThetaIterator iter=theta_pair_begin_;iter!=theta_pair_end_;++iter) {
+      if (random_iterations_ > 0) {
+	iter->RescaleGalRand(1.0/random_iterations_);
+	iter->RescaleRandGal(1.0/random_iterations_);
+	iter->RescaleRandRand(1.0/random_iterations_);
+      } else {
+	iter->ResetGalRand();
+	iter->ResetRandGal();
+	iter->ResetRandRand();
+      }
+    }
+    randoms_normalized_ = false;
   }
 
   std::cout << "Stomp::AngularCorrelation::FindPairCrossCorrelation - \n";
-  for (uint8_t rand_iter=0;rand_iter<random_iterations;rand_iter++) {
+  for (uint32_t rand_iter=random_iterations_;rand_iter<random_iterations;
+       rand_iter++) {
     std::cout << "\tRandom iteration " <<
       static_cast<int>(rand_iter) << "...\n";
-    WAngularVector random_galaxy_a;
+    PointCatalog random_galaxy_a;
     stomp_map_a.GenerateRandomPoints(random_galaxy_a, galaxy_a,
     		                             use_weighted_randoms);
 
-    WAngularVector random_galaxy_b;
+    PointCatalog random_galaxy_b;
     stomp_map_b.GenerateRandomPoints(random_galaxy_b, galaxy_b,
     		                             use_weighted_randoms);
 
@@ -730,16 +1272,13 @@ void AngularCorrelation::FindPairCrossCorrelation(Map& stomp_map_a,
       iter->MoveWeightToGalRand();
     }
 
-    TreeMap* random_tree_a = new TreeMap(tree_resolution, 200);
+    TreeMap* random_tree_a =
+      new TreeMap(tree_resolution, tree_node_capacity_);
 
-    for (WAngularIterator iter=random_galaxy_a.begin();
-	 iter!=random_galaxy_a.end();++iter) {
-      if (!random_tree_a->AddPoint(*iter)) {
-	std::cout << "Stomp::AngularCorrelation::FindPairCrossCorrelation - " <<
-	  "Failed to add point: " << iter->Lambda() << ", " <<
-	  iter->Eta() << "\n";
-      }
-    }
+    n_fail = random_galaxy_a.Size() - random_tree_a->AddPoint(random_galaxy_a);
+    if (n_fail > 0)
+      std::cout << "Stomp::AngularCorrelation::FindPairCrossCorrelation - " <<
+	"Failed to add " << n_fail << " random points to tree\n";
 
     if (stomp_map_a.NRegion() > 0) {
       if (!random_tree_a->InitializeRegions(stomp_map_a)) {
@@ -770,6 +1309,9 @@ void AngularCorrelation::FindPairCrossCorrelation(Map& stomp_map_a,
     }
 
     delete random_tree_a;
+
+    random_iterations_++;
+    _SaveCheckpoint();
   }
 
   delete galaxy_tree_a;
@@ -777,10 +1319,12 @@ void AngularCorrelation::FindPairCrossCorrelation(Map& stomp_map_a,
   // Finally, we rescale our random pair counts to normalize them to the
   // number of input objects.
   for (ThetaIterator iter=theta_pair_begin_;iter!=theta_pair_end_;++iter) {
-    iter->RescaleGalRand(1.0*random_iterations);
-    iter->RescaleRandGal(1.0*random_iterations);
-    iter->RescaleRandRand(1.0*random_iterations);
+    iter->RescaleGalRand(1.0*random_iterations_);
+    iter->RescaleRandGal(1.0*random_iterations_);
+    iter->RescaleRandRand(1.0*random_iterations_);
   }
+  randoms_normalized_ = true;
+  _SaveCheckpoint();
 }
 
 bool AngularCorrelation::Write(const std::string& output_file_name) {
@@ -815,6 +1359,729 @@ bool AngularCorrelation::Write(const std::string& output_file_name) {
   return wrote_file;
 }
 
+void AngularCorrelation::SetCheckpointFile(
+  const std::string& checkpoint_file) {
+  checkpoint_file_ = checkpoint_file;
+}
+
+bool AngularCorrelation::WriteCheckpoint(const std::string& checkpoint_file) {
+  // Write to a temporary file and then move it into place, so that a job
+  // killed in the middle of writing leaves the previous checkpoint intact.
+  std::string tmp_file_name = checkpoint_file + ".tmp";
+  std::ofstream output_file(tmp_file_name.c_str());
+  if (!output_file.is_open()) {
+    std::cout << "Stomp::AngularCorrelation::WriteCheckpoint - " <<
+      "Can't open " << tmp_file_name << "!\n";
+    return false;
+  }
+
+  output_file << "STOMP_ANGULAR_CORRELATION_CHECKPOINT 1\n";
+  output_file << thetabin_.size() << " " << n_region_ << " " <<
+    regionation_resolution_ << " " << min_resolution_ << " " <<
+    max_resolution_ << " " << (manual_resolution_break_ ? 1 : 0) << " " <<
+    theta_pixel_begin_ - thetabin_.begin() << " " <<
+    theta_pixel_end_ - thetabin_.begin() << " " <<
+    theta_pair_begin_ - thetabin_.begin() << " " <<
+    theta_pair_end_ - thetabin_.begin() << " " <<
+    static_cast<int>(completed_stages_) << " " << random_iterations_ << " " <<
+    (randoms_normalized_ ? 1 : 0) << "\n";
+  for (ThetaIterator iter=thetabin_.begin();iter!=thetabin_.end();++iter)
+    iter->WriteState(output_file);
+  output_file.close();
+
+  if (output_file.fail() ||
+      (rename(tmp_file_name.c_str(), checkpoint_file.c_str()) != 0)) {
+    std::cout << "Stomp::AngularCorrelation::WriteCheckpoint - " <<
+      "Failed to write " << checkpoint_file << "!\n";
+    return false;
+  }
+
+  return true;
+}
+
+bool AngularCorrelation::ReadCheckpoint(const std::string& checkpoint_file) {
+  std::ifstream input_file(checkpoint_file.c_str());
+  if (!input_file) {
+    std::cout << "Stomp::AngularCorrelation::ReadCheckpoint - " <<
+      checkpoint_file << " does not exist!\n";
+    return false;
+  }
+
+  std::string magic;
+  int version, manual_break, completed_stages, randoms_normalized;
+  uint32_t n_bins, pixel_begin, pixel_end, pair_begin, pair_end;
+  uint32_t regionation_resolution, min_resolution, max_resolution;
+  uint32_t random_iterations;
+  int16_t n_region;
+  if (!(input_file >> magic >> version) ||
+      (magic != "STOMP_ANGULAR_CORRELATION_CHECKPOINT") || (version != 1) ||
+      !(input_file >> n_bins >> n_region >> regionation_resolution >>
+	min_resolution >> max_resolution >> manual_break >> pixel_begin >>
+	pixel_end >> pair_begin >> pair_end >> completed_stages >>
+	random_iterations >> randoms_normalized)) {
+    std::cout << "Stomp::AngularCorrelation::ReadCheckpoint - " <<
+      "Bad header in " << checkpoint_file << "\n";
+    return false;
+  }
+
+  if ((n_bins != thetabin_.size()) || (pixel_begin > pixel_end) ||
+      (pixel_end > n_bins) || (pair_begin > pair_end) || (pair_end > n_bins)) {
+    std::cout << "Stomp::AngularCorrelation::ReadCheckpoint - " <<
+      checkpoint_file << " doesn't match our binning.\n";
+    return false;
+  }
+
+  ThetaVector thetabin(n_bins);
+  for (uint32_t i=0;i<n_bins;i++) {
+    if (!thetabin[i].ReadState(input_file)) {
+      std::cout << "Stomp::AngularCorrelation::ReadCheckpoint - " <<
+	"Failed to read bin " << i << " from " << checkpoint_file << "\n";
+      return false;
+    }
+    if (!DoubleEQ(thetabin[i].ThetaMin(), thetabin_[i].ThetaMin()) ||
+	!DoubleEQ(thetabin[i].ThetaMax(), thetabin_[i].ThetaMax())) {
+      std::cout << "Stomp::AngularCorrelation::ReadCheckpoint - " <<
+	checkpoint_file << " doesn't match our binning.\n";
+      return false;
+    }
+  }
+
+  for (uint32_t i=0;i<n_bins;i++) thetabin_[i] = thetabin[i];
+  n_region_ = n_region;
+  regionation_resolution_ = regionation_resolution;
+  min_resolution_ = min_resolution;
+  max_resolution_ = max_resolution;
+  manual_resolution_break_ = (manual_break == 1);
+  theta_pixel_begin_ = thetabin_.begin() + pixel_begin;
+  theta_pixel_end_ = thetabin_.begin() + pixel_end;
+  theta_pair_begin_ = thetabin_.begin() + pair_begin;
+  theta_pair_end_ = thetabin_.begin() + pair_end;
+  completed_stages_ = static_cast<uint8_t>(completed_stages);
+  random_iterations_ = random_iterations;
+  randoms_normalized_ = (randoms_normalized == 1);
+
+  return true;
+}
+
+uint32_t AngularCorrelation::RandomIterations() {
+  return random_iterations_;
+}
+
+bool AngularCorrelation::Merge(AngularCorrelation& wtheta,
+			       bool same_galaxies) {
+  if (wtheta.NBins() != thetabin_.size()) {
+    std::cout << "Stomp::AngularCorrelation::Merge - " <<
+      "Incompatible binning.\n";
+    return false;
+  }
+
+  for (uint32_t i=0;i<thetabin_.size();i++) {
+    if (!DoubleEQ(wtheta.thetabin_[i].ThetaMin(), thetabin_[i].ThetaMin()) ||
+	!DoubleEQ(wtheta.thetabin_[i].ThetaMax(), thetabin_[i].ThetaMax()) ||
+	(wtheta.thetabin_[i].Resolution() != thetabin_[i].Resolution()) ||
+	(wtheta.thetabin_[i].NRegion() != thetabin_[i].NRegion())) {
+      std::cout << "Stomp::AngularCorrelation::Merge - " <<
+	"Incompatible binning or regions.\n";
+      return false;
+    }
+  }
+
+  if (((random_iterations_ > 0) && !randoms_normalized_) ||
+      ((wtheta.random_iterations_ > 0) && !wtheta.randoms_normalized_)) {
+    std::cout << "Stomp::AngularCorrelation::Merge - " <<
+      "Can't merge unfinished measurements.\n";
+    return false;
+  }
+
+  if (same_galaxies) {
+    // Weight each set of random pair counts by the number of iterations that
+    // went into it.
+    uint32_t n_iter = random_iterations_ + wtheta.random_iterations_;
+    if (n_iter == 0) return true;
+    for (uint32_t i=0;i<thetabin_.size();i++) {
+      if (thetabin_[i].Resolution() != 0) continue;
+
+      AngularBin theta = wtheta.thetabin_[i];
+      theta.ResetWeight();
+      theta.ResetCounter();
+      theta.ResetGalGal();
+      theta.ResetPixelWtheta();
+      if (wtheta.random_iterations_ > 0) {
+	theta.RescaleGalRand(1.0/wtheta.random_iterations_);
+	theta.RescaleRandGal(1.0/wtheta.random_iterations_);
+	theta.RescaleRandRand(1.0/wtheta.random_iterations_);
+      } else {
+	theta.ResetGalRand();
+	theta.ResetRandGal();
+	theta.ResetRandRand();
+      }
+
+      if (random_iterations_ > 0) {
+	thetabin_[i].RescaleGalRand(1.0/random_iterations_);
+	thetabin_[i].RescaleRandGal(1.0/random_iterations_);
+	thetabin_[i].RescaleRandRand(1.0/random_iterations_);
+      } else {
+	thetabin_[i].ResetGalRand();
+	thetabin_[i].ResetRandGal();
+	thetabin_[i].ResetRandRand();
+      }
+      thetabin_[i].Add(theta);
+      thetabin_[i].RescaleGalRand(1.0*n_iter);
+      thetabin_[i].RescaleRandGal(1.0*n_iter);
+      thetabin_[i].RescaleRandRand(1.0*n_iter);
+    }
+    random_iterations_ = n_iter;
+  } else {
+    for (uint32_t i=0;i<thetabin_.size();i++)
+      thetabin_[i].Add(wtheta.thetabin_[i]);
+  }
+
+  return true;
+}
+
+bool AngularCorrelation::WritePairAutoWorkUnits(Map& stomp_map,
+						PointCatalog& galaxy,
+						const std::string& prefix,
+						uint32_t n_work_units,
+						uint8_t random_iterations,
+						bool use_weighted_randoms) {
+  return _WritePairWorkUnits(stomp_map, stomp_map, galaxy, galaxy, prefix,
+			     n_work_units, random_iterations,
+			     use_weighted_randoms, true);
+}
+
+bool AngularCorrelation::WritePairCrossWorkUnits(Map& stomp_map_a,
+						 Map& stomp_map_b,
+						 PointCatalog& galaxy_a,
+						 PointCatalog& galaxy_b,
+						 const std::string& prefix,
+						 uint32_t n_work_units,
+						 uint8_t random_iterations,
+						 bool use_weighted_randoms) {
+  return _WritePairWorkUnits(stomp_map_a, stomp_map_b, galaxy_a, galaxy_b,
+			     prefix, n_work_units, random_iterations,
+			     use_weighted_randoms, false);
+}
+
+bool AngularCorrelation::_WritePairWorkUnits(Map& stomp_map_a,
+					     Map& stomp_map_b,
+					     PointCatalog& galaxy_a,
+					     PointCatalog& galaxy_b,
+					     const std::string& prefix,
+					     uint32_t n_work_units,
+					     uint8_t random_iterations,
+					     bool use_weighted_randoms,
+					     bool auto_correlation) {
+  if ((n_work_units == 0) || (theta_pair_begin_ == theta_pair_end_)) {
+    std::cout << "Stomp::AngularCorrelation::WritePairWorkUnits - " <<
+      "Need at least one work unit and one pair-based bin.\n";
+    return false;
+  }
+
+  uint32_t tree_resolution = TreeResolution();
+
+  double theta_max = 0.0;
+  for (ThetaIterator iter=theta_pair_begin_;iter!=theta_pair_end_;++iter)
+    if (iter->ThetaMax() > theta_max) theta_max = iter->ThetaMax();
+
+  // The pair counting uses the regions from the first Map for both the tree
+  // and the query points, so that's what we split on as well.  Each work
+  // unit gets an equal share of the regions (or covered superpixels), with
+  // any points outside of them going to the first or last work unit.
+  bool use_regions = (stomp_map_a.NRegion() > 0);
+  std::vector<int64_t> keys;
+  if (use_regions) {
+    for (uint16_t region=0;region<stomp_map_a.NRegion();region++)
+      keys.push_back(region);
+  } else {
+    PixelVector superpix;
+    stomp_map_a.Coverage(superpix, HPixResolution, false);
+    for (PixelIterator iter=superpix.begin();iter!=superpix.end();++iter)
+      keys.push_back(iter->Pixnum());
+    std::sort(keys.begin(), keys.end());
+  }
+  if (keys.size() < n_work_units)
+    std::cout << "Stomp::AngularCorrelation::WritePairWorkUnits - " <<
+      "Only " << keys.size() << " regions for " << n_work_units <<
+      " work units; some will be empty.\n";
+
+  std::vector<int64_t> unit_bounds;
+  for (uint32_t i=1;i<n_work_units;i++)
+    unit_bounds.push_back(keys.empty() ? 0 : keys[i*keys.size()/n_work_units]);
+
+  // The current state goes in the job file, along with the regions and
+  // the parameters that the work units need.
+  if (!WriteCheckpoint(prefix + ".job") ||
+      (use_regions && !stomp_map_a.WriteRegions(prefix + ".regions")))
+    return false;
+
+  std::string units_file_name = prefix + ".units";
+  std::ofstream units_file(units_file_name.c_str());
+  units_file << "STOMP_PAIR_WORK_UNITS 1\n" << n_work_units << " " <<
+    (auto_correlation ? 1 : 0) << " " <<
+    static_cast<int>(random_iterations) << " " << tree_resolution << " " <<
+    (use_regions ? 1 : 0) << " " << tree_node_capacity_ << "\n";
+  units_file.close();
+  if (units_file.fail()) {
+    std::cout << "Stomp::AngularCorrelation::WritePairWorkUnits - " <<
+      "Failed to write " << units_file_name << "!\n";
+    return false;
+  }
+
+  // The galaxies that go into the tree have to be in the Map, while the
+  // query points are used as they are, just as in FindPair*Correlation.
+  std::vector<uint8_t> inside;
+  stomp_map_a.Contains(galaxy_a, inside);
+  PointCatalog tree_galaxy;
+  galaxy_a.Select(inside, tree_galaxy);
+
+  std::vector<uint32_t> galaxy_unit;
+  std::vector<std::vector<uint32_t> > galaxy_neighborhood(n_work_units);
+  _FindWorkUnits(stomp_map_a, galaxy_b, use_regions, unit_bounds,
+		 galaxy_unit);
+  _FindWorkUnitNeighborhoods(galaxy_b, galaxy_unit, tree_resolution,
+			     theta_max, galaxy_neighborhood);
+  if (!_WriteWorkUnitQueries(galaxy_b, galaxy_unit, n_work_units, prefix,
+			     "galaxy_query")) return false;
+
+  // For cross-correlations, the galaxy tree is also used for the
+  // galaxy-random pairs, so its neighborhood grows with each iteration.
+  std::vector<std::vector<uint32_t> > tree_neighborhood = galaxy_neighborhood;
+
+  std::cout << "Stomp::AngularCorrelation::WritePairWorkUnits - " <<
+    "Writing " << n_work_units << " work units to " << prefix << "...\n";
+  for (uint32_t rand_iter=0;rand_iter<random_iterations;rand_iter++) {
+    std::cout << "\tRandom iteration " << rand_iter << "...\n";
+    PointCatalog random_galaxy_a;
+    stomp_map_a.GenerateRandomPoints(random_galaxy_a, galaxy_a,
+				     use_weighted_randoms);
+    PointCatalog random_galaxy_b;
+    if (!auto_correlation)
+      stomp_map_b.GenerateRandomPoints(random_galaxy_b, galaxy_b,
+				       use_weighted_randoms);
+    PointCatalog& random_query =
+      (auto_correlation ? random_galaxy_a : random_galaxy_b);
+
+    std::vector<uint32_t> random_unit;
+    std::vector<std::vector<uint32_t> > random_neighborhood(n_work_units);
+    _FindWorkUnits(stomp_map_a, random_query, use_regions, unit_bounds,
+		   random_unit);
+    _FindWorkUnitNeighborhoods(random_query, random_unit, tree_resolution,
+			       theta_max, random_neighborhood);
+
+    std::ostringstream query_suffix, tree_suffix;
+    query_suffix << "random_query." << rand_iter;
+    tree_suffix << "random_tree." << rand_iter;
+    if (!_WriteWorkUnitQueries(random_query, random_unit, n_work_units,
+			       prefix, query_suffix.str())) return false;
+
+    // The random tree is queried with both the galaxies and the randoms.
+    std::vector<std::vector<uint32_t> > neighborhood = random_neighborhood;
+    for (uint32_t i=0;i<n_work_units;i++) {
+      neighborhood[i].insert(neighborhood[i].end(),
+			     galaxy_neighborhood[i].begin(),
+			     galaxy_neighborhood[i].end());
+      if (!auto_correlation)
+	tree_neighborhood[i].insert(tree_neighborhood[i].end(),
+				    random_neighborhood[i].begin(),
+				    random_neighborhood[i].end());
+    }
+    if (!_WriteWorkUnitTrees(random_galaxy_a, tree_resolution, neighborhood,
+			     prefix, tree_suffix.str())) return false;
+  }
+
+  return _WriteWorkUnitTrees(tree_galaxy, tree_resolution, tree_neighborhood,
+			     prefix, "galaxy_tree");
+}
+
+bool AngularCorrelation::RunPairWorkUnit(const std::string& prefix,
+					 uint32_t work_unit) {
+  STOMP_SCOPED_TIMER("AngularCorrelation::RunPairWorkUnit");
+  uint32_t n_work_units, random_iterations, tree_resolution;
+  uint16_t node_capacity;
+  bool auto_correlation, use_regions;
+  if (!_ReadWorkUnits(prefix, n_work_units, auto_correlation,
+		      random_iterations, tree_resolution, node_capacity,
+		      use_regions))
+    return false;
+
+  if (work_unit >= n_work_units) {
+    std::cout << "Stomp::AngularCorrelation::RunPairWorkUnit - " <<
+      "Work unit " << work_unit << " out of range; " << prefix <<
+      " only has " << n_work_units << " work units.\n";
+    return false;
+  }
+
+  std::string output_file_name = _WorkUnitFile(prefix, work_unit, "out");
+  std::ifstream output_file(output_file_name.c_str());
+  if (output_file) {
+    std::cout << "Stomp::AngularCorrelation::RunPairWorkUnit - " <<
+      output_file_name << " already done.\n";
+    return true;
+  }
+
+  if (!ReadCheckpoint(prefix + ".job")) return false;
+  for (ThetaIterator iter=theta_pair_begin_;iter!=theta_pair_end_;++iter)
+    iter->Reset();
+
+  PointCatalog galaxy_query, galaxy_tree_catalog;
+  if (!galaxy_query.Read(_WorkUnitFile(prefix, work_unit,
+				       "galaxy_query")) ||
+      !galaxy_tree_catalog.Read(_WorkUnitFile(prefix, work_unit,
+					      "galaxy_tree")))
+    return false;
+
+  // Galaxy-galaxy.  As in FindPairCrossCorrelation, a cross-correlation
+  // without randoms leaves the pair counts in the Weight and Counter fields.
+  TreeMap* galaxy_tree = _BuildWorkUnitTree(galaxy_tree_catalog,
+					    tree_resolution, node_capacity,
+					    use_regions, prefix);
+  galaxy_tree_catalog.Clear();
+  _FindWorkUnitPairs(galaxy_tree, galaxy_query, use_regions);
+  if (auto_correlation || (random_iterations > 0))
+    for (ThetaIterator iter=theta_pair_begin_;iter!=theta_pair_end_;++iter)
+      iter->MoveWeightToGalGal();
+
+  for (uint32_t rand_iter=0;rand_iter<random_iterations;rand_iter++) {
+    std::ostringstream query_suffix, tree_suffix;
+    query_suffix << "random_query." << rand_iter;
+    tree_suffix << "random_tree." << rand_iter;
+    PointCatalog random_query, random_tree_catalog;
+    if (!random_query.Read(_WorkUnitFile(prefix, work_unit,
+					 query_suffix.str())) ||
+	!random_tree_catalog.Read(_WorkUnitFile(prefix, work_unit,
+						tree_suffix.str()))) {
+      delete galaxy_tree;
+      return false;
+    }
+
+    if (!auto_correlation) {
+      _FindWorkUnitPairs(galaxy_tree, random_query, use_regions);
+      for (ThetaIterator iter=theta_pair_begin_;iter!=theta_pair_end_;++iter)
+	iter->MoveWeightToGalRand();
+    }
+
+    TreeMap* random_tree = _BuildWorkUnitTree(random_tree_catalog,
+					      tree_resolution, node_capacity,
+					      use_regions, prefix);
+    random_tree_catalog.Clear();
+
+    _FindWorkUnitPairs(random_tree, galaxy_query, use_regions);
+    for (ThetaIterator iter=theta_pair_begin_;iter!=theta_pair_end_;++iter) {
+      if (auto_correlation) {
+	iter->MoveWeightToGalRand(true);
+      } else {
+	iter->MoveWeightToRandGal();
+      }
+    }
+
+    _FindWorkUnitPairs(random_tree, random_query, use_regions);
+    for (ThetaIterator iter=theta_pair_begin_;iter!=theta_pair_end_;++iter)
+      iter->MoveWeightToRandRand();
+
+    delete random_tree;
+  }
+
+  delete galaxy_tree;
+
+  // The random pair counts are normalized here rather than after the merge;
+  // since the rescaling is linear, the sum comes out the same.
+  if (random_iterations > 0) {
+    for (ThetaIterator iter=theta_pair_begin_;iter!=theta_pair_end_;++iter) {
+      iter->RescaleGalRand(1.0*random_iterations);
+      iter->RescaleRandGal(1.0*random_iterations);
+      iter->RescaleRandRand(1.0*random_iterations);
+    }
+  }
+  completed_stages_ |= GalGalStage;
+  random_iterations_ = random_iterations;
+  randoms_normalized_ = true;
+
+  return WriteCheckpoint(output_file_name);
+}
+
+bool AngularCorrelation::MergePairWorkUnits(const std::string& prefix) {
+  uint32_t n_work_units, random_iterations, tree_resolution;
+  uint16_t node_capacity;
+  bool auto_correlation, use_regions;
+  if (!_ReadWorkUnits(prefix, n_work_units, auto_correlation,
+		      random_iterations, tree_resolution, node_capacity,
+		      use_regions) ||
+      !ReadCheckpoint(prefix + ".job"))
+    return false;
+
+  for (ThetaIterator iter=theta_pair_begin_;iter!=theta_pair_end_;++iter)
+    iter->Reset();
+
+  uint32_t pair_begin = theta_pair_begin_ - thetabin_.begin();
+  uint32_t pair_end = theta_pair_end_ - thetabin_.begin();
+  AngularCorrelation wtheta = *this;
+  for (uint32_t work_unit=0;work_unit<n_work_units;work_unit++) {
+    if (!wtheta.ReadCheckpoint(_WorkUnitFile(prefix, work_unit, "out")) ||
+	(wtheta.theta_pair_begin_ != wtheta.thetabin_.begin() + pair_begin) ||
+	(wtheta.theta_pair_end_ != wtheta.thetabin_.begin() + pair_end) ||
+	(wtheta.RandomIterations() != random_iterations)) {
+      std::cout << "Stomp::AngularCorrelation::MergePairWorkUnits - " <<
+	"Work unit " << work_unit << " is missing or doesn't match.\n";
+      ReadCheckpoint(prefix + ".job");
+      return false;
+    }
+    for (uint32_t i=pair_begin;i<pair_end;i++) {
+      if (!thetabin_[i].Add(wtheta.thetabin_[i])) {
+	std::cout << "Stomp::AngularCorrelation::MergePairWorkUnits - " <<
+	  "Work unit " << work_unit << " has incompatible binning or " <<
+	  "regions.\n";
+	ReadCheckpoint(prefix + ".job");
+	return false;
+      }
+    }
+  }
+
+  completed_stages_ |= GalGalStage;
+  random_iterations_ = random_iterations;
+  randoms_normalized_ = true;
+
+  return true;
+}
+
+bool AngularCorrelation::_ReadWorkUnits(const std::string& prefix,
+					uint32_t& n_work_units,
+					bool& auto_correlation,
+					uint32_t& random_iterations,
+					uint32_t& tree_resolution,
+					uint16_t& node_capacity,
+					bool& use_regions) {
+  std::string units_file_name = prefix + ".units";
+  std::ifstream units_file(units_file_name.c_str());
+  std::string tag;
+  int version, auto_flag, regions_flag;
+
+  if (!(units_file >> tag >> version) || (tag != "STOMP_PAIR_WORK_UNITS") ||
+      (version != 1) ||
+      !(units_file >> n_work_units >> auto_flag >> random_iterations >>
+	tree_resolution >> regions_flag >> node_capacity)) {
+    std::cout << "Stomp::AngularCorrelation - Can't read work units from " <<
+      units_file_name << "\n";
+    return false;
+  }
+  auto_correlation = (auto_flag == 1);
+  use_regions = (regions_flag == 1);
+
+  return true;
+}
+
+std::string AngularCorrelation::_WorkUnitFile(const std::string& prefix,
+					      uint32_t work_unit,
+					      const std::string& suffix) {
+  std::ostringstream file_name;
+  file_name << prefix << "." << work_unit << "." << suffix;
+  return file_name.str();
+}
+
+void AngularCorrelation::_FindWorkUnits(Map& stomp_map,
+					PointCatalog& catalog,
+					bool use_regions,
+					std::vector<int64_t>& unit_bounds,
+					std::vector<uint32_t>& work_unit) {
+  work_unit.assign(catalog.Size(), 0);
+
+  const uint32_t block_size = 4096;
+  uint32_t n_point = catalog.Size();
+  uint32_t n_block = (n_point + block_size - 1)/block_size;
+  ParallelFor(n_block, DefaultThreads(), [&](uint32_t block) {
+    uint32_t end = (block + 1)*block_size;
+    if (end > n_point) end = n_point;
+    AngularCoordinate ang;
+    for (uint32_t i=block*block_size;i<end;i++) {
+      catalog.Point(i, ang);
+      int64_t key;
+      if (use_regions) {
+	key = stomp_map.FindRegion(ang);
+      } else {
+	Pixel pix(ang, HPixResolution);
+	key = pix.Pixnum();
+      }
+      work_unit[i] = std::upper_bound(unit_bounds.begin(), unit_bounds.end(),
+				      key) - unit_bounds.begin();
+    }
+  });
+}
+
+void AngularCorrelation::_FindWorkUnitNeighborhoods(
+  PointCatalog& catalog, std::vector<uint32_t>& work_unit,
+  uint32_t tree_resolution, double theta_max,
+  std::vector<std::vector<uint32_t> >& neighborhood) {
+  // TreeMap only looks at the tree pixels returned by BoundingRadius around
+  // each query point.  Rather than doing that for every point, we do it once
+  // for each tree pixel containing query points, padding the radius by the
+  // size of the pixel so that the result covers every point inside it.
+  std::vector<uint64_t> unit_pixels;
+  unit_pixels.reserve(catalog.Size());
+  AngularCoordinate ang;
+  for (uint32_t i=0;i<catalog.Size();i++) {
+    catalog.Point(i, ang);
+    Pixel pix(ang, tree_resolution);
+    unit_pixels.push_back((static_cast<uint64_t>(work_unit[i]) << 32) |
+			  pix.Pixnum());
+  }
+  std::sort(unit_pixels.begin(), unit_pixels.end());
+  unit_pixels.erase(std::unique(unit_pixels.begin(), unit_pixels.end()),
+		    unit_pixels.end());
+
+  PixelVector cover_pix;
+  for (std::vector<uint64_t>::iterator iter=unit_pixels.begin();
+       iter!=unit_pixels.end();++iter) {
+    uint32_t unit = static_cast<uint32_t>(*iter >> 32);
+    Pixel pix(tree_resolution, static_cast<uint32_t>(*iter & 0xffffffff));
+    double pad = pix.LambdaMax() - pix.LambdaMin();
+    if (pix.EtaMax() - pix.EtaMin() > pad) pad = pix.EtaMax() - pix.EtaMin();
+    pix.Ang(ang);
+    pix.BoundingRadius(ang, theta_max + pad, cover_pix);
+    for (PixelIterator cover_iter=cover_pix.begin();
+	 cover_iter!=cover_pix.end();++cover_iter)
+      neighborhood[unit].push_back(cover_iter->Pixnum());
+  }
+
+  for (uint32_t i=0;i<neighborhood.size();i++) {
+    std::sort(neighborhood[i].begin(), neighborhood[i].end());
+    neighborhood[i].erase(std::unique(neighborhood[i].begin(),
+				      neighborhood[i].end()),
+			  neighborhood[i].end());
+  }
+}
+
+bool AngularCorrelation::_WriteWorkUnitQueries(PointCatalog& catalog,
+					       std::vector<uint32_t>& work_unit,
+					       uint32_t n_work_units,
+					       const std::string& prefix,
+					       const std::string& suffix) {
+  std::vector<uint8_t> keep;
+  PointCatalog unit_catalog;
+  for (uint32_t unit=0;unit<n_work_units;unit++) {
+    keep.assign(catalog.Size(), 0);
+    for (uint32_t i=0;i<catalog.Size();i++)
+      if (work_unit[i] == unit) keep[i] = 1;
+    catalog.Select(keep, unit_catalog);
+    if (!unit_catalog.Write(_WorkUnitFile(prefix, unit, suffix)))
+      return false;
+  }
+
+  return true;
+}
+
+bool AngularCorrelation::_WriteWorkUnitTrees(
+  PointCatalog& catalog, uint32_t tree_resolution,
+  std::vector<std::vector<uint32_t> >& neighborhood,
+  const std::string& prefix, const std::string& suffix) {
+  // Invert the neighborhoods so that we can find all of the work units that
+  // want a given tree pixel.
+  std::vector<std::pair<uint32_t, uint32_t> > pixel_units;
+  for (uint32_t unit=0;unit<neighborhood.size();unit++) {
+    std::sort(neighborhood[unit].begin(), neighborhood[unit].end());
+    neighborhood[unit].erase(std::unique(neighborhood[unit].begin(),
+					 neighborhood[unit].end()),
+			     neighborhood[unit].end());
+    for (std::vector<uint32_t>::iterator iter=neighborhood[unit].begin();
+	 iter!=neighborhood[unit].end();++iter)
+      pixel_units.push_back(std::make_pair(*iter, unit));
+  }
+  std::sort(pixel_units.begin(), pixel_units.end());
+
+  std::vector<std::vector<uint32_t> > unit_points(neighborhood.size());
+  AngularCoordinate ang;
+  for (uint32_t i=0;i<catalog.Size();i++) {
+    catalog.Point(i, ang);
+    Pixel pix(ang, tree_resolution);
+    std::vector<std::pair<uint32_t, uint32_t> >::iterator iter =
+      std::lower_bound(pixel_units.begin(), pixel_units.end(),
+		       std::make_pair(pix.Pixnum(), static_cast<uint32_t>(0)));
+    for (;(iter!=pixel_units.end()) && (iter->first == pix.Pixnum());++iter)
+      unit_points[iter->second].push_back(i);
+  }
+
+  std::vector<uint8_t> keep(catalog.Size(), 0);
+  PointCatalog unit_catalog;
+  for (uint32_t unit=0;unit<unit_points.size();unit++) {
+    for (std::vector<uint32_t>::iterator iter=unit_points[unit].begin();
+	 iter!=unit_points[unit].end();++iter) keep[*iter] = 1;
+    catalog.Select(keep, unit_catalog);
+    for (std::vector<uint32_t>::iterator iter=unit_points[unit].begin();
+	 iter!=unit_points[unit].end();++iter) keep[*iter] = 0;
+    if (!unit_catalog.Write(_WorkUnitFile(prefix, unit, suffix)))
+      return false;
+  }
+
+  return true;
+}
+
+TreeMap* AngularCorrelation::_BuildWorkUnitTree(PointCatalog& catalog,
+						uint32_t tree_resolution,
+						uint16_t node_capacity,
+						bool use_regions,
+						const std::string& prefix) {
+  TreeMap* tree = new TreeMap(tree_resolution, node_capacity);
+  uint32_t n_fail = catalog.Size() - tree->AddPoint(catalog);
+  if (n_fail > 0)
+    std::cout << "Stomp::AngularCorrelation::RunPairWorkUnit - " <<
+      "Failed to add " << n_fail << " points to tree\n";
+
+  if (use_regions && !tree->ReadRegions(prefix + ".regions")) {
+    std::cout << "Stomp::AngularCorrelation::RunPairWorkUnit - " <<
+      "Failed to initialize regions on TreeMap  Exiting.\n";
+    exit(2);
+  }
+
+  return tree;
+}
+
+void AngularCorrelation::_FindWorkUnitPairs(TreeMap* tree,
+					    PointCatalog& catalog,
+					    bool use_regions) {
+  for (ThetaIterator iter=theta_pair_begin_;iter!=theta_pair_end_;++iter) {
+    if (use_regions) {
+      tree->FindWeightedPairsWithRegions(catalog, *iter);
+    } else {
+      tree->FindWeightedPairs(catalog, *iter);
+    }
+  }
+}
+
+void AngularCorrelation::_InitializeCheckpoint() {
+  checkpoint_file_.clear();
+  completed_stages_ = 0;
+  random_iterations_ = 0;
+  randoms_normalized_ = false;
+}
+
+void AngularCorrelation::_InitializeTuning() {
+  tree_resolution_ = 0;
+  tree_node_capacity_ = 200;
+  auto_tune_ = false;
+  tuning_pair_seconds_.clear();
+  tuning_pixel_seconds_.clear();
+  tuning_seconds_ = 0.0;
+}
+
+bool AngularCorrelation::_ResumeCheckpoint() {
+  if (checkpoint_file_.empty()) return false;
+
+  std::ifstream checkpoint(checkpoint_file_.c_str());
+  if (!checkpoint) return false;
+  checkpoint.close();
+
+  if (!ReadCheckpoint(checkpoint_file_)) {
+    std::cout << "Stomp::AngularCorrelation - Can't resume from " <<
+      checkpoint_file_ << ".  Exiting.\n";
+    exit(2);
+  }
+
+  return true;
+}
+
+void AngularCorrelation::_SaveCheckpoint() {
+  if (!checkpoint_file_.empty()) WriteCheckpoint(checkpoint_file_);
+}
+
 void AngularCorrelation::UseOnlyPixels() {
   AssignBinResolutions();
   theta_pixel_begin_ = thetabin_.begin();
@@ -1027,13 +2294,21 @@ double AngularCorrelation::Covariance(uint8_t bin_idx_a, uint8_t bin_idx_b) {
     // We have a valid number of regions and both bins were calculated with
     // the same number of regions, so we calculate the jack-knife covariance.
     uint16_t n_region = theta_a->NRegion();
-    double mean_wtheta_a = theta_a->MeanWtheta();
-    double mean_wtheta_b = theta_b->MeanWtheta();
+    std::vector<double> wtheta_a, wtheta_b;
+    theta_a->JackknifeWtheta(wtheta_a);
+    theta_b->JackknifeWtheta(wtheta_b);
+
+    double mean_wtheta_a = 0.0;
+    double mean_wtheta_b = 0.0;
+    for (uint16_t region_iter=0;region_iter<n_region;region_iter++) {
+      mean_wtheta_a += wtheta_a[region_iter]/(1.0*n_region);
+      mean_wtheta_b += wtheta_b[region_iter]/(1.0*n_region);
+    }
 
     for (uint16_t region_iter=0;region_iter<n_region;region_iter++) {
       covariance +=
-	(theta_a->Wtheta(region_iter) - mean_wtheta_a)*
-	(theta_b->Wtheta(region_iter) - mean_wtheta_b);
+	(wtheta_a[region_iter] - mean_wtheta_a)*
+	(wtheta_b[region_iter] - mean_wtheta_b);
     }
 
     covariance *= (n_region - 1.0)*(n_region - 1.0)/(1.0*n_region*n_region);
@@ -1049,6 +2324,51 @@ double AngularCorrelation::Covariance(uint8_t bin_idx_a, uint8_t bin_idx_b) {
   return covariance;
 }
 
+void AngularCorrelation::CovarianceMatrix(std::vector<double>& covariance) {
+  uint32_t n_bins = thetabin_.size();
+  covariance.assign(n_bins*n_bins, 0.0);
+
+  // Gather the deviations of each bin's jack-knife w(theta) values from
+  // their mean into a single [bin][region] matrix, D.  The jack-knife part of
+  // the covariance matrix is then just D*D^T (suitably normalized), which we
+  // only need to do for the upper triangle.
+  int16_t max_region = 0;
+  for (uint32_t a=0;a<n_bins;a++)
+    if (thetabin_[a].NRegion() > max_region)
+      max_region = thetabin_[a].NRegion();
+
+  std::vector<double> deviation(n_bins*max_region, 0.0);
+  std::vector<double> wtheta;
+  for (uint32_t a=0;a<n_bins;a++) {
+    int16_t n_region = thetabin_[a].NRegion();
+    if (n_region <= 0) continue;
+
+    thetabin_[a].JackknifeWtheta(wtheta);
+    double mean_wtheta = 0.0;
+    for (int16_t k=0;k<n_region;k++) mean_wtheta += wtheta[k]/(1.0*n_region);
+
+    double* row = &deviation[a*max_region];
+    for (int16_t k=0;k<n_region;k++) row[k] = wtheta[k] - mean_wtheta;
+  }
+
+  for (uint32_t a=0;a<n_bins;a++) {
+    int16_t n_region = thetabin_[a].NRegion();
+    for (uint32_t b=a;b<n_bins;b++) {
+      double element = 0.0;
+      if ((n_region == thetabin_[b].NRegion()) && (n_region > 0)) {
+	const double* row_a = &deviation[a*max_region];
+	const double* row_b = &deviation[b*max_region];
+	for (int16_t k=0;k<n_region;k++) element += row_a[k]*row_b[k];
+	element *= (n_region - 1.0)*(n_region - 1.0)/(1.0*n_region*n_region);
+      } else if (a == b) {
+	element = thetabin_[a].WthetaError()*thetabin_[a].WthetaError();
+      }
+      covariance[a*n_bins + b] = element;
+      covariance[b*n_bins + a] = element;
+    }
+  }
+}
+
 bool AngularCorrelation::WriteCovariance(const std::string& output_file_name) {
   bool wrote_file = false;
 
@@ -1057,12 +2377,16 @@ bool AngularCorrelation::WriteCovariance(const std::string& output_file_name) {
   if (output_file.is_open()) {
     wrote_file = true;
 
-    for (uint8_t theta_idx_a=0;theta_idx_a<thetabin_.size();theta_idx_a++) {
-      for (uint8_t theta_idx_b=0;theta_idx_b<thetabin_.size();theta_idx_b++) {
+    std::vector<double> covariance;
+    CovarianceMatrix(covariance);
+
+    uint32_t n_bins = thetabin_.size();
+    for (uint32_t theta_idx_a=0;theta_idx_a<n_bins;theta_idx_a++) {
+      for (uint32_t theta_idx_b=0;theta_idx_b<n_bins;theta_idx_b++) {
 	output_file << std::setprecision(6) <<
 	  thetabin_[theta_idx_a].Theta() << " " <<
 	  thetabin_[theta_idx_b].Theta() << " " <<
-	  Covariance(theta_idx_a, theta_idx_b) << "\n";
+	  covariance[theta_idx_a*n_bins + theta_idx_b] << "\n";
       }
     }
 
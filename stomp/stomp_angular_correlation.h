@@ -16,7 +16,9 @@
 #ifndef STOMP_ANGULAR_CORRELATION_H
 #define STOMP_ANGULAR_CORRELATION_H
 
+#include <stdint.h>
 #include <vector>
+#include <string>
 #include "stomp_core.h"
 #include "stomp_angular_coordinate.h"
 #include "stomp_angular_bin.h"
@@ -26,6 +28,7 @@ namespace Stomp {
 class Map;        // class declaration in stomp_map.h
 class ScalarMap;  // class declaration in stomp_scalar_map.h
 class TreeMap;    // class declaration in stomp_tree_map.h
+class PointCatalog;  // class declaration in stomp_point_catalog.h
 class AngularCorrelation;
 
 typedef std::vector<AngularCorrelation> WThetaVector;
@@ -57,6 +60,10 @@ class AngularCorrelation {
   // spacing of the bins is determined based on the requested number of bins.
   AngularCorrelation(uint32_t n_bins, double theta_min, double theta_max,
 		     bool assign_resolutions = true);
+  // Copying needs to rebase the iterators marking the pixel- and pair-based
+  // bins onto the new copy of the bins, so that WThetaVectors work.
+  AngularCorrelation(const AngularCorrelation& wtheta);
+  AngularCorrelation& operator=(const AngularCorrelation& wtheta);
   ~AngularCorrelation() {
     thetabin_.clear();
   };
@@ -87,6 +94,50 @@ class AngularCorrelation {
   // correlation function calculation and the area involved.
   void AutoMaxResolution(uint32_t n_obj, double area);
 
+  // AutoMaxResolution only looks at the number of objects and the area, so
+  // it can be well off for very sparse or very dense samples.  AutoTune
+  // instead times the pair counting on a patch of the input catalog (around
+  // n_calibration query points) for a range of TreeMap resolutions and node
+  // capacities, along with the pixel-based estimator on a patch of the Map,
+  // and scales those timings up to the full measurement.  It then picks the
+  // break between the two estimators and the TreeMap parameters that
+  // minimize the predicted run time.  As with AutoMaxResolution, the break
+  // isn't treated as a manual one.  If regions are being used, this needs
+  // to be called after they've been initialized.  SetAutoTune(true) makes
+  // the Find*Correlation wrappers call AutoTune rather than
+  // AutoMaxResolution.
+  void AutoTune(Map& stomp_map, PointCatalog& galaxy,
+		uint8_t random_iterations = 1, uint32_t n_calibration = 1000);
+  void AutoTune(Map& stomp_map_a, Map& stomp_map_b,
+		PointCatalog& galaxy_a, PointCatalog& galaxy_b,
+		uint8_t random_iterations = 1, uint32_t n_calibration = 1000);
+  void SetAutoTune(bool auto_tune = true);
+
+  // The predicted run time (in seconds) from the last call to AutoTune and
+  // a record of how it got there.  The output format is
+  //
+  //   tree_resolution RESOLUTION
+  //   node_capacity CAPACITY
+  //   max_resolution RESOLUTION
+  //   predicted_seconds SECONDS
+  //   bin THETA RESOLUTION PAIR_SECONDS PIXEL_SECONDS
+  //
+  // with one bin line for each angular bin, giving the resolution that the
+  // bin will be calculated at (0 for the pair-based estimator) and the
+  // predicted time for either estimator.
+  double PredictedSeconds();
+  bool WriteTuning(const std::string& output_file_name);
+
+  // The pair-based estimator uses a TreeMap with the coarsest resolution of
+  // the pixel-based bins (or the regionation resolution, if that's larger)
+  // and a node capacity of 200 points unless these are set by hand or by
+  // AutoTune.  The resolution is never allowed to go below the regionation
+  // resolution.
+  void SetTreeParameters(uint32_t tree_resolution,
+			 uint16_t node_capacity = 200);
+  uint32_t TreeResolution();
+  uint16_t TreeNodeCapacity();
+
   // If we're going to use regions to find jack-knife errors, then we need
   // to initialize the AngularBins to handle this state of affairs or possibly
   // clear out previous calculations.
@@ -146,6 +197,42 @@ class AngularCorrelation {
 				uint8_t random_iterations = 1,
 				bool use_weighted_randoms = false);
 
+  // Each of the above methods also takes PointCatalogs in place of the
+  // WAngularVectors.  The WAngularVector versions convert their input to a
+  // PointCatalog and call these, so these are the ones to use for large
+  // catalogs.
+  void FindAutoCorrelation(Map& stomp_map, PointCatalog& galaxy,
+			   uint8_t random_iterations = 1,
+			   bool use_weighted_randoms = false);
+  void FindCrossCorrelation(Map& stomp_map_a, Map& stomp_map_b,
+			    PointCatalog& galaxy_a, PointCatalog& galaxy_b,
+			    uint8_t random_iterations = 1,
+			    bool use_weighted_randoms = false);
+  void FindAutoCorrelationWithRegions(Map& stomp_map, PointCatalog& galaxy,
+				      uint8_t random_iterations = 1,
+				      uint16_t n_regions = 0,
+				      bool use_weighted_randoms = false);
+  void FindCrossCorrelationWithRegions(Map& stomp_map_a, Map& stomp_map_b,
+				       PointCatalog& galaxy_a,
+				       PointCatalog& galaxy_b,
+				       uint8_t random_iterations = 1,
+				       uint16_t n_regions = 0,
+				       bool use_weighted_randoms = false);
+  void FindPixelAutoCorrelation(Map& stomp_map, PointCatalog& galaxy,
+				bool use_weighted_randoms = false);
+  void FindPixelCrossCorrelation(Map& stomp_map_a, Map& stomp_map_b,
+				 PointCatalog& galaxy_a,
+				 PointCatalog& galaxy_b,
+				 bool use_weighted_randoms = false);
+  void FindPairAutoCorrelation(Map& stomp_map, PointCatalog& galaxy,
+			       uint8_t random_iterations = 1,
+			       bool use_weighted_randoms = false);
+  void FindPairCrossCorrelation(Map& stomp_map_a, Map& stomp_map_b,
+				PointCatalog& galaxy_a,
+				PointCatalog& galaxy_b,
+				uint8_t random_iterations = 1,
+				bool use_weighted_randoms = false);
+
   // Once we're done calculating our correlation function, we can write it out
   // to an ASCII file.  The output format will be
   //
@@ -156,6 +243,64 @@ class AngularCorrelation {
   // calculated without regions, then this column will be omitted.
   bool Write(const std::string& output_file_name);
 
+  // Long pair-counting runs can be checkpointed.  Once a checkpoint file has
+  // been set, the Map-based Find*Correlation methods save everything they've
+  // accumulated to it after the pixel-based bins are done, after the
+  // galaxy-galaxy pairs and after each random iteration.  If the file
+  // already exists when they start, they pick up where it left off rather
+  // than starting over: finished stages are skipped and only the random
+  // iterations beyond those already done are run.  Re-running a finished
+  // measurement with a larger number of random iterations adds the extra
+  // iterations to the existing result.  The checkpoint needs to have come
+  // from the same binning, Maps and regions.
+  void SetCheckpointFile(const std::string& checkpoint_file);
+  bool WriteCheckpoint(const std::string& checkpoint_file);
+  bool ReadCheckpoint(const std::string& checkpoint_file);
+  uint32_t RandomIterations();
+
+  // Combine another measurement with the same binning and regions with this
+  // one.  If same_galaxies is true, the other measurement is taken to be
+  // more random iterations on the same galaxy catalogs, so only the random
+  // pair counts are combined (weighted by the number of iterations behind
+  // each).  Otherwise, the other measurement is for an additional set of
+  // catalogs and all of the pair counts and pixel sums are added together.
+  bool Merge(AngularCorrelation& wtheta, bool same_galaxies = false);
+
+  // For measurements too big for a single machine, the pair-based bins can
+  // be split into independent work units, each of which can be run as a
+  // separate process (under xargs -P or a batch scheduler) as long as they
+  // all see the same filesystem.  The split is by jack-knife region (or by
+  // superpixel if the Map hasn't been regionated): each work unit counts
+  // the pairs for the points in a contiguous block of regions against a
+  // tree holding only the points that could possibly be within the largest
+  // pair-based angular bin of them.
+  //
+  // The Write*WorkUnits methods take the same input as the equivalent
+  // FindPair*Correlation methods.  They generate the random catalogs and
+  // write everything that each of n_work_units work units needs to files
+  // starting with prefix, along with the current state of this object (so
+  // any pixel-based bins should be done first) and the Map's regions.
+  // RunPairWorkUnit then does the pair counting for a single work unit
+  // (numbered from 0) and writes its partial pair counts to another file;
+  // a work unit whose output already exists is skipped, so a failed batch
+  // can just be re-submitted.  Once all of the work units are done,
+  // MergePairWorkUnits restores the state written by Write*WorkUnits and
+  // adds up the pair counts from every work unit, giving the same result as
+  // the FindPair*Correlation methods.  All three steps need an object with
+  // the same binning as the one that wrote the work units.
+  bool WritePairAutoWorkUnits(Map& stomp_map, PointCatalog& galaxy,
+			      const std::string& prefix, uint32_t n_work_units,
+			      uint8_t random_iterations = 1,
+			      bool use_weighted_randoms = false);
+  bool WritePairCrossWorkUnits(Map& stomp_map_a, Map& stomp_map_b,
+			       PointCatalog& galaxy_a, PointCatalog& galaxy_b,
+			       const std::string& prefix,
+			       uint32_t n_work_units,
+			       uint8_t random_iterations = 1,
+			       bool use_weighted_randoms = false);
+  bool RunPairWorkUnit(const std::string& prefix, uint32_t work_unit);
+  bool MergePairWorkUnits(const std::string& prefix);
+
   // In some cases, we want to default to using either the pair-based or
   // pixel-based estimator for all of our bins, regardless of angular scale.
   // These methods allow us to over-ride the default behavior of the
@@ -186,6 +331,11 @@ class AngularCorrelation {
   // covariance matrix.
   double Covariance(uint8_t bin_idx_a, uint8_t bin_idx_b);
 
+  // If we want all of the elements, it's much faster to get the whole matrix
+  // at once.  The matrix is returned as NBins()*NBins() values, with the
+  // (theta_a, theta_b) element in covariance[a*NBins() + b].
+  void CovarianceMatrix(std::vector<double>& covariance);
+
   // Alternatively, we can just write the full covariance matrix to a file.
   // The output format will be
   //
@@ -195,6 +345,74 @@ class AngularCorrelation {
 
 
  private:
+  void _CopyFrom(const AngularCorrelation& wtheta);
+
+  // The stages of a correlation measurement that the checkpoint tracks.
+  enum CheckpointStage {
+    PixelStage = 1,
+    GalGalStage = 2
+  };
+  void _InitializeCheckpoint();
+  void _InitializeTuning();
+  bool _ResumeCheckpoint();
+  void _SaveCheckpoint();
+
+  // The internals of the work unit methods.  _FindWorkUnits assigns each
+  // point to a work unit based on its region (or superpixel) and
+  // _FindWorkUnitNeighborhoods adds the pixels (at the tree resolution)
+  // that the pair counting for each work unit's points would look at to
+  // that work unit's neighborhood.  _WriteWorkUnitQueries and
+  // _WriteWorkUnitTrees then write the points belonging to each work unit
+  // or falling in its neighborhood.
+  bool _WritePairWorkUnits(Map& stomp_map_a, Map& stomp_map_b,
+			   PointCatalog& galaxy_a, PointCatalog& galaxy_b,
+			   const std::string& prefix, uint32_t n_work_units,
+			   uint8_t random_iterations, bool use_weighted_randoms,
+			   bool auto_correlation);
+  bool _ReadWorkUnits(const std::string& prefix, uint32_t& n_work_units,
+		      bool& auto_correlation, uint32_t& random_iterations,
+		      uint32_t& tree_resolution, uint16_t& node_capacity,
+		      bool& use_regions);
+  static std::string _WorkUnitFile(const std::string& prefix,
+				   uint32_t work_unit,
+				   const std::string& suffix);
+  static void _FindWorkUnits(Map& stomp_map, PointCatalog& catalog,
+			     bool use_regions,
+			     std::vector<int64_t>& unit_bounds,
+			     std::vector<uint32_t>& work_unit);
+  static void _FindWorkUnitNeighborhoods(
+    PointCatalog& catalog, std::vector<uint32_t>& work_unit,
+    uint32_t tree_resolution, double theta_max,
+    std::vector<std::vector<uint32_t> >& neighborhood);
+  static bool _WriteWorkUnitQueries(PointCatalog& catalog,
+				    std::vector<uint32_t>& work_unit,
+				    uint32_t n_work_units,
+				    const std::string& prefix,
+				    const std::string& suffix);
+  static bool _WriteWorkUnitTrees(
+    PointCatalog& catalog, uint32_t tree_resolution,
+    std::vector<std::vector<uint32_t> >& neighborhood,
+    const std::string& prefix, const std::string& suffix);
+  TreeMap* _BuildWorkUnitTree(PointCatalog& catalog, uint32_t tree_resolution,
+			      uint16_t node_capacity, bool use_regions,
+			      const std::string& prefix);
+  void _FindWorkUnitPairs(TreeMap* tree, PointCatalog& catalog,
+			  bool use_regions);
+
+  // The internals of AutoTune.  _FindCalibrationPatch copies the points
+  // within radius (in degrees) of center into patch, keeping at most
+  // max_points of them (0 keeps them all).  _AnnulusPixels is the number of
+  // pixels at the given resolution that fit in an annulus.
+  void _AutoTune(Map& stomp_map_a, Map& stomp_map_b,
+		 PointCatalog& galaxy_a, PointCatalog& galaxy_b,
+		 uint8_t random_iterations, uint32_t n_calibration,
+		 bool auto_correlation);
+  static void _FindCalibrationPatch(PointCatalog& catalog,
+				    AngularCoordinate& center, double radius,
+				    uint32_t max_points, PointCatalog& patch);
+  static double _AnnulusPixels(double theta_min, double theta_max,
+			       uint32_t resolution);
+
   ThetaVector thetabin_;
   ThetaIterator theta_pixel_begin_, theta_pixel_end_;
   ThetaIterator theta_pair_begin_, theta_pair_end_;
@@ -202,6 +420,15 @@ class AngularCorrelation {
   uint32_t min_resolution_, max_resolution_, regionation_resolution_;
   int16_t n_region_;
   bool manual_resolution_break_;
+  std::string checkpoint_file_;
+  uint8_t completed_stages_;
+  uint32_t random_iterations_;
+  bool randoms_normalized_;
+  uint32_t tree_resolution_;
+  uint16_t tree_node_capacity_;
+  bool auto_tune_;
+  std::vector<double> tuning_pair_seconds_, tuning_pixel_seconds_;
+  double tuning_seconds_;
 };
 
 } // end namespace Stomp
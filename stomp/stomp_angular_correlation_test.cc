@@ -2,12 +2,17 @@
 #include <iostream>
 #include <math.h>
 #include <string>
+#include <vector>
+#include <cstdio>
+#include <sstream>
 #include <gflags/gflags.h>
 #include "stomp_core.h"
 #include "stomp_angular_bin.h"
 #include "stomp_angular_correlation.h"
 #include "stomp_map.h"
 #include "stomp_scalar_map.h"
+#include "stomp_point_catalog.h"
+#include "stomp_tree_map.h"
 
 void AngularBinningTests() {
   // Now we break out the angular bin code.  This class lets you define either
@@ -137,13 +142,434 @@ void AngularBinningTests() {
   }
 }
 
+void AngularCorrelationJackknifeTests() {
+  // The jack-knife region values are stored as totals minus the
+  // contribution from each region.  Check them and the covariance matrix
+  // against the straightforward approach of adding each pair to every
+  // region that it doesn't touch.
+  std::cout << "\n";
+  std::cout << "******************************************\n";
+  std::cout << "*** AngularCorrelation Jackknife Tests ***\n";
+  std::cout << "******************************************\n";
+  Stomp::AngularCorrelation wtheta(0.01, 1.0, 6.0);
+  int16_t n_region = 50;
+  uint32_t n_bins = wtheta.NBins();
+  for (Stomp::ThetaIterator iter=wtheta.Begin();iter!=wtheta.End();++iter)
+    iter->InitializeRegions(n_region);
+
+  std::vector<double> pixel_wtheta(n_bins*n_region, 0.0);
+  std::vector<double> pixel_weight(n_bins*n_region, 0.0);
+  std::vector<double> weight(n_bins*n_region, 0.0);
+  std::vector<double> counter(n_bins*n_region, 0.0);
+  uint64_t seed = 12345;
+  for (uint32_t bin_idx=0;bin_idx<n_bins;bin_idx++) {
+    Stomp::ThetaIterator theta_iter = wtheta.BinIterator(bin_idx);
+    for (uint32_t i=0;i<20000;i++) {
+      seed = seed*6364136223846793005ULL + 1442695040888963407ULL;
+      int16_t region_a =
+	static_cast<int16_t>((seed >> 33) % (n_region + 1)) - 1;
+      int16_t region_b = static_cast<int16_t>((seed >> 17) % n_region);
+      double dwtheta = 0.01*((seed >> 40) % 1000) - 4.0 + 0.1*bin_idx;
+      double dweight = 1.0 + ((seed >> 20) % 7);
+
+      theta_iter->AddToPixelWtheta(dwtheta, dweight, region_a, region_b);
+      theta_iter->AddToWeight(dwtheta, region_b);
+      theta_iter->AddToCounter(1, region_b);
+      for (int16_t k=0;k<n_region;k++) {
+	if ((region_a != -1) && (k != region_a) && (k != region_b)) {
+	  pixel_wtheta[bin_idx*n_region + k] += dwtheta;
+	  pixel_weight[bin_idx*n_region + k] += dweight;
+	}
+	if (k != region_b) {
+	  weight[bin_idx*n_region + k] += dwtheta;
+	  counter[bin_idx*n_region + k] += 1.0;
+	}
+      }
+    }
+  }
+
+  uint32_t n_mismatch = 0;
+  std::vector<double> reference_wtheta(n_bins*n_region);
+  for (uint32_t bin_idx=0;bin_idx<n_bins;bin_idx++) {
+    Stomp::ThetaIterator theta_iter = wtheta.BinIterator(bin_idx);
+    std::vector<double> jackknife_wtheta;
+    theta_iter->JackknifeWtheta(jackknife_wtheta);
+    for (int16_t k=0;k<n_region;k++) {
+      uint32_t idx = bin_idx*n_region + k;
+      reference_wtheta[idx] = pixel_wtheta[idx]/pixel_weight[idx];
+      if ((fabs(theta_iter->Wtheta(k) - reference_wtheta[idx]) >
+	   1.0e-10*fabs(reference_wtheta[idx])) ||
+	  (jackknife_wtheta[k] != theta_iter->Wtheta(k)) ||
+	  (fabs(theta_iter->WeightedCrossCorrelation(k) -
+		weight[idx]/counter[idx]) >
+	   1.0e-10*fabs(weight[idx]/counter[idx])) ||
+	  (theta_iter->Counter(k) != static_cast<uint32_t>(counter[idx])))
+	n_mismatch++;
+    }
+  }
+  std::cout << "\t" << n_bins << " bins, " << n_region << " regions: " <<
+    n_mismatch << " region mismatches\n";
+
+  std::vector<double> covariance;
+  wtheta.CovarianceMatrix(covariance);
+  n_mismatch = 0;
+  for (uint32_t a=0;a<n_bins;a++) {
+    double mean_a = 0.0;
+    for (int16_t k=0;k<n_region;k++)
+      mean_a += reference_wtheta[a*n_region + k]/n_region;
+    for (uint32_t b=0;b<n_bins;b++) {
+      double mean_b = 0.0;
+      for (int16_t k=0;k<n_region;k++)
+	mean_b += reference_wtheta[b*n_region + k]/n_region;
+      double reference_covariance = 0.0;
+      for (int16_t k=0;k<n_region;k++)
+	reference_covariance += (reference_wtheta[a*n_region + k] - mean_a)*
+	  (reference_wtheta[b*n_region + k] - mean_b);
+      reference_covariance *=
+	(n_region - 1.0)*(n_region - 1.0)/(1.0*n_region*n_region);
+      if ((fabs(covariance[a*n_bins + b] - reference_covariance) >
+	   1.0e-6*fabs(reference_covariance) + 1.0e-14) ||
+	  (fabs(wtheta.Covariance(a, b) - covariance[a*n_bins + b]) >
+	   1.0e-12*fabs(covariance[a*n_bins + b]))) n_mismatch++;
+    }
+  }
+  std::cout << "\tCovariance matrix: " << n_mismatch << " mismatches\n";
+}
+
+void AngularCorrelationCheckpointTests() {
+  // Check that a checkpointed pair-based measurement picks up where it left
+  // off and that extra random iterations merge into an existing result.
+  std::cout << "\n";
+  std::cout << "*******************************************\n";
+  std::cout << "*** AngularCorrelation Checkpoint Tests ***\n";
+  std::cout << "*******************************************\n";
+  Stomp::AngularCoordinate ang(20.0, 0.0, Stomp::AngularCoordinate::Survey);
+  Stomp::Pixel tmp_pix(ang, 256);
+  Stomp::PixelVector circle_pix;
+  tmp_pix.WithinRadius(1.0, circle_pix);
+  Stomp::Map stomp_map(circle_pix);
+
+  Stomp::AngularVector galaxy_ang;
+  stomp_map.GenerateRandomPoints(galaxy_ang, 2000, false, 1);
+  Stomp::PointCatalog galaxy(galaxy_ang);
+
+  std::string checkpoint_file = "AngularCorrelationCheckpoint.dat";
+  std::remove(checkpoint_file.c_str());
+
+  // One random iteration, saved to the checkpoint...
+  Stomp::AngularCorrelation wtheta_a(0.01, 0.1, 4.0);
+  wtheta_a.UseOnlyPairs();
+  wtheta_a.SetCheckpointFile(checkpoint_file);
+  wtheta_a.FindPairAutoCorrelation(stomp_map, galaxy, 1);
+
+  // ... and then two more on top of it.  The galaxy-galaxy pairs should be
+  // taken from the checkpoint rather than being re-done.
+  Stomp::AngularCorrelation wtheta_b(0.01, 0.1, 4.0);
+  wtheta_b.UseOnlyPairs();
+  wtheta_b.SetCheckpointFile(checkpoint_file);
+  for (Stomp::ThetaIterator iter=wtheta_b.Begin();iter!=wtheta_b.End();++iter)
+    iter->AddToWeight(1.0e10);
+  wtheta_b.FindPairAutoCorrelation(stomp_map, galaxy, 3);
+
+  Stomp::AngularCorrelation wtheta_c(0.01, 0.1, 4.0);
+  bool read_checkpoint = wtheta_c.ReadCheckpoint(checkpoint_file);
+
+  uint32_t n_mismatch = 0;
+  for (uint32_t i=0;i<wtheta_a.NBins();i++) {
+    Stomp::ThetaIterator iter_a = wtheta_a.BinIterator(i);
+    Stomp::ThetaIterator iter_b = wtheta_b.BinIterator(i);
+    Stomp::ThetaIterator iter_c = wtheta_c.BinIterator(i);
+    if ((iter_a->GalGal() != iter_b->GalGal()) ||
+	(iter_b->Wtheta() != iter_c->Wtheta()) ||
+	(iter_b->RandRand() != iter_c->RandRand()) ||
+	(iter_c->Resolution() != 0)) n_mismatch++;
+  }
+  std::cout << "\tResumed: " << wtheta_a.RandomIterations() << " + " <<
+    wtheta_b.RandomIterations() - wtheta_a.RandomIterations() <<
+    " random iterations; read checkpoint: " <<
+    (read_checkpoint ? "yes" : "no") << ", " << wtheta_c.RandomIterations() <<
+    " iterations; " << n_mismatch << " mismatches\n";
+
+  // Merging more random iterations for the same galaxies should weight the
+  // random pair counts by the number of iterations behind each.
+  Stomp::AngularCorrelation wtheta_d = wtheta_a;
+  wtheta_d.SetCheckpointFile("");
+  wtheta_d.Merge(wtheta_b, true);
+  n_mismatch = 0;
+  for (uint32_t i=0;i<wtheta_a.NBins();i++) {
+    Stomp::ThetaIterator iter_a = wtheta_a.BinIterator(i);
+    Stomp::ThetaIterator iter_b = wtheta_b.BinIterator(i);
+    Stomp::ThetaIterator iter_d = wtheta_d.BinIterator(i);
+    double rand_rand = (iter_a->RandRand() + 3.0*iter_b->RandRand())/4.0;
+    if ((iter_d->GalGal() != iter_a->GalGal()) ||
+	(fabs(iter_d->RandRand() - rand_rand) > 1.0e-10*rand_rand))
+      n_mismatch++;
+  }
+  std::cout << "\tMerged same galaxies: " << wtheta_d.RandomIterations() <<
+    " random iterations; " << n_mismatch << " mismatches\n";
+
+  // Merging a separate set of catalogs just adds everything.
+  Stomp::AngularCorrelation wtheta_e = wtheta_a;
+  wtheta_e.SetCheckpointFile("");
+  wtheta_e.Merge(wtheta_a);
+  n_mismatch = 0;
+  for (uint32_t i=0;i<wtheta_a.NBins();i++) {
+    Stomp::ThetaIterator iter_a = wtheta_a.BinIterator(i);
+    Stomp::ThetaIterator iter_e = wtheta_e.BinIterator(i);
+    if ((iter_e->GalGal() != 2.0*iter_a->GalGal()) ||
+	(iter_e->GalRand() != 2.0*iter_a->GalRand())) n_mismatch++;
+  }
+  std::cout << "\tMerged catalogs: " << n_mismatch << " mismatches\n";
+
+  // A w(theta) stored directly in a bin doesn't describe the summed counts,
+  // so adding bins should drop it, and bins with different ranges
+  // shouldn't add at all.
+  Stomp::AngularBin set_bin, count_bin;
+  std::istringstream set_state("0.1 0.2 0.15 0 0 1 1 0 100 50 50 40 0 0 "
+			       "0.5 0.1 0");
+  std::istringstream count_state("0.1 0.2 0.15 0 0 0 0 0 100 50 50 40 0 0 "
+				 "0 0 0");
+  set_bin.ReadState(set_state);
+  count_bin.ReadState(count_state);
+  bool added = set_bin.Add(count_bin);
+  Stomp::AngularBin other_bin(0.2, 0.3);
+  bool added_other = set_bin.Add(other_bin);
+  std::cout << "\tAdded bins: w(theta) = " << set_bin.Wtheta() <<
+    " (1), added mismatched bins: " << (added_other ? "yes" : "no") << "\n";
+  if (!added || added_other || !Stomp::DoubleEQ(set_bin.Wtheta(), 1.0))
+    std::cout << "\tFAILED: AngularBin::Add kept the stored w(theta) or " <<
+      "added mismatched bins.\n";
+
+  std::remove(checkpoint_file.c_str());
+}
+
+void AngularCorrelationWorkUnitTests() {
+  // Split a regionated pair-based auto-correlation into work units, run
+  // them and check that the merged result matches the same measurement done
+  // in one go against the reconstructed random catalog.
+  std::cout << "\n";
+  std::cout << "******************************************\n";
+  std::cout << "*** AngularCorrelation Work Unit Tests ***\n";
+  std::cout << "******************************************\n";
+  Stomp::AngularCoordinate ang(20.0, 0.0, Stomp::AngularCoordinate::Survey);
+  Stomp::Pixel tmp_pix(ang, 256);
+  Stomp::PixelVector circle_pix;
+  tmp_pix.WithinRadius(1.0, circle_pix);
+  Stomp::Map stomp_map(circle_pix);
+  int16_t n_region = stomp_map.InitializeRegions(8);
+
+  Stomp::AngularVector galaxy_ang;
+  stomp_map.GenerateRandomPoints(galaxy_ang, 2000, false, 1);
+  Stomp::PointCatalog galaxy(galaxy_ang);
+
+  std::string prefix = "AngularCorrelationWorkUnit";
+  uint32_t n_work_units = 3;
+  uint8_t random_iterations = 2;
+
+  Stomp::AngularCorrelation wtheta(0.01, 0.1, 4.0);
+  wtheta.UseOnlyPairs();
+  wtheta.SetMinResolution(stomp_map.RegionResolution());
+  wtheta.InitializeRegions(n_region);
+  bool wrote_units =
+    wtheta.WritePairAutoWorkUnits(stomp_map, galaxy, prefix, n_work_units,
+				  random_iterations);
+
+  // Each work unit in its own object, as if they were separate processes.
+  // Running a finished work unit again should just skip it.
+  uint32_t n_run = 0;
+  for (uint32_t i=0;i<n_work_units;i++) {
+    Stomp::AngularCorrelation wtheta_unit(0.01, 0.1, 4.0);
+    if (wtheta_unit.RunPairWorkUnit(prefix, i)) n_run++;
+  }
+  Stomp::AngularCorrelation wtheta_rerun(0.01, 0.1, 4.0);
+  bool skipped = wtheta_rerun.RunPairWorkUnit(prefix, 0);
+
+  Stomp::AngularCorrelation wtheta_merged(0.01, 0.1, 4.0);
+  bool merged = wtheta_merged.MergePairWorkUnits(prefix);
+  std::cout << "\tWrote work units: " << (wrote_units ? "yes" : "no") <<
+    "; ran " << n_run << "/" << n_work_units << "; re-run skipped: " <<
+    (skipped ? "yes" : "no") << "; merged: " << (merged ? "yes" : "no") <<
+    ", " << wtheta_merged.RandomIterations() << " random iterations\n";
+
+  // The query catalogs partition the inputs, so putting them back together
+  // gives us the random catalogs the work units used.
+  Stomp::AngularCorrelation wtheta_ref(0.01, 0.1, 4.0);
+  wtheta_ref.UseOnlyPairs();
+  wtheta_ref.InitializeRegions(n_region);
+  Stomp::PointCatalog galaxy_query;
+  for (uint32_t i=0;i<n_work_units;i++) {
+    std::ostringstream file_name;
+    file_name << prefix << "." << i << ".galaxy_query";
+    Stomp::PointCatalog unit_catalog;
+    unit_catalog.Read(file_name.str());
+    galaxy_query.Append(unit_catalog);
+  }
+
+  Stomp::TreeMap galaxy_tree(stomp_map.RegionResolution(), 200);
+  galaxy_tree.AddPoint(galaxy);
+  galaxy_tree.InitializeRegions(stomp_map);
+  for (Stomp::ThetaIterator iter=wtheta_ref.Begin();
+       iter!=wtheta_ref.End();++iter) {
+    galaxy_tree.FindWeightedPairsWithRegions(galaxy, *iter);
+    iter->MoveWeightToGalGal();
+  }
+
+  for (uint8_t rand_iter=0;rand_iter<random_iterations;rand_iter++) {
+    Stomp::PointCatalog random_galaxy;
+    for (uint32_t i=0;i<n_work_units;i++) {
+      std::ostringstream file_name;
+      file_name << prefix << "." << i << ".random_query." <<
+	static_cast<int>(rand_iter);
+      Stomp::PointCatalog unit_catalog;
+      unit_catalog.Read(file_name.str());
+      random_galaxy.Append(unit_catalog);
+    }
+
+    Stomp::TreeMap random_tree(stomp_map.RegionResolution(), 200);
+    random_tree.AddPoint(random_galaxy);
+    random_tree.InitializeRegions(stomp_map);
+    for (Stomp::ThetaIterator iter=wtheta_ref.Begin();
+	 iter!=wtheta_ref.End();++iter) {
+      random_tree.FindWeightedPairsWithRegions(galaxy, *iter);
+      iter->MoveWeightToGalRand(true);
+      random_tree.FindWeightedPairsWithRegions(random_galaxy, *iter);
+      iter->MoveWeightToRandRand();
+    }
+  }
+  for (Stomp::ThetaIterator iter=wtheta_ref.Begin();
+       iter!=wtheta_ref.End();++iter) {
+    iter->RescaleGalRand(1.0*random_iterations);
+    iter->RescaleRandGal(1.0*random_iterations);
+    iter->RescaleRandRand(1.0*random_iterations);
+  }
+
+  uint32_t n_mismatch = 0;
+  for (uint32_t i=0;i<wtheta_ref.NBins();i++) {
+    Stomp::ThetaIterator iter_ref = wtheta_ref.BinIterator(i);
+    Stomp::ThetaIterator iter_merged = wtheta_merged.BinIterator(i);
+    for (int16_t k=-1;k<n_region;k++) {
+      if ((fabs(iter_merged->GalGal(k) - iter_ref->GalGal(k)) >
+	   1.0e-10*iter_ref->GalGal(k)) ||
+	  (fabs(iter_merged->GalRand(k) - iter_ref->GalRand(k)) >
+	   1.0e-10*iter_ref->GalRand(k)) ||
+	  (fabs(iter_merged->RandRand(k) - iter_ref->RandRand(k)) >
+	   1.0e-10*iter_ref->RandRand(k)) ||
+	  (fabs(iter_merged->Wtheta(k) - iter_ref->Wtheta(k)) >
+	   1.0e-10*fabs(iter_ref->Wtheta(k)) + 1.0e-12)) n_mismatch++;
+    }
+  }
+  std::cout << "\t" << galaxy_query.Size() << "/" << galaxy.Size() <<
+    " galaxies in work units; " << n_mismatch << " mismatches in " <<
+    wtheta_ref.NBins() << " bins, " << n_region << " regions\n";
+
+  std::remove((prefix + ".job").c_str());
+  std::remove((prefix + ".units").c_str());
+  std::remove((prefix + ".regions").c_str());
+  for (uint32_t i=0;i<n_work_units;i++) {
+    std::ostringstream unit_prefix;
+    unit_prefix << prefix << "." << i << ".";
+    std::remove((unit_prefix.str() + "galaxy_query").c_str());
+    std::remove((unit_prefix.str() + "galaxy_tree").c_str());
+    std::remove((unit_prefix.str() + "out").c_str());
+    for (uint8_t rand_iter=0;rand_iter<random_iterations;rand_iter++) {
+      std::ostringstream suffix;
+      suffix << static_cast<int>(rand_iter);
+      std::remove((unit_prefix.str() + "random_query." +
+		   suffix.str()).c_str());
+      std::remove((unit_prefix.str() + "random_tree." +
+		   suffix.str()).c_str());
+    }
+  }
+}
+
+void AngularCorrelationAutoTuneTests() {
+  // Auto-tune a small auto-correlation and check that the choice it makes is
+  // a consistent one and that the tuned tree gives the same pair counts.
+  std::cout << "\n";
+  std::cout << "******************************************\n";
+  std::cout << "*** AngularCorrelation Auto-Tune Tests ***\n";
+  std::cout << "******************************************\n";
+  Stomp::AngularCoordinate ang(20.0, 0.0, Stomp::AngularCoordinate::Survey);
+  Stomp::Pixel tmp_pix(ang, 256);
+  Stomp::PixelVector circle_pix;
+  tmp_pix.WithinRadius(1.0, circle_pix);
+  Stomp::Map stomp_map(circle_pix);
+
+  Stomp::AngularVector galaxy_ang;
+  stomp_map.GenerateRandomPoints(galaxy_ang, 5000, false, 1);
+  Stomp::PointCatalog galaxy(galaxy_ang);
+
+  Stomp::AngularCorrelation wtheta(0.01, 0.5, 4.0);
+  wtheta.AutoTune(stomp_map, galaxy, 1, 200);
+
+  // The pair-based bins have to be the smallest ones, with the rest at no
+  // finer than the maximum resolution.
+  uint32_t n_pair = 0, n_bad = 0;
+  for (uint32_t i=0;i<wtheta.NBins();i++) {
+    Stomp::ThetaIterator iter = wtheta.BinIterator(i);
+    if (iter->Resolution() == 0) {
+      if (n_pair != i) n_bad++;
+      n_pair++;
+    } else {
+      if (iter->Resolution() > wtheta.MaxResolution()) n_bad++;
+    }
+  }
+  std::cout << "\t" << n_pair << "/" << wtheta.NBins() <<
+    " pair-based bins, max resolution " << wtheta.MaxResolution() <<
+    ", tree resolution " << wtheta.TreeResolution() << ", node capacity " <<
+    wtheta.TreeNodeCapacity() << "; predicted " <<
+    wtheta.PredictedSeconds() << " seconds\n";
+  if ((n_bad > 0) || (wtheta.PredictedSeconds() <= 0.0) ||
+      (wtheta.TreeResolution() < Stomp::HPixResolution))
+    std::cout << "\tFAILED: inconsistent tuning.\n";
+
+  std::string tuning_file = "AngularCorrelationTuning.dat";
+  if (!wtheta.WriteTuning(tuning_file))
+    std::cout << "\tFAILED: couldn't write tuning.\n";
+  std::remove(tuning_file.c_str());
+
+  // The tree parameters shouldn't change the galaxy-galaxy pair counts.
+  Stomp::AngularCorrelation wtheta_tuned(0.01, 0.5, 4.0);
+  wtheta_tuned.UseOnlyPairs();
+  wtheta_tuned.SetTreeParameters(wtheta.TreeResolution(),
+				 wtheta.TreeNodeCapacity());
+  wtheta_tuned.FindPairAutoCorrelation(stomp_map, galaxy, 1);
+
+  Stomp::AngularCorrelation wtheta_ref(0.01, 0.5, 4.0);
+  wtheta_ref.UseOnlyPairs();
+  wtheta_ref.FindPairAutoCorrelation(stomp_map, galaxy, 1);
+
+  uint32_t n_mismatch = 0;
+  for (uint32_t i=0;i<wtheta_ref.NBins();i++) {
+    if (wtheta_tuned.BinIterator(i)->GalGal() !=
+	wtheta_ref.BinIterator(i)->GalGal()) n_mismatch++;
+  }
+  std::cout << "\t" << n_mismatch << " mismatches in " << wtheta_ref.NBins() <<
+    " bins with the tuned tree\n";
+  if (n_mismatch > 0)
+    std::cout << "\tFAILED: tuned tree doesn't match the reference " <<
+      "pair counts.\n";
+}
+
 // Define our command line flags
 DEFINE_bool(all_angular_correlation_tests, false, "Run all class unit tests.");
 DEFINE_bool(angular_binning_tests, false,
             "Run AngularCorrelation binning tests");
+DEFINE_bool(angular_correlation_jackknife_tests, false,
+            "Run AngularCorrelation jack-knife tests");
+DEFINE_bool(angular_correlation_checkpoint_tests, false,
+            "Run AngularCorrelation checkpoint tests");
+DEFINE_bool(angular_correlation_work_unit_tests, false,
+            "Run AngularCorrelation work unit tests");
+DEFINE_bool(angular_correlation_auto_tune_tests, false,
+            "Run AngularCorrelation auto-tuning tests");
 
 void AngularCorrelationUnitTests(bool run_all_tests) {
   void AngularBinningTests();
+  void AngularCorrelationJackknifeTests();
+  void AngularCorrelationCheckpointTests();
+  void AngularCorrelationWorkUnitTests();
+  void AngularCorrelationAutoTuneTests();
 
   if (run_all_tests) FLAGS_all_angular_correlation_tests = true;
 
@@ -151,4 +577,24 @@ void AngularCorrelationUnitTests(bool run_all_tests) {
   // classes.
   if (FLAGS_all_angular_correlation_tests || FLAGS_angular_binning_tests)
     AngularBinningTests();
+
+  // Check the jack-knife region bookkeeping and the covariance matrix.
+  if (FLAGS_all_angular_correlation_tests ||
+      FLAGS_angular_correlation_jackknife_tests)
+    AngularCorrelationJackknifeTests();
+
+  // Check checkpointing and merging of correlation measurements.
+  if (FLAGS_all_angular_correlation_tests ||
+      FLAGS_angular_correlation_checkpoint_tests)
+    AngularCorrelationCheckpointTests();
+
+  // Check splitting pair counting into separate work units.
+  if (FLAGS_all_angular_correlation_tests ||
+      FLAGS_angular_correlation_work_unit_tests)
+    AngularCorrelationWorkUnitTests();
+
+  // Check the auto-tuning of the estimator break and tree parameters.
+  if (FLAGS_all_angular_correlation_tests ||
+      FLAGS_angular_correlation_auto_tune_tests)
+    AngularCorrelationAutoTuneTests();
 }
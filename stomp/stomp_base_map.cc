@@ -16,6 +16,8 @@
 // similarly-shaped regions.  This functionality is the basis for calculating
 // jack-knife errors for our various statistical analyses.
 
+#include <iomanip>
+#include <limits>
 #include "stomp_core.h"
 #include "stomp_geometry.h"
 #include "stomp_base_map.h"
@@ -614,26 +616,147 @@ void RegionMap::_VerifyRegionation(uint16_t n_region) {
 int16_t RegionMap::FindRegion(AngularCoordinate& ang) {
   Pixel tmp_pix(ang, region_resolution_, 1.0);
 
-  return (region_map_.find(tmp_pix.Pixnum()) != region_map_.end() ?
-	  region_map_[tmp_pix.Pixnum()] : -1);
+  // Stick to find() here (rather than operator[]) so that concurrent lookups
+  // never touch the map's structure.
+  RegionIterator iter = region_map_.find(tmp_pix.Pixnum());
+  return (iter != region_map_.end() ? iter->second : -1);
 }
 
 int16_t RegionMap::FindRegion(Pixel& pix) {
   if (pix.Resolution() >= region_resolution_) {
-    uint32_t pix_idx = pix.SuperPix(region_resolution_);
-    return (region_map_.find(pix_idx) != region_map_.end() ?
-	    region_map_[pix_idx] : -1);
+    RegionIterator iter = region_map_.find(pix.SuperPix(region_resolution_));
+    return (iter != region_map_.end() ? iter->second : -1);
   } else {
     return -1;
   }
 }
 
+#ifdef WITH_NUMPY  // begin python-only code
+PyObject* RegionMap::FindRegion(PyObject* x1obj, PyObject* x2obj,
+				const std::string& system, uint32_t n_threads)
+  throw (const char* ) {
+  AngularCoordinate::Sphere sys = AngularCoordinate::SystemFromString(system);
+
+  // No copy made as long as the type and byte order is correct.
+  NumpyVector<double> x1(x1obj);
+  NumpyVector<double> x2(x2obj);
+  if (x1.size() != x2.size()) {
+    throw "coordinates must be same size";
+  }
+
+  npy_intp n_point = x1.size();
+  NumpyVector<npy_int16> region(n_point);
+
+  Py_BEGIN_ALLOW_THREADS
+  const npy_intp block_size = 4096;
+  uint32_t n_block = (n_point + block_size - 1)/block_size;
+  ParallelFor(n_block, n_threads, [&](uint32_t block) {
+    npy_intp end = (block + 1)*block_size;
+    if (end > n_point) end = n_point;
+    AngularCoordinate ang;
+    for (npy_intp i=block*block_size;i<end;i++) {
+      ang.Set(x1.at(i), x2.at(i), sys);
+      region.at(i) = FindRegion(ang);
+    }
+  });
+  Py_END_ALLOW_THREADS
+
+  return region.getref();
+}
+#endif  // end python-only code
+
 void RegionMap::ClearRegions() {
   region_map_.clear();
   n_region_ = 0;
   region_resolution_ = 0;
 }
 
+bool RegionMap::Write(const std::string& output_file_name) {
+  std::ofstream output_file(output_file_name.c_str());
+  if (!output_file.is_open()) {
+    std::cout << "Stomp::RegionMap::Write - " <<
+      "Can't open " << output_file_name << "!\n";
+    return false;
+  }
+
+  output_file << std::setprecision(std::numeric_limits<double>::digits10 + 2);
+  output_file << "STOMP_REGIONS 1\n";
+  output_file << region_resolution_ << " " << n_region_ << " " <<
+    region_area_.size() << " " << region_map_.size() << "\n";
+  for (RegionAreaIterator iter=region_area_.begin();
+       iter!=region_area_.end();++iter)
+    output_file << iter->first << " " << iter->second << "\n";
+  for (RegionIterator iter=region_map_.begin();
+       iter!=region_map_.end();++iter)
+    output_file << iter->first << " " << iter->second << "\n";
+  output_file.close();
+
+  if (output_file.fail()) {
+    std::cout << "Stomp::RegionMap::Write - " <<
+      "Failed to write " << output_file_name << "!\n";
+    return false;
+  }
+
+  return true;
+}
+
+bool RegionMap::Read(const std::string& input_file_name) {
+  ClearRegions();
+  region_area_.clear();
+
+  std::ifstream input_file(input_file_name.c_str());
+  if (!input_file) {
+    std::cout << "Stomp::RegionMap::Read - " <<
+      input_file_name << " does not exist!\n";
+    return false;
+  }
+
+  std::string tag;
+  int version;
+  uint32_t region_resolution, n_area, n_pixel;
+  uint16_t n_region;
+  if (!(input_file >> tag >> version) || (tag != "STOMP_REGIONS") ||
+      (version != 1) ||
+      !(input_file >> region_resolution >> n_region >> n_area >> n_pixel)) {
+    std::cout << "Stomp::RegionMap::Read - " <<
+      "Bad header in " << input_file_name << "\n";
+    return false;
+  }
+
+  bool read_regions = true;
+  for (uint32_t i=0;read_regions && (i<n_area);i++) {
+    int16_t region;
+    double area;
+    if (input_file >> region >> area) {
+      region_area_[region] = area;
+    } else {
+      read_regions = false;
+    }
+  }
+  for (uint32_t i=0;read_regions && (i<n_pixel);i++) {
+    uint32_t pixnum;
+    int16_t region;
+    if (input_file >> pixnum >> region) {
+      region_map_[pixnum] = region;
+    } else {
+      read_regions = false;
+    }
+  }
+
+  if (!read_regions) {
+    std::cout << "Stomp::RegionMap::Read - " <<
+      "Failed to read " << input_file_name << "\n";
+    ClearRegions();
+    region_area_.clear();
+    return false;
+  }
+
+  region_resolution_ = region_resolution;
+  n_region_ = n_region;
+
+  return true;
+}
+
 int16_t RegionMap::Region(uint32_t region_idx) {
   return (region_map_.find(region_idx) != region_map_.end() ?
 	  region_map_[region_idx] : -1);
@@ -752,10 +875,26 @@ int16_t BaseMap::FindRegion(Pixel& pix) {
   return region_map_.FindRegion(pix);
 }
 
+#ifdef WITH_NUMPY  // begin python-only code
+PyObject* BaseMap::FindRegion(PyObject* x1obj, PyObject* x2obj,
+			      const std::string& system, uint32_t n_threads)
+  throw (const char* ) {
+  return region_map_.FindRegion(x1obj, x2obj, system, n_threads);
+}
+#endif  // end python-only code
+
 void BaseMap::ClearRegions() {
   region_map_.ClearRegions();
 }
 
+bool BaseMap::WriteRegions(const std::string& output_file_name) {
+  return region_map_.Write(output_file_name);
+}
+
+bool BaseMap::ReadRegions(const std::string& input_file_name) {
+  return region_map_.Read(input_file_name);
+}
+
 void BaseMap::RegionArea(int16_t region, PixelVector& pix) {
   region_map_.RegionArea(region, pix);
 }
@@ -20,12 +20,22 @@
 #define STOMP_BASE_MAP_H
 
 #include <stdint.h>
+#include <string>
 #include <vector>
 #include <map>
 #include "stomp_core.h"
 #include "stomp_geometry.h"
 #include "stomp_pixel.h"
 
+// Python and numpy support for the array-based methods below
+#ifdef WITH_PYTHON
+#include <Python.h>
+#endif
+#ifdef WITH_NUMPY
+#include "numpy/arrayobject.h"
+#include "../python/NumpyVector.h"
+#endif
+
 namespace Stomp {
 
 class AngularCoordinate;  // class declaration in stomp_angular_coordinate.h
@@ -211,12 +221,31 @@ class RegionMap {
   // map will also return -1 even if they are within the BaseMap).
   int16_t FindRegion(Pixel& pix);
 
+#ifdef WITH_NUMPY
+  // The numpy version takes arrays of coordinates in the given system and
+  // returns an int16 array of region indices.  The lookups are done with the
+  // GIL released, split over n_threads threads.
+  PyObject* FindRegion(PyObject* x1obj, PyObject* x2obj,
+		       const std::string& system,
+		       uint32_t n_threads = DefaultThreads())
+    throw (const char* );
+#endif
+
   // And finally, a method for removing the current sub-region setup so that
   // a new version can be imposed on the map.  This method is called before
   // InitializeRegions does anything, so two successive calls to
   // InitializeRegions won't cause problems.
   void ClearRegions();
 
+  // The regionation can be written to an ASCII file and read back in, so
+  // that separate processes working on pieces of the same measurement all
+  // use exactly the same regions.  The format is a header line with the
+  // resolution and number of regions, the area of each region and then the
+  // pixel index and region for each pixel in the region map.  Read replaces
+  // any existing regionation and returns false if the file can't be read.
+  bool Write(const std::string& output_file_name);
+  bool Read(const std::string& input_file_name);
+
   // Given a pixel index (the Pixnum method in Pixel), return the corresponding
   // region value.
   int16_t Region(uint32_t region_idx);
@@ -293,7 +322,15 @@ class BaseMap {
   bool InitializeRegions(BaseMap& base_map);
   int16_t FindRegion(AngularCoordinate& ang);
   int16_t FindRegion(Pixel& pix);
+#ifdef WITH_NUMPY
+  PyObject* FindRegion(PyObject* x1obj, PyObject* x2obj,
+		       const std::string& system,
+		       uint32_t n_threads = DefaultThreads())
+    throw (const char* );
+#endif
   void ClearRegions();
+  bool WriteRegions(const std::string& output_file_name);
+  bool ReadRegions(const std::string& input_file_name);
   void RegionArea(int16_t region, PixelVector& pix);
   int16_t Region(uint32_t region_idx);
   double RegionArea(int16_t region);
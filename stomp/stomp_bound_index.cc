@@ -0,0 +1,322 @@
+// Copyright 2010  All Rights Reserved.
+// Author: ryan.scranton@gmail.com (Ryan Scranton)
+
+// STOMP is a set of libraries for doing astrostatistical analysis on the
+// celestial sphere.  The goal is to enable descriptions of arbitrary regions
+// on the sky which may or may not encode futher spatial information (galaxy
+// density, CMB temperature, observational depth, etc.) and to do so in such
+// a way as to make the analysis of that data as algorithmically efficient as
+// possible.
+//
+// This file contains the implementation of the BoundIndex class.  See
+// stomp_bound_index.h for the details.
+
+#include <stdint.h>
+#include <math.h>
+#include <algorithm>
+#include <utility>
+#include "stomp_core.h"
+#include "stomp_angular_coordinate.h"
+#include "stomp_pixel.h"
+#include "stomp_geometry.h"
+#include "stomp_point_catalog.h"
+#include "stomp_bound_index.h"
+
+namespace Stomp {
+
+typedef std::pair<uint64_t, uint32_t> IndexEntry;
+typedef std::vector<IndexEntry> IndexEntryVector;
+
+BoundIndex::BoundIndex() {
+  max_resolution_ = MaxPixelResolution;
+  built_ = false;
+}
+
+BoundIndex::~BoundIndex() {
+  Clear();
+}
+
+uint32_t BoundIndex::AddBound(GeometricBound* bound) {
+  bounds_.push_back(bound);
+  built_ = false;
+  return bounds_.size() - 1;
+}
+
+void BoundIndex::AddBounds(std::vector<GeometricBound*>& bounds) {
+  bounds_.reserve(bounds_.size() + bounds.size());
+  for (uint32_t i=0;i<bounds.size();i++) bounds_.push_back(bounds[i]);
+  built_ = false;
+}
+
+bool BoundIndex::Build(uint32_t max_resolution, uint32_t n_threads) {
+  levels_.clear();
+  unindexed_.clear();
+  max_resolution_ = max_resolution;
+  built_ = false;
+
+  if (bounds_.empty()) {
+    std::cout << "Stomp::BoundIndex::Build - No bounds to index.\n";
+    return false;
+  }
+
+  uint8_t max_level = MostSignificantBit(max_resolution);
+  if (max_level > MaxPixelLevel) max_level = MaxPixelLevel;
+  if (max_level < HPixLevel) max_level = HPixLevel;
+
+  // Work out where each bound goes in parallel, keeping separate lists of
+  // entries for each block of bounds and each resolution level.  The caps
+  // are padded slightly to make sure that points right on the edge of a
+  // bound (which CheckPoint accepts to within a small tolerance) still find
+  // it.
+  const uint32_t block_size = 256;
+  const uint32_t n_level = MaxPixelLevel + 1;
+  uint32_t n_bound = bounds_.size();
+  uint32_t n_block = (n_bound + block_size - 1)/block_size;
+  std::vector<IndexEntryVector> block_entries(n_block*n_level);
+  std::vector<std::vector<uint32_t> > block_unindexed(n_block);
+  ParallelFor(n_block, n_threads, [&](uint32_t block) {
+    uint32_t end = (block + 1)*block_size;
+    if (end > n_bound) end = n_bound;
+    Pixel pix;
+    PixelVector cover_pix;
+    for (uint32_t i=block*block_size;i<end;i++) {
+      AngularCoordinate center;
+      double radius;
+      if (!bounds_[i]->BoundingCap(center, radius) ||
+	  DoubleGE(radius, 90.0)) {
+	block_unindexed[block].push_back(i);
+	continue;
+      }
+      radius += 1.0e-6;
+
+      uint8_t level = HPixLevel;
+      while ((level < max_level) &&
+	     (sqrt(Pixel::PixelArea(Pixel::LevelToResolution(level + 1))) >=
+	      radius)) level++;
+
+      uint32_t resolution = Pixel::LevelToResolution(level);
+      uint64_t nx = Nx0*resolution;
+      pix.SetResolution(resolution);
+      pix.BoundingRadius(center, radius, cover_pix);
+      IndexEntryVector& entries = block_entries[block*n_level + level];
+      for (PixelIterator iter=cover_pix.begin();
+	   iter!=cover_pix.end();++iter)
+	entries.push_back(IndexEntry(iter->PixelY()*nx + iter->PixelX(), i));
+    }
+  });
+
+  for (uint32_t block=0;block<n_block;block++)
+    unindexed_.insert(unindexed_.end(), block_unindexed[block].begin(),
+		      block_unindexed[block].end());
+
+  // Now gather up the entries for each level and sort them by pixel.
+  std::vector<IndexLevel> levels(n_level);
+  ParallelFor(n_level, n_threads, [&](uint32_t level) {
+    uint32_t n_entries = 0;
+    for (uint32_t block=0;block<n_block;block++)
+      n_entries += block_entries[block*n_level + level].size();
+    if (n_entries == 0) return;
+
+    IndexEntryVector entries;
+    entries.reserve(n_entries);
+    for (uint32_t block=0;block<n_block;block++) {
+      IndexEntryVector& block_level = block_entries[block*n_level + level];
+      entries.insert(entries.end(), block_level.begin(), block_level.end());
+      IndexEntryVector().swap(block_level);
+    }
+    std::sort(entries.begin(), entries.end());
+
+    levels[level].resolution = Pixel::LevelToResolution(level);
+    levels[level].key.reserve(n_entries);
+    levels[level].bound_id.reserve(n_entries);
+    for (IndexEntryVector::iterator iter=entries.begin();
+	 iter!=entries.end();++iter) {
+      levels[level].key.push_back(iter->first);
+      levels[level].bound_id.push_back(iter->second);
+    }
+  });
+
+  for (uint32_t level=0;level<n_level;level++)
+    if (!levels[level].key.empty()) levels_.push_back(levels[level]);
+
+  built_ = true;
+
+  return true;
+}
+
+template<typename Function>
+void BoundIndex::_VisitBounds(AngularCoordinate& ang, Function visit) {
+  for (std::vector<uint32_t>::iterator iter=unindexed_.begin();
+       iter!=unindexed_.end();++iter)
+    if (bounds_[*iter]->CheckPoint(ang) && !visit(*iter)) return;
+
+  if (levels_.empty()) return;
+
+  // The same pixel index calculation as Pixel::SetPixnumFromAng, but with
+  // the trigonometry done once for all of the levels.
+  double eta = (ang.Eta() - EtaOffSet)*DegToRad;
+  if (eta <= 0.0) eta += 2.0*Pi;
+  eta /= 2.0*Pi;
+
+  double lambda = (90.0 - ang.Lambda())*DegToRad;
+  bool south_pole = (lambda >= Pi);
+  double y_fraction = south_pole ? 1.0 : (1.0 - cos(lambda))/2.0;
+
+  for (std::vector<IndexLevel>::iterator level=levels_.begin();
+       level!=levels_.end();++level) {
+    uint32_t nx = Nx0*level->resolution;
+    uint32_t ny = Ny0*level->resolution;
+    uint32_t x = static_cast<uint32_t>(nx*eta);
+    if (x >= nx) x = nx - 1;
+    uint32_t y = south_pole ? ny - 1 : static_cast<uint32_t>(ny*y_fraction);
+    uint64_t key = static_cast<uint64_t>(y)*nx + x;
+
+    std::vector<uint64_t>::iterator first =
+      std::lower_bound(level->key.begin(), level->key.end(), key);
+    for (std::vector<uint64_t>::iterator iter=first;
+	 (iter!=level->key.end()) && (*iter == key);++iter) {
+      uint32_t bound_id = level->bound_id[iter - level->key.begin()];
+      if (bounds_[bound_id]->CheckPoint(ang) && !visit(bound_id)) return;
+    }
+  }
+}
+
+bool BoundIndex::_CheckBuilt() {
+  if (built_) return true;
+  if (bounds_.empty()) return false;
+
+  std::cout << "Stomp::BoundIndex::_CheckBuilt - Bounds added since the " <<
+    "last Build; rebuilding the index.\n";
+  return Build(max_resolution_);
+}
+
+bool BoundIndex::Contains(AngularCoordinate& ang) {
+  if (!_CheckBuilt()) return false;
+
+  bool inside = false;
+  _VisitBounds(ang, [&](uint32_t bound_id) {
+    inside = true;
+    return false;
+  });
+
+  return inside;
+}
+
+void BoundIndex::FindBounds(AngularCoordinate& ang,
+			    std::vector<uint32_t>& bound_ids) {
+  bound_ids.clear();
+  if (!_CheckBuilt()) return;
+
+  _VisitBounds(ang, [&](uint32_t bound_id) {
+    bound_ids.push_back(bound_id);
+    return true;
+  });
+  std::sort(bound_ids.begin(), bound_ids.end());
+}
+
+uint32_t BoundIndex::Contains(PointCatalog& catalog,
+			      std::vector<uint8_t>& inside,
+			      uint32_t n_threads) {
+  uint32_t n_point = catalog.Size();
+  inside.assign(n_point, 0);
+  if (!_CheckBuilt()) return 0;
+
+  double* x = catalog.XColumn();
+  double* y = catalog.YColumn();
+  double* z = catalog.ZColumn();
+  const uint32_t block_size = 4096;
+  uint32_t n_block = (n_point + block_size - 1)/block_size;
+  std::vector<uint32_t> n_inside(n_block, 0);
+  ParallelFor(n_block, n_threads, [&](uint32_t block) {
+    uint32_t end = (block + 1)*block_size;
+    if (end > n_point) end = n_point;
+    AngularCoordinate ang;
+    for (uint32_t i=block*block_size;i<end;i++) {
+      ang.SetUnitSphereCoordinates(x[i], y[i], z[i]);
+      if (Contains(ang)) {
+	inside[i] = 1;
+	n_inside[block]++;
+      }
+    }
+  });
+
+  uint32_t n_total = 0;
+  for (uint32_t block=0;block<n_block;block++) n_total += n_inside[block];
+
+  return n_total;
+}
+
+uint32_t BoundIndex::FindBounds(PointCatalog& catalog,
+				std::vector<uint32_t>& match_start,
+				std::vector<uint32_t>& bound_ids,
+				uint32_t n_threads) {
+  uint32_t n_point = catalog.Size();
+  match_start.assign(n_point + 1, 0);
+  bound_ids.clear();
+  if (!_CheckBuilt()) return 0;
+
+  // Each block collects the number of matches for each of its points and the
+  // matching IDs, which we then stitch together in order.
+  double* x = catalog.XColumn();
+  double* y = catalog.YColumn();
+  double* z = catalog.ZColumn();
+  const uint32_t block_size = 4096;
+  uint32_t n_block = (n_point + block_size - 1)/block_size;
+  std::vector<std::vector<uint32_t> > block_ids(n_block);
+  ParallelFor(n_block, n_threads, [&](uint32_t block) {
+    uint32_t end = (block + 1)*block_size;
+    if (end > n_point) end = n_point;
+    AngularCoordinate ang;
+    std::vector<uint32_t> point_ids;
+    for (uint32_t i=block*block_size;i<end;i++) {
+      ang.SetUnitSphereCoordinates(x[i], y[i], z[i]);
+      FindBounds(ang, point_ids);
+      match_start[i + 1] = point_ids.size();
+      block_ids[block].insert(block_ids[block].end(), point_ids.begin(),
+			      point_ids.end());
+    }
+  });
+
+  for (uint32_t i=0;i<n_point;i++) match_start[i + 1] += match_start[i];
+
+  bound_ids.reserve(match_start[n_point]);
+  for (uint32_t block=0;block<n_block;block++) {
+    bound_ids.insert(bound_ids.end(), block_ids[block].begin(),
+		     block_ids[block].end());
+    std::vector<uint32_t>().swap(block_ids[block]);
+  }
+
+  return bound_ids.size();
+}
+
+uint32_t BoundIndex::NBounds() {
+  return bounds_.size();
+}
+
+uint32_t BoundIndex::NEntries() {
+  uint32_t n_entries = 0;
+  for (std::vector<IndexLevel>::iterator level=levels_.begin();
+       level!=levels_.end();++level) n_entries += level->key.size();
+  return n_entries;
+}
+
+uint8_t BoundIndex::NLevels() {
+  return levels_.size();
+}
+
+uint32_t BoundIndex::NUnindexed() {
+  return unindexed_.size();
+}
+
+bool BoundIndex::Built() {
+  return built_;
+}
+
+void BoundIndex::Clear() {
+  bounds_.clear();
+  levels_.clear();
+  unindexed_.clear();
+  built_ = false;
+}
+
+} // end namespace Stomp
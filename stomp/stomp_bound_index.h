@@ -0,0 +1,132 @@
+// Copyright 2010  All Rights Reserved.
+// Author: ryan.scranton@gmail.com (Ryan Scranton)
+
+// STOMP is a set of libraries for doing astrostatistical analysis on the
+// celestial sphere.  The goal is to enable descriptions of arbitrary regions
+// on the sky which may or may not encode futher spatial information (galaxy
+// density, CMB temperature, observational depth, etc.) and to do so in such
+// a way as to make the analysis of that data as algorithmically efficient as
+// possible.
+//
+// This header file contains the BoundIndex class, a spatial index over a
+// large collection of GeometricBounds.  Vetoing a catalog against a bright
+// star mask with hundreds of thousands of circles is too slow if every point
+// is checked against every bound and too expensive in memory if the bounds
+// are pixelized finely enough to resolve the smallest of the circles.  The
+// BoundIndex instead files each bound under the handful of pixels that its
+// bounding cap touches and only checks a point against the bounds filed
+// under the pixels containing it.  The bounds themselves are never
+// pixelized, so the answers are exactly those of CheckPoint.
+
+#ifndef STOMP_BOUND_INDEX_H
+#define STOMP_BOUND_INDEX_H
+
+#include <stdint.h>
+#include <vector>
+#include "stomp_core.h"
+#include "stomp_angular_coordinate.h"
+
+namespace Stomp {
+
+class GeometricBound;  // class definition in stomp_geometry.h
+class PointCatalog;    // class definition in stomp_point_catalog.h
+class BoundIndex;
+
+class BoundIndex {
+  // The basic pattern is
+  //
+  //   BoundIndex index;
+  //   for (...) index.AddBound(&star_circles[i]);
+  //   index.Build();
+  //   std::vector<uint8_t> masked;
+  //   index.Contains(catalog, masked);
+  //
+  // Each bound is given an ID when it's added (0, 1, 2, ... in the order
+  // that they were added), which is what the FindBounds methods return.  The
+  // index doesn't copy the bounds, so they need to stay in scope for as long
+  // as the index is in use.
+  //
+  // The index resolution adapts to the bounds: each bound is filed at the
+  // finest resolution where its bounding cap (see
+  // GeometricBound::BoundingCap) is no larger than a pixel, so that it only
+  // lands in a few pixels, and a query checks each of the resolutions in
+  // use.  Bounds without a bounding cap (LatLonBound and the like) are
+  // checked against every point.
+
+ public:
+  BoundIndex();
+  ~BoundIndex();
+
+  // Add bounds to the index.  Adding bounds after calling Build means that
+  // the index needs to be built again.  If Build isn't called, the next query
+  // rebuilds the index with the previous max_resolution, but that rebuild
+  // isn't thread-safe, so call Build explicitly before querying from several
+  // threads at once.
+  uint32_t AddBound(GeometricBound* bound);
+  void AddBounds(std::vector<GeometricBound*>& bounds);
+
+  // Sort the bounds into pixels, using up to n_threads threads.  Bounds are
+  // filed at resolutions no finer than max_resolution.  Returns false if
+  // there are no bounds in the index.
+  bool Build(uint32_t max_resolution = MaxPixelResolution,
+	     uint32_t n_threads = DefaultThreads());
+
+  // Is the point inside any of the bounds?
+  bool Contains(AngularCoordinate& ang);
+
+  // The IDs of all of the bounds containing the point, in increasing order.
+  void FindBounds(AngularCoordinate& ang, std::vector<uint32_t>& bound_ids);
+
+  // The PointCatalog versions check every point in the catalog on up to
+  // n_threads threads.  Contains sets inside[i] to 1 for every point inside
+  // at least one bound (so that the result can go straight to
+  // PointCatalog::Select to keep the masked points; invert it to veto them)
+  // and returns the number of such points.  FindBounds returns the IDs of
+  // the bounds containing each point in a compact form: the matches for
+  // point i are bound_ids[match_start[i]] through
+  // bound_ids[match_start[i+1]-1].  The return value is the total number of
+  // matches.
+  uint32_t Contains(PointCatalog& catalog, std::vector<uint8_t>& inside,
+		    uint32_t n_threads = DefaultThreads());
+  uint32_t FindBounds(PointCatalog& catalog,
+		      std::vector<uint32_t>& match_start,
+		      std::vector<uint32_t>& bound_ids,
+		      uint32_t n_threads = DefaultThreads());
+
+  // Some details about the index.  NEntries is the total number of
+  // (pixel, bound) pairs, NLevels the number of resolutions in use.
+  uint32_t NBounds();
+  uint32_t NEntries();
+  uint8_t NLevels();
+  uint32_t NUnindexed();
+  bool Built();
+  void Clear();
+
+ private:
+  // The bounds filed at a single resolution, sorted by pixel.  The pixel key
+  // is y*nx + x.
+  struct IndexLevel {
+    uint32_t resolution;
+    std::vector<uint64_t> key;
+    std::vector<uint32_t> bound_id;
+  };
+
+  // Call visit(bound_id) for each bound containing the point, stopping early
+  // if visit returns false.
+  template<typename Function> void _VisitBounds(AngularCoordinate& ang,
+						Function visit);
+
+  // Rebuild the index if bounds have been added since the last Build.
+  // Returns false if there's nothing to query.
+  bool _CheckBuilt();
+
+  std::vector<GeometricBound*> bounds_;
+  std::vector<IndexLevel> levels_;
+  std::vector<uint32_t> unindexed_;
+  uint32_t max_resolution_;
+  bool built_;
+};
+
+} // end namespace Stomp
+
+#endif
@@ -0,0 +1,135 @@
+#include <stdint.h>
+#include <iostream>
+#include <math.h>
+#include <string>
+#include <vector>
+#include <gflags/gflags.h>
+#include "stomp_core.h"
+#include "stomp_angular_coordinate.h"
+#include "stomp_geometry.h"
+#include "stomp_point_catalog.h"
+#include "stomp_bound_index.h"
+
+void BoundIndexTests() {
+  // Build an index over a mix of bounds and check it against checking every
+  // point against every bound.
+  std::cout << "\n";
+  std::cout << "************************\n";
+  std::cout << "*** BoundIndex Tests ***\n";
+  std::cout << "************************\n";
+  Stomp::AngularCoordinate center(20.0, 0.0, Stomp::AngularCoordinate::Survey);
+  Stomp::CircleBound region(center, 10.0);
+
+  // Lots of small circles of different sizes, like a bright star mask.
+  uint32_t n_circle = 2000;
+  Stomp::AngularVector circle_centers;
+  region.GenerateRandomPoints(circle_centers, n_circle);
+  std::vector<Stomp::GeometricBound*> bounds;
+  for (uint32_t i=0;i<n_circle;i++)
+    bounds.push_back(new Stomp::CircleBound(circle_centers[i],
+					    0.01 + 0.5*(i % 50)/50.0));
+
+  // A few polygons, wedges and annuli of a couple of degrees.
+  for (uint32_t i=0;i<10;i++) {
+    double lambda = 12.0 + 1.6*i;
+    double eta = -6.0 + 1.2*i;
+    Stomp::AngularVector vertices;
+    vertices.push_back(Stomp::AngularCoordinate(lambda + 1.0, eta,
+						Stomp::AngularCoordinate::Survey));
+    vertices.push_back(Stomp::AngularCoordinate(lambda, eta + 1.0,
+						Stomp::AngularCoordinate::Survey));
+    vertices.push_back(Stomp::AngularCoordinate(lambda - 1.0, eta,
+						Stomp::AngularCoordinate::Survey));
+    vertices.push_back(Stomp::AngularCoordinate(lambda, eta - 1.0,
+						Stomp::AngularCoordinate::Survey));
+    bounds.push_back(new Stomp::PolygonBound(vertices));
+
+    Stomp::AngularCoordinate wedge_center(lambda, -eta,
+					  Stomp::AngularCoordinate::Survey);
+    bounds.push_back(new Stomp::WedgeBound(wedge_center, 1.5, 20.0*i,
+					   20.0*i + 90.0));
+    bounds.push_back(new Stomp::AnnulusBound(wedge_center, 0.5, 2.0));
+  }
+
+  // And one bound without a bounding cap.
+  bounds.push_back(new Stomp::LatLonBound(-1.0, 1.0, -10.0, 10.0,
+					  Stomp::AngularCoordinate::Survey));
+
+  Stomp::BoundIndex index;
+  index.AddBounds(bounds);
+  if (!index.Build()) std::cout << "\tFAILED to build the index.\n";
+  std::cout << "\t" << index.NBounds() << " bounds: " << index.NEntries() <<
+    " entries on " << static_cast<int>(index.NLevels()) << " levels, " <<
+    index.NUnindexed() << " unindexed\n";
+
+  uint32_t n_random = 20000;
+  Stomp::AngularVector rand_ang;
+  region.GenerateRandomPoints(rand_ang, n_random);
+  Stomp::PointCatalog catalog(rand_ang);
+
+  std::vector<uint8_t> inside;
+  std::vector<uint32_t> match_start, match_ids;
+  uint32_t n_inside = index.Contains(catalog, inside);
+  uint32_t n_match = index.FindBounds(catalog, match_start, match_ids);
+
+  uint32_t n_check_inside = 0, n_check_match = 0;
+  uint32_t n_contains_mismatch = 0, n_find_mismatch = 0;
+  uint32_t n_catalog_mismatch = 0;
+  std::vector<uint32_t> check_ids, bound_ids;
+  for (uint32_t i=0;i<rand_ang.size();i++) {
+    check_ids.clear();
+    for (uint32_t k=0;k<bounds.size();k++)
+      if (bounds[k]->CheckPoint(rand_ang[i])) check_ids.push_back(k);
+    if (!check_ids.empty()) n_check_inside++;
+    n_check_match += check_ids.size();
+
+    if (index.Contains(rand_ang[i]) != !check_ids.empty())
+      n_contains_mismatch++;
+    index.FindBounds(rand_ang[i], bound_ids);
+    if (bound_ids != check_ids) n_find_mismatch++;
+
+    std::vector<uint32_t> catalog_ids(match_ids.begin() + match_start[i],
+				      match_ids.begin() + match_start[i + 1]);
+    if ((catalog_ids != check_ids) ||
+	((inside[i] == 1) != !check_ids.empty())) n_catalog_mismatch++;
+  }
+
+  std::cout << "\tContains: " << n_inside << " (" << n_check_inside <<
+    ") points inside, " << n_contains_mismatch << " mismatched\n";
+  std::cout << "\tFindBounds: " << n_match << " (" << n_check_match <<
+    ") matches, " << n_find_mismatch << " mismatched\n";
+  std::cout << "\tPointCatalog queries: " << n_catalog_mismatch <<
+    " mismatched\n";
+
+  // A bound added after Build should still be found, with the index
+  // rebuilt on the next query.
+  Stomp::AngularCoordinate new_center(20.0, 40.0,
+				      Stomp::AngularCoordinate::Survey);
+  bounds.push_back(new Stomp::CircleBound(new_center, 0.1));
+  uint32_t new_id = index.AddBound(bounds.back());
+  bool found_new_bound = index.Contains(new_center);
+  index.FindBounds(new_center, bound_ids);
+  std::cout << "\tBound added after Build: " <<
+    (found_new_bound ? "found" : "missed") << ", " << bound_ids.size() <<
+    " (1) matches, index " << (index.Built() ? "rebuilt" : "not rebuilt") <<
+    "\n";
+  if (!found_new_bound || !index.Built() || (bound_ids.size() != 1) ||
+      (bound_ids[0] != new_id))
+    std::cout << "\tFAILED: bound added after Build wasn't found.\n";
+
+  for (uint32_t k=0;k<bounds.size();k++) delete bounds[k];
+}
+
+// Define our command line flags
+DEFINE_bool(all_bound_index_tests, false, "Run all class unit tests.");
+DEFINE_bool(bound_index_basic_tests, false, "Run BoundIndex basic tests");
+
+void BoundIndexUnitTests(bool run_all_tests) {
+  void BoundIndexTests();
+
+  if (run_all_tests) FLAGS_all_bound_index_tests = true;
+
+  // Check the Stomp::BoundIndex queries against brute force.
+  if (FLAGS_all_bound_index_tests || FLAGS_bound_index_basic_tests)
+    BoundIndexTests();
+}
@@ -0,0 +1,987 @@
+// Copyright 2010  All Rights Reserved.
+// Author: ryan.scranton@gmail.com (Ryan Scranton)
+
+// STOMP is a set of libraries for doing astrostatistical analysis on the
+// celestial sphere.  The goal is to enable descriptions of arbitrary regions
+// on the sky which may or may not encode futher spatial information (galaxy
+// density, CMB temperature, observational depth, etc.) and to do so in such
+// a way as to make the analysis of that data as algorithmically efficient as
+// possible.
+//
+// This file contains the memory-mapped binary and FITS catalog readers.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <iostream>
+#include <sstream>
+#include <limits>
+#include <map>
+#include "stomp_core.h"
+#include "stomp_catalog_reader.h"
+#include "stomp_instrumentation.h"
+
+namespace Stomp {
+
+// Each thread decodes this many rows at a time.
+static const uint32_t DecodeBlockRows = 65536;
+
+// Load a value of type R from (possibly unaligned) memory, reversing the
+// byte order if necessary.
+template<class R> static inline R LoadValue(const uint8_t* ptr,
+					     bool swap_bytes) {
+  uint8_t bytes[sizeof(R)];
+  if (swap_bytes) {
+    for (uint32_t k=0;k<sizeof(R);k++) bytes[k] = ptr[sizeof(R) - 1 - k];
+  } else {
+    memcpy(bytes, ptr, sizeof(R));
+  }
+  R value;
+  memcpy(&value, bytes, sizeof(R));
+  return value;
+}
+
+template<class R, class T> static void DecodeValues(const uint8_t* ptr,
+						     uint64_t stride,
+						     bool swap_bytes,
+						     double scale, double zero,
+						     uint32_t n_values,
+						     T* values) {
+  if ((scale == 1.0) && (zero == 0.0)) {
+    for (uint32_t i=0;i<n_values;i++,ptr+=stride)
+      values[i] = static_cast<T>(LoadValue<R>(ptr, swap_bytes));
+  } else {
+    for (uint32_t i=0;i<n_values;i++,ptr+=stride)
+      values[i] = static_cast<T>(scale*LoadValue<R>(ptr, swap_bytes) + zero);
+  }
+}
+
+CatalogReader::CatalogReader() {
+  n_rows_ = 0;
+  data_ = NULL;
+  file_size_ = 0;
+  current_row_ = 0;
+  _ClearSelection();
+}
+
+CatalogReader::~CatalogReader() {
+  Close();
+}
+
+void CatalogReader::Close() {
+  if (data_ != NULL)
+    munmap(const_cast<uint8_t*>(data_), file_size_);
+  data_ = NULL;
+  file_size_ = 0;
+  n_rows_ = 0;
+  current_row_ = 0;
+  column_.clear();
+  input_file_.clear();
+  _ClearSelection();
+}
+
+bool CatalogReader::IsOpen() {
+  return (data_ != NULL);
+}
+
+uint64_t CatalogReader::NRows() {
+  return n_rows_;
+}
+
+uint16_t CatalogReader::NColumns() {
+  return column_.size();
+}
+
+void CatalogReader::ColumnNames(std::vector<std::string>& column_names) {
+  if (!column_names.empty()) column_names.clear();
+  for (uint32_t i=0;i<column_.size();i++)
+    column_names.push_back(column_[i].name);
+}
+
+CatalogReader::ColumnType CatalogReader::FindColumnType(
+  const std::string& column_name) {
+  int32_t column_idx = ColumnIndex(column_name);
+  return (column_idx == -1 ? UnknownColumn : column_[column_idx].type);
+}
+
+int32_t CatalogReader::ColumnIndex(const std::string& column_name) {
+  for (uint32_t i=0;i<column_.size();i++)
+    if (column_[i].name == column_name) return static_cast<int32_t>(i);
+  return -1;
+}
+
+bool CatalogReader::SetCoordinateColumns(const std::string& theta_column,
+					 const std::string& phi_column,
+					 AngularCoordinate::Sphere sphere,
+					 bool radians) {
+  int32_t theta_idx, phi_idx;
+  if (!_CheckColumn(theta_column, theta_idx, "SetCoordinateColumns") ||
+      !_CheckColumn(phi_column, phi_idx, "SetCoordinateColumns"))
+    return false;
+
+  theta_idx_ = theta_idx;
+  phi_idx_ = phi_idx;
+  sphere_ = sphere;
+  radians_ = radians;
+  return true;
+}
+
+bool CatalogReader::SetWeightColumn(const std::string& weight_column) {
+  int32_t weight_idx;
+  if (!_CheckColumn(weight_column, weight_idx, "SetWeightColumn"))
+    return false;
+  weight_idx_ = weight_idx;
+  return true;
+}
+
+bool CatalogReader::SetRedshiftColumn(const std::string& redshift_column) {
+  int32_t redshift_idx;
+  if (!_CheckColumn(redshift_column, redshift_idx, "SetRedshiftColumn"))
+    return false;
+  redshift_idx_ = redshift_idx;
+  return true;
+}
+
+bool CatalogReader::SetFieldColumns(FieldColumnDict& field_columns) {
+  FieldColumnDict field_idx;
+  for (FieldColumnIterator iter=field_columns.begin();
+       iter!=field_columns.end();++iter) {
+    int32_t column_idx;
+    if (!_CheckColumn(iter->first, column_idx, "SetFieldColumns"))
+      return false;
+    if (column_idx > 255) {
+      std::cout << "Stomp::CatalogReader::SetFieldColumns - " <<
+	iter->first << " is past the last column a FieldColumnDict " <<
+	"can index.\n";
+      return false;
+    }
+    field_idx[iter->first] = static_cast<uint8_t>(column_idx);
+  }
+
+  field_idx_ = field_idx;
+  field_columns = field_idx;
+  return true;
+}
+
+uint32_t CatalogReader::ReadChunk(PointCatalog& catalog, uint32_t max_rows,
+				  uint32_t n_threads) {
+  catalog.Clear();
+  if ((theta_idx_ == -1) || (phi_idx_ == -1)) {
+    std::cout << "Stomp::CatalogReader::ReadChunk - " <<
+      "Coordinate columns have not been set.\n";
+    return 0;
+  }
+  if ((current_row_ >= n_rows_) || (max_rows == 0)) return 0;
+
+  uint32_t n_chunk = max_rows;
+  if (n_rows_ - current_row_ < n_chunk)
+    n_chunk = static_cast<uint32_t>(n_rows_ - current_row_);
+
+  if (!_ReadRows(catalog, current_row_, n_chunk, n_threads)) return 0;
+  current_row_ += n_chunk;
+
+  return n_chunk;
+}
+
+bool CatalogReader::Read(PointCatalog& catalog, uint32_t n_threads) {
+  STOMP_SCOPED_TIMER("CatalogReader::Read");
+  if ((theta_idx_ == -1) || (phi_idx_ == -1)) {
+    std::cout << "Stomp::CatalogReader::Read - " <<
+      "Coordinate columns have not been set.\n";
+    return false;
+  }
+
+  uint64_t n_remaining = n_rows_ - current_row_;
+  if (catalog.Size() + n_remaining > std::numeric_limits<uint32_t>::max()) {
+    std::cout << "Stomp::CatalogReader::Read - " << n_remaining <<
+      " rows won't fit in a single PointCatalog; use ReadChunk instead.\n";
+    return false;
+  }
+
+  catalog.Reserve(catalog.Size() + n_remaining);
+  while (current_row_ < n_rows_) {
+    uint32_t n_chunk = DefaultChunkRows;
+    if (n_rows_ - current_row_ < n_chunk)
+      n_chunk = static_cast<uint32_t>(n_rows_ - current_row_);
+    if (!_ReadRows(catalog, current_row_, n_chunk, n_threads)) return false;
+    current_row_ += n_chunk;
+  }
+
+  return true;
+}
+
+uint64_t CatalogReader::CurrentRow() {
+  return current_row_;
+}
+
+void CatalogReader::Rewind() {
+  current_row_ = 0;
+}
+
+void CatalogReader::SetCurrentRow(uint64_t row) {
+  current_row_ = (row > n_rows_ ? n_rows_ : row);
+}
+
+bool CatalogReader::ColumnValues(uint16_t column_idx, uint64_t start_row,
+				 uint32_t n_rows, double* values,
+				 uint32_t n_threads) {
+  if ((column_idx >= column_.size()) ||
+      (column_[column_idx].type == UnknownColumn) ||
+      (start_row + n_rows > n_rows_)) return false;
+  return _DecodeColumn(column_idx, start_row, n_rows, values, n_threads);
+}
+
+bool CatalogReader::_MapFile(const std::string& input_file) {
+  Close();
+
+  int fd = open(input_file.c_str(), O_RDONLY);
+  if (fd == -1) {
+    std::cout << "Stomp::CatalogReader::Open - " << input_file <<
+      " does not exist!\n";
+    return false;
+  }
+
+  struct stat file_stat;
+  if ((fstat(fd, &file_stat) == -1) || (file_stat.st_size == 0)) {
+    std::cout << "Stomp::CatalogReader::Open - " << input_file <<
+      " is empty or unreadable.\n";
+    close(fd);
+    return false;
+  }
+
+  void* data = mmap(NULL, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    std::cout << "Stomp::CatalogReader::Open - Failed to map " <<
+      input_file << " into memory.\n";
+    return false;
+  }
+
+  data_ = static_cast<const uint8_t*>(data);
+  file_size_ = file_stat.st_size;
+  input_file_ = input_file;
+
+  return true;
+}
+
+uint8_t CatalogReader::_ColumnSize(ColumnType column_type) {
+  switch (column_type) {
+  case Float64Column:
+  case Int64Column:
+    return 8;
+  case Float32Column:
+  case Int32Column:
+    return 4;
+  case Int16Column:
+    return 2;
+  case UInt8Column:
+    return 1;
+  default:
+    return 0;
+  }
+}
+
+bool CatalogReader::_HostIsBigEndian() {
+  uint32_t one = 1;
+  uint8_t first_byte;
+  memcpy(&first_byte, &one, 1);
+  return (first_byte == 0);
+}
+
+template<class T> bool CatalogReader::_DecodeColumn(uint16_t column_idx,
+						    uint64_t start_row,
+						    uint32_t n_rows,
+						    T* values,
+						    uint32_t n_threads) {
+  ColumnInfo& column = column_[column_idx];
+  if ((column.type == UnknownColumn) || (start_row + n_rows > n_rows_))
+    return false;
+
+  // Each block of rows is independent, so we can decode them in parallel.
+  uint32_t n_block = (n_rows + DecodeBlockRows - 1)/DecodeBlockRows;
+  const uint8_t* base = data_ + column.offset + start_row*column.stride;
+  STOMP_COUNT_N(BytesRead,
+		static_cast<uint64_t>(n_rows)*_ColumnSize(column.type));
+  ParallelFor(n_block, n_threads, [&](uint32_t k) {
+      uint32_t n_start = k*DecodeBlockRows;
+      uint32_t n_values = DecodeBlockRows;
+      if (n_start + n_values > n_rows) n_values = n_rows - n_start;
+      const uint8_t* ptr = base + n_start*column.stride;
+      switch (column.type) {
+      case Float64Column:
+	DecodeValues<double>(ptr, column.stride, column.swap_bytes,
+			     column.scale, column.zero, n_values,
+			     values + n_start);
+	break;
+      case Float32Column:
+	DecodeValues<float>(ptr, column.stride, column.swap_bytes,
+			    column.scale, column.zero, n_values,
+			    values + n_start);
+	break;
+      case Int64Column:
+	DecodeValues<int64_t>(ptr, column.stride, column.swap_bytes,
+			      column.scale, column.zero, n_values,
+			      values + n_start);
+	break;
+      case Int32Column:
+	DecodeValues<int32_t>(ptr, column.stride, column.swap_bytes,
+			      column.scale, column.zero, n_values,
+			      values + n_start);
+	break;
+      case Int16Column:
+	DecodeValues<int16_t>(ptr, column.stride, column.swap_bytes,
+			      column.scale, column.zero, n_values,
+			      values + n_start);
+	break;
+      case UInt8Column:
+	DecodeValues<uint8_t>(ptr, column.stride, column.swap_bytes,
+			      column.scale, column.zero, n_values,
+			      values + n_start);
+	break;
+      default:
+	break;
+      }
+    });
+
+  return true;
+}
+
+bool CatalogReader::_ReadRows(PointCatalog& catalog, uint64_t start_row,
+			      uint32_t n_rows, uint32_t n_threads) {
+  _Prefetch(start_row, n_rows);
+
+  theta_buffer_.resize(n_rows);
+  phi_buffer_.resize(n_rows);
+  weight_buffer_.resize(n_rows);
+  bool decoded =
+    _DecodeColumn(theta_idx_, start_row, n_rows, &theta_buffer_[0],
+		  n_threads) &&
+    _DecodeColumn(phi_idx_, start_row, n_rows, &phi_buffer_[0], n_threads);
+  if (weight_idx_ != -1) {
+    decoded = decoded &&
+      _DecodeColumn(weight_idx_, start_row, n_rows, &weight_buffer_[0],
+		    n_threads);
+  } else {
+    weight_buffer_.assign(n_rows, 1.0);
+  }
+  if (!decoded) {
+    std::cout << "Stomp::CatalogReader::Read - Failed to decode rows " <<
+      start_row << "-" << start_row + n_rows << ".\n";
+    return false;
+  }
+
+  uint32_t n_start = catalog.Size();
+  catalog.AddPoints(theta_buffer_, phi_buffer_, weight_buffer_, sphere_,
+		    radians_, n_threads);
+
+  if (redshift_idx_ != -1) {
+    catalog.AddRedshiftColumn();
+    if (!_DecodeColumn(redshift_idx_, start_row, n_rows,
+		       catalog.RedshiftColumn() + n_start, n_threads)) {
+      std::cout << "Stomp::CatalogReader::Read - Failed to decode " <<
+	"redshifts for rows " << start_row << "-" << start_row + n_rows <<
+	".\n";
+      return false;
+    }
+  }
+
+  // The Field columns keep the type of the file column where they can.
+  for (FieldColumnIterator iter=field_idx_.begin();
+       iter!=field_idx_.end();++iter) {
+    ColumnInfo& column = column_[iter->second];
+    PointCatalog::FieldType field_type = PointCatalog::DoubleField;
+    if ((column.scale == 1.0) && (column.zero == 0.0)) {
+      switch (column.type) {
+      case Float32Column:
+	field_type = PointCatalog::FloatField;
+	break;
+      case Int64Column:
+	field_type = PointCatalog::Int64Field;
+	break;
+      case Int32Column:
+      case Int16Column:
+      case UInt8Column:
+	field_type = PointCatalog::Int32Field;
+	break;
+      default:
+	break;
+      }
+    }
+    catalog.AddField(iter->first, field_type);
+
+    bool matched_type = false;
+    decoded = false;
+    switch (field_type) {
+    case PointCatalog::DoubleField:
+      matched_type = (catalog.FieldColumn<double>(iter->first) != NULL);
+      if (matched_type)
+	decoded = _DecodeColumn(iter->second, start_row, n_rows,
+				catalog.FieldColumn<double>(iter->first) +
+				n_start, n_threads);
+      break;
+    case PointCatalog::FloatField:
+      matched_type = (catalog.FieldColumn<float>(iter->first) != NULL);
+      if (matched_type)
+	decoded = _DecodeColumn(iter->second, start_row, n_rows,
+				catalog.FieldColumn<float>(iter->first) +
+				n_start, n_threads);
+      break;
+    case PointCatalog::Int32Field:
+      matched_type = (catalog.FieldColumn<int32_t>(iter->first) != NULL);
+      if (matched_type)
+	decoded = _DecodeColumn(iter->second, start_row, n_rows,
+				catalog.FieldColumn<int32_t>(iter->first) +
+				n_start, n_threads);
+      break;
+    case PointCatalog::Int64Field:
+      matched_type = (catalog.FieldColumn<int64_t>(iter->first) != NULL);
+      if (matched_type)
+	decoded = _DecodeColumn(iter->second, start_row, n_rows,
+				catalog.FieldColumn<int64_t>(iter->first) +
+				n_start, n_threads);
+      break;
+    }
+
+    if (!matched_type) {
+      std::cout << "Stomp::CatalogReader::Read - " << iter->first <<
+	" already exists in the catalog with a different type.\n";
+      return false;
+    }
+    if (!decoded) {
+      std::cout << "Stomp::CatalogReader::Read - Failed to decode " <<
+	iter->first << " for rows " << start_row << "-" <<
+	start_row + n_rows << ".\n";
+      return false;
+    }
+  }
+
+  return true;
+}
+
+void CatalogReader::_Prefetch(uint64_t start_row, uint32_t n_rows) {
+  // Let the kernel know which parts of the file we're about to read so that
+  // it can start pulling them in before we fault on them.
+  std::vector<int32_t> selected;
+  selected.push_back(theta_idx_);
+  selected.push_back(phi_idx_);
+  if (weight_idx_ != -1) selected.push_back(weight_idx_);
+  if (redshift_idx_ != -1) selected.push_back(redshift_idx_);
+  for (FieldColumnIterator iter=field_idx_.begin();
+       iter!=field_idx_.end();++iter) selected.push_back(iter->second);
+
+  uint64_t page_size = sysconf(_SC_PAGESIZE);
+  for (uint32_t i=0;i<selected.size();i++) {
+    ColumnInfo& column = column_[selected[i]];
+    uint64_t begin = column.offset + start_row*column.stride;
+    uint64_t end = column.offset + (start_row + n_rows)*column.stride;
+    if (end > file_size_) end = file_size_;
+    begin -= begin % page_size;
+    if (end > begin)
+      madvise(const_cast<uint8_t*>(data_) + begin, end - begin,
+	      MADV_WILLNEED);
+  }
+}
+
+bool CatalogReader::_CheckColumn(const std::string& column_name,
+				 int32_t& column_idx,
+				 const std::string& method) {
+  column_idx = ColumnIndex(column_name);
+  if (column_idx == -1) {
+    std::cout << "Stomp::CatalogReader::" << method << " - " <<
+      input_file_ << " has no column named " << column_name << "\n";
+    return false;
+  }
+  if (column_[column_idx].type == UnknownColumn) {
+    std::cout << "Stomp::CatalogReader::" << method << " - " <<
+      column_name << " is not a scalar numeric column.\n";
+    return false;
+  }
+  return true;
+}
+
+void CatalogReader::_ClearSelection() {
+  theta_idx_ = -1;
+  phi_idx_ = -1;
+  weight_idx_ = -1;
+  redshift_idx_ = -1;
+  field_idx_.clear();
+  sphere_ = AngularCoordinate::Equatorial;
+  radians_ = false;
+}
+
+// The fixed parts of the BinaryCatalogReader file layout.
+static const char BinaryCatalogMagic[8] = {'S', 'T', 'O', 'M',
+					   'P', 'C', 'A', 'T'};
+static const uint32_t BinaryCatalogVersion = 1;
+static const uint32_t BinaryCatalogHeaderSize = 32;
+static const uint32_t BinaryCatalogColumnSize = 64;
+static const uint32_t BinaryCatalogNameSize = 48;
+
+BinaryCatalogReader::BinaryCatalogReader() {
+}
+
+BinaryCatalogReader::BinaryCatalogReader(const std::string& input_file) {
+  Open(input_file);
+}
+
+BinaryCatalogReader::~BinaryCatalogReader() {
+}
+
+bool BinaryCatalogReader::Open(const std::string& input_file) {
+  if (!_MapFile(input_file)) return false;
+
+  if ((file_size_ < BinaryCatalogHeaderSize) ||
+      (memcmp(data_, BinaryCatalogMagic, 8) != 0)) {
+    std::cout << "Stomp::BinaryCatalogReader::Open - " << input_file <<
+      " is not a STOMP binary catalog.\n";
+    Close();
+    return false;
+  }
+
+  bool swap_bytes = false;
+  uint32_t byte_order = LoadValue<uint32_t>(data_ + 8, false);
+  if (byte_order != 1) {
+    swap_bytes = true;
+    byte_order = LoadValue<uint32_t>(data_ + 8, true);
+  }
+  uint32_t version = LoadValue<uint32_t>(data_ + 12, swap_bytes);
+  if ((byte_order != 1) || (version != BinaryCatalogVersion)) {
+    std::cout << "Stomp::BinaryCatalogReader::Open - " << input_file <<
+      " has an unknown version or byte order.\n";
+    Close();
+    return false;
+  }
+
+  uint64_t n_rows = LoadValue<uint64_t>(data_ + 16, swap_bytes);
+  uint32_t n_columns = LoadValue<uint32_t>(data_ + 24, swap_bytes);
+  if (file_size_ < BinaryCatalogHeaderSize +
+      static_cast<uint64_t>(n_columns)*BinaryCatalogColumnSize) {
+    std::cout << "Stomp::BinaryCatalogReader::Open - " << input_file <<
+      " is truncated.\n";
+    Close();
+    return false;
+  }
+
+  for (uint32_t i=0;i<n_columns;i++) {
+    const uint8_t* record = data_ + BinaryCatalogHeaderSize +
+      i*BinaryCatalogColumnSize;
+    const char* name = reinterpret_cast<const char*>(record);
+
+    ColumnInfo column;
+    column.name = std::string(name, strnlen(name, BinaryCatalogNameSize));
+    uint32_t column_type =
+      LoadValue<uint32_t>(record + BinaryCatalogNameSize, swap_bytes);
+    column.type = (column_type < UnknownColumn ?
+		   static_cast<ColumnType>(column_type) : UnknownColumn);
+    column.offset =
+      LoadValue<uint64_t>(record + BinaryCatalogNameSize + 8, swap_bytes);
+    column.stride = _ColumnSize(column.type);
+    column.swap_bytes = swap_bytes;
+    column.scale = 1.0;
+    column.zero = 0.0;
+
+    if (column.offset + n_rows*column.stride > file_size_) {
+      std::cout << "Stomp::BinaryCatalogReader::Open - " << input_file <<
+	" is truncated (column " << column.name << ").\n";
+      Close();
+      return false;
+    }
+    column_.push_back(column);
+  }
+  n_rows_ = n_rows;
+
+  return true;
+}
+
+bool BinaryCatalogReader::Write(const std::string& output_file,
+				PointCatalog& catalog,
+				AngularCoordinate::Sphere sphere,
+				bool radians) {
+  std::vector<double> thetaVec, phiVec;
+  catalog.Coordinates(thetaVec, phiVec, sphere, radians);
+
+  // Gather up the columns that we're going to write.
+  std::vector<std::string> names;
+  std::vector<ColumnType> types;
+  std::vector<const void*> columns;
+  switch (sphere) {
+  case AngularCoordinate::Survey:
+    names.push_back("LAMBDA");
+    names.push_back("ETA");
+    break;
+  case AngularCoordinate::Equatorial:
+    names.push_back("RA");
+    names.push_back("DEC");
+    break;
+  case AngularCoordinate::Galactic:
+    names.push_back("GLON");
+    names.push_back("GLAT");
+    break;
+  }
+  types.push_back(Float64Column);
+  types.push_back(Float64Column);
+  columns.push_back(thetaVec.empty() ? NULL : &thetaVec[0]);
+  columns.push_back(phiVec.empty() ? NULL : &phiVec[0]);
+
+  names.push_back("WEIGHT");
+  types.push_back(Float64Column);
+  columns.push_back(catalog.Empty() ? NULL : catalog.WeightColumn());
+
+  if (catalog.HasRedshift()) {
+    names.push_back("REDSHIFT");
+    types.push_back(Float64Column);
+    columns.push_back(catalog.RedshiftColumn());
+  }
+
+  std::vector<std::string> field_names;
+  catalog.FieldNames(field_names);
+  for (uint32_t i=0;i<field_names.size();i++) {
+    PointCatalog::FieldType field_type;
+    catalog.FindFieldType(field_names[i], field_type);
+    names.push_back(field_names[i]);
+    switch (field_type) {
+    case PointCatalog::DoubleField:
+      types.push_back(Float64Column);
+      columns.push_back(catalog.FieldColumn<double>(field_names[i]));
+      break;
+    case PointCatalog::FloatField:
+      types.push_back(Float32Column);
+      columns.push_back(catalog.FieldColumn<float>(field_names[i]));
+      break;
+    case PointCatalog::Int32Field:
+      types.push_back(Int32Column);
+      columns.push_back(catalog.FieldColumn<int32_t>(field_names[i]));
+      break;
+    case PointCatalog::Int64Field:
+      types.push_back(Int64Column);
+      columns.push_back(catalog.FieldColumn<int64_t>(field_names[i]));
+      break;
+    }
+  }
+
+  // Now lay out the file, keeping each column 8-byte aligned.
+  uint64_t n_rows = catalog.Size();
+  uint32_t n_columns = names.size();
+  std::vector<uint64_t> offsets(n_columns);
+  uint64_t offset = BinaryCatalogHeaderSize +
+    n_columns*BinaryCatalogColumnSize;
+  for (uint32_t i=0;i<n_columns;i++) {
+    offsets[i] = offset;
+    offset += n_rows*_ColumnSize(types[i]);
+    offset += (8 - offset % 8) % 8;
+  }
+
+  FILE* output = fopen(output_file.c_str(), "wb");
+  if (output == NULL) {
+    std::cout << "Stomp::BinaryCatalogReader::Write - Couldn't open " <<
+      output_file << " for writing.\n";
+    return false;
+  }
+
+  uint8_t header[BinaryCatalogHeaderSize];
+  uint32_t byte_order = 1;
+  uint32_t unused = 0;
+  memset(header, 0, BinaryCatalogHeaderSize);
+  memcpy(header, BinaryCatalogMagic, 8);
+  memcpy(header + 8, &byte_order, 4);
+  memcpy(header + 12, &BinaryCatalogVersion, 4);
+  memcpy(header + 16, &n_rows, 8);
+  memcpy(header + 24, &n_columns, 4);
+  memcpy(header + 28, &unused, 4);
+  bool io_success =
+    (fwrite(header, 1, BinaryCatalogHeaderSize, output) ==
+     BinaryCatalogHeaderSize);
+
+  for (uint32_t i=0;i<n_columns && io_success;i++) {
+    uint8_t record[BinaryCatalogColumnSize];
+    uint32_t column_type = types[i];
+    memset(record, 0, BinaryCatalogColumnSize);
+    strncpy(reinterpret_cast<char*>(record), names[i].c_str(),
+	    BinaryCatalogNameSize - 1);
+    memcpy(record + BinaryCatalogNameSize, &column_type, 4);
+    memcpy(record + BinaryCatalogNameSize + 8, &offsets[i], 8);
+    io_success = (fwrite(record, 1, BinaryCatalogColumnSize, output) ==
+		  BinaryCatalogColumnSize);
+  }
+
+  const uint8_t padding[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+  for (uint32_t i=0;i<n_columns && io_success;i++) {
+    uint64_t n_bytes = n_rows*_ColumnSize(types[i]);
+    if (n_bytes > 0)
+      io_success = (fwrite(columns[i], 1, n_bytes, output) == n_bytes);
+    uint64_t n_pad = (8 - (offsets[i] + n_bytes) % 8) % 8;
+    if (io_success && (n_pad > 0))
+      io_success = (fwrite(padding, 1, n_pad, output) == n_pad);
+  }
+
+  if (fclose(output) != 0) io_success = false;
+  if (!io_success)
+    std::cout << "Stomp::BinaryCatalogReader::Write - Failed writing to " <<
+      output_file << "\n";
+
+  return io_success;
+}
+
+// FITS files are made of 2880-byte blocks and each header is a series of
+// 80-character cards.
+static const uint32_t FitsBlockSize = 2880;
+static const uint32_t FitsCardSize = 80;
+
+typedef std::map<std::string, std::string> FitsHeader;
+
+static std::string TrimFitsString(const std::string& input) {
+  size_t first = input.find_first_not_of(' ');
+  if (first == std::string::npos) return "";
+  size_t last = input.find_last_not_of(' ');
+  return input.substr(first, last - first + 1);
+}
+
+// Parse the header starting at offset, storing the keyword values (minus
+// any quotes or comments) and setting data_offset to the start of the data
+// that follows.  Returns false if we run off the end of the file before
+// finding the END card.
+static bool ParseFitsHeader(const uint8_t* data, uint64_t file_size,
+			    uint64_t offset, FitsHeader& header,
+			    uint64_t& data_offset) {
+  header.clear();
+  for (uint64_t card=offset;card+FitsCardSize<=file_size;
+       card+=FitsCardSize) {
+    std::string line(reinterpret_cast<const char*>(data + card),
+		     FitsCardSize);
+    std::string keyword = TrimFitsString(line.substr(0, 8));
+
+    if (keyword == "END") {
+      uint64_t header_end = card + FitsCardSize;
+      data_offset = ((header_end + FitsBlockSize - 1)/FitsBlockSize)*
+	FitsBlockSize;
+      return true;
+    }
+
+    if (line.compare(8, 2, "= ") != 0) continue;
+
+    std::string value = line.substr(10);
+    size_t first = value.find_first_not_of(' ');
+    if ((first != std::string::npos) && (value[first] == '\'')) {
+      // String values are quoted, with '' standing in for a literal quote.
+      std::string string_value;
+      for (size_t k=first+1;k<value.size();k++) {
+	if (value[k] == '\'') {
+	  if ((k + 1 < value.size()) && (value[k+1] == '\'')) {
+	    string_value += '\'';
+	    k++;
+	  } else {
+	    break;
+	  }
+	} else {
+	  string_value += value[k];
+	}
+      }
+      value = string_value;
+    } else {
+      size_t comment = value.find('/');
+      if (comment != std::string::npos) value = value.substr(0, comment);
+    }
+    header[keyword] = TrimFitsString(value);
+  }
+
+  return false;
+}
+
+static int64_t FitsInteger(FitsHeader& header, const std::string& keyword,
+			   int64_t default_value) {
+  FitsHeader::iterator iter = header.find(keyword);
+  if (iter == header.end()) return default_value;
+  return strtoll(iter->second.c_str(), NULL, 10);
+}
+
+static double FitsDouble(FitsHeader& header, const std::string& keyword,
+			 double default_value) {
+  FitsHeader::iterator iter = header.find(keyword);
+  if (iter == header.end()) return default_value;
+  // FITS allows D as the exponent character.
+  std::string value = iter->second;
+  for (size_t k=0;k<value.size();k++)
+    if ((value[k] == 'D') || (value[k] == 'd')) value[k] = 'E';
+  return strtod(value.c_str(), NULL);
+}
+
+FitsCatalogReader::FitsCatalogReader() {
+}
+
+FitsCatalogReader::FitsCatalogReader(const std::string& input_file,
+				     uint16_t extension) {
+  Open(input_file, extension);
+}
+
+FitsCatalogReader::~FitsCatalogReader() {
+}
+
+bool FitsCatalogReader::Open(const std::string& input_file) {
+  return Open(input_file, 1);
+}
+
+bool FitsCatalogReader::Open(const std::string& input_file,
+			     uint16_t extension) {
+  if (!_MapFile(input_file)) return false;
+
+  // Walk through the HDUs until we reach the one we want.
+  FitsHeader header;
+  uint64_t offset = 0;
+  uint64_t data_offset = 0;
+  for (uint16_t hdu=0;hdu<=extension;hdu++) {
+    if (!ParseFitsHeader(data_, file_size_, offset, header, data_offset)) {
+      std::cout << "Stomp::FitsCatalogReader::Open - Couldn't find HDU " <<
+	hdu << " in " << input_file << "\n";
+      Close();
+      return false;
+    }
+    if ((hdu == 0) && (header.find("SIMPLE") == header.end())) {
+      std::cout << "Stomp::FitsCatalogReader::Open - " << input_file <<
+	" is not a FITS file.\n";
+      Close();
+      return false;
+    }
+    if (hdu == extension) break;
+
+    int64_t n_axis = FitsInteger(header, "NAXIS", 0);
+    uint64_t data_size = 0;
+    if (n_axis > 0) {
+      data_size = 1;
+      for (int64_t i=1;i<=n_axis;i++) {
+	std::ostringstream keyword;
+	keyword << "NAXIS" << i;
+	data_size *= FitsInteger(header, keyword.str(), 0);
+      }
+      data_size += FitsInteger(header, "PCOUNT", 0);
+      data_size *= FitsInteger(header, "GCOUNT", 1);
+      int64_t bitpix = FitsInteger(header, "BITPIX", 8);
+      data_size *= (bitpix < 0 ? -bitpix : bitpix)/8;
+    }
+    offset = data_offset +
+      ((data_size + FitsBlockSize - 1)/FitsBlockSize)*FitsBlockSize;
+  }
+
+  if ((header.find("XTENSION") == header.end()) ||
+      (header["XTENSION"] != "BINTABLE")) {
+    std::cout << "Stomp::FitsCatalogReader::Open - HDU " << extension <<
+      " of " << input_file << " is not a binary table.\n";
+    Close();
+    return false;
+  }
+
+  uint64_t row_size = FitsInteger(header, "NAXIS1", 0);
+  uint64_t n_rows = FitsInteger(header, "NAXIS2", 0);
+  int64_t n_fields = FitsInteger(header, "TFIELDS", 0);
+  bool swap_bytes = !_HostIsBigEndian();
+
+  uint64_t column_offset = 0;
+  for (int64_t i=1;i<=n_fields;i++) {
+    std::ostringstream ttype, tform, tscal, tzero;
+    ttype << "TTYPE" << i;
+    tform << "TFORM" << i;
+    tscal << "TSCAL" << i;
+    tzero << "TZERO" << i;
+
+    // TFORM is an optional repeat count followed by the type code.
+    std::string form = header[tform.str()];
+    uint64_t repeat = 1;
+    size_t code_idx = form.find_first_not_of("0123456789");
+    if (code_idx == std::string::npos) {
+      std::cout << "Stomp::FitsCatalogReader::Open - Bad TFORM" << i <<
+	" in " << input_file << "\n";
+      Close();
+      return false;
+    }
+    if (code_idx > 0) repeat = strtoull(form.substr(0, code_idx).c_str(),
+					NULL, 10);
+
+    ColumnInfo column;
+    column.name = header[ttype.str()];
+    if (column.name.empty()) {
+      std::ostringstream name;
+      name << "COL" << i;
+      column.name = name.str();
+    }
+    column.type = UnknownColumn;
+    uint64_t width = 0;
+    switch (form[code_idx]) {
+    case 'L':
+    case 'A':
+      width = repeat;
+      break;
+    case 'X':
+      width = (repeat + 7)/8;
+      break;
+    case 'B':
+      width = repeat;
+      column.type = UInt8Column;
+      break;
+    case 'I':
+      width = 2*repeat;
+      column.type = Int16Column;
+      break;
+    case 'J':
+      width = 4*repeat;
+      column.type = Int32Column;
+      break;
+    case 'K':
+      width = 8*repeat;
+      column.type = Int64Column;
+      break;
+    case 'E':
+      width = 4*repeat;
+      column.type = Float32Column;
+      break;
+    case 'D':
+      width = 8*repeat;
+      column.type = Float64Column;
+      break;
+    case 'C':
+    case 'P':
+      width = 8*repeat;
+      break;
+    case 'M':
+    case 'Q':
+      width = 16*repeat;
+      break;
+    default:
+      std::cout << "Stomp::FitsCatalogReader::Open - Unknown TFORM" << i <<
+	" (" << form << ") in " << input_file << "\n";
+      Close();
+      return false;
+    }
+    if (repeat != 1) column.type = UnknownColumn;
+
+    column.offset = data_offset + column_offset;
+    column.stride = row_size;
+    column.swap_bytes = swap_bytes;
+    column.scale = FitsDouble(header, tscal.str(), 1.0);
+    column.zero = FitsDouble(header, tzero.str(), 0.0);
+    column_.push_back(column);
+
+    column_offset += width;
+  }
+
+  if (column_offset != row_size) {
+    std::cout << "Stomp::FitsCatalogReader::Open - Column widths (" <<
+      column_offset << ") don't match NAXIS1 (" << row_size << ") in " <<
+      input_file << "\n";
+    Close();
+    return false;
+  }
+  if (data_offset + n_rows*row_size > file_size_) {
+    std::cout << "Stomp::FitsCatalogReader::Open - " << input_file <<
+      " is truncated.\n";
+    Close();
+    return false;
+  }
+  n_rows_ = n_rows;
+
+  return true;
+}
+
+} // end namespace Stomp
@@ -0,0 +1,235 @@
+// Copyright 2010  All Rights Reserved.
+// Author: ryan.scranton@gmail.com (Ryan Scranton)
+
+// STOMP is a set of libraries for doing astrostatistical analysis on the
+// celestial sphere.  The goal is to enable descriptions of arbitrary regions
+// on the sky which may or may not encode futher spatial information (galaxy
+// density, CMB temperature, observational depth, etc.) and to do so in such
+// a way as to make the analysis of that data as algorithmically efficient as
+// possible.
+//
+// This header file contains the classes for reading point catalogs from
+// binary files.  Parsing ASCII catalogs a line at a time is fine for a few
+// million objects, but for catalogs with billions of rows the conversion
+// from text dominates everything else.  The readers here memory-map the
+// input file and decode the requested columns straight into a PointCatalog,
+// a chunk of rows at a time, so that the full catalog never needs to be in
+// memory as WeightedAngularCoordinate objects.  Two formats are supported: a
+// simple columnar format native to STOMP (see BinaryCatalogReader) and FITS
+// binary tables (see FitsCatalogReader).
+
+#ifndef STOMP_CATALOG_READER_H
+#define STOMP_CATALOG_READER_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "stomp_core.h"
+#include "stomp_angular_coordinate.h"
+#include "stomp_point_catalog.h"
+
+namespace Stomp {
+
+class CatalogReader;
+class BinaryCatalogReader;
+class FitsCatalogReader;
+
+class CatalogReader {
+  // The base class for the binary catalog readers.  The derived classes
+  // handle opening the file and working out where each column lives; the
+  // base class takes care of the memory-mapping, the column selection and the
+  // conversion of rows into PointCatalog entries.  The basic pattern is
+  //
+  //   FitsCatalogReader reader;
+  //   reader.Open("galaxies.fits");
+  //   reader.SetCoordinateColumns("RA", "DEC");
+  //   reader.SetWeightColumn("PROB");
+  //   PointCatalog catalog;
+  //   while (reader.ReadChunk(catalog) > 0) { ...do something with catalog }
+  //
+  // or, if the whole catalog fits in memory, reader.Read(catalog).
+
+ public:
+  // The column types we know how to decode.  Any column in the file that
+  // isn't one of these (strings, arrays, etc.) can't be selected.
+  enum ColumnType {
+    Float64Column,
+    Float32Column,
+    Int64Column,
+    Int32Column,
+    Int16Column,
+    UInt8Column,
+    UnknownColumn
+  };
+
+  CatalogReader();
+  virtual ~CatalogReader();
+
+  // Open and parse the header of the input file.  On failure, an error
+  // message is printed and the return value is false.
+  virtual bool Open(const std::string& input_file) = 0;
+  void Close();
+  bool IsOpen();
+
+  uint64_t NRows();
+  uint16_t NColumns();
+  void ColumnNames(std::vector<std::string>& column_names);
+  ColumnType FindColumnType(const std::string& column_name);
+
+  // Returns -1 if there is no column with that name.  Column names are
+  // matched exactly.
+  int32_t ColumnIndex(const std::string& column_name);
+
+  // Select the columns to read.  The coordinate columns are required before
+  // any of the read methods will do anything; the weight column is optional
+  // (unity for every point if it isn't set).  Each method returns false if
+  // one of the named columns doesn't exist or can't be decoded.
+  bool SetCoordinateColumns(const std::string& theta_column,
+			    const std::string& phi_column,
+			    AngularCoordinate::Sphere sphere =
+			    AngularCoordinate::Equatorial,
+			    bool radians = false);
+  bool SetWeightColumn(const std::string& weight_column);
+  bool SetRedshiftColumn(const std::string& redshift_column);
+
+  // Any other columns can be carried along as Field columns in the output
+  // PointCatalog.  The keys of the input FieldColumnDict are the column names
+  // (which become the Field names as well) and, on return, the values are
+  // the indices of those columns in the file, as in the FieldColumnDict
+  // arguments to the ASCII readers.  Integer columns become integer Fields,
+  // unless the column has a scaling applied to it.
+  bool SetFieldColumns(FieldColumnDict& field_columns);
+
+  // Read up to max_rows rows, starting from the current row, into the input
+  // catalog, replacing its contents.  The return value is the number of rows
+  // read, so 0 means that we've reached the end of the file.
+  uint32_t ReadChunk(PointCatalog& catalog,
+		     uint32_t max_rows = DefaultChunkRows,
+		     uint32_t n_threads = DefaultThreads());
+
+  // Alternatively, read all of the remaining rows, appending them to the
+  // contents of the catalog.
+  bool Read(PointCatalog& catalog, uint32_t n_threads = DefaultThreads());
+
+  // The position of the next row to be read.  Rewind goes back to the start.
+  uint64_t CurrentRow();
+  void Rewind();
+  void SetCurrentRow(uint64_t row);
+
+  // Decode n_rows values from one of the file columns into the output array,
+  // regardless of what columns have been selected.  Returns false if the
+  // column index or row range is invalid.
+  bool ColumnValues(uint16_t column_idx, uint64_t start_row, uint32_t n_rows,
+		    double* values, uint32_t n_threads = DefaultThreads());
+
+  static const uint32_t DefaultChunkRows = 1048576;
+
+ protected:
+  // Where each column's values live in the mapped file.  Value i of the
+  // column is at offset + i*stride.  FITS also allows a linear scaling to be
+  // applied to each value.
+  struct ColumnInfo {
+    std::string name;
+    ColumnType type;
+    uint64_t offset;
+    uint64_t stride;
+    bool swap_bytes;
+    double scale;
+    double zero;
+  };
+
+  // Map the file into memory, setting data_ and file_size_.
+  bool _MapFile(const std::string& input_file);
+  static uint8_t _ColumnSize(ColumnType column_type);
+  static bool _HostIsBigEndian();
+
+  std::vector<ColumnInfo> column_;
+  uint64_t n_rows_;
+  const uint8_t* data_;
+  uint64_t file_size_;
+
+ private:
+  template<class T> bool _DecodeColumn(uint16_t column_idx,
+				       uint64_t start_row, uint32_t n_rows,
+				       T* values, uint32_t n_threads);
+  bool _ReadRows(PointCatalog& catalog, uint64_t start_row, uint32_t n_rows,
+		 uint32_t n_threads);
+  void _Prefetch(uint64_t start_row, uint32_t n_rows);
+  bool _CheckColumn(const std::string& column_name, int32_t& column_idx,
+		    const std::string& method);
+  void _ClearSelection();
+
+  // The mapping can't be shared between readers, so no copying.
+  CatalogReader(const CatalogReader& reader);
+  CatalogReader& operator=(const CatalogReader& reader);
+
+  std::string input_file_;
+  int32_t theta_idx_, phi_idx_, weight_idx_, redshift_idx_;
+  FieldColumnDict field_idx_;
+  AngularCoordinate::Sphere sphere_;
+  bool radians_;
+  uint64_t current_row_;
+  std::vector<double> theta_buffer_, phi_buffer_, weight_buffer_;
+};
+
+class BinaryCatalogReader : public CatalogReader {
+  // A simple columnar format for point catalogs.  The file starts with a
+  // header
+  //
+  //   char[8]   "STOMPCAT"
+  //   uint32_t  1 (to detect the byte order of the file)
+  //   uint32_t  format version (currently 1)
+  //   uint64_t  number of rows
+  //   uint32_t  number of columns
+  //   uint32_t  unused
+  //
+  // followed by a 64-byte record for each column
+  //
+  //   char[48]  column name (NUL-padded)
+  //   uint32_t  column type (CatalogReader::ColumnType)
+  //   uint32_t  unused
+  //   uint64_t  byte offset of the column data from the start of the file
+  //
+  // with each column's values stored contiguously after that.  Since a
+  // column is a single block of memory, reading it is as fast as the disk
+  // allows.  The Write method produces files in this format from a
+  // PointCatalog.
+
+ public:
+  BinaryCatalogReader();
+  BinaryCatalogReader(const std::string& input_file);
+  virtual ~BinaryCatalogReader();
+
+  virtual bool Open(const std::string& input_file);
+
+  // Write the input catalog to a file.  The coordinate columns are named
+  // RA & DEC, LAMBDA & ETA or GLON & GLAT, depending on the requested Sphere,
+  // followed by WEIGHT, REDSHIFT (if the catalog has one) and any Fields.
+  static bool Write(const std::string& output_file, PointCatalog& catalog,
+		    AngularCoordinate::Sphere sphere =
+		    AngularCoordinate::Equatorial,
+		    bool radians = false);
+};
+
+class FitsCatalogReader : public CatalogReader {
+  // A reader for FITS binary tables.  This is not a general FITS library;
+  // it understands just enough of the standard to find a BINTABLE extension
+  // and locate its scalar numeric columns (TFORM codes B, I, J, K, E and D
+  // with a repeat count of 1), including any TSCAL/TZERO scaling.  Other
+  // columns are skipped over.  FITS stores rows rather than columns, so
+  // reading a few columns out of a wide table touches more of the file than
+  // the BinaryCatalogReader would.
+
+ public:
+  FitsCatalogReader();
+  FitsCatalogReader(const std::string& input_file, uint16_t extension = 1);
+  virtual ~FitsCatalogReader();
+
+  // By default, we read the first extension after the primary HDU.
+  virtual bool Open(const std::string& input_file);
+  bool Open(const std::string& input_file, uint16_t extension);
+};
+
+} // end namespace Stomp
+
+#endif
@@ -0,0 +1,234 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <iostream>
+#include <math.h>
+#include <string>
+#include <vector>
+#include <gflags/gflags.h>
+#include "stomp_core.h"
+#include "stomp_angular_coordinate.h"
+#include "stomp_pixel.h"
+#include "stomp_map.h"
+#include "stomp_tree_map.h"
+#include "stomp_point_catalog.h"
+#include "stomp_catalog_reader.h"
+
+void CatalogReaderBinaryTests() {
+  // Write a catalog out in the binary format and make sure we get the same
+  // thing back, both all at once and in chunks.
+  std::cout << "\n";
+  std::cout << "**********************************\n";
+  std::cout << "*** CatalogReader Binary Tests ***\n";
+  std::cout << "**********************************\n";
+  Stomp::AngularCoordinate ang(60.0, 0.0, Stomp::AngularCoordinate::Survey);
+  Stomp::Pixel tmp_pix(ang, 256);
+  Stomp::PixelVector annulus_pix;
+  tmp_pix.WithinRadius(3.0, annulus_pix);
+  Stomp::Map* stomp_map = new Stomp::Map(annulus_pix);
+
+  uint32_t n_random = 10000;
+  Stomp::AngularVector rand_ang;
+  stomp_map->GenerateRandomPoints(rand_ang, n_random);
+  Stomp::PointCatalog catalog(rand_ang);
+  catalog.AddField("magnitude", Stomp::PointCatalog::FloatField);
+  catalog.AddField("id", Stomp::PointCatalog::Int64Field);
+  float* magnitude = catalog.FieldColumn<float>("magnitude");
+  int64_t* id = catalog.FieldColumn<int64_t>("id");
+  for (uint32_t i=0;i<catalog.Size();i++) {
+    catalog.SetWeight(i, 0.5 + 0.001*i);
+    magnitude[i] = 20.0 + 0.0001*i;
+    id[i] = 10000000000LL + i;
+  }
+
+  std::string file_name = "/tmp/stomp_catalog_reader_test.scat";
+  if (!Stomp::BinaryCatalogReader::Write(file_name, catalog))
+    std::cout << "\tFAILED to write " << file_name << "\n";
+
+  Stomp::BinaryCatalogReader reader(file_name);
+  std::cout << "\tRead header: " << reader.NRows() << " rows, " <<
+    reader.NColumns() << " columns\n";
+
+  Stomp::FieldColumnDict field_columns;
+  field_columns["magnitude"] = 0;
+  field_columns["id"] = 0;
+  reader.SetCoordinateColumns("RA", "DEC");
+  reader.SetWeightColumn("WEIGHT");
+  reader.SetFieldColumns(field_columns);
+  std::cout << "\tmagnitude column: " <<
+    static_cast<int>(field_columns["magnitude"]) << ", id column: " <<
+    static_cast<int>(field_columns["id"]) << "\n";
+
+  Stomp::PointCatalog read_catalog;
+  reader.Read(read_catalog);
+  uint32_t n_mismatch = 0;
+  float* read_magnitude = read_catalog.FieldColumn<float>("magnitude");
+  int64_t* read_id = read_catalog.FieldColumn<int64_t>("id");
+  if ((read_magnitude == NULL) || (read_id == NULL)) {
+    std::cout << "\tFAILED: Field columns missing or the wrong type.\n";
+  } else {
+    for (uint32_t i=0;i<catalog.Size();i++) {
+      if ((fabs(read_catalog.UnitSphereX(i) - catalog.UnitSphereX(i)) >
+	   1.0e-10) ||
+	  (fabs(read_catalog.UnitSphereY(i) - catalog.UnitSphereY(i)) >
+	   1.0e-10) ||
+	  (fabs(read_catalog.UnitSphereZ(i) - catalog.UnitSphereZ(i)) >
+	   1.0e-10) ||
+	  (read_catalog.Weight(i) != catalog.Weight(i)) ||
+	  (read_magnitude[i] != magnitude[i]) || (read_id[i] != id[i]))
+	n_mismatch++;
+    }
+  }
+  std::cout << "\t" << read_catalog.Size() << " points read, " <<
+    n_mismatch << " mismatched.\n";
+
+  // Now in chunks, straight into a TreeMap.
+  reader.Rewind();
+  Stomp::TreeMap* tree_map = new Stomp::TreeMap(128, 50);
+  if (!tree_map->Read(reader, false, 777))
+    std::cout << "\tFAILED to read all points into the tree.\n";
+  std::cout << "\tTreeMap::Read: " << tree_map->NPoints() << "/" <<
+    n_random << " points, weight " << tree_map->Weight() << " (" <<
+    catalog.TotalWeight() << ")\n";
+
+  delete tree_map;
+  delete stomp_map;
+  remove(file_name.c_str());
+}
+
+// Append a FITS header card to the buffer.
+static void AddFitsCard(std::string& header, const std::string& card) {
+  std::string padded_card = card;
+  padded_card.resize(80, ' ');
+  header += padded_card;
+}
+
+// Store the value in FITS (big-endian) byte order.
+template<class T> static void AddFitsValue(std::string& data, T value) {
+  uint8_t bytes[sizeof(T)];
+  memcpy(bytes, &value, sizeof(T));
+  uint32_t one = 1;
+  uint8_t first_byte;
+  memcpy(&first_byte, &one, 1);
+  for (uint32_t k=0;k<sizeof(T);k++)
+    data += static_cast<char>(first_byte == 1 ? bytes[sizeof(T) - 1 - k] :
+			      bytes[k]);
+}
+
+void CatalogReaderFitsTests() {
+  // Build a small FITS binary table by hand with a mix of column types,
+  // including a string column and a scaled integer column, and read it back.
+  std::cout << "\n";
+  std::cout << "********************************\n";
+  std::cout << "*** CatalogReader FITS Tests ***\n";
+  std::cout << "********************************\n";
+  uint32_t n_rows = 1000;
+  std::string primary;
+  AddFitsCard(primary, "SIMPLE  =                    T");
+  AddFitsCard(primary, "BITPIX  =                    8");
+  AddFitsCard(primary, "NAXIS   =                    0");
+  AddFitsCard(primary, "EXTEND  =                    T");
+  AddFitsCard(primary, "END");
+  primary.resize(2880, ' ');
+
+  // Columns: RA (D), DEC (E), NAME (8A), FLAG (J), MAG (I, scaled)
+  std::string extension;
+  AddFitsCard(extension, "XTENSION= 'BINTABLE'           / binary table");
+  AddFitsCard(extension, "BITPIX  =                    8");
+  AddFitsCard(extension, "NAXIS   =                    2");
+  AddFitsCard(extension, "NAXIS1  =                   26");
+  AddFitsCard(extension, "NAXIS2  =                 1000");
+  AddFitsCard(extension, "PCOUNT  =                    0");
+  AddFitsCard(extension, "GCOUNT  =                    1");
+  AddFitsCard(extension, "TFIELDS =                    5");
+  AddFitsCard(extension, "TTYPE1  = 'RA      '");
+  AddFitsCard(extension, "TFORM1  = 'D       '");
+  AddFitsCard(extension, "TTYPE2  = 'DEC     '");
+  AddFitsCard(extension, "TFORM2  = '1E      '");
+  AddFitsCard(extension, "TTYPE3  = 'NAME    '");
+  AddFitsCard(extension, "TFORM3  = '8A      '");
+  AddFitsCard(extension, "TTYPE4  = 'FLAG    '");
+  AddFitsCard(extension, "TFORM4  = 'J       '");
+  AddFitsCard(extension, "TTYPE5  = 'MAG     '");
+  AddFitsCard(extension, "TFORM5  = 'I       '");
+  AddFitsCard(extension, "TSCAL5  =                0.001");
+  AddFitsCard(extension, "TZERO5  =                 20.0");
+  AddFitsCard(extension, "END");
+  extension.resize(2880, ' ');
+
+  std::string data;
+  for (uint32_t i=0;i<n_rows;i++) {
+    AddFitsValue<double>(data, 150.0 + 0.001*i);
+    AddFitsValue<float>(data, 2.0 + 0.001*i);
+    data += "galaxy  ";
+    AddFitsValue<int32_t>(data, i % 7);
+    AddFitsValue<int16_t>(data, i);
+  }
+  data.resize(((data.size() + 2879)/2880)*2880, '\0');
+
+  std::string file_name = "/tmp/stomp_catalog_reader_test.fits";
+  FILE* fits_file = fopen(file_name.c_str(), "wb");
+  fwrite(primary.data(), 1, primary.size(), fits_file);
+  fwrite(extension.data(), 1, extension.size(), fits_file);
+  fwrite(data.data(), 1, data.size(), fits_file);
+  fclose(fits_file);
+
+  Stomp::FitsCatalogReader reader(file_name);
+  std::cout << "\tRead header: " << reader.NRows() << " rows, " <<
+    reader.NColumns() << " columns\n";
+  if (reader.SetWeightColumn("NAME"))
+    std::cout << "\tFAILED: selected a string column.\n";
+
+  Stomp::FieldColumnDict field_columns;
+  field_columns["FLAG"] = 0;
+  field_columns["MAG"] = 0;
+  reader.SetCoordinateColumns("RA", "DEC");
+  reader.SetFieldColumns(field_columns);
+
+  Stomp::PointCatalog catalog;
+  uint32_t n_chunks = 0;
+  uint32_t n_mismatch = 0;
+  uint32_t n_read = 0;
+  while (reader.ReadChunk(catalog, 300) > 0) {
+    int32_t* flag = catalog.FieldColumn<int32_t>("FLAG");
+    double* mag = catalog.FieldColumn<double>("MAG");
+    for (uint32_t i=0;i<catalog.Size();i++,n_read++) {
+      Stomp::AngularCoordinate check_ang(150.0 + 0.001*n_read,
+					 static_cast<float>(2.0 + 0.001*n_read),
+					 Stomp::AngularCoordinate::Equatorial);
+      if ((fabs(catalog.UnitSphereX(i) - check_ang.UnitSphereX()) > 1.0e-10) ||
+	  (fabs(catalog.UnitSphereY(i) - check_ang.UnitSphereY()) > 1.0e-10) ||
+	  (fabs(catalog.UnitSphereZ(i) - check_ang.UnitSphereZ()) > 1.0e-10) ||
+	  (flag == NULL) || (flag[i] != static_cast<int32_t>(n_read % 7)) ||
+	  (mag == NULL) || (fabs(mag[i] - (20.0 + 0.001*n_read)) > 1.0e-10))
+	n_mismatch++;
+    }
+    n_chunks++;
+  }
+  std::cout << "\t" << n_read << " rows read in " << n_chunks <<
+    " chunks, " << n_mismatch << " mismatched.\n";
+
+  remove(file_name.c_str());
+}
+
+// Define our command line flags
+DEFINE_bool(all_catalog_reader_tests, false, "Run all class unit tests.");
+DEFINE_bool(catalog_reader_binary_tests, false,
+            "Run CatalogReader binary format tests");
+DEFINE_bool(catalog_reader_fits_tests, false,
+            "Run CatalogReader FITS tests");
+
+void CatalogReaderUnitTests(bool run_all_tests) {
+  void CatalogReaderBinaryTests();
+  void CatalogReaderFitsTests();
+
+  if (run_all_tests) FLAGS_all_catalog_reader_tests = true;
+
+  // Check the round trip through the Stomp::BinaryCatalogReader format.
+  if (FLAGS_all_catalog_reader_tests || FLAGS_catalog_reader_binary_tests)
+    CatalogReaderBinaryTests();
+
+  // Check the Stomp::FitsCatalogReader against a hand-built binary table.
+  if (FLAGS_all_catalog_reader_tests || FLAGS_catalog_reader_fits_tests)
+    CatalogReaderFitsTests();
+}
@@ -16,6 +16,9 @@
 #define STOMP_STOMP_CORE_H_
 
 #include <stdint.h>
+#include <atomic>
+#include <thread>
+#include <vector>
 
 namespace Stomp {
 
@@ -76,6 +79,38 @@ bool DoubleEQ(double a, double b);
 // resolution level.
 uint8_t MostSignificantBit(uint32_t input_int);
 
+// Several of the heavier Map methods break their work into independent pieces
+// (usually one per superpixel) that can be done concurrently.  DefaultThreads
+// returns the number of threads to use when the caller doesn't specify one
+// (one per core) and ParallelFor calls task(k) for every k in [0, n_tasks),
+// handing the indices out to up to n_threads threads as they become free.
+// The calling thread does part of the work and the method returns once every
+// task is done.  With n_threads <= 1, the tasks run serially in order.
+inline uint32_t DefaultThreads() {
+  uint32_t n_threads = std::thread::hardware_concurrency();
+  return n_threads > 0 ? n_threads : 1;
+}
+
+template <typename Function>
+void ParallelFor(uint32_t n_tasks, uint32_t n_threads, Function task) {
+  if (n_threads > n_tasks) n_threads = n_tasks;
+  if (n_threads <= 1) {
+    for (uint32_t k=0;k<n_tasks;k++) task(k);
+    return;
+  }
+
+  std::atomic<uint32_t> next_task(0);
+  auto worker = [&]() {
+    for (uint32_t k=next_task++;k<n_tasks;k=next_task++) task(k);
+  };
+
+  std::vector<std::thread> threads;
+  threads.reserve(n_threads - 1);
+  for (uint32_t i=1;i<n_threads;i++) threads.push_back(std::thread(worker));
+  worker();
+  for (uint32_t i=0;i<threads.size();i++) threads[i].join();
+}
+
 }  // end namespace Stomp
 
 #endif  // STOMP_STOMP_CORE_H_
@@ -25,12 +25,17 @@
 #include "stomp_pixel.h"
 #include "stomp_angular_coordinate.h"
 #include "stomp_geometry.h"
+#include "stomp_point_catalog.h"
+#include "stomp_instrumentation.h"
 
 namespace Stomp {
 
-GeometricBound::GeometricBound() {
+// Seeding the random number generator reads from /dev/urandom, which costs
+// far more than the rest of setting up a bound, so we put it off until the
+// first random point is requested.
+GeometricBound::GeometricBound() : mtrand_(1) {
   set_bounds_ = false;
-  mtrand_.seed();
+  seeded_ = false;
   FindArea();
   FindAngularBounds();
 }
@@ -54,164 +59,134 @@ bool GeometricBound::FindArea() {
   return HPixArea*MaxSuperpixnum;
 }
 
-bool GeometricBound::CheckPixel(Pixel& pix) {
-  double inv_nx = 1.0/static_cast<double>(Nx0*pix.Resolution());
-  double inv_ny = 1.0/static_cast<double>(Ny0*pix.Resolution());
-  double x = static_cast<double>(pix.PixelX());
-  double y = static_cast<double>(pix.PixelY());
+bool GeometricBound::BoundingCap(AngularCoordinate& center, double& radius) {
+  return false;
+}
 
-  double lammid = 90.0 - RadToDeg*acos(1.0-2.0*(y+0.5)*inv_ny);
-  double lammin = 90.0 - RadToDeg*acos(1.0-2.0*(y+1.0)*inv_ny);
-  double lammax = 90.0 - RadToDeg*acos(1.0-2.0*(y+0.0)*inv_ny);
-  double lam_quart = 90.0 - RadToDeg*acos(1.0-2.0*(y+0.75)*inv_ny);
-  double lam_three = 90.0 - RadToDeg*acos(1.0-2.0*(y+0.25)*inv_ny);
+uint32_t GeometricBound::CheckPoints(const double* x, const double* y,
+				     const double* z, uint32_t n_points,
+				     uint8_t* inside) {
+  uint32_t n_inside = 0;
+  AngularCoordinate ang;
+  for (uint32_t i=0;i<n_points;i++) {
+    ang.SetUnitSphereCoordinates(x[i], y[i], z[i]);
+    inside[i] = CheckPoint(ang) ? 1 : 0;
+    n_inside += inside[i];
+  }
 
-  double etamid = RadToDeg*(2.0*Pi*(x+0.5))*inv_nx + EtaOffSet;
-  if (DoubleGE(etamid, 180.0)) etamid -= 360.0;
-  if (DoubleLE(etamid, -180.0)) etamid += 360.0;
+  return n_inside;
+}
 
-  double etamin = RadToDeg*(2.0*Pi*(x+0.0))*inv_nx + EtaOffSet;
-  if (DoubleGE(etamin, 180.0)) etamin -= 360.0;
-  if (DoubleLE(etamin, -180.0)) etamin += 360.0;
+uint32_t GeometricBound::CheckPoints(PointCatalog& catalog,
+				     std::vector<uint8_t>& inside,
+				     uint32_t n_threads) {
+  uint32_t n_point = catalog.Size();
+  inside.assign(n_point, 0);
+  if (n_point == 0) return 0;
 
-  double etamax = RadToDeg*(2.0*Pi*(x+1.0))*inv_nx + EtaOffSet;
-  if (DoubleGE(etamax, 180.0)) etamax -= 360.0;
-  if (DoubleLE(etamax, -180.0)) etamax += 360.0;
+  double* x = catalog.XColumn();
+  double* y = catalog.YColumn();
+  double* z = catalog.ZColumn();
+  const uint32_t block_size = 4096;
+  uint32_t n_block = (n_point + block_size - 1)/block_size;
+  std::vector<uint32_t> n_inside(n_block, 0);
+  ParallelFor(n_block, n_threads, [&](uint32_t block) {
+    uint32_t start = block*block_size;
+    uint32_t n_check = n_point - start;
+    if (n_check > block_size) n_check = block_size;
+    n_inside[block] = CheckPoints(x + start, y + start, z + start, n_check,
+				  &inside[start]);
+  });
 
-  double eta_quart = RadToDeg*(2.0*Pi*(x+0.25))*inv_nx + EtaOffSet;
-  if (DoubleGE(eta_quart, 180.0)) eta_quart -= 360.0;
-  if (DoubleLE(eta_quart, -180.0)) eta_quart += 360.0;
-
-  double eta_three = RadToDeg*(2.0*Pi*(x+0.75))*inv_nx + EtaOffSet;
-  if (DoubleGE(eta_three, 180.0)) eta_three -= 360.0;
-  if (DoubleLE(eta_three, -180.0)) eta_three += 360.0;
+  uint32_t n_total = 0;
+  for (uint32_t block=0;block<n_block;block++) n_total += n_inside[block];
 
-  bool within_bound = false;
+  return n_total;
+}
 
-  AngularCoordinate ang(lammid, etamid, AngularCoordinate::Survey);
-  if (CheckPoint(ang)) within_bound = true;
-
-  if (!within_bound) {
-    ang.SetSurveyCoordinates(lam_quart,etamid);
-    if (CheckPoint(ang)) within_bound = true;
-    ang.SetSurveyCoordinates(lam_three,etamid);
-    if (CheckPoint(ang)) within_bound = true;
-    ang.SetSurveyCoordinates(lammid,eta_quart);
-    if (CheckPoint(ang)) within_bound = true;
-    ang.SetSurveyCoordinates(lammid,eta_quart);
-    if (CheckPoint(ang)) within_bound = true;
-  }
+bool GeometricBound::CheckPixel(Pixel& pix) {
+  double x[NPixelTestPoints], y[NPixelTestPoints], z[NPixelTestPoints];
+  uint8_t inside[NPixelTestPoints];
+  _PixelTestPoints(pix, x, y, z);
 
-  if (!within_bound) {
-    ang.SetSurveyCoordinates(lam_quart,eta_quart);
-    if (CheckPoint(ang)) within_bound = true;
-    ang.SetSurveyCoordinates(lam_three,eta_quart);
-    if (CheckPoint(ang)) within_bound = true;
-    ang.SetSurveyCoordinates(lam_quart,eta_three);
-    if (CheckPoint(ang)) within_bound = true;
-    ang.SetSurveyCoordinates(lam_three,eta_three);
-    if (CheckPoint(ang)) within_bound = true;
-  }
+  return (CheckPoints(x, y, z, NPixelTestPoints, inside) > 0 ? true : false);
+}
 
-  if (!within_bound) {
-    ang.SetSurveyCoordinates(lammid,etamax);
-    if (CheckPoint(ang)) within_bound = true;
-    ang.SetSurveyCoordinates(lammid,etamin);
-    if (CheckPoint(ang)) within_bound = true;
-    ang.SetSurveyCoordinates(lammax,etamid);
-    if (CheckPoint(ang)) within_bound = true;
-    ang.SetSurveyCoordinates(lammin,etamid);
-    if (CheckPoint(ang)) within_bound = true;
-  }
+double GeometricBound::ScorePixel(Pixel& pix) {
+  // The center of the pixel counts for the most, followed by the points
+  // half-way to the edges, the middles of the edges and then the corners.
+  static const double point_score[NPixelTestPoints] = {
+    4.0, 3.0, 3.0, 3.0, 3.0, 3.0, 3.0, 3.0, 3.0,
+    2.0, 2.0, 2.0, 2.0, 1.0, 1.0, 1.0, 1.0
+  };
+
+  double x[NPixelTestPoints], y[NPixelTestPoints], z[NPixelTestPoints];
+  uint8_t inside[NPixelTestPoints];
+  _PixelTestPoints(pix, x, y, z);
+  CheckPoints(x, y, z, NPixelTestPoints, inside);
 
-  if (!within_bound) {
-    ang.SetSurveyCoordinates(lammax,etamax);
-    if (CheckPoint(ang)) within_bound = true;
-    ang.SetSurveyCoordinates(lammax,etamin);
-    if (CheckPoint(ang)) within_bound = true;
-    ang.SetSurveyCoordinates(lammin,etamax);
-    if (CheckPoint(ang)) within_bound = true;
-    ang.SetSurveyCoordinates(lammin,etamin);
-    if (CheckPoint(ang)) within_bound = true;
-  }
+  double score = 0.0;
+  for (uint32_t k=0;k<NPixelTestPoints;k++)
+    if (inside[k] == 1) score -= point_score[k];
 
-  return within_bound;
+  return score/40.0;
 }
 
-double GeometricBound::ScorePixel(Pixel& pix) {
+void GeometricBound::_PixelTestPoints(Pixel& pix, double* x, double* y,
+				      double* z) {
   double inv_nx = 1.0/static_cast<double>(Nx0*pix.Resolution());
   double inv_ny = 1.0/static_cast<double>(Ny0*pix.Resolution());
-  double x = static_cast<double>(pix.PixelX());
-  double y = static_cast<double>(pix.PixelY());
+  double pix_x = static_cast<double>(pix.PixelX());
+  double pix_y = static_cast<double>(pix.PixelY());
 
-  double lammid = 90.0 - RadToDeg*acos(1.0-2.0*(y+0.5)*inv_ny);
-  double lammin = 90.0 - RadToDeg*acos(1.0-2.0*(y+1.0)*inv_ny);
-  double lammax = 90.0 - RadToDeg*acos(1.0-2.0*(y+0.0)*inv_ny);
-  double lam_quart = 90.0 - RadToDeg*acos(1.0-2.0*(y+0.75)*inv_ny);
-  double lam_three = 90.0 - RadToDeg*acos(1.0-2.0*(y+0.25)*inv_ny);
+  double lammid = 90.0 - RadToDeg*acos(1.0-2.0*(pix_y+0.5)*inv_ny);
+  double lammin = 90.0 - RadToDeg*acos(1.0-2.0*(pix_y+1.0)*inv_ny);
+  double lammax = 90.0 - RadToDeg*acos(1.0-2.0*(pix_y+0.0)*inv_ny);
+  double lam_quart = 90.0 - RadToDeg*acos(1.0-2.0*(pix_y+0.75)*inv_ny);
+  double lam_three = 90.0 - RadToDeg*acos(1.0-2.0*(pix_y+0.25)*inv_ny);
 
-  double etamid = RadToDeg*(2.0*Pi*(x+0.5))*inv_nx + EtaOffSet;
+  double etamid = RadToDeg*(2.0*Pi*(pix_x+0.5))*inv_nx + EtaOffSet;
   if (DoubleGE(etamid, 180.0)) etamid -= 360.0;
   if (DoubleLE(etamid, -180.0)) etamid += 360.0;
 
-  double etamin = RadToDeg*(2.0*Pi*(x+0.0))*inv_nx + EtaOffSet;
+  double etamin = RadToDeg*(2.0*Pi*(pix_x+0.0))*inv_nx + EtaOffSet;
   if (DoubleGE(etamin, 180.0)) etamin -= 360.0;
   if (DoubleLE(etamin, -180.0)) etamin += 360.0;
 
-  double etamax = RadToDeg*(2.0*Pi*(x+1.0))*inv_nx + EtaOffSet;
+  double etamax = RadToDeg*(2.0*Pi*(pix_x+1.0))*inv_nx + EtaOffSet;
   if (DoubleGE(etamax, 180.0)) etamax -= 360.0;
   if (DoubleLE(etamax, -180.0)) etamax += 360.0;
 
-  double eta_quart = RadToDeg*(2.0*Pi*(x+0.25))*inv_nx + EtaOffSet;
+  double eta_quart = RadToDeg*(2.0*Pi*(pix_x+0.25))*inv_nx + EtaOffSet;
   if (DoubleGE(eta_quart, 180.0)) eta_quart -= 360.0;
   if (DoubleLE(eta_quart, -180.0)) eta_quart += 360.0;
 
-  double eta_three = RadToDeg*(2.0*Pi*(x+0.75))*inv_nx + EtaOffSet;
+  double eta_three = RadToDeg*(2.0*Pi*(pix_x+0.75))*inv_nx + EtaOffSet;
   if (DoubleGE(eta_three, 180.0)) eta_three -= 360.0;
   if (DoubleLE(eta_three, -180.0)) eta_three += 360.0;
 
-  double score = 0.0;
-
-  AngularCoordinate ang(lammid, etamid, AngularCoordinate::Survey);
-  if (CheckPoint(ang)) score -= 4.0;
-
-  ang.SetSurveyCoordinates(lam_quart,etamid);
-  if (CheckPoint(ang)) score -= 3.0;
-  ang.SetSurveyCoordinates(lam_three,etamid);
-  if (CheckPoint(ang)) score -= 3.0;
-  ang.SetSurveyCoordinates(lammid,eta_quart);
-  if (CheckPoint(ang)) score -= 3.0;
-  ang.SetSurveyCoordinates(lammid,eta_quart);
-  if (CheckPoint(ang)) score -= 3.0;
-
-  ang.SetSurveyCoordinates(lam_quart,eta_quart);
-  if (CheckPoint(ang)) score -= 3.0;
-  ang.SetSurveyCoordinates(lam_three,eta_quart);
-  if (CheckPoint(ang)) score -= 3.0;
-  ang.SetSurveyCoordinates(lam_quart,eta_three);
-  if (CheckPoint(ang)) score -= 3.0;
-  ang.SetSurveyCoordinates(lam_three,eta_three);
-  if (CheckPoint(ang)) score -= 3.0;
-
-  ang.SetSurveyCoordinates(lammid,etamax);
-  if (CheckPoint(ang)) score -= 2.0;
-  ang.SetSurveyCoordinates(lammid,etamin);
-  if (CheckPoint(ang)) score -= 2.0;
-  ang.SetSurveyCoordinates(lammax,etamid);
-  if (CheckPoint(ang)) score -= 2.0;
-  ang.SetSurveyCoordinates(lammin,etamid);
-  if (CheckPoint(ang)) score -= 2.0;
-
-  ang.SetSurveyCoordinates(lammax,etamax);
-  if (CheckPoint(ang)) score -= 1.0;
-  ang.SetSurveyCoordinates(lammax,etamin);
-  if (CheckPoint(ang)) score -= 1.0;
-  ang.SetSurveyCoordinates(lammin,etamax);
-  if (CheckPoint(ang)) score -= 1.0;
-  ang.SetSurveyCoordinates(lammin,etamin);
-  if (CheckPoint(ang)) score -= 1.0;
-
-  return score/40.0;
+  double lambda[NPixelTestPoints] = {
+    lammid,
+    lam_quart, lam_three, lammid, lammid,
+    lam_quart, lam_three, lam_quart, lam_three,
+    lammid, lammid, lammax, lammin,
+    lammax, lammax, lammin, lammin
+  };
+  double eta[NPixelTestPoints] = {
+    etamid,
+    etamid, etamid, eta_quart, eta_quart,
+    eta_quart, eta_quart, eta_three, eta_three,
+    etamax, etamin, etamid, etamid,
+    etamax, etamin, etamax, etamin
+  };
+
+  AngularCoordinate ang;
+  for (uint32_t k=0;k<NPixelTestPoints;k++) {
+    ang.SetSurveyCoordinates(lambda[k], eta[k]);
+    x[k] = ang.UnitSphereX();
+    y[k] = ang.UnitSphereY();
+    z[k] = ang.UnitSphereZ();
+  }
 }
 
 void GeometricBound::SetArea(double input_area) {
@@ -259,6 +234,11 @@ bool GeometricBound::ContinuousBounds() {
 }
 
 void GeometricBound::GenerateRandomPoint(AngularCoordinate& ang) {
+  if (!seeded_) {
+    mtrand_.seed();
+    seeded_ = true;
+  }
+
   bool keep = false;
 
   while (!keep) {
@@ -267,7 +247,12 @@ void GeometricBound::GenerateRandomPoint(AngularCoordinate& ang) {
     double eta = etamin_ + mtrand_.rand(etamax_ - etamin_);
     ang.SetSurveyCoordinates(lambda, eta);
 
-    if (CheckPoint(ang)) keep = true;
+    if (CheckPoint(ang)) {
+      keep = true;
+      STOMP_COUNT(RandomPointsGenerated);
+    } else {
+      STOMP_COUNT(RandomPointsRejected);
+    }
   }
 
 }
@@ -277,19 +262,42 @@ void GeometricBound::GenerateRandomPoints(AngularVector& angVec,
   if (!angVec.empty()) angVec.clear();
   angVec.reserve(n_rand);
 
-  bool keep = false;
-  AngularCoordinate tmp_ang(0.0,0.0);
+  if (!seeded_) {
+    mtrand_.seed();
+    seeded_ = true;
+  }
 
-  for (uint32_t i=0;i<n_rand;i++) {
-    while (!keep) {
-      double z = z_min_ + mtrand_.rand(z_max_ - z_min_);
-      double lambda = asin(z)*RadToDeg;
+  // Draw the candidate points in batches so that they can be checked against
+  // the bound all at once.  The candidates are drawn in the same order as in
+  // GenerateRandomPoint, so the points are the same as calling that n_rand
+  // times.
+  const uint32_t batch_size = 1024;
+  std::vector<double> x(batch_size), y(batch_size), z(batch_size);
+  std::vector<uint8_t> inside(batch_size);
+  AngularVector candidate_ang(batch_size);
+
+  while (angVec.size() < n_rand) {
+    for (uint32_t i=0;i<batch_size;i++) {
+      double z_rand = z_min_ + mtrand_.rand(z_max_ - z_min_);
+      double lambda = asin(z_rand)*RadToDeg;
       double eta = etamin_ + mtrand_.rand(etamax_ - etamin_);
 
-      tmp_ang.SetSurveyCoordinates(lambda, eta);
-      if (CheckPoint(tmp_ang)) keep = true;
+      candidate_ang[i].SetSurveyCoordinates(lambda, eta);
+      x[i] = candidate_ang[i].UnitSphereX();
+      y[i] = candidate_ang[i].UnitSphereY();
+      z[i] = candidate_ang[i].UnitSphereZ();
+    }
+
+    CheckPoints(&x[0], &y[0], &z[0], batch_size, &inside[0]);
+
+    for (uint32_t i=0;i<batch_size && angVec.size()<n_rand;i++) {
+      if (inside[i] == 1) {
+	angVec.push_back(candidate_ang[i]);
+	STOMP_COUNT(RandomPointsGenerated);
+      } else {
+	STOMP_COUNT(RandomPointsRejected);
+      }
     }
-    angVec.push_back(tmp_ang);
   }
 }
 
@@ -338,10 +346,36 @@ bool CircleBound::FindArea() {
   return true;
 }
 
+bool CircleBound::BoundingCap(AngularCoordinate& center, double& radius) {
+  center = center_point_;
+  radius = radius_;
+  return true;
+}
+
 bool CircleBound::CheckPoint(AngularCoordinate& ang) {
   return (DoubleGE(center_point_.DotProduct(ang), costhetamin_) ? true : false);
 }
 
+uint32_t CircleBound::CheckPoints(const double* x, const double* y,
+				  const double* z, uint32_t n_points,
+				  uint8_t* inside) {
+  // The same test as CheckPoint, including the DoubleGE tolerance, written
+  // out so that the loop vectorizes.
+  double center_x = center_point_.UnitSphereX();
+  double center_y = center_point_.UnitSphereY();
+  double center_z = center_point_.UnitSphereZ();
+  double min_dot = costhetamin_ - 1.0e-15;
+
+  uint32_t n_inside = 0;
+  for (uint32_t i=0;i<n_points;i++) {
+    double dot = center_x*x[i] + center_y*y[i] + center_z*z[i];
+    inside[i] = (dot >= min_dot ? 1 : 0);
+    n_inside += inside[i];
+  }
+
+  return n_inside;
+}
+
 AnnulusBound::AnnulusBound(const AngularCoordinate& center_point,
 			   double min_radius, double max_radius) {
   center_point_ = center_point;
@@ -412,11 +446,36 @@ bool AnnulusBound::FindArea() {
   return true;
 }
 
+bool AnnulusBound::BoundingCap(AngularCoordinate& center, double& radius) {
+  center = center_point_;
+  radius = max_radius_;
+  return true;
+}
+
 bool AnnulusBound::CheckPoint(AngularCoordinate& ang) {
   return (DoubleLE(center_point_.DotProduct(ang), costhetamax_) &&
 	  DoubleGE(center_point_.DotProduct(ang), costhetamin_) ? true : false);
 }
 
+uint32_t AnnulusBound::CheckPoints(const double* x, const double* y,
+				   const double* z, uint32_t n_points,
+				   uint8_t* inside) {
+  double center_x = center_point_.UnitSphereX();
+  double center_y = center_point_.UnitSphereY();
+  double center_z = center_point_.UnitSphereZ();
+  double min_dot = costhetamin_ - 1.0e-15;
+  double max_dot = costhetamax_ + 1.0e-15;
+
+  uint32_t n_inside = 0;
+  for (uint32_t i=0;i<n_points;i++) {
+    double dot = center_x*x[i] + center_y*y[i] + center_z*z[i];
+    inside[i] = ((dot <= max_dot) & (dot >= min_dot) ? 1 : 0);
+    n_inside += inside[i];
+  }
+
+  return n_inside;
+}
+
 WedgeBound::WedgeBound(const AngularCoordinate& center_point, double radius,
 		       double position_angle_min, double position_angle_max,
 		       AngularCoordinate::Sphere sphere) {
@@ -525,6 +584,12 @@ bool WedgeBound::FindArea() {
   return true;
 }
 
+bool WedgeBound::BoundingCap(AngularCoordinate& center, double& radius) {
+  center = center_point_;
+  radius = radius_;
+  return true;
+}
+
 bool WedgeBound::CheckPoint(AngularCoordinate& ang) {
   bool within_bound = false;
 
@@ -642,6 +707,34 @@ bool PolygonBound::FindArea() {
   return true;
 }
 
+bool PolygonBound::BoundingCap(AngularCoordinate& center, double& radius) {
+  // The polygon is convex, so a cap around the mean of the vertices that
+  // reaches the farthest vertex contains all of it, provided that the cap
+  // is smaller than a hemisphere.
+  if (n_vert_ == 0) return false;
+
+  double mean_x = 0.0, mean_y = 0.0, mean_z = 0.0;
+  for (uint32_t i=0;i<n_vert_;i++) {
+    mean_x += ang_[i].UnitSphereX();
+    mean_y += ang_[i].UnitSphereY();
+    mean_z += ang_[i].UnitSphereZ();
+  }
+  if (DoubleLE(mean_x*mean_x + mean_y*mean_y + mean_z*mean_z, 0.0))
+    return false;
+  center.SetUnitSphereCoordinates(mean_x, mean_y, mean_z);
+
+  double min_dot = 1.0;
+  for (uint32_t i=0;i<n_vert_;i++) {
+    double dot = center.DotProduct(ang_[i]);
+    if (dot < min_dot) min_dot = dot;
+  }
+  if (DoubleLE(min_dot, 0.0)) return false;
+  if (min_dot > 1.0) min_dot = 1.0;
+  radius = acos(min_dot)*RadToDeg;
+
+  return true;
+}
+
 bool PolygonBound::CheckPoint(AngularCoordinate& ang) {
   bool in_polygon = true;
 
@@ -662,6 +755,57 @@ bool PolygonBound::CheckPoint(AngularCoordinate& ang) {
   return in_polygon;
 }
 
+uint32_t PolygonBound::CheckPoints(const double* x, const double* y,
+				   const double* z, uint32_t n_points,
+				   uint8_t* inside) {
+  // Rather than running through the edges for one point at a time, we take
+  // the points in blocks small enough to stay in cache and test the whole
+  // block against each edge in turn.  The inner loops have no branches, so
+  // they vectorize, and once every point in a block has failed one of the
+  // edges we can skip the rest of them.  The comparisons are the same as in
+  // CheckPoint, tolerance and all.
+  const uint32_t block_size = 256;
+
+  uint32_t n_inside = 0;
+  for (uint32_t start=0;start<n_points;start+=block_size) {
+    uint32_t n_block = n_points - start;
+    if (n_block > block_size) n_block = block_size;
+    const double* block_x = x + start;
+    const double* block_y = y + start;
+    const double* block_z = z + start;
+    uint8_t* block_inside = inside + start;
+
+    for (uint32_t i=0;i<n_block;i++) block_inside[i] = 1;
+
+    for (uint32_t n=0;n<n_vert_;n++) {
+      double edge_x = x_[n], edge_y = y_[n], edge_z = z_[n];
+      uint8_t any_inside = 0;
+      if (DoubleLE(dot_[n], 0.0)) {
+	double edge_dot = fabs(dot_[n]);
+	for (uint32_t i=0;i<n_block;i++) {
+	  double dot = 1.0 - edge_x*block_x[i] - edge_y*block_y[i] -
+	    edge_z*block_z[i];
+	  block_inside[i] &= (edge_dot <= dot + 1.0e-15 ? 1 : 0);
+	  any_inside |= block_inside[i];
+	}
+      } else {
+	double edge_dot = dot_[n];
+	for (uint32_t i=0;i<n_block;i++) {
+	  double dot = 1.0 - edge_x*block_x[i] - edge_y*block_y[i] -
+	    edge_z*block_z[i];
+	  block_inside[i] &= (edge_dot >= dot - 1.0e-15 ? 1 : 0);
+	  any_inside |= block_inside[i];
+	}
+      }
+      if (any_inside == 0) break;
+    }
+
+    for (uint32_t i=0;i<n_block;i++) n_inside += block_inside[i];
+  }
+
+  return n_inside;
+}
+
 LongitudeBound::LongitudeBound(double min_longitude, double max_longitude,
 			       AngularCoordinate::Sphere sphere) {
   // Cast the input values into AngularCoordinate objects to handle vagaries
@@ -26,6 +26,7 @@
 #include <math.h>
 #include <vector>
 #include <algorithm>
+#include "stomp_core.h"
 #include "stomp_angular_coordinate.h"
 #include "stomp_angular_bin.h"
 #include "MersenneTwister.h"
@@ -34,6 +35,7 @@ namespace Stomp {
 
 class AngularCoordinate;  // class declaration in stomp_angular_coordinate.h
 class AngularBin;         // class declaration in stomp_angular_bin.h
+class PointCatalog;       // class declaration in stomp_point_catalog.h
 class GeometricBound;
 class CircleBound;
 class AnnulusBound;
@@ -98,6 +100,32 @@ class GeometricBound {
   bool CheckPixel(Pixel& pix);
   double ScorePixel(Pixel& pix);
 
+  // CheckPoint works one point at a time, which means a virtual call and a
+  // pass through the bound's parameters for every point.  CheckPoints does
+  // the same test for a whole set of points, given as arrays of unit sphere
+  // coordinates, setting inside[i] to 1 for the points within the bound (0
+  // otherwise) and returning the number of points inside.  The default
+  // version simply calls CheckPoint for each point, but the derived classes
+  // with simple dot product tests (CircleBound, AnnulusBound and
+  // PolygonBound) override it with loops that the compiler can vectorize.
+  // CheckPixel, ScorePixel and GenerateRandomPoints all use it.
+  virtual uint32_t CheckPoints(const double* x, const double* y,
+			       const double* z, uint32_t n_points,
+			       uint8_t* inside);
+
+  // A spherical cap (center and radius in degrees) that contains the whole
+  // bound, for indexing the bound without pixelizing it (see BoundIndex).
+  // Returns false if the bound has no useful cap, in which case it should be
+  // treated as covering the whole sphere.
+  virtual bool BoundingCap(AngularCoordinate& center, double& radius);
+
+  // The PointCatalog version checks every point in the catalog, splitting
+  // the work into blocks on up to n_threads threads, as with
+  // Map::Contains.  The inside vector is resized to match the catalog and
+  // can be passed on to PointCatalog::Select.
+  uint32_t CheckPoints(PointCatalog& catalog, std::vector<uint8_t>& inside,
+		       uint32_t n_threads = DefaultThreads());
+
   // And some simple getters and setters for the values that determine the
   // area and bounds as well as a boolean to indicate whether or not the eta
   // bounds are continuous across the eta discontinuity.  We need the setters
@@ -123,9 +151,15 @@ class GeometricBound {
   void GenerateRandomPoints(AngularVector& angVec, uint32_t n_rand);
 
  private:
+  // The points within a pixel that CheckPixel and ScorePixel test against
+  // the bound: the center, the points half-way to the edges, the middles of
+  // the edges and the corners.
+  static const uint32_t NPixelTestPoints = 17;
+  void _PixelTestPoints(Pixel& pix, double* x, double* y, double* z);
+
   MTRand mtrand_;
   double area_, lammin_, lammax_, etamin_, etamax_, z_min_, z_max_;
-  bool continuous_bounds_, set_bounds_;
+  bool continuous_bounds_, set_bounds_, seeded_;
 };
 
 class CircleBound : public GeometricBound {
@@ -137,8 +171,13 @@ class CircleBound : public GeometricBound {
   CircleBound(const AngularCoordinate& center_point, double radius);
   virtual ~CircleBound();
   virtual bool CheckPoint(AngularCoordinate& ang);
+  virtual uint32_t CheckPoints(const double* x, const double* y,
+			       const double* z, uint32_t n_points,
+			       uint8_t* inside);
+  using GeometricBound::CheckPoints;
   virtual bool FindAngularBounds();
   virtual bool FindArea();
+  virtual bool BoundingCap(AngularCoordinate& center, double& radius);
 
  private:
   AngularCoordinate center_point_;
@@ -157,8 +196,13 @@ class AnnulusBound : public GeometricBound {
 	       AngularBin& angular_bin);
   virtual ~AnnulusBound();
   virtual bool CheckPoint(AngularCoordinate& ang);
+  virtual uint32_t CheckPoints(const double* x, const double* y,
+			       const double* z, uint32_t n_points,
+			       uint8_t* inside);
+  using GeometricBound::CheckPoints;
   virtual bool FindAngularBounds();
   virtual bool FindArea();
+  virtual bool BoundingCap(AngularCoordinate& center, double& radius);
 
  private:
   AngularCoordinate center_point_;
@@ -178,6 +222,7 @@ class WedgeBound : public GeometricBound {
   virtual bool CheckPoint(AngularCoordinate& ang);
   virtual bool FindAngularBounds();
   virtual bool FindArea();
+  virtual bool BoundingCap(AngularCoordinate& center, double& radius);
 
  private:
   AngularCoordinate center_point_;
@@ -198,8 +243,13 @@ class PolygonBound : public GeometricBound {
   PolygonBound(AngularVector& ang);
   virtual ~PolygonBound();
   virtual bool CheckPoint(AngularCoordinate& ang);
+  virtual uint32_t CheckPoints(const double* x, const double* y,
+			       const double* z, uint32_t n_points,
+			       uint8_t* inside);
+  using GeometricBound::CheckPoints;
   virtual bool FindAngularBounds();
   virtual bool FindArea();
+  virtual bool BoundingCap(AngularCoordinate& center, double& radius);
 
  private:
   AngularVector ang_;
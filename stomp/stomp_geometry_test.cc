@@ -2,10 +2,12 @@
 #include <iostream>
 #include <math.h>
 #include <string>
+#include <vector>
 #include <gflags/gflags.h>
 #include "stomp_core.h"
 #include "stomp_angular_coordinate.h"
 #include "stomp_geometry.h"
+#include "stomp_point_catalog.h"
 
 void CircleBoundTests() {
   // Testing the CircleBound class
@@ -286,6 +288,74 @@ void LatLonBoundTests() {
   }
 }
 
+void BoundCheckPointsTests() {
+  // Check the batch CheckPoints methods against CheckPoint for each of the
+  // bounds that override it, as well as one that doesn't.
+  std::cout << "\n";
+  std::cout << "*********************************\n";
+  std::cout << "*** GeometricBound CheckPoints ***\n";
+  std::cout << "*********************************\n";
+
+  Stomp::AngularCoordinate center(20.0, 0.0, Stomp::AngularCoordinate::Survey);
+  Stomp::CircleBound circle(center, 2.0);
+  Stomp::AnnulusBound annulus(center, 1.0, 2.0);
+  Stomp::WedgeBound wedge(center, 2.0, 30.0, 120.0);
+
+  // A polygon with a few hundred vertices, roughly circular.
+  Stomp::AngularVector vertices;
+  for (uint32_t i=0;i<360;i++) {
+    double position_angle = i*Stomp::DegToRad;
+    Stomp::AngularCoordinate vertex(20.0 + 2.0*cos(position_angle),
+				    2.0*sin(position_angle),
+				    Stomp::AngularCoordinate::Survey);
+    vertices.push_back(vertex);
+  }
+  Stomp::PolygonBound polygon(vertices);
+
+  Stomp::CircleBound big_circle(center, 3.0);
+  Stomp::AngularVector rand_ang;
+  big_circle.GenerateRandomPoints(rand_ang, 50000);
+  Stomp::PointCatalog catalog(rand_ang);
+
+  std::vector<Stomp::GeometricBound*> bounds;
+  std::vector<std::string> bound_names;
+  bounds.push_back(&circle);
+  bound_names.push_back("CircleBound");
+  bounds.push_back(&annulus);
+  bound_names.push_back("AnnulusBound");
+  bounds.push_back(&polygon);
+  bound_names.push_back("PolygonBound");
+  bounds.push_back(&wedge);
+  bound_names.push_back("WedgeBound");
+
+  for (uint32_t k=0;k<bounds.size();k++) {
+    std::vector<uint8_t> inside;
+    uint32_t n_inside = bounds[k]->CheckPoints(catalog, inside);
+    uint32_t n_mismatch = 0;
+    uint32_t n_check = 0;
+    for (uint32_t i=0;i<rand_ang.size();i++) {
+      bool check_point = bounds[k]->CheckPoint(rand_ang[i]);
+      if (check_point) n_check++;
+      if (check_point != (inside[i] == 1)) n_mismatch++;
+    }
+    std::cout << "\t" << bound_names[k] << ": " << n_inside << " (" <<
+      n_check << ") points inside, " << n_mismatch << " mismatched\n";
+  }
+
+  // Each of the random points should be distinct and inside the bound.
+  Stomp::AngularVector polygon_ang;
+  polygon.GenerateRandomPoints(polygon_ang, 1000);
+  uint32_t n_outside = 0, n_repeat = 0;
+  for (uint32_t i=0;i<polygon_ang.size();i++) {
+    if (!polygon.CheckPoint(polygon_ang[i])) n_outside++;
+    if ((i > 0) &&
+	(polygon_ang[i].UnitSphereX() == polygon_ang[i-1].UnitSphereX()))
+      n_repeat++;
+  }
+  std::cout << "\tGenerateRandomPoints: " << polygon_ang.size() <<
+    " points, " << n_outside << " outside, " << n_repeat << " repeated\n";
+}
+
 // Define our command line flags
 DEFINE_bool(all_geometry_tests, false, "Run all class unit tests.");
 DEFINE_bool(circle_bound_tests, false, "Run CircleBound tests");
@@ -293,6 +363,8 @@ DEFINE_bool(annulus_bound_tests, false, "Run AnnulusBound tests");
 DEFINE_bool(wedge_bound_tests, false, "Run WedgeBound tests");
 DEFINE_bool(polygon_bound_tests, false, "Run PolygonBound tests");
 DEFINE_bool(latlon_bound_tests, false, "Run LatLonBound tests");
+DEFINE_bool(bound_check_points_tests, false,
+            "Run GeometricBound CheckPoints tests");
 
 void GeometryUnitTests(bool run_all_tests) {
   void CircleBoundTests();
@@ -300,6 +372,7 @@ void GeometryUnitTests(bool run_all_tests) {
   void WedgeBoundTests();
   void PolygonBoundTests();
   void LatLonBoundTests();
+  void BoundCheckPointsTests();
 
   if (run_all_tests) FLAGS_all_geometry_tests = true;
 
@@ -322,4 +395,8 @@ void GeometryUnitTests(bool run_all_tests) {
   // Check the LatLonBound class.
   if (FLAGS_all_geometry_tests || FLAGS_latlon_bound_tests)
     LatLonBoundTests();
+
+  // Check the batch GeometricBound::CheckPoints methods.
+  if (FLAGS_all_geometry_tests || FLAGS_bound_check_points_tests)
+    BoundCheckPointsTests();
 }
@@ -0,0 +1,232 @@
+// Copyright 2010  All Rights Reserved.
+// Author: ryan.scranton@gmail.com (Ryan Scranton)
+
+// STOMP is a set of libraries for doing astrostatistical analysis on the
+// celestial sphere.  The goal is to enable descriptions of arbitrary regions
+// on the sky which may or may not encode futher spatial information (galaxy
+// density, CMB temperature, observational depth, etc.) and to do so in such
+// a way as to make the analysis of that data as algorithmically efficient as
+// possible.
+//
+// This file contains the implementation of the Instrumentation and
+// ScopedTimer classes.  See stomp_instrumentation.h for the details.
+
+#include <stdint.h>
+#include <atomic>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "stomp_core.h"
+#include "stomp_util.h"
+#include "stomp_instrumentation.h"
+
+namespace Stomp {
+
+namespace {
+
+// The per-thread counters.  Only the owning thread ever writes to a block,
+// so the increments don't need to be atomic read-modify-writes; the atomics
+// are just there so that Count can read them safely from another thread.
+struct CounterBlock {
+  CounterBlock();
+  ~CounterBlock();
+  std::atomic<uint64_t> count[Instrumentation::NCounters];
+};
+
+struct TimerTotal {
+  uint64_t calls;
+  double seconds;
+};
+
+// The list of live CounterBlocks, the counts from threads that have already
+// exited and the timers.  This is allocated once and never freed so that
+// threads exiting during static destruction still have somewhere to put
+// their counts.
+struct Registry {
+  std::mutex mutex;
+  std::vector<CounterBlock*> blocks;
+  uint64_t retired[Instrumentation::NCounters];
+  std::map<std::string, TimerTotal> timers;
+};
+
+Registry& GetRegistry() {
+  static Registry* registry = new Registry();
+  return *registry;
+}
+
+CounterBlock::CounterBlock() {
+  for (uint32_t i=0;i<Instrumentation::NCounters;i++) count[i].store(0);
+  Registry& registry = GetRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  registry.blocks.push_back(this);
+}
+
+CounterBlock::~CounterBlock() {
+  Registry& registry = GetRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  for (uint32_t i=0;i<Instrumentation::NCounters;i++)
+    registry.retired[i] += count[i].load();
+  registry.blocks.erase(std::find(registry.blocks.begin(),
+				  registry.blocks.end(), this));
+}
+
+thread_local CounterBlock thread_counters;
+
+const char* const CounterNames[Instrumentation::NCounters] = {
+  "tree_nodes_visited",
+  "leaf_pairs_tested",
+  "annulus_accepted",
+  "annulus_rejected",
+  "annulus_partial",
+  "find_location_probes",
+  "random_points_generated",
+  "random_points_rejected",
+  "bytes_read"
+};
+
+void WriteJSONString(std::ostream& output, const std::string& value) {
+  output << "\"";
+  for (std::string::const_iterator iter=value.begin();
+       iter!=value.end();++iter) {
+    if ((*iter == '"') || (*iter == '\\')) output << "\\";
+    output << *iter;
+  }
+  output << "\"";
+}
+
+} // end anonymous namespace
+
+bool Instrumentation::Enabled() {
+#ifdef WITH_INSTRUMENTATION
+  return true;
+#else
+  return false;
+#endif
+}
+
+void Instrumentation::Add(Counter counter, uint64_t n) {
+  std::atomic<uint64_t>& count = thread_counters.count[counter];
+  count.store(count.load(std::memory_order_relaxed) + n,
+	      std::memory_order_relaxed);
+}
+
+uint64_t Instrumentation::Count(Counter counter) {
+  Registry& registry = GetRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  uint64_t total = registry.retired[counter];
+  for (std::vector<CounterBlock*>::iterator iter=registry.blocks.begin();
+       iter!=registry.blocks.end();++iter)
+    total += (*iter)->count[counter].load(std::memory_order_relaxed);
+  return total;
+}
+
+const char* Instrumentation::CounterName(Counter counter) {
+  return (counter < NCounters ? CounterNames[counter] : "unknown");
+}
+
+void Instrumentation::AddTime(const std::string& timer_name, double seconds) {
+  Registry& registry = GetRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  std::map<std::string, TimerTotal>::iterator iter =
+    registry.timers.find(timer_name);
+  if (iter == registry.timers.end()) {
+    TimerTotal timer;
+    timer.calls = 0;
+    timer.seconds = 0.0;
+    iter = registry.timers.insert(std::make_pair(timer_name, timer)).first;
+  }
+  iter->second.calls++;
+  iter->second.seconds += seconds;
+}
+
+double Instrumentation::Time(const std::string& timer_name) {
+  Registry& registry = GetRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  std::map<std::string, TimerTotal>::iterator iter =
+    registry.timers.find(timer_name);
+  return (iter == registry.timers.end() ? 0.0 : iter->second.seconds);
+}
+
+uint64_t Instrumentation::Calls(const std::string& timer_name) {
+  Registry& registry = GetRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  std::map<std::string, TimerTotal>::iterator iter =
+    registry.timers.find(timer_name);
+  return (iter == registry.timers.end() ? 0 : iter->second.calls);
+}
+
+void Instrumentation::Reset() {
+  // The lock only protects the registry itself; the stores below race with
+  // any thread still counting, hence the no-workers rule in the header.
+  Registry& registry = GetRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  for (uint32_t i=0;i<NCounters;i++) {
+    registry.retired[i] = 0;
+    for (std::vector<CounterBlock*>::iterator iter=registry.blocks.begin();
+	 iter!=registry.blocks.end();++iter)
+      (*iter)->count[i].store(0, std::memory_order_relaxed);
+  }
+  registry.timers.clear();
+}
+
+void Instrumentation::WriteReport(std::ostream& output) {
+  uint64_t counts[NCounters];
+  for (uint32_t i=0;i<NCounters;i++) counts[i] = Count(Counter(i));
+
+  Registry& registry = GetRegistry();
+  std::map<std::string, TimerTotal> timers;
+  {
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    timers = registry.timers;
+  }
+
+  output << "{\n  \"instrumentation\": " <<
+    (Enabled() ? "true" : "false") << ",\n  \"counters\": {";
+  for (uint32_t i=0;i<NCounters;i++) {
+    output << (i == 0 ? "\n" : ",\n") << "    \"" << CounterNames[i] <<
+      "\": " << counts[i];
+  }
+  output << "\n  },\n  \"timers\": {";
+
+  std::streamsize precision = output.precision(9);
+  for (std::map<std::string, TimerTotal>::iterator iter=timers.begin();
+       iter!=timers.end();++iter) {
+    output << (iter == timers.begin() ? "\n    " : ",\n    ");
+    WriteJSONString(output, iter->first);
+    output << ": {\"calls\": " << iter->second.calls <<
+      ", \"seconds\": " << iter->second.seconds << "}";
+  }
+  output.precision(precision);
+  output << (timers.empty() ? "}\n}\n" : "\n  }\n}\n");
+}
+
+bool Instrumentation::WriteReport(const std::string& output_file_name) {
+  std::ofstream output_file(output_file_name.c_str());
+  if (!output_file.is_open()) {
+    std::cout << "Stomp::Instrumentation::WriteReport - " <<
+      "Failed to open " << output_file_name << "\n";
+    return false;
+  }
+
+  WriteReport(output_file);
+  output_file.close();
+
+  return !output_file.fail();
+}
+
+ScopedTimer::ScopedTimer(const char* timer_name) {
+  timer_name_ = timer_name;
+  watch_.StartTimer();
+}
+
+ScopedTimer::~ScopedTimer() {
+  watch_.StopTimer();
+  Instrumentation::AddTime(timer_name_, watch_.ElapsedTime());
+}
+
+} // end namespace Stomp
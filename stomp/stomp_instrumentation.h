@@ -0,0 +1,131 @@
+// Copyright 2010  All Rights Reserved.
+// Author: ryan.scranton@gmail.com (Ryan Scranton)
+
+// STOMP is a set of libraries for doing astrostatistical analysis on the
+// celestial sphere.  The goal is to enable descriptions of arbitrary regions
+// on the sky which may or may not encode futher spatial information (galaxy
+// density, CMB temperature, observational depth, etc.) and to do so in such
+// a way as to make the analysis of that data as algorithmically efficient as
+// possible.
+//
+// This header file contains the Instrumentation and ScopedTimer classes.
+// Choosing the tree resolution, maximum_points or the maximum pixel
+// resolution for a correlation measurement is a matter of knowing where the
+// time actually goes on a given data set: how many tree nodes get visited,
+// how many point pairs get tested directly, how often the annulus test
+// prunes a node and so on.  The library code keeps a running count of those
+// events along with the time spent in the major methods, which can then be
+// written out as a JSON report at the end of a run.
+//
+// None of this is free, so the counting is only compiled in if the library
+// is built with WITH_INSTRUMENTATION defined (configure
+// --enable-instrumentation).  Otherwise the STOMP_COUNT and
+// STOMP_SCOPED_TIMER macros expand to nothing and the report just shows
+// that instrumentation was disabled.
+
+#ifndef STOMP_INSTRUMENTATION_H
+#define STOMP_INSTRUMENTATION_H
+
+#include <stdint.h>
+#include <iostream>
+#include <string>
+#include "stomp_util.h"
+
+namespace Stomp {
+
+class Instrumentation;
+class ScopedTimer;
+
+class Instrumentation {
+  // All of the methods are static; there is one set of counters and timers
+  // for the whole program.  Each thread accumulates its counts separately so
+  // that the counting doesn't serialize the ParallelFor loops; Count and
+  // WriteReport add them all up.  A typical run looks like
+  //
+  //   Instrumentation::Reset();
+  //   wtheta.FindAutoCorrelation(stomp_map, galaxy, n_random);
+  //   Instrumentation::WriteReport("wtheta_profile.json");
+
+ public:
+  enum Counter {
+    TreeNodesVisited,      // TreePixel nodes entered during a pair search
+    LeafPairsTested,       // point pairs checked directly in TreePixel leaves
+    AnnulusAccepted,       // pixels entirely inside an annulus
+    AnnulusRejected,       // pixels entirely outside an annulus
+    AnnulusPartial,        // pixels straddling the edge of an annulus
+    FindLocationProbes,    // Map::FindLocation calls
+    RandomPointsGenerated, // random points accepted by Map or bound samplers
+    RandomPointsRejected,  // candidate random points thrown away
+    BytesRead,             // bytes read from Map and catalog files
+    NCounters
+  };
+
+  // True if the library was built with WITH_INSTRUMENTATION.
+  static bool Enabled();
+
+  // Add to one of the counters.  This is what the STOMP_COUNT macros call.
+  static void Add(Counter counter, uint64_t n = 1);
+
+  // The current total for a counter, summed over all threads.
+  static uint64_t Count(Counter counter);
+
+  // The name used for the counter in the report, e.g. "tree_nodes_visited".
+  static const char* CounterName(Counter counter);
+
+  // Add a call of the given length (in seconds) to a named timer.  This is
+  // what ScopedTimer calls when it goes out of scope.
+  static void AddTime(const std::string& timer_name, double seconds);
+
+  // The total time and number of calls recorded for a named timer.
+  static double Time(const std::string& timer_name);
+  static uint64_t Calls(const std::string& timer_name);
+
+  // Zero all of the counters and timers.  This must only be called while no
+  // worker threads are running (i.e. outside of any ParallelFor): the
+  // per-thread counters are bumped with a plain load and store, so a thread
+  // that's mid-increment can write its old count back over the reset.
+  static void Reset();
+
+  // Write the current counters and timers as a JSON object:
+  //
+  //   {"instrumentation": true,
+  //    "counters": {"tree_nodes_visited": 1234, ...},
+  //    "timers": {"AngularCorrelation::FindPairAutoCorrelation":
+  //               {"calls": 2, "seconds": 12.5}, ...}}
+  //
+  // The file version returns false if the file can't be written.
+  static void WriteReport(std::ostream& output);
+  static bool WriteReport(const std::string& output_file_name);
+};
+
+class ScopedTimer {
+  // Times the enclosing scope with a StompWatch, adding the result to the
+  // named Instrumentation timer when it goes out of scope.  Library code
+  // should use the STOMP_SCOPED_TIMER macro so that the timer disappears
+  // along with the counters when instrumentation is switched off.
+
+ public:
+  ScopedTimer(const char* timer_name);
+  ~ScopedTimer();
+
+ private:
+  const char* timer_name_;
+  StompWatch watch_;
+};
+
+} // end namespace Stomp
+
+#ifdef WITH_INSTRUMENTATION
+#define STOMP_COUNT(counter) \
+  Stomp::Instrumentation::Add(Stomp::Instrumentation::counter)
+#define STOMP_COUNT_N(counter, n) \
+  Stomp::Instrumentation::Add(Stomp::Instrumentation::counter, (n))
+#define STOMP_SCOPED_TIMER(timer_name) \
+  Stomp::ScopedTimer stomp_scoped_timer(timer_name)
+#else
+#define STOMP_COUNT(counter) ((void) 0)
+#define STOMP_COUNT_N(counter, n) ((void) 0)
+#define STOMP_SCOPED_TIMER(timer_name) ((void) 0)
+#endif
+
+#endif
@@ -0,0 +1,138 @@
+#include <stdint.h>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <gflags/gflags.h>
+#include "stomp_core.h"
+#include "stomp_angular_coordinate.h"
+#include "stomp_angular_bin.h"
+#include "stomp_geometry.h"
+#include "stomp_tree_map.h"
+#include "stomp_instrumentation.h"
+
+void InstrumentationCounterTests() {
+  // Check that counts from several threads add up and that the timers and
+  // report behave.  These work whether or not the library was built with
+  // instrumentation since they call Add and AddTime directly.
+  std::cout << "\n";
+  std::cout << "*************************************\n";
+  std::cout << "*** Instrumentation Counter Tests ***\n";
+  std::cout << "*************************************\n";
+  Stomp::Instrumentation::Reset();
+
+  uint32_t n_task = 64, n_add = 10000;
+  Stomp::ParallelFor(n_task, Stomp::DefaultThreads(), [&](uint32_t k) {
+    for (uint32_t i=0;i<n_add;i++)
+      Stomp::Instrumentation::Add(Stomp::Instrumentation::LeafPairsTested);
+    Stomp::Instrumentation::Add(Stomp::Instrumentation::BytesRead, k);
+  });
+  uint64_t n_bytes = n_task*(n_task - 1)/2;
+  std::cout << "\t" << Stomp::Instrumentation::Count(
+    Stomp::Instrumentation::LeafPairsTested) << " (" << n_task*n_add <<
+    ") leaf pairs, " << Stomp::Instrumentation::Count(
+      Stomp::Instrumentation::BytesRead) << " (" << n_bytes << ") bytes\n";
+  if ((Stomp::Instrumentation::Count(
+	 Stomp::Instrumentation::LeafPairsTested) != n_task*n_add) ||
+      (Stomp::Instrumentation::Count(
+	 Stomp::Instrumentation::BytesRead) != n_bytes))
+    std::cout << "\tFAILED: thread counts don't add up.\n";
+
+  Stomp::Instrumentation::AddTime("Test::Timer", 0.25);
+  Stomp::Instrumentation::AddTime("Test::Timer", 0.5);
+  {
+    Stomp::ScopedTimer timer("Test::ScopedTimer");
+  }
+  std::cout << "\tTest::Timer: " <<
+    Stomp::Instrumentation::Calls("Test::Timer") << " calls, " <<
+    Stomp::Instrumentation::Time("Test::Timer") << " (0.75) seconds\n";
+  if ((Stomp::Instrumentation::Calls("Test::Timer") != 2) ||
+      (Stomp::Instrumentation::Calls("Test::ScopedTimer") != 1))
+    std::cout << "\tFAILED: wrong number of timer calls.\n";
+
+  std::ostringstream report;
+  Stomp::Instrumentation::WriteReport(report);
+  std::cout << report.str();
+  if ((report.str().find("\"leaf_pairs_tested\": 640000") ==
+       std::string::npos) ||
+      (report.str().find("\"Test::Timer\": {\"calls\": 2") ==
+       std::string::npos))
+    std::cout << "\tFAILED: report is missing entries.\n";
+
+  Stomp::Instrumentation::Reset();
+  if ((Stomp::Instrumentation::Count(
+	 Stomp::Instrumentation::LeafPairsTested) != 0) ||
+      (Stomp::Instrumentation::Calls("Test::Timer") != 0))
+    std::cout << "\tFAILED: Reset didn't clear everything.\n";
+}
+
+void InstrumentationPairTests() {
+  // Run a pair search and check that the library counters agree with each
+  // other.  Without instrumentation compiled in they should all stay zero.
+  std::cout << "\n";
+  std::cout << "**********************************\n";
+  std::cout << "*** Instrumentation Pair Tests ***\n";
+  std::cout << "**********************************\n";
+  Stomp::AngularCoordinate center(20.0, 0.0, Stomp::AngularCoordinate::Survey);
+  Stomp::CircleBound region(center, 2.0);
+
+  Stomp::AngularVector tree_ang, query_ang;
+  region.GenerateRandomPoints(tree_ang, 5000);
+  region.GenerateRandomPoints(query_ang, 200);
+
+  Stomp::TreeMap tree_map(32, 20);
+  for (Stomp::AngularIterator iter=tree_ang.begin();
+       iter!=tree_ang.end();++iter) tree_map.AddPoint(*iter);
+
+  Stomp::Instrumentation::Reset();
+  Stomp::AngularBin theta(0.1, 0.5);
+  tree_map.FindPairs(query_ang, theta);
+
+  uint64_t n_nodes = Stomp::Instrumentation::Count(
+    Stomp::Instrumentation::TreeNodesVisited);
+  uint64_t n_leaf = Stomp::Instrumentation::Count(
+    Stomp::Instrumentation::LeafPairsTested);
+  uint64_t n_accepted = Stomp::Instrumentation::Count(
+    Stomp::Instrumentation::AnnulusAccepted);
+  uint64_t n_rejected = Stomp::Instrumentation::Count(
+    Stomp::Instrumentation::AnnulusRejected);
+  uint64_t n_partial = Stomp::Instrumentation::Count(
+    Stomp::Instrumentation::AnnulusPartial);
+  std::cout << "\tInstrumentation " <<
+    (Stomp::Instrumentation::Enabled() ? "enabled" : "disabled") << ": " <<
+    n_nodes << " nodes, " << n_leaf << " leaf pairs, " << n_accepted <<
+    "/" << n_rejected << "/" << n_partial <<
+    " accepted/rejected/partial for " << theta.Counter() << " pairs\n";
+
+  if (Stomp::Instrumentation::Enabled()) {
+    if ((n_nodes == 0) || (n_leaf < theta.Counter()) ||
+	(n_partial == 0))
+      std::cout << "\tFAILED: counters don't match the pair search.\n";
+  } else {
+    if (n_nodes + n_leaf + n_accepted + n_rejected + n_partial > 0)
+      std::cout << "\tFAILED: counting without instrumentation.\n";
+  }
+  Stomp::Instrumentation::Reset();
+}
+
+// Define our command line flags
+DEFINE_bool(all_instrumentation_tests, false, "Run all class unit tests.");
+DEFINE_bool(instrumentation_counter_tests, false,
+	    "Run Instrumentation counter tests");
+DEFINE_bool(instrumentation_pair_tests, false,
+	    "Run Instrumentation pair search tests");
+
+void InstrumentationUnitTests(bool run_all_tests) {
+  void InstrumentationCounterTests();
+  void InstrumentationPairTests();
+
+  if (run_all_tests) FLAGS_all_instrumentation_tests = true;
+
+  // Check the Stomp::Instrumentation counters, timers and report.
+  if (FLAGS_all_instrumentation_tests || FLAGS_instrumentation_counter_tests)
+    InstrumentationCounterTests();
+
+  // Check the counters from a Stomp::TreeMap pair search.
+  if (FLAGS_all_instrumentation_tests || FLAGS_instrumentation_pair_tests)
+    InstrumentationPairTests();
+}
@@ -348,53 +348,23 @@ bool IndexedTreeMap::Read(const std::string& input_file,
 			  int8_t index_column) {
   bool io_success = false;
 
-  uint32_t n_lines = 0;
-  uint32_t check_lines = 128;
   if (theta_column != phi_column) {
-    std::ifstream input_file_str(input_file.c_str());
-
-    uint8_t index_idx = static_cast<uint8_t>(index_column);
-
-    if (input_file_str) {
+    // The parsing and coordinate conversion happen in parallel in
+    // ToIAngularVector; adding the points to the tree is serial.
+    if (verbose) std::cout << "Stomp::IndexedTreeMap::Read - " <<
+		   "Reading from " << input_file << "...\n";
+    IAngularVector i_ang;
+    if (IndexedAngularCoordinate::ToIAngularVector(input_file, i_ang, sphere,
+						   false, theta_column,
+						   phi_column, index_column)) {
       io_success = true;
-      if (verbose) std::cout << "Stomp::IndexedTreeMap::Read - " <<
-		     "Reading from " << input_file << "...\n";
-      while (!input_file_str.eof()) {
-	if (!input_file_str.eof()) {
-	  // This should read each line into a buffer, convert that buffer into
-	  // a string and then break that string into a vector of strings.  We
-	  // should then be able to access theta and phi by converting the
-	  // appropriate elements of that vector to doubles.
-	  char line_buffer[1000];
-	  std::vector<std::string> line_elements;
-
-	  input_file_str.getline(line_buffer, 1000);
-	  std::string line_string(line_buffer);
-	  Tokenize(line_string, line_elements, " ");
-	  n_lines++;
-	  if (verbose && n_lines == check_lines) {
-	    std::cout << "\tRead " << check_lines << " lines...\n";
-	    check_lines *= 2;
-	  }
-
-	  if ((line_elements.size() > theta_column) &&
-	      (line_elements.size() > phi_column)) {
-	    double theta = strtod(line_elements[theta_column].c_str(), NULL);
-	    double phi = strtod(line_elements[phi_column].c_str(), NULL);
-	    uint32_t index = n_lines - 1;
-	    if ((index_column > -1) &&
-		(line_elements.size() > index_idx)) {
-	      index = static_cast<uint32_t>(
-		strtoul(line_elements[index_idx].c_str(), NULL, 10));
-	    }
-
-	    IndexedAngularCoordinate* i_ang =
-	      new IndexedAngularCoordinate(theta, phi, index, sphere);
-	    if (!AddPoint(i_ang)) io_success = false;
-	  }
-	}
+      for (IAngularIterator iter=i_ang.begin();iter!=i_ang.end();++iter) {
+	IndexedAngularCoordinate* tmp_ang =
+	  new IndexedAngularCoordinate(iter->UnitSphereX(),
+				       iter->UnitSphereY(),
+				       iter->UnitSphereZ(), iter->Index());
+	if (!AddPoint(tmp_ang)) io_success = false;
       }
-      input_file_str.close();
     } else {
       std::cout << "Stomp::IndexedTreeMap::Read - " << input_file <<
 	" does not exist!\n";
@@ -402,9 +372,8 @@ bool IndexedTreeMap::Read(const std::string& input_file,
   }
 
   if (verbose && io_success)
-    std::cout << "Stomp::IndexedTreeMap::Read - Read " << n_lines-1 <<
-      " lines from " << input_file << "; loaded " <<
-      NPoints() << " into tree...\n";
+    std::cout << "Stomp::IndexedTreeMap::Read - Read " << input_file <<
+      "; loaded " << NPoints() << " into tree...\n";
 
   return io_success;
 }
@@ -17,9 +17,14 @@
 // However, the goal of the class is to abstract away those details, allowing
 // the user to treat Maps as a pure representative of spherical geometry.
 
+#include <string.h>
+#include <algorithm>
 #include "stomp_core.h"
 #include "stomp_map.h"
 #include "stomp_geometry.h"
+#include "stomp_point_catalog.h"
+#include "stomp_util.h"
+#include "stomp_instrumentation.h"
 
 namespace Stomp {
 
@@ -163,6 +168,7 @@ void SubMap::SetMaximumResolution(uint32_t max_resolution,
 }
 
 bool SubMap::FindLocation(AngularCoordinate& ang, double& weight) {
+  STOMP_COUNT(FindLocationProbes);
   bool keep = false;
   weight = -1.0e-30;
 
@@ -207,14 +213,18 @@ double SubMap::FindUnmaskedFraction(Pixel& pix) {
     level++;
   }
 
-  while (iter != pix_.end() && !found_pixel) {
-    if (pix.Contains(*iter)) {
-      double pixel_fraction =
+  // Rather than scanning everything past iter, we only need to look at the
+  // range of higher resolution pixels that could be inside pix.
+  for (level=pix.Level()+1;(level<=MaxLevel()) && !found_pixel;level++) {
+    PixelPair sub_iter = _FindSubPixelRange(pix, level);
+    for (iter=sub_iter.first;iter!=sub_iter.second;++iter) {
+      if (pix.Contains(*iter)) {
+	double pixel_fraction =
           static_cast<double> (pix.Resolution()*pix.Resolution())/
           (iter->Resolution()*iter->Resolution());
-      unmasked_fraction += pixel_fraction;
+	unmasked_fraction += pixel_fraction;
+      }
     }
-    ++iter;
   }
 
   return unmasked_fraction;
@@ -242,14 +252,33 @@ int8_t SubMap::FindUnmaskedStatus(Pixel& pix) {
     level++;
   }
 
-  while ((iter != pix_.end()) && (unmasked_status == 0)) {
-    if (pix.Contains(*iter)) unmasked_status = -1;
-    ++iter;
+  for (level=pix.Level()+1;
+       (level<=MaxLevel()) && (unmasked_status == 0);level++) {
+    PixelPair sub_iter = _FindSubPixelRange(pix, level);
+    for (iter=sub_iter.first;
+	 (iter!=sub_iter.second) && (unmasked_status == 0);++iter)
+      if (pix.Contains(*iter)) unmasked_status = -1;
   }
 
   return unmasked_status;
 }
 
+PixelPair SubMap::_FindSubPixelRange(Pixel& pix, uint8_t level) {
+  uint32_t scale = 1 << (level - pix.Level());
+  uint32_t resolution = Pixel::LevelToResolution(level);
+
+  Pixel first_pix(pix.PixelX()*scale, pix.PixelY()*scale, resolution, 1.0);
+  Pixel last_pix((pix.PixelX() + 1)*scale - 1, (pix.PixelY() + 1)*scale - 1,
+		 resolution, 1.0);
+
+  PixelIterator first_iter = lower_bound(pix_.begin(), pix_.end(), first_pix,
+					 Pixel::SuperPixelBasedOrder);
+  PixelIterator last_iter = upper_bound(first_iter, pix_.end(), last_pix,
+					Pixel::SuperPixelBasedOrder);
+
+  return PixelPair(first_iter, last_iter);
+}
+
 double SubMap::FindAverageWeight(Pixel& pix) {
   PixelIterator iter;
 
@@ -1125,6 +1154,36 @@ bool Map::Contains(AngularCoordinate& ang) {
   return keep;
 }
 
+uint32_t Map::Contains(PointCatalog& catalog, std::vector<uint8_t>& inside,
+		       uint32_t n_threads) {
+  uint32_t n_point = catalog.Size();
+  inside.assign(n_point, 0);
+
+  double* x = catalog.XColumn();
+  double* y = catalog.YColumn();
+  double* z = catalog.ZColumn();
+  const uint32_t block_size = 4096;
+  uint32_t n_block = (n_point + block_size - 1)/block_size;
+  std::vector<uint32_t> n_inside(n_block, 0);
+  ParallelFor(n_block, n_threads, [&](uint32_t block) {
+    uint32_t end = (block + 1)*block_size;
+    if (end > n_point) end = n_point;
+    AngularCoordinate ang;
+    for (uint32_t i=block*block_size;i<end;i++) {
+      ang.SetUnitSphereCoordinates(x[i], y[i], z[i]);
+      if (Contains(ang)) {
+	inside[i] = 1;
+	n_inside[block]++;
+      }
+    }
+  });
+
+  uint32_t n_total = 0;
+  for (uint32_t block=0;block<n_block;block++) n_total += n_inside[block];
+
+  return n_total;
+}
+
 bool Map::Contains(Pixel& pix) {
   return (FindUnmaskedStatus(pix) == 1 ? true : false);
 }
@@ -1581,58 +1640,8 @@ bool Map::RegionExcludedMap(int16_t region_index, Map& stomp_map) {
 
 void Map::GenerateRandomPoints(AngularVector& ang, uint32_t n_point,
 			       bool use_weighted_sampling, uint32_t seed) {
-  if (!ang.empty()) ang.clear();
-  ang.reserve(n_point);
-
-  double minimum_probability = -0.0001;
-  double probability_slope = 0.0;
-  if (use_weighted_sampling) {
-    if (max_weight_ - min_weight_ < 0.0001) {
-      use_weighted_sampling = false;
-    } else {
-      minimum_probability = 1.0/(max_weight_ - min_weight_ + 1.0);
-      probability_slope =
-          (1.0 - minimum_probability)/(max_weight_ - min_weight_);
-    }
-  }
-
-  PixelVector superpix;
-  Coverage(superpix);
-
-  MTRand mtrand;
-  if (seed > 0) mtrand.seed(seed);
-  else mtrand.seed();
-
-  for (uint32_t m=0;m<n_point;m++) {
-    bool keep = false;
-    double lambda, eta, z, weight, probability_limit, eta_min, eta_max;
-    AngularCoordinate tmp_ang(0.0,0.0);
-    uint32_t n,k;
-
-    while (!keep) {
-      n = mtrand.randInt(superpix.size()-1);
-      k = superpix[n].Superpixnum();
-
-      z = sub_map_[k].ZMin() + mtrand.rand(sub_map_[k].ZMax() -
-					   sub_map_[k].ZMin());
-      lambda = asin(z)*RadToDeg;
-      eta_min = sub_map_[k].EtaMin();
-      eta_max = sub_map_[k].EtaMax();
-      if (eta_min > eta_max) eta_min -= 360.;
-      eta = eta_min + mtrand.rand(eta_max - eta_min);
-      tmp_ang.SetSurveyCoordinates(lambda,eta);
-
-      keep = sub_map_[k].FindLocation(tmp_ang,weight);
-
-      if (use_weighted_sampling && keep) {
-        probability_limit =
-            minimum_probability + (weight - min_weight_)*probability_slope;
-        if (mtrand.rand(1.0) > probability_limit) keep = false;
-      }
-    }
-
-    ang.push_back(tmp_ang);
-  }
+  MapSampler sampler(*this, use_weighted_sampling);
+  sampler.GenerateRandomPoints(ang, n_point, seed);
 }
 
 void Map::GenerateRandomPoints(WAngularVector& ang, WAngularVector& input_ang,
@@ -1640,20 +1649,8 @@ void Map::GenerateRandomPoints(WAngularVector& ang, WAngularVector& input_ang,
   if (!ang.empty()) ang.clear();
   ang.reserve(input_ang.size());
 
-  double minimum_probability = -0.0001;
-  double probability_slope = 0.0;
-  if (use_weighted_sampling) {
-    if (max_weight_ - min_weight_ < 0.0001) {
-      use_weighted_sampling = false;
-    } else {
-      minimum_probability = 1.0/(max_weight_ - min_weight_ + 1.0);
-      probability_slope =
-          (1.0 - minimum_probability)/(max_weight_ - min_weight_);
-    }
-  }
-
-  PixelVector superpix;
-  Coverage(superpix);
+  MapSampler sampler(*this, use_weighted_sampling);
+  if (sampler.Empty()) return;
 
   MTRand mtrand;
   if (seed > 0) mtrand.seed(seed);
@@ -1662,31 +1659,7 @@ void Map::GenerateRandomPoints(WAngularVector& ang, WAngularVector& input_ang,
   WeightedAngularCoordinate tmp_ang;
   for (uint32_t m=0;m<input_ang.size();m++) {
     if (Contains(input_ang[m])) {
-      bool keep = false;
-      double lambda, eta, z, map_weight, probability_limit, eta_min, eta_max;
-      uint32_t n,k;
-
-      while (!keep) {
-	n = mtrand.randInt(superpix.size()-1);
-	k = superpix[n].Superpixnum();
-
-	z = sub_map_[k].ZMin() + mtrand.rand(sub_map_[k].ZMax() -
-					     sub_map_[k].ZMin());
-	lambda = asin(z)*RadToDeg;
-	eta_min = sub_map_[k].EtaMin();
-    eta_max = sub_map_[k].EtaMax();
-    if (eta_min > eta_max) eta_min -= 360.;
-    eta = eta_min + mtrand.rand(eta_max - eta_min);
-	tmp_ang.SetSurveyCoordinates(lambda,eta);
-
-	keep = sub_map_[k].FindLocation(tmp_ang, map_weight);
-
-	if (use_weighted_sampling && keep) {
-	  probability_limit =
-	    minimum_probability + (map_weight - min_weight_)*probability_slope;
-	  if (mtrand.rand(1.0) > probability_limit) keep = false;
-	}
-      }
+      sampler.GenerateRandomPoint(mtrand, tmp_ang);
       tmp_ang.SetWeight(input_ang[m].Weight());
       ang.push_back(tmp_ang);
     }
@@ -1699,20 +1672,8 @@ void Map::GenerateRandomPoints(WAngularVector& ang,
   if (!ang.empty()) ang.clear();
   ang.reserve(weights.size());
 
-  double minimum_probability = -0.0001;
-  double probability_slope = 0.0;
-  if (use_weighted_sampling) {
-    if (max_weight_ - min_weight_ < 0.0001) {
-      use_weighted_sampling = false;
-    } else {
-      minimum_probability = 1.0/(max_weight_ - min_weight_ + 1.0);
-      probability_slope =
-          (1.0 - minimum_probability)/(max_weight_ - min_weight_);
-    }
-  }
-
-  PixelVector superpix;
-  Coverage(superpix);
+  MapSampler sampler(*this, use_weighted_sampling);
+  if (sampler.Empty()) return;
 
   MTRand mtrand;
   if (seed > 0) mtrand.seed(seed);
@@ -1720,31 +1681,7 @@ void Map::GenerateRandomPoints(WAngularVector& ang,
 
   WeightedAngularCoordinate tmp_ang;
   for (uint32_t m=0;m<weights.size();m++) {
-    bool keep = false;
-    double lambda, eta, z, map_weight, probability_limit, eta_min, eta_max;
-    uint32_t n,k;
-
-    while (!keep) {
-      n = mtrand.randInt(superpix.size()-1);
-      k = superpix[n].Superpixnum();
-
-      z = sub_map_[k].ZMin() + mtrand.rand(sub_map_[k].ZMax() -
-					   sub_map_[k].ZMin());
-      lambda = asin(z)*RadToDeg;
-      eta_min = sub_map_[k].EtaMin();
-      eta_max = sub_map_[k].EtaMax();
-      if (eta_min > eta_max) eta_min -= 360.;
-      eta = eta_min + mtrand.rand(eta_max - eta_min);
-      tmp_ang.SetSurveyCoordinates(lambda,eta);
-
-      keep = sub_map_[k].FindLocation(tmp_ang, map_weight);
-
-      if (use_weighted_sampling && keep) {
-	probability_limit =
-	  minimum_probability + (map_weight - min_weight_)*probability_slope;
-	if (mtrand.rand(1.0) > probability_limit) keep = false;
-      }
-    }
+    sampler.GenerateRandomPoint(mtrand, tmp_ang);
     tmp_ang.SetWeight(weights[m]);
     ang.push_back(tmp_ang);
   }
@@ -1755,20 +1692,8 @@ void Map::GenerateRandomPoints(CosmoVector& ang, CosmoVector& input_ang,
   if (!ang.empty()) ang.clear();
   ang.reserve(input_ang.size());
 
-  double minimum_probability = -0.0001;
-  double probability_slope = 0.0;
-  if (use_weighted_sampling) {
-    if (max_weight_ - min_weight_ < 0.0001) {
-      use_weighted_sampling = false;
-    } else {
-      minimum_probability = 1.0/(max_weight_ - min_weight_ + 1.0);
-      probability_slope =
-          (1.0 - minimum_probability)/(max_weight_ - min_weight_);
-    }
-  }
-
-  PixelVector superpix;
-  Coverage(superpix);
+  MapSampler sampler(*this, use_weighted_sampling);
+  if (sampler.Empty()) return;
 
   MTRand mtrand;
   if (seed > 0) mtrand.seed(seed);
@@ -1777,39 +1702,47 @@ void Map::GenerateRandomPoints(CosmoVector& ang, CosmoVector& input_ang,
   CosmoCoordinate tmp_ang;
   for (uint32_t m=0;m<input_ang.size();m++) {
     if (Contains(input_ang[m])) {
-      bool keep = false;
-      double lambda, eta, z, map_weight, probability_limit, eta_min, eta_max;
-      uint32_t n,k,red_id;
-
-      while (!keep) {
-	n = mtrand.randInt(superpix.size()-1);
-	k = superpix[n].Superpixnum();
-
-	z = sub_map_[k].ZMin() + mtrand.rand(sub_map_[k].ZMax() -
-					     sub_map_[k].ZMin());
-	lambda = asin(z)*RadToDeg;
-	eta_min = sub_map_[k].EtaMin();
-    eta_max = sub_map_[k].EtaMax();
-    if (eta_min > eta_max) eta_min -= 360.;
-    eta = eta_min + mtrand.rand(eta_max - eta_min);
-	tmp_ang.SetSurveyCoordinates(lambda,eta);
-
-	keep = sub_map_[k].FindLocation(tmp_ang, map_weight);
-
-	if (use_weighted_sampling && keep) {
-	  probability_limit =
-	    minimum_probability + (map_weight - min_weight_)*probability_slope;
-	  if (mtrand.rand(1.0) > probability_limit) keep = false;
-	}
-      }
+      sampler.GenerateRandomPoint(mtrand, tmp_ang);
       tmp_ang.SetWeight(input_ang[m].Weight());
-      red_id = mtrand.randInt(input_ang.size()-1);
+      uint32_t red_id = mtrand.randInt(input_ang.size()-1);
       tmp_ang.SetRedshift(input_ang[red_id].Redshift());
       ang.push_back(tmp_ang);
     }
   }
 }
 
+void Map::GenerateRandomPoints(PointCatalog& catalog,
+			       PointCatalog& input_catalog,
+			       bool use_weighted_sampling, uint32_t seed) {
+  catalog.Clear();
+
+  std::vector<uint8_t> inside;
+  uint32_t n_inside = Contains(input_catalog, inside);
+  catalog.Reserve(n_inside);
+  if (input_catalog.HasRedshift()) catalog.AddRedshiftColumn();
+
+  MapSampler sampler(*this, use_weighted_sampling);
+  if (sampler.Empty()) return;
+
+  MTRand mtrand;
+  if (seed > 0) mtrand.seed(seed);
+  else mtrand.seed();
+
+  // As with the CosmoVector version, random points get a redshift drawn from
+  // the input catalog if it has them.
+  AngularCoordinate tmp_ang;
+  for (uint32_t m=0;m<input_catalog.Size();m++) {
+    if (inside[m]) {
+      sampler.GenerateRandomPoint(mtrand, tmp_ang);
+      catalog.AddPoint(tmp_ang, input_catalog.Weight(m));
+      if (input_catalog.HasRedshift()) {
+	uint32_t red_id = mtrand.randInt(input_catalog.Size()-1);
+	catalog.SetRedshift(catalog.Size()-1, input_catalog.Redshift(red_id));
+      }
+    }
+  }
+}
+
 void Map::GenerateSingleRandomPoint(WeightedAngularCoordinate& ang, 
 				    bool return_local_weight,
 				    bool use_weighted_sampling) {
@@ -1856,6 +1789,12 @@ void Map::GenerateSingleRandomPoint(WeightedAngularCoordinate& ang,
 	minimum_probability + (map_weight - min_weight_)*probability_slope;
       if (mtrand.rand(1.0) > probability_limit) keep = false;
     }
+
+    if (keep) {
+      STOMP_COUNT(RandomPointsGenerated);
+    } else {
+      STOMP_COUNT(RandomPointsRejected);
+    }
   }
   if (return_local_weight)
     ang.SetWeight(FindLocationWeight(ang));
@@ -1867,88 +1806,62 @@ void Map::GenerateSingleRandomPoint(WeightedAngularCoordinate& ang,
 
 // This is the generic version taking a string for the system
 PyObject* Map::GenerateRandomPoints(uint32_t n_point, const std::string& system,
-				    bool use_weighted_sampling, uint32_t seed)
+				    bool use_weighted_sampling, uint32_t seed,
+				    uint32_t n_threads)
   throw (const char*)  {
   Stomp::AngularCoordinate::Sphere sys =
     Stomp::AngularCoordinate::SystemFromString(system);
-  return GenerateRandomPoints(n_point,sys,use_weighted_sampling,seed);
+  return GenerateRandomPoints(n_point,sys,use_weighted_sampling,seed,n_threads);
 }
 
 // This is the generic version taking a Sphere id for the system
 PyObject* Map::GenerateRandomPoints(uint32_t n_point,
 				    Stomp::AngularCoordinate::Sphere systemid,
-				    bool use_weighted_sampling, uint32_t seed)
+				    bool use_weighted_sampling, uint32_t seed,
+				    uint32_t n_threads)
   throw (const char*)  {
-  double minimum_probability = -0.0001;
-  double probability_slope = 0.0;
   std::stringstream err;
+  if (systemid != Stomp::AngularCoordinate::Survey &&
+      systemid != Stomp::AngularCoordinate::Equatorial &&
+      systemid != Stomp::AngularCoordinate::Galactic) {
+    err << "Bad system id: " << systemid;
+    throw err.str().c_str();
+  }
+
   // Make the output numpy arrays
   NumpyVector<double> x1(n_point);
   NumpyVector<double> x2(n_point);
 
-  if (use_weighted_sampling) {
-    if (max_weight_ - min_weight_ < 0.0001) {
-      use_weighted_sampling = false;
-    } else {
-      minimum_probability = 1.0/(max_weight_ - min_weight_ + 1.0);
-      probability_slope =
-        (1.0 - minimum_probability)/(max_weight_ - min_weight_);
-    }
-  }
-
-  PixelVector superpix;
-  Coverage(superpix);
-
-  MTRand mtrand;
-  if (seed > 0) mtrand.seed(seed);
-  else mtrand.seed();
-
-  for (uint32_t m=0;m<n_point;m++) {
-    bool keep = false;
-    double lambda, eta, z, weight, probability_limit, eta_min, eta_max;
-    AngularCoordinate tmp_ang(0.0,0.0);
-    uint32_t n,k;
-
-    while (!keep) {
-      n = mtrand.randInt(superpix.size()-1);
-      k = superpix[n].Superpixnum();
-
-      z = sub_map_[k].ZMin() +
-        mtrand.rand(sub_map_[k].ZMax() - sub_map_[k].ZMin());
-      lambda = asin(z)*RadToDeg;
-      eta_min = sub_map_[k].EtaMin();
-      eta_max = sub_map_[k].EtaMax();
-      if (eta_min > eta_max) eta_min -= 360.;
-      eta = eta_min + mtrand.rand(eta_max - eta_min);
-      tmp_ang.SetSurveyCoordinates(lambda,eta);
-
-      keep = sub_map_[k].FindLocation(tmp_ang,weight);
-
-      if (use_weighted_sampling && keep) {
-        probability_limit =
-          minimum_probability + (weight - min_weight_)*probability_slope;
-        if (mtrand.rand(1.0) > probability_limit) keep = false;
+  MapSampler sampler(*this, use_weighted_sampling);
+
+  // Nothing below touches the python API, so let other python threads run.
+  Py_BEGIN_ALLOW_THREADS
+  AngularVector ang;
+  sampler.GenerateRandomPoints(ang, n_point, seed, n_threads);
+
+  const uint32_t block_size = 4096;
+  uint32_t n_block = (ang.size() + block_size - 1)/block_size;
+  ParallelFor(n_block, n_threads, [&](uint32_t block) {
+    uint32_t end = (block + 1)*block_size;
+    if (end > ang.size()) end = ang.size();
+    for (uint32_t m=block*block_size;m<end;m++) {
+      switch (systemid) {
+      case Stomp::AngularCoordinate::Survey:
+	x1.at(m) = ang[m].Lambda();
+	x2.at(m) = ang[m].Eta();
+	break;
+      case Stomp::AngularCoordinate::Equatorial:
+	x1.at(m) = ang[m].RA();
+	x2.at(m) = ang[m].DEC();
+	break;
+      case Stomp::AngularCoordinate::Galactic:
+	x1.at(m) = ang[m].GalLon();
+	x2.at(m) = ang[m].GalLat();
+	break;
       }
     }
-
-    switch (systemid) {
-    case Stomp::AngularCoordinate::Survey:
-      x1[m] = lambda;
-      x2[m] = eta;
-      break;
-    case Stomp::AngularCoordinate::Equatorial:
-      x1[m] = tmp_ang.RA();
-      x2[m] = tmp_ang.DEC();
-      break;
-    case Stomp::AngularCoordinate::Galactic:
-      x1[m] = tmp_ang.GalLon();
-      x2[m] = tmp_ang.GalLat();
-      break;
-    default:
-      err << "Bad system id: " << systemid;
-      throw err.str().c_str();
-    }
-  }
+  });
+  Py_END_ALLOW_THREADS
 
   PyObject* output_tuple = PyTuple_New(2);
   PyTuple_SetItem(output_tuple, 0, x1.getref());
@@ -1959,42 +1872,65 @@ PyObject* Map::GenerateRandomPoints(uint32_t n_point,
 
 // These are wrappers for the more generic function above
 PyObject* Map::GenerateRandomEq(uint32_t n_point, bool use_weighted_sampling,
-            uint32_t seed)
+            uint32_t seed, uint32_t n_threads)
   throw (const char*)  {
   return GenerateRandomPoints(n_point, Stomp::AngularCoordinate::Equatorial,
-			      use_weighted_sampling, seed);
+			      use_weighted_sampling, seed, n_threads);
 }
 PyObject* Map::GenerateRandomSurvey(uint32_t n_point,
-				    bool use_weighted_sampling, uint32_t seed)
+				    bool use_weighted_sampling, uint32_t seed,
+				    uint32_t n_threads)
   throw (const char*)  {
   return GenerateRandomPoints(n_point, Stomp::AngularCoordinate::Survey,
-			      use_weighted_sampling, seed);
+			      use_weighted_sampling, seed, n_threads);
 }
 PyObject* Map::GenerateRandomGal(uint32_t n_point, bool use_weighted_sampling,
-            uint32_t seed)
+            uint32_t seed, uint32_t n_threads)
   throw (const char*)  {
   return GenerateRandomPoints(n_point, Stomp::AngularCoordinate::Galactic,
-			      use_weighted_sampling, seed);
+			      use_weighted_sampling, seed, n_threads);
 }
 
 // generate random points in a quadrant around the input lambda,eta
 // lambda,eta,R in degrees, quadrante in [0,3]
 PyObject* Map::GenerateRandomQuadrantPointsSurvey(double lambda_center, double eta_center, 
-    double R, uint32_t n_point, int quadrant) throw (const char*)  {
+    double R, uint32_t n_point, int quadrant, uint32_t seed,
+    uint32_t n_threads) throw (const char*)  {
+  // Check this up front; we can't throw once the GIL has been released.
+  if (quadrant < -1 || quadrant > 3) {
+    std::stringstream err;
+    err << "Error: quadrant is undefined: " << quadrant;
+    throw err.str().c_str();
+  }
 
-  std::srand ( std::time(NULL) );
+  if (seed == 0) {
+    MTRand mtrand;
+    mtrand.seed();
+    seed = mtrand.randInt();
+  }
 
   // Make the output numpy arrays
   NumpyVector<double> rand_lambda(n_point);
   NumpyVector<double> rand_eta(n_point);
 
-  double rlam=0, reta=0;
-  for (uint32_t i=0; i<n_point; i++) {
-    _GenerateRandLamEtaQuadrant(lambda_center, eta_center, R, quadrant,
-				                        rlam, reta);
-    rand_lambda[i] = rlam;
-    rand_eta[i] = reta;
-  }
+  // Each block of points gets its own generator, seeded from its index, so
+  // the output doesn't depend on how the blocks are spread over the threads.
+  Py_BEGIN_ALLOW_THREADS
+  const uint32_t block_size = 65536;
+  uint32_t n_block = (n_point + block_size - 1)/block_size;
+  ParallelFor(n_block, n_threads, [&](uint32_t block) {
+    MTRand mtrand(seed + 2654435761u*block);
+    uint32_t end = (block + 1)*block_size;
+    if (end > n_point) end = n_point;
+    double rlam=0, reta=0;
+    for (uint32_t i=block*block_size;i<end;i++) {
+      _GenerateRandLamEtaQuadrant(mtrand, lambda_center, eta_center, R,
+				  quadrant, rlam, reta);
+      rand_lambda.at(i) = rlam;
+      rand_eta.at(i) = reta;
+    }
+  });
+  Py_END_ALLOW_THREADS
 
   PyObject* output_tuple = PyTuple_New(2);
   PyTuple_SetItem(output_tuple, 0, rand_lambda.getref());
@@ -2007,7 +1943,8 @@ PyObject* Map::GenerateRandomQuadrantPointsSurvey(double lambda_center, double e
 
 
 PyObject* Map::Contains(PyObject* x1obj, PyObject* x2obj,
-			const std::string& system, PyObject* radobj)
+			const std::string& system, PyObject* radobj,
+			uint32_t n_threads)
   throw (const char* ) {
   // convert the string system indicator to a Sphere id
   Stomp::AngularCoordinate::Sphere sys =
@@ -2024,156 +1961,387 @@ PyObject* Map::Contains(PyObject* x1obj, PyObject* x2obj,
   // optional radius, can be scalar or x1.size()
   NumpyVector<double> rad;
   npy_intp nrad=0;
-  double thisrad=-1;
-  if (radobj != NULL) {
+  if (radobj != NULL && radobj != Py_None) {
     rad.init(radobj);
     nrad = rad.size();
     if (nrad != 1 && nrad != x1.size()) {
       throw "radius must be same length as coordinates or length 1";
     }
-    if (nrad == 1) {
-      thisrad = rad[0];
-    }
-    // seed the random number generator.  Distinctive to
-    // one second
-    std::srand ( std::time(NULL) );
   }
 
   // An output numpy array
-  NumpyVector<npy_int8> maskflags(x1.size());
-
-  Stomp::AngularCoordinate ang;
-  for (npy_intp i=0; i<x1.size(); i++) {
-    ang.Set(x1[i], x2[i], sys);
-    if (Contains(ang)) {
-      maskflags[i] |= INSIDE_MAP;
-
-      // If radii were sent, we will do the quadrant check
-      if (nrad > 0) {
-        if (nrad > 1) {
-          thisrad = rad[i];
-        }
-        maskflags[i] |= QuadrantsContainedMC(ang,thisrad,sys);
+  npy_intp n_point = x1.size();
+  NumpyVector<npy_int8> maskflags(n_point);
+
+  Py_BEGIN_ALLOW_THREADS
+  const npy_intp block_size = 4096;
+  uint32_t n_block = (n_point + block_size - 1)/block_size;
+  ParallelFor(n_block, n_threads, [&](uint32_t block) {
+    npy_intp end = (block + 1)*block_size;
+    if (end > n_point) end = n_point;
+    Stomp::AngularCoordinate ang;
+    for (npy_intp i=block*block_size;i<end;i++) {
+      ang.Set(x1.at(i), x2.at(i), sys);
+      if (Contains(ang)) {
+	npy_int8 flags = INSIDE_MAP;
+
+	// If radii were sent, we will do the quadrant check
+	if (nrad > 0)
+	  flags |= QuadrantsContained(ang, rad.at(nrad > 1 ? i : 0), sys);
+	maskflags.at(i) = flags;
       }
     }
-  }
+  });
+  Py_END_ALLOW_THREADS
+
   return maskflags.getref();
 }
 
 #endif  // end python-only code
 
-int Map::QuadrantsContainedMC(AngularCoordinate& ang, double radius,
-			      Stomp::AngularCoordinate::Sphere coord_system)
-  throw (const char*) {
-  int maskflags=0;
+int Map::QuadrantsContained(AngularCoordinate& ang, double radius,
+			    AngularCoordinate::Sphere coord_system) {
+  std::vector<double> quadrant_fraction;
+  FindQuadrantFractions(ang, radius, quadrant_fraction, coord_system);
 
-  if (1) {
-    if (QuadrantContainedMC(ang,radius,0)) {
-      maskflags |= FIRST_QUADRANT_OK;
-    }
-    if (QuadrantContainedMC(ang,radius,1)) {
-      maskflags |= SECOND_QUADRANT_OK;
-    }
-    if (QuadrantContainedMC(ang,radius,2)) {
-      maskflags |= THIRD_QUADRANT_OK;
-    }
-    if (QuadrantContainedMC(ang,radius,3)) {
-      maskflags |= FOURTH_QUADRANT_OK;
-    }
-  } else {
-    double amin=0.05;
-    double pmax=0.01;
-    {
-      WedgeBound wb(ang, radius, 0.0, 90.0, coord_system);
-      if (Contains(wb, amin, pmax))
-        maskflags |= FIRST_QUADRANT_OK;
-    }
-    {
-      WedgeBound wb(ang, radius, 90.0, 180.0, coord_system);
-      if (Contains(wb, amin, pmax))
-        maskflags |= SECOND_QUADRANT_OK;
-    }
-    {
-      WedgeBound wb(ang, radius, 180.0, 270.0, coord_system);
-      if (Contains(wb, amin, pmax))
-        maskflags |= THIRD_QUADRANT_OK;
-    }
-    {
-      WedgeBound wb(ang, radius, 270.0, 360.0, coord_system);
-      if (Contains(wb, amin, pmax))
-        maskflags |= FOURTH_QUADRANT_OK;
-    }
+  int maskflags = 0;
+  if (DoubleGE(quadrant_fraction[0], 1.0)) maskflags |= FIRST_QUADRANT_OK;
+  if (DoubleGE(quadrant_fraction[1], 1.0)) maskflags |= SECOND_QUADRANT_OK;
+  if (DoubleGE(quadrant_fraction[2], 1.0)) maskflags |= THIRD_QUADRANT_OK;
+  if (DoubleGE(quadrant_fraction[3], 1.0)) maskflags |= FOURTH_QUADRANT_OK;
 
-  }
   return maskflags;
 }
 
-bool Map::QuadrantContainedMC(AngularCoordinate& ang, double radius,
-			      int quadrant) throw (const char*) {
-  // These tune the test accuracy
-  //
-  // Minimum size we want to resolve in square degrees This can be pretty
-  // big since we are only worried about edges and big holes.  0.05
-  // corresponds to half a field
-  static double amin=0.05;
-
-  // probability a randomly generated point will *not*
-  // fall within our smallest area amin
-  double A = Pi*radius*radius/4.0;
-  double pmiss = 1. - amin/A;
-
-  // Probability of missing amin sized region?  The number of points used
-  // goes as the log of this
-  static double pmax=0.01;
-
-  uint32_t nrand=0;
-  if (pmiss > 1.e-10) {
-    // how many points do we need in order for the
-    // probability of missing the hole to be pmax?
-    //      We need n such that (1-amin/a)^n = pmax
-    double tmp = log10(pmax)/log10(pmiss);
-    if (tmp < 20) tmp = 20;
-    if (tmp > 20000) tmp = 20000;
-    nrand = lround(tmp);
+bool Map::QuadrantContained(AngularCoordinate& ang, double radius,
+			    int quadrant,
+			    AngularCoordinate::Sphere coord_system) {
+  if ((quadrant < 0) || (quadrant > 3)) {
+    std::cout << "Stomp::Map::QuadrantContained - " <<
+      "Quadrant must be in [0,3]; got " << quadrant << "\n";
+    return false;
+  }
+
+  WedgeBound wedge_bound(ang, radius, 90.0*quadrant, 90.0*(quadrant + 1),
+			 coord_system);
+
+  return Contains(wedge_bound);
+}
+
+bool Map::Contains(GeometricBound& bound, uint32_t max_resolution) {
+  return DoubleGE(FindUnmaskedFraction(bound, max_resolution), 1.0);
+}
+
+double Map::FindUnmaskedFraction(GeometricBound& bound,
+				 uint32_t max_resolution) {
+  std::vector<GeometricBound*> pieces;
+  std::vector<double> uncovered_area;
+  if (!_FindUncoveredArea(bound, pieces, max_resolution, uncovered_area)) {
+    // Either the bound is outside the Map or it was too small for any of the
+    // pixel scoring points to land in it.  In the latter case, the best we
+    // can do is check the middle of its angular bounds.
+    if (uncovered_area[0] > 0.0) return 0.0;
+
+    double eta_min = bound.EtaMin();
+    double eta_max = bound.EtaMax();
+    if (eta_min > eta_max) eta_max += 360.0;
+    AngularCoordinate ang(0.5*(bound.LambdaMin() + bound.LambdaMax()),
+			  0.5*(eta_min + eta_max), AngularCoordinate::Survey);
+
+    return (Contains(ang) ? 1.0 : 0.0);
+  }
+
+  double unmasked_fraction = 1.0 - uncovered_area[0]/bound.Area();
+  if (unmasked_fraction < 0.0) unmasked_fraction = 0.0;
+
+  return unmasked_fraction;
+}
+
+bool Map::Contains(GeometricBound& bound, double area_resolution,
+		   double precision) {
+  return DoubleGE(FindUnmaskedFraction(bound, area_resolution, precision),
+		  1.0);
+}
+
+double Map::FindUnmaskedFraction(GeometricBound& bound, double area_resolution,
+				 double precision) {
+  uint32_t max_resolution = HPixResolution;
+  while ((max_resolution < MaxResolution()) &&
+	 (Pixel::PixelArea(max_resolution) > area_resolution))
+    max_resolution *= 2;
+
+  return FindUnmaskedFraction(bound, max_resolution);
+}
+
+double Map::FindQuadrantFractions(AngularCoordinate& ang, double radius,
+				  std::vector<double>& quadrant_fraction,
+				  AngularCoordinate::Sphere coord_system,
+				  uint32_t max_resolution) {
+  CircleBound circle_bound(ang, radius);
+  WedgeBound first_quadrant(ang, radius, 0.0, 90.0, coord_system);
+  WedgeBound second_quadrant(ang, radius, 90.0, 180.0, coord_system);
+  WedgeBound third_quadrant(ang, radius, 180.0, 270.0, coord_system);
+  WedgeBound fourth_quadrant(ang, radius, 270.0, 360.0, coord_system);
+
+  std::vector<GeometricBound*> pieces;
+  pieces.push_back(&first_quadrant);
+  pieces.push_back(&second_quadrant);
+  pieces.push_back(&third_quadrant);
+  pieces.push_back(&fourth_quadrant);
+
+  std::vector<double> uncovered_area;
+  quadrant_fraction.assign(4, 0.0);
+  if (!_FindUncoveredArea(circle_bound, pieces, max_resolution,
+			  uncovered_area)) {
+    // As in FindUnmaskedFraction, circles too small to pixelize are either
+    // in or out depending on their center.
+    double circle_uncovered_area = uncovered_area[0] + uncovered_area[1] +
+      uncovered_area[2] + uncovered_area[3];
+    if ((circle_uncovered_area == 0.0) && Contains(ang))
+      quadrant_fraction.assign(4, 1.0);
+    return quadrant_fraction[0];
+  }
+
+  double unmasked_fraction = 0.0;
+  for (uint32_t q=0;q<4;q++) {
+    quadrant_fraction[q] = 1.0 - uncovered_area[q]/pieces[q]->Area();
+    if (quadrant_fraction[q] < 0.0) quadrant_fraction[q] = 0.0;
+    unmasked_fraction += 0.25*quadrant_fraction[q];
+  }
+
+  return unmasked_fraction;
+}
+
+bool Map::FindQuadrantFractions(AngularVector& ang,
+				std::vector<double>& radius,
+				std::vector<double>& unmasked_fraction,
+				std::vector<double>& quadrant_fraction,
+				AngularCoordinate::Sphere coord_system,
+				uint32_t max_resolution, uint32_t n_threads) {
+  if ((radius.size() != 1) && (radius.size() != ang.size())) {
+    std::cout << "Stomp::Map::FindQuadrantFractions - " <<
+      "radius must have 1 or " << ang.size() << " entries; got " <<
+      radius.size() << "\n";
+    return false;
+  }
+
+  unmasked_fraction.assign(ang.size(), 0.0);
+  quadrant_fraction.assign(4*ang.size(), 0.0);
+
+  ParallelFor(ang.size(), n_threads, [&](uint32_t i) {
+    AngularCoordinate center = ang[i];
+    double circle_radius = (radius.size() == 1 ? radius[0] : radius[i]);
+    std::vector<double> circle_quadrant_fraction;
+    unmasked_fraction[i] =
+      FindQuadrantFractions(center, circle_radius, circle_quadrant_fraction,
+			    coord_system, max_resolution);
+    for (uint32_t q=0;q<4;q++)
+      quadrant_fraction[4*i + q] = circle_quadrant_fraction[q];
+  });
+
+  return true;
+}
+
+bool Map::_FindUncoveredArea(GeometricBound& bound,
+			     std::vector<GeometricBound*>& pieces,
+			     uint32_t max_resolution,
+			     std::vector<double>& uncovered_area) {
+  uint32_t n_piece = (pieces.empty() ? 1 : pieces.size());
+  uncovered_area.assign(n_piece, 0.0);
+
+  // As with PixelizeBound, we start with pixels about 1/100th the area of the
+  // bound, although here we let small bounds start as fine as they need to.
+  uint32_t starting_resolution = HPixResolution;
+  while ((bound.Area()/Pixel::PixelArea(starting_resolution) <= 100.0) &&
+	 (starting_resolution < MaxPixelResolution)) starting_resolution *= 2;
+  uint8_t starting_resolution_level =
+    Pixel::ResolutionToLevel(starting_resolution);
+
+  // We need to be careful around the poles since the pixels there get
+  // very distorted.
+  if (((bound.LambdaMin() > 85.0) || (bound.LambdaMax() < -85.0)) &&
+      (starting_resolution_level < MostSignificantBit(512)))
+    starting_resolution_level = MostSignificantBit(512);
+
+  // Pixels straddling the edge of the bound are refined down to
+  // max_resolution (the Map's maximum resolution by default) if they also
+  // straddle the edge of the Map.  Otherwise, we only need to resolve the
+  // bound's geometry and a couple of levels past the starting resolution is
+  // plenty for that.
+  uint8_t geometry_resolution_level = starting_resolution_level + 2;
+  if (geometry_resolution_level > MaxPixelLevel)
+    geometry_resolution_level = MaxPixelLevel;
+
+  if (max_resolution == 0) max_resolution = MaxResolution();
+  uint8_t max_resolution_level = MostSignificantBit(max_resolution);
+  if (max_resolution_level < starting_resolution_level)
+    max_resolution_level = starting_resolution_level;
+
+  // Most bounds are either well inside or well outside of the Map, so we
+  // check the Map a few levels coarser than where we start scoring pixels
+  // against the bound.  That way, those cases take only a handful of lookups.
+  uint8_t coarse_resolution_level = HPixLevel;
+  if (starting_resolution_level > HPixLevel + 3)
+    coarse_resolution_level = starting_resolution_level - 3;
+
+  uint32_t x_min, x_max, y_min, y_max;
+  if (Empty() || !_FindXYBounds(coarse_resolution_level, bound,
+				x_min, x_max, y_min, y_max)) return false;
+
+  // The pixels waiting to be resolved carry a set of flags in their weight
+  // so that the children of pixels known to be inside the bound or inside or
+  // outside of the Map don't have to repeat those checks.
+  const int inside_bound = 1;
+  const int inside_map = 2;
+  const int outside_map = 4;
+
+  PixelVector resolve_pix;
+  uint32_t resolution = Pixel::LevelToResolution(coarse_resolution_level);
+  uint32_t nx = Nx0*resolution;
+  uint32_t nx_pix;
+  if ((x_max < x_min) && (x_min > nx/2)) {
+    nx_pix = nx - x_min + x_max + 1;
   } else {
-    // we reach here often because the search area is very
-    // close to or smaller than our minimum resolvable area
-    // We don't want nrand to be less than say 20
-    nrand = 20;
+    nx_pix = x_max - x_min + 1;
   }
 
-  // get test the point as clambda,ceta
-  double clambda = ang.Lambda();
-  double ceta = ang.Eta();
+  Pixel tmp_pix;
+  tmp_pix.SetResolution(resolution);
+  tmp_pix.SetWeight(0.0);
+  for (uint32_t y=y_min;y<=y_max;y++) {
+    for (uint32_t m=0,x=x_min;m<nx_pix;m++,x++) {
+      if (x==nx) x = 0;
+      tmp_pix.SetPixnumFromXY(x,y);
+      resolve_pix.push_back(tmp_pix);
+    }
+  }
 
-  double rand_clambda=0;
-  double rand_ceta=0;
+  bool found_covered_area = false;
+  bool found_map = false;
+  std::vector<double> piece_score(n_piece);
+  for (uint8_t resolution_level=coarse_resolution_level;
+       !resolve_pix.empty();resolution_level++) {
+    PixelVector refine_pix;
 
-  // use clambda,ceta coords
-  Stomp::AngularCoordinate::Sphere sys= Stomp::AngularCoordinate::Survey;
-  AngularCoordinate tmp_ang;
-  bool quadrant_inside = true;
-  for (uint32_t i=0; i<nrand; i++) {
-    _GenerateRandLamEtaQuadrant(clambda, ceta, radius, quadrant,
-				rand_clambda, rand_ceta);
-    tmp_ang.Set(rand_clambda,rand_ceta,sys);
-    if (!Contains(tmp_ang)) {
-      quadrant_inside = false;
-      break;
+    for (PixelIterator iter=resolve_pix.begin();
+	 iter!=resolve_pix.end();++iter) {
+      int flags = static_cast<int>(iter->Weight());
+
+      int8_t unmasked_status = 0;
+      if (flags & inside_map) {
+	unmasked_status = 1;
+      } else {
+	if (!(flags & outside_map)) {
+	  unmasked_status = FindUnmaskedStatus(*iter);
+	  if (unmasked_status == 1) flags |= inside_map;
+	  if (unmasked_status == 0) flags |= outside_map;
+	}
+      }
+      if (unmasked_status != 0) found_map = true;
+
+      // Above the starting level, the pixels are too coarse to score
+      // reliably.
+      bool coarse_level = (resolution_level < starting_resolution_level);
+
+      // Pixels wholly inside the Map don't add anything to the uncovered
+      // area, so the only thing we need from them is to know that some of the
+      // bound is covered at all.  If a coarse pixel seems to miss the bound,
+      // we look again at the starting level before believing it.
+      bool refine_pixel = false;
+      if (unmasked_status == 1) {
+	if (!found_covered_area) {
+	  if ((flags & inside_bound) || (bound.ScorePixel(*iter) < -0.00001)) {
+	    found_covered_area = true;
+	  } else {
+	    refine_pixel = coarse_level;
+	  }
+	}
+	if (!refine_pixel) continue;
+      }
+
+      double score = -1.0;
+      if (!(flags & inside_bound) && !coarse_level && !refine_pixel) {
+	score = bound.ScorePixel(*iter);
+	if (score > -0.00001) continue;
+	if (score < -0.99999) {
+	  score = -1.0;
+	  flags |= inside_bound;
+	}
+      }
+
+      bool final_level = !coarse_level && (unmasked_status == -1 ?
+			  resolution_level >= max_resolution_level :
+			  resolution_level >= geometry_resolution_level);
+
+      // Now figure out which piece the pixel belongs to.  We only need the
+      // full set of piece scores if the pixel straddles more than one and we
+      // can't refine it any further.
+      int32_t piece_idx = -1;
+      if (pieces.empty()) {
+	piece_score[0] = score;
+	if ((flags & inside_bound) && !coarse_level) piece_idx = 0;
+      } else {
+	if ((flags & inside_bound) && !coarse_level) {
+	  AngularCoordinate center;
+	  iter->Ang(center);
+	  for (uint32_t q=0;(q<n_piece)&&(piece_idx==-1);q++) {
+	    if (pieces[q]->CheckPoint(center) &&
+		(pieces[q]->ScorePixel(*iter) < -0.99999)) piece_idx = q;
+	  }
+	}
+	if ((piece_idx == -1) && final_level) {
+	  for (uint32_t q=0;q<n_piece;q++)
+	    piece_score[q] = pieces[q]->ScorePixel(*iter);
+	}
+      }
+
+      if ((piece_idx != -1) || final_level) {
+	double pixel_area = iter->Area();
+	if (unmasked_status == -1) {
+	  pixel_area *= 1.0 - FindUnmaskedFraction(*iter);
+	  found_covered_area = true;
+	}
+
+	if (piece_idx != -1) {
+	  uncovered_area[piece_idx] += pixel_area;
+	} else {
+	  for (uint32_t q=0;q<n_piece;q++)
+	    uncovered_area[q] -= piece_score[q]*pixel_area;
+	}
+      } else {
+	PixelVector sub_pix;
+	iter->SubPix(iter->Resolution()*2, sub_pix);
+	for (PixelIterator sub_iter=sub_pix.begin();
+	     sub_iter!=sub_pix.end();++sub_iter) {
+	  sub_iter->SetWeight(static_cast<double>(flags));
+	  refine_pix.push_back(*sub_iter);
+	}
+      }
     }
+
+    // If none of the coarse pixels touched the Map, the bound is entirely
+    // outside of it and there's no point in resolving its geometry.
+    if (!found_map) {
+      if (pieces.empty()) {
+	uncovered_area[0] = bound.Area();
+      } else {
+	for (uint32_t q=0;q<n_piece;q++)
+	  uncovered_area[q] = pieces[q]->Area();
+      }
+      return false;
+    }
+
+    resolve_pix.swap(refine_pix);
   }
 
-  return quadrant_inside;
+  return found_covered_area;
 }
 
-void Map::_GenerateRandLamEtaQuadrant(double lambda, double eta,
+void Map::_GenerateRandLamEtaQuadrant(MTRand& mtrand,
+				      double lambda, double eta,
 				      double R, int quadrant,
 				      double& rand_lambda, double& rand_eta)
   throw (const char*) {
-  // this is crazy slow
-  //MTRand mtrand;
-  //mtrand.seed();
-
   std::stringstream err;
   double cospsi;
   double theta,phi,sintheta,costheta,sinphi,cosphi;
@@ -2187,13 +2355,10 @@ void Map::_GenerateRandLamEtaQuadrant(double lambda, double eta,
 
   // generate uniformly in R^2
   // random [0,1)
-  //rand_r = mtrand.randExc();
-  rand_r =
-    ( (double)std::rand() / ((double)(RAND_MAX)+(double)(1)) );
+  rand_r = mtrand.randExc();
   rand_r = sqrt(rand_r)*R*DegToRad;
 
-  rand_num =
-    ( (double)std::rand() / ((double)(RAND_MAX)+(double)(1)) );
+  rand_num = mtrand.randExc();
 
   // generate theta uniformly from [min_theta,min_theta+90)
   if (quadrant == -1) {
@@ -2261,77 +2426,6 @@ void Map::_GenerateRandLamEtaQuadrant(double lambda, double eta,
   rand_eta    = RadToDeg*phi2 - 180.0;
 }
 
-//
-// amin: Minimum size we want to resolve in square degrees 0.05 corresponds to
-// half an SDSS field
-//
-// pmax: probability a randomly generated point will *not* fall within our
-// smallest area amin
-bool Map::Contains(GeometricBound& bound, double area_resolution,
-		   double precision) {
-  double miss_prob = 1.0 - area_resolution/bound.Area();
-
-  uint32_t n_rand = 0;
-  if (miss_prob > 1.e-10) {
-    // how many points do we need in order for the
-    // probability of missing the hole to be pmax?
-    //      We need n such that (1-amin/a)^n = pmax
-    double points_estimate = log10(precision)/log10(miss_prob);
-    if (points_estimate < 20.0) points_estimate = 20.1;
-    if (points_estimate > 20000.0)
-      points_estimate = 20000.1;  // cap at 20000 random points
-    n_rand = static_cast<uint32_t>(points_estimate);
-  } else {
-    // we reach here often because the search area is very
-    // close to or smaller than our minimum resolvable area
-    // We don't want nrand to be less than say 20
-    n_rand = 20;
-  }
-
-  AngularCoordinate tmp_ang;
-  bool bound_inside = true;
-  for (uint32_t i=0;i<n_rand;i++) {
-    bound.GenerateRandomPoint(tmp_ang);
-    if (!Contains(tmp_ang)) {
-      bound_inside = false;
-      break;
-    }
-  }
-
-  return bound_inside;
-}
-
-double Map::FindUnmaskedFraction(GeometricBound& bound, double area_resolution,
-				 double precision) {
-  double miss_prob = 1.0 - area_resolution/bound.Area();
-
-  uint32_t n_rand = 0;
-  if (miss_prob > 1.e-10) {
-    // how many points do we need in order for the
-    // probability of missing the hole to be pmax?
-    //      We need n such that (1-amin/a)^n = pmax
-    double points_estimate = log10(precision)/log10(miss_prob);
-    if (points_estimate < 20.0) points_estimate = 20.1;
-    if (points_estimate > 20000.0)
-      points_estimate = 20000.1;  // cap at 20000 random points
-    n_rand = static_cast<uint32_t>(points_estimate);
-  } else {
-    // we reach here often because the search area is very
-    // close to or smaller than our minimum resolvable area
-    // We don't want nrand to be less than say 20
-    n_rand = 20;
-  }
-
-  AngularCoordinate tmp_ang;
-  uint32_t n_inside = 0;
-  for (uint32_t i=0;i<n_rand;i++) {
-    bound.GenerateRandomPoint(tmp_ang);
-    if (Contains(tmp_ang)) n_inside++;
-  }
-
-  return static_cast<double>(n_inside)/static_cast<double>(n_rand);
-}
-
 bool Map::Write(const std::string& OutputFile, bool hpixel_format,
 		bool weighted_map) {
   std::ofstream output_file(OutputFile.c_str());
@@ -2379,52 +2473,56 @@ bool Map::Write(const std::string& OutputFile, bool hpixel_format,
 
 bool Map::Read(const std::string& InputFile, bool hpixel_format,
 	       bool weighted_map) {
+  STOMP_SCOPED_TIMER("Map::Read");
   Clear();
 
-  std::ifstream input_file(InputFile.c_str());
+  // The columns are either HPIXNUM SUPERPIXNUM RESOLUTION [WEIGHT] or
+  // PIXNUM RESOLUTION [WEIGHT].
+  std::vector<uint8_t> columns;
+  uint8_t n_columns = (hpixel_format ? 3 : 2) + (weighted_map ? 1 : 0);
+  for (uint8_t k=0;k<n_columns;k++) columns.push_back(k);
+  uint8_t resolution_idx = (hpixel_format ? 2 : 1);
 
-  uint32_t hpixnum, superpixnum, pixnum, x, y;
-  int resolution;  // have to use an int here because of old map formats
-  double weight;
+  AsciiTable table;
   bool found_file = false;
 
-  if (input_file) {
+  if (table.Read(InputFile, columns)) {
     found_file = true;
-    while (!input_file.eof()) {
+    for (uint32_t i=0;i<table.NRows();i++) {
+      if (!table.Complete(i)) continue;
+
+      // Resolution has to be handled as a signed value because of old map
+      // formats.
+      int resolution = static_cast<int>(table.Value(i, resolution_idx));
+      if ((resolution % 2 != 0) || (resolution <= 0)) continue;
+
+      uint32_t hpixnum, superpixnum, x, y;
       if (hpixel_format) {
-	if (weighted_map) {
-	  input_file >> hpixnum >> superpixnum >> resolution >> weight;
-	} else {
-	  input_file >> hpixnum >> superpixnum >> resolution;
-	  weight = 1.0;
-	}
+	hpixnum = static_cast<uint32_t>(table.Value(i, 0));
+	superpixnum = static_cast<uint32_t>(table.Value(i, 1));
       } else {
-	if (weighted_map) {
-	  input_file >> pixnum >> resolution >> weight;
-	} else {
-	  input_file >> pixnum >> resolution;
-	  weight = 1.0;
-	}
+	Pixel::Pix2HPix(static_cast<uint32_t>(resolution),
+			static_cast<uint32_t>(table.Value(i, 0)),
+			hpixnum, superpixnum);
       }
+      double weight = (weighted_map ? table.Value(i, n_columns - 1) : 1.0);
 
-      if (!input_file.eof() && (resolution % 2 == 0) &&
-	  (resolution > 0)) {
-	if (!hpixel_format)
-	  Pixel::Pix2HPix(static_cast<uint32_t>(resolution), pixnum,
-			  hpixnum, superpixnum);
-	Pixel::HPix2XY(static_cast<uint32_t>(resolution), hpixnum, superpixnum,
-		       x, y);
-	Pixel tmp_pix(x, y, static_cast<uint32_t>(resolution), weight);
-	sub_map_[superpixnum].AddPixel(tmp_pix);
-      }
+      Pixel::HPix2XY(static_cast<uint32_t>(resolution), hpixnum, superpixnum,
+		     x, y);
+      Pixel tmp_pix(x, y, static_cast<uint32_t>(resolution), weight);
+      sub_map_[superpixnum].AddPixel(tmp_pix);
     }
+    table.Clear();
 
-    input_file.close();
+    // Each superpixel's pixels can be sorted and resolved independently.
+    ParallelFor(sub_map_.size(), DefaultThreads(), [&](uint32_t k) {
+      if (sub_map_[k].Initialized() && sub_map_[k].Unsorted())
+	sub_map_[k].Resolve();
+    });
 
     bool found_beginning = false;
     for (SubMapIterator iter=sub_map_.begin();iter!=sub_map_.end();++iter) {
       if (iter->Initialized()) {
-	if (iter->Unsorted()) iter->Resolve();
 
 	if (!found_beginning) {
 	  begin_ = MapIterator(iter->Superpixnum(), iter->Begin());
@@ -2454,12 +2552,429 @@ bool Map::Read(const std::string& InputFile, bool hpixel_format,
   return found_file;
 }
 
+// The binary map format is built from a few primitives: unsigned integers are
+// written as little-endian base-128 varints (7 bits per byte, with the high
+// bit set on all but the last byte), signed differences are zig-zag encoded
+// first so that small negative values stay short, and doubles are written as
+// their 8-byte little-endian IEEE representation.
+static const char BinaryMapMagic[] = "STOMPMAP";
+static const uint32_t BinaryMapMagicSize = 8;
+static const uint32_t BinaryMapVersion = 1;
+
+enum BinaryWeightMode {
+  UniformWeight = 0,
+  ExactWeight = 1,
+  QuantizedWeight = 2
+};
+
+static void AppendVarint(uint64_t value, std::string& buffer) {
+  while (value >= 0x80) {
+    buffer.push_back(static_cast<char>((value & 0x7f) | 0x80));
+    value >>= 7;
+  }
+  buffer.push_back(static_cast<char>(value));
+}
+
+static void AppendDouble(double value, std::string& buffer) {
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  for (int i=0;i<8;i++) buffer.push_back(static_cast<char>(bits >> 8*i));
+}
+
+static bool ReadVarint(const unsigned char*& cursor, const unsigned char* end,
+		       uint64_t& value) {
+  value = 0;
+  for (int shift=0;shift<64;shift+=7) {
+    if (cursor == end) return false;
+    uint64_t byte = *cursor++;
+    value |= (byte & 0x7f) << shift;
+    if (!(byte & 0x80)) return true;
+  }
+  return false;
+}
+
+static bool ReadDouble(const unsigned char*& cursor, const unsigned char* end,
+		       double& value) {
+  if (end - cursor < 8) return false;
+  uint64_t bits = 0;
+  for (int i=0;i<8;i++) bits |= static_cast<uint64_t>(cursor[i]) << 8*i;
+  memcpy(&value, &bits, sizeof(value));
+  cursor += 8;
+  return true;
+}
+
+bool Map::WriteBinary(const std::string& OutputFile, bool weighted_map,
+		      uint8_t weight_bits) {
+  if ((weight_bits != 0) && (weight_bits != 8) && (weight_bits != 16)) {
+    std::cout << "Stomp::Map::WriteBinary - weight_bits must be 0, 8 or 16\n";
+    return false;
+  }
+
+  std::vector<uint32_t> superpixnums;
+  for (uint32_t k=0;k<MaxSuperpixnum;k++)
+    if (sub_map_[k].Initialized()) superpixnums.push_back(k);
+
+  // The blocks are independent, so we encode them concurrently and then
+  // write them out in superpixel order.
+  std::vector<std::string> blocks(superpixnums.size());
+  ParallelFor(superpixnums.size(), DefaultThreads(), [&](uint32_t i) {
+    _EncodeSuperpixel(superpixnums[i], weighted_map, weight_bits, blocks[i]);
+  });
+
+  std::string header(BinaryMapMagic, BinaryMapMagicSize);
+  AppendVarint(BinaryMapVersion, header);
+  AppendVarint(weighted_map ? 1 : 0, header);
+  AppendVarint(superpixnums.size(), header);
+  for (uint32_t i=0;i<superpixnums.size();i++) {
+    AppendVarint(superpixnums[i], header);
+    AppendVarint(blocks[i].size(), header);
+  }
+
+  std::ofstream output_file(OutputFile.c_str(),
+			    std::ios::out | std::ios::binary);
+  if (!output_file.is_open()) {
+    std::cout << "Stomp::Map::WriteBinary - Can't open " << OutputFile <<
+      "!  No Map written\n";
+    return false;
+  }
+
+  output_file.write(header.data(), header.size());
+  for (uint32_t i=0;i<blocks.size();i++)
+    output_file.write(blocks[i].data(), blocks[i].size());
+  output_file.close();
+
+  return !output_file.fail();
+}
+
+void Map::_EncodeSuperpixel(uint32_t superpixnum, bool weighted_map,
+			    uint8_t weight_bits, std::string& block) {
+  PixelVector pix;
+  sub_map_[superpixnum].Pixels(pix);
+
+  block.clear();
+  AppendVarint(pix.size(), block);
+
+  // Count the runs of pixels at the same resolution.  Since the pixels are
+  // stored in LocalOrder, there is one run per resolution and the HPixnum
+  // differences within a run are all positive.
+  uint32_t n_runs = 0;
+  for (uint32_t i=0;i<pix.size();i++)
+    if ((i == 0) || (pix[i].Resolution() != pix[i-1].Resolution())) n_runs++;
+  AppendVarint(n_runs, block);
+
+  uint32_t i = 0;
+  while (i < pix.size()) {
+    uint32_t j = i + 1;
+    while ((j < pix.size()) && (pix[j].Resolution() == pix[i].Resolution())) j++;
+
+    AppendVarint(pix[i].Level(), block);
+    AppendVarint(j - i, block);
+    int64_t last_hpixnum = 0;
+    for (uint32_t k=i;k<j;k++) {
+      int64_t delta = static_cast<int64_t>(pix[k].HPixnum()) - last_hpixnum;
+      AppendVarint((static_cast<uint64_t>(delta) << 1) ^
+		   static_cast<uint64_t>(delta >> 63), block);
+      last_hpixnum = pix[k].HPixnum();
+    }
+    i = j;
+  }
+
+  if (!weighted_map) return;
+
+  double min_weight = sub_map_[superpixnum].MinWeight();
+  double max_weight = sub_map_[superpixnum].MaxWeight();
+  bool uniform_weight = true;
+  for (PixelIterator iter=pix.begin();iter!=pix.end();++iter) {
+    if (iter->Weight() != pix[0].Weight()) {
+      uniform_weight = false;
+      break;
+    }
+  }
+
+  if (uniform_weight) {
+    AppendVarint(UniformWeight, block);
+    AppendDouble(pix[0].Weight(), block);
+  } else if (weight_bits == 0) {
+    AppendVarint(ExactWeight, block);
+    for (PixelIterator iter=pix.begin();iter!=pix.end();++iter)
+      AppendDouble(iter->Weight(), block);
+  } else {
+    AppendVarint(QuantizedWeight, block);
+    AppendVarint(weight_bits, block);
+    AppendDouble(min_weight, block);
+    AppendDouble(max_weight, block);
+    double n_steps = static_cast<double>((1 << weight_bits) - 1);
+    double scale = n_steps/(max_weight - min_weight);
+    for (PixelIterator iter=pix.begin();iter!=pix.end();++iter) {
+      uint32_t q = static_cast<uint32_t>(
+	floor((iter->Weight() - min_weight)*scale + 0.5));
+      if (q > n_steps) q = static_cast<uint32_t>(n_steps);
+      for (uint8_t b=0;b<weight_bits;b+=8)
+	block.push_back(static_cast<char>(q >> b));
+    }
+  }
+}
+
+bool Map::ReadBinary(const std::string& InputFile, uint32_t n_threads) {
+  STOMP_SCOPED_TIMER("Map::ReadBinary");
+  Clear();
+
+  std::ifstream input_file(InputFile.c_str(), std::ios::in | std::ios::binary);
+  if (!input_file) {
+    std::cout << "Stomp::Map::ReadBinary - " << InputFile <<
+      " does not exist!.  No Map ingested\n";
+    return false;
+  }
+
+  // Pull the whole file into memory in one read; decoding is then limited by
+  // memory bandwidth rather than stream parsing.
+  input_file.seekg(0, std::ios::end);
+  std::string buffer(static_cast<size_t>(input_file.tellg()), '\0');
+  input_file.seekg(0, std::ios::beg);
+  if (!buffer.empty()) input_file.read(&buffer[0], buffer.size());
+  input_file.close();
+  STOMP_COUNT_N(BytesRead, buffer.size());
+
+  const unsigned char* cursor =
+    reinterpret_cast<const unsigned char*>(buffer.data());
+  const unsigned char* end = cursor + buffer.size();
+
+  uint64_t version, weighted_map, n_blocks;
+  if ((buffer.size() < BinaryMapMagicSize) ||
+      (buffer.compare(0, BinaryMapMagicSize, BinaryMapMagic) != 0)) {
+    std::cout << "Stomp::Map::ReadBinary - " << InputFile <<
+      " is not a binary Map file.  No Map ingested\n";
+    return false;
+  }
+  cursor += BinaryMapMagicSize;
+  if (!ReadVarint(cursor, end, version) || (version != BinaryMapVersion) ||
+      !ReadVarint(cursor, end, weighted_map) ||
+      !ReadVarint(cursor, end, n_blocks) || (n_blocks > MaxSuperpixnum)) {
+    std::cout << "Stomp::Map::ReadBinary - Bad header in " << InputFile <<
+      ".  No Map ingested\n";
+    return false;
+  }
+
+  std::vector<uint32_t> superpixnums(n_blocks);
+  std::vector<const unsigned char*> blocks(n_blocks);
+  std::vector<uint32_t> block_sizes(n_blocks);
+  std::vector<bool> seen_superpixel(MaxSuperpixnum, false);
+  uint64_t offset = 0;
+  for (uint32_t i=0;i<n_blocks;i++) {
+    uint64_t superpixnum, n_bytes;
+    if (!ReadVarint(cursor, end, superpixnum) ||
+	!ReadVarint(cursor, end, n_bytes) ||
+	(superpixnum >= MaxSuperpixnum) || seen_superpixel[superpixnum]) {
+      std::cout << "Stomp::Map::ReadBinary - Bad block index in " <<
+	InputFile << ".  No Map ingested\n";
+      return false;
+    }
+    seen_superpixel[superpixnum] = true;
+    superpixnums[i] = static_cast<uint32_t>(superpixnum);
+    block_sizes[i] = static_cast<uint32_t>(n_bytes);
+    offset += n_bytes;
+  }
+
+  if (offset != static_cast<uint64_t>(end - cursor)) {
+    std::cout << "Stomp::Map::ReadBinary - " << InputFile <<
+      " is truncated.  No Map ingested\n";
+    return false;
+  }
+  for (uint32_t i=0;i<n_blocks;i++) {
+    blocks[i] = cursor;
+    cursor += block_sizes[i];
+  }
+
+  // Each block only touches its own SubMap, so they can be filled
+  // concurrently.
+  std::vector<char> decoded(n_blocks, 0);
+  ParallelFor(n_blocks, n_threads, [&](uint32_t i) {
+    decoded[i] = _DecodeSuperpixel(superpixnums[i], weighted_map != 0,
+				   blocks[i], block_sizes[i]);
+  });
+
+  for (uint32_t i=0;i<n_blocks;i++) {
+    if (!decoded[i]) {
+      std::cout << "Stomp::Map::ReadBinary - Bad data for superpixel " <<
+	superpixnums[i] << " in " << InputFile << ".  No Map ingested\n";
+      Clear();
+      return false;
+    }
+  }
+
+  return Initialize();
+}
+
+bool Map::_DecodeSuperpixel(uint32_t superpixnum, bool weighted_map,
+			    const unsigned char* block, uint32_t n_bytes) {
+  const unsigned char* cursor = block;
+  const unsigned char* end = block + n_bytes;
+
+  uint64_t n_pixels, n_runs;
+  if (!ReadVarint(cursor, end, n_pixels) || !ReadVarint(cursor, end, n_runs))
+    return false;
+
+  PixelVector pix;
+  pix.reserve(n_pixels);
+  for (uint64_t run=0;run<n_runs;run++) {
+    uint64_t level, n_run_pixels;
+    if (!ReadVarint(cursor, end, level) ||
+	!ReadVarint(cursor, end, n_run_pixels) ||
+	(level < HPixLevel) || (level > MaxPixelLevel) ||
+	(pix.size() + n_run_pixels > n_pixels)) return false;
+
+    uint32_t resolution = static_cast<uint32_t>(1) << level;
+    uint32_t max_hpixnum =
+      (resolution/HPixResolution)*(resolution/HPixResolution);
+    int64_t hpixnum = 0;
+    for (uint64_t k=0;k<n_run_pixels;k++) {
+      uint64_t zigzag;
+      if (!ReadVarint(cursor, end, zigzag)) return false;
+      hpixnum += static_cast<int64_t>(zigzag >> 1) ^
+	-static_cast<int64_t>(zigzag & 1);
+      if ((hpixnum < 0) || (hpixnum >= max_hpixnum)) return false;
+
+      uint32_t x, y;
+      Pixel::HPix2XY(resolution, static_cast<uint32_t>(hpixnum), superpixnum,
+		     x, y);
+      pix.push_back(Pixel(x, y, resolution, 1.0));
+    }
+  }
+  if (pix.size() != n_pixels) return false;
+
+  if (weighted_map) {
+    uint64_t mode;
+    if (!ReadVarint(cursor, end, mode)) return false;
+
+    if (mode == UniformWeight) {
+      double weight;
+      if (!ReadDouble(cursor, end, weight)) return false;
+      for (PixelIterator iter=pix.begin();iter!=pix.end();++iter)
+	iter->SetWeight(weight);
+    } else if (mode == ExactWeight) {
+      for (PixelIterator iter=pix.begin();iter!=pix.end();++iter) {
+	double weight;
+	if (!ReadDouble(cursor, end, weight)) return false;
+	iter->SetWeight(weight);
+      }
+    } else if (mode == QuantizedWeight) {
+      uint64_t weight_bits;
+      double min_weight, max_weight;
+      if (!ReadVarint(cursor, end, weight_bits) ||
+	  ((weight_bits != 8) && (weight_bits != 16)) ||
+	  !ReadDouble(cursor, end, min_weight) ||
+	  !ReadDouble(cursor, end, max_weight) ||
+	  (static_cast<uint64_t>(end - cursor) < pix.size()*weight_bits/8))
+	return false;
+      double step = (max_weight - min_weight)/((1 << weight_bits) - 1);
+      for (PixelIterator iter=pix.begin();iter!=pix.end();++iter) {
+	uint32_t q = 0;
+	for (uint8_t b=0;b<weight_bits;b+=8)
+	  q |= static_cast<uint32_t>(*cursor++) << b;
+	iter->SetWeight(min_weight + q*step);
+      }
+    } else {
+      return false;
+    }
+  }
+  if (cursor != end) return false;
+
+  for (PixelIterator iter=pix.begin();iter!=pix.end();++iter)
+    sub_map_[superpixnum].AddPixel(*iter);
+  sub_map_[superpixnum].Resolve();
+
+  return true;
+}
+
 bool Map::PixelizeBound(GeometricBound& bound, double weight,
-			uint32_t maximum_resolution) {
-  bool pixelized_map = false;
+			uint32_t maximum_resolution, uint32_t n_threads) {
+  Clear();
 
+  PixelVector kept_pix;
+  if (!_PixelizeBound(bound, weight, maximum_resolution, kept_pix, n_threads))
+    return false;
+
+  Initialize(kept_pix);
+
+  return true;
+}
+
+bool Map::PixelizeBounds(std::vector<GeometricBound*>& bounds, double weight,
+			 uint32_t maximum_resolution, uint32_t n_threads) {
   Clear();
 
+  // With plenty of bounds, each thread pixelizes its own bound; otherwise,
+  // the threads share the work on one bound at a time.  The bounds are done
+  // in batches, with the pixels from each batch added straight to the
+  // SubMaps.  Any SubMap that has grown substantially since it was last
+  // resolved is resolved again before the next batch, which keeps the
+  // overlapping pixels from piling up.
+  uint32_t batch_size = 1, bound_threads = n_threads;
+  if (bounds.size() >= 2*n_threads) {
+    batch_size = 4*n_threads;
+    bound_threads = 1;
+  }
+
+  bool pixelized_bounds = true;
+  std::vector<PixelVector> batch_pix(batch_size);
+  std::vector<uint8_t> batch_success(batch_size, 0);
+  std::vector<uint32_t> resolved_size(MaxSuperpixnum, 0);
+  for (uint32_t batch_start=0;batch_start<bounds.size();
+       batch_start+=batch_size) {
+    uint32_t n_batch = bounds.size() - batch_start;
+    if (n_batch > batch_size) n_batch = batch_size;
+
+    ParallelFor(n_batch, bound_threads == 1 ? n_threads : 1,
+		[&](uint32_t i) {
+      batch_pix[i].clear();
+      batch_success[i] = _PixelizeBound(*bounds[batch_start + i], weight,
+					maximum_resolution, batch_pix[i],
+					bound_threads) ? 1 : 0;
+    });
+
+    for (uint32_t i=0;i<n_batch;i++)
+      if (batch_success[i] == 0) pixelized_bounds = false;
+
+    _IngestPixelBatch(batch_pix, resolved_size, n_threads);
+  }
+
+  ParallelFor(MaxSuperpixnum, n_threads, [&](uint32_t k) {
+    if (sub_map_[k].Initialized() && sub_map_[k].Unsorted())
+      sub_map_[k].Resolve();
+  });
+
+  if (!Initialize()) pixelized_bounds = false;
+
+  return pixelized_bounds;
+}
+
+void Map::_IngestPixelBatch(std::vector<PixelVector>& batch_pix,
+			    std::vector<uint32_t>& resolved_size,
+			    uint32_t n_threads) {
+  for (std::vector<PixelVector>::iterator pix_iter=batch_pix.begin();
+       pix_iter!=batch_pix.end();++pix_iter) {
+    for (PixelIterator iter=pix_iter->begin();iter!=pix_iter->end();++iter)
+      sub_map_[iter->Superpixnum()].AddPixel(*iter);
+    pix_iter->clear();
+  }
+
+  // SubMap::Size counts every pixel added since the last Resolve, so we
+  // compare against the size the SubMap had right after that Resolve.
+  // Doubling the threshold each time keeps the total resolving work
+  // proportional to the final number of pixels.
+  ParallelFor(MaxSuperpixnum, n_threads, [&](uint32_t k) {
+    uint32_t threshold = resolved_size[k] +
+      std::max<uint32_t>(1024, resolved_size[k]);
+    if (sub_map_[k].Size() > threshold) {
+      sub_map_[k].Resolve();
+      resolved_size[k] = sub_map_[k].Size();
+    }
+  });
+}
+
+bool Map::_PixelizeBound(GeometricBound& bound, double weight,
+			 uint32_t maximum_resolution, PixelVector& kept_pix,
+			 uint32_t n_threads) {
   uint8_t max_resolution_level = MostSignificantBit(maximum_resolution);
 
   uint8_t starting_resolution_level =
@@ -2484,134 +2999,158 @@ bool Map::PixelizeBound(GeometricBound& bound, double weight,
   //  static_cast<int>(max_resolution_level) << "...\n";
 
   uint32_t x_min, x_max, y_min, y_max;
-  if (_FindXYBounds(starting_resolution_level, bound,
-		    x_min, x_max, y_min, y_max)) {
-
-    PixelVector resolve_pix, previous_pix, kept_pix;
-    double pixel_area = 0.0;
-
-    for (uint8_t resolution_level=starting_resolution_level;
-         resolution_level<=max_resolution_level;resolution_level++) {
-      uint32_t resolution = Pixel::LevelToResolution(resolution_level);
-
-      unsigned n_keep = 0;
-      uint32_t nx = Nx0*resolution;
-      Pixel tmp_pix;
-      tmp_pix.SetResolution(resolution);
-      double unit_area = tmp_pix.Area();
-
-      double score;
-      AngularCoordinate ang;
-
-      if (resolution_level == starting_resolution_level) {
-        resolve_pix.clear();
-        previous_pix.clear();
+  if (!_FindXYBounds(starting_resolution_level, bound,
+		     x_min, x_max, y_min, y_max)) return false;
+
+  PixelVector resolve_pix, previous_pix;
+  double pixel_area = 0.0;
+
+  // At each level, the candidate pixels are scored in blocks on separate
+  // threads.  Each block keeps its own lists of fully and partially
+  // contained pixels and we merge them back together in block order, so the
+  // results are identical to scoring the candidates one after another.
+  const uint32_t block_size = 1024;
+  std::vector<PixelVector> block_kept, block_resolve;
+  auto score_pixel = [&](Pixel& tmp_pix, PixelVector& kept,
+			 PixelVector& resolve) {
+    double score = bound.ScorePixel(tmp_pix);
+
+    if (score < -0.99999) {
+      tmp_pix.SetWeight(weight);
+      kept.push_back(tmp_pix);
+    } else {
+      if (score < -0.00001) {
+	tmp_pix.SetWeight(score);
+	resolve.push_back(tmp_pix);
+      }
+    }
+  };
+  auto merge_blocks = [&](uint32_t n_block, double unit_area) {
+    for (uint32_t block=0;block<n_block;block++) {
+      for (PixelIterator iter=block_kept[block].begin();
+	   iter!=block_kept[block].end();++iter) {
+	kept_pix.push_back(*iter);
+	pixel_area += unit_area;
+      }
+      resolve_pix.insert(resolve_pix.end(), block_resolve[block].begin(),
+			 block_resolve[block].end());
+      block_kept[block].clear();
+      block_resolve[block].clear();
+    }
+  };
 
-        uint32_t nx_pix;
-        if ((x_max < x_min) && (x_min > nx/2)) {
-          nx_pix = nx - x_min + x_max + 1;
-        } else {
-          nx_pix = x_max - x_min + 1;
-        }
+  for (uint8_t resolution_level=starting_resolution_level;
+       resolution_level<=max_resolution_level;resolution_level++) {
+    uint32_t resolution = Pixel::LevelToResolution(resolution_level);
 
-        for (uint32_t y=y_min;y<=y_max;y++) {
-          for (uint32_t m=0,x=x_min;m<nx_pix;m++,x++) {
-            if (x==nx) x = 0;
-            tmp_pix.SetPixnumFromXY(x,y);
+    uint32_t nx = Nx0*resolution;
+    Pixel tmp_pix;
+    tmp_pix.SetResolution(resolution);
+    double unit_area = tmp_pix.Area();
 
-            score = bound.ScorePixel(tmp_pix);
+    if (resolution_level == starting_resolution_level) {
+      resolve_pix.clear();
+      previous_pix.clear();
 
-            if (score < -0.99999) {
-              tmp_pix.SetWeight(weight);
-              kept_pix.push_back(tmp_pix);
-	      pixel_area += unit_area;
-              n_keep++;
-            } else {
-              if (score < -0.00001) {
-                tmp_pix.SetWeight(score);
-                resolve_pix.push_back(tmp_pix);
-              }
-            }
-            previous_pix.push_back(tmp_pix);
-          }
-        }
+      uint32_t nx_pix;
+      if ((x_max < x_min) && (x_min > nx/2)) {
+	nx_pix = nx - x_min + x_max + 1;
       } else {
-        if (resolve_pix.size() == 0) {
-          std::cout << "Stomp::Map::PixelizeBound - " <<
-	    "Missed all pixels in initial search; trying again...\n";
-          for (PixelIterator iter=previous_pix.begin();
-               iter!=previous_pix.end();++iter) {
-            PixelVector sub_pix;
-            iter->SubPix(resolution,sub_pix);
-            for (PixelIterator sub_iter=sub_pix.begin();
-                 sub_iter!=sub_pix.end();++sub_iter)
-              resolve_pix.push_back(*sub_iter);
-          }
-        }
-
-        previous_pix.clear();
-
-	previous_pix.reserve(resolve_pix.size());
-        for (PixelIterator iter=resolve_pix.begin();
-             iter!=resolve_pix.end();++iter) previous_pix.push_back(*iter);
-
-        resolve_pix.clear();
-
-        uint32_t x_min, x_max, y_min, y_max;
-
-        for (PixelIterator iter=previous_pix.begin();
-             iter!=previous_pix.end();++iter) {
-
-          iter->SubPix(resolution,x_min,x_max,y_min,y_max);
+	nx_pix = x_max - x_min + 1;
+      }
 
-          for (uint32_t y=y_min;y<=y_max;y++) {
-            for (uint32_t x=x_min;x<=x_max;x++) {
-              tmp_pix.SetPixnumFromXY(x,y);
+      // The candidates are the pixels in the x-y box, in row order.
+      uint32_t n_candidate = (y_max - y_min + 1)*nx_pix;
+      uint32_t n_block = n_candidate/block_size + 1;
+      block_kept.resize(n_block);
+      block_resolve.resize(n_block);
+      ParallelFor(n_block, n_threads, [&](uint32_t block) {
+	Pixel block_pix;
+	block_pix.SetResolution(resolution);
+	uint32_t end = (block + 1)*block_size;
+	if (end > n_candidate) end = n_candidate;
+	for (uint32_t i=block*block_size;i<end;i++) {
+	  uint32_t x = x_min + i % nx_pix;
+	  if (x >= nx) x -= nx;
+	  block_pix.SetPixnumFromXY(x, y_min + i/nx_pix);
+	  score_pixel(block_pix, block_kept[block], block_resolve[block]);
+	}
+      });
+      merge_blocks(n_block, unit_area);
+
+      // We hang on to the full set of candidates in case none of them were
+      // even partially inside the bound.
+      previous_pix.reserve(n_candidate);
+      for (uint32_t y=y_min;y<=y_max;y++) {
+	for (uint32_t m=0,x=x_min;m<nx_pix;m++,x++) {
+	  if (x==nx) x = 0;
+	  tmp_pix.SetPixnumFromXY(x,y);
+	  previous_pix.push_back(tmp_pix);
+	}
+      }
+    } else {
+      if (resolve_pix.size() == 0) {
+	std::cout << "Stomp::Map::PixelizeBound - " <<
+	  "Missed all pixels in initial search; trying again...\n";
+	for (PixelIterator iter=previous_pix.begin();
+	     iter!=previous_pix.end();++iter) {
+	  PixelVector sub_pix;
+	  iter->SubPix(resolution,sub_pix);
+	  for (PixelIterator sub_iter=sub_pix.begin();
+	       sub_iter!=sub_pix.end();++sub_iter)
+	    resolve_pix.push_back(*sub_iter);
+	}
+      }
 
-              score = bound.ScorePixel(tmp_pix);
+      previous_pix.swap(resolve_pix);
+      resolve_pix.clear();
 
-              if (score < -0.99999) {
-                tmp_pix.SetWeight(weight);
-		kept_pix.push_back(tmp_pix);
-		pixel_area += unit_area;
-                n_keep++;
-              } else {
-                if (score < -0.00001) {
-                  tmp_pix.SetWeight(score);
-                  resolve_pix.push_back(tmp_pix);
-                }
-              }
-            }
-          }
-        }
-      }
+      // Here the candidates are the sub-pixels of each of the partially
+      // contained pixels from the previous level.
+      uint32_t n_block = previous_pix.size()/block_size + 1;
+      block_kept.resize(n_block);
+      block_resolve.resize(n_block);
+      ParallelFor(n_block, n_threads, [&](uint32_t block) {
+	Pixel block_pix;
+	block_pix.SetResolution(resolution);
+	uint32_t end = (block + 1)*block_size;
+	if (end > previous_pix.size()) end = previous_pix.size();
+	for (uint32_t i=block*block_size;i<end;i++) {
+	  uint32_t sub_x_min, sub_x_max, sub_y_min, sub_y_max;
+	  previous_pix[i].SubPix(resolution, sub_x_min, sub_x_max,
+				 sub_y_min, sub_y_max);
+	  for (uint32_t y=sub_y_min;y<=sub_y_max;y++) {
+	    for (uint32_t x=sub_x_min;x<=sub_x_max;x++) {
+	      block_pix.SetPixnumFromXY(x,y);
+	      score_pixel(block_pix, block_kept[block], block_resolve[block]);
+	    }
+	  }
+	}
+      });
+      merge_blocks(n_block, unit_area);
     }
+  }
 
-    previous_pix.clear();
+  previous_pix.clear();
 
-    if (bound.Area() > pixel_area) {
-      sort(resolve_pix.begin(), resolve_pix.end(), Pixel::WeightedOrder);
+  if ((bound.Area() > pixel_area) && !resolve_pix.empty()) {
+    sort(resolve_pix.begin(), resolve_pix.end(), Pixel::WeightedOrder);
 
-      uint32_t n=0;
-      double ur_weight = resolve_pix[n].Weight();
-      double unit_area = resolve_pix[n].Area();
-      while ((n < resolve_pix.size()) &&
-             ((bound.Area() > pixel_area) ||
-              DoubleEQ(resolve_pix[n].Weight(), ur_weight))) {
-        ur_weight = resolve_pix[n].Weight();
-        resolve_pix[n].SetWeight(weight);
-	kept_pix.push_back(resolve_pix[n]);
-	pixel_area += unit_area;
-        n++;
-      }
+    uint32_t n=0;
+    double ur_weight = resolve_pix[n].Weight();
+    double unit_area = resolve_pix[n].Area();
+    while ((n < resolve_pix.size()) &&
+	   ((bound.Area() > pixel_area) ||
+	    DoubleEQ(resolve_pix[n].Weight(), ur_weight))) {
+      ur_weight = resolve_pix[n].Weight();
+      resolve_pix[n].SetWeight(weight);
+      kept_pix.push_back(resolve_pix[n]);
+      pixel_area += unit_area;
+      n++;
     }
-
-    Initialize(kept_pix);
-
-    pixelized_map = true;
   }
 
-  return pixelized_map;
+  return true;
 }
 
 uint8_t Map::_FindStartingResolutionLevel(double bound_area) {
@@ -3352,4 +3891,143 @@ uint32_t Map::PixelCount(uint32_t resolution) {
 }
 
 
+MapSampler::MapSampler(Map& stomp_map, bool use_weighted_sampling) {
+  // Same weighting as the old rejection sampler: points are accepted with a
+  // probability that rises linearly from 1/(weight range + 1) at the minimum
+  // Map weight to 1 at the maximum weight.
+  double min_weight = stomp_map.MinWeight();
+  double max_weight = stomp_map.MaxWeight();
+  double minimum_probability = 1.0;
+  double probability_slope = 0.0;
+  if (use_weighted_sampling && (max_weight - min_weight >= 0.0001)) {
+    minimum_probability = 1.0/(max_weight - min_weight + 1.0);
+    probability_slope =
+      (1.0 - minimum_probability)/(max_weight - min_weight);
+  }
+
+  PixelVector pix;
+  stomp_map.Pixels(pix);
+
+  uint32_t n_pixel = pix.size();
+  z_min_.reserve(n_pixel);
+  z_height_.reserve(n_pixel);
+  eta_min_.reserve(n_pixel);
+  eta_width_.reserve(n_pixel);
+
+  std::vector<double> mass;
+  mass.reserve(n_pixel);
+  double total_mass = 0.0;
+  for (PixelIterator iter=pix.begin();iter!=pix.end();++iter) {
+    double z_min = sin(iter->LambdaMin()*DegToRad);
+    double z_max = sin(iter->LambdaMax()*DegToRad);
+    double eta_min = iter->EtaMin();
+    double eta_max = iter->EtaMax();
+    if (eta_min > eta_max) eta_min -= 360.0;
+
+    z_min_.push_back(z_min);
+    z_height_.push_back(z_max - z_min);
+    eta_min_.push_back(eta_min);
+    eta_width_.push_back(eta_max - eta_min);
+
+    double probability = minimum_probability +
+      (iter->Weight() - min_weight)*probability_slope;
+    mass.push_back(probability > 0.0 ? iter->Area()*probability : 0.0);
+    total_mass += mass.back();
+  }
+
+  // Vose's alias method: scale the masses so that they average to 1, then
+  // pair each under-full column with an over-full one that tops it up.
+  probability_.assign(n_pixel, 1.0);
+  alias_.resize(n_pixel);
+  if (total_mass <= 0.0) {
+    z_min_.clear();
+    z_height_.clear();
+    eta_min_.clear();
+    eta_width_.clear();
+    probability_.clear();
+    alias_.clear();
+    return;
+  }
+
+  std::vector<uint32_t> small, large;
+  for (uint32_t i=0;i<n_pixel;i++) {
+    mass[i] *= n_pixel/total_mass;
+    alias_[i] = i;
+    if (mass[i] < 1.0) {
+      small.push_back(i);
+    } else {
+      large.push_back(i);
+    }
+  }
+
+  while (!small.empty() && !large.empty()) {
+    uint32_t s = small.back();
+    uint32_t l = large.back();
+    small.pop_back();
+
+    probability_[s] = mass[s];
+    alias_[s] = l;
+    mass[l] -= 1.0 - mass[s];
+    if (mass[l] < 1.0) {
+      large.pop_back();
+      small.push_back(l);
+    }
+  }
+
+  // Anything left over is full to within round-off.
+  for (uint32_t i=0;i<small.size();i++) probability_[small[i]] = 1.0;
+  for (uint32_t i=0;i<large.size();i++) probability_[large[i]] = 1.0;
+}
+
+MapSampler::~MapSampler() {
+  z_min_.clear();
+  z_height_.clear();
+  eta_min_.clear();
+  eta_width_.clear();
+  probability_.clear();
+  alias_.clear();
+}
+
+void MapSampler::GenerateRandomPoint(MTRand& mtrand, AngularCoordinate& ang) {
+  uint32_t i = mtrand.randInt(Size() - 1);
+  if (mtrand.randExc() >= probability_[i]) i = alias_[i];
+
+  double z = z_min_[i] + mtrand.rand(z_height_[i]);
+  double eta = eta_min_[i] + mtrand.rand(eta_width_[i]);
+  ang.SetSurveyCoordinates(asin(z)*RadToDeg, eta);
+  STOMP_COUNT(RandomPointsGenerated);
+}
+
+void MapSampler::GenerateRandomPoints(AngularVector& ang, uint32_t n_point,
+				      uint32_t seed, uint32_t n_threads) {
+  if (!ang.empty()) ang.clear();
+  if (Empty()) return;
+
+  if (seed == 0) {
+    MTRand mtrand;
+    mtrand.seed();
+    seed = mtrand.randInt();
+  }
+
+  const uint32_t block_size = 65536;
+  uint32_t n_block = (n_point + block_size - 1)/block_size;
+  ang.resize(n_point);
+
+  ParallelFor(n_block, n_threads, [&](uint32_t block) {
+    MTRand mtrand(seed + 2654435761u*block);
+    uint32_t end = (block + 1)*block_size;
+    if (end > n_point) end = n_point;
+    for (uint32_t m=block*block_size;m<end;m++)
+      GenerateRandomPoint(mtrand, ang[m]);
+  });
+}
+
+uint32_t MapSampler::Size() {
+  return probability_.size();
+}
+
+bool MapSampler::Empty() {
+  return probability_.empty();
+}
+
 } // end namespace Stomp
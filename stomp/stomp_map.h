@@ -55,8 +55,10 @@ namespace Stomp {
 class AngularCoordinate;  // class declaration in stomp_angular_coordinate.h
 class Pixel;              // class declaration in stomp_pixel.h
 class GeometricBound;     // class declaration in stomp_geometry.h
+class PointCatalog;       // class declaration in stomp_point_catalog.h
 class SubMap;
 class Map;
+class MapSampler;
 
 typedef std::map<uint32_t, uint32_t> ResolutionDict;
 typedef ResolutionDict::iterator ResolutionIterator;
@@ -126,6 +128,11 @@ class SubMap {
   uint32_t PixelCount(uint32_t resolution);
 
  private:
+  // Pixels are stored in SuperPixelBasedOrder, so the pixels at a given level
+  // that are inside pix fall between its first and last sub-pixels at that
+  // level.  This returns that range.
+  PixelPair _FindSubPixelRange(Pixel& pix, uint8_t level);
+
   uint32_t superpixnum_, size_;
   PixelVector pix_;
   double area_, lambda_min_, lambda_max_, eta_min_, eta_max_, z_min_, z_max_;
@@ -203,6 +210,14 @@ class Map : public BaseMap {
   bool Contains(Pixel& pix);
   bool Contains(Map& stomp_map);
 
+  // The PointCatalog version checks every point in the catalog, splitting
+  // them over n_threads threads.  On return, inside holds a flag for each
+  // point (1 if it is within the Map, 0 if not) and the return value is the
+  // number of points within the Map.  The flags can go straight into
+  // PointCatalog::Select to trim the catalog to the Map.
+  uint32_t Contains(PointCatalog& catalog, std::vector<uint8_t>& inside,
+		    uint32_t n_threads = DefaultThreads());
+
   // Given a Pixel, this returns the fraction of that pixel's area that is
   // contained within the current map (0 <= fraction <= 1).  Alternatively, a
   // vector of pixels can be processed in a single call, in which case a
@@ -317,6 +332,10 @@ class Map : public BaseMap {
   // with the same area but twice the weight as another pixel should, in the
   // limit of infinite realizations, have twice as many points as the
   // lower-weighted one.
+  //
+  // All of these methods draw their points with a MapSampler (see below).
+  // If you need several sets of random points from the same Map, it is
+  // cheaper to make a MapSampler once and use it directly.
   void GenerateRandomPoints(AngularVector& ang,
                             uint32_t n_point = 1,
                             bool use_weighted_sampling = false,
@@ -334,6 +353,8 @@ class Map : public BaseMap {
 			    bool use_weighted_sampling = false, uint32_t seed = 0);
   void GenerateRandomPoints(CosmoVector& ang, CosmoVector& input_ang,
 			    bool use_weighted_sampling = false, uint32_t seed = 0);
+  void GenerateRandomPoints(PointCatalog& catalog, PointCatalog& input_catalog,
+			    bool use_weighted_sampling = false, uint32_t seed = 0);
 
   //Like the above methods but only returns a single random angular point on
   //the map. Boolien is used to return the weight of the map at the random
@@ -343,25 +364,34 @@ class Map : public BaseMap {
 				 bool use_weighted_sampling = false);
 
   // This version returns numerical python arrays in a tuple
-  // Requires python and numpy support
+  // Requires python and numpy support.  All of the numpy methods release the
+  // GIL once their input and output arrays are in hand and split the work
+  // over n_threads threads.  Input arrays that are already native-endian
+  // doubles are used in place rather than copied.  As with MapSampler, a
+  // given non-zero seed produces the same points for any thread count.
 #ifdef WITH_NUMPY
   // This is the generic function
   PyObject* GenerateRandomPoints(uint32_t n_point,
 				 Stomp::AngularCoordinate::Sphere systemid,
-				 bool use_weighted_sampling=false, uint32_t seed=0)
+				 bool use_weighted_sampling=false, uint32_t seed=0,
+				 uint32_t n_threads=DefaultThreads())
     throw (const char*);
   // overloaded for string system name
   PyObject* GenerateRandomPoints(uint32_t n_point, const std::string& system,
-				 bool use_weighted_sampling=false, uint32_t seed=0)
+				 bool use_weighted_sampling=false, uint32_t seed=0,
+				 uint32_t n_threads=DefaultThreads())
     throw (const char*);
   PyObject* GenerateRandomEq(uint32_t n_point,
-			     bool use_weighted_sampling = false, uint32_t seed = 0)
+			     bool use_weighted_sampling = false, uint32_t seed = 0,
+			     uint32_t n_threads = DefaultThreads())
     throw (const char*);
   PyObject* GenerateRandomSurvey(uint32_t n_point,
-				 bool use_weighted_sampling = false, uint32_t seed = 0)
+				 bool use_weighted_sampling = false, uint32_t seed = 0,
+				 uint32_t n_threads = DefaultThreads())
     throw (const char*);
   PyObject* GenerateRandomGal(uint32_t n_point,
-			      bool use_weighted_sampling = false, uint32_t seed = 0)
+			      bool use_weighted_sampling = false, uint32_t seed = 0,
+			      uint32_t n_threads = DefaultThreads())
     throw (const char*);
 
 
@@ -369,11 +399,13 @@ class Map : public BaseMap {
   // input lambda,eta lambda,eta,R in degrees, quadrante in [0,3]
   PyObject* GenerateRandomQuadrantPointsSurvey(
       double lambda_center, double eta_center, double R, uint32_t n_point,
-      int quadrant=-1) throw (const char*);
+      int quadrant=-1, uint32_t seed=0, uint32_t n_threads=DefaultThreads())
+    throw (const char*);
 
   // radius in degrees
   PyObject* Contains(PyObject* x1obj,PyObject* x2obj,const std::string& system,
-      PyObject* radobj=NULL) throw (const char* );
+      PyObject* radobj=NULL, uint32_t n_threads=DefaultThreads())
+    throw (const char* );
 
 
 #endif
@@ -384,33 +416,66 @@ class Map : public BaseMap {
   static int THIRD_QUADRANT_OK;
   static int FOURTH_QUADRANT_OK;
 
-  // Check four quadrants using a monte carlo technique
-  // radius in degrees
-  int QuadrantsContainedMC(AngularCoordinate& ang, double radius,
-          Stomp::AngularCoordinate::Sphere coord_system) throw (const char*);
-
+  // Check the four quadrants of a circle around ang, returning the
+  // bitmask of quadrants (FIRST_QUADRANT_OK, etc.) that are wholly within
+  // our Map.  Position angles are measured in the input coordinate system and
+  // the radius is in degrees.
+  int QuadrantsContained(AngularCoordinate& ang, double radius,
+          AngularCoordinate::Sphere coord_system = AngularCoordinate::Survey);
 
-  // check a single quadrant
+  // check a single quadrant, quadrant in [0,3]
   // radius in degrees
-  bool QuadrantContainedMC(AngularCoordinate& ang, double radius,
-          int quadrant) throw (const char*);
-
-
-  // Depending on our precision requirements, it can occasionally be faster to
-  // use Monte Carlo sampling to find out if a given region is within our Map.
-  // The first method takes a GeometricBound object and a size resolution (in
-  // square degrees) and returns a boolean indicating whether or not the input
-  // object is wholely contained in the map.  The precision value is the
-  // probability that we would miss an hole of area_resolution in our sampling.
-  bool Contains(GeometricBound& bound, double area_resolution = 0.5,
-		double precision = 0.01);
-
-  // Alternatively, we can attempt to estimate the fraction of the bound object
-  // that is within our Map, under the same sampling limitations.
+  bool QuadrantContained(AngularCoordinate& ang, double radius, int quadrant,
+          AngularCoordinate::Sphere coord_system = AngularCoordinate::Survey);
+
+  // To find out how much of a GeometricBound is within our Map, we pixelize
+  // the bound the same way PixelizeBound does, scoring the pixels with
+  // ScorePixel, and check each pixel against our SubMaps as we go.  Pixels
+  // wholly inside the Map or outside the bound are dropped, pixels outside
+  // the Map and inside the bound are added to the uncovered area and only the
+  // pixels straddling an edge are refined.  Refinement along the edge of the
+  // Map stops at max_resolution (the Map's maximum resolution by default),
+  // after which the remaining edge pixels are weighted by their score.  The
+  // result is deterministic and exact to that resolution.
+  // FindUnmaskedFraction returns the fraction of the bound in our Map and
+  // Contains returns true if that fraction is 1.
+  bool Contains(GeometricBound& bound, uint32_t max_resolution = 0);
   double FindUnmaskedFraction(GeometricBound& bound,
-			      double area_resolution = 0.5,
+			      uint32_t max_resolution = 0);
+
+  // Deprecated versions of the above from when these were Monte Carlo
+  // estimates, kept so that existing calls keep their meaning.  Holes smaller
+  // than area_resolution (in square degrees) could go unnoticed, so the Map
+  // edge is only refined to the first resolution whose pixels are no larger
+  // than that.  The answer is no longer sampled, so precision is ignored.
+  bool Contains(GeometricBound& bound, double area_resolution,
+		double precision = 0.01);
+  double FindUnmaskedFraction(GeometricBound& bound, double area_resolution,
 			      double precision = 0.01);
 
+  // For circles, the same pass also gives us the unmasked fraction of each
+  // quadrant (position angles [0,90), [90,180), etc. in the input coordinate
+  // system).  quadrant_fraction is resized to 4 and the return value is the
+  // unmasked fraction of the whole circle.
+  double FindQuadrantFractions(AngularCoordinate& ang, double radius,
+			       std::vector<double>& quadrant_fraction,
+			       AngularCoordinate::Sphere coord_system =
+			       AngularCoordinate::Survey,
+			       uint32_t max_resolution = 0);
+
+  // And the batch version for large catalogs.  The radius vector can either
+  // match the length of ang or have a single entry used for every circle.
+  // unmasked_fraction gets one value per circle and quadrant_fraction four,
+  // with quadrant_fraction[4*i+q] for quadrant q of circle i.  The circles are
+  // split across n_threads threads.
+  bool FindQuadrantFractions(AngularVector& ang, std::vector<double>& radius,
+			     std::vector<double>& unmasked_fraction,
+			     std::vector<double>& quadrant_fraction,
+			     AngularCoordinate::Sphere coord_system =
+			     AngularCoordinate::Survey,
+			     uint32_t max_resolution = 0,
+			     uint32_t n_threads = DefaultThreads());
+
   // The book-end to the initialization method that takes an ASCII filename
   // as an argument, this method writes the current map to an ASCII file using
   // the same formatting conventions.
@@ -422,6 +487,22 @@ class Map : public BaseMap {
   bool Read(const std::string& InputFile, const bool hpixel_format = true,
 	    const bool weighted_map = true);
 
+  // The ASCII format is simple, but large high-resolution maps are slow to
+  // parse and take up far more disk than they need to.  The binary format
+  // stores each superpixel as an independent block: runs of pixels at the
+  // same resolution are written as varint-encoded differences between
+  // successive HPixnum values and the weights are stored either as a single
+  // value (for uniformly weighted superpixels), as exact doubles or, if
+  // weight_bits is 8 or 16, quantized to that many bits between the minimum
+  // and maximum weight in the block.  Setting weighted_map to false drops the
+  // weights entirely and they are read back as 1.0.  A block index at the
+  // start of the file lets ReadBinary decode the superpixels in parallel on
+  // n_threads threads (defaulting to one per core).
+  bool WriteBinary(const std::string& OutputFile, bool weighted_map = true,
+		   uint8_t weight_bits = 0);
+  bool ReadBinary(const std::string& InputFile,
+		  uint32_t n_threads = DefaultThreads());
+
   // Another option for specifying the Map geometry is to use a GeometricBound
   // object.  This translates from the analytic region described in the
   // GeometricBound to a pixel-based version that we can use as a basis for a
@@ -429,9 +510,22 @@ class Map : public BaseMap {
   // maximum_resolution value controls the level of Map fidelity to the
   // GeometricBound's area (although higher fidelity comes at the expense of
   // more pixels).  The return value indicates success or failure of the
-  // translation.
+  // translation.  The pixels at each resolution level are scored against the
+  // bound on up to n_threads threads.
   bool PixelizeBound(GeometricBound& bound, double weight = 1.0,
-		     uint32_t maximum_resolution = MaxPixelResolution);
+		     uint32_t maximum_resolution = MaxPixelResolution,
+		     uint32_t n_threads = DefaultThreads());
+
+  // When the footprint is made up of many bounds (a mask of thousands of
+  // circles, say), PixelizeBounds pixelizes each of them in the same way and
+  // makes the Map from the union of the results, collecting the pixels by
+  // superpixel as it goes rather than building a Map for each bound and
+  // adding them together.  The Map has a uniform weight.  The return value
+  // is false if any of the bounds couldn't be pixelized, although the rest
+  // of them are still included in the Map.
+  bool PixelizeBounds(std::vector<GeometricBound*>& bounds, double weight = 1.0,
+		      uint32_t maximum_resolution = MaxPixelResolution,
+		      uint32_t n_threads = DefaultThreads());
 
   // The pixelization method is iteratively adaptive.  First, it tries to find
   // the largest pixels that will likely fit inside the footprint.  Then it
@@ -441,8 +535,22 @@ class Map : public BaseMap {
   // reach the maximum resolution level, at which point we keep enough of the
   // partials to match the footprint's area, preferentially keeping those
   // pixels that are most contained by the bound.  These internal methods
-  // handle this process.
+  // handle this process, with _PixelizeBound doing the work for both
+  // PixelizeBound and PixelizeBounds.
+  bool _PixelizeBound(GeometricBound& bound, double weight,
+		      uint32_t maximum_resolution, PixelVector& kept_pix,
+		      uint32_t n_threads);
   uint8_t _FindStartingResolutionLevel(double bound_area);
+
+  // PixelizeBounds adds the pixels from each batch of bounds with
+  // _IngestPixelBatch, which empties the input vectors into the SubMaps and
+  // then resolves any SubMap that has at least doubled in size (or grown by
+  // 1024 pixels, whichever is more) since it was last resolved.
+  // resolved_size holds the size of each SubMap after its last Resolve and
+  // should start out as MaxSuperpixnum zeros.
+  void _IngestPixelBatch(std::vector<PixelVector>& batch_pix,
+			 std::vector<uint32_t>& resolved_size,
+			 uint32_t n_threads);
   bool _FindXYBounds(const uint8_t resolution_level,
 		     GeometricBound& bound,
 		     uint32_t& x_min, uint32_t& x_max,
@@ -550,10 +658,30 @@ class Map : public BaseMap {
 private:
 
   // generate a random point in the specified quadrant in sdss survey
-  // coordinates
+  // coordinates, drawing from the input generator so that each thread can
+  // carry its own stream.
   // lambda, eta, R in degrees. quadrant in [0,3]
-  void _GenerateRandLamEtaQuadrant(double lambda, double eta, double R,
-      int quadrant, double& rand_lambda, double& rand_eta) throw (const char*);
+  void _GenerateRandLamEtaQuadrant(MTRand& mtrand, double lambda, double eta,
+      double R, int quadrant, double& rand_lambda, double& rand_eta)
+    throw (const char*);
+
+  // The engine behind the coverage methods.  Only the parts of the bound
+  // outside our Map need to be pixelized, so this returns the uncovered area
+  // of the bound in the first element of uncovered_area, or, if pieces isn't
+  // empty, the uncovered area of each piece.  The pieces should be disjoint
+  // bounds that tile the input bound.  The return value indicates whether any
+  // of the bound was inside the Map at all.
+  bool _FindUncoveredArea(GeometricBound& bound,
+			  std::vector<GeometricBound*>& pieces,
+			  uint32_t max_resolution,
+			  std::vector<double>& uncovered_area);
+
+  // Encode or decode the pixels in a single superpixel for the binary map
+  // format.
+  void _EncodeSuperpixel(uint32_t superpixnum, bool weighted_map,
+			 uint8_t weight_bits, std::string& block);
+  bool _DecodeSuperpixel(uint32_t superpixnum, bool weighted_map,
+			 const unsigned char* block, uint32_t n_bytes);
 
   SubMapVector sub_map_;
   MapIterator begin_, end_;
@@ -564,6 +692,42 @@ private:
 };
 
 
+// The rejection sampling that Map used to do for its random points (pick a
+// superpixel, draw a point in its bounding box and keep it if it lands in the
+// Map) gets very inefficient for fragmented maps, and worse still when the
+// weights are used to thin the points.  MapSampler instead builds an alias
+// table over the Map's pixels once, with each pixel's probability set to its
+// area times the weighted sampling probability, so that each random point
+// takes one table lookup and a uniform draw in (z, eta) within the selected
+// pixel, with no rejections.  The sampler keeps its own copy of the pixel
+// geometry, so it remains valid if the Map is later modified or destroyed.
+//
+// The bulk generator splits the requested points into fixed-size blocks, each
+// with its own generator seeded from the input seed and the block index.  The
+// output for a given seed is therefore the same regardless of the number of
+// threads used to generate it.
+class MapSampler {
+ public:
+  MapSampler(Map& stomp_map, bool use_weighted_sampling = false);
+  ~MapSampler();
+
+  // Draw a single random point using the input generator.
+  void GenerateRandomPoint(MTRand& mtrand, AngularCoordinate& ang);
+
+  // Fill the input vector with n_point random points.  A seed value of 0 will
+  // seed the generator from the clock.
+  void GenerateRandomPoints(AngularVector& ang, uint32_t n_point,
+			    uint32_t seed = 0,
+			    uint32_t n_threads = DefaultThreads());
+
+  uint32_t Size();
+  bool Empty();
+
+ private:
+  std::vector<double> z_min_, z_height_, eta_min_, eta_width_;
+  std::vector<double> probability_;
+  std::vector<uint32_t> alias_;
+};
 
 } // end namespace Stomp
 
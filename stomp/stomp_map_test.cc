@@ -107,6 +107,89 @@ void MapReadTests() {
       stomp_map->PixelCount(resolution) << ")\n";
 }
 
+void MapBinaryTests() {
+  std::cout << "\n";
+  std::cout << "************************\n";
+  std::cout << "*** Map Binary Tests ***\n";
+  std::cout << "************************\n";
+
+  // Same map as the Read tests, but we also use a continuously varying
+  // weight within each superpixel to exercise the quantized weights.
+  double theta = 3.0;
+  Stomp::AngularCoordinate ang(60.0, 0.0, Stomp::AngularCoordinate::Survey);
+  Stomp::Pixel tmp_pix(ang, 256);
+  Stomp::PixelVector annulus_pix;
+  tmp_pix.WithinRadius(theta, annulus_pix);
+  for (Stomp::PixelIterator iter=annulus_pix.begin();
+       iter!=annulus_pix.end();++iter)
+    iter->SetWeight(1.0 + 0.001*iter->HPixnum());
+
+  Stomp::Map* stomp_map = new Stomp::Map(annulus_pix);
+
+  std::string ascii_file_name = "StompBinaryMap.pix";
+  std::string binary_file_name = "StompBinaryMap.bin";
+  std::string quantized_file_name = "StompBinaryMapQuantized.bin";
+  stomp_map->Write(ascii_file_name);
+  stomp_map->WriteBinary(binary_file_name);
+  stomp_map->WriteBinary(quantized_file_name, true, 16);
+
+  std::ifstream ascii_file(ascii_file_name.c_str(),
+			   std::ios::in | std::ios::binary | std::ios::ate);
+  std::ifstream binary_file(binary_file_name.c_str(),
+			    std::ios::in | std::ios::binary | std::ios::ate);
+  std::ifstream quantized_file(quantized_file_name.c_str(),
+			       std::ios::in | std::ios::binary | std::ios::ate);
+  std::cout << "\tFile sizes: " << ascii_file.tellg() << " bytes (ASCII), " <<
+    binary_file.tellg() << " bytes (binary), " << quantized_file.tellg() <<
+    " bytes (16-bit weights)\n";
+
+  std::cout << "\nChecking exact Map parameters...\n";
+  Stomp::Map* read_stomp_map = new Stomp::Map();
+  read_stomp_map->ReadBinary(binary_file_name);
+  std::cout << "\tArea: " << read_stomp_map->Area() << " (" <<
+    stomp_map->Area() << ")\n";
+  std::cout << "\tSize: " << read_stomp_map->Size() << " (" <<
+    stomp_map->Size() << ")\n";
+  std::cout << "\tWeight: " << read_stomp_map->MinWeight() << " - " <<
+    read_stomp_map->MaxWeight() << " (" << stomp_map->MinWeight() << " - " <<
+    stomp_map->MaxWeight() << ")\n";
+
+  uint32_t n_mismatch = 0;
+  Stomp::PixelVector pix, read_pix;
+  stomp_map->Pixels(pix);
+  read_stomp_map->Pixels(read_pix);
+  if (pix.size() != read_pix.size()) {
+    n_mismatch = pix.size();
+  } else {
+    for (uint32_t i=0;i<pix.size();i++) {
+      if ((pix[i] != read_pix[i]) ||
+	  (pix[i].Weight() != read_pix[i].Weight())) n_mismatch++;
+    }
+  }
+  std::cout << "\t" << n_mismatch << " mismatched pixels (0)\n";
+
+  std::cout << "\nChecking quantized Map parameters...\n";
+  Stomp::Map* quantized_stomp_map = new Stomp::Map();
+  quantized_stomp_map->ReadBinary(quantized_file_name, 1);
+  double max_weight_error = 0.0;
+  quantized_stomp_map->Pixels(read_pix);
+  n_mismatch = (pix.size() == read_pix.size() ? 0 : pix.size());
+  for (uint32_t i=0;(n_mismatch == 0) && (i<pix.size());i++) {
+    if (pix[i] != read_pix[i]) n_mismatch++;
+    double weight_error = fabs(pix[i].Weight() - read_pix[i].Weight());
+    if (weight_error > max_weight_error) max_weight_error = weight_error;
+  }
+  std::cout << "\tSize: " << quantized_stomp_map->Size() << " (" <<
+    stomp_map->Size() << ")\n";
+  std::cout << "\t" << n_mismatch << " mismatched pixels (0)\n";
+  std::cout << "\tMaximum weight error: " << max_weight_error << " (< " <<
+    0.5*(stomp_map->MaxWeight() - stomp_map->MinWeight())/65535.0 << ")\n";
+
+  delete stomp_map;
+  delete read_stomp_map;
+  delete quantized_stomp_map;
+}
+
 void MapPixelizationTests() {
   // Now we try generating a Map from a GeometricBound object
   std::cout << "\n";
@@ -149,6 +232,114 @@ void MapPixelizationTests() {
   }
 }
 
+void MapPixelizeBoundsTests() {
+  // Check that the threaded pixelization matches the serial one and that
+  // pixelizing a set of bounds at once gives the union of their Maps.
+  std::cout << "\n";
+  std::cout << "********************************\n";
+  std::cout << "*** Map PixelizeBounds Tests ***\n";
+  std::cout << "********************************\n";
+
+  Stomp::AngularCoordinate ang(20.0, 0.0, Stomp::AngularCoordinate::Survey);
+  Stomp::CircleBound circle(ang, 3.0);
+  Stomp::Map* serial_map = new Stomp::Map();
+  Stomp::Map* threaded_map = new Stomp::Map();
+  serial_map->PixelizeBound(circle, 1.0, 4096, 1);
+  threaded_map->PixelizeBound(circle, 1.0, 4096, 4);
+  Stomp::PixelVector serial_pix, threaded_pix;
+  serial_map->Pixels(serial_pix);
+  threaded_map->Pixels(threaded_pix);
+  uint32_t n_mismatch = 0;
+  for (uint32_t i=0;i<serial_pix.size() && i<threaded_pix.size();i++)
+    if (!(serial_pix[i] == threaded_pix[i])) n_mismatch++;
+  std::cout << "\tPixelizeBound: " << threaded_pix.size() << " (" <<
+    serial_pix.size() << ") pixels, " << n_mismatch << " mismatched\n";
+
+  // A strip of overlapping circles.
+  std::vector<Stomp::CircleBound> circles;
+  for (uint32_t i=0;i<24;i++) {
+    Stomp::AngularCoordinate center(10.0 + 0.5*(i % 3), 5.0 + 0.8*i,
+				    Stomp::AngularCoordinate::Survey);
+    circles.push_back(Stomp::CircleBound(center, 0.5 + 0.05*(i % 4)));
+  }
+  std::vector<Stomp::GeometricBound*> bounds;
+  Stomp::Map* union_map = new Stomp::Map();
+  for (uint32_t i=0;i<circles.size();i++) {
+    bounds.push_back(&circles[i]);
+    Stomp::Map* circle_map = new Stomp::Map(circles[i], 1.0, 4096);
+    union_map->IngestMap(*circle_map);
+    delete circle_map;
+  }
+
+  Stomp::Map* bounds_map = new Stomp::Map();
+  for (uint32_t n_threads=1;n_threads<=4;n_threads*=2) {
+    if (!bounds_map->PixelizeBounds(bounds, 1.0, 4096, n_threads))
+      std::cout << "\t\tFAILED to pixelize all bounds.\n";
+    std::cout << "\tPixelizeBounds (" << n_threads << " threads): " <<
+      bounds_map->Area() << " (" << union_map->Area() << ") sq. degrees, " <<
+      bounds_map->Size() << " (" << union_map->Size() << ") pixels\n";
+  }
+
+  uint32_t n_random = 20000;
+  Stomp::AngularVector rand_ang;
+  union_map->GenerateRandomPoints(rand_ang, n_random);
+  uint32_t n_inside = 0;
+  for (Stomp::AngularIterator iter=rand_ang.begin();
+       iter!=rand_ang.end();++iter)
+    if (bounds_map->Contains(*iter)) n_inside++;
+  std::cout << "\t\t" << n_inside << "/" << n_random <<
+    " union points inside PixelizeBounds Map\n";
+
+  // Many copies of the same bound.  Every batch adds the same pixels again,
+  // so the SubMaps should be resolved along the way rather than holding
+  // every copy until the end.
+  std::vector<Stomp::GeometricBound*> repeated_bounds(200, &circles[0]);
+  Stomp::Map* circle_map = new Stomp::Map(circles[0], 1.0, 4096);
+  if (!bounds_map->PixelizeBounds(repeated_bounds, 1.0, 4096))
+    std::cout << "\t\tFAILED to pixelize all bounds.\n";
+  std::cout << "\tPixelizeBounds (" << repeated_bounds.size() <<
+    " copies): " << bounds_map->Area() << " (" << circle_map->Area() <<
+    ") sq. degrees, " << bounds_map->Size() << " (" << circle_map->Size() <<
+    ") pixels\n";
+  if ((bounds_map->Size() != circle_map->Size()) ||
+      !Stomp::DoubleEQ(bounds_map->Area(), circle_map->Area()))
+    std::cout << "\t\tFAILED: repeated bounds don't match a single one.\n";
+
+  // With a bound small enough that one copy doesn't trigger a Resolve, the
+  // SubMaps still shouldn't have to wait for the last batch.
+  Stomp::AngularCoordinate small_center(10.0, 5.0,
+					Stomp::AngularCoordinate::Survey);
+  Stomp::CircleBound small_circle(small_center, 0.1);
+  Stomp::Map* small_map = new Stomp::Map(small_circle, 1.0, 4096);
+  Stomp::PixelVector circle_pix;
+  small_map->Pixels(circle_pix);
+  delete small_map;
+  std::vector<uint32_t> resolved_size(Stomp::MaxSuperpixnum, 0);
+  uint32_t max_resolved_size = 0, n_batch = 0;
+  Stomp::Map* batch_map = new Stomp::Map();
+  for (n_batch=0;n_batch<200;n_batch++) {
+    std::vector<Stomp::PixelVector> batch_pix(1, circle_pix);
+    batch_map->_IngestPixelBatch(batch_pix, resolved_size, 1);
+    for (uint32_t k=0;k<Stomp::MaxSuperpixnum;k++)
+      if (resolved_size[k] > max_resolved_size)
+	max_resolved_size = resolved_size[k];
+    if (max_resolved_size > 0) break;
+  }
+  std::cout << "\t_IngestPixelBatch: first resolve after " << n_batch + 1 <<
+    " batches, " << max_resolved_size << " (" << circle_pix.size() <<
+    ") pixels\n";
+  if ((max_resolved_size == 0) || (max_resolved_size > circle_pix.size()) ||
+      (n_batch == 0))
+    std::cout << "\t\tFAILED: SubMaps weren't resolved between batches.\n";
+
+  delete batch_map;
+  delete circle_map;
+  delete bounds_map;
+  delete union_map;
+  delete threaded_map;
+  delete serial_map;
+}
+
 void MapCoverTests() {
   std::cout << "\n";
   std::cout << "***********************\n";
@@ -390,6 +581,114 @@ void MapContainsTests() {
   }
 }
 
+void MapCoverageTests() {
+  // Now we check the deterministic coverage code for GeometricBounds, both
+  // for single bounds and for circles split into quadrants.
+  std::cout << "\n";
+  std::cout << "**************************\n";
+  std::cout << "*** Map Coverage Tests ***\n";
+  std::cout << "**************************\n";
+  double theta = 3.0;
+  Stomp::AngularCoordinate ang(60.0, 0.0, Stomp::AngularCoordinate::Survey);
+  Stomp::Pixel tmp_pix(ang, 256);
+  Stomp::PixelVector annulus_pix;
+  tmp_pix.WithinRadius(theta, annulus_pix);
+  Stomp::Map* stomp_map = new Stomp::Map(annulus_pix);
+
+  std::vector<double> quadrant_fraction;
+  double unmasked_fraction =
+    stomp_map->FindQuadrantFractions(ang, 1.0, quadrant_fraction);
+  int maskflags = stomp_map->QuadrantsContained(ang, 1.0);
+  std::cout << "\tCentered circle: " << unmasked_fraction <<
+    " unmasked, quadrant flags " << maskflags << "\n";
+  if ((unmasked_fraction != 1.0) || (maskflags != 30)) {
+    std::cout << "\t\tBad.  Centered circle should be fully contained.\n";
+    exit(1);
+  }
+
+  Stomp::AngularCoordinate far_ang(0.0, 0.0, Stomp::AngularCoordinate::Survey);
+  unmasked_fraction =
+    stomp_map->FindQuadrantFractions(far_ang, 1.0, quadrant_fraction);
+  std::cout << "\tFar away circle: " << unmasked_fraction << " unmasked\n";
+  if (unmasked_fraction != 0.0) {
+    std::cout << "\t\tBad.  Far away circle should be outside the map.\n";
+    exit(1);
+  }
+
+  // A circle on the edge of the map should be about half in and the
+  // quadrant fractions should average to the full circle fraction.  We also
+  // check it against the area of the pixelized circle inside the map.
+  Stomp::AngularCoordinate edge_ang(60.0 + theta, 0.0,
+				    Stomp::AngularCoordinate::Survey);
+  unmasked_fraction =
+    stomp_map->FindQuadrantFractions(edge_ang, 1.0, quadrant_fraction);
+  double mean_quadrant_fraction = 0.25*(quadrant_fraction[0] +
+					quadrant_fraction[1] +
+					quadrant_fraction[2] +
+					quadrant_fraction[3]);
+  Stomp::CircleBound edge_circle(edge_ang, 1.0);
+  double bound_fraction = stomp_map->FindUnmaskedFraction(edge_circle);
+  Stomp::Map* edge_map = new Stomp::Map(edge_circle, 1.0, 2048);
+  double map_fraction = stomp_map->FindUnmaskedFraction(*edge_map);
+  std::cout << "\tEdge circle: " << unmasked_fraction << " unmasked (" <<
+    bound_fraction << " as a bound, " << map_fraction << " as a map)\n";
+  std::cout << "\t\tQuadrants: " << quadrant_fraction[0] << ", " <<
+    quadrant_fraction[1] << ", " << quadrant_fraction[2] << ", " <<
+    quadrant_fraction[3] << "\n";
+  if ((fabs(unmasked_fraction - mean_quadrant_fraction) > 0.005) ||
+      (fabs(unmasked_fraction - bound_fraction) > 0.01) ||
+      (fabs(unmasked_fraction - map_fraction) > 0.01)) {
+    std::cout << "\t\tBad.  Edge circle fractions don't agree.\n";
+    exit(1);
+  }
+
+  // The old Monte Carlo style calls should still treat their second
+  // argument as an area resolution rather than as a pixel resolution.
+  Stomp::CircleBound center_circle(ang, 1.0);
+  double coarse_fraction = stomp_map->FindUnmaskedFraction(edge_circle, 0.5);
+  std::cout << "\t\tWith a 0.5 square degree area resolution: " <<
+    coarse_fraction << " unmasked\n";
+  if ((fabs(coarse_fraction - bound_fraction) > 0.05) ||
+      stomp_map->Contains(edge_circle, 0.5) ||
+      !stomp_map->Contains(center_circle, 0.5)) {
+    std::cout << "\t\tBad.  Area resolution calls don't match.\n";
+    exit(1);
+  }
+
+  // Finally, the batch version should match the single circle version.
+  Stomp::AngularVector circle_ang;
+  std::vector<double> radius;
+  for (uint32_t i=0;i<20;i++) {
+    circle_ang.push_back(Stomp::AngularCoordinate(57.0 + 0.3*i, 0.2*i,
+					Stomp::AngularCoordinate::Survey));
+    radius.push_back(0.1 + 0.05*i);
+  }
+  std::vector<double> batch_fraction, batch_quadrant_fraction;
+  stomp_map->FindQuadrantFractions(circle_ang, radius, batch_fraction,
+				   batch_quadrant_fraction,
+				   Stomp::AngularCoordinate::Survey, 0, 4);
+  uint32_t n_match = 0;
+  for (uint32_t i=0;i<circle_ang.size();i++) {
+    unmasked_fraction = stomp_map->FindQuadrantFractions(circle_ang[i],
+							 radius[i],
+							 quadrant_fraction);
+    bool match = (unmasked_fraction == batch_fraction[i]);
+    for (uint32_t q=0;q<4;q++)
+      if (quadrant_fraction[q] != batch_quadrant_fraction[4*i + q])
+	match = false;
+    if (match) n_match++;
+  }
+  std::cout << "\t" << n_match << "/" << circle_ang.size() <<
+    " batch results match.\n";
+  if (n_match != circle_ang.size()) {
+    std::cout << "\t\tBad.  Batch results don't match.\n";
+    exit(1);
+  }
+
+  delete edge_map;
+  delete stomp_map;
+}
+
 void MapRandomPointsTests() {
   // Alright, now we check the random position generator.  This should give
   // us back a fixed number of randomly selected positions within our original
@@ -450,6 +749,81 @@ void MapRandomPointsTests() {
       " points within far away map.\n";
 }
 
+void MapSamplerTests() {
+  // The MapSampler should only ever put points inside the Map, should give
+  // back the same points for a fixed seed regardless of how many threads do
+  // the work and should respect the weighted sampling probabilities.
+  std::cout << "\n";
+  std::cout << "*************************\n";
+  std::cout << "*** Map Sampler Tests ***\n";
+  std::cout << "*************************\n";
+  double theta = 3.0;
+  Stomp::AngularCoordinate ang(60.0, 0.0, Stomp::AngularCoordinate::Survey);
+  Stomp::Pixel tmp_pix(ang, 256);
+  Stomp::PixelVector annulus_pix;
+  tmp_pix.WithinRadius(theta, annulus_pix);
+
+  // Give the lower half of the pixels a weight of 1 and the upper half a
+  // weight of 3.  With the standard weighted sampling probabilities, the
+  // upper half should get 3/4 of the points for equal areas.
+  double low_area = 0.0, high_area = 0.0;
+  for (uint32_t i=0;i<annulus_pix.size();i++) {
+    if (2*i < annulus_pix.size()) {
+      annulus_pix[i].SetWeight(1.0);
+      low_area += annulus_pix[i].Area();
+    } else {
+      annulus_pix[i].SetWeight(3.0);
+      high_area += annulus_pix[i].Area();
+    }
+  }
+  Stomp::Map* stomp_map = new Stomp::Map(annulus_pix);
+
+  uint32_t n_random = 200000;
+  std::cout << "\tGenerating " << n_random << " points...\n";
+  Stomp::MapSampler sampler(*stomp_map);
+  Stomp::AngularVector rand_ang, thread_ang;
+  sampler.GenerateRandomPoints(rand_ang, n_random, 1234, 1);
+  sampler.GenerateRandomPoints(thread_ang, n_random, 1234, 4);
+
+  if (rand_ang.size() != n_random) {
+    std::cout << "\t\tRandom point array size doesn't match requested size!\n";
+    exit(1);
+  }
+
+  uint32_t n_found = 0, n_match = 0;
+  double weight = 0.0;
+  for (uint32_t i=0;i<n_random;i++) {
+    if (stomp_map->FindLocation(rand_ang[i], weight)) n_found++;
+    if ((rand_ang[i].UnitSphereX() == thread_ang[i].UnitSphereX()) &&
+	(rand_ang[i].UnitSphereY() == thread_ang[i].UnitSphereY()) &&
+	(rand_ang[i].UnitSphereZ() == thread_ang[i].UnitSphereZ())) n_match++;
+  }
+  std::cout << "\tVerified that " << n_found << "/" << n_random <<
+      " points within map.\n";
+  std::cout << "\t" << n_match << "/" << n_random <<
+      " points match between 1 and 4 threads.\n";
+  if ((n_found != n_random) || (n_match != n_random)) {
+    std::cout << "\t\tBad.  Sampler points outside map or not reproducible.\n";
+    exit(1);
+  }
+
+  Stomp::MapSampler weighted_sampler(*stomp_map, true);
+  weighted_sampler.GenerateRandomPoints(rand_ang, n_random, 1234);
+  uint32_t n_high = 0;
+  for (Stomp::AngularIterator iter=rand_ang.begin();iter!=rand_ang.end();++iter)
+    if (stomp_map->FindLocation(*iter, weight) && (weight > 2.0)) n_high++;
+  double expected = 3.0*high_area/(3.0*high_area + low_area);
+  std::cout << "\tWeighted sampling: " <<
+      1.0*n_high/n_random << " of points in high weight half (expected " <<
+      expected << ").\n";
+  if (fabs(1.0*n_high/n_random - expected) > 0.01) {
+    std::cout << "\t\tBad.  Weighted sampling fraction is off.\n";
+    exit(1);
+  }
+
+  delete stomp_map;
+}
+
 void MapMultiMapTests() {
   // Ok, now we want to test the various routines for working with multiple
   // stomp maps.  We'll use the same basic routines to generate two new maps,
@@ -914,14 +1288,19 @@ DEFINE_bool(all_map_tests, false, "Run all class unit tests.");
 DEFINE_bool(map_basic_tests, false, "Run Map basic tests");
 DEFINE_bool(map_write_tests, false, "Run Map write tests");
 DEFINE_bool(map_read_tests, false, "Run Map read tests");
+DEFINE_bool(map_binary_tests, false, "Run Map binary I/O tests");
 DEFINE_bool(map_pixelization_tests, false, "Run Map pixelization tests");
+DEFINE_bool(map_pixelize_bounds_tests, false,
+            "Run Map PixelizeBounds tests");
 DEFINE_bool(map_cover_tests, false, "Run Map cover tests");
 DEFINE_bool(map_iterator_tests, false, "Run Map iterator tests");
 DEFINE_bool(map_location_tests, false, "Run Map location tests");
 DEFINE_bool(map_unmasked_fraction_tests, false,
             "Run Map unmasked fraction tests");
 DEFINE_bool(map_contains_tests, false, "Run Map Contains tests");
+DEFINE_bool(map_coverage_tests, false, "Run Map bound coverage tests");
 DEFINE_bool(map_random_points_tests, false, "Run Map random points tests");
+DEFINE_bool(map_sampler_tests, false, "Run MapSampler tests");
 DEFINE_bool(map_multimap_tests, false, "Run Map multi-map tests");
 DEFINE_bool(map_region_tests, false, "Run Map region tests");
 DEFINE_bool(map_region_bound_tests, false, "Run Map RegionBound tests");
@@ -931,13 +1310,17 @@ void MapUnitTests(bool run_all_tests) {
   void MapBasicTests();
   void MapWriteTests();
   void MapReadTests();
+  void MapBinaryTests();
   void MapPixelizationTests();
+  void MapPixelizeBoundsTests();
   void MapCoverTests();
   void MapIteratorTests();
   void MapLocationTests();
   void MapUnmaskedFractionTests();
   void MapContainsTests();
+  void MapCoverageTests();
   void MapRandomPointsTests();
+  void MapSamplerTests();
   void MapMultiMapTests();
   void MapRegionTests();
   void MapRegionBoundTests();
@@ -955,10 +1338,17 @@ void MapUnitTests(bool run_all_tests) {
   // Check the routines for reading a Stomp::Map from a simple ASCII file.
   if (FLAGS_all_map_tests || FLAGS_map_read_tests) MapReadTests();
 
+  // Check the routines for writing and reading the binary Stomp::Map format.
+  if (FLAGS_all_map_tests || FLAGS_map_binary_tests) MapBinaryTests();
+
   // Check the routines for generating a Stomp::Map from a GeometricBound
   if (FLAGS_all_map_tests || FLAGS_map_pixelization_tests)
     MapPixelizationTests();
 
+  // Check the threaded pixelization and the batch version for many bounds.
+  if (FLAGS_all_map_tests || FLAGS_map_pixelize_bounds_tests)
+    MapPixelizeBoundsTests();
+
   // Check the routines for finding the Stomp::Map Coverage and Covering.
   if (FLAGS_all_map_tests || FLAGS_map_cover_tests) MapCoverTests();
 
@@ -978,10 +1368,17 @@ void MapUnitTests(bool run_all_tests) {
   // another Stomp::Map.
   if (FLAGS_all_map_tests || FLAGS_map_contains_tests) MapContainsTests();
 
+  // Check the routines for finding how much of a GeometricBound or a circle
+  // and its quadrants is within a Stomp::Map.
+  if (FLAGS_all_map_tests || FLAGS_map_coverage_tests) MapCoverageTests();
+
   // Check the routine for generating random points within a Stomp::Map's area.
   if (FLAGS_all_map_tests || FLAGS_map_random_points_tests)
     MapRandomPointsTests();
 
+  // Check the alias table sampler behind the random point generators.
+  if (FLAGS_all_map_tests || FLAGS_map_sampler_tests) MapSamplerTests();
+
   // Check the different ways of combining Stomp::Map instances.
   if (FLAGS_all_map_tests || FLAGS_map_multimap_tests) MapMultiMapTests();
 
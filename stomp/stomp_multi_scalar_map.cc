@@ -0,0 +1,570 @@
+// Copyright 2010  All Rights Reserved.
+// Author: ryan.scranton@gmail.com (Ryan Scranton)
+
+// STOMP is a set of libraries for doing astrostatistical analysis on the
+// celestial sphere.  The goal is to enable descriptions of arbitrary regions
+// on the sky which may or may not encode futher spatial information (galaxy
+// density, CMB temperature, observational depth, etc.) and to do so in such
+// a way as to make the analysis of that data as algorithmically efficient as
+// possible.
+//
+// This file contains the implementation of the MultiScalarMap class.  See
+// stomp_multi_scalar_map.h for the details.
+
+#include <stdint.h>
+#include <algorithm>
+#include <map>
+#include <utility>
+#include "stomp_core.h"
+#include "stomp_angular_coordinate.h"
+#include "stomp_angular_bin.h"
+#include "stomp_angular_correlation.h"
+#include "stomp_pixel.h"
+#include "stomp_scalar_pixel.h"
+#include "stomp_map.h"
+#include "stomp_scalar_map.h"
+#include "stomp_multi_scalar_map.h"
+
+namespace Stomp {
+
+MultiScalarMap::MultiScalarMap() {
+  map_type_ = ScalarMap::ScalarField;
+  resolution_ = 0;
+  n_channel_ = 0;
+  area_ = 0.0;
+}
+
+MultiScalarMap::MultiScalarMap(Map& stomp_map, uint32_t resolution,
+			       uint32_t n_channel,
+			       ScalarMap::ScalarMapType map_type,
+			       double min_unmasked_fraction) {
+  resolution_ = resolution;
+  n_channel_ = n_channel;
+  map_type_ = map_type;
+
+  PixelVector superpix;
+  stomp_map.Coverage(superpix);
+
+  for (PixelIterator iter=superpix.begin();iter!=superpix.end();++iter) {
+    PixelVector sub_pix;
+    iter->SubPix(resolution_, sub_pix);
+
+    for (PixelIterator sub_iter=sub_pix.begin();
+	 sub_iter!=sub_pix.end();++sub_iter) {
+      double unmasked_fraction = stomp_map.FindUnmaskedFraction(*sub_iter);
+      if (unmasked_fraction > min_unmasked_fraction) {
+	sub_iter->SetWeight(unmasked_fraction);
+	pix_.push_back(*sub_iter);
+      }
+    }
+  }
+
+  sort(pix_.begin(), pix_.end(), Pixel::LocalOrder);
+  intensity_.assign(pix_.size()*n_channel_, 0.0);
+
+  area_ = 0.0;
+  for (PixelIterator iter=pix_.begin();iter!=pix_.end();++iter)
+    area_ += iter->Area()*iter->Weight();
+}
+
+MultiScalarMap::MultiScalarMap(PixelVector& pix, uint32_t n_channel,
+			       ScalarMap::ScalarMapType map_type) {
+  resolution_ = (pix.empty() ? 0 : pix[0].Resolution());
+  n_channel_ = n_channel;
+  map_type_ = map_type;
+
+  pix_.reserve(pix.size());
+  area_ = 0.0;
+  for (PixelIterator iter=pix.begin();iter!=pix.end();++iter) {
+    if (iter->Resolution() != resolution_) {
+      std::cout << "Stomp::MultiScalarMap::MultiScalarMap - " <<
+	"Incompatible resolutions in Pixel list.  Exiting.\n";
+      exit(2);
+    }
+    area_ += iter->Area()*iter->Weight();
+    pix_.push_back(*iter);
+  }
+
+  sort(pix_.begin(), pix_.end(), Pixel::LocalOrder);
+  intensity_.assign(pix_.size()*n_channel_, 0.0);
+}
+
+MultiScalarMap::MultiScalarMap(ScalarMap& scalar_map, uint32_t n_channel) {
+  resolution_ = scalar_map.Resolution();
+  n_channel_ = (n_channel > 0 ? n_channel : 1);
+  map_type_ = scalar_map.MapType();
+
+  pix_.reserve(scalar_map.Size());
+  area_ = 0.0;
+  for (ScalarIterator iter=scalar_map.Begin();
+       iter!=scalar_map.End();++iter) {
+    pix_.push_back(Pixel(iter->PixelX(), iter->PixelY(), iter->Resolution(),
+			 iter->Weight()));
+    area_ += iter->Area()*iter->Weight();
+  }
+
+  intensity_.assign(pix_.size()*n_channel_, 0.0);
+  SetChannel(0, scalar_map);
+}
+
+MultiScalarMap::MultiScalarMap(MultiScalarMap& multi_map,
+			       uint32_t resolution,
+			       double min_unmasked_fraction) {
+  if (resolution > multi_map.Resolution()) {
+    std::cout << "Stomp::MultiScalarMap::MultiScalarMap - " <<
+      "Cannot make higher resolution map by resampling. Exiting.\n";
+    exit(1);
+  }
+
+  resolution_ = resolution;
+  n_channel_ = multi_map.NChannel();
+  map_type_ = multi_map.MapType();
+  area_ = 0.0;
+
+  // Sort the input pixels by the coarse pixel they fall in, which also puts
+  // the coarse pixels in LocalOrder, and then sum up each run, the same way
+  // that ScalarMap::Resample would.
+  uint32_t scale = multi_map.Resolution()/resolution_;
+  double pixel_fraction = 1.0/(1.0*scale*scale);
+  uint64_t nx = Nx0*resolution_;
+  uint32_t n_pix = multi_map.Size();
+  std::vector<std::pair<uint64_t, uint32_t> > parent(n_pix);
+  for (uint32_t i=0;i<n_pix;i++)
+    parent[i] = std::make_pair((multi_map.pix_[i].PixelY()/scale)*nx +
+			       multi_map.pix_[i].PixelX()/scale, i);
+  sort(parent.begin(), parent.end());
+
+  std::vector<double> weighted_intensity(n_channel_);
+  uint32_t run_begin = 0;
+  while (run_begin < n_pix) {
+    uint64_t key = parent[run_begin].first;
+    double unmasked_fraction = 0.0;
+    weighted_intensity.assign(n_channel_, 0.0);
+    uint32_t run_end = run_begin;
+    for (;(run_end < n_pix) && (parent[run_end].first == key);run_end++) {
+      uint32_t idx = parent[run_end].second;
+      double weight = pixel_fraction*multi_map.pix_[idx].Weight();
+      unmasked_fraction += weight;
+      double* intensity = multi_map.Intensities(idx);
+      for (uint32_t k=0;k<n_channel_;k++)
+	weighted_intensity[k] += (map_type_ == ScalarMap::DensityField ?
+				  intensity[k] : intensity[k]*weight);
+    }
+
+    if ((unmasked_fraction > 0.0000001) &&
+	(unmasked_fraction > min_unmasked_fraction)) {
+      Pixel tmp_pix(static_cast<uint32_t>(key % nx),
+		    static_cast<uint32_t>(key/nx), resolution_,
+		    unmasked_fraction);
+      pix_.push_back(tmp_pix);
+      area_ += tmp_pix.Area()*unmasked_fraction;
+
+      // For a ScalarField, we want the area-averaged value; for a
+      // DensityField, the total.
+      for (uint32_t k=0;k<n_channel_;k++)
+	intensity_.push_back(map_type_ == ScalarMap::DensityField ?
+			     weighted_intensity[k] :
+			     weighted_intensity[k]/unmasked_fraction);
+    }
+
+    run_begin = run_end;
+  }
+}
+
+MultiScalarMap::~MultiScalarMap() {
+  Clear();
+}
+
+PixelIterator MultiScalarMap::Begin() {
+  return pix_.begin();
+}
+
+PixelIterator MultiScalarMap::End() {
+  return pix_.end();
+}
+
+int32_t MultiScalarMap::FindPixel(Pixel& pix) {
+  PixelIterator iter =
+    lower_bound(pix_.begin(), pix_.end(), pix, Pixel::LocalOrder);
+  if ((iter != pix_.end()) && !Pixel::LocalOrder(pix, *iter))
+    return iter - pix_.begin();
+
+  return -1;
+}
+
+double MultiScalarMap::Intensity(uint32_t pixel_idx, uint32_t channel) {
+  return intensity_[pixel_idx*n_channel_ + channel];
+}
+
+void MultiScalarMap::SetIntensity(uint32_t pixel_idx, uint32_t channel,
+				  double intensity) {
+  intensity_[pixel_idx*n_channel_ + channel] = intensity;
+}
+
+bool MultiScalarMap::SetIntensity(Pixel& pix, uint32_t channel,
+				  double intensity) {
+  int32_t pixel_idx = FindPixel(pix);
+  if ((pixel_idx == -1) || (channel >= n_channel_)) return false;
+
+  intensity_[pixel_idx*n_channel_ + channel] = intensity;
+  return true;
+}
+
+double* MultiScalarMap::Intensities(uint32_t pixel_idx) {
+  return &intensity_[pixel_idx*n_channel_];
+}
+
+bool MultiScalarMap::AddToMap(AngularCoordinate& ang, uint32_t channel,
+			      double object_weight) {
+  if (channel >= n_channel_) return false;
+
+  Pixel tmp_pix(ang, resolution_);
+  int32_t pixel_idx = FindPixel(tmp_pix);
+  if (pixel_idx == -1) return false;
+
+  intensity_[pixel_idx*n_channel_ + channel] += object_weight;
+  return true;
+}
+
+bool MultiScalarMap::SetChannel(uint32_t channel, ScalarMap& scalar_map) {
+  if (channel >= n_channel_) {
+    std::cout << "Stomp::MultiScalarMap::SetChannel - " <<
+      "Channel " << channel << " out of range.\n";
+    return false;
+  }
+
+  if (scalar_map.Resolution() < resolution_) {
+    std::cout << "Stomp::MultiScalarMap::SetChannel - " <<
+      "Input map resolution is lower than ours.\n";
+    return false;
+  }
+
+  for (uint32_t i=0;i<pix_.size();i++) {
+    ScalarPixel tmp_pix(pix_[i].PixelX(), pix_[i].PixelY(), resolution_);
+    scalar_map.Resample(tmp_pix);
+    intensity_[i*n_channel_ + channel] = tmp_pix.Intensity();
+  }
+
+  return true;
+}
+
+double MultiScalarMap::MeanIntensity(uint32_t channel) {
+  double mean_intensity = 0.0;
+  double sum_pixel = 0.0;
+
+  if (map_type_ == ScalarMap::DensityField) {
+    double pixel_area = Pixel::PixelArea(resolution_);
+    for (uint32_t i=0;i<pix_.size();i++) {
+      mean_intensity +=
+	intensity_[i*n_channel_ + channel]/(pixel_area*pix_[i].Weight());
+      sum_pixel += 1.0;
+    }
+  } else {
+    for (uint32_t i=0;i<pix_.size();i++) {
+      mean_intensity += intensity_[i*n_channel_ + channel]*pix_[i].Weight();
+      sum_pixel += pix_[i].Weight();
+    }
+  }
+
+  return (sum_pixel > 0.0 ? mean_intensity/sum_pixel : 0.0);
+}
+
+void MultiScalarMap::_FindOverDensity(std::vector<double>& overdensity) {
+  // The same conversion as ScalarMap::ConvertToOverDensity, but into a
+  // separate array.
+  overdensity.resize(intensity_.size());
+
+  double pixel_area = Pixel::PixelArea(resolution_);
+  for (uint32_t k=0;k<n_channel_;k++) {
+    double mean_intensity = MeanIntensity(k);
+    for (uint32_t i=0;i<pix_.size();i++) {
+      uint32_t idx = i*n_channel_ + k;
+      if (map_type_ == ScalarMap::DensityField) {
+	double norm_intensity = mean_intensity*pix_[i].Weight()*pixel_area;
+	overdensity[idx] = (intensity_[idx] - norm_intensity)/norm_intensity;
+      } else {
+	overdensity[idx] = intensity_[idx] - mean_intensity;
+      }
+    }
+  }
+}
+
+void MultiScalarMap::_FindPixelRegions(std::vector<int16_t>& pixel_region) {
+  pixel_region.resize(pix_.size());
+  for (uint32_t i=0;i<pix_.size();i++)
+    pixel_region[i] = Region(pix_[i].SuperPix(RegionResolution()));
+}
+
+void MultiScalarMap::CrossCorrelate(MultiScalarMap& multi_map,
+				    WThetaVector& wtheta) {
+  _CrossCorrelate(multi_map, wtheta, false);
+}
+
+void MultiScalarMap::CrossCorrelate(MultiScalarMap& multi_map,
+				    ThetaPtrVector& theta) {
+  _CrossCorrelate(multi_map, theta, false);
+}
+
+void MultiScalarMap::CrossCorrelateWithRegions(MultiScalarMap& multi_map,
+					       WThetaVector& wtheta) {
+  _CrossCorrelate(multi_map, wtheta, true);
+}
+
+void MultiScalarMap::CrossCorrelateWithRegions(MultiScalarMap& multi_map,
+					       ThetaPtrVector& theta) {
+  _CrossCorrelate(multi_map, theta, true);
+}
+
+void MultiScalarMap::_CrossCorrelate(MultiScalarMap& multi_map,
+				     WThetaVector& wtheta, bool use_regions) {
+  if (wtheta.size() != n_channel_*multi_map.NChannel()) {
+    std::cout << "Stomp::MultiScalarMap::CrossCorrelate - " <<
+      "Need " << n_channel_*multi_map.NChannel() <<
+      " AngularCorrelations, got " << wtheta.size() << "...\n";
+    return;
+  }
+
+  ThetaIterator theta_begin = wtheta[0].Begin(resolution_);
+  ThetaIterator theta_end = wtheta[0].End(resolution_);
+  if (theta_begin == theta_end) {
+    std::cout << "Stomp::MultiScalarMap::CrossCorrelate - " <<
+      "No angular bins have resolution " << resolution_ << "...\n";
+    return;
+  }
+
+  // Pick out the matching bin from each of the correlations.
+  for (ThetaIterator theta_iter=theta_begin;
+       theta_iter!=theta_end;++theta_iter) {
+    uint32_t bin_idx = theta_iter - wtheta[0].Begin();
+    ThetaPtrVector theta;
+    theta.reserve(wtheta.size());
+    for (WThetaIterator iter=wtheta.begin();iter!=wtheta.end();++iter)
+      theta.push_back(&(*(iter->Begin() + bin_idx)));
+    _CrossCorrelate(multi_map, theta, use_regions);
+  }
+}
+
+void MultiScalarMap::_CrossCorrelate(MultiScalarMap& multi_map,
+				     ThetaPtrVector& theta, bool use_regions) {
+  if (resolution_ != multi_map.Resolution()) {
+    std::cout << "Stomp::MultiScalarMap::CrossCorrelate - " <<
+      "Map resolutions must match!  Exiting...\n";
+    exit(1);
+  }
+
+  uint32_t n_channel_b = multi_map.NChannel();
+  if (theta.size() != n_channel_*n_channel_b) {
+    std::cout << "Stomp::MultiScalarMap::CrossCorrelate - " <<
+      "Need " << n_channel_*n_channel_b << " angular bins, got " <<
+      theta.size() << "...\n";
+    return;
+  }
+
+  if (use_regions && (NRegion() != multi_map.NRegion())) {
+    std::cout << "Stomp::MultiScalarMap::CrossCorrelateWithRegions - " <<
+      "Map regionation must match!  Exiting...\n";
+    exit(1);
+  }
+
+  for (ThetaPtrIterator iter=theta.begin();iter!=theta.end();++iter) {
+    if (use_regions && ((*iter)->NRegion() != NRegion())) {
+      (*iter)->ClearRegions();
+      (*iter)->InitializeRegions(NRegion());
+    }
+    (*iter)->ResetPixelWtheta();
+  }
+
+  std::vector<double> overdensity_a, overdensity_b;
+  _FindOverDensity(overdensity_a);
+  multi_map._FindOverDensity(overdensity_b);
+
+  std::vector<int16_t> region_a, region_b;
+  uint16_t n_region = 0;
+  if (use_regions) {
+    _FindPixelRegions(region_a);
+    multi_map._FindPixelRegions(region_b);
+    n_region = NRegion();
+  }
+
+  // For each pixel in the input map, we sum the weighted over-densities of
+  // our pixels in the annulus around it, separately for each of our regions
+  // (the last slot is for pixels that aren't in a region).  The products
+  // with each of the input pixel's channels then go into the bins, so the
+  // neighbors are only found once for all of the channel pairs.
+  std::vector<double> sum_overdensity((n_region + 1)*n_channel_, 0.0);
+  std::vector<double> sum_weight(n_region + 1, 0.0);
+  std::vector<uint16_t> touched_slots;
+  std::vector<uint8_t> touched(n_region + 1, 0);
+  ScalarVector pixVec;
+  for (uint32_t j=0;j<multi_map.Size();j++) {
+    ScalarPixel tmp_pix(multi_map.pix_[j].PixelX(),
+			multi_map.pix_[j].PixelY(), resolution_);
+    tmp_pix._WithinAnnulus(*theta[0], pixVec);
+
+    for (ScalarIterator pix_iter=pixVec.begin();
+	 pix_iter!=pixVec.end();++pix_iter) {
+      PixelIterator iter =
+	lower_bound(pix_.begin(), pix_.end(), *pix_iter, Pixel::LocalOrder);
+      if ((iter == pix_.end()) || Pixel::LocalOrder(*pix_iter, *iter))
+	continue;
+
+      uint32_t i = iter - pix_.begin();
+      uint16_t slot = n_region;
+      if (use_regions && (region_a[i] != -1)) slot = region_a[i];
+      if (!touched[slot]) {
+	touched[slot] = 1;
+	touched_slots.push_back(slot);
+      }
+
+      double weight = iter->Weight();
+      sum_weight[slot] += weight;
+      double* overdensity = &overdensity_a[i*n_channel_];
+      double* slot_sum = &sum_overdensity[slot*n_channel_];
+      for (uint32_t k=0;k<n_channel_;k++)
+	slot_sum[k] += overdensity[k]*weight;
+    }
+
+    double weight_b = multi_map.pix_[j].Weight();
+    int16_t pix_region = (use_regions ? region_b[j] : -1);
+    double* overdensity = &overdensity_b[j*n_channel_b];
+    for (std::vector<uint16_t>::iterator slot_iter=touched_slots.begin();
+	 slot_iter!=touched_slots.end();++slot_iter) {
+      uint16_t slot = *slot_iter;
+      int16_t map_region = (slot == n_region ? -1 : slot);
+      double dweight = sum_weight[slot]*weight_b;
+      double* slot_sum = &sum_overdensity[slot*n_channel_];
+      for (uint32_t a=0;a<n_channel_;a++) {
+	for (uint32_t b=0;b<n_channel_b;b++)
+	  theta[a*n_channel_b + b]->AddToPixelWtheta(
+	    slot_sum[a]*overdensity[b]*weight_b, dweight,
+	    map_region, pix_region);
+	slot_sum[a] = 0.0;
+      }
+      sum_weight[slot] = 0.0;
+      touched[slot] = 0;
+    }
+    touched_slots.clear();
+  }
+}
+
+uint32_t MultiScalarMap::Resolution() {
+  return resolution_;
+}
+
+uint32_t MultiScalarMap::NChannel() {
+  return n_channel_;
+}
+
+ScalarMap::ScalarMapType MultiScalarMap::MapType() {
+  return map_type_;
+}
+
+void MultiScalarMap::Coverage(PixelVector& superpix, uint32_t resolution,
+			      bool calculate_fraction) {
+  if (!superpix.empty()) superpix.clear();
+
+  if (resolution > resolution_) {
+    std::cout << "Stomp::MultiScalarMap::Coverage - " <<
+      "WARNING: Requested resolution is higher than " <<
+      "the map resolution!\nReseting to map resolution...\n";
+    resolution = resolution_;
+  }
+
+  std::map<Pixel, bool, PixelOrdering> coverage_map;
+  for (PixelIterator iter=pix_.begin();iter!=pix_.end();++iter) {
+    Pixel tmp_pix = *iter;
+    tmp_pix.SetToSuperPix(resolution);
+    coverage_map[tmp_pix] = true;
+  }
+
+  for (std::map<Pixel, bool, PixelOrdering>::iterator iter=coverage_map.begin();
+       iter!=coverage_map.end();++iter) {
+    Pixel tmp_pix = iter->first;
+    if (calculate_fraction) tmp_pix.SetWeight(FindUnmaskedFraction(tmp_pix));
+    superpix.push_back(tmp_pix);
+  }
+
+  sort(superpix.begin(), superpix.end(), Pixel::SuperPixelBasedOrder);
+}
+
+double MultiScalarMap::FindUnmaskedFraction(Pixel& pix) {
+  double unmasked_fraction = 0.0;
+
+  if (pix.Resolution() >= resolution_) {
+    Pixel tmp_pix = pix;
+    tmp_pix.SetToSuperPix(resolution_);
+    int32_t pixel_idx = FindPixel(tmp_pix);
+    if (pixel_idx != -1) unmasked_fraction = pix_[pixel_idx].Weight();
+  } else {
+    double pixel_fraction =
+      1.0*pix.Resolution()*pix.Resolution()/(resolution_*resolution_);
+    PixelVector sub_pix;
+    pix.SubPix(resolution_, sub_pix);
+    for (PixelIterator iter=sub_pix.begin();iter!=sub_pix.end();++iter) {
+      int32_t pixel_idx = FindPixel(*iter);
+      if (pixel_idx != -1)
+	unmasked_fraction += pixel_fraction*pix_[pixel_idx].Weight();
+    }
+  }
+
+  return unmasked_fraction;
+}
+
+int8_t MultiScalarMap::FindUnmaskedStatus(Pixel& pix) {
+  // Same as ScalarMap::FindUnmaskedStatus.
+  int8_t unmasked_status = 0;
+
+  if (pix.Resolution() >= resolution_) {
+    Pixel tmp_pix = pix;
+    tmp_pix.SetToSuperPix(resolution_);
+    if (FindPixel(tmp_pix) != -1) unmasked_status = 1;
+  } else {
+    PixelVector sub_pix;
+    pix.SubPix(resolution_, sub_pix);
+    for (PixelIterator iter=sub_pix.begin();iter!=sub_pix.end();++iter) {
+      if (FindPixel(*iter) != -1) {
+	unmasked_status = -1;
+	break;
+      }
+    }
+  }
+
+  return unmasked_status;
+}
+
+double MultiScalarMap::Area() {
+  return area_;
+}
+
+uint32_t MultiScalarMap::Size() {
+  return pix_.size();
+}
+
+uint32_t MultiScalarMap::MinResolution() {
+  return resolution_;
+}
+
+uint32_t MultiScalarMap::MaxResolution() {
+  return resolution_;
+}
+
+uint8_t MultiScalarMap::MinLevel() {
+  return Pixel::ResolutionToLevel(resolution_);
+}
+
+uint8_t MultiScalarMap::MaxLevel() {
+  return Pixel::ResolutionToLevel(resolution_);
+}
+
+bool MultiScalarMap::Empty() {
+  return pix_.empty();
+}
+
+void MultiScalarMap::Clear() {
+  pix_.clear();
+  intensity_.clear();
+  area_ = 0.0;
+  ClearRegions();
+}
+
+} // end namespace Stomp
@@ -0,0 +1,150 @@
+// Copyright 2010  All Rights Reserved.
+// Author: ryan.scranton@gmail.com (Ryan Scranton)
+
+// STOMP is a set of libraries for doing astrostatistical analysis on the
+// celestial sphere.  The goal is to enable descriptions of arbitrary regions
+// on the sky which may or may not encode futher spatial information (galaxy
+// density, CMB temperature, observational depth, etc.) and to do so in such
+// a way as to make the analysis of that data as algorithmically efficient as
+// possible.
+//
+// This header file contains the MultiScalarMap class.  A MultiScalarMap is a
+// ScalarMap with several intensity channels sharing the same pixels, e.g.
+// the seeing, extinction and sky brightness from a systematics map or a set
+// of galaxy samples over the same footprint.  The point is that correlating
+// every channel in one map against every channel in another takes a single
+// pass over the pixel pairs rather than one pass per pair of channels.
+
+#ifndef STOMP_MULTI_SCALAR_MAP_H
+#define STOMP_MULTI_SCALAR_MAP_H
+
+#include <stdint.h>
+#include <vector>
+#include "stomp_core.h"
+#include "stomp_angular_bin.h"
+#include "stomp_angular_correlation.h"
+#include "stomp_pixel.h"
+#include "stomp_base_map.h"
+#include "stomp_scalar_map.h"
+
+namespace Stomp {
+
+class AngularCoordinate;  // class definition in stomp_angular_coordinate.h
+class Map;                // class definition in stomp_map.h
+class MultiScalarMap;
+
+class MultiScalarMap : public BaseMap {
+  // The geometry is the same as for a ScalarMap: a set of pixels at a single
+  // resolution, each with an unmasked fraction (stored as the pixel Weight).
+  // The intensities are stored as a contiguous array with all of the
+  // channels for the first pixel, then all of the channels for the second
+  // pixel and so on.  All of the channels share the same ScalarMapType; only
+  // the ScalarField and DensityField types are supported, with the same
+  // meaning as for a ScalarMap.
+
+ public:
+  MultiScalarMap();
+
+  // Initialize the geometry from a Map, as with the equivalent ScalarMap
+  // constructor.  All of the channels start at zero.
+  MultiScalarMap(Map& stomp_map, uint32_t resolution, uint32_t n_channel,
+		 ScalarMap::ScalarMapType map_type = ScalarMap::ScalarField,
+		 double min_unmasked_fraction = 0.0000001);
+
+  // Initialize the geometry from a vector of Pixels, taking the Weight of
+  // each pixel as its unmasked fraction.  All of the pixels must have the
+  // same resolution.
+  MultiScalarMap(PixelVector& pix, uint32_t n_channel,
+		 ScalarMap::ScalarMapType map_type = ScalarMap::ScalarField);
+
+  // Initialize from a ScalarMap, copying its geometry and type and putting
+  // its intensities in the first channel.
+  MultiScalarMap(ScalarMap& scalar_map, uint32_t n_channel = 1);
+
+  // Resample another MultiScalarMap to a coarser resolution.
+  MultiScalarMap(MultiScalarMap& multi_map, uint32_t resolution,
+		 double min_unmasked_fraction = 0.0000001);
+  virtual ~MultiScalarMap();
+
+  // Pixels are indexed by their position in the map (Begin() is pixel 0).
+  // FindPixel returns the index of the input pixel (which needs to be at the
+  // map resolution) or -1 if it isn't in the map.
+  PixelIterator Begin();
+  PixelIterator End();
+  int32_t FindPixel(Pixel& pix);
+
+  // Access to the channels.  Intensities returns a pointer to the NChannel
+  // values for a given pixel.
+  double Intensity(uint32_t pixel_idx, uint32_t channel);
+  void SetIntensity(uint32_t pixel_idx, uint32_t channel, double intensity);
+  bool SetIntensity(Pixel& pix, uint32_t channel, double intensity);
+  double* Intensities(uint32_t pixel_idx);
+
+  // For DensityField maps, add an object to the appropriate pixel in the
+  // given channel.  Returns false if the point isn't in the map.
+  bool AddToMap(AngularCoordinate& ang, uint32_t channel,
+		double object_weight = 1.0);
+
+  // Fill a channel by resampling a ScalarMap (at the same or higher
+  // resolution) onto our pixels.
+  bool SetChannel(uint32_t channel, ScalarMap& scalar_map);
+
+  // The mean intensity in each channel, calculated the same way as
+  // ScalarMap::MeanIntensity.
+  double MeanIntensity(uint32_t channel);
+
+  // Cross-correlate every channel in this map with every channel in the input
+  // map, which has to have the same resolution.  The results go into
+  // NChannel()*multi_map.NChannel() AngularCorrelation objects (all with the
+  // same binning), with the correlation between our channel a and the input
+  // map's channel b in wtheta[a*multi_map.NChannel() + b].  As with the
+  // ScalarMap methods, the AngularCorrelation versions only do the bins
+  // at the map resolution and the ThetaPtrVector versions take the
+  // equivalent bin from each of the correlations.  The intensities are
+  // converted to over-densities on the fly; the maps themselves are left
+  // unchanged.
+  void CrossCorrelate(MultiScalarMap& multi_map, WThetaVector& wtheta);
+  void CrossCorrelate(MultiScalarMap& multi_map, ThetaPtrVector& theta);
+  void CrossCorrelateWithRegions(MultiScalarMap& multi_map,
+				 WThetaVector& wtheta);
+  void CrossCorrelateWithRegions(MultiScalarMap& multi_map,
+				 ThetaPtrVector& theta);
+
+  // Some basic facts about the map.
+  uint32_t Resolution();
+  uint32_t NChannel();
+  ScalarMap::ScalarMapType MapType();
+
+  // We need these methods to comply with the BaseMap signature.
+  virtual void Coverage(PixelVector& superpix,
+			uint32_t resolution = HPixResolution,
+			bool calculate_fraction = true);
+  virtual double FindUnmaskedFraction(Pixel& pix);
+  virtual int8_t FindUnmaskedStatus(Pixel& pix);
+  virtual double Area();
+  virtual uint32_t Size();
+  virtual uint32_t MinResolution();
+  virtual uint32_t MaxResolution();
+  virtual uint8_t MinLevel();
+  virtual uint8_t MaxLevel();
+  virtual bool Empty();
+  virtual void Clear();
+
+ private:
+  void _FindOverDensity(std::vector<double>& overdensity);
+  void _FindPixelRegions(std::vector<int16_t>& pixel_region);
+  void _CrossCorrelate(MultiScalarMap& multi_map, WThetaVector& wtheta,
+		       bool use_regions);
+  void _CrossCorrelate(MultiScalarMap& multi_map, ThetaPtrVector& theta,
+		       bool use_regions);
+
+  PixelVector pix_;
+  std::vector<double> intensity_;
+  ScalarMap::ScalarMapType map_type_;
+  uint32_t resolution_, n_channel_;
+  double area_;
+};
+
+} // end namespace Stomp
+
+#endif
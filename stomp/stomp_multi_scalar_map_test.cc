@@ -0,0 +1,189 @@
+#include <stdint.h>
+#include <iostream>
+#include <math.h>
+#include <string>
+#include <vector>
+#include <gflags/gflags.h>
+#include "stomp_core.h"
+#include "stomp_angular_coordinate.h"
+#include "stomp_angular_bin.h"
+#include "stomp_angular_correlation.h"
+#include "stomp_pixel.h"
+#include "stomp_map.h"
+#include "stomp_scalar_map.h"
+#include "stomp_multi_scalar_map.h"
+
+// A few smooth fields standing in for seeing, extinction and sky brightness.
+static double SystematicsValue(uint32_t channel, Stomp::Pixel& pix) {
+  double lambda = pix.Lambda()*Stomp::DegToRad;
+  double eta = pix.Eta()*Stomp::DegToRad;
+  switch (channel) {
+  case 0:
+    return 1.2 + 0.3*sin(20.0*lambda);
+  case 1:
+    return 0.1 + 0.05*cos(15.0*eta);
+  default:
+    return 21.0 + sin(10.0*lambda)*cos(10.0*eta);
+  }
+}
+
+void MultiScalarMapCrossCorrelationTests() {
+  // Cross-correlate a galaxy density map against three systematics fields
+  // with a single MultiScalarMap traversal and check the results against
+  // doing each field separately with ScalarMaps, with and without regions
+  // and at each resampled resolution.
+  std::cout << "\n";
+  std::cout << "*********************************************\n";
+  std::cout << "*** MultiScalarMap CrossCorrelation Tests ***\n";
+  std::cout << "*********************************************\n";
+  Stomp::AngularCoordinate ang(60.0, 0.0, Stomp::AngularCoordinate::Survey);
+  Stomp::Pixel tmp_pix(ang, 256);
+  Stomp::PixelVector annulus_pix;
+  tmp_pix.WithinRadius(5.0, annulus_pix);
+  Stomp::Map* stomp_map = new Stomp::Map(annulus_pix);
+
+  uint32_t resolution = 128;
+  uint32_t n_sys = 3;
+  Stomp::ScalarMap* galaxy_map =
+    new Stomp::ScalarMap(*stomp_map, resolution,
+			 Stomp::ScalarMap::DensityField);
+  Stomp::AngularVector rand_ang;
+  stomp_map->GenerateRandomPoints(rand_ang, 50000);
+  for (Stomp::AngularIterator iter=rand_ang.begin();
+       iter!=rand_ang.end();++iter) galaxy_map->AddToMap(*iter);
+
+  std::vector<Stomp::ScalarMap*> sys_maps;
+  Stomp::MultiScalarMap sys_multi_map(*stomp_map, resolution, n_sys);
+  for (uint32_t k=0;k<n_sys;k++) {
+    Stomp::ScalarMap* sys_map =
+      new Stomp::ScalarMap(*stomp_map, resolution,
+			   Stomp::ScalarMap::ScalarField);
+    for (Stomp::ScalarIterator iter=sys_map->Begin();
+	 iter!=sys_map->End();++iter) {
+      double value = SystematicsValue(k, *iter);
+      iter->SetIntensity(value);
+      sys_multi_map.SetIntensity(*iter, k, value);
+    }
+    sys_maps.push_back(sys_map);
+  }
+  Stomp::MultiScalarMap galaxy_multi_map(*galaxy_map);
+  std::cout << "\t" << galaxy_multi_map.Size() << " galaxy pixels, " <<
+    sys_multi_map.Size() << " systematics pixels, " <<
+    sys_multi_map.NChannel() << " channels\n";
+
+  for (uint32_t use_regions=0;use_regions<2;use_regions++) {
+    if (use_regions == 1) {
+      galaxy_map->InitializeRegions(8);
+      galaxy_multi_map.InitializeRegions(*galaxy_map);
+      sys_multi_map.InitializeRegions(*galaxy_map);
+      for (uint32_t k=0;k<n_sys;k++)
+	sys_maps[k]->InitializeRegions(*galaxy_map);
+      std::cout << "\tWith " << galaxy_map->NRegion() << " regions:\n";
+    }
+
+    for (uint32_t level_resolution=resolution;
+	 level_resolution>=(use_regions ? resolution : 16);
+	 level_resolution/=2) {
+      Stomp::AngularCorrelation wtheta(0.1, 3.0, 6.0);
+      Stomp::WThetaVector multi_wtheta(n_sys, wtheta);
+      Stomp::WThetaVector single_wtheta(n_sys, wtheta);
+
+      Stomp::MultiScalarMap* galaxy_level = &galaxy_multi_map;
+      Stomp::MultiScalarMap* sys_level = &sys_multi_map;
+      Stomp::ScalarMap* galaxy_scalar_level = galaxy_map;
+      std::vector<Stomp::ScalarMap*> sys_scalar_level = sys_maps;
+      if (level_resolution != resolution) {
+	galaxy_level =
+	  new Stomp::MultiScalarMap(galaxy_multi_map, level_resolution);
+	sys_level = new Stomp::MultiScalarMap(sys_multi_map, level_resolution);
+	galaxy_scalar_level = new Stomp::ScalarMap(*galaxy_map,
+						   level_resolution);
+	for (uint32_t k=0;k<n_sys;k++)
+	  sys_scalar_level[k] = new Stomp::ScalarMap(*sys_maps[k],
+						     level_resolution);
+      }
+
+      uint32_t n_bins = 0;
+      if (wtheta.Begin(level_resolution) != wtheta.End(level_resolution)) {
+	if (use_regions == 1) {
+	  galaxy_level->CrossCorrelateWithRegions(*sys_level, multi_wtheta);
+	} else {
+	  galaxy_level->CrossCorrelate(*sys_level, multi_wtheta);
+	}
+	for (uint32_t k=0;k<n_sys;k++) {
+	  Stomp::AngularCorrelation& single = single_wtheta[k];
+	  for (Stomp::ThetaIterator iter=single.Begin(level_resolution);
+	       iter!=single.End(level_resolution);++iter) {
+	    if (use_regions == 1) {
+	      galaxy_scalar_level->CrossCorrelateWithRegions(
+		*sys_scalar_level[k], iter);
+	    } else {
+	      galaxy_scalar_level->CrossCorrelate(*sys_scalar_level[k], iter);
+	    }
+	  }
+	}
+      }
+
+      uint32_t n_mismatch = 0;
+      for (uint32_t k=0;k<n_sys;k++) {
+	for (uint32_t i=0;i<wtheta.NBins();i++) {
+	  Stomp::ThetaIterator multi_iter = multi_wtheta[k].BinIterator(i);
+	  Stomp::ThetaIterator single_iter = single_wtheta[k].BinIterator(i);
+	  if (multi_iter->Resolution() != level_resolution) continue;
+	  if (k == 0) n_bins++;
+	  if (fabs(multi_iter->Wtheta() - single_iter->Wtheta()) >
+	      1.0e-8*(fabs(single_iter->Wtheta()) + 1.0e-6)) n_mismatch++;
+	  for (int16_t region=0;region<multi_iter->NRegion();region++)
+	    if (fabs(multi_iter->Wtheta(region) -
+		     single_iter->Wtheta(region)) >
+		1.0e-8*(fabs(single_iter->Wtheta(region)) + 1.0e-6))
+	      n_mismatch++;
+	}
+      }
+
+      // The resampled maps should agree, too.
+      uint32_t n_pixel_mismatch = 0;
+      for (uint32_t k=0;k<n_sys;k++) {
+	uint32_t idx = 0;
+	for (Stomp::ScalarIterator iter=sys_scalar_level[k]->Begin();
+	     iter!=sys_scalar_level[k]->End();++iter,++idx) {
+	  if ((idx >= sys_level->Size()) ||
+	      (fabs(sys_level->Intensity(idx, k) - iter->Intensity()) >
+	       1.0e-10*fabs(iter->Intensity()))) n_pixel_mismatch++;
+	}
+      }
+
+      std::cout << "\t\t" << level_resolution << ": " << n_bins <<
+	" bins, " << n_mismatch << " correlation mismatches, " <<
+	n_pixel_mismatch << " pixel mismatches\n";
+
+      if (level_resolution != resolution) {
+	delete galaxy_level;
+	delete sys_level;
+	delete galaxy_scalar_level;
+	for (uint32_t k=0;k<n_sys;k++) delete sys_scalar_level[k];
+      }
+    }
+  }
+
+  for (uint32_t k=0;k<n_sys;k++) delete sys_maps[k];
+  delete galaxy_map;
+  delete stomp_map;
+}
+
+// Define our command line flags
+DEFINE_bool(all_multi_scalar_map_tests, false, "Run all class unit tests.");
+DEFINE_bool(multi_scalar_map_crosscorrelation_tests, false,
+            "Run MultiScalarMap cross-correlation tests");
+
+void MultiScalarMapUnitTests(bool run_all_tests) {
+  void MultiScalarMapCrossCorrelationTests();
+
+  if (run_all_tests) FLAGS_all_multi_scalar_map_tests = true;
+
+  // Check the Stomp::MultiScalarMap cross-correlations against the
+  // equivalent Stomp::ScalarMap calculations.
+  if (FLAGS_all_multi_scalar_map_tests ||
+      FLAGS_multi_scalar_map_crosscorrelation_tests)
+    MultiScalarMapCrossCorrelationTests();
+}
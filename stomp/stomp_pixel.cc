@@ -18,6 +18,7 @@
 #include "stomp_pixel.h"
 #include "stomp_angular_coordinate.h"
 #include "stomp_angular_bin.h"
+#include "stomp_instrumentation.h"
 
 namespace Stomp {
 
@@ -1359,6 +1360,14 @@ int8_t Pixel::IntersectsAnnulus(AngularCoordinate& ang, AngularBin& theta) {
     intersects_annulus = 0;
   }
 
+  if (intersects_annulus == 1) {
+    STOMP_COUNT(AnnulusAccepted);
+  } else if (intersects_annulus == 0) {
+    STOMP_COUNT(AnnulusRejected);
+  } else {
+    STOMP_COUNT(AnnulusPartial);
+  }
+
   return intersects_annulus;
 }
 
@@ -0,0 +1,669 @@
+// Copyright 2010  All Rights Reserved.
+// Author: ryan.scranton@gmail.com (Ryan Scranton)
+
+// STOMP is a set of libraries for doing astrostatistical analysis on the
+// celestial sphere.  The goal is to enable descriptions of arbitrary regions
+// on the sky which may or may not encode futher spatial information (galaxy
+// density, CMB temperature, observational depth, etc.) and to do so in such
+// a way as to make the analysis of that data as algorithmically efficient as
+// possible.
+//
+// This file contains the PointCatalog class, a column-oriented alternative
+// to the WAngularVector for large sets of points.
+
+#include <fstream>
+#include "stomp_core.h"
+#include "stomp_point_catalog.h"
+#include "stomp_instrumentation.h"
+
+namespace Stomp {
+
+PointCatalog::PointCatalog() {
+  has_redshift_ = false;
+}
+
+PointCatalog::PointCatalog(AngularVector& ang, double weight) {
+  has_redshift_ = false;
+  Reserve(ang.size());
+  for (AngularIterator iter=ang.begin();iter!=ang.end();++iter)
+    AddPoint(*iter, weight);
+}
+
+PointCatalog::PointCatalog(WAngularVector& w_ang, bool copy_fields) {
+  has_redshift_ = false;
+  Reserve(w_ang.size());
+
+  // Set up the Field columns first so that we aren't resizing them for
+  // every new Field name we come across.
+  if (copy_fields) {
+    for (WAngularIterator iter=w_ang.begin();iter!=w_ang.end();++iter) {
+      if (iter->HasFields()) {
+	for (FieldIterator field_iter=iter->FieldBegin();
+	     field_iter!=iter->FieldEnd();++field_iter)
+	  if (!HasField(field_iter->first)) AddField(field_iter->first);
+      }
+    }
+  }
+
+  for (WAngularIterator iter=w_ang.begin();iter!=w_ang.end();++iter)
+    AddPoint(*iter, copy_fields);
+}
+
+PointCatalog::PointCatalog(CosmoVector& c_ang) {
+  has_redshift_ = false;
+  Reserve(c_ang.size());
+  AddRedshiftColumn();
+  for (CosmoIterator iter=c_ang.begin();iter!=c_ang.end();++iter)
+    AddPoint(*iter);
+}
+
+PointCatalog::~PointCatalog() {
+  Clear();
+}
+
+void PointCatalog::AddPoint(double unit_sphere_x, double unit_sphere_y,
+			    double unit_sphere_z, double weight) {
+  double r_norm = 1.0/sqrt(unit_sphere_x*unit_sphere_x +
+			   unit_sphere_y*unit_sphere_y +
+			   unit_sphere_z*unit_sphere_z);
+  x_.push_back(unit_sphere_x*r_norm);
+  y_.push_back(unit_sphere_y*r_norm);
+  z_.push_back(unit_sphere_z*r_norm);
+  weight_.push_back(weight);
+  _ResizeOptionalColumns();
+}
+
+void PointCatalog::AddPoint(AngularCoordinate& ang, double weight) {
+  x_.push_back(ang.UnitSphereX());
+  y_.push_back(ang.UnitSphereY());
+  z_.push_back(ang.UnitSphereZ());
+  weight_.push_back(weight);
+  _ResizeOptionalColumns();
+}
+
+void PointCatalog::AddPoint(WeightedAngularCoordinate& w_ang,
+			    bool copy_fields) {
+  AddPoint(static_cast<AngularCoordinate&>(w_ang), w_ang.Weight());
+
+  if (copy_fields && w_ang.HasFields()) {
+    uint32_t idx = x_.size() - 1;
+    for (FieldIterator iter=w_ang.FieldBegin();iter!=w_ang.FieldEnd();++iter)
+      SetField(iter->first, idx, iter->second);
+  }
+}
+
+void PointCatalog::AddPoint(CosmoCoordinate& c_ang) {
+  AddRedshiftColumn();
+  AddPoint(static_cast<AngularCoordinate&>(c_ang), c_ang.Weight());
+  redshift_.back() = c_ang.Redshift();
+}
+
+bool PointCatalog::AddPoints(std::vector<double>& thetaVec,
+			     std::vector<double>& phiVec,
+			     AngularCoordinate::Sphere sphere, bool radians,
+			     uint32_t n_threads) {
+  std::vector<double> weightVec(thetaVec.size(), 1.0);
+  return AddPoints(thetaVec, phiVec, weightVec, sphere, radians, n_threads);
+}
+
+bool PointCatalog::AddPoints(std::vector<double>& thetaVec,
+			     std::vector<double>& phiVec,
+			     std::vector<double>& weightVec,
+			     AngularCoordinate::Sphere sphere, bool radians,
+			     uint32_t n_threads) {
+  if ((thetaVec.size() != phiVec.size()) ||
+      (thetaVec.size() != weightVec.size())) return false;
+  if (thetaVec.empty()) return true;
+
+  uint32_t n_start = x_.size();
+  uint32_t n_point = thetaVec.size();
+  x_.resize(n_start + n_point);
+  y_.resize(n_start + n_point);
+  z_.resize(n_start + n_point);
+  AngularCoordinate::ToUnitSphereCoordinates(&thetaVec[0], &phiVec[0],
+					     n_point, &x_[n_start],
+					     &y_[n_start], &z_[n_start],
+					     sphere, radians, n_threads);
+  weight_.insert(weight_.end(), weightVec.begin(), weightVec.end());
+  _ResizeOptionalColumns();
+
+  return true;
+}
+
+void PointCatalog::Append(PointCatalog& catalog) {
+  uint32_t n_start = x_.size();
+  uint32_t n_point = catalog.Size();
+
+  x_.insert(x_.end(), catalog.x_.begin(), catalog.x_.end());
+  y_.insert(y_.end(), catalog.y_.begin(), catalog.y_.end());
+  z_.insert(z_.end(), catalog.z_.begin(), catalog.z_.end());
+  weight_.insert(weight_.end(), catalog.weight_.begin(),
+		 catalog.weight_.end());
+  if (catalog.HasRedshift()) AddRedshiftColumn();
+  for (FieldDataIterator iter=catalog.field_.begin();
+       iter!=catalog.field_.end();++iter)
+    if (!HasField(iter->first)) AddField(iter->first, iter->second.type);
+  _ResizeOptionalColumns();
+
+  if (catalog.HasRedshift()) {
+    for (uint32_t i=0;i<n_point;i++)
+      redshift_[n_start + i] = catalog.redshift_[i];
+  }
+
+  for (FieldDataIterator iter=catalog.field_.begin();
+       iter!=catalog.field_.end();++iter) {
+    FieldData& field = field_[iter->first];
+    if ((field.type == iter->second.type) && (n_point > 0)) {
+      uint8_t field_size = _FieldSize(field.type);
+      memcpy(&field.data[n_start*field_size], &iter->second.data[0],
+	     n_point*field_size);
+    } else {
+      for (uint32_t i=0;i<n_point;i++)
+	_SetFieldValue(field, n_start + i, _FieldValue(iter->second, i));
+    }
+  }
+}
+
+void PointCatalog::Select(std::vector<uint8_t>& keep, PointCatalog& output) {
+  output.Clear();
+
+  uint32_t n_keep = 0;
+  for (uint32_t i=0;i<keep.size() && i<x_.size();i++) if (keep[i]) n_keep++;
+
+  output.Reserve(n_keep);
+  if (has_redshift_) output.AddRedshiftColumn();
+  for (FieldDataIterator iter=field_.begin();iter!=field_.end();++iter)
+    output.AddField(iter->first, iter->second.type);
+
+  for (uint32_t i=0;i<keep.size() && i<x_.size();i++) {
+    if (keep[i]) {
+      output.x_.push_back(x_[i]);
+      output.y_.push_back(y_[i]);
+      output.z_.push_back(z_[i]);
+      output.weight_.push_back(weight_[i]);
+      if (has_redshift_) output.redshift_.push_back(redshift_[i]);
+    }
+  }
+
+  for (FieldDataIterator iter=field_.begin();iter!=field_.end();++iter) {
+    uint8_t field_size = _FieldSize(iter->second.type);
+    std::vector<uint8_t>& data = output.field_[iter->first].data;
+    data.resize(n_keep*field_size);
+    uint32_t m = 0;
+    for (uint32_t i=0;i<keep.size() && i<x_.size();i++) {
+      if (keep[i]) {
+	memcpy(&data[m*field_size], &iter->second.data[i*field_size],
+	       field_size);
+	m++;
+      }
+    }
+  }
+}
+
+void PointCatalog::Point(uint32_t idx, AngularCoordinate& ang) {
+  ang.SetUnitSphereCoordinates(x_[idx], y_[idx], z_[idx]);
+}
+
+void PointCatalog::Point(uint32_t idx, WeightedAngularCoordinate& w_ang,
+			 bool copy_fields) {
+  w_ang.SetUnitSphereCoordinates(x_[idx], y_[idx], z_[idx]);
+  w_ang.SetWeight(weight_[idx]);
+  if (copy_fields) {
+    for (FieldDataIterator iter=field_.begin();iter!=field_.end();++iter)
+      w_ang.SetField(iter->first, _FieldValue(iter->second, idx));
+  }
+}
+
+void PointCatalog::ToWAngularVector(WAngularVector& w_ang, bool copy_fields) {
+  if (!w_ang.empty()) w_ang.clear();
+  w_ang.reserve(x_.size());
+
+  for (uint32_t i=0;i<x_.size();i++) {
+    WeightedAngularCoordinate tmp_ang(x_[i], y_[i], z_[i], weight_[i]);
+    if (copy_fields) {
+      for (FieldDataIterator iter=field_.begin();iter!=field_.end();++iter)
+	tmp_ang.SetField(iter->first, _FieldValue(iter->second, i));
+    }
+    w_ang.push_back(tmp_ang);
+  }
+}
+
+void PointCatalog::Coordinates(std::vector<double>& thetaVec,
+			       std::vector<double>& phiVec,
+			       AngularCoordinate::Sphere sphere, bool radians,
+			       uint32_t n_threads) {
+  AngularCoordinate::FromUnitSphereCoordinates(x_, y_, z_, thetaVec, phiVec,
+					       sphere, radians, n_threads);
+}
+
+// Not the BinaryCatalogReader format (whose files start with "STOMPCAT"), so
+// it gets its own tag to keep either reader from mistaking one for the other.
+static const char PointCatalogMagic[9] = "STOMPPTS";
+
+bool PointCatalog::Write(const std::string& output_file_name) {
+  std::ofstream output_file(output_file_name.c_str(),
+			    std::ios::out | std::ios::binary);
+  if (!output_file.is_open()) {
+    std::cout << "Stomp::PointCatalog::Write - " <<
+      "Can't open " << output_file_name << "!\n";
+    return false;
+  }
+
+  // Header: format tag and version, then the number of points, whether
+  // there's a redshift column and the number of Field columns.
+  uint32_t version = 1;
+  uint32_t n_point = x_.size();
+  uint8_t has_redshift = (has_redshift_ ? 1 : 0);
+  uint16_t n_field = field_.size();
+  output_file.write(PointCatalogMagic, 8);
+  output_file.write(reinterpret_cast<char*>(&version), sizeof(version));
+  output_file.write(reinterpret_cast<char*>(&n_point), sizeof(n_point));
+  output_file.write(reinterpret_cast<char*>(&has_redshift),
+		    sizeof(has_redshift));
+  output_file.write(reinterpret_cast<char*>(&n_field), sizeof(n_field));
+
+  if (n_point > 0) {
+    output_file.write(reinterpret_cast<char*>(&x_[0]),
+		      n_point*sizeof(double));
+    output_file.write(reinterpret_cast<char*>(&y_[0]),
+		      n_point*sizeof(double));
+    output_file.write(reinterpret_cast<char*>(&z_[0]),
+		      n_point*sizeof(double));
+    output_file.write(reinterpret_cast<char*>(&weight_[0]),
+		      n_point*sizeof(double));
+    if (has_redshift_)
+      output_file.write(reinterpret_cast<char*>(&redshift_[0]),
+			n_point*sizeof(double));
+  }
+
+  // Each Field is its name (length first), type and data.
+  for (FieldDataIterator iter=field_.begin();iter!=field_.end();++iter) {
+    uint16_t name_length = iter->first.size();
+    uint8_t field_type = static_cast<uint8_t>(iter->second.type);
+    output_file.write(reinterpret_cast<char*>(&name_length),
+		      sizeof(name_length));
+    output_file.write(iter->first.data(), name_length);
+    output_file.write(reinterpret_cast<char*>(&field_type),
+		      sizeof(field_type));
+    if (!iter->second.data.empty())
+      output_file.write(reinterpret_cast<char*>(&iter->second.data[0]),
+			iter->second.data.size());
+  }
+
+  output_file.close();
+  if (output_file.fail()) {
+    std::cout << "Stomp::PointCatalog::Write - " <<
+      "Failed to write " << output_file_name << "!\n";
+    return false;
+  }
+
+  return true;
+}
+
+bool PointCatalog::Read(const std::string& input_file_name) {
+  Clear();
+
+  std::ifstream input_file(input_file_name.c_str(),
+			   std::ios::in | std::ios::binary);
+  if (!input_file) {
+    std::cout << "Stomp::PointCatalog::Read - " <<
+      input_file_name << " does not exist!\n";
+    return false;
+  }
+
+  char tag[8];
+  uint32_t version, n_point;
+  uint8_t has_redshift;
+  uint16_t n_field;
+  input_file.read(tag, 8);
+  input_file.read(reinterpret_cast<char*>(&version), sizeof(version));
+  input_file.read(reinterpret_cast<char*>(&n_point), sizeof(n_point));
+  input_file.read(reinterpret_cast<char*>(&has_redshift),
+		  sizeof(has_redshift));
+  input_file.read(reinterpret_cast<char*>(&n_field), sizeof(n_field));
+  if (!input_file || (strncmp(tag, PointCatalogMagic, 8) != 0) ||
+      (version != 1)) {
+    std::cout << "Stomp::PointCatalog::Read - " <<
+      "Bad header in " << input_file_name << "\n";
+    return false;
+  }
+
+  x_.resize(n_point);
+  y_.resize(n_point);
+  z_.resize(n_point);
+  weight_.resize(n_point);
+  if (has_redshift == 1) {
+    has_redshift_ = true;
+    redshift_.resize(n_point);
+  }
+  if (n_point > 0) {
+    input_file.read(reinterpret_cast<char*>(&x_[0]), n_point*sizeof(double));
+    input_file.read(reinterpret_cast<char*>(&y_[0]), n_point*sizeof(double));
+    input_file.read(reinterpret_cast<char*>(&z_[0]), n_point*sizeof(double));
+    input_file.read(reinterpret_cast<char*>(&weight_[0]),
+		    n_point*sizeof(double));
+    if (has_redshift_)
+      input_file.read(reinterpret_cast<char*>(&redshift_[0]),
+		      n_point*sizeof(double));
+  }
+
+  for (uint16_t i=0;input_file && (i<n_field);i++) {
+    uint16_t name_length;
+    uint8_t field_type;
+    input_file.read(reinterpret_cast<char*>(&name_length),
+		    sizeof(name_length));
+    std::string field_name(name_length, ' ');
+    if (name_length > 0) input_file.read(&field_name[0], name_length);
+    input_file.read(reinterpret_cast<char*>(&field_type), sizeof(field_type));
+    if (!input_file || (field_type > Int64Field)) break;
+
+    FieldData& field = field_[field_name];
+    field.type = static_cast<FieldType>(field_type);
+    field.data.resize(n_point*_FieldSize(field.type));
+    if (!field.data.empty())
+      input_file.read(reinterpret_cast<char*>(&field.data[0]),
+		      field.data.size());
+  }
+
+  if (!input_file || (field_.size() != n_field)) {
+    std::cout << "Stomp::PointCatalog::Read - " <<
+      "Failed to read " << input_file_name << "\n";
+    Clear();
+    return false;
+  }
+  STOMP_COUNT_N(BytesRead, static_cast<uint64_t>(input_file.tellg()));
+
+  return true;
+}
+
+void PointCatalog::Reserve(uint32_t n_point) {
+  x_.reserve(n_point);
+  y_.reserve(n_point);
+  z_.reserve(n_point);
+  weight_.reserve(n_point);
+  if (has_redshift_) redshift_.reserve(n_point);
+  for (FieldDataIterator iter=field_.begin();iter!=field_.end();++iter)
+    iter->second.data.reserve(n_point*_FieldSize(iter->second.type));
+}
+
+void PointCatalog::Clear() {
+  x_.clear();
+  y_.clear();
+  z_.clear();
+  weight_.clear();
+  redshift_.clear();
+  field_.clear();
+  has_redshift_ = false;
+}
+
+uint32_t PointCatalog::Size() {
+  return x_.size();
+}
+
+bool PointCatalog::Empty() {
+  return x_.empty();
+}
+
+double PointCatalog::TotalWeight() {
+  double total_weight = 0.0;
+  for (uint32_t i=0;i<weight_.size();i++) total_weight += weight_[i];
+  return total_weight;
+}
+
+double* PointCatalog::XColumn() {
+  return (x_.empty() ? NULL : &x_[0]);
+}
+
+double* PointCatalog::YColumn() {
+  return (y_.empty() ? NULL : &y_[0]);
+}
+
+double* PointCatalog::ZColumn() {
+  return (z_.empty() ? NULL : &z_[0]);
+}
+
+double* PointCatalog::WeightColumn() {
+  return (weight_.empty() ? NULL : &weight_[0]);
+}
+
+void PointCatalog::AddRedshiftColumn() {
+  if (!has_redshift_) {
+    has_redshift_ = true;
+    redshift_.assign(x_.size(), 0.0);
+  }
+}
+
+bool PointCatalog::HasRedshift() {
+  return has_redshift_;
+}
+
+double PointCatalog::Redshift(uint32_t idx) {
+  return (has_redshift_ ? redshift_[idx] : 0.0);
+}
+
+void PointCatalog::SetRedshift(uint32_t idx, double redshift) {
+  AddRedshiftColumn();
+  redshift_[idx] = redshift;
+}
+
+double* PointCatalog::RedshiftColumn() {
+  return ((has_redshift_ && !redshift_.empty()) ? &redshift_[0] : NULL);
+}
+
+bool PointCatalog::AddField(const std::string& field_name,
+			    FieldType field_type) {
+  if (HasField(field_name)) return false;
+
+  FieldData field;
+  field.type = field_type;
+  field.data.assign(x_.size()*_FieldSize(field_type), 0);
+  field_[field_name] = field;
+
+  return true;
+}
+
+bool PointCatalog::HasField(const std::string& field_name) {
+  return (field_.find(field_name) != field_.end());
+}
+
+bool PointCatalog::FindFieldType(const std::string& field_name,
+				 FieldType& field_type) {
+  FieldDataIterator iter = field_.find(field_name);
+  if (iter == field_.end()) return false;
+  field_type = iter->second.type;
+  return true;
+}
+
+uint16_t PointCatalog::NFields() {
+  return field_.size();
+}
+
+bool PointCatalog::HasFields() {
+  return !field_.empty();
+}
+
+void PointCatalog::FieldNames(std::vector<std::string>& field_names) {
+  if (!field_names.empty()) field_names.clear();
+  for (FieldDataIterator iter=field_.begin();iter!=field_.end();++iter)
+    field_names.push_back(iter->first);
+}
+
+double PointCatalog::Field(const std::string& field_name, uint32_t idx) {
+  FieldDataIterator iter = field_.find(field_name);
+  return (iter == field_.end() ? 0.0 : _FieldValue(iter->second, idx));
+}
+
+void PointCatalog::SetField(const std::string& field_name, uint32_t idx,
+			    double value) {
+  FieldDataIterator iter = field_.find(field_name);
+  if (iter == field_.end()) {
+    AddField(field_name);
+    iter = field_.find(field_name);
+  }
+  _SetFieldValue(iter->second, idx, value);
+}
+
+bool PointCatalog::CopyFieldToWeight(const std::string& field_name) {
+  FieldDataIterator iter = field_.find(field_name);
+  if (iter == field_.end()) return false;
+
+  for (uint32_t i=0;i<weight_.size();i++)
+    weight_[i] = _FieldValue(iter->second, i);
+
+  return true;
+}
+
+uint8_t PointCatalog::_FieldSize(FieldType field_type) {
+  uint8_t field_size = sizeof(double);
+  switch (field_type) {
+  case DoubleField:
+    field_size = sizeof(double);
+    break;
+  case FloatField:
+    field_size = sizeof(float);
+    break;
+  case Int32Field:
+    field_size = sizeof(int32_t);
+    break;
+  case Int64Field:
+    field_size = sizeof(int64_t);
+    break;
+  }
+  return field_size;
+}
+
+double PointCatalog::_FieldValue(FieldData& field, uint32_t idx) {
+  double value = 0.0;
+  switch (field.type) {
+  case DoubleField:
+    value = reinterpret_cast<double*>(&field.data[0])[idx];
+    break;
+  case FloatField:
+    value = reinterpret_cast<float*>(&field.data[0])[idx];
+    break;
+  case Int32Field:
+    value = reinterpret_cast<int32_t*>(&field.data[0])[idx];
+    break;
+  case Int64Field:
+    value = reinterpret_cast<int64_t*>(&field.data[0])[idx];
+    break;
+  }
+  return value;
+}
+
+void PointCatalog::_SetFieldValue(FieldData& field, uint32_t idx,
+				  double value) {
+  switch (field.type) {
+  case DoubleField:
+    reinterpret_cast<double*>(&field.data[0])[idx] = value;
+    break;
+  case FloatField:
+    reinterpret_cast<float*>(&field.data[0])[idx] =
+      static_cast<float>(value);
+    break;
+  case Int32Field:
+    reinterpret_cast<int32_t*>(&field.data[0])[idx] =
+      static_cast<int32_t>(value);
+    break;
+  case Int64Field:
+    reinterpret_cast<int64_t*>(&field.data[0])[idx] =
+      static_cast<int64_t>(value);
+    break;
+  }
+}
+
+void PointCatalog::_ResizeOptionalColumns() {
+  if (has_redshift_) redshift_.resize(x_.size(), 0.0);
+  for (FieldDataIterator iter=field_.begin();iter!=field_.end();++iter)
+    iter->second.data.resize(x_.size()*_FieldSize(iter->second.type), 0);
+}
+
+#ifdef WITH_NUMPY  // begin python-only code
+PyObject* PointCatalog::Column(const std::string& column_name)
+  throw (const char* ) {
+  if (_import_array() < 0) throw "Could not import numpy";
+
+  npy_intp n_point = x_.size();
+  void* data = NULL;
+  int type_num = NPY_DOUBLE;
+  if (column_name == "x") {
+    data = XColumn();
+  } else if (column_name == "y") {
+    data = YColumn();
+  } else if (column_name == "z") {
+    data = ZColumn();
+  } else if (column_name == "weight") {
+    data = WeightColumn();
+  } else if (column_name == "redshift") {
+    if (!has_redshift_) throw "catalog has no redshift column";
+    data = RedshiftColumn();
+  } else {
+    FieldDataIterator iter = field_.find(column_name);
+    if (iter == field_.end()) throw "unknown catalog column";
+    if (!iter->second.data.empty()) data = &iter->second.data[0];
+    switch (iter->second.type) {
+    case DoubleField:
+      type_num = NPY_DOUBLE;
+      break;
+    case FloatField:
+      type_num = NPY_FLOAT;
+      break;
+    case Int32Field:
+      type_num = NPY_INT32;
+      break;
+    case Int64Field:
+      type_num = NPY_INT64;
+      break;
+    }
+  }
+
+  // The array owns a copy of the column.  A view of the std::vector would
+  // have nothing keeping the catalog alive and would be left pointing at
+  // freed memory as soon as the catalog was collected or AddPoints
+  // reallocated the column.
+  PyObject* array = PyArray_SimpleNew(1, &n_point, type_num);
+  if (array == NULL) throw "Could not allocate column array";
+  if (data != NULL)
+    memcpy(PyArray_DATA(reinterpret_cast<PyArrayObject*>(array)), data,
+	   PyArray_NBYTES(reinterpret_cast<PyArrayObject*>(array)));
+  return array;
+}
+
+void PointCatalog::AddPoints(PyObject* x1obj, PyObject* x2obj,
+			     const std::string& system, PyObject* weightobj,
+			     uint32_t n_threads) throw (const char* ) {
+  AngularCoordinate::Sphere sys = AngularCoordinate::SystemFromString(system);
+
+  // No copy made as long as the type and byte order is correct.
+  NumpyVector<double> x1(x1obj);
+  NumpyVector<double> x2(x2obj);
+  if (x1.size() != x2.size()) {
+    throw "coordinates must be same size";
+  }
+
+  // optional weight, can be scalar or x1.size()
+  NumpyVector<double> weight;
+  npy_intp n_weight = 0;
+  if (weightobj != NULL && weightobj != Py_None) {
+    weight.init(weightobj);
+    n_weight = weight.size();
+    if (n_weight != 1 && n_weight != x1.size()) {
+      throw "weight must be same length as coordinates or length 1";
+    }
+  }
+
+  npy_intp n_point = x1.size();
+  std::vector<double> thetaVec(n_point), phiVec(n_point), weightVec(n_point);
+  for (npy_intp i=0;i<n_point;i++) {
+    thetaVec[i] = x1.at(i);
+    phiVec[i] = x2.at(i);
+    weightVec[i] = (n_weight == 0 ? 1.0 : weight.at(n_weight > 1 ? i : 0));
+  }
+
+  Py_BEGIN_ALLOW_THREADS
+  AddPoints(thetaVec, phiVec, weightVec, sys, false, n_threads);
+  Py_END_ALLOW_THREADS
+}
+#endif  // end python-only code
+
+} // end namespace Stomp
@@ -0,0 +1,250 @@
+// Copyright 2010  All Rights Reserved.
+// Author: ryan.scranton@gmail.com (Ryan Scranton)
+
+// STOMP is a set of libraries for doing astrostatistical analysis on the
+// celestial sphere.  The goal is to enable descriptions of arbitrary regions
+// on the sky which may or may not encode futher spatial information (galaxy
+// density, CMB temperature, observational depth, etc.) and to do so in such
+// a way as to make the analysis of that data as algorithmically efficient as
+// possible.
+//
+// This header file contains the PointCatalog class.  A WAngularVector stores
+// each point as a full WeightedAngularCoordinate object, complete with its
+// own Field dictionary, which makes large catalogs both big and slow to walk
+// through.  PointCatalog stores the same information column by column: the
+// unit sphere coordinates and weights each live in their own contiguous
+// array, with optional typed Field columns and an optional redshift column
+// alongside.
+
+#ifndef STOMP_POINT_CATALOG_H
+#define STOMP_POINT_CATALOG_H
+
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <map>
+#include "stomp_core.h"
+#include "stomp_angular_coordinate.h"
+
+// ESS: Add support for python
+#ifdef WITH_PYTHON
+#include <Python.h>
+#endif
+// ESS: Support numpy if it is available
+#ifdef WITH_NUMPY
+#include "numpy/arrayobject.h"
+#include "../python/NumpyVector.h"
+#endif
+
+namespace Stomp {
+
+class PointCatalog;
+
+typedef std::vector<PointCatalog> PointCatalogVector;
+typedef PointCatalogVector::iterator PointCatalogIterator;
+
+class PointCatalog {
+  // A structure-of-arrays container for points on the sphere.  Point i is
+  // (UnitSphereX(i), UnitSphereY(i), UnitSphereZ(i)) with weight Weight(i);
+  // the raw columns are available through the XColumn(), etc. methods so
+  // that loops over the catalog can run straight through memory.  Any Field
+  // and redshift columns are kept the same length as the coordinates, with
+  // new points getting 0 for those values unless they are set explicitly.
+
+ public:
+  // Field columns can hold any of these types.  Values going in and out
+  // through the generic Field() and SetField() methods are converted to and
+  // from double; FieldColumn() gives direct access to the typed array.
+  enum FieldType {
+    DoubleField,
+    FloatField,
+    Int32Field,
+    Int64Field
+  };
+
+  PointCatalog();
+
+  // We can build a catalog directly from the existing vector types.  For the
+  // WAngularVector version, any Fields attached to the input points become
+  // DoubleField columns (missing values are 0).  The CosmoVector version
+  // also fills in the redshift column.
+  PointCatalog(AngularVector& ang, double weight = 1.0);
+  PointCatalog(WAngularVector& w_ang, bool copy_fields = true);
+  PointCatalog(CosmoVector& c_ang);
+  ~PointCatalog();
+
+  // Add points one at a time.  As with the WeightedAngularCoordinate
+  // constructors, the unit sphere version normalizes its input.
+  void AddPoint(double unit_sphere_x, double unit_sphere_y,
+		double unit_sphere_z, double weight = 1.0);
+  void AddPoint(AngularCoordinate& ang, double weight = 1.0);
+  void AddPoint(WeightedAngularCoordinate& w_ang, bool copy_fields = true);
+  void AddPoint(CosmoCoordinate& c_ang);
+
+  // Or add a whole set of coordinates at once.  The conversion to unit sphere
+  // coordinates uses the bulk AngularCoordinate methods.  The return value is
+  // false if the input vectors don't match in length.
+  bool AddPoints(std::vector<double>& thetaVec, std::vector<double>& phiVec,
+		 AngularCoordinate::Sphere sphere = AngularCoordinate::Equatorial,
+		 bool radians = false, uint32_t n_threads = DefaultThreads());
+  bool AddPoints(std::vector<double>& thetaVec, std::vector<double>& phiVec,
+		 std::vector<double>& weightVec,
+		 AngularCoordinate::Sphere sphere = AngularCoordinate::Equatorial,
+		 bool radians = false, uint32_t n_threads = DefaultThreads());
+
+  // Append the points from another catalog.  Fields present in only one of
+  // the catalogs are 0 for the points from the other.
+  void Append(PointCatalog& catalog);
+
+  // Copy the points with a non-zero keep flag into the output catalog,
+  // preserving their order, Field values and redshifts.  The keep vector is
+  // usually the output of a method like Map::Contains.
+  void Select(std::vector<uint8_t>& keep, PointCatalog& output);
+
+  // Extract the points as individual objects.  This is the same as the
+  // WeightedAngularCoordinate version of the catalog, with Field columns
+  // converted to Field values if requested.
+  void Point(uint32_t idx, AngularCoordinate& ang);
+  void Point(uint32_t idx, WeightedAngularCoordinate& w_ang,
+	     bool copy_fields = false);
+  void ToWAngularVector(WAngularVector& w_ang, bool copy_fields = true);
+
+  // Return the angular coordinates for all of the points in the requested
+  // coordinate system.
+  void Coordinates(std::vector<double>& thetaVec, std::vector<double>& phiVec,
+		   AngularCoordinate::Sphere sphere =
+		   AngularCoordinate::Equatorial,
+		   bool radians = false, uint32_t n_threads = DefaultThreads());
+
+  // Write the catalog to a binary file and read it back.  The file holds the
+  // coordinate, weight, redshift and Field columns exactly as they are in
+  // memory (native byte order), so it's meant for passing catalogs between
+  // processes on the same cluster rather than for archiving.  The files are
+  // tagged "STOMPPTS" so they can't be confused with BinaryCatalogReader
+  // input.  Read replaces the current contents of the catalog and returns
+  // false if the file can't be read.
+  bool Write(const std::string& output_file_name);
+  bool Read(const std::string& input_file_name);
+
+  void Reserve(uint32_t n_point);
+  void Clear();
+  uint32_t Size();
+  bool Empty();
+  double TotalWeight();
+
+  // Per-point accessors.  No bounds checking is done.
+  double UnitSphereX(uint32_t idx) {
+    return x_[idx];
+  };
+  double UnitSphereY(uint32_t idx) {
+    return y_[idx];
+  };
+  double UnitSphereZ(uint32_t idx) {
+    return z_[idx];
+  };
+  double Weight(uint32_t idx) {
+    return weight_[idx];
+  };
+  void SetWeight(uint32_t idx, double weight) {
+    weight_[idx] = weight;
+  };
+
+  // Raw access to the columns.  These pointers are invalidated by any method
+  // that adds points to the catalog.
+  double* XColumn();
+  double* YColumn();
+  double* ZColumn();
+  double* WeightColumn();
+
+  // The redshift column only exists if it has been added, either explicitly
+  // or by adding CosmoCoordinates.  Redshift returns 0 if there is no column
+  // and RedshiftColumn returns NULL.
+  void AddRedshiftColumn();
+  bool HasRedshift();
+  double Redshift(uint32_t idx);
+  void SetRedshift(uint32_t idx, double redshift);
+  double* RedshiftColumn();
+
+  // Field columns.  AddField returns false if a Field with that name already
+  // exists.  As with WeightedAngularCoordinate, Field returns 0 for a Field
+  // that doesn't exist and SetField creates a DoubleField column if needed.
+  bool AddField(const std::string& field_name,
+		FieldType field_type = DoubleField);
+  bool HasField(const std::string& field_name);
+  bool FindFieldType(const std::string& field_name, FieldType& field_type);
+  uint16_t NFields();
+  bool HasFields();
+  void FieldNames(std::vector<std::string>& field_names);
+  double Field(const std::string& field_name, uint32_t idx);
+  void SetField(const std::string& field_name, uint32_t idx, double value);
+
+  // Typed access to a Field column.  The return value is NULL if there is no
+  // such Field or if its type doesn't match the template type (double, float,
+  // int32_t or int64_t).
+  template<class T> T* FieldColumn(const std::string& field_name);
+
+  // Replace the weights with the values from a Field column.  Unlike the
+  // WeightedAngularCoordinate version, there is no automatic back-up of the
+  // original weights; copy WeightColumn() first if you need them.
+  bool CopyFieldToWeight(const std::string& field_name);
+
+#ifdef WITH_NUMPY
+  // Numpy arrays of the catalog columns.  The name is one of "x", "y", "z",
+  // "weight", "redshift" or the name of a Field; an unknown name raises an
+  // exception.  Each call returns a copy of the column, so the array stays
+  // valid after the catalog is deleted or grows, and writing to it doesn't
+  // change the catalog.
+  PyObject* Column(const std::string& column_name) throw (const char* );
+
+  // Add arrays of coordinates in the given system with an optional weight
+  // (either a scalar or one per point; unity by default).
+  void AddPoints(PyObject* x1obj, PyObject* x2obj, const std::string& system,
+		 PyObject* weightobj = NULL,
+		 uint32_t n_threads = DefaultThreads()) throw (const char* );
+#endif
+
+ private:
+  struct FieldData {
+    FieldType type;
+    std::vector<uint8_t> data;
+  };
+  typedef std::map<std::string, FieldData> FieldDataDict;
+  typedef FieldDataDict::iterator FieldDataIterator;
+
+  static uint8_t _FieldSize(FieldType field_type);
+  static double _FieldValue(FieldData& field, uint32_t idx);
+  static void _SetFieldValue(FieldData& field, uint32_t idx, double value);
+  template<class T> static bool _FieldTypeMatch(FieldType field_type);
+
+  // Bring the optional columns up to the length of the coordinate columns.
+  void _ResizeOptionalColumns();
+
+  std::vector<double> x_, y_, z_, weight_, redshift_;
+  FieldDataDict field_;
+  bool has_redshift_;
+};
+
+template<> inline bool PointCatalog::_FieldTypeMatch<double>(FieldType t) {
+  return t == DoubleField;
+}
+template<> inline bool PointCatalog::_FieldTypeMatch<float>(FieldType t) {
+  return t == FloatField;
+}
+template<> inline bool PointCatalog::_FieldTypeMatch<int32_t>(FieldType t) {
+  return t == Int32Field;
+}
+template<> inline bool PointCatalog::_FieldTypeMatch<int64_t>(FieldType t) {
+  return t == Int64Field;
+}
+
+template<class T> T* PointCatalog::FieldColumn(const std::string& field_name) {
+  FieldDataIterator iter = field_.find(field_name);
+  if ((iter == field_.end()) || !_FieldTypeMatch<T>(iter->second.type) ||
+      iter->second.data.empty()) return NULL;
+  return reinterpret_cast<T*>(&iter->second.data[0]);
+}
+
+} // end namespace Stomp
+
+#endif
@@ -0,0 +1,205 @@
+#include <stdint.h>
+#include <iostream>
+#include <math.h>
+#include <string>
+#include <vector>
+#include <gflags/gflags.h>
+#include "stomp_core.h"
+#include "stomp_angular_coordinate.h"
+#include "stomp_angular_bin.h"
+#include "stomp_pixel.h"
+#include "stomp_map.h"
+#include "stomp_scalar_map.h"
+#include "stomp_tree_map.h"
+#include "stomp_point_catalog.h"
+
+void PointCatalogBasicTests() {
+  // Build a catalog from a WAngularVector with a Field attached and make sure
+  // that the points, weights and Field values all survive the round trip.
+  std::cout << "\n";
+  std::cout << "********************************\n";
+  std::cout << "*** PointCatalog Basic Tests ***\n";
+  std::cout << "********************************\n";
+  Stomp::AngularCoordinate ang(60.0, 0.0, Stomp::AngularCoordinate::Survey);
+  Stomp::Pixel tmp_pix(ang, 256);
+  Stomp::PixelVector annulus_pix;
+  tmp_pix.WithinRadius(3.0, annulus_pix);
+  Stomp::Map* stomp_map = new Stomp::Map(annulus_pix);
+
+  uint32_t n_random = 10000;
+  Stomp::AngularVector rand_ang;
+  stomp_map->GenerateRandomPoints(rand_ang, n_random);
+
+  Stomp::WAngularVector w_ang;
+  w_ang.reserve(n_random);
+  for (uint32_t i=0;i<rand_ang.size();i++) {
+    Stomp::WeightedAngularCoordinate tmp_ang(rand_ang[i].UnitSphereX(),
+					     rand_ang[i].UnitSphereY(),
+					     rand_ang[i].UnitSphereZ(),
+					     1.0 + 0.5*(i % 3));
+    tmp_ang.SetField("magnitude", 20.0 + 0.001*i);
+    w_ang.push_back(tmp_ang);
+  }
+
+  Stomp::PointCatalog catalog(w_ang);
+  std::cout << "\t" << catalog.Size() << "/" << w_ang.size() <<
+    " points in catalog (" << catalog.NFields() << " Fields)\n";
+  if (catalog.Size() != w_ang.size())
+    std::cout << "\t\tFAILED: catalog size doesn't match input.\n";
+
+  uint32_t n_mismatch = 0;
+  double* magnitude = catalog.FieldColumn<double>("magnitude");
+  if (magnitude == NULL) {
+    std::cout << "\t\tFAILED: couldn't find magnitude column.\n";
+  } else {
+    for (uint32_t i=0;i<catalog.Size();i++) {
+      if ((fabs(catalog.UnitSphereX(i) - w_ang[i].UnitSphereX()) > 1.0e-10) ||
+	  (fabs(catalog.UnitSphereY(i) - w_ang[i].UnitSphereY()) > 1.0e-10) ||
+	  (fabs(catalog.UnitSphereZ(i) - w_ang[i].UnitSphereZ()) > 1.0e-10) ||
+	  (catalog.Weight(i) != w_ang[i].Weight()) ||
+	  (magnitude[i] != w_ang[i].Field("magnitude"))) n_mismatch++;
+    }
+  }
+  std::cout << "\t\t" << n_mismatch << " mismatched points.\n";
+  std::cout << "\t\tTotal weight: " << catalog.TotalWeight() << "\n";
+
+  // Asking for the wrong type should get us nothing.
+  if (catalog.FieldColumn<float>("magnitude") != NULL)
+    std::cout << "\t\tFAILED: typed Field access ignored type.\n";
+
+  // Now add the same points by their equatorial coordinates and append.
+  std::vector<double> raVec, decVec;
+  catalog.Coordinates(raVec, decVec);
+  Stomp::PointCatalog second_catalog;
+  second_catalog.AddPoints(raVec, decVec);
+  second_catalog.AddField("flag", Stomp::PointCatalog::Int32Field);
+  int32_t* flag = second_catalog.FieldColumn<int32_t>("flag");
+  for (uint32_t i=0;i<second_catalog.Size();i++) flag[i] = i % 2;
+  catalog.Append(second_catalog);
+  std::cout << "\tAppended catalog: " << catalog.Size() << " points, " <<
+    catalog.NFields() << " Fields\n";
+
+  n_mismatch = 0;
+  for (uint32_t i=0;i<second_catalog.Size();i++) {
+    uint32_t j = i + n_random;
+    if ((fabs(catalog.UnitSphereX(j) - catalog.UnitSphereX(i)) > 1.0e-10) ||
+	(fabs(catalog.UnitSphereY(j) - catalog.UnitSphereY(i)) > 1.0e-10) ||
+	(fabs(catalog.UnitSphereZ(j) - catalog.UnitSphereZ(i)) > 1.0e-10) ||
+	(catalog.Field("magnitude", j) != 0.0) ||
+	(catalog.Field("flag", j) != i % 2) ||
+	(catalog.Field("flag", i) != 0.0)) n_mismatch++;
+  }
+  std::cout << "\t\t" << n_mismatch << " mismatched appended points.\n";
+
+  // Select out the points with the flag set.
+  std::vector<uint8_t> keep(catalog.Size(), 0);
+  for (uint32_t i=0;i<catalog.Size();i++)
+    if (catalog.Field("flag", i) > 0.5) keep[i] = 1;
+  Stomp::PointCatalog flagged;
+  catalog.Select(keep, flagged);
+  std::cout << "\tSelected " << flagged.Size() << "/" << catalog.Size() <<
+    " points (expected " << n_random/2 << ")\n";
+
+  // Finally, a redshift column.
+  flagged.AddRedshiftColumn();
+  for (uint32_t i=0;i<flagged.Size();i++) flagged.SetRedshift(i, 0.1);
+  Stomp::PointCatalog copy_catalog;
+  copy_catalog.Append(flagged);
+  std::cout << "\tRedshift column: " << copy_catalog.HasRedshift() << ", " <<
+    copy_catalog.Redshift(0) << "\n";
+
+  delete stomp_map;
+}
+
+void PointCatalogMapTests() {
+  // Check that the PointCatalog versions of the Map, ScalarMap and TreeMap
+  // methods give the same answers as the WAngularVector versions.
+  std::cout << "\n";
+  std::cout << "******************************\n";
+  std::cout << "*** PointCatalog Map Tests ***\n";
+  std::cout << "******************************\n";
+  Stomp::AngularCoordinate ang(60.0, 0.0, Stomp::AngularCoordinate::Survey);
+  Stomp::Pixel tmp_pix(ang, 256);
+  Stomp::PixelVector annulus_pix;
+  tmp_pix.WithinRadius(3.0, annulus_pix);
+  Stomp::Map* stomp_map = new Stomp::Map(annulus_pix);
+
+  // Generate points over a larger area so that some fall outside the map.
+  Stomp::PixelVector big_pix;
+  tmp_pix.WithinRadius(4.0, big_pix);
+  Stomp::Map* big_map = new Stomp::Map(big_pix);
+  uint32_t n_random = 20000;
+  Stomp::AngularVector rand_ang;
+  big_map->GenerateRandomPoints(rand_ang, n_random);
+  Stomp::PointCatalog catalog(rand_ang);
+
+  std::vector<uint8_t> inside;
+  uint32_t n_inside = stomp_map->Contains(catalog, inside);
+  uint32_t n_inside_check = 0;
+  for (Stomp::AngularIterator iter=rand_ang.begin();
+       iter!=rand_ang.end();++iter)
+    if (stomp_map->Contains(*iter)) n_inside_check++;
+  std::cout << "\tMap::Contains: " << n_inside << " (" << n_inside_check <<
+    ") points inside map\n";
+
+  Stomp::ScalarMap* scalar_map =
+    new Stomp::ScalarMap(*stomp_map, 128, Stomp::ScalarMap::DensityField);
+  Stomp::ScalarMap* check_map =
+    new Stomp::ScalarMap(*stomp_map, 128, Stomp::ScalarMap::DensityField);
+  uint32_t n_added = scalar_map->AddToMap(catalog);
+  uint32_t n_added_check = 0;
+  for (Stomp::AngularIterator iter=rand_ang.begin();
+       iter!=rand_ang.end();++iter)
+    if (check_map->AddToMap(*iter)) n_added_check++;
+  std::cout << "\tScalarMap::AddToMap: " << n_added << " (" <<
+    n_added_check << ") points added\n";
+  std::cout << "\t\tMean intensity: " << scalar_map->MeanIntensity() <<
+    " (" << check_map->MeanIntensity() << ")\n";
+
+  Stomp::TreeMap* tree_map = new Stomp::TreeMap(128, 50);
+  Stomp::TreeMap* check_tree = new Stomp::TreeMap(128, 50);
+  uint32_t n_tree = tree_map->AddPoint(catalog);
+  for (Stomp::AngularIterator iter=rand_ang.begin();
+       iter!=rand_ang.end();++iter) check_tree->AddPoint(*iter);
+  std::cout << "\tTreeMap::AddPoint: " << n_tree << " (" <<
+    check_tree->NPoints() << ") points added, " << tree_map->Nodes() <<
+    " (" << check_tree->Nodes() << ") nodes\n";
+
+  Stomp::AngularBin theta(0.1, 0.5);
+  Stomp::AngularBin check_theta(0.1, 0.5);
+  Stomp::AngularVector pair_ang(rand_ang.begin(), rand_ang.begin() + 500);
+  Stomp::PointCatalog pair_catalog(pair_ang);
+  tree_map->FindPairs(pair_catalog, theta);
+  check_tree->FindPairs(pair_ang, check_theta);
+  std::cout << "\tTreeMap::FindPairs: " << theta.Counter() << " (" <<
+    check_theta.Counter() << ") pairs\n";
+
+  delete check_tree;
+  delete tree_map;
+  delete check_map;
+  delete scalar_map;
+  delete big_map;
+  delete stomp_map;
+}
+
+// Define our command line flags
+DEFINE_bool(all_point_catalog_tests, false, "Run all class unit tests.");
+DEFINE_bool(point_catalog_basic_tests, false, "Run PointCatalog basic tests");
+DEFINE_bool(point_catalog_map_tests, false, "Run PointCatalog map tests");
+
+void PointCatalogUnitTests(bool run_all_tests) {
+  void PointCatalogBasicTests();
+  void PointCatalogMapTests();
+
+  if (run_all_tests) FLAGS_all_point_catalog_tests = true;
+
+  // Check the basic routines for building, appending and selecting from a
+  // Stomp::PointCatalog.
+  if (FLAGS_all_point_catalog_tests || FLAGS_point_catalog_basic_tests)
+    PointCatalogBasicTests();
+
+  // Check the Stomp::PointCatalog versions of the Map, ScalarMap and TreeMap
+  // methods against their WAngularVector counterparts.
+  if (FLAGS_all_point_catalog_tests || FLAGS_point_catalog_map_tests)
+    PointCatalogMapTests();
+}
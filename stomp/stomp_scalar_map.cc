@@ -19,6 +19,8 @@
 #include "stomp_scalar_map.h"
 #include "stomp_map.h"
 #include "stomp_angular_correlation.h"
+#include "stomp_point_catalog.h"
+#include "stomp_util.h"
 
 namespace Stomp {
 
@@ -284,35 +286,32 @@ bool ScalarMap::Read(const std::string& InputFile,
 		ScalarMapType scalar_map_type, double min_unmasked_fraction) {
   Clear();
 
-  std::ifstream input_file(InputFile.c_str());
-
-  uint32_t hpixnum, superpixnum;
-  double unmask, intensity;
-  int npoints;
-  int resolution;  // have to use an int here because of old map formats
+  // The columns are HPIXNUM SUPERPIXNUM RESOLUTION UNMASKED INTENSITY NPOINTS.
+  std::vector<uint8_t> columns;
+  for (uint8_t k=0;k<6;k++) columns.push_back(k);
+  AsciiTable table;
   bool found_file = false;
 
   uint32_t x, y;
 
   ScalarVector pix;
 
-  if (input_file) {
-  	found_file = true;
-    while (!input_file.eof()) {
-    	input_file >> hpixnum >> superpixnum >> resolution >> unmask
-    						 >> intensity >> npoints;
-      if (!input_file.eof() && (resolution % 2 == 0) &&
-      		(resolution > 0)) {
-      	Pixel::HPix2XY(static_cast<uint32_t>(resolution), hpixnum, superpixnum,
-      								 x, y);
-      	pix.push_back(
-      			ScalarPixel(x, y, static_cast<uint32_t>(resolution),
-      			            unmask, intensity, npoints));
+  if (table.Read(InputFile, columns)) {
+    found_file = true;
+    pix.reserve(table.NRows());
+    for (uint32_t i=0;i<table.NRows();i++) {
+      // Resolution has to be handled as a signed value because of old map
+      // formats.
+      int resolution = static_cast<int>(table.Value(i, 2));
+      if (table.Complete(i) && (resolution % 2 == 0) && (resolution > 0)) {
+	Pixel::HPix2XY(static_cast<uint32_t>(resolution),
+		       static_cast<uint32_t>(table.Value(i, 0)),
+		       static_cast<uint32_t>(table.Value(i, 1)), x, y);
+	pix.push_back(ScalarPixel(x, y, static_cast<uint32_t>(resolution),
+				  table.Value(i, 3), table.Value(i, 4),
+				  static_cast<int>(table.Value(i, 5))));
       }
     }
-
-    input_file.close();
-
   } else {
     std::cout << "Stomp::ScalarMap::Read - " << InputFile <<
       " does not exist!.  No Map ingested\n";
@@ -565,6 +564,110 @@ bool ScalarMap::AddToMap(WeightedAngularCoordinate& ang) {
   return added_point;
 }
 
+uint32_t ScalarMap::AddToMap(PointCatalog& catalog, uint32_t n_threads) {
+  uint32_t n_point = catalog.Size();
+  double* x = catalog.XColumn();
+  double* y = catalog.YColumn();
+  double* z = catalog.ZColumn();
+  double* weight = catalog.WeightColumn();
+
+  // First find the pixel for each point in parallel...
+  std::vector<int64_t> pix_idx(n_point, -1);
+  const uint32_t block_size = 4096;
+  uint32_t n_block = (n_point + block_size - 1)/block_size;
+  ParallelFor(n_block, n_threads, [&](uint32_t block) {
+    uint32_t end = (block + 1)*block_size;
+    if (end > n_point) end = n_point;
+    AngularCoordinate ang;
+    for (uint32_t i=block*block_size;i<end;i++) {
+      ang.SetUnitSphereCoordinates(x[i], y[i], z[i]);
+      ScalarPixel tmp_pix(ang, resolution_);
+      ScalarPair iter = equal_range(pix_.begin(), pix_.end(), tmp_pix,
+				    Pixel::LocalOrder);
+      if (iter.first != iter.second) pix_idx[i] = iter.first - pix_.begin();
+    }
+  });
+
+  // ...and then add the weights serially.
+  uint32_t n_added = 0;
+  uint32_t n_point_per_object = (map_type_ == ScalarField ? 0 : 1);
+  for (uint32_t i=0;i<n_point;i++) {
+    if (pix_idx[i] >= 0) {
+      pix_[pix_idx[i]].AddToIntensity(weight[i], n_point_per_object);
+      total_intensity_ += weight[i];
+      total_points_++;
+      n_added++;
+    }
+  }
+
+  return n_added;
+}
+
+#ifdef WITH_NUMPY  // begin python-only code
+PyObject* ScalarMap::AddToMap(PyObject* x1obj, PyObject* x2obj,
+			      const std::string& system, PyObject* weightobj,
+			      uint32_t n_threads)
+  throw (const char* ) {
+  AngularCoordinate::Sphere sys = AngularCoordinate::SystemFromString(system);
+
+  // No copy made as long as the type and byte order is correct.
+  NumpyVector<double> x1(x1obj);
+  NumpyVector<double> x2(x2obj);
+  if (x1.size() != x2.size()) {
+    throw "coordinates must be same size";
+  }
+
+  // optional weight, can be scalar or x1.size()
+  NumpyVector<double> weight;
+  npy_intp n_weight = 0;
+  if (weightobj != NULL && weightobj != Py_None) {
+    weight.init(weightobj);
+    n_weight = weight.size();
+    if (n_weight != 1 && n_weight != x1.size()) {
+      throw "weight must be same length as coordinates or length 1";
+    }
+  }
+
+  npy_intp n_point = x1.size();
+  NumpyVector<npy_int8> added(n_point);
+
+  Py_BEGIN_ALLOW_THREADS
+  // First find the pixel for each point.  This is the expensive part and
+  // doesn't change the map, so it can be done in parallel.
+  std::vector<int64_t> pix_idx(n_point, -1);
+  const npy_intp block_size = 4096;
+  uint32_t n_block = (n_point + block_size - 1)/block_size;
+  ParallelFor(n_block, n_threads, [&](uint32_t block) {
+    npy_intp end = (block + 1)*block_size;
+    if (end > n_point) end = n_point;
+    AngularCoordinate ang;
+    for (npy_intp i=block*block_size;i<end;i++) {
+      ang.Set(x1.at(i), x2.at(i), sys);
+      ScalarPixel tmp_pix(ang, resolution_);
+      ScalarPair iter = equal_range(pix_.begin(), pix_.end(), tmp_pix,
+				    Pixel::LocalOrder);
+      if (iter.first != iter.second) pix_idx[i] = iter.first - pix_.begin();
+    }
+  });
+
+  // Then add the weights serially, in the same order as AddToMap would.
+  uint32_t n_point_per_object = (map_type_ == ScalarField ? 0 : 1);
+  for (npy_intp i=0;i<n_point;i++) {
+    if (pix_idx[i] >= 0) {
+      double object_weight =
+	(n_weight == 0 ? 1.0 : weight.at(n_weight > 1 ? i : 0));
+      pix_[pix_idx[i]].AddToIntensity(object_weight, n_point_per_object);
+      total_intensity_ += object_weight;
+      total_points_++;
+      added.at(i) = 1;
+    }
+  }
+  Py_END_ALLOW_THREADS
+
+  return added.getref();
+}
+#endif  // end python-only code
+
 bool ScalarMap::AddToMap(Pixel& pix) {
   bool added_pixel = false;
 
@@ -753,6 +856,14 @@ void ScalarMap::Resample(ScalarPixel& pix) {
     }
   }
 
+  _FinishResample(pix, unmasked_fraction, total_intensity, weighted_intensity,
+		  total_points);
+}
+
+void ScalarMap::_FinishResample(ScalarPixel& pix, double unmasked_fraction,
+				double total_intensity,
+				double weighted_intensity,
+				uint32_t total_points) {
   if (unmasked_fraction > 0.0000001) {
     // If we normalize weighted_intensity by the unmasked fraction, we have an
     // area-averaged value of the intensity over the pixel.
@@ -1421,14 +1532,24 @@ void ScalarMap::CrossCorrelate(WAngularVector& wang_vect,
   }
 
   if (theta_begin != theta_end) {
+    // Resample the map once for all of the coarser bins rather than once per
+    // bin.
+    uint32_t min_resolution = resolution_;
+    for (ThetaIterator theta_iter=theta_begin;
+	 theta_iter!=theta_end;++theta_iter)
+      if (theta_iter->Resolution() < min_resolution)
+	min_resolution = theta_iter->Resolution();
+    ScalarMapPyramid pyramid(*this, min_resolution);
+
     for (ThetaIterator theta_iter=theta_begin;
 	 theta_iter!=theta_end;++theta_iter) {
-    	if (theta_iter->Resolution() == resolution_)
-    		CrossCorrelate(wang_vect, theta_iter);
-    	else {
-    		ScalarMap scalar_map(*this, theta_iter->Resolution());
-    		scalar_map.CrossCorrelate(wang_vect, theta_iter);
-    	}
+      ScalarMap* scalar_map = pyramid.Level(theta_iter->Resolution());
+      if (scalar_map != NULL) {
+	scalar_map->CrossCorrelate(wang_vect, theta_iter);
+      } else {
+	ScalarMap tmp_map(*this, theta_iter->Resolution());
+	tmp_map.CrossCorrelate(wang_vect, theta_iter);
+      }
     }
 
   } else {
@@ -1846,4 +1967,165 @@ ScalarMap::ScalarMapType ScalarMap::MapType() {
   return map_type_;
 }
 
+// The running sums for a single pixel in a ScalarMapPyramid level; these are
+// the same sums that ScalarMap::Resample accumulates over the sub-pixels of
+// its input pixel.
+struct PyramidPixel {
+  uint32_t x, y;
+  double unmasked_fraction, total_intensity, weighted_intensity;
+  uint32_t total_points;
+};
+
+ScalarMapPyramid::ScalarMapPyramid(ScalarMap& scalar_map,
+				   uint32_t min_resolution,
+				   double min_unmasked_fraction) {
+  base_map_ = &scalar_map;
+  if (min_resolution < HPixResolution) min_resolution = HPixResolution;
+
+  bool initialized_regions = false;
+  std::vector<PyramidPixel> pyramid_pix;
+  pyramid_pix.reserve(scalar_map.Size());
+  for (ScalarIterator iter=scalar_map.Begin();
+       iter!=scalar_map.End();++iter) {
+    PyramidPixel tmp_pix = {iter->PixelX(), iter->PixelY(), iter->Weight(),
+			    iter->Intensity(),
+			    iter->Intensity()*iter->Weight(), iter->NPoints()};
+    pyramid_pix.push_back(tmp_pix);
+  }
+
+  for (uint32_t resolution=scalar_map.Resolution()/2;
+       resolution>=min_resolution;resolution/=2) {
+    // Since the pixels are in LocalOrder (by y, then x), the sub-pixels of
+    // each row of coarse pixels are in two consecutive runs: first those
+    // with even y, then those with odd y, each ordered by x.  Merging the
+    // two runs gives the coarse pixels in LocalOrder as well.
+    std::vector<PyramidPixel> coarse_pix;
+    coarse_pix.reserve(pyramid_pix.size()/2 + 1);
+    uint32_t n_pix = pyramid_pix.size();
+    uint32_t row_begin = 0;
+    while (row_begin < n_pix) {
+      uint32_t y = pyramid_pix[row_begin].y/2;
+      uint32_t odd_begin = row_begin;
+      while ((odd_begin < n_pix) && (pyramid_pix[odd_begin].y == 2*y))
+	odd_begin++;
+      uint32_t row_end = odd_begin;
+      while ((row_end < n_pix) && (pyramid_pix[row_end].y/2 == y)) row_end++;
+
+      uint32_t even_idx = row_begin, odd_idx = odd_begin;
+      while ((even_idx < odd_begin) || (odd_idx < row_end)) {
+	uint32_t x = 0;
+	if (odd_idx == row_end) {
+	  x = pyramid_pix[even_idx].x/2;
+	} else if (even_idx == odd_begin) {
+	  x = pyramid_pix[odd_idx].x/2;
+	} else {
+	  x = std::min(pyramid_pix[even_idx].x/2, pyramid_pix[odd_idx].x/2);
+	}
+
+	PyramidPixel tmp_pix = {x, y, 0.0, 0.0, 0.0, 0};
+	while ((even_idx < odd_begin) && (pyramid_pix[even_idx].x/2 == x)) {
+	  tmp_pix.unmasked_fraction += pyramid_pix[even_idx].unmasked_fraction;
+	  tmp_pix.total_intensity += pyramid_pix[even_idx].total_intensity;
+	  tmp_pix.weighted_intensity +=
+	    pyramid_pix[even_idx].weighted_intensity;
+	  tmp_pix.total_points += pyramid_pix[even_idx].total_points;
+	  even_idx++;
+	}
+	while ((odd_idx < row_end) && (pyramid_pix[odd_idx].x/2 == x)) {
+	  tmp_pix.unmasked_fraction += pyramid_pix[odd_idx].unmasked_fraction;
+	  tmp_pix.total_intensity += pyramid_pix[odd_idx].total_intensity;
+	  tmp_pix.weighted_intensity += pyramid_pix[odd_idx].weighted_intensity;
+	  tmp_pix.total_points += pyramid_pix[odd_idx].total_points;
+	  odd_idx++;
+	}
+
+	// The unmasked fraction and weighted intensity are per unit area, so
+	// each sub-pixel contributes a quarter of its value.
+	tmp_pix.unmasked_fraction *= 0.25;
+	tmp_pix.weighted_intensity *= 0.25;
+	coarse_pix.push_back(tmp_pix);
+      }
+
+      row_begin = row_end;
+    }
+    pyramid_pix.swap(coarse_pix);
+
+    ScalarVector level_pix;
+    level_pix.reserve(pyramid_pix.size());
+    for (std::vector<PyramidPixel>::iterator iter=pyramid_pix.begin();
+	 iter!=pyramid_pix.end();++iter) {
+      ScalarPixel tmp_pix(iter->x, iter->y, resolution);
+      scalar_map._FinishResample(tmp_pix, iter->unmasked_fraction,
+				 iter->total_intensity,
+				 iter->weighted_intensity,
+				 iter->total_points);
+      if (tmp_pix.Weight() > min_unmasked_fraction)
+	level_pix.push_back(tmp_pix);
+    }
+
+    ScalarMap* level_map = NULL;
+    if (level_pix.empty()) {
+      level_map = new ScalarMap();
+      level_map->SetResolution(resolution);
+      level_map->map_type_ = scalar_map.MapType();
+      level_map->unmasked_fraction_minimum_ = min_unmasked_fraction;
+    } else {
+      level_map = new ScalarMap(level_pix, scalar_map.MapType(),
+				min_unmasked_fraction);
+    }
+
+    // Each level takes its regions from the one above it, which is cheaper
+    // than going back to the input map every time.  Once the levels are
+    // coarser than the region resolution, this will fail, just as it would
+    // for the input map.
+    if (scalar_map.NRegion() > 0) {
+      if (levels_.empty()) {
+	initialized_regions = level_map->InitializeRegions(scalar_map);
+      } else if (initialized_regions) {
+	initialized_regions = level_map->InitializeRegions(*levels_.back());
+      } else {
+	level_map->InitializeRegions(scalar_map);
+      }
+    }
+
+    levels_.push_back(level_map);
+  }
+}
+
+ScalarMapPyramid::~ScalarMapPyramid() {
+  for (uint32_t i=0;i<levels_.size();i++) delete levels_[i];
+  levels_.clear();
+}
+
+ScalarMap* ScalarMapPyramid::Level(uint32_t resolution) {
+  if (resolution == base_map_->Resolution()) return base_map_;
+
+  uint32_t level_resolution = base_map_->Resolution()/2;
+  for (uint32_t i=0;i<levels_.size();i++,level_resolution/=2)
+    if (level_resolution == resolution) return levels_[i];
+
+  return NULL;
+}
+
+bool ScalarMapPyramid::InitializeRegions(BaseMap& base_map) {
+  bool initialized_regions = true;
+  for (uint32_t i=0;i<levels_.size();i++)
+    if (!levels_[i]->InitializeRegions(base_map)) initialized_regions = false;
+
+  return initialized_regions;
+}
+
+uint32_t ScalarMapPyramid::MinResolution() {
+  return (levels_.empty() ? base_map_->Resolution() :
+	  levels_.back()->Resolution());
+}
+
+uint32_t ScalarMapPyramid::MaxResolution() {
+  return base_map_->Resolution();
+}
+
+uint8_t ScalarMapPyramid::NLevels() {
+  return levels_.size() + 1;
+}
+
 } // end namespace Stomp
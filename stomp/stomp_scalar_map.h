@@ -31,7 +31,9 @@ class AngularCoordinate;           // class def. in stomp_angular_coordinate.h
 class WeightedAngularCoordinate;   // class def. in stomp_angular_coordinate.h
 class AngularCorrelation;          // class def. in stomp_angular_correlation.h
 class Map;                         // class definition in stomp_map.h
+class PointCatalog;                // class def. in stomp_point_catalog.h
 class ScalarMap;
+class ScalarMapPyramid;
 
 typedef std::vector<ScalarMap> ScalarMapVector;
 typedef ScalarMapVector::iterator ScalarMapIterator;
@@ -154,6 +156,26 @@ class ScalarMap : public BaseMap {
   bool AddToMap(AngularCoordinate& ang, double object_weight = 1.0);
   bool AddToMap(WeightedAngularCoordinate& ang);
 
+  // The PointCatalog version adds every point in the catalog with its
+  // weight and returns the number of points that landed in the map.  As with
+  // the numpy version below, the pixel lookups are split over n_threads
+  // threads and the weights are then added in catalog order.
+  uint32_t AddToMap(PointCatalog& catalog,
+		    uint32_t n_threads = DefaultThreads());
+
+#ifdef WITH_NUMPY
+  // The numpy version takes arrays of coordinates in the given system and an
+  // optional weight (either a scalar or one per point; unity by default) and
+  // returns an int8 array flagging the points that landed in the map.  The
+  // pixel lookups are split over n_threads threads with the GIL released;
+  // the weights are then added in input order, so the result is the same as
+  // adding the points one at a time.
+  PyObject* AddToMap(PyObject* x1obj, PyObject* x2obj,
+		     const std::string& system, PyObject* weightobj = NULL,
+		     uint32_t n_threads = DefaultThreads())
+    throw (const char* );
+#endif
+
   // Alternatively, if we are encoding a pure scalar field, then this method
   // will import the weight value from the input pixel into the proper fields.
   // If the input pixel is at a higher resolution than the current resolution
@@ -309,6 +331,14 @@ class ScalarMap : public BaseMap {
 
 
  private:
+  friend class ScalarMapPyramid;
+
+  // The second half of Resample: given the sums over the sub-pixels of pix,
+  // set pix's weight, intensity and point count.
+  void _FinishResample(ScalarPixel& pix, double unmasked_fraction,
+		       double total_intensity, double weighted_intensity,
+		       uint32_t total_points);
+
   ScalarVector pix_;
   ScalarMapType map_type_;
   double area_, mean_intensity_, unmasked_fraction_minimum_, total_intensity_;
@@ -318,6 +348,43 @@ class ScalarMap : public BaseMap {
   std::vector<double> local_mean_intensity_;
 };
 
+class ScalarMapPyramid {
+  // The pixel-based correlation estimators need the same ScalarMap at every
+  // resolution from the finest down to the coarsest angular bin.  Building
+  // each of those with the resampling ScalarMap constructor goes back to the
+  // finest map for every coarse pixel, so the total cost is one full pass
+  // over the finest map per level.  A ScalarMapPyramid instead builds each
+  // level by summing the four sub-pixels of the level above it, so that the
+  // whole pyramid costs about 4/3 of a single pass over the finest map.  The
+  // resulting maps match what ScalarMap(scalar_map, resolution) would give.
+  //
+  // The input map serves as the finest level, so it needs to stay in scope
+  // for as long as the pyramid is in use.  If the input map has regions,
+  // each level gets the same region assignments.
+
+ public:
+  ScalarMapPyramid(ScalarMap& scalar_map,
+		   uint32_t min_resolution = HPixResolution,
+		   double min_unmasked_fraction = 0.0000001);
+  ~ScalarMapPyramid();
+
+  // The map at the requested resolution, or NULL if the resolution is outside
+  // the range of the pyramid.  At MaxResolution, this is the input map.
+  ScalarMap* Level(uint32_t resolution);
+
+  // Re-assign the regions for all of the coarser levels based on the input
+  // map, e.g. to give one map in a cross-correlation the regions of the other.
+  bool InitializeRegions(BaseMap& base_map);
+
+  uint32_t MinResolution();
+  uint32_t MaxResolution();
+  uint8_t NLevels();
+
+ private:
+  ScalarMap* base_map_;
+  std::vector<ScalarMap*> levels_;
+};
+
 } // end namespace Stomp
 
 #endif
@@ -396,12 +396,76 @@ void ScalarMapCrossCorrelationTests() {
   }
 }
 
+void ScalarMapPyramidTests() {
+  // Check that each level of a Stomp::ScalarMapPyramid matches the map we
+  // get from the resampling constructor, both for a raw map and after the
+  // conversion to over-density.
+  std::cout << "\n";
+  std::cout << "*******************************\n";
+  std::cout << "*** ScalarMap Pyramid Tests ***\n";
+  std::cout << "*******************************\n";
+  Stomp::AngularCoordinate ang(60.0, 0.0, Stomp::AngularCoordinate::Survey);
+  Stomp::Pixel tmp_pix(ang, 256);
+  Stomp::PixelVector annulus_pix;
+  tmp_pix.WithinRadius(3.0, annulus_pix);
+  Stomp::Map* stomp_map = new Stomp::Map(annulus_pix);
+  Stomp::ScalarMap* scalar_map =
+    new Stomp::ScalarMap(*stomp_map, 256, Stomp::ScalarMap::DensityField);
+
+  Stomp::AngularVector rand_ang;
+  stomp_map->GenerateRandomPoints(rand_ang, 10000);
+  for (Stomp::AngularIterator iter=rand_ang.begin();iter!=rand_ang.end();++iter)
+    scalar_map->AddToMap(*iter, 2.0);
+
+  for (uint32_t k=0;k<2;k++) {
+    if (k == 1) {
+      std::cout << "\tPost-overdensity translation:\n";
+      scalar_map->ConvertToOverDensity();
+    }
+
+    Stomp::ScalarMapPyramid pyramid(*scalar_map);
+    std::cout << "\t" << static_cast<int>(pyramid.NLevels()) <<
+      " levels from " << pyramid.MaxResolution() << " to " <<
+      pyramid.MinResolution() << "\n";
+    for (uint32_t resolution=scalar_map->Resolution()/2;
+	 resolution>=Stomp::HPixResolution;resolution /= 2) {
+      Stomp::ScalarMap* level_map = pyramid.Level(resolution);
+      Stomp::ScalarMap* sub_scalar_map =
+	new Stomp::ScalarMap(*scalar_map, resolution);
+      uint32_t n_mismatch = 0;
+      if ((level_map == NULL) || (level_map->Size() != sub_scalar_map->Size())) {
+	n_mismatch = sub_scalar_map->Size();
+      } else {
+	Stomp::ScalarIterator level_iter = level_map->Begin();
+	for (Stomp::ScalarIterator iter=sub_scalar_map->Begin();
+	     iter!=sub_scalar_map->End();++iter,++level_iter) {
+	  if ((iter->Pixnum() != level_iter->Pixnum()) ||
+	      (iter->NPoints() != level_iter->NPoints()) ||
+	      (fabs(iter->Weight() - level_iter->Weight()) > 1.0e-10) ||
+	      (fabs(iter->Intensity() - level_iter->Intensity()) >
+	       1.0e-10*(1.0 + fabs(iter->Intensity())))) n_mismatch++;
+	}
+      }
+      std::cout << "\t\t" << resolution << ": " <<
+	(level_map == NULL ? 0 : level_map->Size()) << " (" <<
+	sub_scalar_map->Size() << ") pixels, " << n_mismatch <<
+	" mismatched\n";
+      delete sub_scalar_map;
+    }
+  }
+
+  delete scalar_map;
+  delete stomp_map;
+}
+
 // Define our command line flags
 DEFINE_bool(all_scalar_map_tests, false, "Run all class unit tests.");
 DEFINE_bool(scalar_map_basic_tests, false, "Run ScalarMap basic tests");
 DEFINE_bool(scalar_map_local_tests, false, "Run ScalarMap local tests");
 DEFINE_bool(scalar_map_resampling_tests, false,
             "Run ScalarMap resampling tests");
+DEFINE_bool(scalar_map_pyramid_tests, false,
+            "Run ScalarMapPyramid tests");
 DEFINE_bool(scalar_map_region_tests, false, "Run ScalarMap region tests");
 DEFINE_bool(scalar_map_autocorrelation_tests, false,
             "Run ScalarMap auto-correlation tests");
@@ -412,6 +476,7 @@ void ScalarMapUnitTests(bool run_all_tests) {
   void ScalarMapBasicTests();
   void ScalarMapLocalTests();
   void ScalarMapResamplingTests();
+  void ScalarMapPyramidTests();
   void ScalarMapRegionTests();
   void ScalarMapAutoCorrelationTests();
   void ScalarMapCrossCorrelationTests();
@@ -433,6 +498,10 @@ void ScalarMapUnitTests(bool run_all_tests) {
   if (FLAGS_all_scalar_map_tests || FLAGS_scalar_map_resampling_tests)
     ScalarMapResamplingTests();
 
+  // Check the Stomp::ScalarMapPyramid levels against the resampled maps.
+  if (FLAGS_all_scalar_map_tests || FLAGS_scalar_map_pyramid_tests)
+    ScalarMapPyramidTests();
+
   // Check the routines for splitting up the area of a Stomp::ScalarMap into
   // roughly equal-area regions.
   if (FLAGS_all_scalar_map_tests || FLAGS_scalar_map_region_tests)
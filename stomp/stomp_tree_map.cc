@@ -23,6 +23,8 @@
 #include "stomp_radial_bin.h"
 #include "stomp_angular_correlation.h"
 #include "stomp_util.h"
+#include "stomp_point_catalog.h"
+#include "stomp_catalog_reader.h"
 
 namespace Stomp {
 
@@ -91,7 +93,7 @@ uint32_t TreeMap::FindPairs(AngularCoordinate& ang, AngularBin& theta) {
   for (PixelIterator pix_iter=pix.begin();pix_iter!=pix.end();++pix_iter) {
     TreeDictIterator iter = tree_map_.find(pix_iter->Pixnum());
     if (iter != tree_map_.end())
-      pair_count += tree_map_[pix_iter->Pixnum()]->FindPairs(ang, theta);
+      pair_count += iter->second->FindPairs(ang, theta);
   }
   return pair_count;
 }
@@ -127,6 +129,91 @@ void TreeMap::FindPairs(AngularVector& ang, AngularCorrelation& wtheta) {
   }
 }
 
+void TreeMap::FindPairs(PointCatalog& catalog, AngularBin& theta) {
+  AngularCoordinate ang;
+  for (uint32_t i=0;i<catalog.Size();i++) {
+    catalog.Point(i, ang);
+    FindPairs(ang, theta);
+  }
+}
+
+void TreeMap::FindPairs(PointCatalog& catalog, AngularCorrelation& wtheta) {
+  for (ThetaIterator theta_iter=wtheta.Begin(0);
+       theta_iter!=wtheta.End(0);++theta_iter)
+    FindPairs(catalog, *theta_iter);
+}
+
+#ifdef WITH_NUMPY  // begin python-only code
+PyObject* TreeMap::FindPairs(PyObject* x1obj, PyObject* x2obj,
+			     const std::string& system,
+			     double theta_min, double theta_max,
+			     uint32_t n_threads)
+  throw (const char* ) {
+  AngularCoordinate::Sphere sys = AngularCoordinate::SystemFromString(system);
+
+  // No copy made as long as the type and byte order is correct.
+  NumpyVector<double> x1(x1obj);
+  NumpyVector<double> x2(x2obj);
+  if (x1.size() != x2.size()) {
+    throw "coordinates must be same size";
+  }
+
+  npy_intp n_point = x1.size();
+  NumpyVector<npy_uint32> pair_count(n_point);
+
+  // The single-point FindPairs uses its own AngularBin and only reads from
+  // the tree, so the points can be spread over threads directly.
+  Py_BEGIN_ALLOW_THREADS
+  const npy_intp block_size = 1024;
+  uint32_t n_block = (n_point + block_size - 1)/block_size;
+  ParallelFor(n_block, n_threads, [&](uint32_t block) {
+    npy_intp end = (block + 1)*block_size;
+    if (end > n_point) end = n_point;
+    AngularCoordinate ang;
+    for (npy_intp i=block*block_size;i<end;i++) {
+      ang.Set(x1.at(i), x2.at(i), sys);
+      pair_count.at(i) = FindPairs(ang, theta_min, theta_max);
+    }
+  });
+  Py_END_ALLOW_THREADS
+
+  return pair_count.getref();
+}
+
+PyObject* TreeMap::FindWeightedPairs(PyObject* x1obj, PyObject* x2obj,
+				     const std::string& system,
+				     double theta_min, double theta_max,
+				     uint32_t n_threads)
+  throw (const char* ) {
+  AngularCoordinate::Sphere sys = AngularCoordinate::SystemFromString(system);
+
+  NumpyVector<double> x1(x1obj);
+  NumpyVector<double> x2(x2obj);
+  if (x1.size() != x2.size()) {
+    throw "coordinates must be same size";
+  }
+
+  npy_intp n_point = x1.size();
+  NumpyVector<double> total_weight(n_point);
+
+  Py_BEGIN_ALLOW_THREADS
+  const npy_intp block_size = 1024;
+  uint32_t n_block = (n_point + block_size - 1)/block_size;
+  ParallelFor(n_block, n_threads, [&](uint32_t block) {
+    npy_intp end = (block + 1)*block_size;
+    if (end > n_point) end = n_point;
+    AngularCoordinate ang;
+    for (npy_intp i=block*block_size;i<end;i++) {
+      ang.Set(x1.at(i), x2.at(i), sys);
+      total_weight.at(i) = FindWeightedPairs(ang, theta_min, theta_max);
+    }
+  });
+  Py_END_ALLOW_THREADS
+
+  return total_weight.getref();
+}
+#endif  // end python-only code
+
 double TreeMap::FindWeightedPairs(AngularCoordinate& ang, AngularBin& theta) {
   double total_weight = 0.0;
 
@@ -141,8 +228,7 @@ double TreeMap::FindWeightedPairs(AngularCoordinate& ang, AngularBin& theta) {
   for (PixelIterator pix_iter=pix.begin();pix_iter!=pix.end();++pix_iter) {
     TreeDictIterator iter = tree_map_.find(pix_iter->Pixnum());
     if (iter != tree_map_.end())
-      total_weight +=
-	tree_map_[pix_iter->Pixnum()]->FindWeightedPairs(ang, theta);
+      total_weight += iter->second->FindWeightedPairs(ang, theta);
   }
   return total_weight;
 }
@@ -234,6 +320,21 @@ void TreeMap::FindWeightedPairs(WAngularVector& w_ang,
   }
 }
 
+void TreeMap::FindWeightedPairs(PointCatalog& catalog, AngularBin& theta) {
+  WeightedAngularCoordinate w_ang;
+  for (uint32_t i=0;i<catalog.Size();i++) {
+    catalog.Point(i, w_ang);
+    FindWeightedPairs(w_ang, theta);
+  }
+}
+
+void TreeMap::FindWeightedPairs(PointCatalog& catalog,
+				AngularCorrelation& wtheta) {
+  for (ThetaIterator theta_iter=wtheta.Begin(0);
+       theta_iter!=wtheta.End(0);++theta_iter)
+    FindWeightedPairs(catalog, *theta_iter);
+}
+
 double TreeMap::FindWeightedPairs(AngularCoordinate& ang, AngularBin& theta,
 				  const std::string& field_name) {
   double total_weight = 0.0;
@@ -587,6 +688,46 @@ void TreeMap::FindWeightedPairsWithRegions(WAngularVector& w_ang,
     FindWeightedPairsWithRegions(w_ang, *theta_iter);
 }
 
+void TreeMap::FindWeightedPairsWithRegions(PointCatalog& catalog,
+					   AngularBin& theta) {
+  if (!RegionsInitialized()) {
+    std::cout <<
+      "Stomp::TreeMap::FindWeightedPairsWithRegions - " <<
+      "Must initialize regions before calling FindPairsWithRegions\n" <<
+      "\tExiting...\n";
+    exit(2);
+  }
+
+  // First we need to find out which pixels this angular bin possibly touches.
+  Pixel center_pix;
+  center_pix.SetResolution(resolution_);
+  PixelVector pix;
+  WeightedAngularCoordinate w_ang;
+  for (uint32_t i=0;i<catalog.Size();i++) {
+    catalog.Point(i, w_ang);
+    center_pix.BoundingRadius(w_ang, theta.ThetaMax(), pix);
+    uint16_t region = FindRegion(center_pix);
+
+    for (PixelIterator pix_iter=pix.begin();pix_iter!=pix.end();++pix_iter) {
+      TreeDictIterator iter = tree_map_.find(pix_iter->Pixnum());
+      if (iter != tree_map_.end()) {
+	if (region == FindRegion(*pix_iter)) {
+	  iter->second->FindWeightedPairs(w_ang, theta, region);
+	} else {
+	  iter->second->FindWeightedPairs(w_ang, theta);
+	}
+      }
+    }
+  }
+}
+
+void TreeMap::FindWeightedPairsWithRegions(PointCatalog& catalog,
+					   AngularCorrelation& wtheta) {
+  for (ThetaIterator theta_iter=wtheta.Begin(0);
+       theta_iter!=wtheta.End(0);++theta_iter)
+    FindWeightedPairsWithRegions(catalog, *theta_iter);
+}
+
 void TreeMap::FindWeightedPairsWithRegions(AngularVector& ang,
 					   AngularBin& theta,
 					   const std::string& field_name) {
@@ -955,70 +1096,155 @@ bool TreeMap::AddPoint(AngularCoordinate& ang, double object_weight) {
   return AddPoint(w_ang);
 }
 
-bool TreeMap::Read(const std::string& input_file,
-		   AngularCoordinate::Sphere sphere, bool verbose,
-		   uint8_t theta_column, uint8_t phi_column,
-		   int8_t weight_column) {
-  bool io_success = false;
+uint32_t TreeMap::AddPoint(PointCatalog& catalog, uint32_t n_threads) {
+  uint32_t n_point = catalog.Size();
+  std::vector<std::string> field_names;
+  catalog.FieldNames(field_names);
+
+  // Make the new points and find their base nodes in parallel.
+  WAngularPtrVector w_ang(n_point);
+  std::vector<uint32_t> pixnum(n_point);
+  const uint32_t block_size = 4096;
+  uint32_t n_block = (n_point + block_size - 1)/block_size;
+  ParallelFor(n_block, n_threads, [&](uint32_t block) {
+    uint32_t end = (block + 1)*block_size;
+    if (end > n_point) end = n_point;
+    Pixel pix;
+    pix.SetResolution(resolution_);
+    for (uint32_t i=block*block_size;i<end;i++) {
+      w_ang[i] = new WeightedAngularCoordinate(catalog.UnitSphereX(i),
+					       catalog.UnitSphereY(i),
+					       catalog.UnitSphereZ(i),
+					       catalog.Weight(i));
+      for (uint16_t j=0;j<field_names.size();j++)
+	w_ang[i]->SetField(field_names[j], catalog.Field(field_names[j], i));
+      pix.SetPixnumFromAng(*w_ang[i]);
+      pixnum[i] = pix.Pixnum();
+    }
+  });
 
-  uint32_t n_lines = 0;
-  uint32_t check_lines = 128;
-  if (theta_column != phi_column) {
-    std::ifstream input_file_str(input_file.c_str());
+  std::vector<uint8_t> added;
+  return _AddPoints(w_ang, pixnum, added, n_threads);
+}
 
-    uint8_t weight_idx = static_cast<uint8_t>(weight_column);
+uint32_t TreeMap::_AddPoints(WAngularPtrVector& w_ang,
+			     std::vector<uint32_t>& pixnum,
+			     std::vector<uint8_t>& added, uint32_t n_threads) {
+  uint32_t n_point = w_ang.size();
+  added.assign(n_point, 0);
 
-    if (input_file_str) {
-      io_success = true;
-      if (verbose) std::cout << "Stomp::TreeMap::Read - " <<
-		     "Reading from " << input_file << "...\n";
-      while (!input_file_str.eof()) {
-	if (!input_file_str.eof()) {
-	  // This should read each line into a buffer, convert that buffer into
-	  // a string and then break that string into a vector of strings.  We
-	  // should then be able to access theta and phi by converting the
-	  // appropriate elements of that vector to doubles.
-	  char line_buffer[1000];
-	  std::vector<std::string> line_elements;
-
-	  input_file_str.getline(line_buffer, 1000);
-	  std::string line_string(line_buffer);
-	  Tokenize(line_string, line_elements, " ");
-	  n_lines++;
-	  if (verbose && n_lines == check_lines) {
-	    std::cout << "\tRead " << check_lines << " lines...\n";
-	    check_lines *= 2;
-	  }
+  // Group the points by base node, creating any nodes we don't have yet.
+  // Only this step modifies tree_map_ itself.
+  std::map<uint32_t, std::vector<uint32_t> > node_points;
+  for (uint32_t i=0;i<n_point;i++) node_points[pixnum[i]].push_back(i);
 
-	  if ((line_elements.size() > theta_column) &&
-	      (line_elements.size() > phi_column)) {
-	    double theta = strtod(line_elements[theta_column].c_str(), NULL);
-	    double phi = strtod(line_elements[phi_column].c_str(), NULL);
-	    double weight = 1.0;
-	    if ((weight_column > -1) &&
-		(line_elements.size() > weight_idx)) {
-	      weight = strtod(line_elements[weight_idx].c_str(), NULL);
-	    }
+  std::vector<std::pair<TreePixel*, std::vector<uint32_t>*> > nodes;
+  nodes.reserve(node_points.size());
+  for (std::map<uint32_t, std::vector<uint32_t> >::iterator
+	 node_iter=node_points.begin();
+       node_iter!=node_points.end();++node_iter) {
+    TreeDictIterator iter = tree_map_.find(node_iter->first);
+    if (iter == tree_map_.end()) {
+      Pixel pix(resolution_, node_iter->first);
+      iter = tree_map_.insert(std::pair<uint32_t, TreePixel *>(
+	node_iter->first, new TreePixel(pix.PixelX(), pix.PixelY(),
+					resolution_, maximum_points_))).first;
+    }
+    nodes.push_back(std::make_pair(iter->second, &node_iter->second));
+  }
 
-	    WeightedAngularCoordinate* w_ang =
-	      new WeightedAngularCoordinate(theta, phi, weight, sphere);
-	    if (!AddPoint(w_ang)) io_success = false;
-	  }
-	}
-      }
-      input_file_str.close();
+  // Each node is independent of the others, so fill them in parallel.  Each
+  // node still sees its points in input order, so the resulting tree is the
+  // same as adding the points one at a time.
+  ParallelFor(nodes.size(), n_threads, [&](uint32_t k) {
+    std::vector<uint32_t>& idx = *nodes[k].second;
+    for (uint32_t m=0;m<idx.size();m++)
+      if (nodes[k].first->AddPoint(w_ang[idx[m]])) added[idx[m]] = 1;
+  });
+
+  uint32_t n_added = 0;
+  for (uint32_t i=0;i<n_point;i++) {
+    if (added[i]) {
+      n_added++;
+      point_count_++;
+      weight_ += w_ang[i]->Weight();
+      for (FieldIterator iter=w_ang[i]->FieldBegin();
+	   iter!=w_ang[i]->FieldEnd();++iter)
+	field_total_[iter->first] += iter->second;
     } else {
-      std::cout << "Stomp::TreeMap::Read - " << input_file <<
-	" does not exist!\n";
+      delete w_ang[i];
     }
   }
+  modified_ = true;
+
+  return n_added;
+}
 
-  if (verbose && io_success)
-    std::cout << "Stomp::TreeMap::Read - Read " << n_lines-1 <<
-      " lines from " << input_file << "; loaded " << NPoints() <<
-      " into tree...\n";
+#ifdef WITH_NUMPY  // begin python-only code
+PyObject* TreeMap::AddPoint(PyObject* x1obj, PyObject* x2obj,
+			    const std::string& system, PyObject* weightobj,
+			    uint32_t n_threads)
+  throw (const char* ) {
+  AngularCoordinate::Sphere sys = AngularCoordinate::SystemFromString(system);
 
-  return io_success;
+  // No copy made as long as the type and byte order is correct.
+  NumpyVector<double> x1(x1obj);
+  NumpyVector<double> x2(x2obj);
+  if (x1.size() != x2.size()) {
+    throw "coordinates must be same size";
+  }
+
+  // optional weight, can be scalar or x1.size()
+  NumpyVector<double> weight;
+  npy_intp n_weight = 0;
+  if (weightobj != NULL && weightobj != Py_None) {
+    weight.init(weightobj);
+    n_weight = weight.size();
+    if (n_weight != 1 && n_weight != x1.size()) {
+      throw "weight must be same length as coordinates or length 1";
+    }
+  }
+
+  npy_intp n_point = x1.size();
+  NumpyVector<npy_int8> added(n_point);
+
+  Py_BEGIN_ALLOW_THREADS
+  // Make the new points and find their base nodes in parallel.
+  WAngularPtrVector w_ang(n_point);
+  std::vector<uint32_t> pixnum(n_point);
+  const npy_intp block_size = 4096;
+  uint32_t n_block = (n_point + block_size - 1)/block_size;
+  ParallelFor(n_block, n_threads, [&](uint32_t block) {
+    npy_intp end = (block + 1)*block_size;
+    if (end > n_point) end = n_point;
+    Pixel pix;
+    pix.SetResolution(resolution_);
+    for (npy_intp i=block*block_size;i<end;i++) {
+      double object_weight =
+	(n_weight == 0 ? 1.0 : weight.at(n_weight > 1 ? i : 0));
+      w_ang[i] = new WeightedAngularCoordinate(x1.at(i), x2.at(i),
+					       object_weight, sys);
+      pix.SetPixnumFromAng(*w_ang[i]);
+      pixnum[i] = pix.Pixnum();
+    }
+  });
+
+  std::vector<uint8_t> point_added;
+  _AddPoints(w_ang, pixnum, point_added, n_threads);
+  for (npy_intp i=0;i<n_point;i++) added.at(i) = point_added[i];
+  Py_END_ALLOW_THREADS
+
+  return added.getref();
+}
+#endif  // end python-only code
+
+bool TreeMap::Read(const std::string& input_file,
+		   AngularCoordinate::Sphere sphere, bool verbose,
+		   uint8_t theta_column, uint8_t phi_column,
+		   int8_t weight_column) {
+  FieldColumnDict field_columns;
+  return Read(input_file, field_columns, sphere, verbose, theta_column,
+	      phi_column, weight_column);
 }
 
 bool TreeMap::Read(const std::string& input_file,
@@ -1028,71 +1254,87 @@ bool TreeMap::Read(const std::string& input_file,
 		   int8_t weight_column) {
   bool io_success = false;
 
-  uint32_t n_lines = 0;
-  uint32_t check_lines = 128;
   if (theta_column != phi_column) {
-    std::ifstream input_file_str(input_file.c_str());
-
-    uint8_t weight_idx = static_cast<uint8_t>(weight_column);
+    // As with the WeightedAngularCoordinate readers, the table columns are
+    // theta, phi, the optional weight and then the Fields.
+    std::vector<uint8_t> columns;
+    columns.push_back(theta_column);
+    columns.push_back(phi_column);
+    uint8_t field_start = 2;
+    if (weight_column > -1) {
+      columns.push_back(static_cast<uint8_t>(weight_column));
+      field_start++;
+    }
+    for (FieldColumnIterator iter=field_columns.begin();
+	 iter!=field_columns.end();++iter) columns.push_back(iter->second);
 
-    if (input_file_str) {
+    if (verbose) std::cout << "Stomp::TreeMap::Read - Reading from " <<
+		   input_file << "...\n";
+    AsciiTable table;
+    if (table.Read(input_file, columns)) {
       io_success = true;
-      if (verbose) std::cout << "Stomp::TreeMap::Read - Reading from " <<
-		     input_file << "...\n";
-      while (!input_file_str.eof()) {
-	if (!input_file_str.eof()) {
-	  // This should read each line into a buffer, convert that buffer into
-	  // a string and then break that string into a vector of strings.  We
-	  // should then be able to access theta and phi by converting the
-	  // appropriate elements of that vector to doubles.
-	  char line_buffer[1000];
-	  std::vector<std::string> line_elements;
-
-	  input_file_str.getline(line_buffer, 1000);
-	  std::string line_string(line_buffer);
-	  Tokenize(line_string, line_elements, " ");
-	  n_lines++;
-	  if (verbose && n_lines == check_lines) {
-	    std::cout << "\tRead " << check_lines << " lines...\n";
-	    check_lines *= 2;
-	  }
-	  if ((line_elements.size() > theta_column) &&
-	      (line_elements.size() > phi_column)) {
-	    double theta = strtod(line_elements[theta_column].c_str(), NULL);
-	    double phi = strtod(line_elements[phi_column].c_str(), NULL);
-	    double weight = 1.0;
-	    if ((weight_column > -1) &&
-		(line_elements.size() > weight_idx)) {
-	      weight = strtod(line_elements[weight_idx].c_str(), NULL);
-	    }
 
-	    FieldDict fields;
-	    for (FieldColumnIterator iter=field_columns.begin();
-		 iter!=field_columns.end();++iter) {
-	      fields[iter->first] = 0.0;
-	      if (line_elements.size() > iter->second) {
-		fields[iter->first] =
-		  strtod(line_elements[iter->second].c_str(), NULL);
-	      }
-	    }
+      std::vector<uint32_t> rows;
+      rows.reserve(table.NRows());
+      for (uint32_t i=0;i<table.NRows();i++)
+	if (table.HasValue(i, 0) && table.HasValue(i, 1)) rows.push_back(i);
+
+      std::vector<double> thetaVec(rows.size()), phiVec(rows.size());
+      std::vector<double> weightVec(rows.size(), 1.0);
+      for (uint32_t i=0;i<rows.size();i++) {
+	thetaVec[i] = table.Value(rows[i], 0);
+	phiVec[i] = table.Value(rows[i], 1);
+	if ((weight_column > -1) && table.HasValue(rows[i], 2))
+	  weightVec[i] = table.Value(rows[i], 2);
+      }
 
-	    WeightedAngularCoordinate* w_ang =
-	      new WeightedAngularCoordinate(theta, phi, weight, fields, sphere);
-	    if (!AddPoint(w_ang)) io_success = false;
-	  }
-	}
+      PointCatalog catalog;
+      catalog.AddPoints(thetaVec, phiVec, weightVec, sphere);
+      uint8_t k = field_start;
+      for (FieldColumnIterator iter=field_columns.begin();
+	   iter!=field_columns.end();++iter,k++) {
+	catalog.AddField(iter->first);
+	double* field = catalog.FieldColumn<double>(iter->first);
+	for (uint32_t i=0;i<rows.size();i++)
+	  field[i] = table.Value(rows[i], k);
       }
-      input_file_str.close();
+
+      if (AddPoint(catalog) != catalog.Size()) io_success = false;
+
+      if (verbose && io_success)
+	std::cout << "Stomp::TreeMap::Read - Read " << table.NRows() <<
+	  " lines from " << input_file << "; loaded " << NPoints() <<
+	  " into tree...\n";
     } else {
       std::cout << "Stomp::TreeMap::Read - " << input_file <<
 	" does not exist!\n";
     }
   }
 
-  if (verbose && io_success)
-    std::cout << "Stomp::TreeMap::Read - Read " << n_lines-1 <<
-      " lines from " << input_file << "; loaded " << NPoints() <<
-      " into tree...\n";
+  return io_success;
+}
+
+bool TreeMap::Read(CatalogReader& reader, bool verbose, uint32_t chunk_rows) {
+  if (chunk_rows == 0) chunk_rows = CatalogReader::DefaultChunkRows;
+
+  bool io_success = true;
+  uint64_t n_read = 0;
+  uint64_t check_rows = chunk_rows;
+  PointCatalog catalog;
+  uint32_t n_chunk = 0;
+  while ((n_chunk = reader.ReadChunk(catalog, chunk_rows)) > 0) {
+    if (AddPoint(catalog) != n_chunk) io_success = false;
+    n_read += n_chunk;
+    if (verbose && (n_read >= check_rows)) {
+      std::cout << "\tRead " << n_read << " rows...\n";
+      check_rows *= 2;
+    }
+  }
+  if (reader.CurrentRow() != reader.NRows()) io_success = false;
+
+  if (verbose)
+    std::cout << "Stomp::TreeMap::Read - Read " << n_read <<
+      " rows; loaded " << NPoints() << " into tree...\n";
 
   return io_success;
 }
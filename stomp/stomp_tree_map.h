@@ -37,6 +37,8 @@ class AngularBin;           // class definition in stomp_angular_bin.h
 class AngularCorrelation;   // class definition in stomp_angular_correlation.h
 class RadialBin;           
 class Map;                  // class definition in stomp_map.h
+class PointCatalog;         // class definition in stomp_point_catalog.h
+class CatalogReader;        // class definition in stomp_catalog_reader.h
 class TreePixel;            // class definition in stomp_tree_pixel.h
 class TreeMap;
 
@@ -100,6 +102,25 @@ class TreeMap : public BaseMap {
   uint32_t FindPairs(AngularCoordinate& ang, double theta_max);
   void FindPairs(AngularVector& ang, AngularBin& theta);
   void FindPairs(AngularVector& ang, AngularCorrelation& wtheta);
+  void FindPairs(PointCatalog& catalog, AngularBin& theta);
+  void FindPairs(PointCatalog& catalog, AngularCorrelation& wtheta);
+
+#ifdef WITH_NUMPY
+  // The numpy versions take arrays of coordinates in the given system and
+  // return an array with the pair count (or weight) for each point in the
+  // annulus theta_min <= theta < theta_max (in degrees).  The points are
+  // split over n_threads threads with the GIL released.
+  PyObject* FindPairs(PyObject* x1obj, PyObject* x2obj,
+		      const std::string& system,
+		      double theta_min, double theta_max,
+		      uint32_t n_threads = DefaultThreads())
+    throw (const char* );
+  PyObject* FindWeightedPairs(PyObject* x1obj, PyObject* x2obj,
+			      const std::string& system,
+			      double theta_min, double theta_max,
+			      uint32_t n_threads = DefaultThreads())
+    throw (const char* );
+#endif
 
   double FindWeightedPairs(AngularCoordinate& ang, AngularBin& theta);
   double FindWeightedPairs(AngularCoordinate& ang,
@@ -120,6 +141,10 @@ class TreeMap : public BaseMap {
   void FindWeightedPairs(WAngularVector& w_ang,
 			 AngularCorrelation& wtheta);
 
+  // The PointCatalog versions use the catalog weights in the same way.
+  void FindWeightedPairs(PointCatalog& catalog, AngularBin& theta);
+  void FindWeightedPairs(PointCatalog& catalog, AngularCorrelation& wtheta);
+
   // And for the cases where we want to access the Field values in the tree.
   double FindWeightedPairs(AngularCoordinate& ang, AngularBin& theta,
 			   const std::string& field_name);
@@ -174,6 +199,9 @@ class TreeMap : public BaseMap {
   void FindWeightedPairsWithRegions(CosmoVector& c_ang, RadialBin& radius);
   void FindWeightedPairsWithRegions(WAngularVector& w_ang,
                                     AngularCorrelation& wtheta);
+  void FindWeightedPairsWithRegions(PointCatalog& catalog, AngularBin& theta);
+  void FindWeightedPairsWithRegions(PointCatalog& catalog,
+                                    AngularCorrelation& wtheta);
   void FindWeightedPairsWithRegions(AngularVector& ang, AngularBin& theta,
                                     const std::string& field_name);
   void FindWeightedPairsWithRegions(AngularVector& ang,
@@ -248,6 +276,24 @@ class TreeMap : public BaseMap {
   // point to the pixel.
   bool AddPoint(AngularCoordinate& ang, double object_weight = 1.0);
 
+#ifdef WITH_NUMPY
+  // The numpy version adds arrays of coordinates in the given system with an
+  // optional weight (either a scalar or one per point; unity by default) and
+  // returns an int8 array flagging the points that were added.  The points
+  // are grouped by their base node and the nodes are filled in parallel with
+  // the GIL released; each node still sees its points in input order, so the
+  // resulting tree is the same as adding the points one at a time.
+  PyObject* AddPoint(PyObject* x1obj, PyObject* x2obj,
+		     const std::string& system, PyObject* weightobj = NULL,
+		     uint32_t n_threads = DefaultThreads())
+    throw (const char* );
+#endif
+
+  // The PointCatalog version does the same for every point in the catalog,
+  // including any Field columns, and returns the number of points added.
+  uint32_t AddPoint(PointCatalog& catalog,
+		    uint32_t n_threads = DefaultThreads());
+
   // Rather than adding points one by one, we can also take an input file and
   // add those points to the tree.  We can do this with and without also adding
   // Field values to each point from the input file.  If the weight column is
@@ -263,6 +309,14 @@ class TreeMap : public BaseMap {
 	    bool verbose = false, uint8_t theta_column = 0,
 	    uint8_t phi_column = 1, int8_t weight_column = -1);
 
+  // For large catalogs, the binary readers in stomp_catalog_reader.h are much
+  // faster.  The reader needs to have its columns selected already; points
+  // are read in chunks of chunk_rows (CatalogReader::DefaultChunkRows if 0)
+  // from the reader's current row to the end of the file, so the catalog is
+  // never in memory all at once.
+  bool Read(CatalogReader& reader, bool verbose = false,
+	    uint32_t chunk_rows = 0);
+
   // Equivalent methods as their namesakes in the BaseMap class.
   virtual void Coverage(PixelVector& superpix,
 			uint32_t resolution = HPixResolution,
@@ -334,6 +388,12 @@ class TreeMap : public BaseMap {
   virtual void Clear();
 
  private:
+  // Add a set of new points, given the base level pixel index for each.
+  // The map takes ownership of the points that are added (flagged with 1 in
+  // added); the rest are deleted.
+  uint32_t _AddPoints(WAngularPtrVector& w_ang, std::vector<uint32_t>& pixnum,
+		      std::vector<uint8_t>& added, uint32_t n_threads);
+
   TreeDict tree_map_;
   FieldDict field_total_;
   uint16_t maximum_points_, nodes_;
@@ -19,6 +19,7 @@
 #include "stomp_angular_bin.h"
 #include "stomp_radial_bin.h"
 #include "stomp_angular_correlation.h"
+#include "stomp_instrumentation.h"
 
 namespace Stomp {
 
@@ -118,6 +119,7 @@ bool TreePixel::_InitializeSubPixels() {
 uint32_t TreePixel::DirectPairCount(AngularCoordinate& ang,
 				    AngularBin& theta,
 				    int16_t region) {
+  STOMP_COUNT_N(LeafPairsTested, ang_.size());
   uint32_t pair_count = 0;
   if (theta.ThetaMax() < 90.0) {
     for (WAngularPtrIterator iter=ang_.begin();iter!=ang_.end();++iter) {
@@ -135,6 +137,7 @@ uint32_t TreePixel::DirectPairCount(AngularCoordinate& ang,
 
 uint32_t TreePixel::FindPairs(AngularCoordinate& ang, AngularBin& theta,
 			      int16_t region) {
+  STOMP_COUNT(TreeNodesVisited);
   uint32_t pair_count = 0;
 
   // If we have AngularCoordinates in this pixel, then this is just a
@@ -184,6 +187,7 @@ uint32_t TreePixel::FindPairs(AngularCoordinate& ang, double theta_max) {
 
 double TreePixel::DirectWeightedPairs(AngularCoordinate& ang, AngularBin& theta,
 				      int16_t region) {
+  STOMP_COUNT_N(LeafPairsTested, ang_.size());
   double total_weight = 0.0;
   uint32_t n_pairs = 0;
 
@@ -211,6 +215,7 @@ double TreePixel::DirectWeightedPairs(AngularCoordinate& ang, AngularBin& theta,
 
 double TreePixel::FindWeightedPairs(AngularCoordinate& ang, AngularBin& theta,
 				    int16_t region) {
+  STOMP_COUNT(TreeNodesVisited);
   double total_weight = 0.0;
   // If we have AngularCoordinates in this pixel, then this is just a
   // matter of iterating through them and finding how many satisfy the
@@ -259,6 +264,7 @@ double TreePixel::FindWeightedPairs(AngularCoordinate& ang, double theta_max) {
 
 double TreePixel::DirectWeightedPairs(WeightedAngularCoordinate& w_ang,
 				      AngularBin& theta, int16_t region) {
+  STOMP_COUNT_N(LeafPairsTested, ang_.size());
   double total_weight = 0.0;
   uint32_t n_pairs = 0;
 
@@ -288,6 +294,7 @@ double TreePixel::DirectWeightedPairs(WeightedAngularCoordinate& w_ang,
 
 double TreePixel::FindWeightedPairs(WeightedAngularCoordinate& w_ang,
 				    AngularBin& theta, int16_t region) {
+  STOMP_COUNT(TreeNodesVisited);
   double total_weight = 0.0;
   // If we have AngularCoordinates in this pixel, then this is just a
   // matter of iterating through them and finding how many satisfy the
@@ -400,6 +407,7 @@ void TreePixel::FindWeightedPairs(WAngularVector& w_ang,
 double TreePixel::DirectWeightedPairs(AngularCoordinate& ang, AngularBin& theta,
 				      const std::string& field_name,
 				      int16_t region) {
+  STOMP_COUNT_N(LeafPairsTested, ang_.size());
   double total_weight = 0.0;
   uint32_t n_pairs = 0;
 
@@ -428,6 +436,7 @@ double TreePixel::DirectWeightedPairs(AngularCoordinate& ang, AngularBin& theta,
 double TreePixel::FindWeightedPairs(AngularCoordinate& ang, AngularBin& theta,
 				    const std::string& field_name,
 				    int16_t region) {
+  STOMP_COUNT(TreeNodesVisited);
   double total_weight = 0.0;
   // If we have AngularCoordinates in this pixel, then this is just a
   // matter of iterating through them and finding how many satisfy the
@@ -504,6 +513,7 @@ double TreePixel::DirectWeightedPairs(WeightedAngularCoordinate& w_ang,
 				      AngularBin& theta,
 				      const std::string& field_name,
 				      int16_t region) {
+  STOMP_COUNT_N(LeafPairsTested, ang_.size());
   double total_weight = 0.0;
   uint32_t n_pairs = 0;
 
@@ -535,6 +545,7 @@ double TreePixel::FindWeightedPairs(WeightedAngularCoordinate& w_ang,
 				    AngularBin& theta,
 				    const std::string& field_name,
 				    int16_t region) {
+  STOMP_COUNT(TreeNodesVisited);
   double total_weight = 0.0;
   // If we have AngularCoordinates in this pixel, then this is just a
   // matter of iterating through them and finding how many satisfy the
@@ -616,6 +627,7 @@ double TreePixel::DirectWeightedPairs(WeightedAngularCoordinate& w_ang,
 				      AngularBin& theta,
 				      const std::string& field_name,
 				      int16_t region) {
+  STOMP_COUNT_N(LeafPairsTested, ang_.size());
   double total_weight = 0.0;
   uint32_t n_pairs = 0;
 
@@ -648,6 +660,7 @@ double TreePixel::FindWeightedPairs(WeightedAngularCoordinate& w_ang,
 				    AngularBin& theta,
 				    const std::string& field_name,
 				    int16_t region) {
+  STOMP_COUNT(TreeNodesVisited);
   double total_weight = 0.0;
   // If we have AngularCoordinates in this pixel, then this is just a
   // matter of iterating through them and finding how many satisfy the
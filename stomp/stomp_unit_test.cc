@@ -19,7 +19,12 @@ int main(int argc, char **argv) {
   void ScalarMapUnitTests(bool run_all_tests);
   void TreeMapUnitTests(bool run_all_tests);
   void IndexedTreeMapUnitTests(bool run_all_tests);
+  void PointCatalogUnitTests(bool run_all_tests);
+  void CatalogReaderUnitTests(bool run_all_tests);
   void GeometryUnitTests(bool run_all_tests);
+  void BoundIndexUnitTests(bool run_all_tests);
+  void MultiScalarMapUnitTests(bool run_all_tests);
+  void InstrumentationUnitTests(bool run_all_tests);
   void UtilUnitTests(bool run_all_tests);
 
   std::string usage = "Usage: ";
@@ -63,9 +68,24 @@ int main(int argc, char **argv) {
   // The IndexedTreeMap class
   IndexedTreeMapUnitTests(FLAGS_all_tests);
 
+  // The PointCatalog class
+  PointCatalogUnitTests(FLAGS_all_tests);
+
+  // The CatalogReader classes
+  CatalogReaderUnitTests(FLAGS_all_tests);
+
   // The GeometricBound class and derivatives
   GeometryUnitTests(FLAGS_all_tests);
 
+  // The BoundIndex class
+  BoundIndexUnitTests(FLAGS_all_tests);
+
+  // The MultiScalarMap class
+  MultiScalarMapUnitTests(FLAGS_all_tests);
+
+  // The Instrumentation class
+  InstrumentationUnitTests(FLAGS_all_tests);
+
   // The utility classes
   UtilUnitTests(FLAGS_all_tests);
 
@@ -1,9 +1,17 @@
 #include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <iostream>
+#include <algorithm>
 #include <string>
 #include <vector>
 #include "stomp_core.h"
 #include "stomp_util.h"
+#include "stomp_instrumentation.h"
 
 namespace Stomp {
 
@@ -387,6 +395,228 @@ double Histogram::MeanWeightedBinValue() {
   return weighted_bin_value/total_weight;
 }
 
+// Powers of ten that are exactly representable as doubles.
+static const double ExactPowersOfTen[] = {
+  1.0e0, 1.0e1, 1.0e2, 1.0e3, 1.0e4, 1.0e5, 1.0e6, 1.0e7, 1.0e8, 1.0e9,
+  1.0e10, 1.0e11, 1.0e12, 1.0e13, 1.0e14, 1.0e15, 1.0e16, 1.0e17, 1.0e18,
+  1.0e19, 1.0e20, 1.0e21, 1.0e22
+};
+
+// Don't bother splitting files smaller than this across threads.
+static const uint64_t AsciiChunkBytes = 1048576;
+
+static inline bool IsAsciiSpace(char c) {
+  return (c == ' ') || (c == '\t') || (c == '\r') || (c == '\v') ||
+    (c == '\f');
+}
+
+AsciiTable::AsciiTable() {
+  max_column_ = 0;
+}
+
+AsciiTable::~AsciiTable() {
+  Clear();
+}
+
+bool AsciiTable::Read(const std::string& input_file,
+		      std::vector<uint8_t>& columns, uint32_t n_threads) {
+  Clear();
+  columns_ = columns;
+  max_column_ = 0;
+  for (uint32_t k=0;k<columns_.size();k++)
+    if (columns_[k] > max_column_) max_column_ = columns_[k];
+
+  int fd = open(input_file.c_str(), O_RDONLY);
+  if (fd == -1) return false;
+
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) == -1) {
+    close(fd);
+    return false;
+  }
+  uint64_t file_size = file_stat.st_size;
+  if (file_size == 0) {
+    close(fd);
+    return true;
+  }
+
+  void* mapping = mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) return false;
+  madvise(mapping, file_size, MADV_SEQUENTIAL);
+  STOMP_COUNT_N(BytesRead, file_size);
+  const char* data = static_cast<const char*>(mapping);
+
+  // Split the file into chunks, moving each boundary forward to the start of
+  // the next line.
+  uint32_t n_chunk = file_size/AsciiChunkBytes + 1;
+  if (n_chunk > 8*n_threads) n_chunk = 8*n_threads;
+  if (n_chunk == 0) n_chunk = 1;
+  std::vector<uint64_t> chunk_start(n_chunk + 1, file_size);
+  chunk_start[0] = 0;
+  for (uint32_t k=1;k<n_chunk;k++) {
+    uint64_t start = k*(file_size/n_chunk);
+    if (start < chunk_start[k-1]) start = chunk_start[k-1];
+    const char* newline = static_cast<const char*>(
+      memchr(data + start, '\n', file_size - start));
+    chunk_start[k] = (newline == NULL ? file_size : newline - data + 1);
+  }
+
+  // Column c of a line goes to slot column_slot[c] of the row, if it was
+  // requested.
+  int16_t column_slot[256];
+  for (uint32_t c=0;c<256;c++) column_slot[c] = -1;
+  for (uint32_t k=0;k<columns_.size();k++) column_slot[columns_[k]] = k;
+  uint32_t n_columns = columns_.size();
+  uint32_t n_needed = static_cast<uint32_t>(max_column_) + 1;
+
+  std::vector<std::vector<double> > chunk_values(n_chunk);
+  std::vector<std::vector<uint16_t> > chunk_tokens(n_chunk);
+  ParallelFor(n_chunk, n_threads, [&](uint32_t k) {
+      const char* ptr = data + chunk_start[k];
+      const char* chunk_end = data + chunk_start[k+1];
+      std::vector<double>& values = chunk_values[k];
+      std::vector<uint16_t>& n_tokens = chunk_tokens[k];
+      while (ptr < chunk_end) {
+	const char* line_end = static_cast<const char*>(
+	  memchr(ptr, '\n', chunk_end - ptr));
+	if (line_end == NULL) line_end = chunk_end;
+
+	uint32_t row_offset = values.size();
+	values.resize(row_offset + n_columns, 0.0);
+	uint32_t n_token = 0;
+	while ((ptr < line_end) && (n_token < n_needed)) {
+	  while ((ptr < line_end) && IsAsciiSpace(*ptr)) ptr++;
+	  if (ptr == line_end) break;
+	  const char* token_start = ptr;
+	  while ((ptr < line_end) && !IsAsciiSpace(*ptr)) ptr++;
+	  if (column_slot[n_token] != -1)
+	    values[row_offset + column_slot[n_token]] =
+	      ParseDouble(token_start, ptr);
+	  n_token++;
+	}
+	n_tokens.push_back(n_token);
+	ptr = line_end + 1;
+      }
+    });
+
+  munmap(mapping, file_size);
+
+  // Now stitch the chunks back together in order.
+  std::vector<uint64_t> row_start(n_chunk + 1, 0);
+  for (uint32_t k=0;k<n_chunk;k++)
+    row_start[k+1] = row_start[k] + chunk_tokens[k].size();
+  values_.resize(row_start[n_chunk]*n_columns);
+  n_tokens_.resize(row_start[n_chunk]);
+  ParallelFor(n_chunk, n_threads, [&](uint32_t k) {
+      if (!chunk_tokens[k].empty()) {
+	std::copy(chunk_values[k].begin(), chunk_values[k].end(),
+		  values_.begin() + row_start[k]*n_columns);
+	std::copy(chunk_tokens[k].begin(), chunk_tokens[k].end(),
+		  n_tokens_.begin() + row_start[k]);
+      }
+      std::vector<double>().swap(chunk_values[k]);
+      std::vector<uint16_t>().swap(chunk_tokens[k]);
+    });
+
+  return true;
+}
+
+uint32_t AsciiTable::NRows() {
+  return n_tokens_.size();
+}
+
+uint8_t AsciiTable::NColumns() {
+  return columns_.size();
+}
+
+void AsciiTable::Clear() {
+  columns_.clear();
+  values_.clear();
+  n_tokens_.clear();
+  max_column_ = 0;
+}
+
+double AsciiTable::ParseDouble(const char* begin, const char* end) {
+  const char* ptr = begin;
+  bool negative = false;
+  if ((ptr < end) && ((*ptr == '-') || (*ptr == '+'))) {
+    negative = (*ptr == '-');
+    ptr++;
+  }
+
+  // Accumulate up to 19 significant digits in an integer, tracking the
+  // decimal exponent separately.
+  uint64_t mantissa = 0;
+  int32_t exponent = 0;
+  uint32_t n_digits = 0;
+  bool found_digits = false;
+  bool truncated = false;
+  while ((ptr < end) && (*ptr >= '0') && (*ptr <= '9')) {
+    found_digits = true;
+    if (n_digits < 19) {
+      mantissa = 10*mantissa + (*ptr - '0');
+      if (mantissa > 0) n_digits++;
+    } else {
+      exponent++;
+      if (*ptr != '0') truncated = true;
+    }
+    ptr++;
+  }
+  if ((ptr < end) && (*ptr == '.')) {
+    ptr++;
+    while ((ptr < end) && (*ptr >= '0') && (*ptr <= '9')) {
+      found_digits = true;
+      if (n_digits < 19) {
+	mantissa = 10*mantissa + (*ptr - '0');
+	if (mantissa > 0) n_digits++;
+	exponent--;
+      } else if (*ptr != '0') {
+	truncated = true;
+      }
+      ptr++;
+    }
+  }
+  if (found_digits && (ptr < end) && ((*ptr == 'e') || (*ptr == 'E'))) {
+    const char* exponent_start = ptr;
+    ptr++;
+    bool negative_exponent = false;
+    if ((ptr < end) && ((*ptr == '-') || (*ptr == '+'))) {
+      negative_exponent = (*ptr == '-');
+      ptr++;
+    }
+    int32_t exponent_value = 0;
+    bool found_exponent = false;
+    while ((ptr < end) && (*ptr >= '0') && (*ptr <= '9')) {
+      found_exponent = true;
+      if (exponent_value < 100000) exponent_value = 10*exponent_value +
+				     (*ptr - '0');
+      ptr++;
+    }
+    if (!found_exponent) ptr = exponent_start;
+    exponent += (negative_exponent ? -exponent_value : exponent_value);
+  }
+
+  // With an exact mantissa and power of ten, a single multiplication or
+  // division is correctly rounded.
+  if (found_digits && (ptr == end) && !truncated) {
+    if (mantissa == 0) return (negative ? -0.0 : 0.0);
+    if ((mantissa < (static_cast<uint64_t>(1) << 53)) &&
+	(exponent >= -22) && (exponent <= 22)) {
+      double value = static_cast<double>(mantissa);
+      if (exponent < 0) {
+	value /= ExactPowersOfTen[-exponent];
+      } else {
+	value *= ExactPowersOfTen[exponent];
+      }
+      return (negative ? -value : value);
+    }
+  }
+
+  std::string token(begin, end);
+  return strtod(token.c_str(), NULL);
+}
+
 void Tokenize(const std::string& str, std::vector<std::string>& tokens,
 	 const std::string& delimiters) {
   // Skip delimiters at beginning.
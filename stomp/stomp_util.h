@@ -14,8 +14,11 @@
 #ifndef STOMP_UTIL_H
 #define STOMP_UTIL_H
 
+#include <stdint.h>
 #include <sys/time.h>
 #include <string>
+#include <vector>
+#include "stomp_core.h"
 
 namespace Stomp {
 
@@ -23,6 +26,7 @@ class Cosmology;
 class StompWatch;
 class HistogramBin;
 class Histogram;
+class AsciiTable;
 
 typedef std::vector<HistogramBin> BinVector;
 typedef BinVector::iterator BinIterator;
@@ -188,6 +192,60 @@ private:
 };
 
 
+class AsciiTable {
+  // All of the ASCII readers in the library (Map::Read, ScalarMap::Read,
+  // WeightedAngularCoordinate::ToWAngularVector, TreeMap::Read, etc.) expect
+  // whitespace-delimited numeric columns, one object per line.  Rather than
+  // pulling each line through an ifstream, AsciiTable maps the whole file into
+  // memory, splits it into chunks at line boundaries and parses the chunks in
+  // parallel, converting the requested columns with a locale-independent
+  // number parser.  The results are stored in file order.
+  //
+  // Every line in the file is a row, including blank ones, so that row
+  // numbers match line numbers.  If a line has too few entries to reach one
+  // of the requested columns, HasValue returns false for that column and
+  // Value returns 0.
+
+ public:
+  AsciiTable();
+  ~AsciiTable();
+
+  // Read the input file, keeping the values in the requested columns
+  // (counting from 0).  Returns false if the file can't be opened.
+  bool Read(const std::string& input_file, std::vector<uint8_t>& columns,
+	    uint32_t n_threads = DefaultThreads());
+
+  uint32_t NRows();
+  uint8_t NColumns();
+
+  // The value in the k-th requested column (not the k-th column of the file)
+  // for the given row.
+  double Value(uint32_t row, uint8_t k) {
+    return values_[row*columns_.size() + k];
+  };
+  bool HasValue(uint32_t row, uint8_t k) {
+    return n_tokens_[row] > columns_[k];
+  };
+
+  // Does the row have entries for all of the requested columns?
+  bool Complete(uint32_t row) {
+    return n_tokens_[row] > max_column_;
+  };
+
+  void Clear();
+
+  // The number parser used by Read.  It handles the usual decimal and
+  // exponential notations exactly and falls back to strtod for anything
+  // else (more than 19 significant digits, nan, inf, etc.).
+  static double ParseDouble(const char* begin, const char* end);
+
+ private:
+  std::vector<uint8_t> columns_;
+  std::vector<double> values_;
+  std::vector<uint16_t> n_tokens_;
+  uint8_t max_column_;
+};
+
 // A simple utility function for breaking up a string into its component items,
 // generally when the string is a list of filenames or such (separated by the
 // input delimiter).
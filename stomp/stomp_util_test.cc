@@ -1,9 +1,17 @@
 #include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <iostream>
+#include <fstream>
 #include <math.h>
 #include <string>
+#include <vector>
 #include <gflags/gflags.h>
 #include "stomp_util.h"
+#include "stomp_angular_coordinate.h"
+#include "stomp_pixel.h"
+#include "stomp_map.h"
+#include "stomp_tree_map.h"
 
 void CosmologyTests() {
   // Check to make sure that our Cosmology static class works properly.
@@ -38,15 +46,122 @@ void CosmologyTests() {
   }
 }
 
+void AsciiTableTests() {
+  // Check the parallel ASCII parser against strtod and round-trip a Map and a
+  // catalog through the text readers that use it.
+  std::cout << "\n";
+  std::cout << "************************\n";
+  std::cout << "*** AsciiTable Tests ***\n";
+  std::cout << "************************\n";
+  const char* test_values[] = {"0", "-0.0", "1", "3.14159265358979", "1e10",
+			       "-2.5E-3", "123456789012345678901234",
+			       "0.1", "1.7976931348623157e308", "4.9e-324",
+			       "+42.", ".5", "1e400", "nan", "inf", "0x1p3"};
+  uint32_t n_mismatch = 0;
+  for (uint32_t i=0;i<sizeof(test_values)/sizeof(test_values[0]);i++) {
+    std::string value = test_values[i];
+    double parsed = Stomp::AsciiTable::ParseDouble(value.data(),
+						   value.data() + value.size());
+    double expected = strtod(value.c_str(), NULL);
+    if ((parsed != expected) && !(isnan(parsed) && isnan(expected))) {
+      std::cout << "\t\tFAILED: " << value << " -> " << parsed << "\n";
+      n_mismatch++;
+    }
+  }
+  srand48(1);
+  for (uint32_t i=0;i<100000;i++) {
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), "%.*g", static_cast<int>(i % 17) + 1,
+	     (drand48() - 0.5)*pow(10.0, static_cast<int>(i % 41) - 20));
+    std::string value = buffer;
+    if (Stomp::AsciiTable::ParseDouble(value.data(),
+				       value.data() + value.size()) !=
+	strtod(buffer, NULL)) n_mismatch++;
+  }
+  std::cout << "\tParseDouble: " << n_mismatch << " mismatches with strtod\n";
+
+  // A small table with a comment line, a blank line and a short row.
+  std::string file_name = "/tmp/stomp_ascii_table_test.dat";
+  std::ofstream output_file(file_name.c_str());
+  output_file << "# comment\n1 2 3\n\n4\t5  6 7\n8 9\n";
+  output_file.close();
+  Stomp::AsciiTable table;
+  std::vector<uint8_t> columns;
+  columns.push_back(2);
+  columns.push_back(0);
+  table.Read(file_name, columns, 2);
+  std::cout << "\tTable: " << table.NRows() << " rows (expected 5)\n";
+  for (uint32_t i=0;i<table.NRows();i++) {
+    std::cout << "\t\tRow " << i << ": ";
+    if (table.Complete(i)) {
+      std::cout << table.Value(i, 0) << " " << table.Value(i, 1) << "\n";
+    } else {
+      std::cout << "incomplete\n";
+    }
+  }
+
+  // Round-trip a Map.
+  Stomp::AngularCoordinate ang(60.0, 0.0, Stomp::AngularCoordinate::Survey);
+  Stomp::Pixel tmp_pix(ang, 256);
+  Stomp::PixelVector annulus_pix;
+  tmp_pix.WithinRadius(3.0, annulus_pix);
+  Stomp::Map* stomp_map = new Stomp::Map(annulus_pix);
+  file_name = "/tmp/stomp_ascii_map_test.map";
+  stomp_map->Write(file_name);
+  Stomp::Map* read_map = new Stomp::Map(file_name);
+  std::cout << "\tMap: " << read_map->Area() << " (" << stomp_map->Area() <<
+    ") sq. degrees, " << read_map->Size() << " (" << stomp_map->Size() <<
+    ") pixels\n";
+  remove(file_name.c_str());
+
+  // And a weighted catalog, through both the vector and TreeMap readers.
+  uint32_t n_random = 20000;
+  Stomp::AngularVector rand_ang;
+  stomp_map->GenerateRandomPoints(rand_ang, n_random);
+  file_name = "/tmp/stomp_ascii_catalog_test.dat";
+  output_file.open(file_name.c_str());
+  output_file.precision(17);
+  for (uint32_t i=0;i<rand_ang.size();i++)
+    output_file << rand_ang[i].Lambda() << " " << rand_ang[i].Eta() <<
+      " " << 1.0 + 0.25*(i % 4) << "\n";
+  output_file.close();
+
+  Stomp::WAngularVector w_ang;
+  Stomp::WeightedAngularCoordinate::ToWAngularVector(
+    file_name, w_ang, Stomp::AngularCoordinate::Survey, false, 0, 1, 2);
+  n_mismatch = 0;
+  for (uint32_t i=0;i<rand_ang.size() && i<w_ang.size();i++)
+    if ((fabs(w_ang[i].Lambda() - rand_ang[i].Lambda()) > 1.0e-10) ||
+	(fabs(w_ang[i].Eta() - rand_ang[i].Eta()) > 1.0e-10) ||
+	(w_ang[i].Weight() != 1.0 + 0.25*(i % 4))) n_mismatch++;
+  std::cout << "\tToWAngularVector: " << w_ang.size() << "/" << n_random <<
+    " points, " << n_mismatch << " mismatched\n";
+
+  Stomp::TreeMap* tree_map = new Stomp::TreeMap(128, 50);
+  tree_map->Read(file_name, Stomp::AngularCoordinate::Survey, false, 0, 1, 2);
+  std::cout << "\tTreeMap::Read: " << tree_map->NPoints() << "/" << n_random <<
+    " points, weight " << tree_map->Weight() << "\n";
+  remove(file_name.c_str());
+
+  delete tree_map;
+  delete read_map;
+  delete stomp_map;
+}
+
 // Define our command line flags
 DEFINE_bool(all_util_tests, false, "Run all class unit tests.");
 DEFINE_bool(util_cosmology_tests, false, "Run cosmology tests");
+DEFINE_bool(util_ascii_table_tests, false, "Run AsciiTable tests");
 
 void UtilUnitTests(bool run_all_tests) {
   void StompCosmologyTests();
+  void AsciiTableTests();
 
   if (run_all_tests) FLAGS_all_util_tests = true;
 
   // Now, we check our static Cosmology class to make sure it's functioning.
   if (FLAGS_all_util_tests || FLAGS_util_cosmology_tests) CosmologyTests();
+
+  // Check the parallel ASCII parser behind the text file readers.
+  if (FLAGS_all_util_tests || FLAGS_util_ascii_table_tests) AsciiTableTests();
 }
@@ -1,10 +1,13 @@
 #include <QtGui>
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
 #include "reader_thread.h"
 
 ReadMapThread::ReadMapThread(QObject *parent) : QThread(parent) {
+  read_id_ = 0;
   restart = false;
   abort = false;
-  good_base_map_ = false;
 }
 
 ReadMapThread::~ReadMapThread() {
@@ -16,10 +19,11 @@ ReadMapThread::~ReadMapThread() {
   wait();
 }
 
-void ReadMapThread::readMap(const std::string& map_file_name) {
+int ReadMapThread::readMap(const std::string& map_file_name) {
   QMutexLocker locker(&mutex);
 
   map_file_name_ = map_file_name;
+  read_id_++;
 
   if (!isRunning()) {
     start(LowPriority);
@@ -27,31 +31,50 @@ void ReadMapThread::readMap(const std::string& map_file_name) {
     restart = true;
     condition.wakeOne();
   }
+
+  return read_id_;
+}
+
+int ReadMapThread::cancel() {
+  QMutexLocker locker(&mutex);
+
+  map_file_name_.clear();
+  read_id_++;
+
+  if (isRunning()) {
+    restart = true;
+    condition.wakeOne();
+  }
+
+  return read_id_;
+}
+
+QReadWriteLock* ReadMapThread::mapLock() {
+  return &map_lock_;
 }
 
 void ReadMapThread::run() {
   forever {
     mutex.lock();
     std::string map_file_name = map_file_name_;
+    int read_id = read_id_;
     mutex.unlock();
 
-    if (restart) break;
-    if (abort) return;
-    std::cout << "Reading from " << map_file_name << "...\n";
-    Stomp::Map* base_map = new Stomp::Map(map_file_name);
-    std::cout << "Done.\n";
-    if (restart) break;
     if (abort) return;
+    if (!map_file_name.empty()) {
+      std::cout << "Reading from " << map_file_name << "...\n";
+      Stomp::Map* base_map = new Stomp::Map();
+      emit newBaseMap(read_id, base_map);
 
-    bool good_base_map = !base_map->Empty();
-
-    if (good_base_map) {
-      mutex.lock();
-      base_map_ = base_map;
-      good_base_map_ = good_base_map_;
-      mutex.unlock();
-      emit newBaseMap(base_map);
+      // If we were asked for a different file part way through, _readMap
+      // bails out and we go straight on to the new one.  The receiver
+      // already owns the Map, so it's up to it to clean up after us.
+      if (_readMap(map_file_name, read_id, base_map)) {
+	std::cout << "Done.\n";
+	emit baseMapUpdated(read_id, true);
+      }
     }
+    if (abort) return;
 
     mutex.lock();
     if (!restart) condition.wait(&mutex);
@@ -60,3 +83,107 @@ void ReadMapThread::run() {
   }
 }
 
+bool ReadMapThread::_readMap(const std::string& map_file_name, int read_id,
+			     Stomp::Map* base_map) {
+  std::ifstream map_file(map_file_name.c_str());
+  if (!map_file) {
+    std::cout << map_file_name << " does not exist!.  No Map ingested\n";
+    return false;
+  }
+
+  map_file.seekg(0, std::ios::end);
+  qint64 total_bytes = static_cast<qint64>(map_file.tellg());
+  map_file.seekg(0, std::ios::beg);
+
+  // Same format as the Stomp::Map constructor expects: HPIXNUM SUPERPIXNUM
+  // RESOLUTION WEIGHT.  Map::Write puts the pixels out in superpixel order,
+  // so we only add to the Map at the start of a new superpixel to keep from
+  // showing a superpixel that's half read in.  Doing that on the doubling
+  // schedule keeps the total work linear in the size of the file.
+  Stomp::PixelVector pending_pix;
+  std::string line;
+  qint64 bytes_read = 0;
+  qint64 next_progress = ProgressBytes;
+  qint64 next_snapshot = total_bytes/SnapshotDivisions;
+  uint32_t last_superpixnum = Stomp::MaxSuperpixnum;
+  while (std::getline(map_file, line)) {
+    bytes_read += line.size() + 1;
+
+    if (bytes_read >= next_progress) {
+      if (_stale(read_id)) return false;
+      emit readProgress(read_id, bytes_read, total_bytes);
+      next_progress = bytes_read + ProgressBytes;
+    }
+
+    const char* cursor = line.c_str();
+    while (isspace(*cursor)) cursor++;
+    if ((*cursor == '\0') || (*cursor == '#')) continue;
+
+    // Resolution has to be handled as a signed value because of old map
+    // formats.
+    char* next;
+    unsigned long hpixnum = strtoul(cursor, &next, 10);
+    if (next == cursor) continue;
+    cursor = next;
+    unsigned long superpixnum = strtoul(cursor, &next, 10);
+    if (next == cursor) continue;
+    cursor = next;
+    long resolution = strtol(cursor, &next, 10);
+    if (next == cursor) continue;
+    cursor = next;
+    double weight = strtod(cursor, &next);
+    if (next == cursor) continue;
+    if ((resolution % 2 != 0) || (resolution <= 0) ||
+	(superpixnum >= Stomp::MaxSuperpixnum)) continue;
+
+    if (superpixnum != last_superpixnum) {
+      if (!pending_pix.empty() && (bytes_read >= next_snapshot)) {
+	// If the render thread is busy with the Map, we keep reading and
+	// try again at the next superpixel rather than waiting on it.
+	if (!_ingest(read_id, base_map, pending_pix, false)) return false;
+	if (pending_pix.empty()) {
+	  emit baseMapUpdated(read_id, false);
+	  next_snapshot = 2*bytes_read;
+	}
+      }
+      last_superpixnum = superpixnum;
+    }
+
+    uint32_t x, y;
+    Stomp::Pixel::HPix2XY(static_cast<uint32_t>(resolution),
+			  static_cast<uint32_t>(hpixnum),
+			  static_cast<uint32_t>(superpixnum), x, y);
+    pending_pix.push_back(Stomp::Pixel(x, y,
+				       static_cast<uint32_t>(resolution),
+				       weight));
+  }
+  map_file.close();
+
+  if (!_ingest(read_id, base_map, pending_pix, true)) return false;
+  emit readProgress(read_id, total_bytes, total_bytes);
+
+  return true;
+}
+
+bool ReadMapThread::_ingest(int read_id, Stomp::Map* base_map,
+			    Stomp::PixelVector& pending_pix, bool block) {
+  if (block) {
+    map_lock_.lockForWrite();
+  } else if (!map_lock_.tryLockForWrite()) {
+    return !_stale(read_id);
+  }
+
+  // The receiver only deletes the Map while holding the write lock and
+  // after it's moved on to a new read id, so checking the id under the lock
+  // tells us whether the Map is still there.
+  bool stale = _stale(read_id);
+  if (!stale && !pending_pix.empty()) base_map->IngestMap(pending_pix);
+  map_lock_.unlock();
+
+  return !stale;
+}
+
+bool ReadMapThread::_stale(int read_id) {
+  QMutexLocker locker(&mutex);
+  return abort || (read_id != read_id_);
+}
@@ -9,12 +9,16 @@
 // possible.
 //
 // This header file contains the thread class for reading a Stomp::Map file and
-// generating softened versions of it for rendering.
+// generating softened versions of it for rendering.  Large Map files can take
+// a long time to read, so the thread streams the file into the Map a batch
+// at a time and lets the RenderArea show what's there as it goes rather than
+// making it wait for the whole thing.
 
 #ifndef READER_THREAD_H
 #define READER_THREAD_H
 
 #include <QMutex>
+#include <QReadWriteLock>
 #include <QThread>
 #include <QWaitCondition>
 #include <stomp.h>
@@ -28,23 +32,63 @@ class ReadMapThread : public QThread {
   ReadMapThread(QObject *parent = 0);
   ~ReadMapThread();
 
-  void readMap(const std::string& map_file_name);
+  // Start reading a new Map file.  If a file is already being read, that
+  // read is abandoned in favor of the new one.  The return value is the id
+  // for the new read, which is passed along with every signal from it so
+  // that the receiver can drop anything still queued up from an earlier
+  // read.
+  int readMap(const std::string& map_file_name);
+
+  // Abandon the current read without starting a new one.  Like readMap,
+  // this returns a new id, which no signals will ever carry.
+  int cancel();
+
+  // Each read streams the file into a single Map, which is handed to the
+  // receiver through newBaseMap before anything is put in it.  The receiver
+  // takes ownership of that Map, but it's only safe to look at (or delete)
+  // it while holding mapLock; we hold the write lock whenever we add to it.
+  QReadWriteLock* mapLock();
+
+  // The file is read in batches of whole superpixels.  readProgress is
+  // emitted every ProgressBytes bytes so that the caller can show how far
+  // along we are.  Each time the number of bytes read doubles (starting
+  // from 1/SnapshotDivisions of the file), baseMapUpdated is emitted to say
+  // that there's more of the Map to show; once the whole file is in, it's
+  // emitted one last time with finished set.  The doubling keeps the number
+  // of re-renders down to the log of the file size.
+  enum {
+    ProgressBytes = 1048576,
+    SnapshotDivisions = 64
+  };
 
  signals:
-  void newBaseMap(Stomp::Map* base_map);
+  void readProgress(int read_id, qint64 bytes_read, qint64 total_bytes);
+  void newBaseMap(int read_id, Stomp::Map* base_map);
+  void baseMapUpdated(int read_id, bool finished);
 
  protected:
   void run();
 
  private:
+  // Stream the file into base_map, returning false if the file couldn't
+  // be read or the read was superseded or aborted.
+  bool _readMap(const std::string& map_file_name, int read_id,
+		Stomp::Map* base_map);
+
+  // Add the pending pixels to the Map.  Unless block is set, this gives up
+  // (leaving the pixels pending) if the render thread is using the Map.
+  // Either way, the return value is false if the read is stale.
+  bool _ingest(int read_id, Stomp::Map* base_map,
+	       Stomp::PixelVector& pending_pix, bool block);
+  bool _stale(int read_id);
+
   QMutex mutex;
   QWaitCondition condition;
+  QReadWriteLock map_lock_;
   std::string map_file_name_;
-  Stomp::Map* base_map_;
-  bool good_base_map_;
+  int read_id_;
   bool restart;
   bool abort;
 };
 
 #endif
-
@@ -21,7 +21,10 @@ RenderArea::RenderArea(QWidget *parent) : QWidget(parent) {
       for (uint8_t level=Stomp::HPixLevel;level<=Stomp::MaxPixelLevel;level++)
       stomp_map_[level] = base_map;
   */
+  base_map_ = 0;
+  read_id_ = 0;
   good_map_ = false;
+  map_bounds_set_ = false;
   good_points_ = false;
 
   fill_ = false;
@@ -53,8 +56,14 @@ RenderArea::RenderArea(QWidget *parent) : QWidget(parent) {
   connect(&render_points_thread_, SIGNAL(renderProgress(int)),
           this, SLOT(renderProgress(int)));
 
-  connect(&read_map_thread_, SIGNAL(newBaseMap(Stomp::Map*)),
-	  this, SLOT(newBaseMap(Stomp::Map*)));
+  qRegisterMetaType<Stomp::Map*>("Stomp::Map*");
+  render_map_thread_.setMapLock(read_map_thread_.mapLock());
+  connect(&read_map_thread_, SIGNAL(newBaseMap(int, Stomp::Map*)),
+	  this, SLOT(newBaseMap(int, Stomp::Map*)));
+  connect(&read_map_thread_, SIGNAL(baseMapUpdated(int, bool)),
+	  this, SLOT(baseMapUpdated(int, bool)));
+  connect(&read_map_thread_, SIGNAL(readProgress(int, qint64, qint64)),
+	  this, SLOT(readProgress(int, qint64, qint64)));
 
   show_grid_ = false;
   show_coordinates_ = false;
@@ -63,6 +72,8 @@ RenderArea::RenderArea(QWidget *parent) : QWidget(parent) {
 
   show_points_ = false;
   filter_points_ = false;
+  bin_points_ = false;
+  sum_point_weights_ = false;
   points_pixmap_ = QPixmap(width(), height());
   points_pixmap_.fill(Qt::transparent);
 
@@ -155,6 +166,14 @@ bool RenderArea::filteringPoints() {
   return filter_points_;
 }
 
+bool RenderArea::binningPoints() {
+  return bin_points_;
+}
+
+bool RenderArea::summingPointWeights() {
+  return sum_point_weights_;
+}
+
 double RenderArea::mouseLongitude() {
   return mouse_lon_;
 }
@@ -186,7 +205,8 @@ void RenderArea::newMapImage(const QImage& map_image) {
 void RenderArea::updatePoints(bool send_update_call) {
   if (good_points_) {
     render_points_thread_.renderPoints(&ang_, geom_, points_palette_,
-				       antialiased_);
+				       antialiased_, bin_points_,
+				       sum_point_weights_);
   } else {
     points_pixmap_ = QPixmap(width(), height());
     points_pixmap_.fill(Qt::transparent);
@@ -216,36 +236,68 @@ bool RenderArea::readNewMap(QString& input_file) {
   bool file_exists = false;
   std::ifstream test_file(stl_input_file.c_str());
 
-  if (good_map_) {
-    base_map_->Clear();
-    delete base_map_;
-  }
-
-  good_map_ = false;
-
+  // The last read has to be superseded before its Map goes away, since the
+  // reader only stops adding to the Map once it sees a newer read id.
   if (test_file) {
     file_exists = true;
     test_file.close();
-    read_map_thread_.readMap(stl_input_file);
+    read_id_ = read_map_thread_.readMap(stl_input_file);
+  } else {
+    read_id_ = read_map_thread_.cancel();
   }
+  _deleteBaseMap();
 
   return file_exists;
 }
 
-void RenderArea::newBaseMap(Stomp::Map* base_map) {
+void RenderArea::newBaseMap(int read_id, Stomp::Map* base_map) {
+  if (read_id != read_id_) {
+    QWriteLocker locker(read_map_thread_.mapLock());
+    delete base_map;
+    return;
+  }
+
   base_map_ = base_map;
+  good_map_ = false;
+  map_bounds_set_ = false;
+}
 
+void RenderArea::baseMapUpdated(int read_id, bool finished) {
+  if ((read_id != read_id_) || (base_map_ == 0)) return;
+
+  QReadLocker locker(read_map_thread_.mapLock());
   good_map_ = !base_map_->Empty();
+  locker.unlock();
+
   if (good_map_) {
-    emit newStatus("Read base map.  Rendering...", 0);
-    _findNewWeightBounds(base_map);
-    _findNewImageBounds(base_map);
-    _findNewMaxResolution(base_map);
+    if (finished) {
+      emit newStatus("Read base map.  Rendering...", 0);
+    } else {
+      emit newStatus("Read part of base map.  Rendering...", 0);
+    }
+    _findNewWeightBounds(base_map_);
+    if (!map_bounds_set_) {
+      _findNewImageBounds(base_map_);
+      map_bounds_set_ = true;
+    }
+    _findNewMaxResolution(base_map_);
     emit newMapParameters();
+    render_map_thread_.newMap();
     updatePixmap();
   }
 }
 
+void RenderArea::readProgress(int read_id, qint64 bytes_read,
+			      qint64 total_bytes) {
+  if (read_id != read_id_) return;
+
+  emit newStatus(QString("Read %1 of %2 MB").
+		 arg(bytes_read/1048576.0, 0, 'f', 1).
+		 arg(total_bytes/1048576.0, 0, 'f', 1), 0);
+  if (total_bytes > 0)
+    emit progressUpdate(static_cast<int>(15*bytes_read/total_bytes));
+}
+
 void RenderArea::renderProgress(int progress) {
   emit progressUpdate(progress);
 }
@@ -434,6 +486,16 @@ void RenderArea::setFilterPoints(bool filter_points) {
   if (auto_update_) updatePoints();
 }
 
+void RenderArea::setBinPoints(bool bin_points) {
+  bin_points_ = bin_points;
+  if (auto_update_) updatePoints();
+}
+
+void RenderArea::setSumPointWeights(bool sum_point_weights) {
+  sum_point_weights_ = sum_point_weights;
+  if (auto_update_) updatePoints();
+}
+
 void RenderArea::setMaxResolution(uint32_t resolution) {
   max_resolution_ = resolution;
   if (auto_update_) updatePixmap();
@@ -873,7 +935,12 @@ void RenderArea::_drawLatGrid(QPainter* painter, double latitude) {
 }
 
 void RenderArea::_findNewWeightBounds(Stomp::Map* stomp_map) {
-  setMapWeightRange(stomp_map->MinWeight(), stomp_map->MaxWeight());
+  QReadLocker locker(read_map_thread_.mapLock());
+  double weight_min = stomp_map->MinWeight();
+  double weight_max = stomp_map->MaxWeight();
+  locker.unlock();
+
+  setMapWeightRange(weight_min, weight_max);
 }
 
 void RenderArea::_findNewWeightBounds(Stomp::WAngularVector& ang) {
@@ -889,12 +956,14 @@ void RenderArea::_findNewWeightBounds(Stomp::WAngularVector& ang) {
 }
 
 void RenderArea::_findNewImageBounds(Stomp::Map* stomp_map) {
-  if (!stomp_map->Empty()) {
-    double lonmax = -200.0, lonmin = 400.0;
-    double latmax = -200.0, latmin = 200.0;
-
-    Stomp::PixelVector pix;
-    if (stomp_map->Area() < Stomp::HPixArea) {
+  // The reader thread may still be adding to the Map, so we grab what we
+  // need from it up front and let go of the lock before touching geom_.
+  QReadLocker locker(read_map_thread_.mapLock());
+  bool empty_map = stomp_map->Empty();
+  double map_area = stomp_map->Area();
+  Stomp::PixelVector pix;
+  if (!empty_map) {
+    if (map_area < Stomp::HPixArea) {
       // If the Map area is less than that of a single superpixel, then we
       // probably have a small enough map that we can check all of the pixels
       // directly and find the exact bounds.
@@ -904,9 +973,15 @@ void RenderArea::_findNewImageBounds(Stomp::Map* stomp_map) {
       // to work out our bounds.
       stomp_map->Coverage(pix, Stomp::HPixResolution, false);
     }
+  }
+  locker.unlock();
+
+  if (!empty_map) {
+    double lonmax = -200.0, lonmin = 400.0;
+    double latmax = -200.0, latmin = 200.0;
 
     // quick check against the possibility that we've got a full-sky map
-    if (stomp_map->Area() > 0.2*4.0*Stomp::Pi*Stomp::StradToDeg) {
+    if (map_area > 0.2*4.0*Stomp::Pi*Stomp::StradToDeg) {
       setFullSky(true);
       setFullSky(false);
     } else {
@@ -989,7 +1064,23 @@ void RenderArea::_findNewImageBounds(Stomp::WAngularVector& ang) {
 }
 
 void RenderArea::_findNewMaxResolution(Stomp::Map* stomp_map) {
-  setMaxResolution(stomp_map->MaxResolution());
+  QReadLocker locker(read_map_thread_.mapLock());
+  uint32_t max_resolution = stomp_map->MaxResolution();
+  locker.unlock();
+
+  setMaxResolution(max_resolution);
+}
+
+void RenderArea::_deleteBaseMap() {
+  // clearMap cuts short whatever pass the render thread is on, so we only
+  // wait on the write lock for as long as it takes to notice.
+  render_map_thread_.clearMap();
+
+  QWriteLocker locker(read_map_thread_.mapLock());
+  delete base_map_;
+  base_map_ = 0;
+  good_map_ = false;
+  map_bounds_set_ = false;
 }
 
 
@@ -57,6 +57,8 @@ class RenderArea : public QWidget {
   bool displayingGrid();
   bool displayingPoints();
   bool filteringPoints();
+  bool binningPoints();
+  bool summingPointWeights();
   double mouseLongitude();
   double mouseLatitude();
 
@@ -84,12 +86,21 @@ class RenderArea : public QWidget {
   // return true.
   bool readNewMap(QString& file_name);
 
-  // The Map reader thread reads in the file indicated by the argument to
-  // readMapFile.  After doing so, it emits a signal indicating that the base
-  // resolution Map is ready.  That signal is tied to this slot, which stores
-  // the pointer, finds the Map bounds, updates the status and
-  // starts the Map rendering thread to show the base Map.
-  void newBaseMap(Stomp::Map* base_map);
+  // The Map reader thread reads the file indicated by the argument to
+  // readMapFile into a single Map, which it hands to this slot before it
+  // starts.  We own the Map from then on, but only look at it while
+  // holding the reader's map lock.  Every signal from the reader carries the
+  // id of the read it came from, so anything still queued from a read we've
+  // abandoned is dropped (and its Map deleted).
+  void newBaseMap(int read_id, Stomp::Map* base_map);
+
+  // As more of the Map comes in, the reader thread tells us to update the
+  // weight range and resolution from it and re-render, along with how many
+  // bytes of the file it's been through.  The image bounds are only set from
+  // the first update so that the view doesn't jump around as the rest of
+  // the Map comes in.
+  void baseMapUpdated(int read_id, bool finished);
+  void readProgress(int read_id, qint64 bytes_read, qint64 total_bytes);
 
   // While the rendering is being done, the render threads will update us as
   // to their progress
@@ -166,6 +177,12 @@ class RenderArea : public QWidget {
   void setDisplayPoints(bool display_points);
   void setFilterPoints(bool filter_points);
 
+  // For large sets of points, we can bin them into a per-pixel histogram
+  // and display that instead of the individual points, either as counts
+  // or as sums of the point weights.
+  void setBinPoints(bool bin_points);
+  void setSumPointWeights(bool sum_point_weights);
+
   // In general, when we make a polygon out of a pixel, we need to account
   // for the curvature of the pixel boundary in our coordinate space.  In
   // practice, this means turning the pixel into a many sided polygon, where
@@ -241,6 +258,10 @@ class RenderArea : public QWidget {
   void _findNewImageBounds(Stomp::WAngularVector& ang);
   void _findNewMaxResolution(Stomp::Map* stomp_map);
 
+  // Stop rendering the base Map and delete it.  The read that was filling
+  // it in needs to have been superseded or cancelled first.
+  void _deleteBaseMap();
+
  private:
   bool antialiased_;
   Palette map_palette_, points_palette_;
@@ -253,7 +274,8 @@ class RenderArea : public QWidget {
   QPixmap *grid_pixmap_;
   QColor background_color_;
   Stomp::Map* base_map_;
-  bool good_map_;
+  int read_id_;
+  bool good_map_, map_bounds_set_;
   Stomp::WAngularVector ang_;
   bool good_points_;
   bool fill_;
@@ -267,6 +289,7 @@ class RenderArea : public QWidget {
   bool show_coordinates_;
   bool show_grid_;
   bool show_points_, filter_points_;
+  bool bin_points_, sum_point_weights_;
 };
 
 #endif
@@ -678,6 +678,33 @@ bool RenderGeometry::angToPoint(Stomp::WeightedAngularCoordinate& ang,
   return inside_bounds;
 }
 
+bool RenderGeometry::pointToAng(const QPointF& point,
+				Stomp::AngularCoordinate& ang) {
+  if ((point.x() < buffer_left_) || (point.x() > width() - buffer_right_) ||
+      (point.y() < buffer_top_) || (point.y() > height() - buffer_bottom_))
+    return false;
+
+  double longitude = xToLon(point.x());
+  double latitude = yToLat(point.y());
+
+  if (aitoff_projection_ && !aitoffToCartesian(longitude, latitude))
+    return false;
+
+  switch (sphere_) {
+  case Stomp::AngularCoordinate::Survey:
+    ang.SetSurveyCoordinates(latitude, longitude);
+    break;
+  case Stomp::AngularCoordinate::Equatorial:
+    ang.SetEquatorialCoordinates(longitude, latitude);
+    break;
+  case Stomp::AngularCoordinate::Galactic:
+    ang.SetGalacticCoordinates(longitude, latitude);
+    break;
+  }
+
+  return true;
+}
+
 qreal RenderGeometry::lonToX(double longitude) {
   double n_pixel = static_cast<double>(width() - buffer_left_ - buffer_right_);
   double range = longitude - lonmin_;
@@ -807,3 +834,26 @@ void RenderGeometry::cartesianToAitoff(double& longitude, double& latitude) {
   latitude = sin(delta)*r2/denom;
 }
 
+bool RenderGeometry::aitoffToCartesian(double& longitude, double& latitude) {
+  // cartesianToAitoff gives the standard Hammer x and y, scaled by
+  // f*DegToRad, so we undo that scaling and use the usual inverse.
+  double r2 = sqrt(2.0);
+  double f = 2.0*r2/Stomp::Pi;
+
+  double x = longitude;
+  if ((sphere_ == Stomp::AngularCoordinate::Equatorial) ||
+      (sphere_ == Stomp::AngularCoordinate::Galactic)) x -= 180.0;
+  x *= f*Stomp::DegToRad;
+  double y = latitude*f*Stomp::DegToRad;
+
+  double z2 = 1.0 - 0.0625*x*x - 0.25*y*y;
+  if (z2 < 0.5) return false;
+  double z = sqrt(z2);
+
+  longitude = 2.0*atan2(z*x, 2.0*(2.0*z2 - 1.0))*Stomp::RadToDeg;
+  if ((sphere_ == Stomp::AngularCoordinate::Equatorial) ||
+      (sphere_ == Stomp::AngularCoordinate::Galactic)) longitude += 180.0;
+  latitude = asin(z*y)*Stomp::RadToDeg;
+
+  return true;
+}
@@ -103,6 +103,10 @@ class RenderGeometry {
   // AngularCoordinates are simply turned into QPointFs.
   bool angToPoint(Stomp::WeightedAngularCoordinate& w_ang, QPointF& point);
 
+  // And back again.  This returns false if the point falls in the buffer
+  // around the plotting area or outside the Aitoff-Hammer ellipse.
+  bool pointToAng(const QPointF& point, Stomp::AngularCoordinate& ang);
+
   // Four methods for going back and forth between angular space and QPixmap
   // XY pixel-space.
   qreal lonToX(double longitude);
@@ -119,8 +123,10 @@ class RenderGeometry {
   double lonCenter();
   double latCenter();
 
-  // Translate between Cartesian and Aitoff-Hammer projections.
+  // Translate between Cartesian and Aitoff-Hammer projections.  The inverse
+  // returns false if the input is outside of the projected sphere.
   void cartesianToAitoff(double& longitude, double& latitude);
+  bool aitoffToCartesian(double& longitude, double& latitude);
 
   // Based on the current display bounds, figure out the area of a QPixmap
   // pixel.  Any Stomp::Pixels with areas smaller than that should be rendered
@@ -1,4 +1,6 @@
 #include <QtGui>
+#include <atomic>
+#include <vector>
 #include <QBrush>
 #include <QPen>
 #include <QWidget>
@@ -7,6 +9,9 @@
 #include "render_thread.h"
 
 RenderMapThread::RenderMapThread(QObject *parent) : QThread(parent) {
+  map_lock_ = 0;
+  stomp_map_ = 0;
+  new_map_ = true;
   restart = false;
   abort = false;
 }
@@ -41,8 +46,36 @@ void RenderMapThread::renderMap(Stomp::Map* stomp_map, RenderGeometry& geometry,
   }
 }
 
+void RenderMapThread::newMap() {
+  QMutexLocker locker(&mutex);
+  new_map_ = true;
+}
+
+void RenderMapThread::setMapLock(QReadWriteLock* map_lock) {
+  QMutexLocker locker(&mutex);
+  map_lock_ = map_lock;
+}
+
+void RenderMapThread::clearMap() {
+  QMutexLocker locker(&mutex);
+  stomp_map_ = 0;
+  new_map_ = true;
+
+  if (isRunning()) {
+    restart = true;
+    condition.wakeOne();
+  }
+}
+
 void RenderMapThread::run() {
   forever {
+    // The lock is taken before we pick up the Map so that it can't be
+    // deleted between clearMap and the start of the pass.
+    mutex.lock();
+    QReadWriteLock* map_lock = map_lock_;
+    mutex.unlock();
+    if (map_lock != 0) map_lock->lockForRead();
+
     mutex.lock();
     Stomp::Map* stomp_map = stomp_map_;
     RenderGeometry geom = geom_;
@@ -51,97 +84,139 @@ void RenderMapThread::run() {
     uint32_t max_resolution = max_resolution_;
     bool antialiased = antialiased_;
     bool fill = fill_;
+    bool new_map = new_map_;
+    new_map_ = false;
+    mutex.unlock();
+
+    if (stomp_map == 0) {
+      tile_renderer_.clear();
+    } else if (fill) {
+      _renderTiles(stomp_map, geom, palette, max_resolution, new_map);
+    } else {
+      _renderPolygons(stomp_map, geom, palette, max_resolution, antialiased,
+		      fill);
+    }
+    if (map_lock != 0) map_lock->unlock();
+    if (abort) return;
+
+    mutex.lock();
+    if (!restart) condition.wait(&mutex);
+    restart = false;
     mutex.unlock();
+  }
+}
 
-    uint32_t step = stomp_map->Size()/15;
+void RenderMapThread::_renderTiles(Stomp::Map* stomp_map,
+				   RenderGeometry& geom, Palette& palette,
+				   uint32_t max_resolution, bool new_map) {
+  // Each pass softens its pyramid level the first time it's used, coarsest
+  // first, so the first frame only waits on one trip through the Map and a
+  // restart or abort is picked up before each of the finer levels is built.
+  // After that, a pass is just a lookup per image pixel (or less, for cached
+  // tiles).
+  if (new_map || (tile_renderer_.map() != stomp_map))
+    tile_renderer_.setMap(stomp_map);
 
-    QImage image(geom.width(), geom.height(),
-		 QImage::Format_ARGB32_Premultiplied);
-    image.fill(QColor(Qt::white).rgb());
+  std::vector<uint32_t> resolutions;
+  tile_renderer_.levelOfDetail(geom, max_resolution, resolutions);
+  for (uint32_t i=0;i<resolutions.size();i++) {
+    QImage image;
+    if (!tile_renderer_.render(geom, palette, resolutions[i], image,
+			       [this]() { return restart || abort; })) return;
+    emit renderedImage(image);
+    emit renderProgress(static_cast<int>(15*(i + 1)/resolutions.size()));
+  }
+}
 
-    QPainter painter;
+void RenderMapThread::_renderPolygons(Stomp::Map* stomp_map,
+				      RenderGeometry& geom, Palette& palette,
+				      uint32_t max_resolution,
+				      bool antialiased, bool fill) {
+  uint32_t step = stomp_map->Size()/15;
 
-    bool accessed_device = painter.begin(&image);
+  QImage image(geom.width(), geom.height(),
+	       QImage::Format_ARGB32_Premultiplied);
+  image.fill(QColor(Qt::white).rgb());
 
-    if (accessed_device) {
-      if (antialiased) {
-	painter.setRenderHint(QPainter::Antialiasing, true);
-	painter.translate(+0.5, +0.5);
-      }
+  QPainter painter;
 
-      if (!stomp_map->Empty()) {
+  bool accessed_device = painter.begin(&image);
 
-	double render_pixel_area = geom.renderPixelArea();
+  if (accessed_device) {
+    if (antialiased) {
+      painter.setRenderHint(QPainter::Antialiasing, true);
+      painter.translate(+0.5, +0.5);
+    }
 
-	uint32_t counter = 0;
-	int status = 0;
-	for (Stomp::MapIterator iter=stomp_map->Begin();
-	     iter!=stomp_map->End();stomp_map->Iterate(&iter)) {
-	  counter++;
-	  if (counter % step == 0) {
-	    status++;
-	    emit renderProgress(status);
-	  }
-	  if (restart) break;
-	  if (abort) return;
-	  Stomp::PixelIterator pix = iter.second;
-	  if (pix->Resolution() <= max_resolution &&
-	      (geom.fullSky() || pix->IntersectsBounds(geom.longitudeMin(),
-						       geom.longitudeMax(),
-						       geom.latitudeMin(),
-						       geom.latitudeMax(),
-						       geom.sphere()))) {
-	    QBrush pixel_brush = QBrush(palette.color(pix->Weight()));
-	    painter.setBrush(pixel_brush);
-	    painter.setPen(QPen(pixel_brush, 0));
-
-	    if (pix->Area() < render_pixel_area) {
-	      // If the pixel is so small that displaying it wouldn't cover at
-	      // least a single pixel, we just use a single QPointF.
-	      QPointF point;
-	      geom.pixelToPoint(pix->PixelX(), pix->PixelY(),
-				pix->Resolution(), point);
-	      painter.drawPoint(point);
+    if (!stomp_map->Empty()) {
+
+      double render_pixel_area = geom.renderPixelArea();
+
+      uint32_t counter = 0;
+      int status = 0;
+      for (Stomp::MapIterator iter=stomp_map->Begin();
+	   iter!=stomp_map->End();stomp_map->Iterate(&iter)) {
+	counter++;
+	if (counter % step == 0) {
+	  status++;
+	  emit renderProgress(status);
+	}
+	if (restart) break;
+	if (abort) return;
+	Stomp::PixelIterator pix = iter.second;
+	if (pix->Resolution() <= max_resolution &&
+	    (geom.fullSky() || pix->IntersectsBounds(geom.longitudeMin(),
+						     geom.longitudeMax(),
+						     geom.latitudeMin(),
+						     geom.latitudeMax(),
+						     geom.sphere()))) {
+	  QBrush pixel_brush = QBrush(palette.color(pix->Weight()));
+	  painter.setBrush(pixel_brush);
+	  painter.setPen(QPen(pixel_brush, 0));
+
+	  if (pix->Area() < render_pixel_area) {
+	    // If the pixel is so small that displaying it wouldn't cover at
+	    // least a single pixel, we just use a single QPointF.
+	    QPointF point;
+	    geom.pixelToPoint(pix->PixelX(), pix->PixelY(),
+			      pix->Resolution(), point);
+	    painter.drawPoint(point);
+	  } else {
+	    if (pix->ContinuousBounds(geom.sphere())) {
+	      QPolygonF polygon;
+	      geom.pixelToPolygon(pix->PixelX(), pix->PixelY(),
+				  pix->Resolution(), max_resolution, polygon);
+	      if (fill) {
+		painter.drawConvexPolygon(polygon);
+	      } else {
+		painter.drawPolyline(polygon);
+	      }
 	    } else {
-	      if (pix->ContinuousBounds(geom.sphere())) {
-		QPolygonF polygon;
-		geom.pixelToPolygon(pix->PixelX(), pix->PixelY(),
-				    pix->Resolution(), max_resolution, polygon);
-		if (fill) {
-		  painter.drawConvexPolygon(polygon);
-		} else {
-		  painter.drawPolyline(polygon);
-		}
+	      QPolygonF left_polygon;
+	      QPolygonF right_polygon;
+	      geom.splitPixelToPolygons(pix->PixelX(), pix->PixelY(),
+					pix->Resolution(), max_resolution,
+					left_polygon, right_polygon);
+	      if (fill) {
+		painter.drawConvexPolygon(left_polygon);
+		painter.drawConvexPolygon(right_polygon);
 	      } else {
-		QPolygonF left_polygon;
-		QPolygonF right_polygon;
-		geom.splitPixelToPolygons(pix->PixelX(), pix->PixelY(),
-					  pix->Resolution(), max_resolution,
-					  left_polygon, right_polygon);
-		if (fill) {
-		  painter.drawConvexPolygon(left_polygon);
-		  painter.drawConvexPolygon(right_polygon);
-		} else {
-		  painter.drawPolyline(left_polygon);
-		  painter.drawPolyline(right_polygon);
-		}
+		painter.drawPolyline(left_polygon);
+		painter.drawPolyline(right_polygon);
 	      }
 	    }
 	  }
 	}
       }
-      accessed_device = painter.end();
     }
-    if (!restart && accessed_device) emit renderedImage(image);
-
-    mutex.lock();
-    if (!restart) condition.wait(&mutex);
-    restart = false;
-    mutex.unlock();
+    accessed_device = painter.end();
   }
+  if (!restart && accessed_device) emit renderedImage(image);
 }
 
 RenderPointsThread::RenderPointsThread(QObject *parent) : QThread(parent) {
+  bin_points_ = false;
+  sum_weights_ = false;
   restart = false;
   abort = false;
 }
@@ -157,7 +232,8 @@ RenderPointsThread::~RenderPointsThread() {
 
 void RenderPointsThread::renderPoints(Stomp::WAngularVector* ang,
 				      RenderGeometry& geometry,
-				      Palette& palette, bool antialiased) {
+				      Palette& palette, bool antialiased,
+				      bool bin_points, bool sum_weights) {
   QMutexLocker locker(&mutex);
 
   ang_ = ang;
@@ -165,6 +241,8 @@ void RenderPointsThread::renderPoints(Stomp::WAngularVector* ang,
   palette_ = palette;
   palette_.initialize(palette.currentPaletteType()); // Need this for deep copy
   antialiased_ = antialiased;
+  bin_points_ = bin_points;
+  sum_weights_ = sum_weights;
 
   if (!isRunning()) {
     start(LowPriority);
@@ -182,56 +260,152 @@ void RenderPointsThread::run() {
     Palette palette = palette_;
     palette.initialize(palette_.currentPaletteType());
     bool antialiased = antialiased_;
+    bool bin_points = bin_points_;
+    bool sum_weights = sum_weights_;
+    mutex.unlock();
+
+    if (bin_points) {
+      _binPoints(ang, geom, palette, sum_weights);
+    } else {
+      _drawPoints(ang, geom, palette, antialiased);
+    }
+    if (abort) return;
+
+    mutex.lock();
+    if (!restart) condition.wait(&mutex);
+    restart = false;
     mutex.unlock();
+  }
+}
 
-    uint32_t step = ang->size()/15;
+void RenderPointsThread::_drawPoints(Stomp::WAngularVector* ang,
+				     RenderGeometry& geom, Palette& palette,
+				     bool antialiased) {
+  uint32_t step = ang->size()/15;
+  if (step == 0) step = 1;
 
-    QImage image(geom.width(), geom.height(),
-		 QImage::Format_ARGB32_Premultiplied);
-    image.fill(QColor(Qt::transparent).rgba());
+  QImage image(geom.width(), geom.height(),
+	       QImage::Format_ARGB32_Premultiplied);
+  image.fill(QColor(Qt::transparent).rgba());
 
-    QPainter painter;
+  QPainter painter;
 
-    bool accessed_device = painter.begin(&image);
+  bool accessed_device = painter.begin(&image);
 
-    if (accessed_device) {
-      if (antialiased) {
-	painter.setRenderHint(QPainter::Antialiasing, true);
-	painter.translate(+0.5, +0.5);
-      }
+  if (accessed_device) {
+    if (antialiased) {
+      painter.setRenderHint(QPainter::Antialiasing, true);
+      painter.translate(+0.5, +0.5);
+    }
 
-      if (!ang->empty()) {
-	uint32_t plotted_points = 0;
-	uint32_t counter = 0;
-	int status = 0;
-	for (Stomp::WAngularIterator iter=ang->begin();
-	     iter!=ang->end();++iter) {
-	  counter++;
-	  if (counter % step == 0) {
-	    status++;
-	    emit renderProgress(status);
-	  }
-	  if (restart) break;
-	  if (abort) return;
-	  QPointF point;
-	  if (geom_.angToPoint(*iter, point)) {
-	    QBrush pixel_brush = QBrush(palette.color(iter->Weight()));
-	    painter.setBrush(pixel_brush);
-	    painter.setPen(QPen(pixel_brush, 0));
-	    painter.drawPoint(point);
-	    plotted_points++;
-	  }
+    if (!ang->empty()) {
+      uint32_t plotted_points = 0;
+      uint32_t counter = 0;
+      int status = 0;
+      for (Stomp::WAngularIterator iter=ang->begin();
+	   iter!=ang->end();++iter) {
+	counter++;
+	if (counter % step == 0) {
+	  status++;
+	  emit renderProgress(status);
+	}
+	if (restart) break;
+	if (abort) return;
+	QPointF point;
+	if (geom.angToPoint(*iter, point)) {
+	  QBrush pixel_brush = QBrush(palette.color(iter->Weight()));
+	  painter.setBrush(pixel_brush);
+	  painter.setPen(QPen(pixel_brush, 0));
+	  painter.drawPoint(point);
+	  plotted_points++;
 	}
-	std::cout << "Plotted " << plotted_points << "/" <<
-	  ang->size() << " points...\n";
       }
-      accessed_device = painter.end();
-      if (!restart && accessed_device) emit renderedImage(image);
+      std::cout << "Plotted " << plotted_points << "/" <<
+	ang->size() << " points...\n";
     }
+    accessed_device = painter.end();
+    if (!restart && accessed_device) emit renderedImage(image);
+  }
+}
 
-    mutex.lock();
-    if (!restart) condition.wait(&mutex);
-    restart = false;
-    mutex.unlock();
+void RenderPointsThread::_binPoints(Stomp::WAngularVector* ang,
+				    RenderGeometry& geom, Palette& palette,
+				    bool sum_weights) {
+  int width = geom.width();
+  int height = geom.height();
+  if ((width <= 0) || (height <= 0)) return;
+  uint32_t n_pixels = static_cast<uint32_t>(width*height);
+
+  // Each chunk of points gets its own histogram, so the workers never
+  // contend for a bin; the histograms are added up afterwards, a row at a
+  // time.
+  uint32_t n_chunks = Stomp::DefaultThreads();
+  if (n_chunks > ang->size()) n_chunks = ang->size();
+  if (n_chunks == 0) n_chunks = 1;
+  uint32_t chunk_size = (ang->size() + n_chunks - 1)/n_chunks;
+
+  std::vector<std::vector<double> > histogram(n_chunks);
+  std::atomic<bool> stopped(false);
+  std::atomic<uint32_t> finished_chunks(0);
+  Stomp::ParallelFor(n_chunks, Stomp::DefaultThreads(), [&](uint32_t k) {
+    std::vector<double>& bins = histogram[k];
+    bins.assign(n_pixels, 0.0);
+
+    uint32_t end = (k + 1)*chunk_size;
+    if (end > ang->size()) end = ang->size();
+    for (uint32_t i=k*chunk_size;i<end;i++) {
+      if ((i % 65536 == 0) && (restart || abort)) {
+	stopped.store(true);
+	return;
+      }
+      QPointF point;
+      if (!geom.angToPoint((*ang)[i], point)) continue;
+
+      int x = static_cast<int>(point.x());
+      int y = static_cast<int>(point.y());
+      if ((x < 0) || (x >= width) || (y < 0) || (y >= height)) continue;
+      bins[y*width + x] += (sum_weights ? (*ang)[i].Weight() : 1.0);
+    }
+    emit renderProgress(static_cast<int>(14*(++finished_chunks)/n_chunks));
+  });
+  if (stopped.load()) return;
+
+  Stomp::ParallelFor(height, Stomp::DefaultThreads(), [&](uint32_t y) {
+    for (uint32_t k=1;k<n_chunks;k++) {
+      for (int x=0;x<width;x++)
+	histogram[0][y*width + x] += histogram[k][y*width + x];
+    }
+  });
+  std::vector<double>& bins = histogram[0];
+
+  // The bin values have nothing to do with the weight range set for the
+  // individual points, so we scale the palette to the range of the occupied
+  // bins instead.  Counts can easily span several orders of magnitude, so
+  // they go on a log scale; weight sums can be negative, so they don't.
+  double bin_min = 1.0e30, bin_max = -1.0e30;
+  for (uint32_t i=0;i<n_pixels;i++) {
+    if (Stomp::DoubleEQ(bins[i], 0.0)) continue;
+    if (bins[i] < bin_min) bin_min = bins[i];
+    if (bins[i] > bin_max) bin_max = bins[i];
   }
+  if (Stomp::DoubleEQ(bin_min, bin_max)) bin_max = bin_min + 1.0;
+
+  QImage image(width, height, QImage::Format_ARGB32_Premultiplied);
+  image.fill(QColor(Qt::transparent).rgba());
+  if (bin_max >= bin_min) {
+    Palette bin_palette(palette.currentPaletteType(), bin_min, bin_max,
+			!sum_weights);
+    for (int y=0;y<height;y++) {
+      QRgb* line = reinterpret_cast<QRgb*>(image.scanLine(y));
+      for (int x=0;x<width;x++) {
+	if (!Stomp::DoubleEQ(bins[y*width + x], 0.0))
+	  line[x] = bin_palette.rgb(bins[y*width + x]);
+      }
+    }
+  }
+  emit renderProgress(15);
+
+  std::cout << "Binned " << ang->size() << " points into " << n_pixels <<
+    " image pixels...\n";
+  if (!restart) emit renderedImage(image);
 }
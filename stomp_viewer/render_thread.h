@@ -8,22 +8,25 @@
 // a way as to make the analysis of that data as algorithmically efficient as
 // possible.
 //
-// This header file contains the thread class for generating QPixmap from a
-// Stomp::Map object.
+// This header file contains the thread classes for generating QPixmap from a
+// Stomp::Map object or a set of points.
 
 #ifndef RENDER_THREAD_H
 #define RENDER_THREAD_H
 
 #include <QMutex>
+#include <QReadWriteLock>
 #include <QThread>
 #include <QWaitCondition>
 #include <QPixmap>
 #include <stomp.h>
 #include "palette.h"
 #include "render_geometry.h"
+#include "tile_renderer.h"
 
 class Palette;
 class RenderGeometry;
+class TileRenderer;
 class RenderMapThread;
 class RenderPointsThread;
 
@@ -34,10 +37,27 @@ class RenderMapThread : public QThread {
   RenderMapThread(QObject *parent = 0);
   ~RenderMapThread();
 
+  // Filled maps go through a TileRenderer, which emits a coarse image
+  // almost immediately and then progressively finer ones until the image
+  // matches the display resolution.  Unfilled maps are still drawn a
+  // polygon at a time.
   void renderMap(Stomp::Map* stomp_map, RenderGeometry& geometry,
 		 Palette& palette, uint32_t max_resolution,
 		 bool antialiased, bool fill);
 
+  // The TileRenderer keeps a softened pyramid and a tile cache for the
+  // current Map, so it needs to be told when the Map has changed, even if
+  // the new one happens to have the same address as the old one.
+  void newMap();
+
+  // The Map may still be filling in while we render it, so each pass holds
+  // the read side of this lock (from the ReadMapThread) for as long as it's
+  // looking at the Map.  clearMap drops our pointer to the Map and cuts
+  // short the current pass, so it has to be called before the Map is
+  // deleted.
+  void setMapLock(QReadWriteLock* map_lock);
+  void clearMap();
+
  signals:
   void renderedImage(const QImage& image);
   void renderProgress(int progress);
@@ -46,13 +66,22 @@ class RenderMapThread : public QThread {
   void run();
 
  private:
+  void _renderTiles(Stomp::Map* stomp_map, RenderGeometry& geom,
+		    Palette& palette, uint32_t max_resolution, bool new_map);
+  void _renderPolygons(Stomp::Map* stomp_map, RenderGeometry& geom,
+		       Palette& palette, uint32_t max_resolution,
+		       bool antialiased, bool fill);
+
   QMutex mutex;
   QWaitCondition condition;
+  QReadWriteLock* map_lock_;
   Stomp::Map* stomp_map_;
   RenderGeometry geom_;
   Palette palette_;
+  TileRenderer tile_renderer_;
   uint32_t max_resolution_;
   bool antialiased_, fill_;
+  bool new_map_;
   bool restart;
   bool abort;
 };
@@ -64,8 +93,16 @@ class RenderPointsThread : public QThread {
   RenderPointsThread(QObject *parent = 0);
   ~RenderPointsThread();
 
+  // By default, each point is drawn individually in the color for its
+  // weight.  That gets slow and saturates the image once there are millions
+  // of points, so with bin_points the points are instead counted into a
+  // histogram with one bin per image pixel (in parallel) and the histogram
+  // is drawn through the palette, scaled to the range of the occupied bins.
+  // With sum_weights, the bins hold the sum of the point weights rather
+  // than the number of points.
   void renderPoints(Stomp::WAngularVector* ang, RenderGeometry& geometry,
-		    Palette& palette, bool antialiased);
+		    Palette& palette, bool antialiased,
+		    bool bin_points = false, bool sum_weights = false);
 
  signals:
   void renderedImage(const QImage& image);
@@ -75,12 +112,18 @@ class RenderPointsThread : public QThread {
   void run();
 
  private:
+  void _drawPoints(Stomp::WAngularVector* ang, RenderGeometry& geom,
+		   Palette& palette, bool antialiased);
+  void _binPoints(Stomp::WAngularVector* ang, RenderGeometry& geom,
+		  Palette& palette, bool sum_weights);
+
   QMutex mutex;
   QWaitCondition condition;
   Stomp::WAngularVector* ang_;
   RenderGeometry geom_;
   Palette palette_;
   bool antialiased_;
+  bool bin_points_, sum_weights_;
   bool restart;
   bool abort;
 };
@@ -461,6 +461,9 @@ void StompViewer::setupPointsAppearanceGroup() {
   showPointsCheckBox = new QCheckBox(tr("Show &Points"), pointsAppearanceGroup);
   filterPointsCheckBox = new QCheckBox(tr("Fil&ter Points"),
 				       pointsAppearanceGroup);
+  binPointsCheckBox = new QCheckBox(tr("&Bin Points"), pointsAppearanceGroup);
+  sumWeightsCheckBox = new QCheckBox(tr("S&um Weights"),
+				     pointsAppearanceGroup);
 
   // Begin palette group -- within Appearance group
   pointsPaletteGroup = new QGroupBox(pointsAppearanceGroup);
@@ -506,8 +509,10 @@ void StompViewer::setupPointsAppearanceGroup() {
   QGridLayout *appearanceLayout = new QGridLayout(pointsAppearanceGroup);
   appearanceLayout->addWidget(showPointsCheckBox, 0, 0);
   appearanceLayout->addWidget(filterPointsCheckBox, 0, 1);
-  appearanceLayout->addWidget(pointsWeightGroup, 1, 0);
-  appearanceLayout->addWidget(pointsPaletteGroup, 1, 1);
+  appearanceLayout->addWidget(binPointsCheckBox, 1, 0);
+  appearanceLayout->addWidget(sumWeightsCheckBox, 1, 1);
+  appearanceLayout->addWidget(pointsWeightGroup, 2, 0);
+  appearanceLayout->addWidget(pointsPaletteGroup, 2, 1);
   pointsAppearanceGroup->setLayout(appearanceLayout);
 
   // Appearance group connections
@@ -515,6 +520,10 @@ void StompViewer::setupPointsAppearanceGroup() {
 	  this, SLOT(showPointsToggled()));
   connect(filterPointsCheckBox, SIGNAL(toggled(bool)),
 	  this, SLOT(filterPointsToggled()));
+  connect(binPointsCheckBox, SIGNAL(toggled(bool)),
+	  this, SLOT(binPointsToggled()));
+  connect(sumWeightsCheckBox, SIGNAL(toggled(bool)),
+	  this, SLOT(binPointsToggled()));
   connect(pointsWeightMinLineEdit, SIGNAL(editingFinished()),
 	  this, SLOT(newPointsWeightMin()));
   connect(pointsWeightMaxLineEdit, SIGNAL(editingFinished()),
@@ -947,6 +956,13 @@ void StompViewer::filterPointsToggled() {
   renderArea->updatePoints();
 }
 
+void StompViewer::binPointsToggled() {
+  renderArea->setBinPoints(binPointsCheckBox->isChecked());
+  renderArea->setSumPointWeights(sumWeightsCheckBox->isChecked());
+
+  renderArea->updatePoints();
+}
+
 void StompViewer::getMousePosition() {
   lonCoordLabel->setText(QString("%1").arg(renderArea->mouseLongitude(),
 					   8, 'f', 6, 0));
@@ -145,6 +145,10 @@ class StompViewer : public QMainWindow {
   void showPointsToggled();
   void filterPointsToggled();
 
+  // Likewise for the check boxes to bin the points into a density image,
+  // optionally summing their weights.
+  void binPointsToggled();
+
   // MOUSE TRACKING SLOTS
   //
   // When the mouse is over the RenderArea widget, we convert its position into
@@ -213,6 +217,8 @@ class StompViewer : public QMainWindow {
   QGroupBox *pointsAppearanceGroup;
   QCheckBox *showPointsCheckBox;
   QCheckBox *filterPointsCheckBox;
+  QCheckBox *binPointsCheckBox;
+  QCheckBox *sumWeightsCheckBox;
   QGroupBox *pointsWeightGroup;
   QLineEdit *pointsWeightMinLineEdit;
   QLineEdit *pointsWeightMaxLineEdit;
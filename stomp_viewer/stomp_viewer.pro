@@ -7,9 +7,10 @@ TARGET =
 DEPENDPATH += .
 INCLUDEPATH += .
 CONFIG += debug
+QMAKE_CXXFLAGS += -std=c++0x
 
 # Input
-HEADERS += render_area.h stomp_viewer.h render_geometry.h palette.h render_thread.h reader_thread.h
-SOURCES += main.cc render_area.cc stomp_viewer.cc render_geometry.cc palette.cc render_thread.cc reader_thread.cc
+HEADERS += render_area.h stomp_viewer.h render_geometry.h palette.h render_thread.h reader_thread.h tile_renderer.h
+SOURCES += main.cc render_area.cc stomp_viewer.cc render_geometry.cc palette.cc render_thread.cc reader_thread.cc tile_renderer.cc
 RESOURCES += stomp_viewer.qrc
-LIBS += -lm -lstomp
+LIBS += -lm -lstomp -lpthread
@@ -0,0 +1,204 @@
+#include <QtGui>
+#include <atomic>
+#include <cstring>
+#include <sstream>
+#include "tile_renderer.h"
+
+TileRenderer::TileRenderer() {
+  base_map_ = 0;
+  setCacheSize(128*1024);
+}
+
+TileRenderer::~TileRenderer() {
+  clear();
+}
+
+void TileRenderer::setMap(Stomp::Map* stomp_map) {
+  clear();
+  base_map_ = stomp_map;
+}
+
+void TileRenderer::clear() {
+  for (std::map<uint32_t, Stomp::Map*>::iterator iter=pyramid_.begin();
+       iter!=pyramid_.end();++iter) delete iter->second;
+  pyramid_.clear();
+  base_map_ = 0;
+
+  QMutexLocker locker(&cache_mutex_);
+  cache_.clear();
+}
+
+Stomp::Map* TileRenderer::map() {
+  return base_map_;
+}
+
+int TileRenderer::pyramidLevels() {
+  return static_cast<int>(pyramid_.size());
+}
+
+uint32_t TileRenderer::renderResolution(RenderGeometry& geometry,
+					uint32_t max_resolution) {
+  // We want the finest resolution whose pixels are still at least half an
+  // image pixel on a side.
+  double render_pixel_area = geometry.renderPixelArea();
+  uint32_t resolution = Stomp::HPixResolution;
+  while ((resolution < Stomp::MaxPixelResolution) &&
+	 (Stomp::Pixel::PixelArea(2*resolution) >= 0.25*render_pixel_area))
+    resolution *= 2;
+
+  if (resolution > max_resolution) resolution = max_resolution;
+  if ((base_map_ != 0) && !base_map_->Empty() &&
+      (resolution > base_map_->MaxResolution()))
+    resolution = base_map_->MaxResolution();
+  if (resolution < Stomp::HPixResolution) resolution = Stomp::HPixResolution;
+
+  return resolution;
+}
+
+void TileRenderer::levelOfDetail(RenderGeometry& geometry,
+				 uint32_t max_resolution,
+				 std::vector<uint32_t>& resolutions) {
+  resolutions.clear();
+
+  uint32_t render_resolution = renderResolution(geometry, max_resolution);
+  uint32_t resolution = render_resolution/16;
+  if (resolution < Stomp::HPixResolution) resolution = Stomp::HPixResolution;
+  for (;resolution<render_resolution;resolution*=4)
+    resolutions.push_back(resolution);
+  resolutions.push_back(render_resolution);
+}
+
+bool TileRenderer::render(RenderGeometry& geometry, Palette& palette,
+			  uint32_t resolution, QImage& image,
+			  std::function<bool()> cancelled) {
+  int width = geometry.width();
+  int height = geometry.height();
+  if ((image.width() != width) || (image.height() != height) ||
+      (image.format() != QImage::Format_ARGB32_Premultiplied))
+    image = QImage(width, height, QImage::Format_ARGB32_Premultiplied);
+  image.fill(QColor(Qt::white).rgb());
+
+  if (cancelled && cancelled()) return false;
+  Stomp::Map* stomp_map = _level(resolution);
+  if ((stomp_map == 0) || stomp_map->Empty() || (width <= 0) ||
+      (height <= 0)) return true;
+
+  // The workers copy their tiles straight into the image, so we get the
+  // pointer once here rather than having each of them detach it.
+  uchar* bits = image.bits();
+  int bytes_per_line = image.bytesPerLine();
+
+  int n_tile_x = (width + TileSize - 1)/TileSize;
+  int n_tile_y = (height + TileSize - 1)/TileSize;
+  std::atomic<bool> stopped(false);
+  Stomp::ParallelFor(n_tile_x*n_tile_y, Stomp::DefaultThreads(),
+		     [&](uint32_t k) {
+    if (stopped.load()) return;
+    if (cancelled && cancelled()) {
+      stopped.store(true);
+      return;
+    }
+
+    int tile_x = k % n_tile_x;
+    int tile_y = k / n_tile_x;
+    QString key = _tileKey(geometry, palette, resolution, tile_x, tile_y);
+
+    QImage tile;
+    cache_mutex_.lock();
+    QImage* cached_tile = cache_.object(key);
+    if (cached_tile != 0) tile = *cached_tile;
+    cache_mutex_.unlock();
+
+    if (tile.isNull()) {
+      tile = QImage(TileSize, TileSize, QImage::Format_ARGB32_Premultiplied);
+      _renderTile(geometry, palette, stomp_map, tile_x*TileSize,
+		  tile_y*TileSize, tile);
+      cache_mutex_.lock();
+      cache_.insert(key, new QImage(tile), TileSize*TileSize*4/1024);
+      cache_mutex_.unlock();
+    }
+
+    int x_min = tile_x*TileSize;
+    int y_min = tile_y*TileSize;
+    int n_x = (x_min + TileSize > width ? width - x_min : TileSize);
+    int n_y = (y_min + TileSize > height ? height - y_min : TileSize);
+    for (int y=0;y<n_y;y++)
+      memcpy(bits + (y_min + y)*bytes_per_line + x_min*sizeof(QRgb),
+	     tile.constScanLine(y), n_x*sizeof(QRgb));
+  });
+
+  return !stopped.load();
+}
+
+void TileRenderer::setCacheSize(int max_kilobytes) {
+  QMutexLocker locker(&cache_mutex_);
+  cache_.setMaxCost(max_kilobytes);
+}
+
+int TileRenderer::cachedTiles() {
+  QMutexLocker locker(&cache_mutex_);
+  return cache_.count();
+}
+
+Stomp::Map* TileRenderer::_level(uint32_t resolution) {
+  if ((base_map_ == 0) || base_map_->Empty() ||
+      (resolution >= base_map_->MaxResolution())) return base_map_;
+
+  std::map<uint32_t, Stomp::Map*>::iterator iter = pyramid_.find(resolution);
+  if (iter != pyramid_.end()) return iter->second;
+
+  // We soften from the closest finer level we've already built, falling
+  // back to the base Map.  Since levelOfDetail goes from coarse to fine,
+  // the first pass costs a single trip through the base Map rather than
+  // waiting on every level between it and the Map's maximum resolution.
+  Stomp::Map* finer_map = base_map_;
+  iter = pyramid_.upper_bound(resolution);
+  if (iter != pyramid_.end()) finer_map = iter->second;
+
+  Stomp::Map* level_map = new Stomp::Map();
+  finer_map->Soften(*level_map, resolution, true);
+  pyramid_[resolution] = level_map;
+
+  return level_map;
+}
+
+QString TileRenderer::_tileKey(RenderGeometry& geometry, Palette& palette,
+			       uint32_t resolution, int tile_x, int tile_y) {
+  // The image bounds alone don't pin down the geometry, since the buffers
+  // shift the plotting area, so we throw in the coordinates of the corner
+  // of the image as well.
+  std::ostringstream key;
+  key.precision(17);
+  key << geometry.longitudeMin() << " " << geometry.longitudeMax() << " " <<
+    geometry.latitudeMin() << " " << geometry.latitudeMax() << " " <<
+    geometry.xToLon(0.0) << " " << geometry.yToLat(0.0) << " " <<
+    static_cast<int>(geometry.sphere()) << " " <<
+    geometry.aitoffProjection() << " " << geometry.width() << " " <<
+    geometry.height() << " " <<
+    static_cast<int>(palette.currentPaletteType()) << " " <<
+    palette.weightMin() << " " << palette.weightMax() << " " <<
+    palette.logWeight() << " " << resolution << " " << tile_x << " " <<
+    tile_y;
+  return QString::fromLatin1(key.str().c_str());
+}
+
+void TileRenderer::_renderTile(RenderGeometry& geometry, Palette& palette,
+			       Stomp::Map* stomp_map, int x_min, int y_min,
+			       QImage& tile) {
+  QRgb background = QColor(Qt::white).rgb();
+  for (int y=0;y<TileSize;y++) {
+    QRgb* line = reinterpret_cast<QRgb*>(tile.scanLine(y));
+    for (int x=0;x<TileSize;x++) {
+      line[x] = background;
+      if ((x_min + x >= geometry.width()) || (y_min + y >= geometry.height()))
+	continue;
+
+      QPointF point(x_min + x + 0.5, y_min + y + 0.5);
+      Stomp::AngularCoordinate ang;
+      double weight;
+      if (geometry.pointToAng(point, ang) &&
+	  stomp_map->FindLocation(ang, weight))
+	line[x] = palette.rgb(weight);
+    }
+  }
+}
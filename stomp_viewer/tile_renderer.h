@@ -0,0 +1,107 @@
+// Copyright 2010  All Rights Reserved.
+// Author: ryan.scranton@gmail.com (Ryan Scranton)
+
+// STOMP is a set of libraries for doing astrostatistical analysis on the
+// celestial sphere.  The goal is to enable descriptions of arbitrary regions
+// on the sky which may or may not encode futher spatial information (galaxy
+// density, CMB temperature, observational depth, etc.) and to do so in such
+// a way as to make the analysis of that data as algorithmically efficient as
+// possible.
+//
+// This header file contains the TileRenderer class, which rasterizes a
+// Stomp::Map into a QImage for the RenderMapThread.
+
+#ifndef TILE_RENDERER_H
+#define TILE_RENDERER_H
+
+#include <QCache>
+#include <QImage>
+#include <QMutex>
+#include <QString>
+#include <functional>
+#include <map>
+#include <vector>
+#include <stomp.h>
+#include "palette.h"
+#include "render_geometry.h"
+
+class Palette;
+class RenderGeometry;
+class TileRenderer;
+
+class TileRenderer {
+  // Drawing a polygon for every pixel in the Map gets very slow once the Map
+  // has tens of millions of pixels, most of which are smaller than a pixel
+  // in the image.  Instead, we split the image into TileSize x TileSize tiles
+  // and fill in each image pixel with the Map weight at its center.  The
+  // tiles are done in parallel and kept in a cache keyed on the geometry,
+  // palette and resolution that produced them, so going back to an earlier
+  // view doesn't redo the work.
+  //
+  // The weights are looked up in a pyramid of softened copies of the Map
+  // (one for each resolution coarser than the Map's maximum), using the
+  // resolution that best matches the size of an image pixel.  The levels
+  // are only built as they're rendered, so the coarse first pass of
+  // levelOfDetail only has to wait for its own level and the caller gets a
+  // chance to cancel before each of the finer ones is built.
+  //
+  // Nothing here depends on a QWidget, so the renderer works just as well
+  // with the offscreen platform (QT_QPA_PLATFORM=offscreen) for testing.
+
+ public:
+  enum {
+    TileSize = 128
+  };
+  TileRenderer();
+  ~TileRenderer();
+
+  // Set the Map to render.  This doesn't do any work beyond dropping the
+  // pyramid and tile cache for the previous Map.  The TileRenderer doesn't
+  // take ownership of the Map, but it keeps the pyramid levels it builds
+  // until the next call to setMap or clear, so this needs to be called again
+  // whenever the Map changes.
+  void setMap(Stomp::Map* stomp_map);
+  void clear();
+  Stomp::Map* map();
+
+  // The number of softened levels built so far for the current Map.
+  int pyramidLevels();
+
+  // The resolution whose pixels best match the size of an image pixel for
+  // the given geometry, limited to max_resolution and the resolution range
+  // of the Map.
+  uint32_t renderResolution(RenderGeometry& geometry,
+			    uint32_t max_resolution);
+
+  // The sequence of resolutions for a coarse-to-fine set of passes, ending
+  // with renderResolution.
+  void levelOfDetail(RenderGeometry& geometry, uint32_t max_resolution,
+		     std::vector<uint32_t>& resolutions);
+
+  // Render the whole image using the pyramid level for the given resolution,
+  // building that level first if we don't have it yet.  The image needs to
+  // be the same size as the geometry.  If cancelled is set, it's checked
+  // before building the level and before each tile and the method returns
+  // false if it comes back true; otherwise the return value is true.
+  bool render(RenderGeometry& geometry, Palette& palette,
+	      uint32_t resolution, QImage& image,
+	      std::function<bool()> cancelled = std::function<bool()>());
+
+  // Control the size of the tile cache.  The default is 128 MB.
+  void setCacheSize(int max_kilobytes);
+  int cachedTiles();
+
+ private:
+  Stomp::Map* _level(uint32_t resolution);
+  QString _tileKey(RenderGeometry& geometry, Palette& palette,
+		   uint32_t resolution, int tile_x, int tile_y);
+  void _renderTile(RenderGeometry& geometry, Palette& palette,
+		   Stomp::Map* stomp_map, int x_min, int y_min, QImage& tile);
+
+  Stomp::Map* base_map_;
+  std::map<uint32_t, Stomp::Map*> pyramid_;
+  QCache<QString, QImage> cache_;
+  QMutex cache_mutex_;
+};
+
+#endif
@@ -0,0 +1,131 @@
+#include <QApplication>
+#include <QImage>
+#include <iostream>
+#include <vector>
+#include <stomp.h>
+#include "palette.h"
+#include "render_geometry.h"
+#include "tile_renderer.h"
+
+void TileRendererPyramidTests() {
+  // The pyramid levels should only be built as they're rendered, coarsest
+  // first, and only those that levelOfDetail asks for.
+  std::cout << "\n";
+  std::cout << "**********************************\n";
+  std::cout << "*** TileRenderer Pyramid Tests ***\n";
+  std::cout << "**********************************\n";
+
+  Stomp::AngularCoordinate ang(60.0, 0.0,
+			       Stomp::AngularCoordinate::Equatorial);
+  Stomp::Pixel tmp_pix(ang, 256);
+  Stomp::PixelVector circle_pix;
+  tmp_pix.WithinRadius(2.0, circle_pix);
+  for (Stomp::PixelIterator iter=circle_pix.begin();
+       iter!=circle_pix.end();++iter) iter->SetWeight(0.5);
+  Stomp::Map* stomp_map = new Stomp::Map(circle_pix);
+
+  RenderGeometry geometry(55.0, 65.0, -5.0, 5.0,
+			  Stomp::AngularCoordinate::Equatorial, 256, 256);
+  Palette palette(Palette::BlueTemperature, 0.0, 1.0, false);
+
+  TileRenderer tile_renderer;
+  tile_renderer.setMap(stomp_map);
+  std::cout << "\tLevels after setMap: " <<
+    tile_renderer.pyramidLevels() << "\n";
+  if (tile_renderer.pyramidLevels() != 0)
+    std::cout << "\tFAILED: setMap built pyramid levels.\n";
+
+  std::vector<uint32_t> resolutions;
+  tile_renderer.levelOfDetail(geometry, stomp_map->MaxResolution(),
+			      resolutions);
+  std::cout << "\tLevel of detail:";
+  for (uint32_t i=0;i<resolutions.size();i++)
+    std::cout << " " << resolutions[i];
+  std::cout << "\n";
+  for (uint32_t i=1;i<resolutions.size();i++)
+    if (resolutions[i] <= resolutions[i-1])
+      std::cout << "\tFAILED: Level of detail isn't coarse to fine.\n";
+
+  QRgb white = QColor(Qt::white).rgb();
+  QRgb map_color = palette.rgb(0.5);
+  QImage image;
+  int n_levels = 0;
+  for (uint32_t i=0;i<resolutions.size();i++) {
+    if (!tile_renderer.render(geometry, palette, resolutions[i], image))
+      std::cout << "\tFAILED: Uncancelled render returned false.\n";
+    if (resolutions[i] < stomp_map->MaxResolution()) n_levels++;
+
+    std::cout << "\t" << resolutions[i] << ": " <<
+      tile_renderer.pyramidLevels() << " levels, " <<
+      tile_renderer.cachedTiles() << " cached tiles\n";
+    if (tile_renderer.pyramidLevels() != n_levels)
+      std::cout << "\tFAILED: Expected " << n_levels << " levels.\n";
+    if (image.pixel(128, 128) != map_color)
+      std::cout << "\tFAILED: Center of the image doesn't match the Map.\n";
+    if (image.pixel(2, 2) != white)
+      std::cout << "\tFAILED: Corner of the image isn't blank.\n";
+  }
+
+  tile_renderer.clear();
+  delete stomp_map;
+}
+
+void TileRendererCacheTests() {
+  // Cancelling should stop the render before it builds anything and going
+  // back to a view we've already rendered should come out of the cache.
+  std::cout << "\n";
+  std::cout << "********************************\n";
+  std::cout << "*** TileRenderer Cache Tests ***\n";
+  std::cout << "********************************\n";
+
+  Stomp::AngularCoordinate ang(60.0, 0.0,
+			       Stomp::AngularCoordinate::Equatorial);
+  Stomp::Pixel tmp_pix(ang, 256);
+  Stomp::PixelVector circle_pix;
+  tmp_pix.WithinRadius(2.0, circle_pix);
+  Stomp::Map* stomp_map = new Stomp::Map(circle_pix);
+
+  RenderGeometry geometry(55.0, 65.0, -5.0, 5.0,
+			  Stomp::AngularCoordinate::Equatorial, 256, 256);
+  Palette palette(Palette::BlueTemperature, 0.0, 2.0, false);
+
+  TileRenderer tile_renderer;
+  tile_renderer.setMap(stomp_map);
+  uint32_t resolution = Stomp::HPixResolution*4;
+
+  QImage image;
+  if (tile_renderer.render(geometry, palette, resolution, image,
+			   []() { return true; }))
+    std::cout << "\tFAILED: Cancelled render returned true.\n";
+  if ((tile_renderer.pyramidLevels() != 0) ||
+      (tile_renderer.cachedTiles() != 0))
+    std::cout << "\tFAILED: Cancelled render did some work.\n";
+
+  tile_renderer.render(geometry, palette, resolution, image);
+  int n_tiles = tile_renderer.cachedTiles();
+  std::cout << "\tRendered " << n_tiles << " tiles.\n";
+  if (n_tiles != 4)
+    std::cout << "\tFAILED: Expected 4 tiles for a 256x256 image.\n";
+
+  QImage cached_image;
+  tile_renderer.render(geometry, palette, resolution, cached_image);
+  if (tile_renderer.cachedTiles() != n_tiles)
+    std::cout << "\tFAILED: Repeat render didn't use the cache.\n";
+  if (cached_image != image)
+    std::cout << "\tFAILED: Cached image doesn't match the original.\n";
+
+  tile_renderer.clear();
+  delete stomp_map;
+}
+
+int main(int argc, char *argv[]) {
+  // Nothing here needs a display; the renderer only draws into QImages, so
+  // we run everything on the offscreen platform.
+  qputenv("QT_QPA_PLATFORM", "offscreen");
+  QApplication app(argc, argv);
+
+  TileRendererPyramidTests();
+  TileRendererCacheTests();
+
+  return 0;
+}
@@ -0,0 +1,18 @@
+######################################################################
+# Offscreen tests for the TileRenderer.  Build with qmake and run
+# ./tile_renderer_test; no display is needed.
+######################################################################
+
+TEMPLATE = app
+TARGET = tile_renderer_test
+DEPENDPATH += .
+INCLUDEPATH += .
+CONFIG += debug console
+CONFIG -= app_bundle
+QMAKE_CXXFLAGS += -std=c++0x
+greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
+
+# Input
+HEADERS += render_geometry.h palette.h tile_renderer.h
+SOURCES += tile_renderer_test.cc render_geometry.cc palette.cc tile_renderer.cc
+LIBS += -lm -lstomp -lpthread